@@ -210,6 +210,22 @@ typedef uint16_t sample_tx_t;
 typedef uint8_t data_tx_rx_t;
 #define sample_rx_csv_enum csv_u16
 
+/**
+ * @brief	Identification of a buffer of samples delivered to the TX and RX callbacks
+ * @details
+ *	The timestamps come from CLOCK_MONOTONIC (the clock of _plc_time_get_hires_stamp_) so the TX
+ *	and RX ones are directly comparable
+ */
+struct plc_buffer_stamp
+{
+	/// Buffer number since the start of the streaming. The buffers lost (as the overflowed or
+	/// discarded ones on capture) are also counted so a gap in the sequence reveals them
+	uint32_t sequence;
+	/// Time when the buffer was completed by the capturing device (RX) or handed to the
+	/// transmission device (TX) [ns]
+	int64_t timestamp_ns;
+};
+
 // Shared fifo path used to simulate a TX-RX loop
 #define TXRX_SHARED_FIFO_PATH "/tmp/plc-cape-lab-txrx-fifo"
 
@@ -241,6 +257,45 @@ enum plc_rx_device_enum
 	plc_rx_device_alsa,
 	/// Internal memory-based fifo
 	plc_rx_device_internal_fifo,
+	/// Replay of a capture file
+	plc_rx_device_replay,
+};
+
+/// Periods of the ALSA ring buffer when not specified
+#define PLC_ALSA_PERIODS_DEFAULT 4
+
+/**
+ * @brief	Configuration of the ALSA devices (#plc_tx_device_alsa and #plc_rx_device_alsa)
+ * @details
+ *	Specific PCMs as "hw:Loopback,0" (_snd-aloop_) or "hw:Dummy" (_snd-dummy_) allow deterministic
+ *	emulation runs. The _mmap_ mode requires a PCM supporting it (typically "hw:" ones)
+ */
+struct plc_alsa_settings
+{
+	/// PCM name. NULL for "default"
+	char *device;
+	/// 1 to encode and decode the samples directly in the ring buffer of the device; 0 to copy
+	/// them through intermediate buffers ('snd_pcm_writei' and 'snd_pcm_readi')
+	uint32_t mmap;
+	/// Frames per period (transfer unit). 0 to use the buffer length of the application
+	uint32_t period_frames;
+	/// Periods of the ring buffer. 0 for #PLC_ALSA_PERIODS_DEFAULT
+	uint32_t periods;
+};
+
+/**
+ * @brief	Statistics of the ALSA devices. Reset when the streaming starts
+ */
+struct plc_alsa_statistics
+{
+	/// Overruns (capture) or underruns (playback) detected
+	uint32_t xruns;
+	/// Successful recoveries from xruns or suspensions
+	uint32_t recoveries;
+	/// Frames between the application and the hardware after the last transfer
+	uint32_t delay_frames;
+	/// Maximum of _delay_frames_
+	uint32_t delay_max_frames;
 };
 
 //
@@ -277,17 +332,30 @@ typedef int (*singletons_provider_get_t)(singletons_provider_h handle,
  * @brief	Macro encapsulating the name of one of public functions exported by the plugins
  * @note	'define' statements are used on public API function names to simplify maintenance
  *			(global renaming, location of public entry points by global search, etc.)
+ * @note	When a plugin is compiled to be linked statically into the applications (see
+ *			'PLUGINS_STATIC' in 'make_object.mk') 'PLUGIN_STATIC_NAME' is defined and the entry
+ *			points are prefixed with it to be unique (e.g. 'encoder_wave_plugin_api_load')
  */
+#ifdef PLUGIN_STATIC_NAME
+#define PLUGIN_STATIC_SYMBOL_CONCAT(prefix, symbol) prefix##_##symbol
+#define PLUGIN_STATIC_SYMBOL_EXPAND(prefix, symbol) PLUGIN_STATIC_SYMBOL_CONCAT(prefix, symbol)
+#define PLUGIN_STATIC_SYMBOL(symbol) PLUGIN_STATIC_SYMBOL_EXPAND(PLUGIN_STATIC_NAME, symbol)
+#define PLUGIN_API_SET_SINGLETON_PROVIDER PLUGIN_STATIC_SYMBOL(set_singletons_provider)
+#define PLUGIN_API_LOAD PLUGIN_STATIC_SYMBOL(plugin_api_load)
+#define PLUGIN_API_UNLOAD PLUGIN_STATIC_SYMBOL(plugin_api_unload)
+#else
 #define PLUGIN_API_SET_SINGLETON_PROVIDER set_singletons_provider
+#define PLUGIN_API_LOAD plugin_api_load
+#define PLUGIN_API_UNLOAD plugin_api_unload
+#endif
+
 #define PLUGIN_API_SET_SINGLETON_PROVIDER_STRING \
 	EXPAND_AND_QUOTE(PLUGIN_API_SET_SINGLETON_PROVIDER)
 typedef void (*plugin_set_singletons_provider_t)(singletons_provider_get_t, singletons_provider_h);
 
-#define PLUGIN_API_LOAD plugin_api_load
 #define PLUGIN_API_LOAD_STRING EXPAND_AND_QUOTE(PLUGIN_API_LOAD)
 typedef void *(*plugin_api_load_t)(uint32_t *plugin_api_version, uint32_t *plugin_api_size);
 
-#define PLUGIN_API_UNLOAD plugin_api_unload
 #define PLUGIN_API_UNLOAD_STRING EXPAND_AND_QUOTE(PLUGIN_API_UNLOAD)
 typedef void (*plugin_api_unload_t)(void *plugin_api);
 
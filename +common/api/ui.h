@@ -36,6 +36,7 @@ enum ui_data_type
 	data_type_str,
 	data_type_list,
 	data_type_callbacks,
+	data_type_u64,
 };
 
 union ui_data_ptr
@@ -43,6 +44,7 @@ union ui_data_ptr
 	int *i32;
 	uint16_t *u16;
 	uint32_t *u32;
+	uint64_t *u64;
 	float *f;
 	char **str;
 	struct ui_dialog_list
@@ -15,6 +15,14 @@
 #	ADDITIONAL_HEADERS: [Optional] Other dependencies on compiling (e.g. api/*)
 #	SOURCE_PATH: [Optional] If the source code and the 'makefile' are in different folders
 #		this variable indicates the relativa path to source (e.g. for makefile in subdir -> ../)
+#	LTO: [Optional] If defined applies link-time optimization
+#		(e.g. 'make PROFILE=release.bbb LTO=1') across the executables and the static libraries
+#		and plugins linked into them (the static plugins keep the LTO intermediate code)
+#	PLUGINS_STATIC: [Optional] Plugins to be linked statically into the applications declaring
+#		their category in ADDITIONAL_PLC_PLUGIN_CATEGORIES (e.g. 'make PLUGINS_STATIC="encoder-wave
+#		decoder-ook"'). The category is the prefix of the plugin name. Their dynamic libraries
+#		are still built and the rest of plugins are loaded dynamically. The external libraries
+#		required by the static plugins must be linked by the application
 #
 # ENVIRONMENT VARIABLES
 #	DEV_BIN_DIR: [Optional] absolute path for resulting objects and executables
@@ -73,6 +81,45 @@ $(error 'PROFILE=$(PROFILE)' unknown)
 endif
 endif	# ifdef PROFILE
 
+# Link-time optimization. The optimization flags are also required when linking
+AR = ar
+ifdef LTO
+CFLAGS += -flto
+LDFLAGS += $(filter -O%,$(CFLAGS)) -flto
+# Archives with the LTO symbol table
+AR = gcc-ar
+endif
+
+# Static plugins: an object file with only the entry points (prefixed with the plugin name) global
+# NOTE: The plugin is compiled again without '-fwhole-program' as the symbols are localized by
+#	'objcopy' once linked. With LTO the relocatable object keeps the intermediate code to be
+#	optimized with the application, which 'objcopy' can't localize: the rest of global symbols,
+#	taken from a machine-code build, are renamed with the plugin name as prefix through the
+#	preprocessor instead (C plugins only). The linker then lets LTO internalize them
+PLUGIN_NAME = $(basename $(TARGET))
+PLUGIN_STATIC_NAME = $(subst -,_,$(PLUGIN_NAME))
+PLUGIN_STATIC_TARGET = $(BUILD_TARGET_NO_EXT).static.o
+PLUGIN_STATIC_ENTRY_POINTS = set_singletons_provider plugin_api_load plugin_api_unload
+ifeq ($(BUILD_TARGET_SUFFIX), .so)
+ifneq ($(filter $(PLUGIN_NAME),$(PLUGINS_STATIC)),)
+ADDITIONAL_TARGETS += $(PLUGIN_STATIC_TARGET)
+endif
+endif
+
+# Applications: link the static plugins of the categories used
+PLUGINS_STATIC_LINKED = $(foreach plugin,$(PLUGINS_STATIC), \
+		$(if $(filter $(firstword $(subst -, ,$(plugin))),$(ADDITIONAL_PLC_PLUGIN_CATEGORIES)), \
+				$(plugin)))
+ifeq ($(BUILD_TARGET_SUFFIX),)
+ifneq ($(strip $(PLUGINS_STATIC_LINKED)),)
+PLUGINS_STATIC_OBJECTS = $(foreach plugin,$(PLUGINS_STATIC_LINKED), \
+		$(DEV_BIN_DIR)/plugins/$(firstword $(subst -, ,$(plugin)))/$(plugin)/$(plugin).static.o)
+# Table of entry points registered through 'libplc-tools/api/plugin_static.h'
+CFLAGS += -D'PLUGINS_STATIC_LIST=$(foreach plugin,$(PLUGINS_STATIC_LINKED), \
+		PLUGIN_STATIC($(firstword $(subst -, ,$(plugin))), $(subst -,_,$(plugin))))'
+endif
+endif
+
 # Extra CFLAGS depending on target
 ifeq ($(BUILD_TARGET_SUFFIX), .so)
 CFLAGS += -fwhole-program -fPIC
@@ -101,7 +148,8 @@ LIBS += \
 
 # Declare external header libraries to trigger the compiler when updated
 ADDITIONAL_DEPENDENCIES = \
-	$(foreach library,$(ADDITIONAL_PLC_LIBS),$(DEV_BIN_DIR)/libraries/lib$(library)/lib$(library).a)
+	$(foreach library,$(ADDITIONAL_PLC_LIBS),$(DEV_BIN_DIR)/libraries/lib$(library)/lib$(library).a) \
+	$(PLUGINS_STATIC_OBJECTS)
 
 HEADERS = \
 	$(wildcard $(SOURCE_PATH)*.h) \
@@ -116,7 +164,7 @@ default: all
 
 # The 'all: default' clause is not strictly required but it's convenient to simplify the importing
 # of makefiles into tools as Eclipse executing a 'make all' by default to build a project
-all: $(BUILD_TARGET)
+all: $(BUILD_TARGET) $(ADDITIONAL_TARGETS)
 
 display-vars:
 	@echo ENVIRONMENT VARIABLES
@@ -132,6 +180,8 @@ display-vars:
 	@echo ADDITIONAL_PLC_LIBS: $(ADDITIONAL_PLC_LIBS)
 	@echo ADDITIONAL_PLC_PLUGIN_CATEGORIES: $(ADDITIONAL_PLC_PLUGIN_CATEGORIES)
 	@echo ADDITIONAL_HEADERS: $(ADDITIONAL_HEADERS)
+	@echo LTO: $(LTO)
+	@echo PLUGINS_STATIC: $(PLUGINS_STATIC)
 	@echo 
 	@echo INTERNAL VARIABLES
 	@echo MAKEFILE_DIR: $(MAKEFILE_DIR)
@@ -139,7 +189,9 @@ display-vars:
 	@echo BUILD_TARGET: $(BUILD_TARGET)
 	@echo CFLAGS: $(CFLAGS)
 	@echo BUILD_OBJECTS: $(BUILD_OBJECTS)
+	@echo LDFLAGS: $(LDFLAGS)
 	@echo LIBS: $(LIBS)
+	@echo PLUGINS_STATIC_OBJECTS: $(PLUGINS_STATIC_OBJECTS)
 	@echo HEADERS: $(HEADERS)
 	@echo ADDITIONAL_DEPENDENCIES: $(ADDITIONAL_DEPENDENCIES)
 
@@ -160,20 +212,39 @@ $(BUILD_DIR):
 
 $(BUILD_TARGET_NO_EXT): $(BUILD_DIR) $(BUILD_OBJECTS) $(ADDITIONAL_DEPENDENCIES)
 	@echo "-> $@"
-	@$(CC) $(BUILD_OBJECTS) -L"$(DEV_BIN_DIR)" -Wall $(LIBS) -o $@
+	@$(CC) $(BUILD_OBJECTS) $(PLUGINS_STATIC_OBJECTS) -L"$(DEV_BIN_DIR)" -Wall $(LDFLAGS) $(LIBS) \
+			-o $@
 	
 $(BUILD_TARGET_NO_EXT).so: $(BUILD_DIR) $(BUILD_OBJECTS) $(ADDITIONAL_DEPENDENCIES)
 	@echo "-> $@"
-	@$(CC) $(BUILD_OBJECTS) -L"$(DEV_BIN_DIR)" -Wall $(LIBS) -o $@
+	@$(CC) $(BUILD_OBJECTS) -L"$(DEV_BIN_DIR)" -Wall $(LDFLAGS) $(LIBS) -o $@
 
 $(BUILD_TARGET_NO_EXT).a: $(BUILD_DIR) $(BUILD_OBJECTS) $(ADDITIONAL_DEPENDENCIES)
 	@echo "-> $@"
-	@ar -r $(BUILD_TARGET) $(BUILD_OBJECTS)
+	@$(AR) -r $(BUILD_TARGET) $(BUILD_OBJECTS)
+
+$(PLUGIN_STATIC_TARGET): $(BUILD_DIR) $(wildcard $(SOURCE_PATH)*.$(SRC_EXT)) $(HEADERS)
+	@echo "-> $@"
+	@$(CC) $(filter-out -flto -fwhole-program -fPIC,$(CFLAGS)) \
+			-DPLUGIN_STATIC_NAME=$(PLUGIN_STATIC_NAME) -I"$(DEV_SRC_DIR)" -r -nostdlib \
+			$(wildcard $(SOURCE_PATH)*.$(SRC_EXT)) -o $@
+ifdef LTO
+	@$(CC) $(filter-out -fwhole-program -fPIC,$(CFLAGS)) \
+			-DPLUGIN_STATIC_NAME=$(PLUGIN_STATIC_NAME) -I"$(DEV_SRC_DIR)" -r -nostdlib \
+			$$(nm -g --defined-only $@ \
+					| grep -v $(foreach symbol,$(PLUGIN_STATIC_ENTRY_POINTS), \
+							-e ' $(PLUGIN_STATIC_NAME)_$(symbol)$$') \
+					| awk '{ printf " -D%s=$(PLUGIN_STATIC_NAME)_%s", $$3, $$3 }') \
+			$(wildcard $(SOURCE_PATH)*.$(SRC_EXT)) -o $@
+else
+	@objcopy $(foreach symbol,$(PLUGIN_STATIC_ENTRY_POINTS), \
+			--keep-global-symbol=$(PLUGIN_STATIC_NAME)_$(symbol)) $@
+endif
 
 clean:
 	@echo $@ $(BUILD_TARGET)
 	@-rm -f $(BUILD_OBJECTS)
-	@-rm -f $(BUILD_TARGET)
+	@-rm -f $(BUILD_TARGET) $(ADDITIONAL_TARGETS)
 
 clean-build-objects:
 	@echo $@ $(BUILD_TARGET)
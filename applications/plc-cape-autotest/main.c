@@ -184,7 +184,8 @@ void prepare_next_samples_f025_callback(void *handle, sample_tx_t *buffer, uint3
 	}
 }
 
-void tx_on_buffer_sent_callback(void *handle, sample_tx_t *buffer, uint32_t buffer_count)
+void tx_on_buffer_sent_callback(void *handle, sample_tx_t *buffer, uint32_t buffer_count,
+		const struct plc_buffer_stamp *stamp)
 {
 	putc('.', stdout);
 	// NOTE: 'fflush' required to have live progress information
@@ -227,7 +228,7 @@ struct rx_callback_data
 };
 
 void rx_buffer_completed_callback(void *data, sample_rx_t *samples_buffer,
-		uint32_t samples_buffer_count)
+		uint32_t samples_buffer_count, const struct plc_buffer_stamp *stamp)
 {
 	putc('+', stdout);
 	// NOTE: 'fflush' required to have live progress information
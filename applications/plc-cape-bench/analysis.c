@@ -0,0 +1,212 @@
+/**
+ * @file
+ * @brief	Single-pass RX buffer statistics of _libplc-adc_ against a scalar reference
+ * @details
+ *	Buffers of OOK-like bursts with noise and occasional DC steps are analyzed by
+ *	_plc_rx_analysis_ and by a straightforward two-pass scalar implementation. The integer values
+ *	must be identical and the floating-point ones equal up to rounding. The mean absolute
+ *	deviation is split at the pivot (the rounded mean of the previous buffer): it must match the
+ *	exact one while the mean stays within 1 LSB of the pivot. On the DC steps it must match the
+ *	split of the reference at the same pivot, and its error against the exact one is reported
+ *
+ * @cond COPYRIGHT_NOTES @copyright
+ *	Copyright (C) 2017 Jose Maria Ortega\n
+ *	Distributed under the GNU GPLv3. For full terms see the file LICENSE
+ * @endcond
+ */
+
+#include <math.h>		// fabs
+#include "+common/api/+base.h"
+#include "libraries/libplc-adc/api/analysis.h"
+#include "libraries/libplc-tools/api/time.h"
+#include "bench.h"
+
+// Same defaults than plc-cape-lab
+#define ANALYSIS_DATA_OFFSET 500
+#define ANALYSIS_DATA_HI_THRESHOLD 20
+#define ANALYSIS_FREQ_ADC_SPS 100000.0f
+#define ANALYSIS_DATA_BIT_US 1000
+#define ANALYSIS_BUFFERS 400
+// One buffer out of this number starts with a DC step
+#define ANALYSIS_DC_STEP_INTERVAL 16
+#define ANALYSIS_SAMPLE_MAX 4095
+#define ANALYSIS_FLOAT_TOLERANCE 1e-4
+
+static const uint32_t buffer_samples_list[] = {
+	256, 2048, 16384 };
+
+struct analysis_reference
+{
+	sample_rx_t min;
+	sample_rx_t max;
+	double dc_mean;
+	double ac_mean;
+	// Split at the pivot, as the single pass does
+	double ac_mean_pivot;
+	double ac_rms;
+	uint32_t hi_samples;
+	uint32_t crossings;
+	int data_detected;
+};
+
+// Two passes: the values and the mean first, then the deviations from the mean
+static void analysis_reference_analyze(const sample_rx_t *buffer, uint32_t buffer_samples,
+		sample_rx_t pivot, struct analysis_reference *reference)
+{
+	sample_rx_t threshold = ANALYSIS_DATA_OFFSET + ANALYSIS_DATA_HI_THRESHOLD;
+	reference->min = buffer[0];
+	reference->max = buffer[0];
+	reference->hi_samples = 0;
+	reference->crossings = 0;
+	double sum = 0.0;
+	uint32_t n;
+	for (n = 0; n < buffer_samples; n++)
+	{
+		if (buffer[n] < reference->min)
+			reference->min = buffer[n];
+		if (buffer[n] > reference->max)
+			reference->max = buffer[n];
+		sum += buffer[n];
+		if (buffer[n] > threshold)
+			reference->hi_samples++;
+		if ((n > 0) && ((buffer[n] > threshold) != (buffer[n - 1] > threshold)))
+			reference->crossings++;
+	}
+	reference->dc_mean = sum / buffer_samples;
+	double ac_sum = 0.0;
+	double ac_sum_pivot = 0.0;
+	double ac_sum2 = 0.0;
+	for (n = 0; n < buffer_samples; n++)
+	{
+		double deviation = buffer[n] - reference->dc_mean;
+		ac_sum += fabs(deviation);
+		ac_sum_pivot += (buffer[n] > pivot) ? deviation : (buffer[n] < pivot) ? -deviation
+				: fabs(deviation);
+		ac_sum2 += deviation * deviation;
+	}
+	reference->ac_mean = ac_sum / buffer_samples;
+	reference->ac_mean_pivot = ac_sum_pivot / buffer_samples;
+	reference->ac_rms = sqrt(ac_sum2 / buffer_samples);
+	uint32_t samples_hi_threshold_detection = (uint32_t) (ANALYSIS_FREQ_ADC_SPS
+			* ANALYSIS_DATA_BIT_US / 1000000.0f / 4);
+	if (samples_hi_threshold_detection > buffer_samples / 4)
+		samples_hi_threshold_detection = buffer_samples / 4;
+	reference->data_detected = (samples_hi_threshold_detection > 0)
+			&& (reference->hi_samples >= samples_hi_threshold_detection);
+}
+
+// Deterministic uniform noise in [0, 1)
+static float analysis_noise(uint32_t *state)
+{
+	*state = *state * 1664525 + 1013904223;
+	return (*state >> 8) / 16777216.0f;
+}
+
+// Fills the buffers with bursts of a 2 KHz carrier over a DC level changing now and then
+static sample_rx_t *analysis_generate(uint32_t buffer_samples)
+{
+	sample_rx_t *buffers = malloc(ANALYSIS_BUFFERS * buffer_samples * sizeof(sample_rx_t));
+	uint32_t noise_state = buffer_samples;
+	float dc_level = ANALYSIS_DATA_OFFSET;
+	uint32_t n;
+	for (n = 0; n < ANALYSIS_BUFFERS * buffer_samples; n++)
+	{
+		if ((n % (ANALYSIS_DC_STEP_INTERVAL * buffer_samples)) == 0)
+			dc_level = ANALYSIS_DATA_OFFSET + 400.0f * (analysis_noise(&noise_state) - 0.5f);
+		// Bits of 100 samples, one out of two with carrier
+		float amplitude = ((n / 100) % 2) ? 200.0f : 0.0f;
+		float sample = dc_level + amplitude * sinf(2.0f * M_PI * (n % 50) / 50)
+				+ 40.0f * (analysis_noise(&noise_state) - 0.5f);
+		buffers[n] = (sample < 0.0f) ? 0 :
+				(sample > ANALYSIS_SAMPLE_MAX) ? ANALYSIS_SAMPLE_MAX : lroundf(sample);
+	}
+	return buffers;
+}
+
+static int analysis_equal(double value, double reference)
+{
+	return fabs(value - reference) <= ANALYSIS_FLOAT_TOLERANCE * (1.0 + fabs(reference));
+}
+
+static struct plc_rx_analysis *analysis_create(enum plc_rx_statistics_mode mode)
+{
+	struct plc_rx_analysis *plc_rx_analysis = plc_rx_analysis_create();
+	plc_rx_analysis_configure(plc_rx_analysis, ANALYSIS_FREQ_ADC_SPS, ANALYSIS_DATA_BIT_US,
+			ANALYSIS_DATA_OFFSET, ANALYSIS_DATA_HI_THRESHOLD);
+	plc_rx_analysis_set_statistics_mode(plc_rx_analysis, mode);
+	plc_rx_analysis_reset(plc_rx_analysis);
+	return plc_rx_analysis;
+}
+
+int bench_rx_analysis(void)
+{
+	int ret = 0;
+	uint32_t n;
+	for (n = 0; n < ARRAY_SIZE(buffer_samples_list); n++)
+	{
+		uint32_t buffer_samples = buffer_samples_list[n];
+		sample_rx_t *buffers = analysis_generate(buffer_samples);
+		struct analysis_reference *references = malloc(
+				ANALYSIS_BUFFERS * sizeof(struct analysis_reference));
+		struct timespec start = plc_time_get_hires_stamp();
+		// The pivot follows the mean of the previous buffer, from the data offset after a reset
+		sample_rx_t pivot = ANALYSIS_DATA_OFFSET;
+		uint32_t b;
+		for (b = 0; b < ANALYSIS_BUFFERS; b++)
+		{
+			analysis_reference_analyze(buffers + b * buffer_samples, buffer_samples, pivot,
+					&references[b]);
+			pivot = lround(references[b].dc_mean);
+		}
+		double reference_us = bench_get_elapsed_us(start);
+		// Values mode: checked buffer per buffer, so timed apart
+		struct plc_rx_analysis *plc_rx_analysis = analysis_create(plc_rx_statistics_values);
+		uint32_t mismatches = 0;
+		uint32_t pivot_misses = 0;
+		double pivot_error_max = 0.0;
+		double values_us = 0.0;
+		for (b = 0; b < ANALYSIS_BUFFERS; b++)
+		{
+			const struct analysis_reference *reference = &references[b];
+			start = plc_time_get_hires_stamp();
+			int data_detected = plc_rx_analysis_analyze_buffer(plc_rx_analysis,
+					buffers + b * buffer_samples, buffer_samples);
+			values_us += bench_get_elapsed_us(start);
+			const struct rx_statistics *rx_stat = plc_rx_analysis_get_statistics(plc_rx_analysis);
+			if ((rx_stat->buffer_min != reference->min) || (rx_stat->buffer_max != reference->max)
+					|| (rx_stat->buffer_hi_samples != reference->hi_samples)
+					|| (rx_stat->buffer_crossings != reference->crossings)
+					|| (data_detected != reference->data_detected)
+					|| !analysis_equal(rx_stat->buffer_dc_mean, reference->dc_mean)
+					|| !analysis_equal(rx_stat->buffer_ac_mean, reference->ac_mean_pivot)
+					|| !analysis_equal(rx_stat->buffer_ac_rms, reference->ac_rms))
+				mismatches++;
+			double pivot_error = fabs(reference->ac_mean_pivot - reference->ac_mean);
+			if (!analysis_equal(reference->ac_mean_pivot, reference->ac_mean))
+			{
+				pivot_misses++;
+				if (pivot_error > pivot_error_max)
+					pivot_error_max = pivot_error;
+			}
+		}
+		plc_rx_analysis_release(plc_rx_analysis);
+		// None mode: only the data detection
+		plc_rx_analysis = analysis_create(plc_rx_statistics_none);
+		uint32_t detection_mismatches = 0;
+		start = plc_time_get_hires_stamp();
+		for (b = 0; b < ANALYSIS_BUFFERS; b++)
+			detection_mismatches += (plc_rx_analysis_analyze_buffer(plc_rx_analysis,
+					buffers + b * buffer_samples, buffer_samples) != references[b].data_detected);
+		double none_us = bench_get_elapsed_us(start);
+		plc_rx_analysis_release(plc_rx_analysis);
+		ret |= bench_check((mismatches == 0) && (detection_mismatches == 0),
+				"%5u samples: %u/%u mismatches. us per buffer: scalar %.2f, values %.2f, none %.2f. "
+				"AC mean off the pivot in %u buffers, max error %.2f LSB",
+				buffer_samples, mismatches + detection_mismatches, 2 * ANALYSIS_BUFFERS,
+				reference_us / ANALYSIS_BUFFERS, values_us / ANALYSIS_BUFFERS,
+				none_us / ANALYSIS_BUFFERS, pivot_misses, pivot_error_max);
+		free(references);
+		free(buffers);
+	}
+	return ret;
+}
@@ -0,0 +1,77 @@
+/**
+ * @file
+ * @brief	Checks and benchmarks run by _plc-cape-bench_
+ * @details
+ *	Each bench is a function printing its own report. The checks compare an optimized
+ *	implementation with a reference one (or a decoder output with the transmitted data) and
+ *	determine the exit status of the application. The timings are informative
+ *
+ * @cond COPYRIGHT_NOTES @copyright
+ *	Copyright (C) 2017 Jose Maria Ortega\n
+ *	Distributed under the GNU GPLv3. For full terms see the file LICENSE
+ * @endcond
+ */
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include "libraries/libplc-tools/api/plugin.h"
+#include "libraries/libplc-tools/api/signal.h"
+#include "plugins/decoder/api/decoder.h"
+#include "plugins/encoder/api/encoder.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Runs a bench. Returns 0 if all its checks passed
+typedef int (*bench_run_t)(void);
+
+struct bench
+{
+	const char *name;
+	const char *description;
+	bench_run_t run;
+};
+
+// Prints the result of a check prefixed by PASS/FAIL. Returns 0 if passed, -1 otherwise, to be
+// accumulated with '|='
+int bench_check(int passed, const char *format, ...) __attribute__((format(printf, 2, 3)));
+// Microseconds elapsed since 'start' (as returned by 'plc_time_get_hires_stamp')
+double bench_get_elapsed_us(struct timespec start);
+// Loads a plugin returning its API. Exits on failure
+void *bench_load_plugin(enum plc_plugin_category category, const char *name,
+		struct plc_plugin **plugin);
+
+// Encodes the OOK loopback message at 'sampling_rate_sps'. The returned buffer must be freed
+sample_tx_t *bench_ook_encode(struct encoder_api *encoder_api, float sampling_rate_sps,
+		uint32_t samples_count);
+// Creates a 'decoder-ook' configured to decode 'bench_ook_encode' signals from their sample
+//	'first_sample', pending of 'initialize'
+decoder_api_h bench_ook_create_decoder(struct decoder_api *decoder_api, uint32_t decode_mode,
+		uint16_t data_hi_threshold, uint32_t first_sample);
+// Same than 'bench_ook_create_decoder' with a decimation front-end
+decoder_api_h bench_ook_create_decoder_decimated(struct decoder_api *decoder_api,
+		uint32_t decode_mode, uint16_t data_hi_threshold, uint32_t first_sample,
+		enum plc_signal_decimator_enum decimator, uint32_t decimation);
+
+int bench_fixed_point(void);
+int bench_ook_loopback(void);
+int bench_deferred_chunks(void);
+int bench_correlator(void);
+int bench_rx_analysis(void);
+int bench_csv_writer(void);
+int bench_plugin_calls(void);
+int bench_decimation(void);
+int bench_capture(void);
+int bench_profile_cache(void);
+int bench_logger_contention(void);
+int bench_spsc_ring(void);
+int bench_plot_drawing(void);
+int bench_spectrum(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BENCH_H */
@@ -0,0 +1,232 @@
+/**
+ * @file
+ * @brief	Binary capture files of _libplc-tools_ against the CSV ones, and their replay
+ * @details
+ *	The same samples are written as a '.plccap' file with 'plc_capture_writer' (in blocks of the
+ *	ADC buffers of plc-cape-lab) and as a CSV file with 'plc_file_write_csv', and read back with
+ *	'plc_capture_reader' and with a 'strtoul' parser (as the replay device does). Both must return
+ *	the samples written. Reports the write and read throughput of both formats and their sizes.
+ *	Then the binary file is replayed unpaced with buffers that don't divide the capture: all the
+ *	samples must be delivered, the tail in a shorter buffer, and the end of the capture reported
+ *
+ * @cond COPYRIGHT_NOTES @copyright
+ *	Copyright (C) 2017 Jose Maria Ortega\n
+ *	Distributed under the GNU GPLv3. For full terms see the file LICENSE
+ * @endcond
+ */
+
+#include <errno.h>
+#include <unistd.h>		// usleep
+#include "+common/api/+base.h"
+#include "libraries/libplc-adc/api/adc.h"
+#include "libraries/libplc-tools/api/capture.h"
+#include "libraries/libplc-tools/api/file.h"
+#include "libraries/libplc-tools/api/time.h"
+#include "bench.h"
+
+#define CAPTURE_SAMPLES 4000000
+// Same buffers than plc-cape-lab
+#define CAPTURE_BLOCK_SAMPLES 2048
+#define CAPTURE_SAMPLING_RATE_SPS 100000.0f
+#define CAPTURE_SAMPLE_BITS 12
+// Not a divisor of 'CAPTURE_SAMPLES'
+#define CAPTURE_REPLAY_BUFFER_SAMPLES 3000
+#define CAPTURE_REPLAY_TIMEOUT_MS 10000
+#define CAPTURE_REPLAY_POLLING_US 1000
+
+struct capture_replay
+{
+	sample_rx_t *samples;
+	uint32_t samples_count;
+	uint32_t buffers_count;
+	uint32_t last_buffer_samples;
+};
+
+// Deterministic random bits
+static uint32_t capture_random(uint32_t *state)
+{
+	*state = *state * 1664525 + 1013904223;
+	return *state;
+}
+
+static size_t capture_get_file_size(const char *filename)
+{
+	FILE *file = fopen(filename, "rb");
+	if (file == NULL)
+		return 0;
+	fseek(file, 0, SEEK_END);
+	size_t size = ftell(file);
+	fclose(file);
+	return size;
+}
+
+static int capture_write_binary(const char *filename, const sample_rx_t *samples,
+		uint32_t samples_count)
+{
+	struct plc_capture_info info;
+	memset(&info, 0, sizeof(info));
+	info.sample_bits = CAPTURE_SAMPLE_BITS;
+	info.device = plc_rx_device_replay;
+	info.sampling_rate_sps = CAPTURE_SAMPLING_RATE_SPS;
+	struct plc_capture_writer *plc_capture_writer = plc_capture_writer_create(filename, &info, 1);
+	if (plc_capture_writer == NULL)
+		return -1;
+	int ret = 0;
+	uint32_t n;
+	for (n = 0; (n < samples_count) && (ret == 0); n += CAPTURE_BLOCK_SAMPLES)
+	{
+		uint32_t block_samples = samples_count - n;
+		if (block_samples > CAPTURE_BLOCK_SAMPLES)
+			block_samples = CAPTURE_BLOCK_SAMPLES;
+		ret = plc_capture_writer_write_block(plc_capture_writer, samples + n, block_samples,
+				n * (1000000000LL / (int64_t) CAPTURE_SAMPLING_RATE_SPS));
+	}
+	if (plc_capture_writer_close(plc_capture_writer) < 0)
+		ret = -1;
+	return ret;
+}
+
+// Returns the number of samples read
+static uint32_t capture_read_binary(const char *filename, sample_rx_t *samples,
+		uint32_t samples_count)
+{
+	struct plc_capture_reader *plc_capture_reader = plc_capture_reader_open(filename);
+	if (plc_capture_reader == NULL)
+		return 0;
+	uint32_t samples_read = plc_capture_reader_read_samples(plc_capture_reader, 0, samples,
+			samples_count);
+	plc_capture_reader_close(plc_capture_reader);
+	return samples_read;
+}
+
+// Same parser than the replay device. Returns the number of samples read
+static uint32_t capture_read_csv(const char *filename, sample_rx_t *samples,
+		uint32_t samples_count)
+{
+	FILE *file = fopen(filename, "rb");
+	if (file == NULL)
+		return 0;
+	fseek(file, 0, SEEK_END);
+	size_t size = ftell(file);
+	rewind(file);
+	char *text = malloc(size + 1);
+	uint32_t samples_read = 0;
+	if (fread(text, 1, size, file) == size)
+	{
+		text[size] = '\0';
+		const char *cur = text;
+		while (samples_read < samples_count)
+		{
+			char *token_end;
+			unsigned long value = strtoul(cur, &token_end, 10);
+			if (token_end == cur)
+				break;
+			samples[samples_read++] = value;
+			cur = token_end;
+		}
+	}
+	free(text);
+	fclose(file);
+	return samples_read;
+}
+
+static void capture_on_replay_buffer(void *data, sample_rx_t *samples_buffer,
+		uint32_t samples_buffer_count, const struct plc_buffer_stamp *stamp)
+{
+	struct capture_replay *replay = data;
+	if (replay->samples_count + samples_buffer_count <= CAPTURE_SAMPLES)
+		memcpy(replay->samples + replay->samples_count, samples_buffer,
+				samples_buffer_count * sizeof(sample_rx_t));
+	replay->samples_count += samples_buffer_count;
+	replay->buffers_count++;
+	replay->last_buffer_samples = samples_buffer_count;
+}
+
+// Returns 0 if the replay delivers all the samples and reports the end of the capture
+static int capture_replay(const char *filename, const sample_rx_t *samples)
+{
+	struct capture_replay replay;
+	memset(&replay, 0, sizeof(replay));
+	replay.samples = malloc(CAPTURE_SAMPLES * sizeof(sample_rx_t));
+	int end_of_capture = 0;
+	struct plc_adc *plc_adc = plc_adc_create_replay(filename, 0);
+	if (plc_adc)
+	{
+		plc_adc_set_rx_buffer_completed_callback(plc_adc, capture_on_replay_buffer, &replay);
+		uint32_t tick_ini_ms = plc_time_get_tick_ms();
+		plc_adc_start_capture(plc_adc, CAPTURE_REPLAY_BUFFER_SAMPLES, 0, 0.0f);
+		while (!end_of_capture
+				&& (plc_time_get_tick_ms() - tick_ini_ms < CAPTURE_REPLAY_TIMEOUT_MS))
+		{
+			usleep(CAPTURE_REPLAY_POLLING_US);
+			struct plc_adc_statistics statistics;
+			plc_adc_get_statistics(plc_adc, &statistics);
+			end_of_capture = statistics.end_of_capture;
+		}
+		plc_adc_stop_capture(plc_adc);
+		plc_adc_release(plc_adc);
+	}
+	int passed = end_of_capture && (replay.samples_count == CAPTURE_SAMPLES)
+			&& (replay.last_buffer_samples == CAPTURE_SAMPLES % CAPTURE_REPLAY_BUFFER_SAMPLES)
+			&& (memcmp(replay.samples, samples, CAPTURE_SAMPLES * sizeof(sample_rx_t)) == 0);
+	int ret = bench_check(passed, "replay in buffers of %u: %u samples in %u buffers, the last "
+			"of %u, end of capture %s", CAPTURE_REPLAY_BUFFER_SAMPLES, replay.samples_count,
+			replay.buffers_count, replay.last_buffer_samples,
+			end_of_capture ? "reported" : "missing");
+	free(replay.samples);
+	return ret;
+}
+
+int bench_capture(void)
+{
+	sample_rx_t *samples = malloc(CAPTURE_SAMPLES * sizeof(sample_rx_t));
+	sample_rx_t *samples_read = malloc(CAPTURE_SAMPLES * sizeof(sample_rx_t));
+	uint32_t random_state = 1;
+	uint32_t n;
+	for (n = 0; n < CAPTURE_SAMPLES; n++)
+		samples[n] = capture_random(&random_state) >> (32 - CAPTURE_SAMPLE_BITS);
+	char filename_binary[] = "/tmp/plc-cape-bench-capture-XXXXXX" PLC_CAPTURE_EXTENSION;
+	char filename_csv[] = "/tmp/plc-cape-bench-capture-XXXXXX.csv";
+	int file_binary = mkstemps(filename_binary, strlen(PLC_CAPTURE_EXTENSION));
+	int file_csv = mkstemps(filename_csv, strlen(".csv"));
+	if ((file_binary < 0) || (file_csv < 0))
+	{
+		fprintf(stderr, "Unable to create the temporary files: %s\n", strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+	close(file_binary);
+	close(file_csv);
+	int ret = 0;
+	struct timespec start = plc_time_get_hires_stamp();
+	int write_ret = capture_write_binary(filename_binary, samples, CAPTURE_SAMPLES);
+	double write_us = bench_get_elapsed_us(start);
+	memset(samples_read, 0, CAPTURE_SAMPLES * sizeof(sample_rx_t));
+	start = plc_time_get_hires_stamp();
+	uint32_t samples_read_count = capture_read_binary(filename_binary, samples_read,
+			CAPTURE_SAMPLES);
+	double read_us = bench_get_elapsed_us(start);
+	double mb = capture_get_file_size(filename_binary) / (1024.0 * 1024.0);
+	int passed = (write_ret == 0) && (samples_read_count == CAPTURE_SAMPLES)
+			&& (memcmp(samples_read, samples, CAPTURE_SAMPLES * sizeof(sample_rx_t)) == 0);
+	ret |= bench_check(passed, "%-7s %u samples, %5.1f MB: Msamples/s write %7.2f, read %7.2f",
+			"plccap", CAPTURE_SAMPLES, mb, CAPTURE_SAMPLES / write_us,
+			CAPTURE_SAMPLES / read_us);
+	start = plc_time_get_hires_stamp();
+	write_ret = plc_file_write_csv(filename_csv, csv_u16, samples, CAPTURE_SAMPLES, 0);
+	write_us = bench_get_elapsed_us(start);
+	memset(samples_read, 0, CAPTURE_SAMPLES * sizeof(sample_rx_t));
+	start = plc_time_get_hires_stamp();
+	samples_read_count = capture_read_csv(filename_csv, samples_read, CAPTURE_SAMPLES);
+	read_us = bench_get_elapsed_us(start);
+	mb = capture_get_file_size(filename_csv) / (1024.0 * 1024.0);
+	passed = (write_ret == 0) && (samples_read_count == CAPTURE_SAMPLES)
+			&& (memcmp(samples_read, samples, CAPTURE_SAMPLES * sizeof(sample_rx_t)) == 0);
+	ret |= bench_check(passed, "%-7s %u samples, %5.1f MB: Msamples/s write %7.2f, read %7.2f",
+			"csv", CAPTURE_SAMPLES, mb, CAPTURE_SAMPLES / write_us, CAPTURE_SAMPLES / read_us);
+	ret |= capture_replay(filename_binary, samples);
+	unlink(filename_csv);
+	unlink(filename_binary);
+	free(samples_read);
+	free(samples);
+	return ret;
+}
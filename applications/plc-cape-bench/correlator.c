@@ -0,0 +1,187 @@
+/**
+ * @file
+ * @brief	Direct and FFT methods of _plc_correlator_ across template lengths
+ * @details
+ *	A random binary template is inserted several times in a noisy signal. Both methods must find
+ *	the same peaks with the same scores, including all the inserted occurrences. Their timings
+ *	show where the FFT method becomes faster, which is the template length from which
+ *	'plc_correlator_method_auto' should choose it
+ *
+ * @cond COPYRIGHT_NOTES @copyright
+ *	Copyright (C) 2017 Jose Maria Ortega\n
+ *	Distributed under the GNU GPLv3. For full terms see the file LICENSE
+ * @endcond
+ */
+
+#include <math.h>		// fabsf
+#include "+common/api/+base.h"
+#include "libraries/libplc-tools/api/correlator.h"
+#include "libraries/libplc-tools/api/time.h"
+#include "bench.h"
+
+#define CORRELATOR_SIGNAL_SAMPLES 262144
+// Noise appended to the signal to flush the peaks still pending in the last blocks. Longer than
+// the greatest block (the FFT size of the longest template)
+#define CORRELATOR_TAIL_SAMPLES 8192
+#define CORRELATOR_SPAN_SAMPLES 4096
+#define CORRELATOR_OCCURRENCE_INTERVAL 20011
+#define CORRELATOR_NOISE_AMPLITUDE 0.3f
+#define CORRELATOR_THRESHOLD 0.95f
+// Maximum difference between the scores of the two methods for the same peak. Peaks found by
+// only one method must be below the threshold plus this tolerance
+#define CORRELATOR_SCORE_TOLERANCE 1e-3f
+#define CORRELATOR_PEAKS_MAX 4096
+
+static const uint32_t template_counts[] = {
+	8, 16, 32, 64, 128, 256, 512, 1024 };
+
+static const char *method_text[] = {
+	"auto", "direct", "fft" };
+
+// Deterministic uniform noise in [-1, 1)
+static float correlator_noise(uint32_t *state)
+{
+	*state = *state * 1664525 + 1013904223;
+	return (int32_t) *state / 2147483648.0f;
+}
+
+// Runs the whole signal through a correlator of 'method'. Returns the number of peaks stored
+//	into 'peaks', reporting the elapsed time and the peaks discarded
+static uint32_t correlator_run(const float *template_samples, uint32_t template_count,
+		enum plc_correlator_method_enum method, const float *signal, uint32_t signal_count,
+		struct plc_correlator_peak *peaks, double *elapsed_us, uint32_t *peaks_discarded)
+{
+	struct plc_correlator *plc_correlator = plc_correlator_create(template_samples,
+			template_count, CORRELATOR_THRESHOLD, method);
+	uint32_t peaks_count = 0;
+	*peaks_discarded = 0;
+	struct timespec start = plc_time_get_hires_stamp();
+	uint32_t position;
+	for (position = 0; position < signal_count; position += CORRELATOR_SPAN_SAMPLES)
+	{
+		uint32_t span_count = signal_count - position;
+		if (span_count > CORRELATOR_SPAN_SAMPLES)
+			span_count = CORRELATOR_SPAN_SAMPLES;
+		uint32_t span_discarded;
+		peaks_count += plc_correlator_process(plc_correlator, signal + position, span_count,
+				peaks + peaks_count, CORRELATOR_PEAKS_MAX - peaks_count, &span_discarded);
+		*peaks_discarded += span_discarded;
+	}
+	*elapsed_us = bench_get_elapsed_us(start);
+	plc_correlator_release(plc_correlator);
+	// Only the peaks within the signal are reported for sure by both methods
+	while ((peaks_count > 0) && (peaks[peaks_count - 1].position >= CORRELATOR_SIGNAL_SAMPLES))
+		peaks_count--;
+	return peaks_count;
+}
+
+// Returns 1 if both lists of peaks are equivalent
+static int correlator_compare(const struct plc_correlator_peak *peaks_a, uint32_t peaks_a_count,
+		const struct plc_correlator_peak *peaks_b, uint32_t peaks_b_count)
+{
+	uint32_t a = 0, b = 0;
+	while ((a < peaks_a_count) || (b < peaks_b_count))
+	{
+		if ((a < peaks_a_count) && (b < peaks_b_count)
+				&& (peaks_a[a].position == peaks_b[b].position))
+		{
+			if (fabsf(peaks_a[a].score - peaks_b[b].score) > CORRELATOR_SCORE_TOLERANCE)
+				return 0;
+			a++;
+			b++;
+		}
+		else if ((b == peaks_b_count)
+				|| ((a < peaks_a_count) && (peaks_a[a].position < peaks_b[b].position)))
+		{
+			if (peaks_a[a++].score >= CORRELATOR_THRESHOLD + CORRELATOR_SCORE_TOLERANCE)
+				return 0;
+		}
+		else if (peaks_b[b++].score >= CORRELATOR_THRESHOLD + CORRELATOR_SCORE_TOLERANCE)
+			return 0;
+	}
+	return 1;
+}
+
+// Returns the number of occurrences of the template found in 'peaks'
+static uint32_t correlator_count_found(const struct plc_correlator_peak *peaks,
+		uint32_t peaks_count, uint32_t template_count)
+{
+	uint32_t found = 0;
+	uint32_t n;
+	for (n = 0; n < peaks_count; n++)
+		if ((peaks[n].position % CORRELATOR_OCCURRENCE_INTERVAL == 0)
+				&& (peaks[n].position + template_count <= CORRELATOR_SIGNAL_SAMPLES))
+			found++;
+	return found;
+}
+
+int bench_correlator(void)
+{
+	const uint32_t signal_count = CORRELATOR_SIGNAL_SAMPLES + CORRELATOR_TAIL_SAMPLES;
+	float *signal = malloc(signal_count * sizeof(float));
+	struct plc_correlator_peak *peaks_direct = malloc(
+			CORRELATOR_PEAKS_MAX * sizeof(struct plc_correlator_peak));
+	struct plc_correlator_peak *peaks_fft = malloc(
+			CORRELATOR_PEAKS_MAX * sizeof(struct plc_correlator_peak));
+	int ret = 0;
+	uint32_t n;
+	for (n = 0; n < ARRAY_SIZE(template_counts); n++)
+	{
+		uint32_t template_count = template_counts[n];
+		uint32_t noise_state = template_count;
+		float *template_samples = malloc(template_count * sizeof(float));
+		uint32_t k;
+		for (k = 0; k < template_count; k++)
+			template_samples[k] = (correlator_noise(&noise_state) >= 0.0f) ? 1.0f : -1.0f;
+		for (k = 0; k < signal_count; k++)
+			signal[k] = CORRELATOR_NOISE_AMPLITUDE * correlator_noise(&noise_state);
+		uint32_t occurrences = 0;
+		uint32_t position;
+		for (position = 0; position + template_count <= CORRELATOR_SIGNAL_SAMPLES;
+				position += CORRELATOR_OCCURRENCE_INTERVAL, occurrences++)
+			for (k = 0; k < template_count; k++)
+				signal[position + k] += template_samples[k];
+		double direct_us, fft_us;
+		uint32_t direct_discarded, fft_discarded;
+		uint32_t peaks_direct_count = correlator_run(template_samples, template_count,
+				plc_correlator_method_direct, signal, signal_count, peaks_direct, &direct_us,
+				&direct_discarded);
+		uint32_t peaks_fft_count = correlator_run(template_samples, template_count,
+				plc_correlator_method_fft, signal, signal_count, peaks_fft, &fft_us,
+				&fft_discarded);
+		struct plc_correlator *plc_correlator_auto = plc_correlator_create(template_samples,
+				template_count, CORRELATOR_THRESHOLD, plc_correlator_method_auto);
+		enum plc_correlator_method_enum method_auto = plc_correlator_get_method(
+				plc_correlator_auto);
+		plc_correlator_release(plc_correlator_auto);
+		uint32_t found = correlator_count_found(peaks_direct, peaks_direct_count, template_count);
+		int passed = (direct_discarded == 0) && (fft_discarded == 0) && (found == occurrences)
+				&& correlator_compare(peaks_direct, peaks_direct_count, peaks_fft, peaks_fft_count);
+		ret |= bench_check(passed, "Template %4u: %u/%u occurrences, %u/%u peaks direct/fft. "
+				"direct %7.2f ns/sample, fft %7.2f ns/sample, auto '%s'", template_count, found,
+				occurrences, peaks_direct_count, peaks_fft_count, direct_us * 1000.0 / signal_count,
+				fft_us * 1000.0 / signal_count, method_text[method_auto]);
+		free(template_samples);
+	}
+	// The peaks not fitting in the output buffer must be reported as discarded
+	struct plc_correlator *plc_correlator = plc_correlator_create(signal, template_counts[0],
+			CORRELATOR_THRESHOLD, plc_correlator_method_direct);
+	uint32_t peaks_discarded;
+	uint32_t peaks_count = plc_correlator_process(plc_correlator, signal, signal_count,
+			peaks_direct, CORRELATOR_PEAKS_MAX, &peaks_discarded);
+	plc_correlator_reset(plc_correlator);
+	const uint32_t peaks_max_small = 2;
+	uint32_t peaks_discarded_small;
+	uint32_t peaks_count_small = plc_correlator_process(plc_correlator, signal, signal_count,
+			peaks_fft, peaks_max_small, &peaks_discarded_small);
+	plc_correlator_release(plc_correlator);
+	ret |= bench_check((peaks_discarded == 0) && (peaks_count > peaks_max_small)
+			&& (peaks_count_small == peaks_max_small)
+			&& (peaks_count_small + peaks_discarded_small == peaks_count),
+			"Output of %u peaks: %u stored, %u discarded out of %u", peaks_max_small,
+			peaks_count_small, peaks_discarded_small, peaks_count);
+	free(peaks_fft);
+	free(peaks_direct);
+	free(signal);
+	return ret;
+}
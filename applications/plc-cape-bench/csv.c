@@ -0,0 +1,187 @@
+/**
+ * @file
+ * @brief	Buffered CSV writer of _libplc-tools_ against the 'printf' and write-per-line one
+ * @details
+ *	Each kind of CSV file is written by 'plc_file_write_csv' (or its variants) and by a reference
+ *	writer formatting every line with 'sprintf' and issuing a 'write' per line, as the library did
+ *	before. Both files must be byte-identical. The floats include special values, rounding ties and
+ *	values beyond 2^32. The write syscalls are counted from '/proc/self/io' when available
+ *
+ * @cond COPYRIGHT_NOTES @copyright
+ *	Copyright (C) 2017 Jose Maria Ortega\n
+ *	Distributed under the GNU GPLv3. For full terms see the file LICENSE
+ * @endcond
+ */
+
+#include <errno.h>
+#include <fcntl.h>		// open
+#include <inttypes.h>	// SCNu64
+#include <math.h>		// ldexpf
+#include <unistd.h>		// write
+#include "+common/api/+base.h"
+#include "libraries/libplc-tools/api/file.h"
+#include "libraries/libplc-tools/api/time.h"
+#include "bench.h"
+
+#define CSV_LINES 1000000
+#define CSV_LINE_MAX 128
+#define CSV_SAMPLE_TO_UNIT_X 1e-5f
+#define CSV_SAMPLE_TO_UNIT_Y (3.3f / 4096)
+
+enum csv_case_enum
+{
+	csv_case_u16 = 0,
+	csv_case_float,
+	csv_case_units,
+	csv_case_COUNT
+};
+
+static const char *csv_case_text[csv_case_COUNT] = {
+	"u16", "float", "units" };
+
+static const float csv_special_floats[] = {
+	0.0f, -0.0f, NAN, -NAN, INFINITY, -INFINITY, 0.5e-6f, 1.5e-6f, 2.5e-6f, 7.5e-6f,
+	4294967296.0f, 4294967295.0f, 1e38f, -3.4e38f, 1e-45f, 123456.789f };
+
+// Deterministic random bits
+static uint32_t csv_random(uint32_t *state)
+{
+	*state = *state * 1664525 + 1013904223;
+	return *state;
+}
+
+// Number of 'write' syscalls of the process. 0 if not available
+static uint64_t csv_get_write_syscalls(void)
+{
+	uint64_t syscw = 0;
+	FILE *file = fopen("/proc/self/io", "r");
+	if (file == NULL)
+		return 0;
+	char line[64];
+	while (fgets(line, sizeof(line), file) != NULL)
+		if (sscanf(line, "syscw: %" SCNu64, &syscw) == 1)
+			break;
+	fclose(file);
+	return syscw;
+}
+
+// The previous writer: one 'sprintf' and one 'write' per line
+static int csv_write_reference(const char *filename, enum csv_case_enum csv_case,
+		const uint16_t *samples, const float *values, uint32_t lines_count)
+{
+	int file = open(filename, O_CREAT | O_WRONLY | O_TRUNC, S_IRUSR | S_IWUSR);
+	if (file < 0)
+		return -1;
+	float x = 0.0f;
+	float y_offset = samples[0];
+	uint32_t n;
+	for (n = 0; n < lines_count; n++, x += CSV_SAMPLE_TO_UNIT_X)
+	{
+		char line[CSV_LINE_MAX];
+		int len;
+		if (csv_case == csv_case_u16)
+			len = sprintf(line, "%hu\n", samples[n]);
+		else if (csv_case == csv_case_float)
+			len = sprintf(line, "%f\n", values[n]);
+		else
+			len = sprintf(line, "%f %f\n", x, (samples[n] - y_offset) * CSV_SAMPLE_TO_UNIT_Y);
+		if (write(file, line, len) != len)
+		{
+			close(file);
+			return -1;
+		}
+	}
+	return close(file);
+}
+
+static int csv_write_library(const char *filename, enum csv_case_enum csv_case,
+		uint16_t *samples, float *values, uint32_t lines_count)
+{
+	if (csv_case == csv_case_u16)
+		return plc_file_write_csv(filename, csv_u16, samples, lines_count, 0);
+	if (csv_case == csv_case_float)
+		return plc_file_write_csv(filename, csv_float, values, lines_count, 0);
+	return plc_file_write_csv_units(filename, csv_u16, samples, lines_count,
+			CSV_SAMPLE_TO_UNIT_X, samples, CSV_SAMPLE_TO_UNIT_Y, 0);
+}
+
+// Returns the contents of a file (to be freed) and its size
+static char *csv_read_file(const char *filename, size_t *size)
+{
+	FILE *file = fopen(filename, "r");
+	if (file == NULL)
+		return NULL;
+	fseek(file, 0, SEEK_END);
+	*size = ftell(file);
+	rewind(file);
+	char *data = malloc(*size + 1);
+	if (fread(data, 1, *size, file) != *size)
+	{
+		free(data);
+		data = NULL;
+	}
+	fclose(file);
+	return data;
+}
+
+int bench_csv_writer(void)
+{
+	uint16_t *samples = malloc(CSV_LINES * sizeof(uint16_t));
+	float *values = malloc(CSV_LINES * sizeof(float));
+	uint32_t random_state = 1;
+	uint32_t n;
+	for (n = 0; n < CSV_LINES; n++)
+	{
+		samples[n] = csv_random(&random_state) & 0xFFF;
+		// Any sign and magnitude from 2^-30 to 2^40
+		float mantissa = (int32_t) csv_random(&random_state) / 2147483648.0f;
+		values[n] = ldexpf(mantissa, (int) (csv_random(&random_state) % 71) - 30);
+	}
+	memcpy(values, csv_special_floats, sizeof(csv_special_floats));
+	char filename_reference[] = "/tmp/plc-cape-bench-csv-XXXXXX";
+	char filename_library[] = "/tmp/plc-cape-bench-csv-XXXXXX";
+	int file_reference = mkstemp(filename_reference);
+	int file_library = mkstemp(filename_library);
+	if ((file_reference < 0) || (file_library < 0))
+	{
+		fprintf(stderr, "Unable to create the temporary files: %s\n", strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+	close(file_reference);
+	close(file_library);
+	int ret = 0;
+	enum csv_case_enum csv_case;
+	for (csv_case = 0; csv_case < csv_case_COUNT; csv_case++)
+	{
+		uint64_t syscw_start = csv_get_write_syscalls();
+		struct timespec start = plc_time_get_hires_stamp();
+		int reference_ret = csv_write_reference(filename_reference, csv_case, samples, values,
+				CSV_LINES);
+		double reference_us = bench_get_elapsed_us(start);
+		uint64_t reference_syscw = csv_get_write_syscalls() - syscw_start;
+		syscw_start = csv_get_write_syscalls();
+		start = plc_time_get_hires_stamp();
+		int library_ret = csv_write_library(filename_library, csv_case, samples, values,
+				CSV_LINES);
+		double library_us = bench_get_elapsed_us(start);
+		uint64_t library_syscw = csv_get_write_syscalls() - syscw_start;
+		size_t reference_size = 0, library_size = 0;
+		char *reference_data = csv_read_file(filename_reference, &reference_size);
+		char *library_data = csv_read_file(filename_library, &library_size);
+		int passed = (reference_ret == 0) && (library_ret == 0) && (reference_data != NULL)
+				&& (library_data != NULL) && (reference_size == library_size)
+				&& (memcmp(reference_data, library_data, reference_size) == 0);
+		double mb = library_size / (1024.0 * 1024.0);
+		ret |= bench_check(passed, "%-5s %u lines, %.1f MB: lines/s %.2fM -> %.2fM, "
+				"write() per MB %.1f -> %.1f", csv_case_text[csv_case], CSV_LINES, mb,
+				CSV_LINES / reference_us, CSV_LINES / library_us, reference_syscw / mb,
+				library_syscw / mb);
+		free(library_data);
+		free(reference_data);
+	}
+	unlink(filename_library);
+	unlink(filename_reference);
+	free(values);
+	free(samples);
+	return ret;
+}
@@ -0,0 +1,191 @@
+/**
+ * @file
+ * @brief	Decimation front-end of _plc_signal_iir_ and its effect on _decoder-ook_
+ * @details
+ *	The 'butter(2, 0.01)' stage of the decoders is run after the CIC and polyphase decimators
+ *	with the cut-off rescaled to the decimated rate, for several decimation factors. Reports the
+ *	time per input sample of the float and Q15 arithmetics. Then an _encoder-ook_ message is
+ *	decoded with decimation and without it (the previous full-rate path): the decoded data must
+ *	be identical with both decimators and both decoding modes. It is decoded as well through the
+ *	v1 interface ('parse_next_samples') with blocks that are not a multiple of the decimation,
+ *	which regroups them internally, and with room for only one data per call
+ *
+ * @cond COPYRIGHT_NOTES @copyright
+ *	Copyright (C) 2017 Jose Maria Ortega\n
+ *	Distributed under the GNU GPLv3. For full terms see the file LICENSE
+ * @endcond
+ */
+
+#include "+common/api/+base.h"
+#include "libraries/libplc-tools/api/plugin.h"
+#include "libraries/libplc-tools/api/signal.h"
+#include "libraries/libplc-tools/api/time.h"
+#include "bench.h"
+
+// Same chunks than the ADC buffers of plc-cape-lab
+#define DECIMATION_CHUNK_SAMPLES 2048
+#define DECIMATION_CHUNKS 500
+#define DECIMATION_OFFSET 2048
+#define DECIMATION_IIR_CUTOFF 0.01f
+// Loopback at the nominal rate of 'bench_ook_create_decoder'
+#define DECIMATION_LOOPBACK_SAMPLES 200000
+#define DECIMATION_LOOPBACK_SAMPLING_RATE_SPS 100000.0f
+#define DECIMATION_LOOPBACK_THRESHOLD 50
+#define DECIMATION_LOOPBACK_CHUNK_SAMPLES 1000
+#define DECIMATION_LOOPBACK_SPAN_SAMPLES 777
+#define DECIMATION_LOOPBACK_V1_BLOCK_SAMPLES 625
+#define DECIMATION_DATA_MAX 256
+
+static const uint32_t decimation_factors[] = {
+	1, 2, 4, 8, 16, 32 };
+
+static const uint32_t decimation_loopback_factors[] = {
+	4, 8 };
+
+static const char *arithmetic_text[plc_signal_arithmetic_COUNT] = {
+	"float", "q15", "q31" };
+static const char *decimator_text[plc_signal_decimator_COUNT] = {
+	"cic", "polyphase" };
+static const char *decode_mode_text[] = {
+	"threshold", "matched_filter" };
+
+// Time per input sample [ns] of the demodulation, decimation and IIR filtering
+static double decimation_time(const sample_rx_t *samples,
+		enum plc_signal_arithmetic_enum arithmetic, enum plc_signal_decimator_enum decimator,
+		uint32_t decimation)
+{
+	float iir_a[3], iir_b[3];
+	plc_signal_design_butterworth2(DECIMATION_IIR_CUTOFF * decimation, iir_a, iir_b);
+	struct plc_signal_iir *iir = plc_signal_iir_create(DECIMATION_CHUNK_SAMPLES, iir_a, 3, iir_b,
+			3);
+	plc_signal_iir_set_decimation(iir, decimator, decimation);
+	plc_signal_iir_set_arithmetic(iir, arithmetic, 1);
+	plc_signal_iir_set_demodulator(iir, plc_signal_iir_demodulator_abs);
+	struct timespec start = plc_time_get_hires_stamp();
+	uint32_t chunk;
+	for (chunk = 0; chunk < DECIMATION_CHUNKS; chunk++)
+		plc_signal_iir_process_chunk(iir, samples, DECIMATION_OFFSET);
+	double elapsed_us = bench_get_elapsed_us(start);
+	plc_signal_iir_release(iir);
+	return elapsed_us * 1000.0 / (DECIMATION_CHUNKS * DECIMATION_CHUNK_SAMPLES);
+}
+
+// Returns the number of data decoded into 'data'
+static uint32_t decimation_decode(struct decoder_api *decoder_api, const sample_rx_t *samples,
+		uint32_t decode_mode, enum plc_signal_decimator_enum decimator, uint32_t decimation,
+		uint8_t *data)
+{
+	decoder_api_h handle = bench_ook_create_decoder_decimated(decoder_api, decode_mode,
+			DECIMATION_LOOPBACK_THRESHOLD, 0, decimator, decimation);
+	decoder_api->initialize(handle, DECIMATION_LOOPBACK_CHUNK_SAMPLES);
+	uint32_t data_count = 0;
+	uint32_t position = 0;
+	while (position < DECIMATION_LOOPBACK_SAMPLES)
+	{
+		struct decoder_span span = {
+			samples + position, DECIMATION_LOOPBACK_SAMPLES - position };
+		if (span.samples_count > DECIMATION_LOOPBACK_SPAN_SAMPLES)
+			span.samples_count = DECIMATION_LOOPBACK_SPAN_SAMPLES;
+		uint32_t samples_consumed;
+		data_count += decoder_api->parse_spans(handle, &span, 1, data + data_count,
+				DECIMATION_DATA_MAX - data_count, &samples_consumed);
+		// Nothing consumed means the data buffer is full
+		if (samples_consumed == 0)
+			break;
+		position += samples_consumed;
+	}
+	decoder_api->terminate(handle);
+	decoder_api->release(handle);
+	return data_count;
+}
+
+// Same as 'decimation_decode' through the v1 interface, with one data of room but in the last call
+static uint32_t decimation_decode_v1(struct decoder_api *decoder_api, const sample_rx_t *samples,
+		uint32_t decode_mode, enum plc_signal_decimator_enum decimator, uint32_t decimation,
+		uint8_t *data)
+{
+	decoder_api_h handle = bench_ook_create_decoder_decimated(decoder_api, decode_mode,
+			DECIMATION_LOOPBACK_THRESHOLD, 0, decimator, decimation);
+	decoder_api->initialize(handle, DECIMATION_LOOPBACK_V1_BLOCK_SAMPLES);
+	uint32_t data_count = 0;
+	uint32_t position;
+	for (position = 0; position < DECIMATION_LOOPBACK_SAMPLES;
+			position += DECIMATION_LOOPBACK_V1_BLOCK_SAMPLES)
+	{
+		int last_block = (position + DECIMATION_LOOPBACK_V1_BLOCK_SAMPLES
+				>= DECIMATION_LOOPBACK_SAMPLES);
+		data_count += decoder_api->parse_next_samples(handle, samples + position,
+				data + data_count, last_block ? DECIMATION_DATA_MAX - data_count : 1);
+	}
+	decoder_api->terminate(handle);
+	decoder_api->release(handle);
+	return data_count;
+}
+
+int bench_decimation(void)
+{
+	sample_rx_t *samples = malloc(DECIMATION_CHUNK_SAMPLES * sizeof(sample_rx_t));
+	uint32_t seed = 12345;
+	uint32_t n;
+	for (n = 0; n < DECIMATION_CHUNK_SAMPLES; n++)
+	{
+		seed = seed * 1103515245 + 12345;
+		samples[n] = (seed >> 16) & 0xFFF;
+	}
+	enum plc_signal_arithmetic_enum arithmetic;
+	for (arithmetic = plc_signal_arithmetic_float; arithmetic <= plc_signal_arithmetic_q15;
+			arithmetic++)
+	{
+		enum plc_signal_decimator_enum decimator;
+		for (decimator = 0; decimator < plc_signal_decimator_COUNT; decimator++)
+		{
+			printf("  %-5s %-9s ns per input sample:", arithmetic_text[arithmetic],
+					decimator_text[decimator]);
+			for (n = 0; n < ARRAY_SIZE(decimation_factors); n++)
+				printf(" x%u %.2f", decimation_factors[n],
+						decimation_time(samples, arithmetic, decimator, decimation_factors[n]));
+			printf("\n");
+		}
+	}
+	free(samples);
+	struct plc_plugin *encoder_plugin, *decoder_plugin;
+	struct encoder_api *encoder_api = bench_load_plugin(plc_plugin_category_encoder,
+			"encoder-ook", &encoder_plugin);
+	struct decoder_api *decoder_api = bench_load_plugin(plc_plugin_category_decoder,
+			"decoder-ook", &decoder_plugin);
+	sample_tx_t *loopback_samples = bench_ook_encode(encoder_api,
+			DECIMATION_LOOPBACK_SAMPLING_RATE_SPS, DECIMATION_LOOPBACK_SAMPLES);
+	int ret = 0;
+	uint32_t decode_mode;
+	for (decode_mode = 0; decode_mode < ARRAY_SIZE(decode_mode_text); decode_mode++)
+	{
+		uint8_t data_reference[DECIMATION_DATA_MAX];
+		uint32_t data_reference_count = decimation_decode(decoder_api, loopback_samples,
+				decode_mode, plc_signal_decimator_cic, 1, data_reference);
+		enum plc_signal_decimator_enum decimator;
+		for (decimator = 0; decimator < plc_signal_decimator_COUNT; decimator++)
+			for (n = 0; n < ARRAY_SIZE(decimation_loopback_factors); n++)
+			{
+				uint8_t data[DECIMATION_DATA_MAX];
+				uint32_t data_count = decimation_decode(decoder_api, loopback_samples,
+						decode_mode, decimator, decimation_loopback_factors[n], data);
+				int passed = (data_reference_count > 0) && (data_count == data_reference_count)
+						&& (memcmp(data, data_reference, data_count) == 0);
+				ret |= bench_check(passed, "%-14s %-9s x%u: %u data decoded, %u without "
+						"decimation", decode_mode_text[decode_mode], decimator_text[decimator],
+						decimation_loopback_factors[n], data_count, data_reference_count);
+				data_count = decimation_decode_v1(decoder_api, loopback_samples, decode_mode,
+						decimator, decimation_loopback_factors[n], data);
+				passed = (data_count == data_reference_count)
+						&& (memcmp(data, data_reference, data_count) == 0);
+				ret |= bench_check(passed, "%-14s %-9s x%u v1 blocks of %u: %u data decoded",
+						decode_mode_text[decode_mode], decimator_text[decimator],
+						decimation_loopback_factors[n], DECIMATION_LOOPBACK_V1_BLOCK_SAMPLES,
+						data_count);
+			}
+	}
+	free(loopback_samples);
+	plc_plugin_unload(decoder_plugin);
+	plc_plugin_unload(encoder_plugin);
+	return ret;
+}
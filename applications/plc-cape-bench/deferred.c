@@ -0,0 +1,209 @@
+/**
+ * @file
+ * @brief	Deferred decoding in overlapping chunks against the serial one
+ * @details
+ *	Reproduces the splitting of the deferred demodulation of _plc-cape-lab_: the capture is cut
+ *	on ADC buffer boundaries and every chunk but the first one is decoded by a fresh decoder that
+ *	first parses, discarding its data, the overlap preceding the chunk. The decoder is told the
+ *	index of its first sample to demodulate with the carrier phase of the serial decoding. Only
+ *	the last chunk flushes the tail of the decoder, as the serial decoding. A last split is placed
+ *	on purpose in the middle of a frame, located by the position at which the serial decoding
+ *	completes each data
+ *
+ * @cond COPYRIGHT_NOTES @copyright
+ *	Copyright (C) 2017 Jose Maria Ortega\n
+ *	Distributed under the GNU GPLv3. For full terms see the file LICENSE
+ * @endcond
+ */
+
+#include <math.h>		// ceil
+#include "+common/api/+base.h"
+#include "libraries/libplc-tools/api/plugin.h"
+#include "plugins/decoder/api/decoder.h"
+#include "plugins/encoder/api/encoder.h"
+#include "bench.h"
+
+#define DEFERRED_SAMPLES 400000
+#define DEFERRED_RX_SAMPLING_RATE_SPS 100000.0f
+#define DEFERRED_BIT_WIDTH_US 1000
+// Same values than the ADC buffers and the default 'deferred_overlap_bits' of plc-cape-lab
+#define DEFERRED_BUFFER_SAMPLES 2048
+#define DEFERRED_OVERLAP_BITS 64
+// Granularity of the location of the frames: one bit
+#define DEFERRED_LOCATE_SAMPLES 100
+// A frame lasts at least 9 bits (start bit and 8 data bits)
+#define DEFERRED_FRAME_SAMPLES_MIN 900
+
+static const char *decode_mode_text[] = {
+	"threshold", "matched_filter" };
+
+struct deferred_case
+{
+	float tx_sampling_rate_sps;
+	uint32_t decode_mode;
+	uint16_t data_hi_threshold;
+};
+
+static const struct deferred_case deferred_cases[] = {
+	{
+		100000.0f, 0, 50 }, {
+		100000.0f, 1, 50 }, {
+		100000.0f, 1, 20 }, {
+		97000.0f, 1, 50 }, {
+		103000.0f, 1, 50 } };
+
+static const uint32_t chunks_counts[] = {
+	2, 3, 5, 8 };
+
+// Decodes 'samples_count' samples from 'first_sample' discarding the data of the first
+//	'overlap_samples', and the tail of the decoder if 'end_of_stream'. Returns the number of data
+//	stored into 'data'
+static uint32_t deferred_decode(struct decoder_api *decoder_api,
+		const struct deferred_case *deferred_case, const sample_rx_t *samples,
+		uint32_t first_sample, uint32_t overlap_samples, uint32_t samples_count,
+		int end_of_stream, uint8_t *data, uint32_t data_capacity)
+{
+	decoder_api_h handle = bench_ook_create_decoder(decoder_api, deferred_case->decode_mode,
+			deferred_case->data_hi_threshold, first_sample);
+	decoder_api->initialize(handle, DEFERRED_BUFFER_SAMPLES);
+	struct decoder_span overlap_span = {
+		samples + first_sample, overlap_samples };
+	struct decoder_span span = {
+		overlap_span.samples + overlap_samples, samples_count - overlap_samples };
+	uint32_t samples_consumed;
+	if (overlap_span.samples_count > 0)
+	{
+		decoder_api->parse_spans(handle, &overlap_span, 1, data, data_capacity, &samples_consumed);
+		assert(samples_consumed == overlap_span.samples_count);
+	}
+	uint32_t data_count = decoder_api->parse_spans(handle, &span, 1, data, data_capacity,
+			&samples_consumed);
+	assert(samples_consumed == span.samples_count);
+	while (end_of_stream)
+	{
+		uint32_t data_flushed = decoder_api->parse_spans(handle, NULL, 0, data + data_count,
+				data_capacity - data_count, &samples_consumed);
+		data_count += data_flushed;
+		if ((data_flushed == 0) && (samples_consumed == 0))
+			break;
+	}
+	decoder_api->terminate(handle);
+	decoder_api->release(handle);
+	return data_count;
+}
+
+// Returns the middle of the first frame after 'sample_min', located by the position at which the
+//	serial decoding completes its data
+static uint32_t deferred_find_frame_middle(struct decoder_api *decoder_api,
+		const struct deferred_case *deferred_case, const sample_rx_t *samples, uint32_t sample_min)
+{
+	decoder_api_h handle = bench_ook_create_decoder(decoder_api, deferred_case->decode_mode,
+			deferred_case->data_hi_threshold, 0);
+	decoder_api->initialize(handle, DEFERRED_LOCATE_SAMPLES);
+	uint32_t frame_middle = 0;
+	uint32_t position;
+	for (position = 0; position + DEFERRED_LOCATE_SAMPLES <= DEFERRED_SAMPLES;
+			position += DEFERRED_LOCATE_SAMPLES)
+	{
+		struct decoder_span span = {
+			samples + position, DEFERRED_LOCATE_SAMPLES };
+		uint8_t data[DEFERRED_LOCATE_SAMPLES];
+		uint32_t samples_consumed;
+		uint32_t data_count = decoder_api->parse_spans(handle, &span, 1, data, sizeof(data),
+				&samples_consumed);
+		// The data is completed within the span, close to the end of its frame
+		if ((data_count > 0) && (position > sample_min + DEFERRED_FRAME_SAMPLES_MIN))
+		{
+			frame_middle = position + DEFERRED_LOCATE_SAMPLES / 2 - DEFERRED_FRAME_SAMPLES_MIN / 2;
+			break;
+		}
+	}
+	decoder_api->terminate(handle);
+	decoder_api->release(handle);
+	return frame_middle;
+}
+
+int bench_deferred_chunks(void)
+{
+	struct plc_plugin *encoder_plugin, *decoder_plugin;
+	struct encoder_api *encoder_api = bench_load_plugin(plc_plugin_category_encoder,
+			"encoder-ook", &encoder_plugin);
+	struct decoder_api *decoder_api = bench_load_plugin(plc_plugin_category_decoder,
+			"decoder-ook", &decoder_plugin);
+	const uint32_t buffers_count = DEFERRED_SAMPLES / DEFERRED_BUFFER_SAMPLES;
+	const uint32_t overlap_buffers_count = ceil(
+			DEFERRED_OVERLAP_BITS * (DEFERRED_BIT_WIDTH_US * DEFERRED_RX_SAMPLING_RATE_SPS / 1000000.0)
+					/ DEFERRED_BUFFER_SAMPLES);
+	// Far more than one datum per 8 samples can't be decoded
+	const uint32_t data_capacity = DEFERRED_SAMPLES / 8;
+	uint8_t *serial_data = malloc(data_capacity);
+	uint8_t *chunked_data = malloc(data_capacity);
+	int ret = 0;
+	uint32_t n;
+	for (n = 0; n < ARRAY_SIZE(deferred_cases); n++)
+	{
+		const struct deferred_case *deferred_case = &deferred_cases[n];
+		sample_tx_t *samples = bench_ook_encode(encoder_api, deferred_case->tx_sampling_rate_sps,
+				DEFERRED_SAMPLES);
+		uint32_t serial_data_count = deferred_decode(decoder_api, deferred_case, samples, 0, 0,
+				DEFERRED_SAMPLES, 1, serial_data, data_capacity);
+		uint32_t c;
+		for (c = 0; c < ARRAY_SIZE(chunks_counts); c++)
+		{
+			uint32_t chunks_count = chunks_counts[c];
+			uint32_t chunked_data_count = 0;
+			uint32_t k;
+			for (k = 0; k < chunks_count; k++)
+			{
+				uint32_t buffer_ini = buffers_count * k / chunks_count;
+				uint32_t buffer_end = buffers_count * (k + 1) / chunks_count;
+				uint32_t overlap = (k == 0) ? 0 : overlap_buffers_count;
+				// The last chunk takes the incomplete buffer
+				int end_of_stream = (k == chunks_count - 1);
+				uint32_t sample_end = end_of_stream ? DEFERRED_SAMPLES
+						: buffer_end * DEFERRED_BUFFER_SAMPLES;
+				chunked_data_count += deferred_decode(decoder_api, deferred_case, samples,
+						(buffer_ini - overlap) * DEFERRED_BUFFER_SAMPLES,
+						overlap * DEFERRED_BUFFER_SAMPLES,
+						sample_end - (buffer_ini - overlap) * DEFERRED_BUFFER_SAMPLES,
+						end_of_stream, chunked_data + chunked_data_count,
+						data_capacity - chunked_data_count);
+			}
+			int passed = (chunked_data_count == serial_data_count)
+					&& (memcmp(chunked_data, serial_data, serial_data_count) == 0)
+					&& (serial_data_count > 0);
+			ret |= bench_check(passed, "TX %.0f sps, %s, threshold %u, %u chunks: %u data serially, "
+					"%u in chunks", deferred_case->tx_sampling_rate_sps,
+					decode_mode_text[deferred_case->decode_mode], deferred_case->data_hi_threshold,
+					chunks_count, serial_data_count, chunked_data_count);
+		}
+		// Two chunks split in the middle of a frame: the capture starts where that frame is
+		//	crossed by the buffer boundary following the overlap
+		uint32_t split_sample = (overlap_buffers_count + 1) * DEFERRED_BUFFER_SAMPLES;
+		uint32_t capture_start = deferred_find_frame_middle(decoder_api, deferred_case, samples,
+				split_sample) - split_sample;
+		uint32_t capture_samples = DEFERRED_SAMPLES - capture_start;
+		serial_data_count = deferred_decode(decoder_api, deferred_case, samples, capture_start, 0,
+				capture_samples, 1, serial_data, data_capacity);
+		uint32_t chunked_data_count = deferred_decode(decoder_api, deferred_case, samples,
+				capture_start, 0, split_sample, 0, chunked_data, data_capacity);
+		chunked_data_count += deferred_decode(decoder_api, deferred_case, samples,
+				capture_start + DEFERRED_BUFFER_SAMPLES,
+				overlap_buffers_count * DEFERRED_BUFFER_SAMPLES,
+				capture_samples - DEFERRED_BUFFER_SAMPLES, 1, chunked_data + chunked_data_count,
+				data_capacity - chunked_data_count);
+		int passed = (chunked_data_count == serial_data_count)
+				&& (memcmp(chunked_data, serial_data, serial_data_count) == 0)
+				&& (serial_data_count > 0);
+		ret |= bench_check(passed, "TX %.0f sps, %s, threshold %u, split across a frame: %u data "
+				"serially, %u in chunks", deferred_case->tx_sampling_rate_sps,
+				decode_mode_text[deferred_case->decode_mode], deferred_case->data_hi_threshold,
+				serial_data_count, chunked_data_count);
+		free(samples);
+	}
+	free(chunked_data);
+	free(serial_data);
+	plc_plugin_unload(decoder_plugin);
+	plc_plugin_unload(encoder_plugin);
+	return ret;
+}
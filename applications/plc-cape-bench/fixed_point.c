@@ -0,0 +1,376 @@
+/**
+ * @file
+ * @brief	Bit-exact check of the fixed-point (Q15/Q31) filtering chain of _libplc-tools_
+ * @details
+ *	The reference model processes the whole signal at once and implements each stage in its most
+ *	direct form: the CIC decimator as a convolution with the cubed boxcar divided by R^3, the
+ *	polyphase decimator as a full-rate FIR kept every R samples and the IIR filter as the plain
+ *	difference equation. The library processes the same signal in chunks with its recursive and
+ *	polyphase structures. Both must give the same integers. The Q31 chain must also match the
+ *	'float' one, up to the rounding of the integer output, with the demodulators without NCO
+ *
+ * @cond COPYRIGHT_NOTES @copyright
+ *	Copyright (C) 2017 Jose Maria Ortega\n
+ *	Distributed under the GNU GPLv3. For full terms see the file LICENSE
+ * @endcond
+ */
+
+#include <math.h>
+#include "+common/api/+base.h"
+#include "libraries/libplc-tools/api/signal.h"
+#include "bench.h"
+
+// Same formats than the library (they define the expected integers, not the implementation)
+#define FIXED_GUARD_BITS 16
+#define FIXED_COS_TABLE_BITS 10
+#define FIXED_COS_TABLE_SIZE (1 << FIXED_COS_TABLE_BITS)
+#define FIXED_PHASE_QUARTER 0x40000000u
+#define CIC_STAGES 3
+#define POLYPHASE_TAPS_PER_PHASE 8
+#define POLYPHASE_TAPS_FRAC_BITS 15
+
+#define FIXED_CHUNK_SAMPLES 240
+#define FIXED_CHUNKS 40
+#define FIXED_SAMPLES (FIXED_CHUNK_SAMPLES * FIXED_CHUNKS)
+#define FIXED_OFFSET 2048
+#define FIXED_DEMODULATION_FREQUENCY 0.0371f
+// Rounding of the integer output plus the error of the 'float' filter
+#define FIXED_FLOAT_TOLERANCE 1.0f
+
+struct fixed_filter
+{
+	const char *name;
+	float a[3];
+	uint32_t a_count;
+	float b[3];
+	uint32_t b_count;
+};
+
+// The gains expose the fractional bits of the decimators on the integer output and overflow the
+// 32-bit state (saturation vs. wrap-around)
+static const struct fixed_filter fixed_filters[] = {
+	{
+		"butter(2,0.01)", {
+			1.00000f, -1.95558f, 0.95654f }, 3, {
+			2.4136e-04f, 4.8272e-04f, 2.4136e-04f }, 3 }, {
+		"butter(2,0.2)", {
+			1.00000f, -1.14298f, 0.41280f }, 3, {
+			0.067455f, 0.134911f, 0.067455f }, 3 }, {
+		"gain 256", {
+			1.0f }, 1, {
+			256.0f }, 1 }, {
+		"gain 3000", {
+			1.0f }, 1, {
+			3000.0f }, 1 } };
+
+struct fixed_decimator
+{
+	enum plc_signal_decimator_enum decimator;
+	uint32_t decimation;
+};
+
+static const struct fixed_decimator fixed_decimators[] = {
+	{
+		plc_signal_decimator_cic, 1 }, {
+		plc_signal_decimator_cic, 2 }, {
+		plc_signal_decimator_cic, 4 }, {
+		plc_signal_decimator_cic, 8 }, {
+		plc_signal_decimator_polyphase, 2 }, {
+		plc_signal_decimator_polyphase, 4 } };
+
+static const char *arithmetic_text[plc_signal_arithmetic_COUNT] = {
+	"float", "q15", "q31" };
+static const char *decimator_text[plc_signal_decimator_COUNT] = {
+	"cic", "polyphase" };
+
+static int32_t reference_narrow(int64_t value, int saturation)
+{
+	if (saturation)
+		return (value > INT32_MAX) ? INT32_MAX : (value < INT32_MIN) ? INT32_MIN : (int32_t) value;
+	return (int32_t) (uint32_t) (uint64_t) value;
+}
+
+static void reference_demodulate(const sample_rx_t *in,
+		enum plc_signal_iir_demodulator_enum demodulator, int32_t *demod)
+{
+	uint32_t nco_step = (uint32_t) (int64_t) llround(FIXED_DEMODULATION_FREQUENCY * 4294967296.0);
+	uint32_t n;
+	for (n = 0; n < FIXED_SAMPLES; n++)
+	{
+		int32_t sample = (int32_t) in[n] - FIXED_OFFSET;
+		switch (demodulator)
+		{
+		case plc_signal_iir_demodulator_none:
+			demod[n] = sample * (1 << FIXED_GUARD_BITS);
+			break;
+		case plc_signal_iir_demodulator_abs:
+			demod[n] = abs(sample) * (1 << FIXED_GUARD_BITS);
+			break;
+		case plc_signal_iir_demodulator_cos:
+		{
+			// sin carrier: cos shifted a quarter of turn
+			uint32_t phase = n * nco_step - FIXED_PHASE_QUARTER;
+			uint32_t index = phase >> (32 - FIXED_COS_TABLE_BITS);
+			int32_t cos_q15 = (int32_t) round(
+					cos(2.0 * M_PI * index / FIXED_COS_TABLE_SIZE) * INT16_MAX);
+			demod[n] = sample * cos_q15 * (1 << (FIXED_GUARD_BITS - 15));
+			break;
+		}
+		}
+	}
+}
+
+// Returns the decimated samples count
+static uint32_t reference_decimate(const int32_t *demod, const struct fixed_decimator *decimator,
+		int saturation, int32_t *out)
+{
+	uint32_t decimation = decimator->decimation;
+	uint32_t out_count = FIXED_SAMPLES / decimation;
+	uint32_t n, m, k;
+	if (decimation == 1)
+	{
+		memcpy(out, demod, FIXED_SAMPLES * sizeof(int32_t));
+		return out_count;
+	}
+	if (decimator->decimator == plc_signal_decimator_cic)
+	{
+		// Impulse response of CIC_STAGES cascaded boxcars of 'decimation' samples
+		uint32_t h_count = CIC_STAGES * (decimation - 1) + 1;
+		int64_t *h = calloc(h_count, sizeof(int64_t));
+		int64_t *h_tmp = calloc(h_count, sizeof(int64_t));
+		uint32_t h_len = 1, stage;
+		h[0] = 1;
+		for (stage = 0; stage < CIC_STAGES; stage++)
+		{
+			memset(h_tmp, 0, h_count * sizeof(int64_t));
+			for (n = 0; n < h_len; n++)
+				for (k = 0; k < decimation; k++)
+					h_tmp[n + k] += h[n];
+			h_len += decimation - 1;
+			memcpy(h, h_tmp, h_count * sizeof(int64_t));
+		}
+		int64_t gain = (int64_t) decimation * decimation * decimation;
+		int64_t cic[3] = {
+			0, 0, 0 };
+		for (m = 0; m < out_count; m++)
+		{
+			int64_t acc = 0;
+			int64_t last = (int64_t) (m + 1) * decimation - 1;
+			for (k = 0; (k < h_count) && (last - k >= 0); k++)
+				acc += h[k] * demod[last - k];
+			cic[2] = cic[1];
+			cic[1] = cic[0];
+			cic[0] = acc / gain;
+			// Droop compensator [-1, 10, -1] / 8 (one decimated sample of delay)
+			out[m] = reference_narrow((10 * cic[1] - cic[0] - cic[2]) / 8, saturation);
+		}
+		free(h_tmp);
+		free(h);
+		return out_count;
+	}
+	// Hamming-windowed sinc with the cut-off at the output Nyquist frequency, normalized to unity
+	// gain. Intermediate 'float' values as in the design of the library
+	uint32_t taps_count = POLYPHASE_TAPS_PER_PHASE * decimation + 1;
+	float *taps = malloc(taps_count * sizeof(float));
+	int32_t *taps_q = malloc(taps_count * sizeof(int32_t));
+	double cutoff = 0.5 / decimation;
+	double taps_sum = 0.0;
+	for (k = 0; k < taps_count; k++)
+	{
+		double t = (double) k - (taps_count - 1) / 2.0;
+		double sinc = (t == 0.0) ? 1.0 : sin(2.0 * M_PI * cutoff * t) / (2.0 * M_PI * cutoff * t);
+		taps[k] = sinc * (0.54 - 0.46 * cos(2.0 * M_PI * k / (taps_count - 1)));
+		taps_sum += taps[k];
+	}
+	for (k = 0; k < taps_count; k++)
+	{
+		taps[k] /= taps_sum;
+		taps_q[k] = (int32_t) lrint(taps[k] * (1 << POLYPHASE_TAPS_FRAC_BITS));
+	}
+	for (m = 0; m < out_count; m++)
+	{
+		int64_t last = (int64_t) (m + 1) * decimation - 1;
+		int64_t acc = 0;
+		for (k = 0; (k < taps_count) && (last - k >= 0); k++)
+			acc += (int64_t) taps_q[k] * demod[last - k];
+		out[m] = reference_narrow(
+				(acc + (1ll << (POLYPHASE_TAPS_FRAC_BITS - 1))) >> POLYPHASE_TAPS_FRAC_BITS,
+				saturation);
+	}
+	free(taps_q);
+	free(taps);
+	return out_count;
+}
+
+static void reference_filter(const int32_t *in, uint32_t count, const struct fixed_filter *filter,
+		enum plc_signal_arithmetic_enum arithmetic, int saturation, int32_t *out_integer)
+{
+	// Binary point fitting the greatest coefficient normalized by 'a[0]' on 16 or 32 bits
+	float a0 = filter->a[0];
+	float coef_abs_max = 0.0f;
+	uint32_t n, k;
+	for (k = 0; k < filter->a_count; k++)
+		coef_abs_max = fmaxf(coef_abs_max, fabsf(filter->a[k] / a0));
+	for (k = 0; k < filter->b_count; k++)
+		coef_abs_max = fmaxf(coef_abs_max, fabsf(filter->b[k] / a0));
+	uint32_t integer_bits = 0;
+	while ((1u << integer_bits) <= coef_abs_max)
+		integer_bits++;
+	uint32_t frac_bits = ((arithmetic == plc_signal_arithmetic_q15) ? 15 : 31) - integer_bits;
+	double coef_max = (arithmetic == plc_signal_arithmetic_q15) ? INT16_MAX : INT32_MAX;
+	int64_t a_q[3], b_q[3];
+	for (k = 0; k < filter->a_count; k++)
+		a_q[k] = fmin(fmax(round((double) filter->a[k] / a0 * (1ull << frac_bits)),
+				-coef_max - 1), coef_max);
+	for (k = 0; k < filter->b_count; k++)
+		b_q[k] = fmin(fmax(round((double) filter->b[k] / a0 * (1ull << frac_bits)),
+				-coef_max - 1), coef_max);
+	int32_t *out = malloc(count * sizeof(int32_t));
+	for (n = 0; n < count; n++)
+	{
+		int64_t acc = 1ll << (frac_bits - 1);
+		for (k = 0; (k < filter->b_count) && (k <= n); k++)
+			acc += b_q[k] * in[n - k];
+		for (k = 1; (k < filter->a_count) && (k <= n); k++)
+			acc -= a_q[k] * out[n - k];
+		out[n] = reference_narrow(acc >> frac_bits, saturation);
+		out_integer[n] = (int32_t) (((int64_t) out[n] + (1 << (FIXED_GUARD_BITS - 1)))
+				>> FIXED_GUARD_BITS);
+	}
+	free(out);
+}
+
+// Returns the number of mismatching output samples
+static uint32_t fixed_compare(const sample_rx_t *in, enum plc_signal_arithmetic_enum arithmetic,
+		int saturation, enum plc_signal_iir_demodulator_enum demodulator,
+		const struct fixed_decimator *decimator, const struct fixed_filter *filter,
+		int32_t *demod, int32_t *decimated, int32_t *expected)
+{
+	reference_demodulate(in, demodulator, demod);
+	uint32_t out_count = reference_decimate(demod, decimator, saturation, decimated);
+	reference_filter(decimated, out_count, filter, arithmetic, saturation, expected);
+	struct plc_signal_iir *iir = plc_signal_iir_create(FIXED_CHUNK_SAMPLES, filter->a,
+			filter->a_count, filter->b, filter->b_count);
+	plc_signal_iir_set_decimation(iir, decimator->decimator, decimator->decimation);
+	plc_signal_iir_set_arithmetic(iir, arithmetic, saturation);
+	plc_signal_iir_set_demodulator(iir, demodulator);
+	plc_signal_iir_set_demodulation_frequency(iir, FIXED_DEMODULATION_FREQUENCY);
+	uint32_t chunk_out_samples = plc_signal_get_buffer_out_count(iir);
+	uint32_t mismatches = 0;
+	uint32_t chunk, n;
+	for (chunk = 0; chunk < FIXED_CHUNKS; chunk++)
+	{
+		plc_signal_iir_process_chunk(iir, in + chunk * FIXED_CHUNK_SAMPLES, FIXED_OFFSET);
+		const int32_t *out = plc_signal_get_buffer_out_fixed(iir);
+		for (n = 0; n < chunk_out_samples; n++)
+			if (out[n] != expected[chunk * chunk_out_samples + n])
+				mismatches++;
+	}
+	plc_signal_iir_release(iir);
+	return mismatches;
+}
+
+// Returns the max difference between the Q31 and the 'float' outputs of the same filter
+static float fixed_compare_float(const sample_rx_t *in,
+		enum plc_signal_iir_demodulator_enum demodulator, const struct fixed_filter *filter)
+{
+	struct plc_signal_iir *iirs[2];
+	uint32_t k;
+	for (k = 0; k < 2; k++)
+	{
+		iirs[k] = plc_signal_iir_create(FIXED_CHUNK_SAMPLES, filter->a, filter->a_count,
+				filter->b, filter->b_count);
+		plc_signal_iir_set_arithmetic(iirs[k],
+				(k == 0) ? plc_signal_arithmetic_float : plc_signal_arithmetic_q31, 1);
+		plc_signal_iir_set_demodulator(iirs[k], demodulator);
+	}
+	uint32_t chunk_out_samples = plc_signal_get_buffer_out_count(iirs[0]);
+	float diff_max = 0.0f;
+	uint32_t chunk, n;
+	for (chunk = 0; chunk < FIXED_CHUNKS; chunk++)
+	{
+		for (k = 0; k < 2; k++)
+			plc_signal_iir_process_chunk(iirs[k], in + chunk * FIXED_CHUNK_SAMPLES, FIXED_OFFSET);
+		const float *out_float = plc_signal_get_buffer_out(iirs[0]);
+		const int32_t *out_fixed = plc_signal_get_buffer_out_fixed(iirs[1]);
+		for (n = 0; n < chunk_out_samples; n++)
+			diff_max = fmaxf(diff_max, fabsf(out_float[n] - out_fixed[n]));
+	}
+	plc_signal_iir_release(iirs[1]);
+	plc_signal_iir_release(iirs[0]);
+	return diff_max;
+}
+
+int bench_fixed_point(void)
+{
+	// 12-bit full-scale tone plus pseudo-random noise
+	sample_rx_t *in = malloc(FIXED_SAMPLES * sizeof(sample_rx_t));
+	uint32_t seed = 12345;
+	uint32_t n;
+	for (n = 0; n < FIXED_SAMPLES; n++)
+	{
+		seed = seed * 1103515245 + 12345;
+		int32_t noise = (int32_t) ((seed >> 16) & 0x1ff) - 256;
+		int32_t value = FIXED_OFFSET + noise + lrint(1700.0 * sin(2.0 * M_PI * 0.03 * n));
+		in[n] = (value < 0) ? 0 : (value > 4095) ? 4095 : value;
+	}
+	int32_t *demod = malloc(FIXED_SAMPLES * sizeof(int32_t));
+	int32_t *decimated = malloc(FIXED_SAMPLES * sizeof(int32_t));
+	int32_t *expected = malloc(FIXED_SAMPLES * sizeof(int32_t));
+	int ret = 0;
+	enum plc_signal_arithmetic_enum arithmetic;
+	for (arithmetic = plc_signal_arithmetic_q15; arithmetic <= plc_signal_arithmetic_q31;
+			arithmetic++)
+	{
+		int saturation;
+		for (saturation = 0; saturation <= 1; saturation++)
+		{
+			uint32_t d;
+			for (d = 0; d < ARRAY_SIZE(fixed_decimators); d++)
+			{
+				const struct fixed_decimator *decimator = &fixed_decimators[d];
+				// All the demodulators and filters for each decimator
+				uint32_t mismatches = 0;
+				uint32_t cases = 0;
+				enum plc_signal_iir_demodulator_enum demodulator;
+				for (demodulator = plc_signal_iir_demodulator_none;
+						demodulator <= plc_signal_iir_demodulator_cos; demodulator++)
+				{
+					uint32_t f;
+					for (f = 0; f < ARRAY_SIZE(fixed_filters); f++, cases++)
+					{
+						uint32_t case_mismatches = fixed_compare(in, arithmetic, saturation,
+								demodulator, decimator, &fixed_filters[f], demod, decimated,
+								expected);
+						if (case_mismatches > 0)
+							printf("    demodulator %u, %s: %u samples mismatching\n",
+									demodulator, fixed_filters[f].name, case_mismatches);
+						mismatches += case_mismatches;
+					}
+				}
+				ret |= bench_check(mismatches == 0,
+						"%s, %s, %s x%u: %u cases, %u samples mismatching",
+						arithmetic_text[arithmetic], saturation ? "saturated" : "wrapped",
+						decimator_text[decimator->decimator], decimator->decimation, cases,
+						mismatches);
+			}
+		}
+	}
+	enum plc_signal_iir_demodulator_enum demodulator;
+	for (demodulator = plc_signal_iir_demodulator_none;
+			demodulator <= plc_signal_iir_demodulator_abs; demodulator++)
+	{
+		// The last ones are gains overflowing the Q31 state
+		float diff_max = 0.0f;
+		uint32_t f;
+		for (f = 0; f < 2; f++)
+			diff_max = fmaxf(diff_max, fixed_compare_float(in, demodulator, &fixed_filters[f]));
+		ret |= bench_check(diff_max <= FIXED_FLOAT_TOLERANCE,
+				"q31 against float, demodulator %u: max difference %.3f", demodulator, diff_max);
+	}
+	free(expected);
+	free(decimated);
+	free(demod);
+	free(in);
+	return ret;
+}
@@ -0,0 +1,147 @@
+/**
+ * @file
+ * @brief	Logger of _plc-cape-lab_ under contention
+ * @details
+ *	1 to 'LOGGER_BENCH_THREADS_MAX' threads log formatted messages at the same time as fast as
+ *	they can, in synchronous mode (serialized by a mutex) and in asynchronous mode (a ring per
+ *	thread). Reports the time per call seen by the logging threads. Every message must be written
+ *	once or reported as dropped, in the order of its thread
+ *
+ * @cond COPYRIGHT_NOTES @copyright
+ *	Copyright (C) 2017 Jose Maria Ortega\n
+ *	Distributed under the GNU GPLv3. For full terms see the file LICENSE
+ * @endcond
+ */
+
+#include <pthread.h>
+#include "+common/api/+base.h"
+#include "applications/plc-cape-lab/logger.h"
+#include "libraries/libplc-tools/api/time.h"
+#include "bench.h"
+
+#define LOGGER_BENCH_THREADS_MAX 4
+#define LOGGER_BENCH_MESSAGES 100000
+// Default of the 'log_ring_kb' setting
+#define LOGGER_BENCH_RING_SIZE (64 * 1024)
+
+// Checks of the written messages. Updated by a single thread at a time (the logging ones under
+//	the logger mutex or the flushing one)
+struct logger_bench_output
+{
+	uint32_t next_message[LOGGER_BENCH_THREADS_MAX];
+	uint32_t messages_written;
+	uint32_t messages_dropped;
+	uint32_t disorders;
+};
+
+struct logger_bench_thread
+{
+	struct logger *logger;
+	pthread_barrier_t *barrier;
+	uint32_t index;
+	int64_t call_sum_ns;
+	int64_t call_max_ns;
+};
+
+static void logger_bench_log_text(void *data, const char *text)
+{
+	struct logger_bench_output *output = (struct logger_bench_output*) data;
+	uint32_t thread_index, message, messages_dropped;
+	if ((sscanf(text, "Thread %u message %u", &thread_index, &message) == 2)
+			&& (thread_index < LOGGER_BENCH_THREADS_MAX))
+	{
+		// Dropped messages leave gaps, but never go back
+		if (message < output->next_message[thread_index])
+			output->disorders++;
+		output->next_message[thread_index] = message + 1;
+		output->messages_written++;
+	}
+	else if (sscanf(text, "Logger: %u messages dropped", &messages_dropped) == 1)
+	{
+		output->messages_dropped += messages_dropped;
+	}
+	else
+	{
+		output->disorders++;
+	}
+}
+
+static void *logger_bench_thread(void *arg)
+{
+	struct logger_bench_thread *thread = (struct logger_bench_thread*) arg;
+	pthread_barrier_wait(thread->barrier);
+	uint32_t n;
+	for (n = 0; n < LOGGER_BENCH_MESSAGES; n++)
+	{
+		int64_t start_ns = plc_time_hires_stamp_to_nsec(plc_time_get_hires_stamp());
+		logger_log_sequence_format(thread->logger, "Thread %u message %u\n", thread->index, n);
+		int64_t call_ns = plc_time_hires_stamp_to_nsec(plc_time_get_hires_stamp()) - start_ns;
+		thread->call_sum_ns += call_ns;
+		if (call_ns > thread->call_max_ns)
+			thread->call_max_ns = call_ns;
+	}
+	return NULL;
+}
+
+// Returns 0 if all the messages have been properly written or reported as dropped
+static int logger_bench_run(int async, uint32_t threads_count)
+{
+	struct logger_bench_output output;
+	memset(&output, 0, sizeof(output));
+	struct logger *logger = logger_create_log_text(logger_bench_log_text, &output);
+	if (async && (logger_start_async(logger, LOGGER_BENCH_RING_SIZE, threads_count) < 0))
+	{
+		logger_release(logger);
+		return bench_check(0, "Asynchronous logger unavailable");
+	}
+	pthread_barrier_t barrier;
+	pthread_barrier_init(&barrier, NULL, threads_count + 1);
+	struct logger_bench_thread threads[LOGGER_BENCH_THREADS_MAX];
+	pthread_t thread_ids[LOGGER_BENCH_THREADS_MAX];
+	uint32_t n;
+	for (n = 0; n < threads_count; n++)
+	{
+		memset(&threads[n], 0, sizeof(threads[n]));
+		threads[n].logger = logger;
+		threads[n].barrier = &barrier;
+		threads[n].index = n;
+		int ret = pthread_create(&thread_ids[n], NULL, logger_bench_thread, &threads[n]);
+		assert(ret == 0);
+	}
+	pthread_barrier_wait(&barrier);
+	struct timespec start = plc_time_get_hires_stamp();
+	int64_t call_sum_ns = 0;
+	int64_t call_max_ns = 0;
+	for (n = 0; n < threads_count; n++)
+	{
+		pthread_join(thread_ids[n], NULL);
+		call_sum_ns += threads[n].call_sum_ns;
+		if (threads[n].call_max_ns > call_max_ns)
+			call_max_ns = threads[n].call_max_ns;
+	}
+	int64_t logging_ns = plc_time_hires_stamp_to_nsec(plc_time_get_hires_stamp())
+			- plc_time_hires_stamp_to_nsec(start);
+	// Writes the pending messages
+	logger_release(logger);
+	pthread_barrier_destroy(&barrier);
+	uint32_t messages_count = threads_count * LOGGER_BENCH_MESSAGES;
+	int passed = (output.messages_written + output.messages_dropped == messages_count)
+			&& (output.disorders == 0);
+	return bench_check(passed, "%-5s %u threads: %u written, %u dropped, %u disorders. ns per "
+			"call: mean %.0f, max %.0f. %.2f M messages/s", async ? "async" : "sync",
+			threads_count, output.messages_written, output.messages_dropped, output.disorders,
+			(double) call_sum_ns / messages_count, (double) call_max_ns,
+			1000.0 * messages_count / logging_ns);
+}
+
+int bench_logger_contention(void)
+{
+	int ret = 0;
+	uint32_t threads_count;
+	for (threads_count = 1; threads_count <= LOGGER_BENCH_THREADS_MAX; threads_count *= 2)
+	{
+		ret |= logger_bench_run(0, threads_count);
+		ret |= logger_bench_run(1, threads_count);
+	}
+	return ret;
+}
@@ -0,0 +1,190 @@
+/**
+ * @file
+ * @brief	Loopback of the OOK encoder into the OOK decoder
+ * @details
+ *	The encoder is configured with a sampling rate different from the one of the decoder to
+ *	emulate the clock mismatch between TX and RX. The decoded data must match the message
+ *
+ * @cond COPYRIGHT_NOTES @copyright
+ *	Copyright (C) 2017 Jose Maria Ortega\n
+ *	Distributed under the GNU GPLv3. For full terms see the file LICENSE
+ * @endcond
+ */
+
+#include "+common/api/+base.h"
+#include "+common/api/setting.h"
+#include "libraries/libplc-tools/api/plugin.h"
+#include "plugins/decoder/api/decoder.h"
+#include "plugins/encoder/api/encoder.h"
+#include "bench.h"
+
+#define LOOPBACK_MESSAGE "Hello world\n"
+#define LOOPBACK_MESSAGES_MIN 3
+#define LOOPBACK_SAMPLES 200000
+#define LOOPBACK_RX_SAMPLING_RATE_SPS 100000.0f
+#define LOOPBACK_CARRIER_FREQ_HZ 2000.0f
+#define LOOPBACK_BIT_WIDTH_US 1000
+// Irregular length of the spans pushed to exercise their regrouping into chunks
+#define LOOPBACK_SPAN_SAMPLES 777
+#define LOOPBACK_CHUNK_SAMPLES 1000
+#define LOOPBACK_DATA_MAX 256
+
+// Values of the 'decode_mode' setting of 'decoder-ook'
+static const char *decode_mode_text[] = {
+	"threshold", "matched_filter" };
+
+struct loopback_case
+{
+	float tx_sampling_rate_sps;
+	uint32_t decode_mode;
+	uint16_t data_hi_threshold;
+};
+
+// The threshold decoder has no clock recovery: only checked with the nominal rate. A threshold
+// far below the middle of the levels (the demodulated HI level is ~127) is the most sensitive to
+// the symbol timing
+static const struct loopback_case loopback_cases[] = {
+	{
+		100000.0f, 0, 50 }, {
+		100000.0f, 0, 20 }, {
+		100000.0f, 1, 50 }, {
+		100000.0f, 1, 20 }, {
+		97000.0f, 1, 50 }, {
+		97000.0f, 1, 20 }, {
+		103000.0f, 1, 50 }, {
+		103000.0f, 1, 20 }, {
+		94000.0f, 1, 50 }, {
+		106000.0f, 1, 50 } };
+
+static void loopback_set_setting(int ret, const char *identifier)
+{
+	if (ret != 0)
+	{
+		fprintf(stderr, "Setting '%s' rejected\n", identifier);
+		exit(EXIT_FAILURE);
+	}
+}
+
+sample_tx_t *bench_ook_encode(struct encoder_api *encoder_api, float sampling_rate_sps,
+		uint32_t samples_count)
+{
+	encoder_api_h handle = encoder_api->create();
+	union plc_setting_data data;
+	encoder_api->begin_settings(handle);
+	data.f = sampling_rate_sps;
+	loopback_set_setting(encoder_api->set_setting(handle, "sampling_rate_sps", data),
+			"sampling_rate_sps");
+	data.f = LOOPBACK_CARRIER_FREQ_HZ;
+	loopback_set_setting(encoder_api->set_setting(handle, "freq", data), "freq");
+	data.u32 = LOOPBACK_BIT_WIDTH_US;
+	loopback_set_setting(encoder_api->set_setting(handle, "bit_width_us", data), "bit_width_us");
+	data.s = LOOPBACK_MESSAGE;
+	loopback_set_setting(encoder_api->set_setting(handle, "message", data), "message");
+	loopback_set_setting(encoder_api->end_settings(handle), "end_settings");
+	encoder_api->reset(handle);
+	sample_tx_t *samples = malloc(samples_count * sizeof(sample_tx_t));
+	encoder_api->prepare_next_samples(handle, samples, samples_count);
+	encoder_api->release(handle);
+	return samples;
+}
+
+decoder_api_h bench_ook_create_decoder(struct decoder_api *decoder_api, uint32_t decode_mode,
+		uint16_t data_hi_threshold, uint32_t first_sample)
+{
+	return bench_ook_create_decoder_decimated(decoder_api, decode_mode, data_hi_threshold,
+			first_sample, plc_signal_decimator_cic, 1);
+}
+
+decoder_api_h bench_ook_create_decoder_decimated(struct decoder_api *decoder_api,
+		uint32_t decode_mode, uint16_t data_hi_threshold, uint32_t first_sample,
+		enum plc_signal_decimator_enum decimator, uint32_t decimation)
+{
+	decoder_api_h handle = decoder_api->create();
+	union plc_setting_data setting_data;
+	decoder_api->begin_settings(handle);
+	setting_data.f = LOOPBACK_RX_SAMPLING_RATE_SPS;
+	loopback_set_setting(decoder_api->set_setting(handle, "sampling_rate_sps", setting_data),
+			"sampling_rate_sps");
+	setting_data.f = LOOPBACK_CARRIER_FREQ_HZ;
+	loopback_set_setting(decoder_api->set_setting(handle, "freq", setting_data), "freq");
+	setting_data.u32 = LOOPBACK_BIT_WIDTH_US;
+	loopback_set_setting(decoder_api->set_setting(handle, "bit_width_us", setting_data),
+			"bit_width_us");
+	setting_data.u16 = data_hi_threshold;
+	loopback_set_setting(decoder_api->set_setting(handle, "data_hi_threshold", setting_data),
+			"data_hi_threshold");
+	setting_data.u32 = decode_mode;
+	loopback_set_setting(decoder_api->set_setting(handle, "decode_mode", setting_data),
+			"decode_mode");
+	setting_data.u32 = first_sample;
+	loopback_set_setting(decoder_api->set_setting(handle, "first_sample", setting_data),
+			"first_sample");
+	setting_data.u32 = decimator;
+	loopback_set_setting(decoder_api->set_setting(handle, "decimator", setting_data), "decimator");
+	setting_data.u32 = decimation;
+	loopback_set_setting(decoder_api->set_setting(handle, "decimation", setting_data),
+			"decimation");
+	loopback_set_setting(decoder_api->end_settings(handle), "end_settings");
+	return handle;
+}
+
+// Returns the number of data decoded into 'data'
+static uint32_t loopback_decode(struct decoder_api *decoder_api, const sample_rx_t *samples,
+		const struct loopback_case *loopback_case, uint8_t *data)
+{
+	decoder_api_h handle = bench_ook_create_decoder(decoder_api, loopback_case->decode_mode,
+			loopback_case->data_hi_threshold, 0);
+	decoder_api->initialize(handle, LOOPBACK_CHUNK_SAMPLES);
+	uint32_t data_count = 0;
+	uint32_t position = 0;
+	while (position < LOOPBACK_SAMPLES)
+	{
+		struct decoder_span span = {
+			samples + position, LOOPBACK_SAMPLES - position };
+		if (span.samples_count > LOOPBACK_SPAN_SAMPLES)
+			span.samples_count = LOOPBACK_SPAN_SAMPLES;
+		uint32_t samples_consumed;
+		data_count += decoder_api->parse_spans(handle, &span, 1, data + data_count,
+				LOOPBACK_DATA_MAX - data_count, &samples_consumed);
+		assert(samples_consumed == span.samples_count);
+		position += samples_consumed;
+	}
+	decoder_api->terminate(handle);
+	decoder_api->release(handle);
+	return data_count;
+}
+
+int bench_ook_loopback(void)
+{
+	struct plc_plugin *encoder_plugin, *decoder_plugin;
+	struct encoder_api *encoder_api = bench_load_plugin(plc_plugin_category_encoder,
+			"encoder-ook", &encoder_plugin);
+	struct decoder_api *decoder_api = bench_load_plugin(plc_plugin_category_decoder,
+			"decoder-ook", &decoder_plugin);
+	const uint32_t message_len = strlen(LOOPBACK_MESSAGE);
+	int ret = 0;
+	uint32_t n;
+	for (n = 0; n < ARRAY_SIZE(loopback_cases); n++)
+	{
+		const struct loopback_case *loopback_case = &loopback_cases[n];
+		sample_tx_t *samples = bench_ook_encode(encoder_api, loopback_case->tx_sampling_rate_sps,
+				LOOPBACK_SAMPLES);
+		uint8_t data[LOOPBACK_DATA_MAX];
+		uint32_t data_count = loopback_decode(decoder_api, samples, loopback_case, data);
+		uint32_t data_ok;
+		for (data_ok = 0; data_ok < data_count; data_ok++)
+			if (data[data_ok] != LOOPBACK_MESSAGE[data_ok % message_len])
+				break;
+		int passed = (data_ok == data_count)
+				&& (data_count >= LOOPBACK_MESSAGES_MIN * message_len);
+		ret |= bench_check(passed,
+				"TX %.0f sps, RX %.0f sps, %s, threshold %u: %u data decoded, %u correct",
+				loopback_case->tx_sampling_rate_sps, LOOPBACK_RX_SAMPLING_RATE_SPS,
+				decode_mode_text[loopback_case->decode_mode], loopback_case->data_hi_threshold,
+				data_count, data_ok);
+		free(samples);
+	}
+	plc_plugin_unload(decoder_plugin);
+	plc_plugin_unload(encoder_plugin);
+	return ret;
+}
@@ -0,0 +1,165 @@
+/**
+ * @file
+ * @brief	**Main** file
+ *
+ * @see		@ref application-plc-cape-bench
+ *
+ * @cond COPYRIGHT_NOTES
+ *
+ * ##LICENSE
+ *
+ *		This file is part of plc-cape project.
+ *
+ *		plc-cape project is free software: you can redistribute it and/or modify
+ *		it under the terms of the GNU General Public License as published by
+ *		the Free Software Foundation, either version 3 of the License, or
+ *		(at your option) any later version.
+ *
+ *		plc-cape project is distributed in the hope that it will be useful,
+ *		but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *		MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *		GNU General Public License for more details.
+ *
+ *		You should have received a copy of the GNU General Public License
+ *		along with plc-cape project.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @copyright
+ *	Copyright (C) 2017 Jose Maria Ortega
+ *
+ * @endcond
+ */
+
+#include <stdarg.h>
+#include "+common/api/+base.h"
+#include "libraries/libplc-tools/api/plugin.h"
+#include "libraries/libplc-tools/api/plugin_static.h"
+#include "libraries/libplc-tools/api/time.h"
+#include "bench.h"
+
+#ifdef DEBUG
+// To allow TRACE macros declare 'plc_debug_level'. 'plc_trace' is the one of the plc-cape-lab
+//	objects linked for its benches
+int plc_debug_level = 3;
+#endif
+
+static const struct bench benches[] = {
+	{
+		"fixed-point", "Bit-exact Q15/Q31 filtering chain against a reference model",
+		bench_fixed_point }, {
+		"ook-loopback", "OOK encoder to decoder with mismatched sampling rates",
+		bench_ook_loopback }, {
+		"deferred-chunks", "Deferred decoding in overlapping chunks against the serial one",
+		bench_deferred_chunks }, {
+		"correlator", "Direct and FFT correlation methods across template lengths",
+		bench_correlator }, {
+		"rx-analysis", "Single-pass RX buffer statistics against a scalar reference",
+		bench_rx_analysis }, {
+		"csv-writer", "Buffered locale-independent CSV writer against the 'printf' one",
+		bench_csv_writer }, {
+		"plugin-calls", "Per-buffer cost of a static plugin against its dynamic library",
+		bench_plugin_calls }, {
+		"decimation", "CIC and polyphase decimation cost and decoded data against full rate",
+		bench_decimation }, {
+		"capture", "Binary capture files against CSV ones, and their replay to the end",
+		bench_capture }, {
+		"profile-cache", "Cold and warm loads of the plc-cape-lab profiles",
+		bench_profile_cache }, {
+		"logger-contention", "Synchronous and asynchronous plc-cape-lab logger under contention",
+		bench_logger_contention }, {
+		"spsc-ring", "Ingest, wake-up latency and abort of the oscilloscope sample ring",
+		bench_spsc_ring }, {
+		"plot-drawing", "Oscilloscope drawing time per frame of buffers up to 4M samples",
+		bench_plot_drawing }, {
+		"spectrum", "Oscilloscope r2c spectrum against the previous c2c FFT",
+		bench_spectrum } };
+
+// '--help' message
+// NOTE: When modifying this section update 'notes.md'
+static const char usage_message[] = "Usage: plc-cape-bench [OPTION]... [BENCH]...\n"
+		"Runs the specified BENCHes (all by default) reporting their checks and timings\n\n"
+		"  -l            List the available benches and exit\n"
+		"     --help     display this help and exit\n";
+
+int bench_check(int passed, const char *format, ...)
+{
+	va_list args;
+	va_start(args, format);
+	printf("  %s ", passed ? "PASS" : "FAIL");
+	vprintf(format, args);
+	printf("\n");
+	va_end(args);
+	return passed ? 0 : -1;
+}
+
+double bench_get_elapsed_us(struct timespec start)
+{
+	struct timespec end = plc_time_get_hires_stamp();
+	return (plc_time_hires_stamp_to_nsec(end) - plc_time_hires_stamp_to_nsec(start)) / 1000.0;
+}
+
+void *bench_load_plugin(enum plc_plugin_category category, const char *name,
+		struct plc_plugin **plugin)
+{
+	char *error_msg;
+	uint32_t api_version, api_size;
+	void *api;
+	char *plugin_path = plc_plugin_get_abs_path(category, name);
+	*plugin = plc_plugin_load(plugin_path, NULL, NULL, &api, &api_version, &api_size,
+			&error_msg);
+	if (*plugin == NULL)
+	{
+		fprintf(stderr, "Unable to load '%s': %s\n", plugin_path, error_msg);
+		exit(EXIT_FAILURE);
+	}
+	free(plugin_path);
+	return api;
+}
+
+static const struct bench *bench_find(const char *name)
+{
+	uint32_t n;
+	for (n = 0; n < ARRAY_SIZE(benches); n++)
+		if (strcmp(benches[n].name, name) == 0)
+			return &benches[n];
+	return NULL;
+}
+
+static int bench_run(const struct bench *bench)
+{
+	printf("%s: %s\n", bench->name, bench->description);
+	return bench->run();
+}
+
+int main(int argc, char *argv[])
+{
+	plc_plugin_register_static_list();
+	uint32_t n;
+	if ((argc > 1) && (strcmp(argv[1], "--help") == 0))
+	{
+		printf("%s", usage_message);
+		return EXIT_SUCCESS;
+	}
+	if ((argc > 1) && (strcmp(argv[1], "-l") == 0))
+	{
+		for (n = 0; n < ARRAY_SIZE(benches); n++)
+			printf("%-20s %s\n", benches[n].name, benches[n].description);
+		return EXIT_SUCCESS;
+	}
+	// Validate all the names before running anything
+	int i;
+	for (i = 1; i < argc; i++)
+		if (bench_find(argv[i]) == NULL)
+		{
+			fprintf(stderr, "Unknown bench '%s'. Use -l to list them\n", argv[i]);
+			return EXIT_FAILURE;
+		}
+	int ret = 0;
+	if (argc == 1)
+		for (n = 0; n < ARRAY_SIZE(benches); n++)
+			ret |= bench_run(&benches[n]);
+	else
+		for (i = 1; i < argc; i++)
+			ret |= bench_run(bench_find(argv[i]));
+	printf("%s\n", (ret == 0) ? "All the checks passed" : "Some checks FAILED");
+	return (ret == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,135 @@
+/**
+ * @file
+ * @brief	Drawing of _Plot_area_ of _plc-cape-oscilloscope_ into an image surface
+ * @details
+ *	Capture buffers of 10k to 4M samples of a sinusoid with a single-sample glitch are pushed in
+ *	blocks, as the recorder does, and the whole buffer is drawn into an image surface with lines,
+ *	fast-decimated lines and bars. Reports the push cost per sample and the time per frame, which
+ *	should not grow with the samples shown. The glitch must be drawn in every case: with the whole
+ *	ADC range shown, only the glitch reaches the top third of the graph
+ *
+ * @cond COPYRIGHT_NOTES @copyright
+ *	Copyright (C) 2017 Jose Maria Ortega\n
+ *	Distributed under the GNU GPLv3. For full terms see the file LICENSE
+ * @endcond
+ */
+
+#include <math.h>
+#include "+common/api/+base.h"
+#include "applications/plc-cape-oscilloscope/plot_area.h"
+#include "applications/plc-cape-oscilloscope/tools.h"
+#include "libraries/libplc-tools/api/time.h"
+#include "bench.h"
+
+#define BENCH_PLOT_WIDTH 1000
+#define BENCH_PLOT_HEIGHT 400
+// Same block than the recorder ('BUFFER_SAMPLES')
+#define BENCH_PLOT_BLOCK_SAMPLES 1024
+#define BENCH_PLOT_FRAMES 10
+// Sinusoid in the lower half of the 12-bit ADC range and a glitch at its three quarters
+#define BENCH_PLOT_ADC_RANGE (1 << 12)
+#define BENCH_PLOT_SIGNAL_CENTER 1024
+#define BENCH_PLOT_SIGNAL_AMPLITUDE 200
+#define BENCH_PLOT_SIGNAL_PERIOD 100
+#define BENCH_PLOT_GLITCH_VALUE 3072
+
+static const uint32_t bench_plot_samples[] = {
+	10000, 100000, 1000000, 4000000 };
+
+static const enum graph_drawing_mode bench_plot_modes[] = {
+	graph_drawing_lines, graph_drawing_lines_fast_decimation, graph_drawing_bars };
+
+// Returns 1 if anything has been drawn in the top third of the graph, skipping its border
+static int bench_plot_glitch_drawn(cairo_surface_t *surface)
+{
+	cairo_surface_flush(surface);
+	const unsigned char *data = cairo_image_surface_get_data(surface);
+	int stride = cairo_image_surface_get_stride(surface);
+	int y;
+	for (y = 2; y < BENCH_PLOT_HEIGHT / 3; y++)
+	{
+		const uint32_t *row = (const uint32_t*) (data + y * stride);
+		int x;
+		for (x = 2; x < BENCH_PLOT_WIDTH - 2; x++)
+			if (row[x] != 0)
+				return 1;
+	}
+	return 0;
+}
+
+// Draws the plot buffer with 'mode'. Returns 1 if the glitch is drawn and the mean time per frame
+static int bench_plot_draw(Plot_area *plot_area, enum graph_drawing_mode mode, double *frame_ms)
+{
+	plot_area->set_graph_drawing_mode(mode);
+	GtkAllocation rect = {
+		0, 0, BENCH_PLOT_WIDTH, BENCH_PLOT_HEIGHT };
+	cairo_surface_t *surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, BENCH_PLOT_WIDTH,
+			BENCH_PLOT_HEIGHT);
+	cairo_t *cr = cairo_create(surface);
+	// The first frame is checked on the empty surface and discarded from the timing
+	plot_area->do_drawing(cr, rect);
+	int glitch_drawn = bench_plot_glitch_drawn(surface);
+	struct timespec start = plc_time_get_hires_stamp();
+	uint32_t n;
+	for (n = 0; n < BENCH_PLOT_FRAMES; n++)
+		plot_area->do_drawing(cr, rect);
+	cairo_surface_flush(surface);
+	int64_t elapsed_ns = plc_time_hires_stamp_to_nsec(plc_time_get_hires_stamp())
+			- plc_time_hires_stamp_to_nsec(start);
+	cairo_destroy(cr);
+	cairo_surface_destroy(surface);
+	*frame_ms = elapsed_ns / 1000000.0 / BENCH_PLOT_FRAMES;
+	return glitch_drawn;
+}
+
+// Returns 0 if the glitch has been drawn with all the modes
+static int bench_plot_run(uint32_t samples_count)
+{
+	Plot_area *plot_area = new Plot_area();
+	plot_area->show_viewer_info(0);
+	// 1 us per sample: the interval in ms is the thousandth of the samples
+	plot_area->set_osc_buffer(samples_count / 1000.0, 1.0);
+	sample_rx_t *samples = (sample_rx_t*) malloc(samples_count * sizeof(sample_rx_t));
+	uint32_t n;
+	for (n = 0; n < samples_count; n++)
+		samples[n] = BENCH_PLOT_SIGNAL_CENTER + lrintf(BENCH_PLOT_SIGNAL_AMPLITUDE
+				* sinf(2 * M_PI * n / BENCH_PLOT_SIGNAL_PERIOD));
+	samples[samples_count / 3] = BENCH_PLOT_GLITCH_VALUE;
+	struct timespec start = plc_time_get_hires_stamp();
+	uint32_t samples_pushed = 0;
+	int buffer_completed = 0;
+	while (!buffer_completed && (samples_pushed < samples_count))
+	{
+		uint32_t block_samples = samples_count - samples_pushed;
+		if (block_samples > BENCH_PLOT_BLOCK_SAMPLES)
+			block_samples = BENCH_PLOT_BLOCK_SAMPLES;
+		buffer_completed = plot_area->push_buffer(samples + samples_pushed, block_samples);
+		samples_pushed += block_samples;
+	}
+	int64_t push_ns = plc_time_hires_stamp_to_nsec(plc_time_get_hires_stamp())
+			- plc_time_hires_stamp_to_nsec(start);
+	free(samples);
+	plot_area->set_viewer_interval(samples_count / 1000.0);
+	float yunit_per_sample = plot_area->get_yunit_per_sample();
+	plot_area->set_yunit_range(BENCH_PLOT_ADC_RANGE * yunit_per_sample);
+	plot_area->set_yunit_offset((BENCH_PLOT_ADC_RANGE / 2 - SAMPLES_ZERO_REF) * yunit_per_sample);
+	int passed = buffer_completed;
+	double frame_ms[ARRAY_SIZE(bench_plot_modes)];
+	for (n = 0; n < ARRAY_SIZE(bench_plot_modes); n++)
+		passed &= bench_plot_draw(plot_area, bench_plot_modes[n], &frame_ms[n]);
+	delete plot_area;
+	return bench_check(passed, "%7u samples: push %.2f ns/sample. ms per frame: %s %.2f, %s %.2f, "
+			"%s %.2f", samples_count, (double) push_ns / samples_pushed,
+			graph_drawing_mode_text[bench_plot_modes[0]], frame_ms[0],
+			graph_drawing_mode_text[bench_plot_modes[1]], frame_ms[1],
+			graph_drawing_mode_text[bench_plot_modes[2]], frame_ms[2]);
+}
+
+int bench_plot_drawing(void)
+{
+	int ret = 0;
+	uint32_t n;
+	for (n = 0; n < ARRAY_SIZE(bench_plot_samples); n++)
+		ret |= bench_plot_run(bench_plot_samples[n]);
+	return ret;
+}
@@ -0,0 +1,170 @@
+/**
+ * @file
+ * @brief	Per-buffer cost of a plugin linked statically against its dynamic library
+ * @details
+ *	_encoder-wave_ is loaded through 'plc_plugin_load', which uses the static plugin when the
+ *	bench is built with 'PLUGINS_STATIC="encoder-wave"', and directly from its dynamic library
+ *	with 'dlopen'. Both generate the same streams buffer per buffer and their samples must be
+ *	identical. Cheap streams in small buffers show the cost of the calls and the sinus one the
+ *	generated code (with 'LTO=1' the static plugin is optimized with the application)
+ *
+ * @cond COPYRIGHT_NOTES @copyright
+ *	Copyright (C) 2017 Jose Maria Ortega\n
+ *	Distributed under the GNU GPLv3. For full terms see the file LICENSE
+ * @endcond
+ */
+
+#include <dlfcn.h>		// dlopen
+#include "+common/api/+base.h"
+#include "+common/api/setting.h"
+#include "libraries/libplc-tools/api/plugin.h"
+#include "libraries/libplc-tools/api/time.h"
+#include "bench.h"
+
+#define PLUGIN_CALLS_PLUGIN_NAME "encoder-wave"
+// Values of 'stream_type' of encoder-wave
+#define PLUGIN_CALLS_STREAM_CONSTANT 2
+#define PLUGIN_CALLS_STREAM_SINUS 10
+#define PLUGIN_CALLS_SAMPLES_TOTAL (1 << 24)
+#define PLUGIN_CALLS_VERIFIED_BUFFERS 64
+#define PLUGIN_CALLS_REPETITIONS 5
+
+struct plugin_calls_case
+{
+	const char *stream_text;
+	uint32_t stream_type;
+	uint32_t buffer_samples;
+};
+
+static const struct plugin_calls_case plugin_calls_cases[] = {
+	{ "constant", PLUGIN_CALLS_STREAM_CONSTANT, 4 },
+	{ "constant", PLUGIN_CALLS_STREAM_CONSTANT, 64 },
+	{ "sinus", PLUGIN_CALLS_STREAM_SINUS, 64 },
+	{ "sinus", PLUGIN_CALLS_STREAM_SINUS, 1024 } };
+
+// Same steps than 'plc_plugin_load' for a dynamic library, without looking for a static plugin
+static struct encoder_api *plugin_calls_dlopen(const char *plugin_path, void **so_handle,
+		plugin_api_unload_t *api_unload)
+{
+	*so_handle = dlopen(plugin_path, RTLD_LAZY);
+	if (*so_handle == NULL)
+	{
+		fprintf(stderr, "Unable to load '%s': %s\n", plugin_path, dlerror());
+		exit(EXIT_FAILURE);
+	}
+	plugin_api_load_t api_load = dlsym(*so_handle, PLUGIN_API_LOAD_STRING);
+	*api_unload = dlsym(*so_handle, PLUGIN_API_UNLOAD_STRING);
+	if ((api_load == NULL) || (*api_unload == NULL))
+	{
+		fprintf(stderr, "Invalid plugin '%s'\n", plugin_path);
+		exit(EXIT_FAILURE);
+	}
+	uint32_t api_version, api_size;
+	return api_load(&api_version, &api_size);
+}
+
+static encoder_api_h plugin_calls_create_encoder(struct encoder_api *encoder_api,
+		uint32_t stream_type)
+{
+	encoder_api_h handle = encoder_api->create();
+	union plc_setting_data data;
+	encoder_api->begin_settings(handle);
+	data.u32 = stream_type;
+	int ret = encoder_api->set_setting(handle, "stream_type", data);
+	ret |= encoder_api->end_settings(handle);
+	if (ret != 0)
+	{
+		fprintf(stderr, "Unable to configure '%s'\n", PLUGIN_CALLS_PLUGIN_NAME);
+		exit(EXIT_FAILURE);
+	}
+	encoder_api->reset(handle);
+	return handle;
+}
+
+// Returns 1 if both APIs generate the same samples
+static int plugin_calls_compare(struct encoder_api *encoder_api_a,
+		struct encoder_api *encoder_api_b, const struct plugin_calls_case *plugin_calls_case)
+{
+	uint32_t buffer_samples = plugin_calls_case->buffer_samples;
+	sample_tx_t *buffer_a = malloc(buffer_samples * sizeof(sample_tx_t));
+	sample_tx_t *buffer_b = malloc(buffer_samples * sizeof(sample_tx_t));
+	encoder_api_h handle_a = plugin_calls_create_encoder(encoder_api_a,
+			plugin_calls_case->stream_type);
+	encoder_api_h handle_b = plugin_calls_create_encoder(encoder_api_b,
+			plugin_calls_case->stream_type);
+	int equal = 1;
+	uint32_t n;
+	for (n = 0; (n < PLUGIN_CALLS_VERIFIED_BUFFERS) && equal; n++)
+	{
+		encoder_api_a->prepare_next_samples(handle_a, buffer_a, buffer_samples);
+		encoder_api_b->prepare_next_samples(handle_b, buffer_b, buffer_samples);
+		equal = (memcmp(buffer_a, buffer_b, buffer_samples * sizeof(sample_tx_t)) == 0);
+	}
+	encoder_api_b->release(handle_b);
+	encoder_api_a->release(handle_a);
+	free(buffer_b);
+	free(buffer_a);
+	return equal;
+}
+
+// Best time per buffer [ns] of several repetitions
+static double plugin_calls_time(struct encoder_api *encoder_api,
+		const struct plugin_calls_case *plugin_calls_case)
+{
+	uint32_t buffer_samples = plugin_calls_case->buffer_samples;
+	uint32_t buffers_count = PLUGIN_CALLS_SAMPLES_TOTAL / buffer_samples;
+	sample_tx_t *buffer = malloc(buffer_samples * sizeof(sample_tx_t));
+	encoder_api_h handle = plugin_calls_create_encoder(encoder_api,
+			plugin_calls_case->stream_type);
+	double best_us = 0.0;
+	uint32_t repetition;
+	for (repetition = 0; repetition < PLUGIN_CALLS_REPETITIONS; repetition++)
+	{
+		struct timespec start = plc_time_get_hires_stamp();
+		uint32_t n;
+		for (n = 0; n < buffers_count; n++)
+			encoder_api->prepare_next_samples(handle, buffer, buffer_samples);
+		double elapsed_us = bench_get_elapsed_us(start);
+		if ((repetition == 0) || (elapsed_us < best_us))
+			best_us = elapsed_us;
+	}
+	encoder_api->release(handle);
+	free(buffer);
+	return best_us * 1000.0 / buffers_count;
+}
+
+int bench_plugin_calls(void)
+{
+	struct plc_plugin *plugin;
+	struct encoder_api *encoder_api_loaded = bench_load_plugin(plc_plugin_category_encoder,
+			PLUGIN_CALLS_PLUGIN_NAME, &plugin);
+	char *plugin_path = plc_plugin_get_abs_path(plc_plugin_category_encoder,
+			PLUGIN_CALLS_PLUGIN_NAME);
+	void *so_handle;
+	plugin_api_unload_t api_unload;
+	struct encoder_api *encoder_api_dynamic = plugin_calls_dlopen(plugin_path, &so_handle,
+			&api_unload);
+	free(plugin_path);
+	// The same dynamic library is loaded once: same functions if not linked statically
+	const char *loaded_text = (encoder_api_loaded->prepare_next_samples
+			== encoder_api_dynamic->prepare_next_samples) ?
+			"dlopen (not linked statically)" : "static";
+	printf("  plc_plugin_load: %s\n", loaded_text);
+	int ret = 0;
+	uint32_t n;
+	for (n = 0; n < ARRAY_SIZE(plugin_calls_cases); n++)
+	{
+		const struct plugin_calls_case *plugin_calls_case = &plugin_calls_cases[n];
+		int passed = plugin_calls_compare(encoder_api_dynamic, encoder_api_loaded,
+				plugin_calls_case);
+		double dynamic_ns = plugin_calls_time(encoder_api_dynamic, plugin_calls_case);
+		double loaded_ns = plugin_calls_time(encoder_api_loaded, plugin_calls_case);
+		ret |= bench_check(passed, "%-8s %4u samples: ns per buffer dlopen %.1f, loaded %.1f",
+				plugin_calls_case->stream_text, plugin_calls_case->buffer_samples, dynamic_ns,
+				loaded_ns);
+	}
+	api_unload(encoder_api_dynamic);
+	dlclose(so_handle);
+	plc_plugin_unload(plugin);
+	return ret;
+}
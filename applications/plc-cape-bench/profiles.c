@@ -0,0 +1,183 @@
+/**
+ * @file
+ * @brief	Profile cache of _plc-cape-lab_ against the XML parsing
+ * @details
+ *	Run from the output directory of plc-cape-lab, where its 'profiles.xml' is installed:
+ *	- Cold load: without 'profiles.cache' the XML is parsed and the cache written
+ *	- Warm load: the profiles are read from the cache written by the cold load
+ *	- Lookup: the settings of every profile are pushed as when selecting it
+ *	The profiles of both loads must be identical. A valid cache is left behind
+ *
+ * @cond COPYRIGHT_NOTES @copyright
+ *	Copyright (C) 2017 Jose Maria Ortega\n
+ *	Distributed under the GNU GPLv3. For full terms see the file LICENSE
+ * @endcond
+ */
+
+#define _GNU_SOURCE		// asprintf
+#include <errno.h>
+#include <sys/stat.h>	// stat
+#include <unistd.h>		// chdir, unlink
+#include "+common/api/+base.h"
+#include "applications/plc-cape-lab/profiles.h"
+#include "applications/plc-cape-lab/settings.h"
+#include "libraries/libplc-tools/api/application.h"
+#include "libraries/libplc-tools/api/settings.h"
+#include "libraries/libplc-tools/api/time.h"
+#include "bench.h"
+
+#define PROFILES_BENCH_LOADS 30
+#define PROFILES_BENCH_LOOKUP_ROUNDS 100
+// Same names than 'profiles.c' of plc-cape-lab
+#define PROFILES_BENCH_XML_FILENAME "profiles.xml"
+#define PROFILES_BENCH_CACHE_FILENAME "profiles.cache"
+// Output directory of plc-cape-lab relative to the one of this application
+#define PROFILES_BENCH_LAB_REL_DIR "../plc-cape-lab"
+
+static uint32_t profiles_bench_count_settings(const struct setting_list_item *setting_list)
+{
+	uint32_t count = 0;
+	for (; setting_list != NULL; setting_list = setting_list->next)
+		count++;
+	return count;
+}
+
+static int profiles_bench_equal_names(const char *name_a, const char *name_b)
+{
+	return ((name_a == NULL) && (name_b == NULL))
+			|| ((name_a != NULL) && (name_b != NULL) && (strcmp(name_a, name_b) == 0));
+}
+
+// Pushes the settings of a profile. Returns the elapsed ms and a summary of the result to be
+//	compared: the plugin names (to be freed) and the number of plugin settings
+static double profiles_bench_push(struct profiles *profiles, const char *profile_identifier,
+		struct settings *settings, char **encoder_name, char **decoder_name,
+		uint32_t *settings_count)
+{
+	struct setting_list_item *encoder_settings = NULL;
+	struct setting_list_item *decoder_settings = NULL;
+	settings_set_defaults(settings);
+	struct timespec start = plc_time_get_hires_stamp();
+	profiles_push_profile_settings(profiles, profile_identifier, settings, encoder_name,
+			&encoder_settings, decoder_name, &decoder_settings);
+	double elapsed_ms = bench_get_elapsed_us(start) / 1000.0;
+	*settings_count = profiles_bench_count_settings(encoder_settings)
+			+ profiles_bench_count_settings(decoder_settings);
+	plc_setting_clear_settings(&decoder_settings);
+	plc_setting_clear_settings(&encoder_settings);
+	return elapsed_ms;
+}
+
+// Returns the number of profiles differing between both loads
+static uint32_t profiles_bench_compare(struct profiles *profiles_a, struct profiles *profiles_b,
+		struct settings *settings)
+{
+	uint32_t mismatches = 0;
+	profiles_iterator *iterator_a = profiles_move_to_first_profile(profiles_a);
+	profiles_iterator *iterator_b = profiles_move_to_first_profile(profiles_b);
+	for (; (iterator_a != NULL) && (iterator_b != NULL);
+			iterator_a = profiles_move_to_next_profile(iterator_a),
+			iterator_b = profiles_move_to_next_profile(iterator_b))
+	{
+		const char *profile_identifier = profiles_current_profile_get_identifier(iterator_a);
+		char *encoder_name_a, *decoder_name_a, *encoder_name_b, *decoder_name_b;
+		uint32_t settings_count_a, settings_count_b;
+		profiles_bench_push(profiles_a, profile_identifier, settings, &encoder_name_a,
+				&decoder_name_a, &settings_count_a);
+		profiles_bench_push(profiles_b, profile_identifier, settings, &encoder_name_b,
+				&decoder_name_b, &settings_count_b);
+		if ((strcmp(profile_identifier, profiles_current_profile_get_identifier(iterator_b)) != 0)
+				|| (strcmp(profiles_current_profile_get_title(iterator_a),
+						profiles_current_profile_get_title(iterator_b)) != 0)
+				|| (profiles_current_profile_is_hidden(iterator_a)
+						!= profiles_current_profile_is_hidden(iterator_b))
+				|| !profiles_bench_equal_names(encoder_name_a, encoder_name_b)
+				|| !profiles_bench_equal_names(decoder_name_a, decoder_name_b)
+				|| (settings_count_a != settings_count_b))
+			mismatches++;
+		free(encoder_name_a);
+		free(decoder_name_a);
+		free(encoder_name_b);
+		free(decoder_name_b);
+	}
+	if ((iterator_a != NULL) || (iterator_b != NULL))
+		mismatches++;
+	return mismatches;
+}
+
+// Returns 0 if both loads return the same profiles
+static int profiles_bench_run(void)
+{
+	struct stat xml_stat;
+	if (stat(PROFILES_BENCH_XML_FILENAME, &xml_stat) < 0)
+		return bench_check(0, "Unable to open %s", PROFILES_BENCH_XML_FILENAME);
+	double cold_ms = 0.0;
+	uint32_t n;
+	for (n = 0; n < PROFILES_BENCH_LOADS; n++)
+	{
+		unlink(PROFILES_BENCH_CACHE_FILENAME);
+		struct timespec start = plc_time_get_hires_stamp();
+		profiles_release(profiles_create());
+		cold_ms += bench_get_elapsed_us(start) / 1000.0;
+	}
+	struct stat cache_stat;
+	int cache_written = (stat(PROFILES_BENCH_CACHE_FILENAME, &cache_stat) == 0);
+	double warm_ms = 0.0;
+	for (n = 0; n < PROFILES_BENCH_LOADS; n++)
+	{
+		struct timespec start = plc_time_get_hires_stamp();
+		profiles_release(profiles_create());
+		warm_ms += bench_get_elapsed_us(start) / 1000.0;
+	}
+	struct settings *settings = settings_create();
+	struct profiles *profiles_warm = profiles_create();
+	unlink(PROFILES_BENCH_CACHE_FILENAME);
+	struct profiles *profiles_cold = profiles_create();
+	uint32_t profiles_count = profiles_get_count(profiles_cold);
+	uint32_t mismatches = profiles_bench_compare(profiles_cold, profiles_warm, settings);
+	int ret = bench_check(cache_written && (mismatches == 0), "%s (%u profiles, %.1f KB): cold "
+			"%.3f ms, warm %.3f ms per load, %u mismatches", PROFILES_BENCH_XML_FILENAME,
+			profiles_count, xml_stat.st_size / 1024.0, cold_ms / PROFILES_BENCH_LOADS,
+			warm_ms / PROFILES_BENCH_LOADS, mismatches);
+	double lookup_ms = 0.0;
+	for (n = 0; n < PROFILES_BENCH_LOOKUP_ROUNDS; n++)
+	{
+		profiles_iterator *iterator;
+		for (iterator = profiles_move_to_first_profile(profiles_warm); iterator != NULL;
+				iterator = profiles_move_to_next_profile(iterator))
+		{
+			char *encoder_name, *decoder_name;
+			uint32_t settings_count;
+			lookup_ms += profiles_bench_push(profiles_warm,
+					profiles_current_profile_get_identifier(iterator), settings, &encoder_name,
+					&decoder_name, &settings_count);
+			free(encoder_name);
+			free(decoder_name);
+		}
+	}
+	printf("  Push of the profile settings (inheritance included): %.2f us per profile\n",
+			1000.0 * lookup_ms / (PROFILES_BENCH_LOOKUP_ROUNDS * profiles_count));
+	profiles_release(profiles_cold);
+	profiles_release(profiles_warm);
+	settings_release(settings);
+	return ret;
+}
+
+int bench_profile_cache(void)
+{
+	char *cwd = getcwd(NULL, 0);
+	char *app_abs_dir = plc_application_get_abs_dir();
+	char *lab_abs_dir;
+	asprintf(&lab_abs_dir, "%s/%s", app_abs_dir, PROFILES_BENCH_LAB_REL_DIR);
+	free(app_abs_dir);
+	int ret;
+	if (chdir(lab_abs_dir) < 0)
+		ret = bench_check(0, "Unable to access %s: %s", lab_abs_dir, strerror(errno));
+	else
+		ret = profiles_bench_run();
+	if ((cwd == NULL) || (chdir(cwd) < 0))
+		ret |= bench_check(0, "Unable to restore the working directory");
+	free(lab_abs_dir);
+	free(cwd);
+	return ret;
+}
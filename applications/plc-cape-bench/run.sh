@@ -0,0 +1,7 @@
+#!/bin/bash
+
+APP_NAME=$(basename $PWD)
+# NOTE:
+# The capture file is usually the one stored by 'plc-cape-lab' on its own folder
+cd $DEV_BIN_DIR/applications/$APP_NAME
+./$APP_NAME $@
@@ -0,0 +1,122 @@
+/**
+ * @file
+ * @brief	_Spectrum_ of _plc-cape-oscilloscope_ against the previous complex FFT
+ * @details
+ *	For several viewer sizes, compares the spectrum calculation with the previous one: a complex
+ *	(c2c) FFTW_ESTIMATE plan of exactly the viewer samples, re-planned at every viewer change and
+ *	fed with the real samples as complex ones. Reports the planning time and the FFT time per
+ *	frame of both. The new amplitudes are checked with a sinusoid between bins through the
+ *	flat-top window, which must show its amplitude
+ *
+ * @cond COPYRIGHT_NOTES @copyright
+ *	Copyright (C) 2017 Jose Maria Ortega\n
+ *	Distributed under the GNU GPLv3. For full terms see the file LICENSE
+ * @endcond
+ */
+
+#include <math.h>
+#include "+common/api/+base.h"
+#include "applications/plc-cape-oscilloscope/spectrum.h"
+#include "libraries/libplc-tools/api/time.h"
+#include "bench.h"
+
+#define BENCH_FFT_FRAMES 20
+// Sinusoid in the middle of the 12-bit ADC range, not centered in any bin
+#define BENCH_FFT_SIGNAL_CENTER 2048
+#define BENCH_FFT_SIGNAL_AMPLITUDE 500.0
+#define BENCH_FFT_SIGNAL_CYCLES_PER_SAMPLE 0.0537
+#define BENCH_FFT_AMPLITUDE_TOLERANCE 0.01
+
+// Viewer samples, up to one second at the max capturing rate of the BBB ADC
+static const uint32_t bench_fft_samples[] = {
+	1000, 4096, 10000, 65536, 200000 };
+
+static int64_t bench_fft_get_elapsed_ns(struct timespec start)
+{
+	return plc_time_hires_stamp_to_nsec(plc_time_get_hires_stamp())
+			- plc_time_hires_stamp_to_nsec(start);
+}
+
+// Previous calculation. Returns the planning time [ns] and the mean time per frame
+static int64_t bench_fft_c2c(const sample_rx_t *samples, uint32_t samples_count, float *amplitudes,
+		double *frame_ns)
+{
+	struct timespec start = plc_time_get_hires_stamp();
+	fftw_complex *in = (fftw_complex*) fftw_malloc(sizeof(fftw_complex) * samples_count);
+	fftw_complex *out = (fftw_complex*) fftw_malloc(sizeof(fftw_complex) * samples_count);
+	fftw_plan plan = fftw_plan_dft_1d(samples_count, in, out, FFTW_FORWARD, FFTW_ESTIMATE);
+	int64_t plan_ns = bench_fft_get_elapsed_ns(start);
+	start = plc_time_get_hires_stamp();
+	uint32_t frame;
+	for (frame = 0; frame < BENCH_FFT_FRAMES; frame++)
+	{
+		uint32_t n;
+		for (n = 0; n < samples_count; n++)
+		{
+			in[n][0] = samples[n];
+			in[n][1] = 0;
+		}
+		fftw_execute(plan);
+		amplitudes[0] = 0.0;
+		for (n = 1; n < samples_count; n++)
+			amplitudes[n] = sqrt(out[n][0] * out[n][0] + out[n][1] * out[n][1]);
+	}
+	*frame_ns = (double) bench_fft_get_elapsed_ns(start) / BENCH_FFT_FRAMES;
+	fftw_destroy_plan(plan);
+	fftw_free(out);
+	fftw_free(in);
+	return plan_ns;
+}
+
+// Returns 0 if the flat-top peak matches the amplitude of the sinusoid
+static int bench_fft_run(uint32_t samples_count)
+{
+	sample_rx_t *samples = (sample_rx_t*) malloc(samples_count * sizeof(sample_rx_t));
+	uint32_t n;
+	for (n = 0; n < samples_count; n++)
+		samples[n] = BENCH_FFT_SIGNAL_CENTER + lrint(BENCH_FFT_SIGNAL_AMPLITUDE
+				* sin(2 * M_PI * BENCH_FFT_SIGNAL_CYCLES_PER_SAMPLE * n));
+	float *amplitudes = (float*) malloc(samples_count * sizeof(float));
+	double c2c_frame_ns;
+	int64_t c2c_plan_ns = bench_fft_c2c(samples, samples_count, amplitudes, &c2c_frame_ns);
+	free(amplitudes);
+	Spectrum *spectrum = new Spectrum();
+	struct timespec start = plc_time_get_hires_stamp();
+	uint32_t bins = spectrum->configure(samples_count, 0, spectrum_window_flat_top);
+	int64_t r2c_plan_ns = bench_fft_get_elapsed_ns(start);
+	// A viewer change with the plan already cached only recalculates the window
+	spectrum->configure(samples_count - 1, 0, spectrum_window_flat_top);
+	start = plc_time_get_hires_stamp();
+	spectrum->configure(samples_count, 0, spectrum_window_flat_top);
+	int64_t r2c_change_ns = bench_fft_get_elapsed_ns(start);
+	amplitudes = (float*) malloc(bins * sizeof(float));
+	start = plc_time_get_hires_stamp();
+	uint32_t frame;
+	for (frame = 0; frame < BENCH_FFT_FRAMES; frame++)
+		spectrum->calculate(samples, amplitudes);
+	double r2c_frame_ns = (double) bench_fft_get_elapsed_ns(start) / BENCH_FFT_FRAMES;
+	float peak = 0.0;
+	for (n = 0; n < bins; n++)
+		if (amplitudes[n] > peak)
+			peak = amplitudes[n];
+	int passed = (fabs(peak - BENCH_FFT_SIGNAL_AMPLITUDE)
+			<= BENCH_FFT_SIGNAL_AMPLITUDE * BENCH_FFT_AMPLITUDE_TOLERANCE);
+	int ret = bench_check(passed, "%6u samples: c2c plan %.2f ms, frame %.3f ms. r2c %u-point "
+			"plan %.2f ms (cached %.3f ms), frame %.3f ms. Flat-top peak %.1f of %.1f",
+			samples_count, c2c_plan_ns / 1000000.0, c2c_frame_ns / 1000000.0,
+			spectrum->get_fft_size(), r2c_plan_ns / 1000000.0, r2c_change_ns / 1000000.0,
+			r2c_frame_ns / 1000000.0, peak, BENCH_FFT_SIGNAL_AMPLITUDE);
+	free(amplitudes);
+	delete spectrum;
+	free(samples);
+	return ret;
+}
+
+int bench_spectrum(void)
+{
+	int ret = 0;
+	uint32_t n;
+	for (n = 0; n < ARRAY_SIZE(bench_fft_samples); n++)
+		ret |= bench_fft_run(bench_fft_samples[n]);
+	return ret;
+}
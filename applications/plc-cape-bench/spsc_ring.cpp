@@ -0,0 +1,175 @@
+/**
+ * @file
+ * @brief	_Spsc_ring_ of _plc-cape-oscilloscope_ between the recorder and the GUI threads
+ * @details
+ *	- Sustained ingest: the producer pushes blocks of a counter as fast as the consumer pops them.
+ *	The popped samples must be the complete sequence
+ *	- Wake-up latency: the producer pushes a block every block period at the max capturing rate
+ *	and the consumer measures the time from the push to the return of 'pop'
+ *	- CPU use while idle: CPU time of the consumer thread during the latency test, which is mostly
+ *	spent waiting
+ *	- Abort: a consumer waiting without producer must return from 'pop' once the ring is aborted
+ *
+ * @cond COPYRIGHT_NOTES @copyright
+ *	Copyright (C) 2017 Jose Maria Ortega\n
+ *	Distributed under the GNU GPLv3. For full terms see the file LICENSE
+ * @endcond
+ */
+
+#include <pthread.h>
+#include <sched.h>			// sched_yield
+#include <sys/resource.h>	// getrusage
+#include <unistd.h>			// usleep
+#include "+common/api/+base.h"
+#include "applications/plc-cape-oscilloscope/spsc_ring.h"
+#include "libraries/libplc-tools/api/time.h"
+#include "bench.h"
+
+// Same values than the recorder: blocks of 'BUFFER_SAMPLES' and 'RING_SAMPLES_DEFAULT' ring
+#define BENCH_BLOCK_SAMPLES 1024
+#define BENCH_RING_SAMPLES 65536
+#define BENCH_INGEST_BLOCKS 200000
+// Max capturing rate of the BBB ADC
+#define BENCH_LATENCY_RATE_SPS 200000
+#define BENCH_LATENCY_BLOCKS 200
+// Time given to the consumer to be waiting before aborting, and max time to return
+#define BENCH_ABORT_WAIT_US 50000
+#define BENCH_ABORT_RETURN_MAX_US 10000
+
+struct bench_ring
+{
+	Spsc_ring *ring;
+	uint32_t blocks_count;
+	// Latency test only: period between pushes and push stamps per block
+	uint32_t push_period_us;
+	int64_t *push_stamps_ns;
+	// Results of the consumer
+	uint32_t mismatches;
+	int64_t latency_sum_ns;
+	int64_t latency_max_ns;
+	int64_t cpu_us;
+};
+
+static int64_t bench_get_thread_cpu_us(void)
+{
+	struct rusage usage;
+	getrusage(RUSAGE_THREAD, &usage);
+	return (int64_t) (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000
+			+ usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+}
+
+static void *bench_consumer_thread(void *arg)
+{
+	struct bench_ring *bench = (struct bench_ring*) arg;
+	sample_rx_t block[BENCH_BLOCK_SAMPLES];
+	sample_rx_t expected = 0;
+	int64_t cpu_start_us = bench_get_thread_cpu_us();
+	uint32_t n;
+	for (n = 0; n < bench->blocks_count; n++)
+	{
+		bench->ring->pop(block, BENCH_BLOCK_SAMPLES);
+		if (bench->push_stamps_ns)
+		{
+			// The stamp was written before the push, so it is visible once popped
+			int64_t latency_ns = plc_time_hires_stamp_to_nsec(plc_time_get_hires_stamp())
+					- bench->push_stamps_ns[n];
+			bench->latency_sum_ns += latency_ns;
+			if (latency_ns > bench->latency_max_ns)
+				bench->latency_max_ns = latency_ns;
+		}
+		uint32_t k;
+		for (k = 0; k < BENCH_BLOCK_SAMPLES; k++, expected++)
+			if (block[k] != expected)
+			{
+				bench->mismatches++;
+				expected = block[k];
+			}
+	}
+	bench->cpu_us = bench_get_thread_cpu_us() - cpu_start_us;
+	return NULL;
+}
+
+static void bench_ring_run(struct bench_ring *bench)
+{
+	bench->ring = new Spsc_ring(BENCH_RING_SAMPLES);
+	bench->mismatches = 0;
+	bench->latency_sum_ns = 0;
+	bench->latency_max_ns = 0;
+	pthread_t consumer;
+	int ret = pthread_create(&consumer, NULL, bench_consumer_thread, bench);
+	assert(ret == 0);
+	sample_rx_t block[BENCH_BLOCK_SAMPLES];
+	sample_rx_t sample = 0;
+	uint32_t n;
+	for (n = 0; n < bench->blocks_count; n++)
+	{
+		uint32_t k;
+		for (k = 0; k < BENCH_BLOCK_SAMPLES; k++)
+			block[k] = sample++;
+		if (bench->push_stamps_ns)
+		{
+			usleep(bench->push_period_us);
+			bench->push_stamps_ns[n] = plc_time_hires_stamp_to_nsec(plc_time_get_hires_stamp());
+		}
+		// Retry instead of dropping: the whole sequence is checked
+		while (bench->ring->push(block, BENCH_BLOCK_SAMPLES) != 0)
+			sched_yield();
+	}
+	pthread_join(consumer, NULL);
+	delete bench->ring;
+}
+
+static void *bench_abort_consumer_thread(void *arg)
+{
+	Spsc_ring *ring = (Spsc_ring*) arg;
+	sample_rx_t block[BENCH_BLOCK_SAMPLES];
+	return (void*) (intptr_t) ring->pop(block, BENCH_BLOCK_SAMPLES);
+}
+
+// Returns 0 if the waiting consumer returns promptly with an error
+static int bench_ring_abort(void)
+{
+	Spsc_ring *ring = new Spsc_ring(BENCH_RING_SAMPLES);
+	pthread_t consumer;
+	int ret = pthread_create(&consumer, NULL, bench_abort_consumer_thread, ring);
+	assert(ret == 0);
+	usleep(BENCH_ABORT_WAIT_US);
+	struct timespec start = plc_time_get_hires_stamp();
+	ring->abort();
+	void *pop_ret;
+	pthread_join(consumer, &pop_ret);
+	int64_t elapsed_ns = plc_time_hires_stamp_to_nsec(plc_time_get_hires_stamp())
+			- plc_time_hires_stamp_to_nsec(start);
+	delete ring;
+	int passed = ((intptr_t) pop_ret < 0) && (elapsed_ns < BENCH_ABORT_RETURN_MAX_US * 1000LL);
+	return bench_check(passed, "Abort of a waiting consumer: 'pop' returned %d after %.1f us",
+			(int) (intptr_t) pop_ret, elapsed_ns / 1000.0);
+}
+
+int bench_spsc_ring(void)
+{
+	struct bench_ring bench;
+	bench.blocks_count = BENCH_INGEST_BLOCKS;
+	bench.push_stamps_ns = NULL;
+	struct timespec start = plc_time_get_hires_stamp();
+	bench_ring_run(&bench);
+	int64_t elapsed_ns = plc_time_hires_stamp_to_nsec(plc_time_get_hires_stamp())
+			- plc_time_hires_stamp_to_nsec(start);
+	int ret = bench_check(bench.mismatches == 0, "Ingest of %u blocks of %u samples: %.1f Msps, "
+			"%u mismatches", BENCH_INGEST_BLOCKS, BENCH_BLOCK_SAMPLES,
+			1000.0 * BENCH_INGEST_BLOCKS * BENCH_BLOCK_SAMPLES / elapsed_ns, bench.mismatches);
+	bench.blocks_count = BENCH_LATENCY_BLOCKS;
+	bench.push_period_us = 1000000ULL * BENCH_BLOCK_SAMPLES / BENCH_LATENCY_RATE_SPS;
+	bench.push_stamps_ns = (int64_t*) malloc(BENCH_LATENCY_BLOCKS * sizeof(int64_t));
+	start = plc_time_get_hires_stamp();
+	bench_ring_run(&bench);
+	elapsed_ns = plc_time_hires_stamp_to_nsec(plc_time_get_hires_stamp())
+			- plc_time_hires_stamp_to_nsec(start);
+	free(bench.push_stamps_ns);
+	ret |= bench_check(bench.mismatches == 0, "Wake-up at %u sps: latency %.1f us mean, %.1f us "
+			"max. Consumer CPU %.2f%%", BENCH_LATENCY_RATE_SPS,
+			bench.latency_sum_ns / 1000.0 / BENCH_LATENCY_BLOCKS, bench.latency_max_ns / 1000.0,
+			100000.0 * bench.cpu_us / elapsed_ns);
+	ret |= bench_ring_abort();
+	return ret;
+}
@@ -0,0 +1,599 @@
+/**
+ * @file
+ * @brief	**Main** file
+ *
+ * @see		@ref application-plc-cape-decode
+ *
+ * @cond COPYRIGHT_NOTES
+ *
+ * ##LICENSE
+ *
+ *		This file is part of plc-cape project.
+ *
+ *		plc-cape project is free software: you can redistribute it and/or modify
+ *		it under the terms of the GNU General Public License as published by
+ *		the Free Software Foundation, either version 3 of the License, or
+ *		(at your option) any later version.
+ *
+ *		plc-cape project is distributed in the hope that it will be useful,
+ *		but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *		MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *		GNU General Public License for more details.
+ *
+ *		You should have received a copy of the GNU General Public License
+ *		along with plc-cape project.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @copyright
+ *	Copyright (C) 2017 Jose Maria Ortega
+ *
+ * @endcond
+ */
+
+#define _GNU_SOURCE					// Required for 'asprintf' declaration
+#include <ctype.h>					// isprint
+#include <getopt.h>
+#include <libxml/tree.h>			// xmlReadFile
+#include "+common/api/+base.h"
+#include "+common/api/bbb.h"		// ADC_MAX_CAPTURE_RATE_SPS
+#include "+common/api/setting.h"
+#include "libraries/libplc-tools/api/application.h"
+#include "libraries/libplc-tools/api/plugin.h"
+#include "libraries/libplc-tools/api/plugin_static.h"
+#include "libraries/libplc-tools/api/settings.h"
+#include "libraries/libplc-tools/api/time.h"
+#include "libraries/libplc-tools/api/trace.h"
+#include "plugins/decoder/api/decoder.h"
+
+#define DECODER_DEFAULT "decoder-ook"
+#define PROFILES_DEFAULT_REL_PATH "../plc-cape-lab/profiles.xml"
+#define CHUNK_SAMPLES_DEFAULT 2048
+#define DATA_BIT_US_DEFAULT 1000
+#define DATA_OFFSET_DEFAULT 500
+#define DATA_HI_THRESHOLD_DEFAULT 20
+#define CAPTURE_VECTOR_GRANULARITY 65536
+// Limit to the 'inherit' chain to protect against cyclic profiles
+#define PROFILE_INHERIT_DEPTH_MAX 16
+
+// Global settings shared by all the decoders. Same defaults than 'plc-cape-lab'
+struct global_settings
+{
+	float sampling_rate_sps;
+	uint32_t bit_width_us;
+	sample_rx_t data_offset;
+	sample_rx_t data_hi_threshold;
+};
+
+#ifdef DEBUG
+// To allow TRACE macros declare 'plc_debug_level' and 'plc_trace'
+int plc_debug_level = 3;
+void (*plc_trace)(const char *function_name, const char *format, ...) = plc_trace_default;
+#endif
+
+static char *decoder_name = NULL;
+static char *cmdline_decoder_name = NULL;
+static char *profile_id = NULL;
+static char *profiles_filename = NULL;
+static char *capture_filename = NULL;
+static uint32_t chunk_samples = CHUNK_SAMPLES_DEFAULT;
+static uint32_t loops = 1;
+static int legacy_api = 0;
+static int quiet = 0;
+static struct global_settings global_settings = {
+	ADC_MAX_CAPTURE_RATE_SPS, DATA_BIT_US_DEFAULT, DATA_OFFSET_DEFAULT, DATA_HI_THRESHOLD_DEFAULT };
+// Global settings explicitly set on the command line take precedence over the profile ones
+static struct global_settings cmdline_global_settings;
+// Which 'cmdline_global_settings' have been set (0 is a valid value for some of them)
+static struct
+{
+	int sampling_rate_sps;
+	int bit_width_us;
+	int data_offset;
+	int data_hi_threshold;
+} cmdline_global_settings_set;
+static struct setting_list_item *profile_setting_list = NULL;
+static struct setting_list_item *cmdline_setting_list = NULL;
+
+// '--help' message
+// NOTE: When modifying this section update 'notes.md'
+static const char usage_message[] = "Usage: plc-cape-decode [OPTION]... FILE\n"
+		"Offline decoding of a captured FILE (CSV) through a decoder plugin\n\n"
+		"  -B:US         Data bit width [us]\n"
+		"  -C:SAMPLES    Chunk size [samples] passed on each 'parse_next_samples'\n"
+		"  -D:id=value   Specify a DECODER 'value' for a setting identified as 'id'\n"
+		"  -F:FILE       Profiles file (default: " PROFILES_DEFAULT_REL_PATH ")\n"
+		"  -L:LOOPS      Number of times the capture is decoded\n"
+		"  -O:OFFSET     Data offset\n"
+		"  -P:PROFILE    Take the decoder plugin and settings from a 'plc-cape-lab' profile\n"
+		"  -q            Quiet mode (don't print the decoded data)\n"
+		"  -R:SPS        Sampling rate of the capture [sps]\n"
+		"  -T:THRESHOLD  Data HI threshold detection\n"
+		"  -U:NAME       Decoder plugin name (default: " DECODER_DEFAULT ")\n"
+		"  -V:VERSION    Decoder API version to use: 1 (parse_next_samples) or 2 (parse_spans)\n"
+		"     --help     display this help and exit\n";
+
+void pexit(const char *msg)
+{
+	fprintf(stderr, "%s", msg);
+	exit(EXIT_FAILURE);
+}
+
+void cmdline_parse_args(int argc, char *argv[])
+{
+	int n;
+	for (n = 1; n < argc; n++)
+		if (strcmp(argv[n], "--help") == 0)
+		{
+			printf("%s", usage_message);
+			exit(EXIT_SUCCESS);
+		}
+	int c;
+	while ((c = getopt(argc, argv, "B:C:D:F:L:O:P:qR:T:U:V:")) != -1)
+		switch (c)
+		{
+		case 'B':
+			cmdline_global_settings.bit_width_us = atoi(optarg + 1);
+			cmdline_global_settings_set.bit_width_us = 1;
+			break;
+		case 'C':
+			chunk_samples = atoi(optarg + 1);
+			if (chunk_samples == 0)
+				pexit("The chunk size must be greater than 0\n");
+			break;
+		case 'D':
+		{
+			struct plc_setting setting;
+			char *identifier_end = strchr(optarg + 1, '=');
+			if (identifier_end == NULL)
+				pexit("Invalid decoder setting. Expected format 'id=value'\n");
+			setting.identifier = strndup(optarg + 1, identifier_end - (optarg + 1));
+			setting.type = plc_setting_string;
+			setting.data.s = identifier_end + 1;
+			plc_setting_set_setting(&cmdline_setting_list, &setting);
+			free(setting.identifier);
+			break;
+		}
+		case 'F':
+			free(profiles_filename);
+			profiles_filename = strdup(optarg + 1);
+			break;
+		case 'L':
+			loops = atoi(optarg + 1);
+			if (loops == 0)
+				pexit("The number of loops must be greater than 0\n");
+			break;
+		case 'O':
+			cmdline_global_settings.data_offset = atoi(optarg + 1);
+			cmdline_global_settings_set.data_offset = 1;
+			break;
+		case 'P':
+			free(profile_id);
+			profile_id = strdup(optarg + 1);
+			break;
+		case 'q':
+			quiet = 1;
+			break;
+		case 'R':
+			cmdline_global_settings.sampling_rate_sps = atof(optarg + 1);
+			cmdline_global_settings_set.sampling_rate_sps = 1;
+			break;
+		case 'T':
+			cmdline_global_settings.data_hi_threshold = atoi(optarg + 1);
+			cmdline_global_settings_set.data_hi_threshold = 1;
+			break;
+		case 'U':
+			free(cmdline_decoder_name);
+			cmdline_decoder_name = strdup(optarg + 1);
+			break;
+		case 'V':
+			legacy_api = (atoi(optarg + 1) == 1);
+			break;
+		case '?':
+			// Unknown option. The proper message should have been already printed by getopt
+			exit(EXIT_FAILURE);
+		default:
+			// The 'default' should never be reached
+			assert(0);
+		}
+	if (optind != argc - 1)
+		pexit("A single capture FILE is required. Use '--help' for more information\n");
+	capture_filename = strdup(argv[optind]);
+}
+
+//
+// Profiles
+//
+
+static xmlNodePtr profiles_find_profile(xmlNodePtr root, const char *identifier)
+{
+	xmlNodePtr section, profile;
+	for (section = root->children; section != NULL; section = section->next)
+		if ((section->type == XML_ELEMENT_NODE)
+				&& (xmlStrcmp(section->name, BAD_CAST "profiles") == 0))
+			for (profile = section->children; profile != NULL; profile = profile->next)
+				if ((profile->type == XML_ELEMENT_NODE)
+						&& (xmlStrcmp(profile->name, BAD_CAST "profile") == 0))
+				{
+					xmlChar *id = xmlGetProp(profile, BAD_CAST "id");
+					int found = (id != NULL) && (xmlStrcmp(id, BAD_CAST identifier) == 0);
+					xmlFree(id);
+					if (found)
+						return profile;
+				}
+	return NULL;
+}
+
+static void profiles_apply_app_setting(const char *identifier, const char *value)
+{
+	if (strcmp(identifier, "rx_sampling_rate_sps") == 0)
+		global_settings.sampling_rate_sps = atof(value);
+	else if (strcmp(identifier, "bit_width_us") == 0)
+		global_settings.bit_width_us = atoi(value);
+	else if (strcmp(identifier, "data_offset") == 0)
+		global_settings.data_offset = atoi(value);
+	else if (strcmp(identifier, "data_hi_threshold_detection") == 0)
+		global_settings.data_hi_threshold = atoi(value);
+}
+
+static void profiles_apply_decoder_plugin(const char *plugin)
+{
+	// The settings inherited from a different decoder don't apply to the new one
+	if ((decoder_name == NULL) || (strcmp(decoder_name, plugin) != 0))
+	{
+		plc_setting_clear_settings(&profile_setting_list);
+		free(decoder_name);
+		decoder_name = strdup(plugin);
+	}
+}
+
+static void profiles_apply_profile(xmlNodePtr root, const char *identifier, int depth)
+{
+	xmlNodePtr profile = profiles_find_profile(root, identifier);
+	if (profile == NULL)
+	{
+		fprintf(stderr, "Profile '%s' not found\n", identifier);
+		exit(EXIT_FAILURE);
+	}
+	if (depth == PROFILE_INHERIT_DEPTH_MAX)
+		pexit("Too many nested profiles. Check for cyclic 'inherit' attributes\n");
+	// Apply first the base profile to allow its settings to be overriden
+	xmlChar *inherit = xmlGetProp(profile, BAD_CAST "inherit");
+	if (inherit != NULL)
+	{
+		profiles_apply_profile(root, (const char *) inherit, depth + 1);
+		xmlFree(inherit);
+	}
+	xmlNodePtr section;
+	for (section = profile->children; section != NULL; section = section->next)
+	{
+		if (section->type != XML_ELEMENT_NODE)
+			continue;
+		int app_settings = (xmlStrcmp(section->name, BAD_CAST "app-settings") == 0);
+		if (!app_settings && (xmlStrcmp(section->name, BAD_CAST "decoder-settings") != 0))
+			continue;
+		if (!app_settings)
+		{
+			xmlChar *plugin = xmlGetProp(section, BAD_CAST "plugin");
+			if (plugin != NULL)
+			{
+				profiles_apply_decoder_plugin((const char *) plugin);
+				xmlFree(plugin);
+			}
+		}
+		xmlNodePtr setting_node;
+		for (setting_node = section->children; setting_node != NULL;
+				setting_node = setting_node->next)
+		{
+			if ((setting_node->type != XML_ELEMENT_NODE)
+					|| (xmlStrcmp(setting_node->name, BAD_CAST "setting") != 0))
+				continue;
+			xmlChar *id = xmlGetProp(setting_node, BAD_CAST "id");
+			xmlChar *value = xmlNodeGetContent(setting_node);
+			assert((id != NULL) && (value != NULL));
+			// TODO: Make proper conversion from xmlChar (UTF8) to 'const char *'
+			if (app_settings)
+			{
+				profiles_apply_app_setting((const char *) id, (const char *) value);
+			}
+			else
+			{
+				struct plc_setting setting;
+				setting.identifier = (char *) id;
+				setting.type = plc_setting_string;
+				setting.data.s = (char *) value;
+				plc_setting_set_setting(&profile_setting_list, &setting);
+			}
+			xmlFree(value);
+			xmlFree(id);
+		}
+	}
+}
+
+static void profiles_load(void)
+{
+	if (profiles_filename == NULL)
+	{
+		char *app_dir = plc_application_get_abs_dir();
+		asprintf(&profiles_filename, "%s/%s", app_dir, PROFILES_DEFAULT_REL_PATH);
+		free(app_dir);
+	}
+	xmlDocPtr doc = xmlReadFile(profiles_filename, NULL, 0);
+	if (doc == NULL)
+	{
+		fprintf(stderr, "Unable to parse %s\n", profiles_filename);
+		exit(EXIT_FAILURE);
+	}
+	profiles_apply_profile(xmlDocGetRootElement(doc), profile_id, 0);
+	xmlFreeDoc(doc);
+	xmlCleanupParser();
+}
+
+//
+// Capture
+//
+
+// Accepts the CSV files generated by 'plc-cape-lab' (one sample per line) and, in general, any
+// list of samples separated by spaces, commas, semicolons or new lines
+static sample_rx_t *capture_load(const char *filename, uint32_t *samples_count)
+{
+	FILE *file = fopen(filename, "r");
+	if (file == NULL)
+	{
+		fprintf(stderr, "Unable to open %s\n", filename);
+		exit(EXIT_FAILURE);
+	}
+	uint32_t capacity = 0, count = 0;
+	sample_rx_t *samples = NULL;
+	// Lines of any length (e.g. a whole capture in a single line)
+	char *line = NULL;
+	size_t line_size = 0;
+	while (getline(&line, &line_size, file) != -1)
+	{
+		char *token = line;
+		for (;;)
+		{
+			char *token_end;
+			while ((*token == ' ') || (*token == '\t') || (*token == ',') || (*token == ';'))
+				token++;
+			unsigned long value = strtoul(token, &token_end, 10);
+			if (token_end == token)
+				break;
+			if (count == capacity)
+			{
+				capacity += CAPTURE_VECTOR_GRANULARITY;
+				samples = realloc(samples, capacity * sizeof(sample_rx_t));
+			}
+			samples[count++] = value;
+			token = token_end;
+		}
+	}
+	free(line);
+	fclose(file);
+	*samples_count = count;
+	return samples;
+}
+
+//
+// Decoding
+//
+
+static void print_data_decoded(uint8_t *data, uint32_t data_count)
+{
+	// Replace non-ASCII chars by points
+	uint8_t *buffer = data;
+	uint32_t i;
+	for (i = data_count; i > 0; i--, buffer++)
+		if (((*buffer < 0x20) || (*buffer > 0x7F)) && (*buffer != '\n'))
+			*buffer = '.';
+	printf("%.*s", data_count, data);
+}
+
+static uint32_t hires_interval_to_nsec(struct timespec t1, struct timespec t2)
+{
+	return (t2.tv_sec - t1.tv_sec) * 1000000000 + (t2.tv_nsec - t1.tv_nsec);
+}
+
+static int compare_u32(const void *a, const void *b)
+{
+	uint32_t value_a = *(const uint32_t *) a;
+	uint32_t value_b = *(const uint32_t *) b;
+	return (value_a > value_b) - (value_a < value_b);
+}
+
+static void decoder_configure(struct decoder_api *decoder_api, decoder_api_h decoder_handle,
+		struct plc_setting_named_list *settings)
+{
+	uint32_t n;
+	int ret = decoder_api->begin_settings(decoder_handle);
+	// Same global settings than the ones provided by 'plc-cape-lab' to any decoder
+	const struct plc_setting_definition *setting_definition = settings->definitions;
+	for (n = settings->definitions_count; (n > 0) && (ret == 0); n--, setting_definition++)
+	{
+		union plc_setting_data setting_data;
+		if (strcmp(setting_definition->identifier, "sampling_rate_sps") == 0)
+			setting_data.f = global_settings.sampling_rate_sps;
+		else if (strcmp(setting_definition->identifier, "data_offset") == 0)
+			setting_data.u16 = global_settings.data_offset;
+		else if (strcmp(setting_definition->identifier, "data_hi_threshold") == 0)
+			setting_data.u16 = global_settings.data_hi_threshold;
+		else if (strcmp(setting_definition->identifier, "bit_width_us") == 0)
+			setting_data.u32 = global_settings.bit_width_us;
+		else if (strcmp(setting_definition->identifier, "samples_to_file") == 0)
+			setting_data.u32 = 0;
+		else
+			continue;
+		ret = decoder_api->set_setting(decoder_handle, setting_definition->identifier,
+				setting_data);
+	}
+	const struct setting_linked_list_item *setting_item = settings->linked_list;
+	for (; (setting_item != NULL) && (ret == 0); setting_item = setting_item->next)
+		ret = decoder_api->set_setting(decoder_handle, setting_item->setting.definition->identifier,
+				setting_item->setting.data);
+	// The plugin reports the error details through its own channel
+	if ((decoder_api->end_settings(decoder_handle) != 0) || (ret != 0))
+		pexit("Invalid decoder configuration\n");
+}
+
+static void decode_capture(void)
+{
+	char *error_msg;
+	uint32_t api_version, api_size;
+	struct decoder_api *decoder_api;
+	char *plugin_path = plc_plugin_get_abs_path(plc_plugin_category_decoder, decoder_name);
+	struct plc_plugin *plugin = plc_plugin_load(plugin_path, NULL, NULL, (void**) &decoder_api,
+			&api_version, &api_size, &error_msg);
+	if (plugin == NULL)
+	{
+		fprintf(stderr, "Unable to load '%s': %s\n", plugin_path, error_msg);
+		exit(EXIT_FAILURE);
+	}
+	assert((api_version >= 1) && (api_size >= offsetof(struct decoder_api, parse_spans)));
+	if ((api_version < 2) || (api_size < sizeof(struct decoder_api)))
+		legacy_api = 1;
+	decoder_api_h decoder_handle = decoder_api->create();
+	struct plc_setting_named_list settings;
+	memset(&settings, 0, sizeof(settings));
+	settings.definitions = decoder_api->get_accepted_settings(decoder_handle,
+			&settings.definitions_count);
+	struct setting_list_item *setting_item;
+	for (setting_item = cmdline_setting_list; setting_item != NULL;
+			setting_item = setting_item->next)
+		plc_setting_set_setting(&profile_setting_list, &setting_item->setting);
+	for (setting_item = profile_setting_list; setting_item != NULL;
+			setting_item = setting_item->next)
+		if (plc_setting_find_definition(settings.definitions, settings.definitions_count,
+				setting_item->setting.identifier) == NULL)
+		{
+			fprintf(stderr, "The setting '%s' is not accepted by '%s'\n",
+					setting_item->setting.identifier, decoder_name);
+			exit(EXIT_FAILURE);
+		}
+	plc_setting_normalize(profile_setting_list, &settings);
+	decoder_configure(decoder_api, decoder_handle, &settings);
+
+	uint32_t samples_count;
+	sample_rx_t *samples = capture_load(capture_filename, &samples_count);
+	// With the legacy API only full chunks are decoded because the decoders expect
+	//	'chunk_samples' on each call
+	uint32_t chunks_per_loop =
+			legacy_api ?
+					samples_count / chunk_samples :
+					(samples_count + chunk_samples - 1) / chunk_samples;
+	if (chunks_per_loop == 0)
+		pexit("The capture is shorter than a single chunk\n");
+	uint32_t chunks_count = chunks_per_loop * loops;
+	uint32_t *chunk_latencies_ns = malloc(chunks_count * sizeof(uint32_t));
+	// Worst case for the output: one byte per sample
+	uint8_t *data = malloc(chunk_samples);
+	uint64_t data_count = 0;
+	uint64_t total_ns = 0;
+	// Samples of the incomplete last chunk decoded padded by the decoder ('parse_spans' only)
+	uint32_t tail_samples = 0;
+	uint32_t loop, chunk, chunk_index = 0;
+	for (loop = 0; loop < loops; loop++)
+	{
+		decoder_api->initialize(decoder_handle, chunk_samples);
+		const sample_rx_t *chunk_samples_ptr = samples;
+		for (chunk = 0; chunk < chunks_per_loop; chunk++, chunk_samples_ptr += chunk_samples)
+		{
+			uint32_t data_decoded;
+			struct timespec t1 = plc_time_get_hires_stamp();
+			if (legacy_api)
+			{
+				data_decoded = decoder_api->parse_next_samples(decoder_handle, chunk_samples_ptr,
+						data, chunk_samples);
+			}
+			else
+			{
+				struct decoder_span span = {
+					chunk_samples_ptr, chunk_samples };
+				if (chunk_samples_ptr + chunk_samples > samples + samples_count)
+					span.samples_count = samples + samples_count - chunk_samples_ptr;
+				uint32_t samples_consumed;
+				data_decoded = decoder_api->parse_spans(decoder_handle, &span, 1, data,
+						chunk_samples, &samples_consumed);
+				if (samples_consumed < span.samples_count)
+					pexit("Output buffer too small for the decoder\n");
+				// End of the capture -> the decoder completes its last chunk
+				if (chunk == chunks_per_loop - 1)
+				{
+					data_decoded += decoder_api->parse_spans(decoder_handle, NULL, 0,
+							data + data_decoded, chunk_samples - data_decoded, &tail_samples);
+				}
+			}
+			struct timespec t2 = plc_time_get_hires_stamp();
+			assert(data_decoded <= chunk_samples);
+			chunk_latencies_ns[chunk_index++] = hires_interval_to_nsec(t1, t2);
+			total_ns += chunk_latencies_ns[chunk_index - 1];
+			data_count += data_decoded;
+			// Print only the first loop as the next ones are expected to be equal
+			if (!quiet && (loop == 0))
+				print_data_decoded(data, data_decoded);
+		}
+		decoder_api->terminate(decoder_handle);
+	}
+	if (!quiet)
+		printf("\n");
+
+	qsort(chunk_latencies_ns, chunks_count, sizeof(uint32_t), compare_u32);
+	uint64_t samples_decoded =
+			legacy_api ?
+					(uint64_t) chunks_count * chunk_samples : (uint64_t) samples_count * loops;
+	printf("Decoder:            %s (API version %d)\n", decoder_name, legacy_api ? 1 : 2);
+	if (legacy_api)
+		printf("Samples:            %u (%u ignored at the end)\n", samples_count,
+				samples_count - chunks_per_loop * chunk_samples);
+	else
+		printf("Samples:            %u (%u in the padded tail)\n", samples_count, tail_samples);
+	printf("Chunks:             %u x %u samples x %u loops\n", chunks_per_loop, chunk_samples,
+			loops);
+	printf("Data decoded:       %llu bytes\n", (unsigned long long) data_count);
+	printf("Decoding time:      %.3f ms\n", total_ns / 1e6);
+	printf("Throughput:         %.0f samples/s (%.1fx real-time)\n",
+			samples_decoded * 1e9 / total_ns,
+			samples_decoded * 1e9 / total_ns / global_settings.sampling_rate_sps);
+	printf("Chunk latency [us]: min %.1f, mean %.1f, p50 %.1f, p90 %.1f, p99 %.1f, max %.1f\n",
+			chunk_latencies_ns[0] / 1e3, total_ns / 1e3 / chunks_count,
+			chunk_latencies_ns[chunks_count / 2] / 1e3,
+			chunk_latencies_ns[(uint64_t) chunks_count * 90 / 100] / 1e3,
+			chunk_latencies_ns[(uint64_t) chunks_count * 99 / 100] / 1e3,
+			chunk_latencies_ns[chunks_count - 1] / 1e3);
+
+	free(data);
+	free(chunk_latencies_ns);
+	free(samples);
+	plc_setting_clear_settings_linked(&settings);
+	decoder_api->release(decoder_handle);
+	plc_plugin_unload(plugin);
+	free(plugin_path);
+}
+
+int main(int argc, char *argv[])
+{
+	plc_plugin_register_static_list();
+	cmdline_parse_args(argc, argv);
+	if (profile_id)
+		profiles_load();
+	// The command line decoder takes precedence over the profile one
+	if (cmdline_decoder_name)
+		profiles_apply_decoder_plugin(cmdline_decoder_name);
+	else if (decoder_name == NULL)
+		decoder_name = strdup(DECODER_DEFAULT);
+	// Command line global settings override the profile ones
+	if (cmdline_global_settings_set.sampling_rate_sps)
+		global_settings.sampling_rate_sps = cmdline_global_settings.sampling_rate_sps;
+	if (cmdline_global_settings_set.bit_width_us)
+		global_settings.bit_width_us = cmdline_global_settings.bit_width_us;
+	if (cmdline_global_settings_set.data_offset)
+		global_settings.data_offset = cmdline_global_settings.data_offset;
+	if (cmdline_global_settings_set.data_hi_threshold)
+		global_settings.data_hi_threshold = cmdline_global_settings.data_hi_threshold;
+	decode_capture();
+	plc_setting_clear_settings(&cmdline_setting_list);
+	plc_setting_clear_settings(&profile_setting_list);
+	free(capture_filename);
+	free(profiles_filename);
+	free(profile_id);
+	free(cmdline_decoder_name);
+	free(decoder_name);
+	return EXIT_SUCCESS;
+}
@@ -301,7 +301,8 @@ void tx_fill_cycle_callback(void *handle, sample_tx_t *buffer, uint32_t buffer_c
 	}
 }
 
-void tx_on_buffer_sent_callback(void *handle, sample_tx_t *buffer, uint32_t buffer_count)
+void tx_on_buffer_sent_callback(void *handle, sample_tx_t *buffer, uint32_t buffer_count,
+		const struct plc_buffer_stamp *stamp)
 {
 	switch (tx_progress_notification_mode)
 	{
@@ -345,7 +346,7 @@ void test_valid_pointer_errno(void *pointer, const char *component)
 }
 
 static void on_buffer_completed(void *handle, sample_rx_t *samples_buffer,
-		uint32_t samples_buffer_count)
+		uint32_t samples_buffer_count, const struct plc_buffer_stamp *stamp)
 {
 	if ((capture_iteration++ < CAPTURE_ITERATIONS_TO_DISCARD) || samples_adc_filled)
 		return;
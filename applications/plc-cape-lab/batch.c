@@ -0,0 +1,275 @@
+/**
+ * @file
+ *
+ * @cond COPYRIGHT_NOTES @copyright
+ *	Copyright (C) 2017 Jose Maria Ortega\n
+ *	Distributed under the GNU GPLv3. For full terms see the file LICENSE
+ * @endcond
+ */
+
+#define _GNU_SOURCE			// 'memmem'
+#include <fnmatch.h>		// fnmatch
+#include <stdarg.h>			// va_list
+#include "+common/api/+base.h"
+#include "batch.h"
+#include "common.h"
+#include "latency.h"
+#include "libraries/libplc-adc/api/adc.h"
+#include "libraries/libplc-cape/api/tx.h"
+
+// Decoded data kept for the message checking. The bytes beyond it are only counted
+#define BATCH_DECODED_MAX 65536
+#define BATCH_FAILURES_TEXT_MAX 256
+
+struct batch
+{
+	struct batch_settings settings;
+	FILE *report;
+	uint32_t runs_count;
+	uint32_t runs_failed;
+	uint8_t *decoded;
+	uint32_t decoded_stored;
+	uint32_t decoded_count;
+};
+
+void batch_settings_set_defaults(struct batch_settings *batch_settings)
+{
+	memset(batch_settings, 0, sizeof(*batch_settings));
+	batch_settings->duration_ms = BATCH_DURATION_MS_DEFAULT;
+	batch_settings->min_messages = 1;
+}
+
+void batch_settings_release(struct batch_settings *batch_settings)
+{
+	if (batch_settings->profiles)
+	{
+		free(batch_settings->profiles);
+		batch_settings->profiles = NULL;
+	}
+	if (batch_settings->report_filename)
+	{
+		free(batch_settings->report_filename);
+		batch_settings->report_filename = NULL;
+	}
+}
+
+int batch_settings_set_threshold(struct batch_settings *batch_settings, const char *setting)
+{
+	static const struct
+	{
+		const char *identifier;
+		size_t offset;
+	} thresholds[] = {
+		{ "max_tx_underruns", offsetof(struct batch_settings, max_tx_underruns) },
+		{ "max_rx_lost", offsetof(struct batch_settings, max_rx_lost) },
+		{ "min_decoded_bytes", offsetof(struct batch_settings, min_decoded_bytes) },
+		{ "min_messages", offsetof(struct batch_settings, min_messages) } };
+	const char *value = strchr(setting, '=');
+	if (value == NULL)
+		return -1;
+	uint32_t n;
+	for (n = 0; n < ARRAY_SIZE(thresholds); n++)
+		if ((strlen(thresholds[n].identifier) == value - setting)
+				&& (strncmp(setting, thresholds[n].identifier, value - setting) == 0))
+		{
+			*(uint32_t*) ((uint8_t*) batch_settings + thresholds[n].offset) = atoi(value + 1);
+			return 0;
+		}
+	return -1;
+}
+
+struct batch *batch_create(const struct batch_settings *batch_settings)
+{
+	const char *report_filename = batch_settings->report_filename ?
+			batch_settings->report_filename : BATCH_REPORT_FILENAME_DEFAULT;
+	FILE *report = fopen(report_filename, "w");
+	if (report == NULL)
+		return NULL;
+	struct batch *batch = calloc(1, sizeof(struct batch));
+	// The strings remain owned by the caller
+	batch->settings = *batch_settings;
+	batch->report = report;
+	batch->decoded = malloc(BATCH_DECODED_MAX);
+	fprintf(report, "{\n\t\"duration_ms\": %u,\n\t\"thresholds\": { \"max_tx_underruns\": %u, "
+			"\"max_rx_lost\": %u, \"min_decoded_bytes\": %u, \"min_messages\": %u },\n"
+			"\t\"runs\": [", batch->settings.duration_ms, batch->settings.max_tx_underruns,
+			batch->settings.max_rx_lost, batch->settings.min_decoded_bytes,
+			batch->settings.min_messages);
+	return batch;
+}
+
+uint32_t batch_release(struct batch *batch)
+{
+	uint32_t runs_failed = batch->runs_failed;
+	fprintf(batch->report, "\n\t],\n\t\"passed\": %u,\n\t\"failed\": %u\n}\n",
+			batch->runs_count - batch->runs_failed, batch->runs_failed);
+	fclose(batch->report);
+	log_format("Batch finished: %u runs, %u failed\n", batch->runs_count, runs_failed);
+	free(batch->decoded);
+	free(batch);
+	return runs_failed;
+}
+
+int batch_is_profile_selected(struct batch *batch, const char *profile_identifier,
+		int profile_hidden)
+{
+	const char *profiles = batch->settings.profiles;
+	if (strcmp(profiles, "all") == 0)
+		return !profile_hidden;
+	char *profile_list = strdup(profiles);
+	char *saveptr;
+	char *pattern;
+	int selected = 0;
+	for (pattern = strtok_r(profile_list, ",", &saveptr); pattern && !selected;
+			pattern = strtok_r(NULL, ",", &saveptr))
+		if (strcmp(pattern, profile_identifier) == 0)
+			selected = 1;
+		else if (!profile_hidden && (fnmatch(pattern, profile_identifier, 0) == 0))
+			selected = 1;
+	free(profile_list);
+	return selected;
+}
+
+void batch_begin_run(struct batch *batch)
+{
+	batch->decoded_stored = 0;
+	batch->decoded_count = 0;
+}
+
+void batch_on_data_decoded(struct batch *batch, const uint8_t *data, uint32_t data_count)
+{
+	uint32_t data_to_store = BATCH_DECODED_MAX - batch->decoded_stored;
+	if (data_to_store > data_count)
+		data_to_store = data_count;
+	memcpy(batch->decoded + batch->decoded_stored, data, data_to_store);
+	batch->decoded_stored += data_to_store;
+	batch->decoded_count += data_count;
+}
+
+static uint32_t batch_count_messages(struct batch *batch, const char *message)
+{
+	size_t message_len = strlen(message);
+	if (message_len == 0)
+		return 0;
+	uint32_t messages = 0;
+	const uint8_t *data = batch->decoded;
+	const uint8_t *data_end = batch->decoded + batch->decoded_stored;
+	const uint8_t *found;
+	while ((found = memmem(data, data_end - data, message, message_len)) != NULL)
+	{
+		messages++;
+		data = found + message_len;
+	}
+	return messages;
+}
+
+static void batch_print_json_string(FILE *file, const char *text)
+{
+	if (text == NULL)
+	{
+		fputs("null", file);
+		return;
+	}
+	fputc('"', file);
+	for (; *text; text++)
+		if ((*text == '"') || (*text == '\\'))
+			fprintf(file, "\\%c", *text);
+		else if ((uint8_t) *text < 0x20)
+			fprintf(file, "\\u%04x", *text);
+		else
+			fputc(*text, file);
+	fputc('"', file);
+}
+
+// Appends a failure reason to 'failures'
+static void batch_add_failure(char *failures, const char *format, ...)
+{
+	size_t length = strlen(failures);
+	if (length > 0)
+		length += snprintf(failures + length, BATCH_FAILURES_TEXT_MAX - length, ", ");
+	if (length >= BATCH_FAILURES_TEXT_MAX)
+		return;
+	va_list args;
+	va_start(args, format);
+	vsnprintf(failures + length, BATCH_FAILURES_TEXT_MAX - length, format, args);
+	va_end(args);
+}
+
+int batch_end_run(struct batch *batch, const struct batch_run *run)
+{
+	const struct batch_settings *settings = &batch->settings;
+	char failures[BATCH_FAILURES_TEXT_MAX] = "";
+	uint32_t tx_underruns = 0;
+	uint32_t rx_lost = 0;
+	uint32_t messages = 0;
+	if (run->start_error)
+		batch_add_failure(failures, "not started");
+	if (run->tx_statistics)
+	{
+		tx_underruns = run->tx_statistics->buffers_overflow + run->tx_statistics->alsa.xruns;
+		if (tx_underruns > settings->max_tx_underruns)
+			batch_add_failure(failures, "%u TX underruns", tx_underruns);
+	}
+	if (run->adc_statistics)
+	{
+		rx_lost = run->adc_statistics->buffers_overflowed + run->adc_statistics->alsa.xruns;
+		if (rx_lost > settings->max_rx_lost)
+			batch_add_failure(failures, "%u RX buffers lost", rx_lost);
+	}
+	if (batch->decoded_count < settings->min_decoded_bytes)
+		batch_add_failure(failures, "%u bytes decoded", batch->decoded_count);
+	if (run->expected_message)
+	{
+		messages = batch_count_messages(batch, run->expected_message);
+		if (messages < settings->min_messages)
+			batch_add_failure(failures, "%u messages decoded", messages);
+	}
+	int passed = (*failures == '\0');
+	batch->runs_count++;
+	if (!passed)
+		batch->runs_failed++;
+	// Report
+	FILE *report = batch->report;
+	fprintf(report, "%s\n\t\t{\n\t\t\t\"profile\": ", (batch->runs_count > 1) ? "," : "");
+	batch_print_json_string(report, run->profile_identifier);
+	fputs(",\n\t\t\t\"title\": ", report);
+	batch_print_json_string(report, run->profile_title);
+	fprintf(report, ",\n\t\t\t\"passed\": %s,\n\t\t\t\"failures\": ", passed ? "true" : "false");
+	batch_print_json_string(report, failures);
+	fprintf(report, ",\n\t\t\t\"duration_ms\": %u", run->duration_ms);
+	if (run->tx_statistics)
+	{
+		const struct tx_statistics *tx = run->tx_statistics;
+		fprintf(report, ",\n\t\t\t\"tx\": { \"buffers\": %u, \"underruns\": %u, \"xruns\": %u, "
+				"\"preparation_max_us\": %u, \"cycle_min_us\": %u, \"cycle_max_us\": %u }",
+				tx->buffers_handled, tx->buffers_overflow, tx->alsa.xruns,
+				tx->buffer_preparation_max_us, tx->buffer_cycle_min_us, tx->buffer_cycle_max_us);
+	}
+	if (run->adc_statistics)
+	{
+		const struct plc_adc_statistics *adc = run->adc_statistics;
+		fprintf(report, ",\n\t\t\t\"rx\": { \"buffers\": %u, \"overflowed\": %u, \"xruns\": %u, "
+				"\"queue_high_water\": %u }", adc->buffers_captured, adc->buffers_overflowed,
+				adc->alsa.xruns, adc->queue_high_water);
+	}
+	fprintf(report, ",\n\t\t\t\"decoded_bytes\": %u", batch->decoded_count);
+	if (run->expected_message)
+	{
+		fputs(",\n\t\t\t\"expected_message\": ", report);
+		batch_print_json_string(report, run->expected_message);
+		fprintf(report, ",\n\t\t\t\"messages_decoded\": %u", messages);
+	}
+	if (run->latency_statistics)
+	{
+		const struct latency_statistics *latency = run->latency_statistics;
+		fprintf(report, ",\n\t\t\t\"latency_us\": { \"markers_matched\": %u, \"min\": %d, "
+				"\"mean\": %.1f, \"max\": %d, \"jitter\": %.1f }", latency->markers_matched,
+				latency->latency_min_us, latency->latency_mean_us, latency->latency_max_us,
+				latency->jitter_us);
+	}
+	fputs("\n\t\t}", report);
+	fflush(report);
+	log_format("Batch '%s': %s%s%s\n", run->profile_identifier, passed ? "PASS" : "FAIL",
+			passed ? "" : " -> ", failures);
+	return passed;
+}
@@ -0,0 +1,72 @@
+/**
+ * @file
+ * @brief	Headless batch execution of profiles with a machine-readable report
+ * @details
+ *	Each selected profile is loaded, run for a fixed duration and evaluated: TX and RX statistics,
+ *	decoded data and timings are written to a JSON report and checked against pass/fail thresholds.
+ *	When the encoder has a 'message' setting the decoded data must contain it to pass
+ *
+ * @cond COPYRIGHT_NOTES @copyright
+ *	Copyright (C) 2017 Jose Maria Ortega\n
+ *	Distributed under the GNU GPLv3. For full terms see the file LICENSE
+ * @endcond
+ */
+
+#ifndef BATCH_H
+#define BATCH_H
+
+#define BATCH_DURATION_MS_DEFAULT 5000
+#define BATCH_REPORT_FILENAME_DEFAULT "batch_report.json"
+
+struct batch;
+struct latency_statistics;
+struct plc_adc_statistics;
+struct tx_statistics;
+
+struct batch_settings
+{
+	// Comma-separated profile identifiers. Wildcards (as "loop_*") match the non-hidden profiles
+	//	and "all" all of them
+	char *profiles;
+	uint32_t duration_ms;
+	char *report_filename;
+	// Pass/fail thresholds
+	uint32_t max_tx_underruns;
+	uint32_t max_rx_lost;
+	uint32_t min_decoded_bytes;
+	uint32_t min_messages;
+};
+
+// Results of a profile run. NULL statistics for the disabled parts
+struct batch_run
+{
+	const char *profile_identifier;
+	const char *profile_title;
+	// 0 if the communication was started
+	int start_error;
+	uint32_t duration_ms;
+	const struct tx_statistics *tx_statistics;
+	const struct plc_adc_statistics *adc_statistics;
+	const struct latency_statistics *latency_statistics;
+	// Decoder message expected (NULL if the encoder doesn't send one)
+	const char *expected_message;
+};
+
+void batch_settings_set_defaults(struct batch_settings *batch_settings);
+void batch_settings_release(struct batch_settings *batch_settings);
+// Sets a threshold as 'id=value'. Returns 0 if ok or -1 if unknown
+int batch_settings_set_threshold(struct batch_settings *batch_settings, const char *setting);
+// Returns NULL if the report can't be created
+struct batch *batch_create(const struct batch_settings *batch_settings);
+// Finishes the report. Returns the number of runs failed
+uint32_t batch_release(struct batch *batch);
+int batch_is_profile_selected(struct batch *batch, const char *profile_identifier,
+		int profile_hidden);
+// Called before starting a run
+void batch_begin_run(struct batch *batch);
+// Called from the RX thread (or the decoding ones) while running
+void batch_on_data_decoded(struct batch *batch, const uint8_t *data, uint32_t data_count);
+// Called once stopped. Evaluates the run and adds it to the report. Returns 1 if passed
+int batch_end_run(struct batch *batch, const struct batch_run *run);
+
+#endif /* BATCH_H */
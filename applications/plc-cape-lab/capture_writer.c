@@ -0,0 +1,365 @@
+/**
+ * @file
+ *
+ * @cond COPYRIGHT_NOTES @copyright
+ *	Copyright (C) 2016-2017 Jose Maria Ortega\n
+ *	Distributed under the GNU GPLv3. For full terms see the file LICENSE
+ * @endcond
+ */
+
+#define _GNU_SOURCE		// O_DIRECT, asprintf
+#include <errno.h>
+#include <fcntl.h>		// open
+#include <pthread.h>
+#include <semaphore.h>
+#include <strings.h>	// strcasecmp
+#include <time.h>		// timespec
+#include <unistd.h>		// write
+#include "+common/api/+base.h"
+#include "capture_writer.h"
+#include "libraries/libplc-tools/api/capture.h"
+#include "libraries/libplc-tools/api/file.h"
+#include "libraries/libplc-tools/api/time.h"
+
+// Alignment required by O_DIRECT on the usual file systems
+#define WRITE_ALIGNMENT 4096
+// Bytes per 'write'. Multiple of WRITE_ALIGNMENT
+#define WRITE_CHUNK_BYTES (256 * 1024)
+// Longest text of a sample: 5 digits of an 'uint16_t' plus the new line
+#define SAMPLE_TEXT_MAX 6
+
+struct capture_writer
+{
+	struct capture_writer_settings settings;
+	uint32_t buffer_samples;
+	// Queue of CAPTURE_WRITER_QUEUE_DEPTH slots of 'buffer_samples' samples. The indices are
+	//	free-running counters: 'queue_head' only written by the producer, 'queue_tail' only by the
+	//	writer
+	sample_rx_t *queue;
+	uint32_t queue_samples_count[CAPTURE_WRITER_QUEUE_DEPTH];
+	int64_t queue_timestamp_ns[CAPTURE_WRITER_QUEUE_DEPTH];
+	volatile uint32_t queue_head;
+	volatile uint32_t queue_tail;
+	// Posted once per buffer queued (and on stop). 'sem_post' doesn't block neither take locks
+	sem_t buffers_queued;
+	pthread_t thread;
+	volatile int end_thread;
+	// Binary capture (PLC_CAPTURE_EXTENSION) through 'plc_capture_writer' instead of CSV
+	int binary;
+	struct plc_capture_writer *plc_capture_writer;
+	int file;
+	uint32_t file_index;
+	uint64_t file_bytes;
+	struct timespec file_stamp;
+	char *staging;
+	uint32_t staging_len;
+	struct capture_writer_statistics statistics;
+};
+
+struct capture_writer *capture_writer_create(const struct capture_writer_settings *settings,
+		uint32_t buffer_samples)
+{
+	struct capture_writer *capture_writer = calloc(1, sizeof(struct capture_writer));
+	capture_writer->settings = *settings;
+	capture_writer->settings.path = strdup(settings->path);
+	const char *extension = strrchr(settings->path, '.');
+	capture_writer->binary = extension && (strcasecmp(extension, PLC_CAPTURE_EXTENSION) == 0);
+	if (capture_writer->binary)
+		assert(settings->capture_info != NULL);
+	capture_writer->buffer_samples = buffer_samples;
+	capture_writer->queue = malloc(
+			CAPTURE_WRITER_QUEUE_DEPTH * buffer_samples * sizeof(sample_rx_t));
+	// Room for a whole chunk plus the text of the buffer that completes it
+	int ret = posix_memalign((void **) &capture_writer->staging, WRITE_ALIGNMENT,
+			WRITE_CHUNK_BYTES + buffer_samples * SAMPLE_TEXT_MAX);
+	assert(ret == 0);
+	ret = sem_init(&capture_writer->buffers_queued, 0, 0);
+	assert(ret == 0);
+	capture_writer->file = -1;
+	return capture_writer;
+}
+
+void capture_writer_release(struct capture_writer *capture_writer)
+{
+	assert((capture_writer->file < 0) && (capture_writer->plc_capture_writer == NULL));
+	sem_destroy(&capture_writer->buffers_queued);
+	free(capture_writer->staging);
+	free(capture_writer->queue);
+	free((char *) capture_writer->settings.path);
+	free(capture_writer);
+}
+
+static int capture_writer_rotation_enabled(struct capture_writer *capture_writer)
+{
+	return (capture_writer->settings.rotate_mb > 0)
+			|| (capture_writer->settings.rotate_seconds > 0);
+}
+
+static void capture_writer_set_error(struct capture_writer *capture_writer, int error)
+{
+	if (capture_writer->statistics.error == 0)
+		capture_writer->statistics.error = error;
+}
+
+static int capture_writer_open_file(struct capture_writer *capture_writer)
+{
+	char *path;
+	if (capture_writer_rotation_enabled(capture_writer))
+	{
+		const char *path_base = capture_writer->settings.path;
+		const char *extension = strrchr(path_base, '.');
+		if ((extension == NULL) || (strchr(extension, '/') != NULL))
+			extension = path_base + strlen(path_base);
+		asprintf(&path, "%.*s_%03u%s", (int) (extension - path_base), path_base,
+				capture_writer->file_index, extension);
+	}
+	else
+	{
+		path = strdup(capture_writer->settings.path);
+	}
+	if (capture_writer->binary)
+	{
+		// Each file with its own start time
+		struct plc_capture_info capture_info = *capture_writer->settings.capture_info;
+		capture_info.start_time_ns = 0;
+		capture_writer->plc_capture_writer = plc_capture_writer_create(path, &capture_info, 1);
+		free(path);
+		if (capture_writer->plc_capture_writer == NULL)
+		{
+			capture_writer_set_error(capture_writer, errno);
+			return -1;
+		}
+		capture_writer->file_index++;
+		capture_writer->file_bytes = 0;
+		capture_writer->file_stamp = plc_time_get_hires_stamp();
+		capture_writer->statistics.files_count++;
+		return 0;
+	}
+	int flags = O_CREAT | O_WRONLY | O_TRUNC;
+	mode_t mode = S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH;
+	capture_writer->file = -1;
+	if (capture_writer->settings.direct_io)
+	{
+		// Not supported on some file systems (as 'tmpfs') -> fallback to the buffered I/O
+		capture_writer->file = open(path, flags | O_DIRECT, mode);
+		capture_writer->statistics.direct_io = (capture_writer->file >= 0);
+	}
+	if (capture_writer->file < 0)
+		capture_writer->file = open(path, flags, mode);
+	free(path);
+	if (capture_writer->file < 0)
+	{
+		capture_writer_set_error(capture_writer, errno);
+		return -1;
+	}
+	capture_writer->file_index++;
+	capture_writer->file_bytes = 0;
+	capture_writer->file_stamp = plc_time_get_hires_stamp();
+	capture_writer->statistics.files_count++;
+	return 0;
+}
+
+static void capture_writer_write(struct capture_writer *capture_writer, uint32_t bytes)
+{
+	struct timespec stamp_ini = plc_time_get_hires_stamp();
+	const char *data = capture_writer->staging;
+	uint32_t bytes_pending = bytes;
+	while (bytes_pending > 0)
+	{
+		ssize_t bytes_written = write(capture_writer->file, data, bytes_pending);
+		if (bytes_written < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			capture_writer_set_error(capture_writer, errno);
+			close(capture_writer->file);
+			capture_writer->file = -1;
+			return;
+		}
+		data += bytes_written;
+		bytes_pending -= bytes_written;
+	}
+	uint32_t write_us = plc_time_hires_interval_to_usec(stamp_ini, plc_time_get_hires_stamp());
+	if (write_us > capture_writer->statistics.write_max_us)
+		capture_writer->statistics.write_max_us = write_us;
+	capture_writer->file_bytes += bytes;
+	capture_writer->statistics.bytes_written += bytes;
+	capture_writer->staging_len -= bytes;
+	memmove(capture_writer->staging, capture_writer->staging + bytes,
+			capture_writer->staging_len);
+}
+
+static void capture_writer_close_file(struct capture_writer *capture_writer)
+{
+	if (capture_writer->plc_capture_writer)
+	{
+		// The index and the final header are written here
+		if (plc_capture_writer_close(capture_writer->plc_capture_writer) < 0)
+			capture_writer_set_error(capture_writer, errno);
+		capture_writer->plc_capture_writer = NULL;
+		return;
+	}
+	if (capture_writer->file < 0)
+		return;
+	if (capture_writer->staging_len > 0)
+	{
+		// The tail is not a multiple of the alignment -> written through the page cache
+		if (capture_writer->statistics.direct_io)
+			fcntl(capture_writer->file, F_SETFL,
+					fcntl(capture_writer->file, F_GETFL) & ~O_DIRECT);
+		capture_writer_write(capture_writer, capture_writer->staging_len);
+	}
+	if (capture_writer->file >= 0)
+	{
+		close(capture_writer->file);
+		capture_writer->file = -1;
+	}
+}
+
+static int capture_writer_is_open(struct capture_writer *capture_writer)
+{
+	return (capture_writer->file >= 0) || (capture_writer->plc_capture_writer != NULL);
+}
+
+static void capture_writer_write_block(struct capture_writer *capture_writer,
+		const sample_rx_t *samples, uint32_t samples_count, int64_t timestamp_ns)
+{
+	struct timespec stamp_ini = plc_time_get_hires_stamp();
+	if (plc_capture_writer_write_block(capture_writer->plc_capture_writer, samples,
+			samples_count, timestamp_ns) < 0)
+	{
+		capture_writer_set_error(capture_writer, errno);
+		plc_capture_writer_close(capture_writer->plc_capture_writer);
+		capture_writer->plc_capture_writer = NULL;
+		return;
+	}
+	uint32_t write_us = plc_time_hires_interval_to_usec(stamp_ini, plc_time_get_hires_stamp());
+	if (write_us > capture_writer->statistics.write_max_us)
+		capture_writer->statistics.write_max_us = write_us;
+	// Approximated: the block header and the padding are not accounted
+	uint32_t bytes = samples_count * sizeof(sample_rx_t);
+	capture_writer->file_bytes += bytes;
+	capture_writer->statistics.bytes_written += bytes;
+}
+
+static void capture_writer_process_buffer(struct capture_writer *capture_writer,
+		const sample_rx_t *samples, uint32_t samples_count, int64_t timestamp_ns)
+{
+	if (!capture_writer_is_open(capture_writer))
+		return;
+	if (capture_writer->binary)
+	{
+		capture_writer_write_block(capture_writer, samples, samples_count, timestamp_ns);
+	}
+	else
+	{
+		char *text = capture_writer->staging + capture_writer->staging_len;
+		// Locale-independent and much faster than 'sprintf'
+		capture_writer->staging_len = plc_file_csv_format_items(text, csv_u16, samples,
+				samples_count) - capture_writer->staging;
+		if (capture_writer->staging_len >= WRITE_CHUNK_BYTES)
+			capture_writer_write(capture_writer, WRITE_CHUNK_BYTES);
+	}
+	capture_writer->statistics.buffers_written++;
+	if (!capture_writer_is_open(capture_writer))
+		return;
+	// Rotation on buffer boundaries
+	int rotate = 0;
+	if ((capture_writer->settings.rotate_mb > 0)
+			&& (capture_writer->file_bytes + capture_writer->staging_len
+					>= (uint64_t) capture_writer->settings.rotate_mb * 1024 * 1024))
+		rotate = 1;
+	// Compared in seconds: the microseconds intervals overflow after 35 minutes
+	if ((capture_writer->settings.rotate_seconds > 0)
+			&& (plc_time_get_hires_stamp().tv_sec - capture_writer->file_stamp.tv_sec
+					>= capture_writer->settings.rotate_seconds))
+		rotate = 1;
+	if (rotate)
+	{
+		capture_writer_close_file(capture_writer);
+		if (capture_writer->statistics.error == 0)
+			capture_writer_open_file(capture_writer);
+	}
+}
+
+static void *capture_writer_thread(void *arg)
+{
+	struct capture_writer *capture_writer = arg;
+	for (;;)
+	{
+		while (sem_wait(&capture_writer->buffers_queued) < 0)
+			assert(errno == EINTR);
+		uint32_t tail = capture_writer->queue_tail;
+		if (tail == __atomic_load_n(&capture_writer->queue_head, __ATOMIC_ACQUIRE))
+		{
+			// Only the post of 'capture_writer_stop' finds the queue empty
+			if (capture_writer->end_thread)
+				break;
+			continue;
+		}
+		uint32_t slot = tail % CAPTURE_WRITER_QUEUE_DEPTH;
+		capture_writer_process_buffer(capture_writer,
+				capture_writer->queue + slot * capture_writer->buffer_samples,
+				capture_writer->queue_samples_count[slot],
+				capture_writer->queue_timestamp_ns[slot]);
+		__atomic_store_n(&capture_writer->queue_tail, tail + 1, __ATOMIC_RELEASE);
+	}
+	capture_writer_close_file(capture_writer);
+	return NULL;
+}
+
+int capture_writer_start(struct capture_writer *capture_writer)
+{
+	capture_writer->queue_head = 0;
+	capture_writer->queue_tail = 0;
+	capture_writer->staging_len = 0;
+	capture_writer->file_index = 0;
+	memset(&capture_writer->statistics, 0, sizeof(capture_writer->statistics));
+	if (capture_writer_open_file(capture_writer) < 0)
+	{
+		errno = capture_writer->statistics.error;
+		return -1;
+	}
+	capture_writer->end_thread = 0;
+	int ret = pthread_create(&capture_writer->thread, NULL, capture_writer_thread, capture_writer);
+	assert(ret == 0);
+	return 0;
+}
+
+void capture_writer_stop(struct capture_writer *capture_writer)
+{
+	capture_writer->end_thread = 1;
+	sem_post(&capture_writer->buffers_queued);
+	int ret = pthread_join(capture_writer->thread, NULL);
+	assert(ret == 0);
+}
+
+int capture_writer_push_samples(struct capture_writer *capture_writer,
+		const sample_rx_t *samples, uint32_t samples_count, int64_t timestamp_ns)
+{
+	assert(samples_count <= capture_writer->buffer_samples);
+	uint32_t head = capture_writer->queue_head;
+	uint32_t backlog = head - __atomic_load_n(&capture_writer->queue_tail, __ATOMIC_ACQUIRE);
+	if (backlog >= CAPTURE_WRITER_QUEUE_DEPTH)
+	{
+		capture_writer->statistics.buffers_dropped++;
+		return -1;
+	}
+	uint32_t slot = head % CAPTURE_WRITER_QUEUE_DEPTH;
+	memcpy(capture_writer->queue + slot * capture_writer->buffer_samples, samples,
+			samples_count * sizeof(sample_rx_t));
+	capture_writer->queue_samples_count[slot] = samples_count;
+	capture_writer->queue_timestamp_ns[slot] = timestamp_ns;
+	__atomic_store_n(&capture_writer->queue_head, head + 1, __ATOMIC_RELEASE);
+	if (backlog + 1 > capture_writer->statistics.queue_high_water)
+		capture_writer->statistics.queue_high_water = backlog + 1;
+	sem_post(&capture_writer->buffers_queued);
+	return 0;
+}
+
+// PRECONDITION: writer stopped (the counters are not synchronized)
+void capture_writer_get_statistics(struct capture_writer *capture_writer,
+		struct capture_writer_statistics *statistics)
+{
+	*statistics = capture_writer->statistics;
+}
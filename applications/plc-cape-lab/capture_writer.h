@@ -0,0 +1,71 @@
+/**
+ * @file
+ * @brief	Streaming of the captured samples to disk from a dedicated writer thread
+ * @details
+ *	The capturing thread copies each buffer into a lock-free single-producer/single-consumer queue
+ *	and never blocks: if the writer can't keep the pace the new buffers are dropped and counted. The
+ *	writer thread formats the samples as CSV (the same format than 'plc_file_write_csv') into a
+ *	large aligned staging buffer written in big chunks, optionally bypassing the page cache
+ *	(O_DIRECT). If the path has the PLC_CAPTURE_EXTENSION the samples are written instead as
+ *	blocks of a binary capture file (libplc-tools/api/capture.h) with the timestamps given. The
+ *	output can be split in several files by size or by time
+ *
+ * @cond COPYRIGHT_NOTES @copyright
+ *	Copyright (C) 2016-2017 Jose Maria Ortega\n
+ *	Distributed under the GNU GPLv3. For full terms see the file LICENSE
+ * @endcond
+ */
+
+#ifndef CAPTURE_WRITER_H
+#define CAPTURE_WRITER_H
+
+// Buffers queued before dropping new ones. At 200 ksps with 2048-sample buffers it absorbs disk
+//	stalls of about 2.6 seconds
+#define CAPTURE_WRITER_QUEUE_DEPTH 256
+
+struct capture_writer;
+struct plc_capture_info;
+
+struct capture_writer_settings
+{
+	// On rotation a 3-digit index is inserted before the extension: 'adc_000.csv', 'adc_001.csv'...
+	const char *path;
+	// Max size of each file (0 for no rotation by size)
+	uint32_t rotate_mb;
+	// Max time covered by each file (0 for no rotation by time)
+	uint32_t rotate_seconds;
+	// Bypass the page cache. Ignored if not supported by the file system or on binary captures
+	int direct_io;
+	// Metadata of the binary captures. Only required for them
+	const struct plc_capture_info *capture_info;
+};
+
+struct capture_writer_statistics
+{
+	uint32_t buffers_written;
+	uint32_t buffers_dropped;
+	uint32_t queue_high_water;
+	uint32_t files_count;
+	uint64_t bytes_written;
+	uint32_t write_max_us;
+	int direct_io;
+	// 'errno' of the first open or write error. The writing is aborted on error
+	int error;
+};
+
+struct capture_writer *capture_writer_create(const struct capture_writer_settings *settings,
+		uint32_t buffer_samples);
+void capture_writer_release(struct capture_writer *capture_writer);
+// Opens the first file and starts the writer thread. Returns -1 on error ('errno' set)
+int capture_writer_start(struct capture_writer *capture_writer);
+// Writes the queued buffers before terminating the writer thread
+void capture_writer_stop(struct capture_writer *capture_writer);
+// Called from the capturing thread. Never blocks. Returns -1 if the samples are dropped.
+// 'timestamp_ns' is the monotonic time of the buffer (as in 'plc_buffer_stamp')
+// PRECONDITION: samples_count <= buffer_samples
+int capture_writer_push_samples(struct capture_writer *capture_writer,
+		const sample_rx_t *samples, uint32_t samples_count, int64_t timestamp_ns);
+void capture_writer_get_statistics(struct capture_writer *capture_writer,
+		struct capture_writer_statistics *statistics);
+
+#endif /* CAPTURE_WRITER_H */
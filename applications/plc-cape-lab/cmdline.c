@@ -11,6 +11,7 @@
 #include <ctype.h>				// isprint
 #include <getopt.h>
 #include "+common/api/+base.h"
+#include "batch.h"
 #include "common.h"
 #include "libraries/libplc-cape/api/tx.h"
 #include "libraries/libplc-tools/api/cmdline.h"
@@ -21,20 +22,27 @@
 static const char usage_message[] = "Usage: plc-cape-lab [OPTION]...\n"
 		"\"Laboratory\" to experiment with the PlcCape board\n\n"
 		"  -A:MODE       Select ADC receiving mode\n"
+		"  -B:PROFILES   Batch mode: run the comma-separated profiles ('*' wildcards or 'all')\n"
+		"                and exit with failure if any of them doesn't pass the thresholds\n"
 		"  -d            Forces the application to use the standard drivers\n"
 		"  -D:id=value   Speficy a DECODER 'value' for a setting identified as 'id'\n"
 		"  -E:id=value   Speficy an ENCODER 'value' for a setting identified as 'id'\n"
 		"  -F:SPS        SPI sampling rate [sps]\n"
+		"  -G:DURATION   Duration of each batch run [ms]\n"
 		"  -I:INTERVAL   Repetitive test interval [ms]\n"
 		"  -J:INTERVAL   Max duration for the test [ms]\n"
 		"  -L:DELAY      Samples delay [us]\n"
 		"  -N:SIZE       Buffer size [samples]\n"
+		"  -O:FILE       Batch report file (JSON)\n"
 		"  -P:PROFILE    Select a predefined profile\n"
 		"  -q            Quiet mode\n"
+		"  -R:FILE       Replay a capture file (plccap, raw, WAV or CSV)\n"
 		"  -S:MODE       SPI transmitting mode\n"
 		"  -T:MODE       Operating mode\n"
 		"  -U:NAME       UI plugin name (without extension)\n"
-		"  -W:SAMPLES    Received samples to be stored in a file\n"
+		"  -V:id=value   Batch threshold: max_tx_underruns, max_rx_lost, min_decoded_bytes or\n"
+		"                min_messages\n"
+		"  -W:SAMPLES    Received samples to be stored in a file (0 until stopped)\n"
 		"  -x            Auto start\n"
 		"  -Y:TYPE       Stream type\n"
 		"     --help     display this help and exit\n\n"
@@ -51,13 +59,13 @@ const char *cmdline_get_usage_message(void)
 void cmdline_parse_args(int argc, char *argv[], char **error_msg, struct settings *settings,
 		char **ui_plugin_name, char **initial_profile,
 		struct setting_list_item **encoder_setting_list,
-		struct setting_list_item **decoder_setting_list)
+		struct setting_list_item **decoder_setting_list, struct batch_settings *batch_settings)
 {
 	int c;
 	// Disable 'getopt' messages printed to stderr because we use here a custom handler
 	opterr = 0;
 	*error_msg = NULL;
-	while ((c = getopt(argc, argv, "A:dD:E:F:I:J:L:N:P:qS:T:U:W:xY:")) != -1)
+	while ((c = getopt(argc, argv, "A:B:dD:E:F:G:I:J:L:N:O:P:qR:S:T:U:V:W:xY:")) != -1)
 		switch (c)
 		{
 		case 'A':
@@ -66,6 +74,11 @@ void cmdline_parse_args(int argc, char *argv[], char **error_msg, struct setting
 					rx_mode_COUNT)) != NULL)
 				return;
 			break;
+		case 'B':
+			if (batch_settings->profiles)
+				free(batch_settings->profiles);
+			batch_settings->profiles = strdup(optarg + 1);
+			break;
 		case 'd':
 			settings->std_driver = 1;
 			break;
@@ -91,6 +104,9 @@ void cmdline_parse_args(int argc, char *argv[], char **error_msg, struct setting
 		case 'F':
 			settings->tx.sampling_rate_sps = atoi(optarg + 1);
 			break;
+		case 'G':
+			batch_settings->duration_ms = atoi(optarg + 1);
+			break;
 		case 'I':
 			settings->communication_interval_ms = atoi(optarg + 1);
 			break;
@@ -103,6 +119,11 @@ void cmdline_parse_args(int argc, char *argv[], char **error_msg, struct setting
 		case 'N':
 			settings->tx.tx_buffers_len = atoi(optarg + 1);
 			break;
+		case 'O':
+			if (batch_settings->report_filename)
+				free(batch_settings->report_filename);
+			batch_settings->report_filename = strdup(optarg + 1);
+			break;
 		case 'P':
 			if (*initial_profile)
 				free(*initial_profile);
@@ -111,6 +132,11 @@ void cmdline_parse_args(int argc, char *argv[], char **error_msg, struct setting
 		case 'q':
 			settings->quietmode = 1;
 			break;
+		case 'R':
+			if (settings->rx.replay_filename)
+				free(settings->rx.replay_filename);
+			settings->rx.replay_filename = strdup(optarg + 1);
+			break;
 		case 'S':
 			if ((*error_msg = plc_cmdline_set_enum_value_with_checking(optarg,
 					(int*) &settings->tx.tx_mode, "SPI transmission mode", spi_tx_mode_enum_text,
@@ -128,8 +154,17 @@ void cmdline_parse_args(int argc, char *argv[], char **error_msg, struct setting
 				free(*ui_plugin_name);
 			*ui_plugin_name = strdup(optarg + 1);
 			break;
+		case 'V':
+			if (batch_settings_set_threshold(batch_settings, optarg + 1) < 0)
+			{
+				asprintf(error_msg, "Invalid batch threshold '%s'. Expected format 'id=value'\n",
+						optarg + 1);
+				return;
+			}
+			break;
 		case 'W':
-			settings->rx.samples_to_file = atoi(optarg + 1);
+			settings->rx.samples_file = 1;
+			settings->rx.samples_to_file = strtoull(optarg + 1, NULL, 10);
 			break;
 		case 'x':
 			settings->autostart = 1;
@@ -11,6 +11,7 @@
 #ifndef CMDLINE_H
 #define CMDLINE_H
 
+struct batch_settings;
 struct settings;
 struct setting_list_item;
 
@@ -18,6 +19,6 @@ const char *cmdline_get_usage_message(void);
 void cmdline_parse_args(int argc, char *argv[], char **error_msg, struct settings *settings,
 		char **ui_plugin_name, char **initial_profile,
 		struct setting_list_item **encoder_setting_list,
-		struct setting_list_item **decoder_setting_list);
+		struct setting_list_item **decoder_setting_list, struct batch_settings *batch_settings);
 
 #endif /* CMDLINE_H */
@@ -8,17 +8,20 @@
  */
 
 #define _GNU_SOURCE				// Required for 'asprintf' declaration
+#include <errno.h>
 #include <signal.h>				// SIGEV_THREAD
 #include <time.h>				// CLOCK_REALTIME
 #include <unistd.h>
 #include "+common/api/+base.h"
 #include "+common/api/setting.h"
 #include "+common/api/ui.h"		// event_id_tx_flag
+#include "batch.h"
 #include "cmdline.h"
 #include "common.h"
 #include "controller.h"
 #include "decoder.h"
 #include "encoder.h"
+#include "latency.h"
 #include "libraries/libplc-adc/api/adc.h"
 #include "libraries/libplc-cape/api/afe.h"
 // Castings to simplify usage of 'cape.h'
@@ -30,6 +33,7 @@ typedef struct monitor *tx_on_buffer_sent_callback_h;
 #include "libraries/libplc-cape/api/leds.h"
 #include "libraries/libplc-cape/api/tx.h"
 #include "libraries/libplc-tools/api/plugin.h"
+#include "libraries/libplc-tools/api/settings.h"
 #include "libraries/libplc-tools/api/time.h"
 #include "profiles.h"
 #include "rx.h"
@@ -38,8 +42,14 @@ typedef struct monitor *tx_on_buffer_sent_callback_h;
 #include "ui.h"
 
 #define UI_PLUGIN_NAME_DEFAULT "ui-ncurses"
+// Used in batch mode unless explicitly selected
+#define UI_PLUGIN_NAME_BATCH "ui-console"
+#define BATCH_POLLING_INTERVAL_US 100000
 #define SIG_COMUNICATION_TIMER SIGRTMIN
 #define SUPERVISOR_PERIOD_MS 500
+// Logger rings pre-created for the threads logging (main, TX, ADC capture, RX, monitor, timers
+//	and workers), so the real-time ones don't allocate on their first message
+#define LOG_RINGS_PRECREATED 8
 
 // Global variables
 int in_emulation_mode = 0;
@@ -59,7 +69,10 @@ static struct plc_tx *plc_tx = NULL;
 static struct encoder *encoder = NULL;
 static sample_tx_t *tx_preload_buffer = NULL;
 static struct decoder *decoder = NULL;
+static struct decoder **extra_decoders = NULL;
+static uint32_t extra_decoders_count = 0;
 static struct monitor *monitor = NULL;
+static struct latency *latency = NULL;
 static struct plc_plugin_list *encoder_plugins = NULL;
 static struct plc_plugin_list *decoder_plugins = NULL;
 static struct profiles *profiles = NULL;
@@ -82,6 +95,7 @@ static void controller_flags_callback(void *data, int tx_flag, int rx_flag, int
 	ui_set_event(ui, event_id_tx_flag, tx_flag);
 	ui_set_event(ui, event_id_rx_flag, rx_flag);
 	ui_set_event(ui, event_id_ok_flag, ok_flag);
+	monitor_on_afe_flags(monitor, tx_flag, rx_flag, ok_flag);
 }
 
 void controller_encoder_set_default_configuration(void)
@@ -104,7 +118,8 @@ void controller_decoder_apply_configuration(void)
 	// NOTE: By default reuse 'settings->rx.data_hi_threshold_detection' for 'data_hi_threshold'
 	decoder_apply_configuration(decoder, settings->rx.data_offset,
 			settings->rx.data_hi_threshold_detection, settings->rx.sampling_rate_sps,
-			settings->bit_width_us, settings->rx.samples_to_file);
+			settings->bit_width_us, (settings->rx.samples_to_file < UINT32_MAX) ?
+					settings->rx.samples_to_file : UINT32_MAX);
 }
 
 // PRECONDITION: encoder_plugins->active_index != (uint32_t)-1
@@ -164,6 +179,87 @@ void controller_push_profile(const char *profile_identifier,
 	settings->configuration_profile = strdup(profile_identifier);
 }
 
+// Creates the decoders running in parallel to the main one on 'demod_mode_parallel'. Each one is
+//	configured with the decoder settings of a profile listed in 'rx_extra_decoders', allowing to
+//	decode simultaneously different modulations or variants of parameters
+static void controller_create_extra_decoders(void)
+{
+	assert(extra_decoders == NULL);
+	if ((settings->rx.extra_decoders == NULL) || (*settings->rx.extra_decoders == '\0'))
+		return;
+	char *profile_list = strdup(settings->rx.extra_decoders);
+	char *profile_list_state;
+	const char *profile_identifier;
+	for (profile_identifier = strtok_r(profile_list, ",", &profile_list_state);
+			profile_identifier != NULL;
+			profile_identifier = strtok_r(NULL, ",", &profile_list_state))
+	{
+		// Use auxiliary settings to not alter the active ones
+		struct settings *profile_settings = settings_create();
+		struct setting_list_item *encoder_settings = NULL;
+		struct setting_list_item *decoder_settings = NULL;
+		char *encoder_name;
+		char *decoder_name;
+		profiles_push_profile_settings(profiles, profile_identifier, profile_settings,
+				&encoder_name, &encoder_settings, &decoder_name, &decoder_settings);
+		if ((decoder_name != NULL)
+				&& (plc_plugin_list_find_name(decoder_plugins, decoder_name) != -1))
+		{
+			char *plugin_path = plc_plugin_get_abs_path(plc_plugin_category_decoder,
+					decoder_name);
+			struct decoder *extra_decoder = decoder_create(plugin_path);
+			free(plugin_path);
+			decoder_set_configuration(extra_decoder, decoder_settings);
+			decoder_apply_configuration(extra_decoder, settings->rx.data_offset,
+					settings->rx.data_hi_threshold_detection, settings->rx.sampling_rate_sps,
+					settings->bit_width_us, 0);
+			if (decoder_is_ready(extra_decoder))
+			{
+				extra_decoders = realloc(extra_decoders,
+						(extra_decoders_count + 1) * sizeof(struct decoder *));
+				extra_decoders[extra_decoders_count++] = extra_decoder;
+			}
+			else
+			{
+				log_format("Invalid decoder configuration on profile '%s' -> ignored\n",
+						profile_identifier);
+				decoder_release(extra_decoder);
+			}
+		}
+		else
+		{
+			log_format("Profile '%s' without a valid decoder -> ignored\n", profile_identifier);
+		}
+		if (encoder_name)
+			free(encoder_name);
+		if (decoder_name)
+			free(decoder_name);
+		plc_setting_clear_settings(&decoder_settings);
+		plc_setting_clear_settings(&encoder_settings);
+		settings_release(profile_settings);
+	}
+	free(profile_list);
+}
+
+// TX fill callback: the encoder samples with the latency markers (if enabled) overwriting them
+static void controller_prepare_next_samples(struct encoder *encoder, uint16_t *buffer,
+		uint32_t buffer_count)
+{
+	encoder_prepare_next_samples(encoder, buffer, buffer_count);
+	if (latency)
+		latency_tx_embed_marker(latency, buffer, buffer_count);
+}
+
+static void controller_release_extra_decoders(void)
+{
+	uint32_t n;
+	for (n = 0; n < extra_decoders_count; n++)
+		decoder_release(extra_decoders[n]);
+	free(extra_decoders);
+	extra_decoders = NULL;
+	extra_decoders_count = 0;
+}
+
 static void controller_initialize(int reload_plugins,
 		const struct setting_list_item *encoder_settings,
 		const struct setting_list_item *decoder_settings)
@@ -187,7 +283,12 @@ static void controller_initialize(int reload_plugins,
 		break;
 	}
 	// TX & RX devices
-	if (!in_emulation_mode)
+	if (settings->rx.replay_filename && (*settings->rx.replay_filename != '\0'))
+	{
+		settings->tx.device = in_emulation_mode ? plc_tx_device_alsa : plc_tx_device_plc_cape;
+		settings->rx.device = plc_rx_device_replay;
+	}
+	else if (!in_emulation_mode)
 	{
 		settings->tx.device = plc_tx_device_plc_cape;
 		settings->rx.device =
@@ -225,11 +326,12 @@ static void controller_initialize(int reload_plugins,
 			controller_reload_encoder_plugin();
 			encoder_set_configuration(encoder, encoder_settings);
 		}
-		plc_tx = plc_tx_create(settings->tx.device, encoder_prepare_next_samples, encoder,
+		plc_tx = plc_tx_create(settings->tx.device, controller_prepare_next_samples, encoder,
 				monitor_on_buffer_sent, monitor, settings->tx.tx_mode,
 				settings->tx.sampling_rate_sps, settings->tx.tx_buffers_len, plc_afe);
 		if (plc_tx == NULL)
 			log_line_and_exit("Error at 'plc_tx' component initialization");
+		plc_tx_set_alsa_settings(plc_tx, &settings->tx.alsa);
 		settings->tx.sampling_rate_sps = plc_tx_get_effective_sampling_rate(plc_tx);
 		monitor_set_tx(monitor, plc_tx);
 		// Some encoder may depend on 'sampling_rate_sps' which also may depend on 'plc_tx'
@@ -246,21 +348,69 @@ static void controller_initialize(int reload_plugins,
 			decoder_set_configuration(decoder, decoder_settings);
 		}
 		controller_decoder_apply_configuration();
-		plc_adc = plc_adc_create(settings->rx.device);
+		if (settings->rx.device == plc_rx_device_replay)
+		{
+			plc_adc = plc_adc_create_replay(settings->rx.replay_filename,
+					settings->rx.replay_paced);
+			if (plc_adc == NULL)
+				log_line_and_exit("Error loading the RX replay file");
+			// The sampling rate stored in the file (if any) prevails
+			float replay_rate_sps = plc_adc_get_sampling_frequency(plc_adc);
+			if (replay_rate_sps > 0.0f)
+				settings->rx.sampling_rate_sps = replay_rate_sps;
+		}
+		else
+		{
+			plc_adc = plc_adc_create(settings->rx.device);
+			plc_adc_set_alsa_settings(plc_adc, &settings->rx.alsa);
+		}
 		monitor_set_adc(monitor, plc_adc);
 		struct rx_settings rx_settings;
 		rx_settings.rx_mode = settings->rx.rx_mode;
 		rx_settings.capturing_rate_sps = settings->rx.sampling_rate_sps;
 		rx_settings.samples_filename = settings->rx.samples_filename;
 		rx_settings.data_filename = settings->rx.data_filename;
+		rx_settings.samples_file = settings->rx.samples_file || settings->rx.samples_to_file;
 		rx_settings.samples_to_file = settings->rx.samples_to_file;
+		rx_settings.file_rotate_mb = settings->rx.file_rotate_mb;
+		rx_settings.file_rotate_seconds = settings->rx.file_rotate_seconds;
+		rx_settings.file_direct_io = settings->rx.file_direct_io;
+		memset(&rx_settings.capture_info, 0, sizeof(rx_settings.capture_info));
+		rx_settings.capture_info.sample_bits = ADC_BITS;
+		rx_settings.capture_info.device = settings->rx.device;
+		rx_settings.capture_info.sampling_rate_sps = settings->rx.sampling_rate_sps;
+		rx_settings.capture_info.afe_gain_rx_pga1 = settings->rx.gain_rx_pga1;
+		rx_settings.capture_info.afe_gain_rx_pga2 = settings->rx.gain_rx_pga2;
+		rx_settings.capture_info.afe_cenelec_a = settings->cenelec_a;
 		rx_settings.demod_mode = settings->rx.demod_mode;
+		rx_settings.deferred_threads = settings->rx.deferred_threads;
+		rx_settings.deferred_overlap_bits = settings->rx.deferred_overlap_bits;
+		rx_settings.deferred_verify = settings->rx.deferred_verify;
 		rx_settings.bit_width_us = settings->bit_width_us;
 		rx_settings.data_offset = settings->rx.data_offset;
 		rx_settings.data_hi_threshold_detection = settings->rx.data_hi_threshold_detection;
-		rx = rx_create(&rx_settings, monitor, plc_leds, plc_adc, decoder);
+		if (settings->rx.demod_mode == demod_mode_parallel)
+			controller_create_extra_decoders();
+		rx = rx_create(&rx_settings, monitor, plc_leds, plc_adc, decoder, extra_decoders,
+				extra_decoders_count);
 		TRACE(3, "TX mode prepared");
 	}
+	if (settings->latency_marker_ms > 0)
+	{
+		// The markers require the levels to reach the RX undistorted
+		if (plc_tx && plc_adc && ((settings->tx.device == plc_tx_device_alsa)
+				|| (settings->tx.device == plc_tx_device_internal_fifo))
+				&& (settings->rx.device != plc_rx_device_replay))
+		{
+			latency = latency_create(settings->tx.sampling_rate_sps,
+					settings->rx.sampling_rate_sps, settings->latency_marker_ms);
+			monitor_set_latency(monitor, latency);
+		}
+		else
+		{
+			log_line("Latency markers ignored: they require TX and RX on emulated devices");
+		}
+	}
 	monitor_set_profile(monitor, settings->monitor_profile);
 }
 
@@ -273,6 +423,8 @@ static void controller_terminate(int release_plugins)
 		rx_release(rx);
 		rx = NULL;
 	}
+	if (extra_decoders)
+		controller_release_extra_decoders();
 	if (release_plugins && decoder)
 	{
 		decoder_release(decoder);
@@ -302,10 +454,112 @@ static void controller_terminate(int release_plugins)
 	{
 		monitor_set_adc(monitor, NULL);
 		monitor_set_tx(monitor, NULL);
+		monitor_set_latency(monitor, NULL);
 	}
+	if (latency)
+	{
+		latency_release(latency);
+		latency = NULL;
+	}
+}
+
+// Message sent by the encoder (if any) to be checked in the decoded data. Release with 'free'
+static char *controller_get_encoder_message(void)
+{
+	if (encoder == NULL)
+		return NULL;
+	struct setting_linked_list_item *item;
+	for (item = encoder_get_settings(encoder); item != NULL; item = item->next)
+		if (strcmp(item->setting.definition->identifier, "message") == 0)
+			return plc_setting_linked_data_to_text(&item->setting);
+	return NULL;
+}
+
+// Runs the profiles selected in batch mode. Returns the number of runs failed or -1 on error or
+//	if no profile is selected
+// Returns 1 once the RX replay file has been delivered completely
+static int controller_replay_ended(void)
+{
+	if (!plc_adc || (settings->rx.device != plc_rx_device_replay))
+		return 0;
+	struct plc_adc_statistics adc_statistics;
+	plc_adc_get_statistics(plc_adc, &adc_statistics);
+	return adc_statistics.end_of_capture;
+}
+
+static int controller_run_batch(const struct batch_settings *batch_settings)
+{
+	struct batch *batch = batch_create(batch_settings);
+	if (batch == NULL)
+	{
+		log_format("Batch report can't be created: %s\n", strerror(errno));
+		return -1;
+	}
+	monitor_set_batch(monitor, batch);
+	uint32_t runs_count = 0;
+	profiles_iterator *iterator;
+	for (iterator = profiles_move_to_first_profile(profiles); iterator != NULL;
+			iterator = profiles_move_to_next_profile(iterator))
+	{
+		const char *profile_identifier = profiles_current_profile_get_identifier(iterator);
+		if (!batch_is_profile_selected(batch, profile_identifier,
+				profiles_current_profile_is_hidden(iterator)))
+			continue;
+		log_format("Batch '%s'...\n", profile_identifier);
+		runs_count++;
+		controller_reload_configuration_profile(profile_identifier);
+		// The duration is set by the batch
+		settings->communication_timeout_ms = 0;
+		settings->communication_interval_ms = 0;
+		struct batch_run run;
+		memset(&run, 0, sizeof(run));
+		run.profile_identifier = profile_identifier;
+		run.profile_title = profiles_current_profile_get_title(iterator);
+		char *encoder_message = controller_get_encoder_message();
+		if (decoder)
+			run.expected_message = encoder_message;
+		batch_begin_run(batch);
+		uint32_t tick_ini_ms = plc_time_get_tick_ms();
+		controller_activate_async();
+		run.start_error = !controller_communication_in_progress;
+		if (controller_activated)
+		{
+			// 'usleep' can be interrupted by signals. A replay ends the run when exhausted
+			while ((plc_time_get_tick_ms() - tick_ini_ms < batch_settings->duration_ms)
+					&& !controller_replay_ended())
+				usleep(BATCH_POLLING_INTERVAL_US);
+			controller_deactivate();
+		}
+		run.duration_ms = plc_time_get_tick_ms() - tick_ini_ms;
+		struct plc_adc_statistics adc_statistics;
+		struct latency_statistics latency_statistics;
+		if (plc_tx && (settings->tx.tx_mode != spi_tx_mode_none))
+			run.tx_statistics = plc_tx_get_tx_statistics(plc_tx);
+		if (plc_adc && (settings->rx.rx_mode != rx_mode_none))
+		{
+			plc_adc_get_statistics(plc_adc, &adc_statistics);
+			run.adc_statistics = &adc_statistics;
+		}
+		if (latency)
+		{
+			latency_get_statistics(latency, &latency_statistics);
+			run.latency_statistics = &latency_statistics;
+		}
+		batch_end_run(batch, &run);
+		if (encoder_message)
+			free(encoder_message);
+	}
+	monitor_set_batch(monitor, NULL);
+	uint32_t runs_failed = batch_release(batch);
+	if (runs_count == 0)
+	{
+		log_format("No profile matches '%s'\n", batch_settings->profiles);
+		return -1;
+	}
+	return runs_failed;
 }
 
-void controller_create(int argc, char *argv[])
+int controller_create(int argc, char *argv[])
 {
 	TRACE(3, "Initializing settings");
 	settings = settings_create();
@@ -325,8 +579,10 @@ void controller_create(int argc, char *argv[])
 	struct setting_list_item *decoder_explicit_settings = NULL;
 	char *initial_profile = NULL;
 	char *ui_plugin_name = strdup(UI_PLUGIN_NAME_DEFAULT);
+	struct batch_settings batch_settings;
+	batch_settings_set_defaults(&batch_settings);
 	cmdline_parse_args(argc, argv, &error_msg, settings, &ui_plugin_name, &initial_profile,
-			&encoder_explicit_settings, &decoder_explicit_settings);
+			&encoder_explicit_settings, &decoder_explicit_settings, &batch_settings);
 	if (error_msg != NULL)
 	{
 		log_line(error_msg);
@@ -334,6 +590,11 @@ void controller_create(int argc, char *argv[])
 		log_line(cmdline_get_usage_message());
 		exit(EXIT_FAILURE);
 	}
+	if (batch_settings.profiles && (strcmp(ui_plugin_name, UI_PLUGIN_NAME_DEFAULT) == 0))
+	{
+		free(ui_plugin_name);
+		ui_plugin_name = strdup(UI_PLUGIN_NAME_BATCH);
+	}
 
 	TRACE(3, "Configuring profile");
 	if (initial_profile != NULL)
@@ -370,6 +631,10 @@ void controller_create(int argc, char *argv[])
 
 	TRACE(3, "Creating logger");
 	logger = logger_create_log_text((void*) ui_log_text, ui);
+	if ((settings->log_ring_kb > 0)
+			&& (logger_start_async(logger, settings->log_ring_kb * 1024, LOG_RINGS_PRECREATED)
+					< 0))
+		log_line("Asynchronous logger unavailable: logging synchronously");
 	singletons_provider_initialize();
 
 	// Initialize device
@@ -383,6 +648,8 @@ void controller_create(int argc, char *argv[])
 
 	TRACE(3, "Creating 'monitor'");
 	monitor = monitor_create(ui);
+	if (monitor_start_metrics_export(monitor, settings->metrics_file, settings->metrics_socket) < 0)
+		log_format("Metrics export disabled: %s\n", strerror(errno));
 
 	TRACE(3, "Starting controller");
 	controller_initialize(1, encoder_settings, decoder_settings);
@@ -392,6 +659,14 @@ void controller_create(int argc, char *argv[])
 	plc_setting_clear_settings(&encoder_settings);
 
 	TRACE(3, "Controller started");
+	if (batch_settings.profiles)
+	{
+		int runs_failed = controller_run_batch(&batch_settings);
+		batch_settings_release(&batch_settings);
+		// Returned to 'main' for the same clean-up than the interactive mode
+		return (runs_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+	batch_settings_release(&batch_settings);
 	if (settings->autostart)
 	{
 		controller_activate_async();
@@ -408,6 +683,7 @@ void controller_create(int argc, char *argv[])
 			pause();
 	else
 		ui_do_menu_loop(ui);
+	return EXIT_SUCCESS;
 }
 
 void controller_release(void)
@@ -509,6 +785,10 @@ static int controller_start_communication(void)
 		plc_afe_activate_blocks(plc_afe, afe_blocks);
 		plc_afe_set_dac_mode(plc_afe, 1);
 	}
+	// Before starting the devices: their callbacks update the monitor
+	monitor_reset(monitor);
+	if (latency)
+		latency_reset(latency);
 	if (settings->tx.tx_mode != spi_tx_mode_none)
 	{
 		encoder_reset(encoder);
@@ -578,6 +858,8 @@ static void controller_stop_communication(void)
 		}
 	}
 	monitor_stop(monitor);
+	if (latency)
+		latency_log_report(latency);
 	if (plc_afe)
 	{
 		plc_afe_set_dac_mode(plc_afe, 0);
@@ -18,7 +18,8 @@ struct settings;
 struct ui;
 
 // 'controller' is a singleton object
-void controller_create(int argc, char *argv[]);
+// Returns the exit status of the application once finished (a batch or the menu loop)
+int controller_create(int argc, char *argv[]);
 void controller_release(void);
 void controller_encoder_set_default_configuration(void);
 void controller_decoder_set_default_configuration(void);
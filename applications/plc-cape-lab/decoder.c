@@ -7,21 +7,35 @@
  * @endcond
  */
 
+#include <math.h>			// ceil
 #include "+common/api/+base.h"
 #include "common.h"
 #include "decoder.h"
+#include "libraries/libplc-tools/api/chunker.h"
 #include "libraries/libplc-tools/api/settings.h"	// plc_setting_named_list
 #include "plugins.h"
 #include "plugins/decoder/api/decoder.h"
 
 struct decoder
 {
-	struct plugin *plugin;
+	struct plc_plugin *plugin;
 	struct decoder_api *api;
 	decoder_api_h api_handle;
+	char *path;
 	char *name;
 	struct plc_setting_named_list settings;
 	int invalid_configuration;
+	// Plugins with API version 1 don't support 'parse_spans' -> adapted through a chunker
+	int spans_supported;
+	struct plc_chunker *chunker;
+	// Last configuration applied, required by 'decoder_duplicate'
+	sample_rx_t data_offset;
+	sample_rx_t data_hi_threshold;
+	float capturing_rate_sps;
+	uint32_t bit_width_us;
+	uint32_t samples_to_file;
+	// Index of the first sample decoded in the whole capture
+	uint32_t first_sample;
 };
 
 struct decoder *decoder_create(const char *path)
@@ -29,8 +43,10 @@ struct decoder *decoder_create(const char *path)
 	struct decoder *decoder = calloc(1, sizeof(struct decoder));
 	uint32_t api_version, api_size;
 	decoder->plugin = load_plugin(path, (void**) &decoder->api, &api_version, &api_size);
-	assert((api_version >= 1) && (api_size >= sizeof(struct decoder_api)));
+	assert((api_version >= 1) && (api_size >= offsetof(struct decoder_api, parse_spans)));
+	decoder->spans_supported = (api_version >= 2) && (api_size >= sizeof(struct decoder_api));
 	decoder->api_handle = decoder->api->create();
+	decoder->path = strdup(path);
 	decoder->name = strdup(strrchr(path, '/') + 1);
 	decoder->settings.definitions = decoder->api->get_accepted_settings(decoder->api_handle,
 			&decoder->settings.definitions_count);
@@ -41,6 +57,7 @@ void decoder_release(struct decoder *decoder)
 {
 	plc_setting_clear_settings_linked(&decoder->settings);
 	free(decoder->name);
+	free(decoder->path);
 	decoder->api->release(decoder->api_handle);
 	unload_plugin(decoder->plugin);
 	free(decoder);
@@ -65,6 +82,11 @@ void decoder_apply_configuration(struct decoder *decoder,
 		uint32_t bit_width_us, uint32_t samples_to_file)
 {
 	uint32_t n;
+	decoder->data_offset = data_offset;
+	decoder->data_hi_threshold = data_hi_threshold;
+	decoder->capturing_rate_sps = capturing_rate_sps;
+	decoder->bit_width_us = bit_width_us;
+	decoder->samples_to_file = samples_to_file;
 	int ret = decoder->api->begin_settings(decoder->api_handle);
 	if (ret == 0)
 	{
@@ -98,6 +120,11 @@ void decoder_apply_configuration(struct decoder *decoder,
 				assert(setting_definition->type == plc_setting_u32);
 				setting_data.u32 = samples_to_file;
 			}
+			else if (strcmp(setting_definition->identifier, "first_sample") == 0)
+			{
+				assert(setting_definition->type == plc_setting_u32);
+				setting_data.u32 = decoder->first_sample;
+			}
 			else
 			{
 				// Continue with the loop without specific processing
@@ -131,13 +158,57 @@ void decoder_apply_configuration(struct decoder *decoder,
 	decoder->invalid_configuration = (ret != 0);
 }
 
-inline void decoder_initialize_demodulator(struct decoder *decoder, uint32_t chunk_samples)
+struct decoder *decoder_duplicate(struct decoder *decoder, uint32_t first_sample)
+{
+	struct decoder *duplicate = decoder_create(decoder->path);
+	duplicate->first_sample = first_sample;
+	struct setting_list_item *setting_list = NULL;
+	const struct setting_linked_list_item *setting_item = decoder->settings.linked_list;
+	for (; setting_item != NULL; setting_item = setting_item->next)
+	{
+		struct plc_setting setting;
+		setting.identifier = (char *) setting_item->setting.definition->identifier;
+		setting.type = setting_item->setting.definition->type;
+		setting.data = setting_item->setting.data;
+		plc_setting_set_setting(&setting_list, &setting);
+	}
+	decoder_set_configuration(duplicate, setting_list);
+	plc_setting_clear_settings(&setting_list);
+	// The duplicate doesn't dump to file to not overwrite the one of the original decoder
+	decoder_apply_configuration(duplicate, decoder->data_offset, decoder->data_hi_threshold,
+			decoder->capturing_rate_sps, decoder->bit_width_us, 0);
+	return duplicate;
+}
+
+static uint32_t decoder_parse_chunk_legacy(void *handle, const sample_rx_t *chunk,
+		uint8_t *data_out, uint32_t data_out_count)
+{
+	struct decoder *decoder = handle;
+	return decoder->api->parse_next_samples(decoder->api_handle, chunk, data_out, data_out_count);
+}
+
+void decoder_initialize_demodulator(struct decoder *decoder, uint32_t chunk_samples)
 {
 	decoder->api->initialize(decoder->api_handle, chunk_samples);
+	if (!decoder->spans_supported)
+	{
+		// Same bound than the one used by 'rx' for the output buffers: one data per 8 bits
+		float samples_per_bit = decoder->capturing_rate_sps * decoder->bit_width_us / 1000000.0f;
+		uint32_t chunk_data_max =
+				(samples_per_bit > 0.0f) ?
+						ceil(chunk_samples / samples_per_bit / 8.0f) : chunk_samples;
+		decoder->chunker = plc_chunker_create(chunk_samples, chunk_data_max,
+				decoder_parse_chunk_legacy, decoder);
+	}
 }
 
-inline void decoder_terminate_demodulator(struct decoder *decoder)
+void decoder_terminate_demodulator(struct decoder *decoder)
 {
+	if (decoder->chunker)
+	{
+		plc_chunker_release(decoder->chunker);
+		decoder->chunker = NULL;
+	}
 	decoder->api->terminate(decoder->api_handle);
 }
 
@@ -148,6 +219,18 @@ inline uint32_t decoder_parse_next_samples(struct decoder *decoder, const sample
 			buffer_data_out_count);
 }
 
+uint32_t decoder_parse_spans(struct decoder *decoder, const struct decoder_span *spans,
+		uint32_t spans_count, uint8_t *buffer_data_out, uint32_t buffer_data_out_count,
+		uint32_t *samples_consumed)
+{
+	if (decoder->spans_supported)
+		return decoder->api->parse_spans(decoder->api_handle, spans, spans_count, buffer_data_out,
+				buffer_data_out_count, samples_consumed);
+	return plc_chunker_push_spans(decoder->chunker, (const struct plc_chunker_span*) spans,
+			spans_count, decoder->data_offset, buffer_data_out, buffer_data_out_count,
+			samples_consumed);
+}
+
 int decoder_is_ready(struct decoder *decoder)
 {
 	return !decoder->invalid_configuration;
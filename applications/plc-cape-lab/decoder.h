@@ -14,9 +14,13 @@
 #define DECODER_H
 
 struct decoder;
+struct decoder_span;
 struct setting_list_item;
 
 struct decoder *decoder_create(const char *path);
+// Creates a new instance of the same plugin with the same configuration, to decode the capture
+//	from its sample 'first_sample' (the plugins accepting 'first_sample' keep the carrier phase)
+struct decoder *decoder_duplicate(struct decoder *decoder, uint32_t first_sample);
 void decoder_release(struct decoder *decoder);
 void decoder_set_configuration(struct decoder *decoder, const struct setting_list_item *setting_list);
 void decoder_set_default_configuration(struct decoder *decoder);
@@ -27,6 +31,12 @@ void decoder_initialize_demodulator(struct decoder *decoder, uint32_t chunk_samp
 void decoder_terminate_demodulator(struct decoder *decoder);
 uint32_t decoder_parse_next_samples(struct decoder *decoder, const sample_rx_t *buffer_in,
 		uint8_t *buffer_data_out, uint32_t buffer_data_out_count);
+// Decodes any number of samples split in 'spans'. Legacy plugins are supported by regrouping the
+//	samples in chunks of the size provided on 'decoder_initialize_demodulator'. Without spans the
+//	incomplete tail is decoded padded, at the end of the stream
+uint32_t decoder_parse_spans(struct decoder *decoder, const struct decoder_span *spans,
+		uint32_t spans_count, uint8_t *buffer_data_out, uint32_t buffer_data_out_count,
+		uint32_t *samples_consumed);
 int decoder_is_ready(struct decoder *decoder);
 struct setting_linked_list_item *decoder_get_settings(struct decoder *decoder);
 const char *decoder_get_name(struct decoder *decoder);
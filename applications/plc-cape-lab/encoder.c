@@ -16,7 +16,7 @@
 
 struct encoder
 {
-	struct plugin *plugin;
+	struct plc_plugin *plugin;
 	struct encoder_api *api;
 	encoder_api_h api_handle;
 	char *name;
@@ -0,0 +1,253 @@
+/**
+ * @file
+ *
+ * @cond COPYRIGHT_NOTES @copyright
+ *	Copyright (C) 2016-2017 Jose Maria Ortega\n
+ *	Distributed under the GNU GPLv3. For full terms see the file LICENSE
+ * @endcond
+ */
+
+#include <pthread.h>
+#include "+common/api/+base.h"
+#include "decoder.h"
+#include "fanout.h"
+#include "libraries/libplc-adc/api/adc.h"
+#include "libraries/libplc-tools/api/time.h"
+
+struct fanout_buffer
+{
+	// Number of decoders still using the buffer
+	volatile uint32_t references;
+	struct fanout_buffer *next_free;
+	// ADC buffer retained while in use
+	const sample_rx_t *samples;
+};
+
+// The queue and the statistics are protected by the mutex of the fan-out
+struct fanout_worker
+{
+	struct fanout *fanout;
+	uint32_t index;
+	struct decoder *decoder;
+	pthread_t thread;
+	pthread_cond_t condition;
+	struct fanout_buffer *queue[FANOUT_QUEUE_DEPTH];
+	uint32_t queue_head;
+	uint32_t queue_count;
+	int end_thread;
+	uint8_t *buffer_data;
+	struct fanout_statistics statistics;
+};
+
+struct fanout
+{
+	struct plc_adc *plc_adc;
+	uint32_t buffer_samples;
+	uint32_t buffer_data_count;
+	fanout_on_data_decoded_t on_data_decoded;
+	void *on_data_decoded_handle;
+	// A single lock for all the queues: a push from the ADC consumer thread takes it once whatever
+	//	the number of decoders
+	pthread_mutex_t mutex;
+	struct fanout_buffer *buffers;
+	struct fanout_buffer *free_list;
+	struct fanout_worker *workers;
+	uint32_t workers_count;
+};
+
+struct fanout *fanout_create(struct plc_adc *plc_adc, struct decoder **decoders,
+		uint32_t decoders_count, uint32_t buffer_samples, uint32_t buffer_data_count,
+		fanout_on_data_decoded_t on_data_decoded, void *on_data_decoded_handle)
+{
+	assert(decoders_count > 0);
+	struct fanout *fanout = calloc(1, sizeof(struct fanout));
+	fanout->plc_adc = plc_adc;
+	fanout->buffer_samples = buffer_samples;
+	fanout->buffer_data_count = buffer_data_count;
+	fanout->on_data_decoded = on_data_decoded;
+	fanout->on_data_decoded_handle = on_data_decoded_handle;
+	uint32_t buffers_count = FANOUT_BUFFERS_RETAINED_MAX(decoders_count);
+	fanout->buffers = calloc(buffers_count, sizeof(struct fanout_buffer));
+	uint32_t n;
+	for (n = 0; n < buffers_count; n++)
+	{
+		fanout->buffers[n].next_free = fanout->free_list;
+		fanout->free_list = &fanout->buffers[n];
+	}
+	int ret = pthread_mutex_init(&fanout->mutex, NULL);
+	assert(ret == 0);
+	fanout->workers_count = decoders_count;
+	fanout->workers = calloc(decoders_count, sizeof(struct fanout_worker));
+	for (n = 0; n < decoders_count; n++)
+	{
+		struct fanout_worker *worker = &fanout->workers[n];
+		worker->fanout = fanout;
+		worker->index = n;
+		worker->decoder = decoders[n];
+		worker->buffer_data = malloc(buffer_data_count);
+		ret = pthread_cond_init(&worker->condition, NULL);
+		assert(ret == 0);
+	}
+	return fanout;
+}
+
+void fanout_release(struct fanout *fanout)
+{
+	uint32_t n;
+	for (n = 0; n < fanout->workers_count; n++)
+	{
+		struct fanout_worker *worker = &fanout->workers[n];
+		int ret = pthread_cond_destroy(&worker->condition);
+		assert(ret == 0);
+		free(worker->buffer_data);
+	}
+	free(fanout->workers);
+	int ret = pthread_mutex_destroy(&fanout->mutex);
+	assert(ret == 0);
+	free(fanout->buffers);
+	free(fanout);
+}
+
+// PRECONDITION: 'fanout->mutex' locked
+static void fanout_free_buffer(struct fanout *fanout, struct fanout_buffer *buffer)
+{
+	buffer->next_free = fanout->free_list;
+	fanout->free_list = buffer;
+}
+
+static void *fanout_worker_thread(void *arg)
+{
+	struct fanout_worker *worker = arg;
+	struct fanout *fanout = worker->fanout;
+	pthread_mutex_lock(&fanout->mutex);
+	while (1)
+	{
+		while (!worker->end_thread && (worker->queue_count == 0))
+			pthread_cond_wait(&worker->condition, &fanout->mutex);
+		// On termination the pending buffers are still decoded
+		if (worker->queue_count == 0)
+			break;
+		struct fanout_buffer *buffer = worker->queue[worker->queue_head];
+		if (++worker->queue_head == FANOUT_QUEUE_DEPTH)
+			worker->queue_head = 0;
+		worker->queue_count--;
+		pthread_mutex_unlock(&fanout->mutex);
+		struct timespec stamp_ini = plc_time_get_hires_stamp();
+		uint32_t data_decoded = decoder_parse_next_samples(worker->decoder, buffer->samples,
+				worker->buffer_data, fanout->buffer_data_count);
+		// The last decoder gives the ADC buffer back to its pool
+		int buffer_done = (__sync_sub_and_fetch(&buffer->references, 1) == 0);
+		if (buffer_done)
+			plc_adc_release_buffer(fanout->plc_adc, buffer->samples);
+		assert(data_decoded <= fanout->buffer_data_count);
+		if ((data_decoded > 0) && fanout->on_data_decoded)
+			fanout->on_data_decoded(fanout->on_data_decoded_handle, worker->index,
+					worker->buffer_data, data_decoded);
+		uint32_t processing_us = plc_time_hires_interval_to_usec(stamp_ini,
+				plc_time_get_hires_stamp());
+		// A single lock to account the buffer and to wait for the next one
+		pthread_mutex_lock(&fanout->mutex);
+		if (buffer_done)
+			fanout_free_buffer(fanout, buffer);
+		worker->statistics.buffers_processed++;
+		worker->statistics.data_decoded += data_decoded;
+		if (processing_us > worker->statistics.processing_max_us)
+			worker->statistics.processing_max_us = processing_us;
+	}
+	pthread_mutex_unlock(&fanout->mutex);
+	return NULL;
+}
+
+void fanout_start(struct fanout *fanout)
+{
+	uint32_t n;
+	for (n = 0; n < fanout->workers_count; n++)
+	{
+		struct fanout_worker *worker = &fanout->workers[n];
+		worker->queue_head = 0;
+		worker->queue_count = 0;
+		worker->end_thread = 0;
+		memset(&worker->statistics, 0, sizeof(worker->statistics));
+		int ret = pthread_create(&worker->thread, NULL, fanout_worker_thread, worker);
+		assert(ret == 0);
+	}
+}
+
+void fanout_stop(struct fanout *fanout)
+{
+	uint32_t n;
+	pthread_mutex_lock(&fanout->mutex);
+	for (n = 0; n < fanout->workers_count; n++)
+	{
+		fanout->workers[n].end_thread = 1;
+		pthread_cond_signal(&fanout->workers[n].condition);
+	}
+	pthread_mutex_unlock(&fanout->mutex);
+	for (n = 0; n < fanout->workers_count; n++)
+	{
+		int ret = pthread_join(fanout->workers[n].thread, NULL);
+		assert(ret == 0);
+	}
+}
+
+void fanout_push_buffer(struct fanout *fanout, const sample_rx_t *samples_buffer)
+{
+	uint32_t n;
+	pthread_mutex_lock(&fanout->mutex);
+	struct fanout_buffer *buffer = fanout->free_list;
+	if (buffer == NULL)
+	{
+		// All the blocks are retained by the slowest decoders -> lost for everybody
+		for (n = 0; n < fanout->workers_count; n++)
+			fanout->workers[n].statistics.buffers_dropped++;
+		pthread_mutex_unlock(&fanout->mutex);
+		return;
+	}
+	fanout->free_list = buffer->next_free;
+	buffer->samples = samples_buffer;
+	uint32_t references = 0;
+	for (n = 0; n < fanout->workers_count; n++)
+	{
+		struct fanout_worker *worker = &fanout->workers[n];
+		if (worker->queue_count < FANOUT_QUEUE_DEPTH)
+		{
+			uint32_t queue_tail = worker->queue_head + worker->queue_count;
+			if (queue_tail >= FANOUT_QUEUE_DEPTH)
+				queue_tail -= FANOUT_QUEUE_DEPTH;
+			worker->queue[queue_tail] = buffer;
+			worker->queue_count++;
+			if (worker->queue_count > worker->statistics.backlog_max)
+				worker->statistics.backlog_max = worker->queue_count;
+			references++;
+		}
+		else
+		{
+			worker->statistics.buffers_dropped++;
+		}
+	}
+	if (references > 0)
+	{
+		// No copy: the ADC buffer is kept out of its pool until the last decoder releases it.
+		//	The workers can't dequeue it before the unlock
+		plc_adc_retain_buffer(fanout->plc_adc, samples_buffer);
+		buffer->references = references;
+		for (n = 0; n < fanout->workers_count; n++)
+			pthread_cond_signal(&fanout->workers[n].condition);
+	}
+	else
+	{
+		fanout_free_buffer(fanout, buffer);
+	}
+	pthread_mutex_unlock(&fanout->mutex);
+}
+
+void fanout_get_statistics(struct fanout *fanout, uint32_t decoder_index,
+		struct fanout_statistics *statistics)
+{
+	assert(decoder_index < fanout->workers_count);
+	struct fanout_worker *worker = &fanout->workers[decoder_index];
+	pthread_mutex_lock(&fanout->mutex);
+	*statistics = worker->statistics;
+	statistics->backlog = worker->queue_count;
+	pthread_mutex_unlock(&fanout->mutex);
+}
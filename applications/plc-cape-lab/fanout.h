@@ -0,0 +1,64 @@
+/**
+ * @file
+ * @brief	Fan-out of the received buffers to several decoders running on worker threads
+ * @details
+ *	Each captured buffer is retained out of the ADC pool, without copying it, and shared by all the
+ *	decoders through a reference count. The last decoder done with it gives it back to the pool.
+ *	Every decoder runs on its own thread with a bounded queue. When a decoder can't keep the pace
+ *	the new buffers are dropped for it, without blocking the capture neither the other decoders.
+ *	All the queues share a lock, so a buffer is published to every decoder with a single lock
+ *
+ * @cond COPYRIGHT_NOTES @copyright
+ *	Copyright (C) 2016-2017 Jose Maria Ortega\n
+ *	Distributed under the GNU GPLv3. For full terms see the file LICENSE
+ * @endcond
+ */
+
+#ifndef FANOUT_H
+#define FANOUT_H
+
+// Pending buffers per decoder before dropping new ones
+#define FANOUT_QUEUE_DEPTH 8
+// ADC buffers retained simultaneously by 'decoders_count' decoders: each one may hold a full queue
+//	plus the buffer it is decoding, all different when they drop different buffers, plus the one
+//	being pushed. The ADC pool must be deeper than this to keep capturing
+#define FANOUT_BUFFERS_RETAINED_MAX(decoders_count) \
+	((decoders_count) * (FANOUT_QUEUE_DEPTH + 1) + 1)
+
+struct decoder;
+struct fanout;
+struct plc_adc;
+
+struct fanout_statistics
+{
+	uint32_t buffers_processed;
+	uint32_t buffers_dropped;
+	uint32_t backlog;
+	uint32_t backlog_max;
+	uint32_t data_decoded;
+	uint32_t processing_max_us;
+};
+
+/**
+ * @brief	Callback invoked from the worker threads with the data decoded
+ * @param	handle			Custom handle provided at creation time
+ * @param	decoder_index	Index of the decoder in the array provided at creation time
+ * @param	data			Data decoded
+ * @param	data_count		Number of bytes in _data_
+ */
+typedef void (*fanout_on_data_decoded_t)(void *handle, uint32_t decoder_index, uint8_t *data,
+		uint32_t data_count);
+
+// The buffers pushed are retained from 'plc_adc' (zero-copy) until all the decoders process them
+struct fanout *fanout_create(struct plc_adc *plc_adc, struct decoder **decoders,
+		uint32_t decoders_count, uint32_t buffer_samples, uint32_t buffer_data_count,
+		fanout_on_data_decoded_t on_data_decoded, void *on_data_decoded_handle);
+void fanout_release(struct fanout *fanout);
+void fanout_start(struct fanout *fanout);
+// Waits for the queued buffers to be decoded before terminating the worker threads
+void fanout_stop(struct fanout *fanout);
+void fanout_push_buffer(struct fanout *fanout, const sample_rx_t *samples_buffer);
+void fanout_get_statistics(struct fanout *fanout, uint32_t decoder_index,
+		struct fanout_statistics *statistics);
+
+#endif /* FANOUT_H */
@@ -0,0 +1,351 @@
+/**
+ * @file
+ *
+ * @cond COPYRIGHT_NOTES @copyright
+ *	Copyright (C) 2017 Jose Maria Ortega\n
+ *	Distributed under the GNU GPLv3. For full terms see the file LICENSE
+ * @endcond
+ */
+
+#include <math.h>		// ceil, fabsf, sqrt
+#include <pthread.h>
+#include "+common/api/+base.h"
+#include "common.h"
+#include "latency.h"
+#include "libraries/libplc-cape/api/afe.h"
+
+// Marker symbols: the sync pattern, a LO start symbol, the identifier and its complement (MSB first)
+#define MARKER_SYNC_SYMBOLS 9
+#define MARKER_DATA_SYMBOLS 17
+#define MARKER_SYMBOLS (MARKER_SYNC_SYMBOLS + MARKER_DATA_SYMBOLS)
+#define MARKER_TX_LO 0
+#define MARKER_TX_HI (AFE_DAC_MAX_RANGE - 1)
+// The DAC extremes reach the RX as 0 and AFE_DAC_MAX_RANGE-1 through the internal fifo and as 0
+//	and ADC_RANGE-4 through ALSA -> a threshold valid for both paths
+#define MARKER_RX_THRESHOLD (AFE_DAC_MAX_RANGE / 2)
+// The identifier is 8-bit
+#define MARKERS_IN_FLIGHT 256
+// Minimum RX samples per symbol for a reliable detection
+#define RX_SYMBOL_SAMPLES_MIN 2.0f
+
+static const uint8_t marker_sync[MARKER_SYNC_SYMBOLS] = { 1, 1, 1, 1, 0, 0, 0, 0, 1 };
+// Upper bounds of the bins of the jitter distribution. An extra bin holds the longer deviations
+static const uint32_t jitter_bins_us[] = { 50, 100, 200, 500, 1000, 2000, 5000 };
+
+struct marker_in_flight
+{
+	int64_t tx_ns;
+	int64_t rx_ns;
+	int tx_valid;
+	int rx_valid;
+};
+
+struct latency
+{
+	uint32_t tx_symbol_samples;
+	float rx_symbol_samples;
+	double rx_ns_per_sample;
+	uint32_t marker_interval_samples;
+	// Only accessed from the TX thread
+	uint32_t tx_buffers_filled;
+	uint32_t tx_samples_since_marker;
+	uint32_t tx_markers_embedded;
+	int tx_marker_pending;
+	uint8_t tx_marker_id;
+	uint32_t tx_marker_sequence;
+	// Only accessed from the RX thread. The sync is detected by the lengths of the last runs of
+	//	samples at the same level; the data symbols are then sampled at their centers
+	uint64_t rx_sample_index;
+	uint32_t rx_sequence_expected;
+	int rx_level;
+	uint32_t rx_run;
+	uint32_t rx_runs[3];
+	int rx_decoding;
+	double rx_marker_start;
+	double rx_next_symbol;
+	uint32_t rx_symbols_decoded;
+	uint32_t rx_data;
+	// Shared by the TX and RX threads
+	pthread_mutex_t mutex;
+	struct marker_in_flight markers[MARKERS_IN_FLIGHT];
+	struct latency_statistics statistics;
+	double latency_sum_us;
+	double latency_sum_squares_us;
+	int32_t *latencies_us;
+	uint32_t latencies_count;
+};
+
+struct latency *latency_create(float tx_sampling_rate_sps, float rx_sampling_rate_sps,
+		uint32_t marker_interval_ms)
+{
+	struct latency *latency = calloc(1, sizeof(struct latency));
+	latency->tx_symbol_samples = LATENCY_MARKER_SYMBOL_SAMPLES;
+	// Longer symbols if the RX is slower than the TX
+	if (latency->tx_symbol_samples * rx_sampling_rate_sps / tx_sampling_rate_sps
+			< RX_SYMBOL_SAMPLES_MIN)
+		latency->tx_symbol_samples = ceil(
+				RX_SYMBOL_SAMPLES_MIN * tx_sampling_rate_sps / rx_sampling_rate_sps);
+	latency->rx_symbol_samples = latency->tx_symbol_samples * rx_sampling_rate_sps
+			/ tx_sampling_rate_sps;
+	latency->rx_ns_per_sample = 1e9 / rx_sampling_rate_sps;
+	latency->marker_interval_samples = (uint64_t) marker_interval_ms * tx_sampling_rate_sps / 1000;
+	latency->latencies_us = malloc(LATENCY_SAMPLES_MAX * sizeof(int32_t));
+	int ret = pthread_mutex_init(&latency->mutex, NULL);
+	assert(ret == 0);
+	latency_reset(latency);
+	return latency;
+}
+
+void latency_release(struct latency *latency)
+{
+	int ret = pthread_mutex_destroy(&latency->mutex);
+	assert(ret == 0);
+	free(latency->latencies_us);
+	free(latency);
+}
+
+static void latency_reset_detector(struct latency *latency)
+{
+	latency->rx_level = 0;
+	latency->rx_run = 0;
+	memset(latency->rx_runs, 0, sizeof(latency->rx_runs));
+	latency->rx_decoding = 0;
+}
+
+void latency_reset(struct latency *latency)
+{
+	latency->tx_buffers_filled = 0;
+	latency->tx_samples_since_marker = 0;
+	latency->tx_markers_embedded = 0;
+	latency->tx_marker_pending = 0;
+	latency->rx_sample_index = 0;
+	latency->rx_sequence_expected = 0;
+	latency_reset_detector(latency);
+	pthread_mutex_lock(&latency->mutex);
+	memset(latency->markers, 0, sizeof(latency->markers));
+	memset(&latency->statistics, 0, sizeof(latency->statistics));
+	latency->latency_sum_us = 0.0;
+	latency->latency_sum_squares_us = 0.0;
+	latency->latencies_count = 0;
+	pthread_mutex_unlock(&latency->mutex);
+}
+
+void latency_tx_embed_marker(struct latency *latency, sample_tx_t *buffer, uint32_t buffer_count)
+{
+	uint32_t sequence = latency->tx_buffers_filled++;
+	latency->tx_samples_since_marker += buffer_count;
+	// The marker must fit in a single buffer
+	if ((latency->tx_samples_since_marker < latency->marker_interval_samples)
+			|| (buffer_count < MARKER_SYMBOLS * latency->tx_symbol_samples))
+		return;
+	latency->tx_samples_since_marker = 0;
+	uint8_t id = latency->tx_markers_embedded++;
+	uint32_t data = ((uint32_t) id << 8) | (uint8_t) ~id;
+	uint32_t n;
+	for (n = 0; n < MARKER_SYMBOLS; n++)
+	{
+		int symbol = (n < MARKER_SYNC_SYMBOLS) ? marker_sync[n] :
+				(data >> (MARKER_SYMBOLS - 1 - n)) & 1;
+		sample_tx_t value = symbol ? MARKER_TX_HI : MARKER_TX_LO;
+		uint32_t i;
+		for (i = latency->tx_symbol_samples; i > 0; i--)
+			*buffer++ = value;
+	}
+	// The identifier is reused every MARKERS_IN_FLIGHT markers
+	pthread_mutex_lock(&latency->mutex);
+	memset(&latency->markers[id], 0, sizeof(latency->markers[id]));
+	pthread_mutex_unlock(&latency->mutex);
+	latency->tx_marker_id = id;
+	latency->tx_marker_sequence = sequence;
+	latency->tx_marker_pending = 1;
+}
+
+// PRECONDITION: 'mutex' locked
+static void latency_add_measurement(struct latency *latency, struct marker_in_flight *marker)
+{
+	int32_t latency_us = (marker->rx_ns - marker->tx_ns) / 1000;
+	struct latency_statistics *statistics = &latency->statistics;
+	if ((statistics->markers_matched == 0) || (latency_us < statistics->latency_min_us))
+		statistics->latency_min_us = latency_us;
+	if ((statistics->markers_matched == 0) || (latency_us > statistics->latency_max_us))
+		statistics->latency_max_us = latency_us;
+	statistics->markers_matched++;
+	latency->latency_sum_us += latency_us;
+	latency->latency_sum_squares_us += (double) latency_us * latency_us;
+	if (latency->latencies_count < LATENCY_SAMPLES_MAX)
+		latency->latencies_us[latency->latencies_count++] = latency_us;
+	marker->tx_valid = 0;
+	marker->rx_valid = 0;
+}
+
+void latency_tx_on_buffer_sent(struct latency *latency, const struct plc_buffer_stamp *stamp)
+{
+	if (!latency->tx_marker_pending || (stamp->sequence != latency->tx_marker_sequence))
+		return;
+	latency->tx_marker_pending = 0;
+	pthread_mutex_lock(&latency->mutex);
+	struct marker_in_flight *marker = &latency->markers[latency->tx_marker_id];
+	latency->statistics.markers_sent++;
+	// The marker is at the beginning of the buffer
+	marker->tx_ns = stamp->timestamp_ns;
+	marker->tx_valid = 1;
+	// The RX may have detected it before this callback
+	if (marker->rx_valid)
+		latency_add_measurement(latency, marker);
+	pthread_mutex_unlock(&latency->mutex);
+}
+
+static void latency_rx_on_marker(struct latency *latency, uint8_t id, int64_t rx_ns)
+{
+	pthread_mutex_lock(&latency->mutex);
+	struct marker_in_flight *marker = &latency->markers[id];
+	latency->statistics.markers_received++;
+	if (!marker->rx_valid)
+	{
+		marker->rx_ns = rx_ns;
+		marker->rx_valid = 1;
+		if (marker->tx_valid)
+			latency_add_measurement(latency, marker);
+	}
+	pthread_mutex_unlock(&latency->mutex);
+}
+
+static int latency_rx_run_matches(struct latency *latency, uint32_t run, float symbols)
+{
+	return fabsf(run - symbols * latency->rx_symbol_samples) <= latency->rx_symbol_samples / 2;
+}
+
+void latency_rx_on_buffer_received(struct latency *latency, const sample_rx_t *buffer,
+		uint32_t buffer_count, const struct plc_buffer_stamp *stamp)
+{
+	if (stamp->sequence != latency->rx_sequence_expected)
+	{
+		// Discontinuity -> restart the detection. A sequence going backwards is a restart of the
+		//	count (resync), not a loss
+		int32_t buffers_lost = (int32_t) (stamp->sequence - latency->rx_sequence_expected);
+		if (buffers_lost > 0)
+		{
+			pthread_mutex_lock(&latency->mutex);
+			latency->statistics.rx_buffers_lost += buffers_lost;
+			pthread_mutex_unlock(&latency->mutex);
+		}
+		latency_reset_detector(latency);
+	}
+	latency->rx_sequence_expected = stamp->sequence + 1;
+	// The stamp is the time of the last sample of the buffer
+	uint64_t buffer_end_index = latency->rx_sample_index + buffer_count;
+	uint32_t n;
+	for (n = buffer_count; n > 0; n--, buffer++, latency->rx_sample_index++)
+	{
+		int level = (*buffer >= MARKER_RX_THRESHOLD);
+		if (!latency->rx_decoding)
+		{
+			if (level == latency->rx_level)
+			{
+				if (latency->rx_run < UINT32_MAX)
+					latency->rx_run++;
+				continue;
+			}
+			latency->rx_runs[0] = latency->rx_runs[1];
+			latency->rx_runs[1] = latency->rx_runs[2];
+			latency->rx_runs[2] = latency->rx_run;
+			latency->rx_level = level;
+			latency->rx_run = 1;
+			// Falling edge at the end of the sync: 4 (or more) HI symbols, 4 LO and 1 HI
+			if ((level == 0)
+					&& (latency->rx_runs[0] + latency->rx_symbol_samples / 2
+							>= 4 * latency->rx_symbol_samples)
+					&& latency_rx_run_matches(latency, latency->rx_runs[1], 4)
+					&& latency_rx_run_matches(latency, latency->rx_runs[2], 1))
+			{
+				// The edge is half a sample before -> this sample is at the center of the start
+				//	symbol
+				latency->rx_decoding = 1;
+				latency->rx_marker_start = latency->rx_sample_index - 0.5
+						- MARKER_SYNC_SYMBOLS * latency->rx_symbol_samples;
+				latency->rx_next_symbol = latency->rx_sample_index;
+				latency->rx_symbols_decoded = 0;
+				latency->rx_data = 0;
+			}
+		}
+		if (latency->rx_decoding && (latency->rx_sample_index >= latency->rx_next_symbol))
+		{
+			latency->rx_data = (latency->rx_data << 1) | level;
+			latency->rx_next_symbol += latency->rx_symbol_samples;
+			if (++latency->rx_symbols_decoded == MARKER_DATA_SYMBOLS)
+			{
+				uint8_t id = latency->rx_data >> 8;
+				// Start symbol at LO and the identifier checked against its complement
+				if (((latency->rx_data >> 16) == 0) && ((uint8_t) ~id == (latency->rx_data & 0xFF)))
+				{
+					int64_t rx_ns = stamp->timestamp_ns - (int64_t) ((buffer_end_index - 1
+							- latency->rx_marker_start) * latency->rx_ns_per_sample);
+					latency_rx_on_marker(latency, id, rx_ns);
+				}
+				latency_reset_detector(latency);
+				latency->rx_level = level;
+			}
+		}
+	}
+}
+
+void latency_get_statistics(struct latency *latency, struct latency_statistics *statistics)
+{
+	pthread_mutex_lock(&latency->mutex);
+	*statistics = latency->statistics;
+	if (statistics->markers_matched > 0)
+	{
+		double mean = latency->latency_sum_us / statistics->markers_matched;
+		double variance = latency->latency_sum_squares_us / statistics->markers_matched
+				- mean * mean;
+		statistics->latency_mean_us = mean;
+		statistics->jitter_us = (variance > 0.0) ? sqrt(variance) : 0.0;
+	}
+	pthread_mutex_unlock(&latency->mutex);
+}
+
+static int compare_int32(const void *a, const void *b)
+{
+	int32_t va = *(const int32_t *) a;
+	int32_t vb = *(const int32_t *) b;
+	return (va > vb) - (va < vb);
+}
+
+void latency_log_report(struct latency *latency)
+{
+	struct latency_statistics statistics;
+	latency_get_statistics(latency, &statistics);
+	log_format("Latency markers: %u sent, %u received, %u matched. RX buffers lost: %u\n",
+			statistics.markers_sent, statistics.markers_received, statistics.markers_matched,
+			statistics.rx_buffers_lost);
+	if (statistics.markers_matched == 0)
+		return;
+	log_format("Latency [us]: min %d, mean %.1f, max %d, jitter (std) %.1f\n",
+			statistics.latency_min_us, statistics.latency_mean_us, statistics.latency_max_us,
+			statistics.jitter_us);
+	pthread_mutex_lock(&latency->mutex);
+	uint32_t count = latency->latencies_count;
+	int32_t *latencies_us = malloc(count * sizeof(int32_t));
+	memcpy(latencies_us, latency->latencies_us, count * sizeof(int32_t));
+	pthread_mutex_unlock(&latency->mutex);
+	qsort(latencies_us, count, sizeof(int32_t), compare_int32);
+	int32_t median_us = latencies_us[count / 2];
+	log_format("Latency percentiles [us]: p50 %d, p90 %d, p99 %d\n", median_us,
+			latencies_us[(uint64_t) count * 90 / 100], latencies_us[(uint64_t) count * 99 / 100]);
+	uint32_t bins[ARRAY_SIZE(jitter_bins_us) + 1];
+	memset(bins, 0, sizeof(bins));
+	uint32_t n;
+	for (n = 0; n < count; n++)
+	{
+		uint32_t deviation_us = abs(latencies_us[n] - median_us);
+		uint32_t bin = 0;
+		while ((bin < ARRAY_SIZE(jitter_bins_us)) && (deviation_us > jitter_bins_us[bin]))
+			bin++;
+		bins[bin]++;
+	}
+	free(latencies_us);
+	log_format("Jitter distribution (deviation from p50) [us]:");
+	for (n = 0; n < ARRAY_SIZE(jitter_bins_us); n++)
+		log_format(" <=%u: %u,", jitter_bins_us[n], bins[n]);
+	log_format(" >%u: %u\n", jitter_bins_us[n - 1], bins[n]);
+}
@@ -0,0 +1,61 @@
+/**
+ * @file
+ * @brief	End-to-end TX-to-RX latency measurement through markers embedded in the signal
+ * @details
+ *	Periodically the first samples of a TX buffer are replaced by a marker: a sync pattern followed
+ *	by an 8-bit identifier and its complement, each symbol held at one of the DAC extremes. The TX
+ *	time of a marker is the stamp of its buffer when handed to the device. The RX time is the stamp
+ *	of the buffer where it is detected corrected by its position inside it. So the latency covers
+ *	the queues of both devices and the transport between them.\n
+ *	It is intended for the emulated paths (internal fifo and ALSA loopback) where the levels reach
+ *	the RX undistorted and each TX buffer is filled and sent in the same cycle
+ *
+ * @cond COPYRIGHT_NOTES @copyright
+ *	Copyright (C) 2017 Jose Maria Ortega\n
+ *	Distributed under the GNU GPLv3. For full terms see the file LICENSE
+ * @endcond
+ */
+
+#ifndef LATENCY_H
+#define LATENCY_H
+
+// TX samples per symbol of the marker (when the RX and TX rates match)
+#define LATENCY_MARKER_SYMBOL_SAMPLES 4
+// Latencies kept for the distribution of the jitter. The min, mean and max cover the whole session
+#define LATENCY_SAMPLES_MAX 8192
+
+struct latency;
+
+struct latency_statistics
+{
+	uint32_t markers_sent;
+	uint32_t markers_received;
+	// Markers both sent and received. The rest of the sent ones were lost and the rest of the
+	//	received ones were false detections
+	uint32_t markers_matched;
+	// Gaps in the sequence of the RX buffers
+	uint32_t rx_buffers_lost;
+	int32_t latency_min_us;
+	int32_t latency_max_us;
+	float latency_mean_us;
+	// Standard deviation of the latency
+	float jitter_us;
+};
+
+struct latency *latency_create(float tx_sampling_rate_sps, float rx_sampling_rate_sps,
+		uint32_t marker_interval_ms);
+void latency_release(struct latency *latency);
+// Clears the statistics and the markers in flight. Called before each communication session
+void latency_reset(struct latency *latency);
+// Called from the TX thread after the encoder has filled the buffer
+void latency_tx_embed_marker(struct latency *latency, sample_tx_t *buffer, uint32_t buffer_count);
+// Called from the TX thread when a buffer has been sent
+void latency_tx_on_buffer_sent(struct latency *latency, const struct plc_buffer_stamp *stamp);
+// Called from the RX thread for each buffer captured
+void latency_rx_on_buffer_received(struct latency *latency, const sample_rx_t *buffer,
+		uint32_t buffer_count, const struct plc_buffer_stamp *stamp);
+void latency_get_statistics(struct latency *latency, struct latency_statistics *statistics);
+// Logs the statistics of the session with the percentiles and distribution of the jitter
+void latency_log_report(struct latency *latency);
+
+#endif /* LATENCY_H */
@@ -10,18 +10,62 @@
 #define _GNU_SOURCE		// Required for 'vasprintf' declaration
 #include <errno.h>		// errno
 #include <pthread.h>	// pthread_mutex_t
+#include <semaphore.h>	// sem_t
 #include <stdarg.h>		// va_list
+#include <time.h>		// clock_gettime
 #include "+common/api/+base.h"
 #include "common.h"
 
 #include "logger.h"
 
+// Records aligned to keep the headers contiguous in the rings
+#define LOGGER_RECORD_ALIGN 8
+#define LOGGER_FLUSH_INTERVAL_MS 20
+
+struct logger_record_header
+{
+	// Global order of the records among the threads
+	uint32_t sequence;
+	// Length of the text following the header (not null-terminated)
+	uint32_t text_len;
+};
+
+// Single-producer (the owner thread) single-consumer (the flushing one) ring of records
+struct logger_ring
+{
+	// Rings are only added to the list of the logger (never removed until its release)
+	struct logger_ring *next;
+	// Owned by a running thread. Once the thread finishes the ring is reused by new threads
+	int in_use;
+	uint8_t *data;
+	uint32_t size_mask;
+	// Free-running byte positions: 'head' only written by the producer and 'tail' by the consumer
+	uint32_t head;
+	uint32_t tail;
+	uint32_t records_dropped;
+};
+
 struct logger
 {
+	// In synchronous mode serializes the logging threads. In asynchronous mode the flushing ones
 	pthread_mutex_t log_line_lock;
 	void (*release)(struct logger *logger);
 	void *data;
 	void (*log_text)(void *data, const char *text);
+	// Asynchronous mode
+	int async;
+	uint32_t ring_size;
+	pthread_key_t ring_key;
+	struct logger_ring *rings;
+	uint32_t sequence;
+	// Next sequence to be written. As a record takes its sequence before being published, one
+	//	with a later sequence can be published first in the ring of another thread
+	uint32_t flush_sequence;
+	uint32_t records_dropped_reported;
+	sem_t flush_sem;
+	int flusher_end;
+	pthread_t flusher_thread;
+	char flush_text[LOGGER_RECORD_TEXT_MAX + 1];
 };
 
 static struct logger *logger_create_base(void)
@@ -63,17 +107,241 @@ struct logger *logger_create_file(const char *filename)
 	return logger;
 }
 
-void logger_release(struct logger *logger)
+static void logger_stop_async(struct logger *logger)
 {
+	__atomic_store_n(&logger->flusher_end, 1, __ATOMIC_RELEASE);
+	sem_post(&logger->flush_sem);
+	int ret = pthread_join(logger->flusher_thread, NULL);
+	assert(ret == 0);
+	// From now on the new messages are logged synchronously
+	__atomic_store_n(&logger->async, 0, __ATOMIC_RELEASE);
+	logger_flush(logger);
+	pthread_key_delete(logger->ring_key);
+	sem_destroy(&logger->flush_sem);
+	while (logger->rings)
+	{
+		struct logger_ring *ring = logger->rings;
+		logger->rings = ring->next;
+		free(ring->data);
+		free(ring);
+	}
+}
 
+void logger_release(struct logger *logger)
+{
+	if (logger->async)
+		logger_stop_async(logger);
 	if (logger->release)
 		logger->release(logger);
 	pthread_mutex_destroy(&logger->log_line_lock);
 	free(logger);
 }
 
+static void logger_ring_release_owner(void *ring)
+{
+	__atomic_store_n(&((struct logger_ring*) ring)->in_use, 0, __ATOMIC_RELEASE);
+}
+
+static struct logger_ring *logger_ring_create(struct logger *logger, int in_use)
+{
+	struct logger_ring *ring = calloc(1, sizeof(struct logger_ring));
+	ring->data = malloc(logger->ring_size);
+	// Touched now not to page-fault on the first records
+	memset(ring->data, 0, logger->ring_size);
+	ring->size_mask = logger->ring_size - 1;
+	ring->in_use = in_use;
+	ring->next = __atomic_load_n(&logger->rings, __ATOMIC_RELAXED);
+	while (!__atomic_compare_exchange_n(&logger->rings, &ring->next, ring, 1, __ATOMIC_RELEASE,
+			__ATOMIC_RELAXED))
+		;
+	return ring;
+}
+
+// Ring of the calling thread. The first call of each thread claims a free ring and only
+//	allocates a new one if all of them are in use
+static struct logger_ring *logger_get_ring(struct logger *logger)
+{
+	struct logger_ring *ring = pthread_getspecific(logger->ring_key);
+	if (ring)
+		return ring;
+	for (ring = __atomic_load_n(&logger->rings, __ATOMIC_ACQUIRE); ring != NULL; ring = ring->next)
+	{
+		int in_use = 0;
+		if (__atomic_compare_exchange_n(&ring->in_use, &in_use, 1, 0, __ATOMIC_ACQUIRE,
+				__ATOMIC_RELAXED))
+			break;
+	}
+	if (ring == NULL)
+		ring = logger_ring_create(logger, 1);
+	pthread_setspecific(logger->ring_key, ring);
+	return ring;
+}
+
+static void logger_ring_write(struct logger_ring *ring, uint32_t position, const void *data,
+		uint32_t size)
+{
+	uint32_t offset = position & ring->size_mask;
+	uint32_t size_first = ring->size_mask + 1 - offset;
+	if (size_first > size)
+		size_first = size;
+	memcpy(ring->data + offset, data, size_first);
+	memcpy(ring->data, (const uint8_t*) data + size_first, size - size_first);
+}
+
+static void logger_ring_read(struct logger_ring *ring, uint32_t position, void *data,
+		uint32_t size)
+{
+	uint32_t offset = position & ring->size_mask;
+	uint32_t size_first = ring->size_mask + 1 - offset;
+	if (size_first > size)
+		size_first = size;
+	memcpy(data, ring->data + offset, size_first);
+	memcpy((uint8_t*) data + size_first, ring->data, size - size_first);
+}
+
+// Never blocks: if the ring of the thread is full the record is dropped
+static void logger_push(struct logger *logger, const char *text, uint32_t text_len,
+		int add_newline)
+{
+	assert(text_len + add_newline <= LOGGER_RECORD_TEXT_MAX);
+	struct logger_ring *ring = logger_get_ring(logger);
+	struct logger_record_header header;
+	header.text_len = text_len + add_newline;
+	uint32_t record_size = (sizeof(header) + header.text_len + LOGGER_RECORD_ALIGN - 1)
+			& ~(LOGGER_RECORD_ALIGN - 1);
+	uint32_t head = ring->head;
+	uint32_t used = head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+	if (used + record_size > logger->ring_size)
+	{
+		__atomic_fetch_add(&ring->records_dropped, 1, __ATOMIC_RELAXED);
+		return;
+	}
+	// Taken once the record fits: every sequence is published, without gaps
+	header.sequence = __atomic_fetch_add(&logger->sequence, 1, __ATOMIC_RELAXED);
+	logger_ring_write(ring, head, &header, sizeof(header));
+	logger_ring_write(ring, head + sizeof(header), text, text_len);
+	if (add_newline)
+		logger_ring_write(ring, head + sizeof(header) + text_len, "\n", 1);
+	__atomic_store_n(&ring->head, head + record_size, __ATOMIC_RELEASE);
+	// Wake the flushing thread before its period only when the ring gets half full
+	if ((used + record_size > logger->ring_size / 2) && (used <= logger->ring_size / 2))
+		sem_post(&logger->flush_sem);
+}
+
+// Longer texts than a record are split in several ones
+static void logger_push_text(struct logger *logger, const char *text, size_t text_len,
+		int add_newline)
+{
+	for (; text_len + add_newline > LOGGER_RECORD_TEXT_MAX; text += LOGGER_RECORD_TEXT_MAX,
+			text_len -= LOGGER_RECORD_TEXT_MAX)
+		logger_push(logger, text, LOGGER_RECORD_TEXT_MAX, 0);
+	logger_push(logger, text, text_len, add_newline);
+}
+
+void logger_flush(struct logger *logger)
+{
+	pthread_mutex_lock(&logger->log_line_lock);
+	for (;;)
+	{
+		// Merge the rings by sequence to keep the order among threads
+		struct logger_ring *ring;
+		struct logger_ring *ring_next = NULL;
+		struct logger_record_header header_next;
+		for (ring = __atomic_load_n(&logger->rings, __ATOMIC_ACQUIRE); ring != NULL;
+				ring = ring->next)
+		{
+			if (ring->tail == __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE))
+				continue;
+			struct logger_record_header header;
+			logger_ring_read(ring, ring->tail, &header, sizeof(header));
+			if ((ring_next == NULL) || ((int32_t) (header.sequence - header_next.sequence) < 0))
+			{
+				ring_next = ring;
+				header_next = header;
+			}
+		}
+		// A record with a previous sequence may still be being written: wait for it
+		if ((ring_next == NULL) || (header_next.sequence != logger->flush_sequence))
+			break;
+		logger->flush_sequence++;
+		logger_ring_read(ring_next, ring_next->tail + sizeof(header_next), logger->flush_text,
+				header_next.text_len);
+		logger->flush_text[header_next.text_len] = '\0';
+		__atomic_store_n(&ring_next->tail, ring_next->tail
+				+ ((sizeof(header_next) + header_next.text_len + LOGGER_RECORD_ALIGN - 1)
+						& ~(LOGGER_RECORD_ALIGN - 1)), __ATOMIC_RELEASE);
+		logger->log_text(logger->data, logger->flush_text);
+	}
+	uint32_t records_dropped = 0;
+	struct logger_ring *ring;
+	for (ring = __atomic_load_n(&logger->rings, __ATOMIC_ACQUIRE); ring != NULL; ring = ring->next)
+		records_dropped += __atomic_load_n(&ring->records_dropped, __ATOMIC_RELAXED);
+	if (records_dropped != logger->records_dropped_reported)
+	{
+		snprintf(logger->flush_text, sizeof(logger->flush_text), "Logger: %u messages dropped\n",
+				records_dropped - logger->records_dropped_reported);
+		logger->records_dropped_reported = records_dropped;
+		logger->log_text(logger->data, logger->flush_text);
+	}
+	pthread_mutex_unlock(&logger->log_line_lock);
+}
+
+static void *logger_flusher_thread(void *arg)
+{
+	struct logger *logger = (struct logger*) arg;
+	while (!__atomic_load_n(&logger->flusher_end, __ATOMIC_ACQUIRE))
+	{
+		struct timespec deadline;
+		clock_gettime(CLOCK_REALTIME, &deadline);
+		deadline.tv_nsec += LOGGER_FLUSH_INTERVAL_MS * 1000000;
+		if (deadline.tv_nsec >= 1000000000)
+		{
+			deadline.tv_sec++;
+			deadline.tv_nsec -= 1000000000;
+		}
+		while ((sem_timedwait(&logger->flush_sem, &deadline) < 0) && (errno == EINTR))
+			;
+		logger_flush(logger);
+	}
+	return NULL;
+}
+
+int logger_start_async(struct logger *logger, uint32_t ring_size, uint32_t rings_count)
+{
+	assert(!logger->async);
+	// Power of 2 with room for several records of max length
+	uint32_t ring_size_min = 4 * (LOGGER_RECORD_TEXT_MAX + sizeof(struct logger_record_header));
+	if (ring_size < ring_size_min)
+		ring_size = ring_size_min;
+	for (logger->ring_size = 1; logger->ring_size < ring_size; logger->ring_size <<= 1)
+		;
+	int ret = pthread_key_create(&logger->ring_key, logger_ring_release_owner);
+	if (ret != 0)
+		return -1;
+	ret = sem_init(&logger->flush_sem, 0, 0);
+	assert(ret == 0);
+	logger->flusher_end = 0;
+	ret = pthread_create(&logger->flusher_thread, NULL, logger_flusher_thread, logger);
+	if (ret != 0)
+	{
+		sem_destroy(&logger->flush_sem);
+		pthread_key_delete(logger->ring_key);
+		return -1;
+	}
+	uint32_t n;
+	for (n = 0; n < rings_count; n++)
+		logger_ring_create(logger, 0);
+	__atomic_store_n(&logger->async, 1, __ATOMIC_RELEASE);
+	return 0;
+}
+
 static void logger_log(struct logger *logger, const char *text, int add_newline)
 {
+	if (__atomic_load_n(&logger->async, __ATOMIC_ACQUIRE))
+	{
+		logger_push_text(logger, text, strlen(text), add_newline);
+		return;
+	}
 	// As this function is shared among different thread -> mutual exclusion
 	pthread_mutex_lock(&logger->log_line_lock);
 	logger->log_text(logger->data, text);
@@ -94,6 +362,22 @@ void logger_log_line(struct logger *logger, const char *text)
 
 void logger_log_sequence_format_va(struct logger *logger, const char *format, va_list args)
 {
+	if (__atomic_load_n(&logger->async, __ATOMIC_ACQUIRE))
+	{
+		// Formatted now (without allocations up to a record) as the arguments may not outlive
+		//	the call
+		char text[LOGGER_RECORD_TEXT_MAX + 1];
+		va_list args_copy;
+		va_copy(args_copy, args);
+		int text_len = vsnprintf(text, sizeof(text), format, args_copy);
+		va_end(args_copy);
+		assert(text_len >= 0);
+		if (text_len < sizeof(text))
+		{
+			logger_push(logger, text, text_len, 0);
+			return;
+		}
+	}
 	char *text;
 	int ret = vasprintf(&text, format, args);
 	assert(ret >= 0);
@@ -1,6 +1,13 @@
 /**
  * @file
  * @brief	Logging functionality
+ * @details
+ *	By default each message is written synchronously under a mutex by the calling thread. In
+ *	asynchronous mode ('logger_start_async') each thread pushes its messages, already formatted,
+ *	to its own lock-free ring and a background thread writes them in the order they were pushed
+ *	among all the threads. The rings are pre-created, so the real-time threads never allocate
+ *	(for messages up to 'LOGGER_RECORD_TEXT_MAX') nor wait for the output: if their ring is full
+ *	the message is dropped and the drops are reported later
  *
  * @cond COPYRIGHT_NOTES @copyright
  *	Copyright (C) 2016 Jose Maria Ortega\n
@@ -11,12 +18,24 @@
 #ifndef LOGGER_H
 #define LOGGER_H
 
+// Max length of a message stored as a single record. The longer ones are split
+#define LOGGER_RECORD_TEXT_MAX 1024
+
 struct logger;
 
 struct logger *logger_create_log_text(void (*log_text)(void *data, const char *text), void *data);
 struct logger *logger_create_stdout(void);
 struct logger *logger_create_file(const char *filename);
+// In asynchronous mode the pending messages are written before. The other logging threads must
+//	have finished
 void logger_release(struct logger *logger);
+// Switches to asynchronous mode with rings of 'ring_size' bytes per thread (rounded up to a
+//	power of 2). 'rings_count' rings are pre-created to be claimed by the first message of each
+//	thread, and reused once the thread finishes: only the threads exceeding them allocate their
+//	ring. Returns 0 if ok or -1 if the flushing thread cannot be created
+int logger_start_async(struct logger *logger, uint32_t ring_size, uint32_t rings_count);
+// Writes the pending messages of the asynchronous mode
+void logger_flush(struct logger *logger);
 void logger_log_sequence(struct logger *logger, const char *text);
 void logger_log_line(struct logger *logger, const char *text);
 void logger_log_sequence_format(struct logger *logger, const char *format, ...);
@@ -35,6 +35,7 @@
 #include "cmdline.h"
 #include "common.h"
 #include "controller.h"
+#include "plugins.h"
 
 #ifdef DEBUG
 // Tune 'plc_debug_level' according to the development stage:
@@ -108,15 +109,16 @@ int main(int argc, char *argv[])
 
 	TRACE(3, "Initializing main objects");
 	error_ctrl_initialize();
+	register_static_plugins();
 
 	TRACE(3, "Initializing controller");
-	controller_create(argc, argv);
+	int exit_status = controller_create(argc, argv);
 
 	// NOTE: A explicit call to 'terminate()' is not required as it is done on exit the app because
 	//	the 'atexit'. If we explicitly invoke it the 'terminate' function will be called twice
 
-	// NOTE: 'return 0' is equivalent to 'exit(EXIT_SUCCESS)'
-	return 0;
+	// NOTE: returning from 'main' is equivalent to 'exit(exit_status)'
+	return exit_status;
 }
 
 static void terminate(void)
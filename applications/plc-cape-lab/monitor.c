@@ -11,22 +11,49 @@
 #include <pthread.h>
 #include <unistd.h>
 #include "+common/api/+base.h"
+#include "batch.h"
 #include "common.h"
+#include "latency.h"
 #include "monitor.h"
 #include "libraries/libplc-adc/api/adc.h"
 #include "libraries/libplc-adc/api/analysis.h"
 #include "libraries/libplc-cape/api/tx.h"
+#include "libraries/libplc-tools/api/metrics.h"
 #include "libraries/libplc-tools/api/time.h"
 #include "ui.h"
 
 #define UI_REFRESH_INTERVAL_MS 250
 #define UI_REFRESH_INTERVAL_US (UI_REFRESH_INTERVAL_MS*1000)
+#define METRICS_EXPORT_INTERVAL_MS 1000
+#define METRICS_PREFIX "plc_lab_"
+#define NSECS_PER_USEC 1000
+
+// Upper bounds of the buckets of the buffer cycle histograms [us]
+static const int64_t metrics_cycle_bounds_us[] = {
+		500, 1000, 2000, 5000, 10000, 20000, 50000, 100000, 200000, 500000 };
+
+struct monitor_metrics
+{
+	struct plc_metric *tx_buffers;
+	struct plc_metric *tx_buffer_cycle_us;
+	struct plc_metric *tx_buffers_overflow;
+	struct plc_metric *tx_alsa_xruns;
+	struct plc_metric *rx_buffers;
+	struct plc_metric *rx_buffers_lost;
+	struct plc_metric *rx_buffer_cycle_us;
+	struct plc_metric *rx_decoded_bytes;
+	struct plc_metric *afe_tx_flag;
+	struct plc_metric *afe_rx_flag;
+	struct plc_metric *afe_ok_flag;
+};
 
 struct monitor
 {
 	struct plc_adc *plc_adc;
 	struct plc_rx_analysis *plc_rx_analysis;
 	struct plc_tx *plc_tx;
+	struct latency *latency;
+	struct batch *batch;
 	struct ui *ui;
 	pthread_t thread;
 	int end_thread;
@@ -34,17 +61,68 @@ struct monitor
 	uint32_t buffers_tx_count;
 	uint32_t buffers_rx_count;
 	sample_rx_t buffer_rx_last_value;
+	struct plc_metrics *plc_metrics;
+	struct monitor_metrics metrics;
+	// Previous stamps for the cycle times. Only accessed from the TX and RX threads respectively
+	int64_t tx_last_timestamp_ns;
+	int64_t rx_last_timestamp_ns;
+	uint32_t rx_next_sequence;
 };
 
+// Called from the exporter thread. The TX statistics are plain counters read without locking
+static void monitor_collect_metrics(void *data, struct plc_metrics *plc_metrics)
+{
+	struct monitor *monitor = data;
+	const struct tx_statistics *tx_stat;
+	if ((monitor->plc_tx) && (tx_stat = plc_tx_get_tx_statistics(monitor->plc_tx)))
+	{
+		plc_metric_set(monitor->metrics.tx_buffers_overflow, tx_stat->buffers_overflow);
+		plc_metric_set(monitor->metrics.tx_alsa_xruns, tx_stat->alsa.xruns);
+	}
+}
+
+static void monitor_create_metrics(struct monitor *monitor)
+{
+	struct plc_metrics *plc_metrics = plc_metrics_create(METRICS_PREFIX);
+	struct monitor_metrics *metrics = &monitor->metrics;
+	uint32_t cycle_bounds_count = ARRAY_SIZE(metrics_cycle_bounds_us);
+	metrics->tx_buffers = plc_metrics_add_counter(plc_metrics, "tx_buffers_total",
+			"TX buffers sent");
+	metrics->tx_buffer_cycle_us = plc_metrics_add_histogram(plc_metrics, "tx_buffer_cycle_us",
+			"Time between consecutive TX buffers [us]", metrics_cycle_bounds_us,
+			cycle_bounds_count);
+	metrics->tx_buffers_overflow = plc_metrics_add_counter(plc_metrics,
+			"tx_buffers_overflow_total",
+			"TX buffers not prepared in time (underruns) in the session");
+	metrics->tx_alsa_xruns = plc_metrics_add_counter(plc_metrics, "tx_alsa_xruns_total",
+			"ALSA TX xruns in the session");
+	metrics->rx_buffers = plc_metrics_add_counter(plc_metrics, "rx_buffers_total",
+			"RX buffers received");
+	metrics->rx_buffers_lost = plc_metrics_add_counter(plc_metrics, "rx_buffers_lost_total",
+			"RX buffers lost (pool overflows and xruns) from the gaps in their sequence numbers");
+	metrics->rx_buffer_cycle_us = plc_metrics_add_histogram(plc_metrics, "rx_buffer_cycle_us",
+			"Time between consecutive RX buffers [us]", metrics_cycle_bounds_us,
+			cycle_bounds_count);
+	metrics->rx_decoded_bytes = plc_metrics_add_counter(plc_metrics, "rx_decoded_bytes_total",
+			"Bytes decoded");
+	metrics->afe_tx_flag = plc_metrics_add_gauge(plc_metrics, "afe_tx_flag", "AFE TX flag");
+	metrics->afe_rx_flag = plc_metrics_add_gauge(plc_metrics, "afe_rx_flag", "AFE RX flag");
+	metrics->afe_ok_flag = plc_metrics_add_gauge(plc_metrics, "afe_ok_flag", "AFE OK flag");
+	plc_metrics_set_collect_callback(plc_metrics, monitor_collect_metrics, monitor);
+	monitor->plc_metrics = plc_metrics;
+}
+
 struct monitor *monitor_create(struct ui *ui)
 {
 	struct monitor *monitor = (struct monitor*) calloc(1, sizeof(struct monitor));
 	monitor->ui = ui;
+	monitor_create_metrics(monitor);
 	return monitor;
 }
 
 void monitor_release(struct monitor *monitor)
 {
+	plc_metrics_release(monitor->plc_metrics);
 	free(monitor);
 }
 
@@ -63,6 +141,16 @@ void monitor_set_rx_analysis(struct monitor *monitor, struct plc_rx_analysis *pl
 	monitor->plc_rx_analysis = plc_rx_analysis;
 }
 
+void monitor_set_latency(struct monitor *monitor, struct latency *latency)
+{
+	monitor->latency = latency;
+}
+
+void monitor_set_batch(struct monitor *monitor, struct batch *batch)
+{
+	monitor->batch = batch;
+}
+
 static void *monitor_thread(void *arg)
 {
 	struct monitor *monitor = arg;
@@ -78,6 +166,7 @@ static void *monitor_thread(void *arg)
 			char *text = NULL;
 			const struct rx_statistics *rx_stat;
 			const struct tx_statistics *tx_stat;
+			struct latency_statistics latency_stat;
 			switch (monitor->monitor_profile)
 			{
 			case monitor_profile_none:
@@ -90,8 +179,10 @@ static void *monitor_thread(void *arg)
 				break;
 			case monitor_profile_tx_values:
 				if ((monitor->plc_tx) && (tx_stat = plc_tx_get_tx_statistics(monitor->plc_tx)))
-					asprintf(&text, "TX: Buffers overflow/handled: %u/%u",
-							tx_stat->buffers_overflow, tx_stat->buffers_handled);
+					asprintf(&text, "TX: Buffers overflow/handled: %u/%u, ALSA xruns: %u, "
+							"delay: %u (max %u) frames", tx_stat->buffers_overflow,
+							tx_stat->buffers_handled, tx_stat->alsa.xruns,
+							tx_stat->alsa.delay_frames, tx_stat->alsa.delay_max_frames);
 				break;
 			case monitor_profile_tx_time:
 				if ((monitor->plc_tx) && (tx_stat = plc_tx_get_tx_statistics(monitor->plc_tx)))
@@ -107,10 +198,11 @@ static void *monitor_thread(void *arg)
 					(rx_stat = plc_rx_analysis_get_statistics(monitor->plc_rx_analysis)))
 					asprintf(&text,
 						"RX: Buffers received: %u, "
-						"DC Mean: %.1f, AC Mean: %.1f, Range: %u (%u..%u)",
+						"DC Mean: %.1f, AC Mean: %.1f, AC RMS: %.1f, Range: %u (%u..%u), "
+						"Crossings: %u",
 						rx_stat->buffers_handled, rx_stat->buffer_dc_mean, rx_stat->buffer_ac_mean,
-						rx_stat->buffer_max - rx_stat->buffer_min, rx_stat->buffer_min,
-						rx_stat->buffer_max);
+						rx_stat->buffer_ac_rms, rx_stat->buffer_max - rx_stat->buffer_min,
+						rx_stat->buffer_min, rx_stat->buffer_max, rx_stat->buffer_crossings);
 				break;
 			case monitor_profile_rx_time:
 				if ((monitor->plc_rx_analysis) &&
@@ -121,6 +213,19 @@ static void *monitor_thread(void *arg)
 						rx_stat->buffer_preparation_max_us, rx_stat->buffer_cycle_min_us,
 						rx_stat->buffer_cycle_us, rx_stat->buffer_cycle_max_us);
 				break;
+			case monitor_profile_latency:
+				if (monitor->latency)
+				{
+					latency_get_statistics(monitor->latency, &latency_stat);
+					asprintf(&text,
+						"Latency [us]: Markers sent/received/matched: %u/%u/%u, "
+						"(min, mean, max): (%d,%.0f,%d), Jitter: %.1f",
+						latency_stat.markers_sent, latency_stat.markers_received,
+						latency_stat.markers_matched, latency_stat.latency_min_us,
+						latency_stat.latency_mean_us, latency_stat.latency_max_us,
+						latency_stat.jitter_us);
+				}
+				break;
 			default:
 				assert(0);
 				break;
@@ -154,6 +259,30 @@ void monitor_set_profile(struct monitor *monitor, enum monitor_profile_enum prof
 	ui_set_status_bar(monitor->ui, "");
 }
 
+int monitor_start_metrics_export(struct monitor *monitor, const char *file_path,
+		const char *socket_path)
+{
+	if (file_path && (*file_path == '\0'))
+		file_path = NULL;
+	if (socket_path && (*socket_path == '\0'))
+		socket_path = NULL;
+	if ((file_path == NULL) && (socket_path == NULL))
+		return 0;
+	const char *extension = file_path ? strrchr(file_path, '.') : NULL;
+	enum plc_metrics_format_enum format = (extension && (strcmp(extension, ".json") == 0)) ?
+			plc_metrics_format_json : plc_metrics_format_prometheus;
+	return plc_metrics_start_export(monitor->plc_metrics, format, file_path, socket_path,
+			METRICS_EXPORT_INTERVAL_MS);
+}
+
+void monitor_reset(struct monitor *monitor)
+{
+	// The cycles are measured within a session
+	monitor->tx_last_timestamp_ns = 0;
+	monitor->rx_last_timestamp_ns = 0;
+	monitor->rx_next_sequence = 0;
+}
+
 void monitor_start(struct monitor *monitor)
 {
 	monitor->end_thread = 0;
@@ -169,14 +298,51 @@ void monitor_stop(struct monitor *monitor)
 }
 
 void monitor_on_buffer_sent(struct monitor *monitor, uint16_t *samples_buffer,
-		uint32_t samples_buffer_count)
+		uint32_t samples_buffer_count, const struct plc_buffer_stamp *stamp)
 {
 	monitor->buffers_tx_count++;
+	plc_metric_add(monitor->metrics.tx_buffers, 1);
+	if (monitor->tx_last_timestamp_ns != 0)
+		plc_metric_observe(monitor->metrics.tx_buffer_cycle_us,
+				(stamp->timestamp_ns - monitor->tx_last_timestamp_ns) / NSECS_PER_USEC);
+	monitor->tx_last_timestamp_ns = stamp->timestamp_ns;
+	if (monitor->latency)
+		latency_tx_on_buffer_sent(monitor->latency, stamp);
 }
 
 void monitor_on_buffer_received(struct monitor *monitor, sample_rx_t *samples_buffer,
-		uint32_t samples_buffer_count)
+		uint32_t samples_buffer_count, const struct plc_buffer_stamp *stamp)
 {
 	monitor->buffers_rx_count++;
 	monitor->buffer_rx_last_value = *samples_buffer;
+	plc_metric_add(monitor->metrics.rx_buffers, 1);
+	if (monitor->rx_last_timestamp_ns != 0)
+	{
+		// The cycle of a buffer after a gap includes the lost ones. A sequence going backwards is
+		//	a restart of the count (resync), not a loss
+		int32_t buffers_lost = (int32_t) (stamp->sequence - monitor->rx_next_sequence);
+		if (buffers_lost > 0)
+			plc_metric_add(monitor->metrics.rx_buffers_lost, buffers_lost);
+		plc_metric_observe(monitor->metrics.rx_buffer_cycle_us,
+				(stamp->timestamp_ns - monitor->rx_last_timestamp_ns) / NSECS_PER_USEC);
+	}
+	monitor->rx_last_timestamp_ns = stamp->timestamp_ns;
+	monitor->rx_next_sequence = stamp->sequence + 1;
+	if (monitor->latency)
+		latency_rx_on_buffer_received(monitor->latency, samples_buffer, samples_buffer_count,
+				stamp);
+}
+
+void monitor_on_data_decoded(struct monitor *monitor, const uint8_t *data, uint32_t data_count)
+{
+	plc_metric_add(monitor->metrics.rx_decoded_bytes, data_count);
+	if (monitor->batch)
+		batch_on_data_decoded(monitor->batch, data, data_count);
+}
+
+void monitor_on_afe_flags(struct monitor *monitor, int tx_flag, int rx_flag, int ok_flag)
+{
+	plc_metric_set(monitor->metrics.afe_tx_flag, tx_flag);
+	plc_metric_set(monitor->metrics.afe_rx_flag, rx_flag);
+	plc_metric_set(monitor->metrics.afe_ok_flag, ok_flag);
 }
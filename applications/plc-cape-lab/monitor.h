@@ -19,8 +19,11 @@ enum monitor_profile_enum
 	monitor_profile_tx_time,
 	monitor_profile_rx_values,
 	monitor_profile_rx_time,
+	monitor_profile_latency,
 };
 
+struct batch;
+struct latency;
 struct monitor;
 struct plc_adc;
 struct plc_rx_analysis;
@@ -32,12 +35,27 @@ void monitor_release(struct monitor *monitor);
 void monitor_set_adc(struct monitor *monitor, struct plc_adc *plc_adc);
 void monitor_set_tx(struct monitor *monitor, struct plc_tx *plc_tx);
 void monitor_set_rx_analysis(struct monitor *monitor, struct plc_rx_analysis *plc_rx_analysis);
+// The TX and RX buffers are forwarded to 'latency' (if not NULL) for the latency measurement
+void monitor_set_latency(struct monitor *monitor, struct latency *latency);
+// The decoded data is forwarded to 'batch' (if not NULL) for the checking of the batch runs
+void monitor_set_batch(struct monitor *monitor, struct batch *batch);
 void monitor_set_profile(struct monitor *monitor, enum monitor_profile_enum profile);
+// Publishes the metrics to 'file_path' and/or 'socket_path' (NULL or empty to skip) in Prometheus
+//	text format or in JSON if the file has the '.json' extension. Returns 0 if ok or -1 if error
+int monitor_start_metrics_export(struct monitor *monitor, const char *file_path,
+		const char *socket_path);
+// Resets the state of the session updated by the TX/RX callbacks. Call it before starting the
+//	devices
+void monitor_reset(struct monitor *monitor);
 void monitor_start(struct monitor *monitor);
 void monitor_stop(struct monitor *monitor);
 void monitor_on_buffer_sent(struct monitor *monitor, uint16_t *samples_buffer,
-		uint32_t samples_buffer_count);
+		uint32_t samples_buffer_count, const struct plc_buffer_stamp *stamp);
 void monitor_on_buffer_received(struct monitor *monitor, uint16_t *samples_buffer,
-		uint32_t samples_buffer_count);
+		uint32_t samples_buffer_count, const struct plc_buffer_stamp *stamp);
+// Called from the RX thread (or the decoding ones) with the number of bytes decoded
+void monitor_on_data_decoded(struct monitor *monitor, const uint8_t *data, uint32_t data_count);
+// Called from the AFE on changes in the TX, RX and OK flags
+void monitor_on_afe_flags(struct monitor *monitor, int tx_flag, int rx_flag, int ok_flag);
 
 #endif /* MONITOR_H */
@@ -11,10 +11,11 @@
 #ifndef PLUGINS_H
 #define PLUGINS_H
 
-struct plugin;
+struct plc_plugin;
 
-void *load_dl_function(void *so_handle, const char *function_name, int mandatory);
-struct plugin *load_plugin(const char *path, void **api, uint32_t *api_version, uint32_t *api_size);
-void unload_plugin(struct plugin *plugin);
+// Registers the plugins linked into the application (if built with 'PLUGINS_STATIC')
+void register_static_plugins(void);
+struct plc_plugin *load_plugin(const char *path, void **api, uint32_t *api_version, uint32_t *api_size);
+void unload_plugin(struct plc_plugin *plugin);
 
 #endif /* PLUGINS_H */
@@ -7,7 +7,12 @@
  * @endcond
  */
 
+#include <errno.h>
+#include <fcntl.h>		// open
 #include <libxml/xmlreader.h>
+#include <sys/mman.h>	// mmap
+#include <sys/stat.h>	// stat
+#include <unistd.h>		// write
 #include "+common/api/+base.h"
 #include "+common/api/setting.h"
 #include "common.h"
@@ -18,6 +23,15 @@
 #include "settings.h"
 
 #define PROFILES_VECTOR_GRANULARITY 16
+#define PROFILES_FILENAME "profiles.xml"
+// Binary image of the parsed 'PROFILES_FILENAME', rebuilt when the XML changes
+#define PROFILES_CACHE_FILENAME "profiles.cache"
+#define PROFILES_CACHE_MAGIC "PLCPROF"
+#define PROFILES_CACHE_VERSION 1
+// Length stored for NULL strings
+#define PROFILES_CACHE_NULL_STRING UINT32_MAX
+#define FNV1A_OFFSET_BASIS 2166136261u
+#define FNV1A_PRIME 16777619u
 
 #define SAMPLES_TO_FILE_DEFAULT 10000
 
@@ -27,6 +41,8 @@ struct setting_vector
 	uint32_t capacity;
 	uint32_t count;
 	struct plc_setting *settings;
+	// Only for the application settings: their indexes resolved once by 'profiles_build_index'
+	int *app_setting_indexes;
 };
 
 struct profile
@@ -54,6 +70,38 @@ struct profiles
 	struct profile_list_item *profile_list_cur;
 	struct setting_vector *setting_vector_cur;
 	struct tree_node_vector *profile_tree;
+	// Open-addressing hash table of the profiles by identifier (size power of 2)
+	struct profile_list_item **profile_table;
+	uint32_t profile_table_mask;
+};
+
+// Header of the cache file. All the fields in native byte order
+struct profiles_cache_header
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t payload_size;
+	// Identification of the source XML. Any change in it invalidates the cache
+	int64_t source_mtime_sec;
+	int64_t source_mtime_nsec;
+	uint64_t source_size;
+	// FNV-1a of the payload
+	uint32_t payload_hash;
+	uint32_t reserved;
+};
+
+struct profiles_cache_writer
+{
+	uint8_t *data;
+	uint32_t size;
+	uint32_t capacity;
+};
+
+struct profiles_cache_reader
+{
+	const uint8_t *data;
+	const uint8_t *data_end;
+	int error;
 };
 
 static void profiles_add_setting(struct setting_vector *setting_vector,
@@ -297,7 +345,6 @@ static int profiles_xml_parse_profiles(struct profiles *profiles)
 //
 // XML: <tree>
 //
-// TODO: Release tree
 static void profiles_add_tree_profile(struct profile_identifier_vector *profile_identifier_vector,
 		const char *profile_identifier)
 {
@@ -320,7 +367,9 @@ static void profiles_add_tree_node(struct tree_node_vector *tree_node_vector, co
 		tree_node_vector->nodes = realloc(tree_node_vector->nodes,
 				tree_node_vector->nodes_capacity * sizeof(struct tree_node_vector));
 	}
-	tree_node_vector->nodes[tree_node_vector->nodes_count].title = strdup(title);
+	struct tree_node_vector *node = &tree_node_vector->nodes[tree_node_vector->nodes_count];
+	memset(node, 0, sizeof(*node));
+	node->title = strdup(title);
 	tree_node_vector->nodes_count++;
 }
 
@@ -568,37 +617,37 @@ static void profiles_load_defaults(struct profiles *profiles)
 		profiles_add_profile_struct(profiles, &predefined_profiles[n]);
 }
 
-static void profiles_load_xml(struct profiles *profiles)
-{
-	// Initialize the library and check that the loaded library is compatible with the version it
-	// was compiled
-	LIBXML_TEST_VERSION
-	if (profiles_xml_parse_file(profiles, "profiles.xml") < 0)
-		profiles_load_defaults(profiles);
-	xmlCleanupParser();
-	// Debug memory for regression tests
-	xmlMemoryDump();
-}
-
-struct profiles *profiles_create(void)
-{
-	struct profiles *profiles = calloc(1, sizeof(struct profiles));
-	profiles_load_xml(profiles);
-	return profiles;
-}
-
-void profiles_release_tree_node(struct tree_node_vector *node)
+static void profiles_release_tree_node(struct tree_node_vector *node)
 {
 	uint32_t n;
 	if (node->title)
 		free(node->title);
+	for (n = 0; n < node->profile_identifiers.count; n++)
+		free(node->profile_identifiers.identifiers[n]);
 	if (node->profile_identifiers.identifiers)
 		free(node->profile_identifiers.identifiers);
 	for (n = 0; n < node->nodes_count; n++)
 		profiles_release_tree_node(&node->nodes[n]);
+	if (node->nodes)
+		free(node->nodes);
 }
 
-void profiles_release(struct profiles *profiles)
+static void profiles_release_setting_vector(struct setting_vector *setting_vector)
+{
+	uint32_t n;
+	struct plc_setting *setting = setting_vector->settings;
+	for (n = setting_vector->count; n > 0; n--, setting++)
+		plc_setting_clear(setting);
+	if (setting_vector->settings)
+		free(setting_vector->settings);
+	if (setting_vector->plugin)
+		free(setting_vector->plugin);
+	if (setting_vector->app_setting_indexes)
+		free(setting_vector->app_setting_indexes);
+}
+
+// Releases the loaded profiles leaving 'profiles' empty
+static void profiles_clear(struct profiles *profiles)
 {
 	uint32_t n;
 	struct profile_list_item *item = profiles->profile_list_head;
@@ -608,19 +657,398 @@ void profiles_release(struct profiles *profiles)
 			free(item->profile.inherit);
 		free(item->profile.title);
 		free(item->profile.identifier);
-		uint32_t i;
-		struct plc_setting *setting = item->profile.encoder_settings.settings;
-		for (i = item->profile.encoder_settings.count; i > 0; i--, setting++)
-			plc_setting_clear(setting);
-		free(item->profile.encoder_settings.settings);
-		if (item->profile.encoder_settings.plugin)
-			free(item->profile.encoder_settings.plugin);
+		profiles_release_setting_vector(&item->profile.app_settings);
+		profiles_release_setting_vector(&item->profile.encoder_settings);
+		profiles_release_setting_vector(&item->profile.decoder_settings);
 		struct profile_list_item *item_prev = item;
 		item = item->next;
 		free(item_prev);
 	}
 	assert(n == 0);
-	profiles_release_tree_node(profiles->profile_tree);
+	if (profiles->profile_tree)
+	{
+		profiles_release_tree_node(profiles->profile_tree);
+		free(profiles->profile_tree);
+	}
+	if (profiles->profile_table)
+		free(profiles->profile_table);
+	memset(profiles, 0, sizeof(*profiles));
+}
+
+//
+// Lookup
+//
+
+static uint32_t profiles_hash(const void *data, size_t size, uint32_t hash)
+{
+	const uint8_t *byte = data;
+	for (; size > 0; size--, byte++)
+		hash = (hash ^ *byte) * FNV1A_PRIME;
+	return hash;
+}
+
+static uint32_t profiles_hash_identifier(const char *identifier)
+{
+	return profiles_hash(identifier, strlen(identifier), FNV1A_OFFSET_BASIS);
+}
+
+// Hashes the profiles by identifier and resolves the application settings. Done once after loading
+static void profiles_build_index(struct profiles *profiles)
+{
+	uint32_t table_size = 1;
+	while (table_size < 2 * profiles->profile_list_count)
+		table_size <<= 1;
+	profiles->profile_table = calloc(table_size, sizeof(struct profile_list_item*));
+	profiles->profile_table_mask = table_size - 1;
+	struct profile_list_item *item;
+	for (item = profiles->profile_list_head; item != NULL; item = item->next)
+	{
+		uint32_t slot = profiles_hash_identifier(item->profile.identifier)
+				& profiles->profile_table_mask;
+		while ((profiles->profile_table[slot] != NULL)
+				&& (strcmp(profiles->profile_table[slot]->profile.identifier,
+						item->profile.identifier) != 0))
+			slot = (slot + 1) & profiles->profile_table_mask;
+		// On duplicated identifiers the first definition prevails
+		if (profiles->profile_table[slot] == NULL)
+			profiles->profile_table[slot] = item;
+		uint32_t n;
+		struct setting_vector *app_settings = &item->profile.app_settings;
+		app_settings->app_setting_indexes = malloc(app_settings->count * sizeof(int));
+		for (n = 0; n < app_settings->count; n++)
+			app_settings->app_setting_indexes[n] = settings_find_app_setting(
+					app_settings->settings[n].identifier);
+	}
+}
+
+static struct profile_list_item *profiles_find(struct profiles *profiles,
+		const char *profile_identifier)
+{
+	uint32_t slot = profiles_hash_identifier(profile_identifier) & profiles->profile_table_mask;
+	struct profile_list_item *item;
+	while ((item = profiles->profile_table[slot]) != NULL)
+	{
+		if (strcmp(item->profile.identifier, profile_identifier) == 0)
+			return item;
+		slot = (slot + 1) & profiles->profile_table_mask;
+	}
+	return NULL;
+}
+
+//
+// Binary cache
+//
+// The payload is a flat image of the parsed profiles: integers as 'uint32_t' and strings as their
+//	length (null terminator included) followed by their characters
+
+static void profiles_cache_put(struct profiles_cache_writer *writer, const void *data,
+		uint32_t size)
+{
+	if (writer->size + size > writer->capacity)
+	{
+		writer->capacity = 2 * (writer->size + size);
+		writer->data = realloc(writer->data, writer->capacity);
+	}
+	memcpy(writer->data + writer->size, data, size);
+	writer->size += size;
+}
+
+static void profiles_cache_put_u32(struct profiles_cache_writer *writer, uint32_t value)
+{
+	profiles_cache_put(writer, &value, sizeof(value));
+}
+
+static void profiles_cache_put_string(struct profiles_cache_writer *writer, const char *text)
+{
+	if (text == NULL)
+	{
+		profiles_cache_put_u32(writer, PROFILES_CACHE_NULL_STRING);
+		return;
+	}
+	uint32_t size = strlen(text) + 1;
+	profiles_cache_put_u32(writer, size);
+	profiles_cache_put(writer, text, size);
+}
+
+static void profiles_cache_put_setting_vector(struct profiles_cache_writer *writer,
+		const struct setting_vector *setting_vector)
+{
+	uint32_t n;
+	profiles_cache_put_string(writer, setting_vector->plugin);
+	profiles_cache_put_u32(writer, setting_vector->count);
+	for (n = 0; n < setting_vector->count; n++)
+	{
+		// The XML only provides string settings
+		assert(setting_vector->settings[n].type == plc_setting_string);
+		profiles_cache_put_string(writer, setting_vector->settings[n].identifier);
+		profiles_cache_put_string(writer, setting_vector->settings[n].data.s);
+	}
+}
+
+// The title of the node is stored by its parent (the root one doesn't have)
+static void profiles_cache_put_tree_node(struct profiles_cache_writer *writer,
+		const struct tree_node_vector *node)
+{
+	uint32_t n;
+	profiles_cache_put_u32(writer, node->profile_identifiers.count);
+	for (n = 0; n < node->profile_identifiers.count; n++)
+		profiles_cache_put_string(writer, node->profile_identifiers.identifiers[n]);
+	profiles_cache_put_u32(writer, node->nodes_count);
+	for (n = 0; n < node->nodes_count; n++)
+	{
+		profiles_cache_put_string(writer, node->nodes[n].title);
+		profiles_cache_put_tree_node(writer, &node->nodes[n]);
+	}
+}
+
+static int profiles_cache_write_file(const char *filename, const void *data, size_t size)
+{
+	int file = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (file < 0)
+		return -1;
+	const uint8_t *data_cur = data;
+	while (size > 0)
+	{
+		ssize_t written = write(file, data_cur, size);
+		if ((written < 0) && (errno == EINTR))
+			continue;
+		if (written <= 0)
+			break;
+		data_cur += written;
+		size -= written;
+	}
+	return ((close(file) == 0) && (size == 0)) ? 0 : -1;
+}
+
+// Errors are ignored: without a valid cache the XML is just parsed on each start
+static void profiles_cache_write(struct profiles *profiles, const struct stat *source_stat)
+{
+	struct profiles_cache_writer writer;
+	memset(&writer, 0, sizeof(writer));
+	struct profiles_cache_header header;
+	memset(&header, 0, sizeof(header));
+	// Reserve the header to write the whole file at once
+	profiles_cache_put(&writer, &header, sizeof(header));
+	profiles_cache_put_u32(&writer, profiles->profile_list_count);
+	struct profile_list_item *item;
+	for (item = profiles->profile_list_head; item != NULL; item = item->next)
+	{
+		profiles_cache_put_string(&writer, item->profile.identifier);
+		profiles_cache_put_string(&writer, item->profile.title);
+		profiles_cache_put_string(&writer, item->profile.inherit);
+		profiles_cache_put_u32(&writer, item->profile.hidden);
+		profiles_cache_put_setting_vector(&writer, &item->profile.app_settings);
+		profiles_cache_put_setting_vector(&writer, &item->profile.encoder_settings);
+		profiles_cache_put_setting_vector(&writer, &item->profile.decoder_settings);
+	}
+	profiles_cache_put_u32(&writer, profiles->profile_tree != NULL);
+	if (profiles->profile_tree)
+		profiles_cache_put_tree_node(&writer, profiles->profile_tree);
+	memcpy(header.magic, PROFILES_CACHE_MAGIC, sizeof(header.magic));
+	header.version = PROFILES_CACHE_VERSION;
+	header.payload_size = writer.size - sizeof(header);
+	header.source_mtime_sec = source_stat->st_mtim.tv_sec;
+	header.source_mtime_nsec = source_stat->st_mtim.tv_nsec;
+	header.source_size = source_stat->st_size;
+	header.payload_hash = profiles_hash(writer.data + sizeof(header), header.payload_size,
+			FNV1A_OFFSET_BASIS);
+	memcpy(writer.data, &header, sizeof(header));
+	// Replaced atomically not to leave a truncated cache to a concurrent instance
+	if (profiles_cache_write_file(PROFILES_CACHE_FILENAME ".tmp", writer.data, writer.size) == 0)
+	{
+		if (rename(PROFILES_CACHE_FILENAME ".tmp", PROFILES_CACHE_FILENAME) < 0)
+			unlink(PROFILES_CACHE_FILENAME ".tmp");
+	}
+	else
+	{
+		unlink(PROFILES_CACHE_FILENAME ".tmp");
+	}
+	free(writer.data);
+}
+
+static uint32_t profiles_cache_get_u32(struct profiles_cache_reader *reader)
+{
+	uint32_t value;
+	if (reader->data_end - reader->data < sizeof(value))
+	{
+		reader->error = 1;
+		return 0;
+	}
+	memcpy(&value, reader->data, sizeof(value));
+	reader->data += sizeof(value);
+	return value;
+}
+
+// Returns a pointer into the cache data (NULL for the NULL strings)
+static const char *profiles_cache_get_string(struct profiles_cache_reader *reader)
+{
+	uint32_t size = profiles_cache_get_u32(reader);
+	if (reader->error || (size == PROFILES_CACHE_NULL_STRING))
+		return NULL;
+	if ((size == 0) || (reader->data_end - reader->data < size)
+			|| (reader->data[size - 1] != '\0'))
+	{
+		reader->error = 1;
+		return NULL;
+	}
+	const char *text = (const char*) reader->data;
+	reader->data += size;
+	return text;
+}
+
+static void profiles_cache_get_setting_vector(struct profiles_cache_reader *reader,
+		struct setting_vector *setting_vector)
+{
+	uint32_t n;
+	const char *plugin = profiles_cache_get_string(reader);
+	if (plugin)
+		setting_vector->plugin = strdup(plugin);
+	uint32_t count = profiles_cache_get_u32(reader);
+	for (n = 0; (n < count) && !reader->error; n++)
+	{
+		const char *setting_identifier = profiles_cache_get_string(reader);
+		const char *setting_value = profiles_cache_get_string(reader);
+		if ((setting_identifier != NULL) && (setting_value != NULL))
+			profiles_add_setting_string(setting_vector, setting_identifier, setting_value);
+		else
+			reader->error = 1;
+	}
+}
+
+static void profiles_cache_get_tree_node(struct profiles_cache_reader *reader,
+		struct tree_node_vector *node)
+{
+	uint32_t n;
+	uint32_t count = profiles_cache_get_u32(reader);
+	for (n = 0; (n < count) && !reader->error; n++)
+	{
+		const char *profile_identifier = profiles_cache_get_string(reader);
+		if (profile_identifier != NULL)
+			profiles_add_tree_profile(&node->profile_identifiers, profile_identifier);
+		else
+			reader->error = 1;
+	}
+	count = profiles_cache_get_u32(reader);
+	for (n = 0; (n < count) && !reader->error; n++)
+	{
+		const char *title = profiles_cache_get_string(reader);
+		if (title == NULL)
+		{
+			reader->error = 1;
+			break;
+		}
+		profiles_add_tree_node(node, title);
+		profiles_cache_get_tree_node(reader, &node->nodes[node->nodes_count - 1]);
+	}
+}
+
+static int profiles_cache_parse(struct profiles *profiles, const uint8_t *data, size_t size,
+		const struct stat *source_stat)
+{
+	struct profiles_cache_header header;
+	if (size < sizeof(header))
+		return -1;
+	memcpy(&header, data, sizeof(header));
+	if ((memcmp(header.magic, PROFILES_CACHE_MAGIC, sizeof(header.magic)) != 0)
+			|| (header.version != PROFILES_CACHE_VERSION)
+			|| (header.payload_size != size - sizeof(header))
+			|| (header.source_mtime_sec != source_stat->st_mtim.tv_sec)
+			|| (header.source_mtime_nsec != source_stat->st_mtim.tv_nsec)
+			|| (header.source_size != source_stat->st_size)
+			|| (header.payload_hash != profiles_hash(data + sizeof(header), header.payload_size,
+					FNV1A_OFFSET_BASIS)))
+		return -1;
+	struct profiles_cache_reader reader;
+	reader.data = data + sizeof(header);
+	reader.data_end = data + size;
+	reader.error = 0;
+	uint32_t n;
+	uint32_t profiles_count = profiles_cache_get_u32(&reader);
+	for (n = 0; (n < profiles_count) && !reader.error; n++)
+	{
+		const char *profile_identifier = profiles_cache_get_string(&reader);
+		const char *profile_title = profiles_cache_get_string(&reader);
+		const char *profile_inherit = profiles_cache_get_string(&reader);
+		int hidden = profiles_cache_get_u32(&reader);
+		if ((profile_identifier == NULL) || (profile_title == NULL))
+		{
+			reader.error = 1;
+			break;
+		}
+		profiles_add_profile(profiles, profile_identifier, profile_inherit, profile_title, hidden);
+		struct profile *profile = &profiles->profile_list_cur->profile;
+		profiles_cache_get_setting_vector(&reader, &profile->app_settings);
+		profiles_cache_get_setting_vector(&reader, &profile->encoder_settings);
+		profiles_cache_get_setting_vector(&reader, &profile->decoder_settings);
+	}
+	if (profiles_cache_get_u32(&reader) && !reader.error)
+	{
+		profiles->profile_tree = calloc(1, sizeof(struct tree_node_vector));
+		profiles_cache_get_tree_node(&reader, profiles->profile_tree);
+	}
+	if (reader.error || (reader.data != reader.data_end))
+	{
+		profiles_clear(profiles);
+		return -1;
+	}
+	return 0;
+}
+
+// Returns 0 if the cache matches the source XML and has been loaded
+static int profiles_cache_read(struct profiles *profiles, const struct stat *source_stat)
+{
+	int file = open(PROFILES_CACHE_FILENAME, O_RDONLY);
+	if (file < 0)
+		return -1;
+	int ret = -1;
+	struct stat cache_stat;
+	if ((fstat(file, &cache_stat) == 0) && (cache_stat.st_size > 0))
+	{
+		void *data = mmap(NULL, cache_stat.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+		if (data != MAP_FAILED)
+		{
+			ret = profiles_cache_parse(profiles, data, cache_stat.st_size, source_stat);
+			munmap(data, cache_stat.st_size);
+		}
+	}
+	close(file);
+	return ret;
+}
+
+static void profiles_load_xml(struct profiles *profiles)
+{
+	struct stat source_stat;
+	if (stat(PROFILES_FILENAME, &source_stat) < 0)
+	{
+		fprintf(stderr, "Unable to open %s\n", PROFILES_FILENAME);
+		profiles_load_defaults(profiles);
+	}
+	else if (profiles_cache_read(profiles, &source_stat) < 0)
+	{
+		// Initialize the library and check that the loaded library is compatible with the version
+		// it was compiled
+		LIBXML_TEST_VERSION
+		if (profiles_xml_parse_file(profiles, PROFILES_FILENAME) == 0)
+			profiles_cache_write(profiles, &source_stat);
+		else
+			profiles_load_defaults(profiles);
+		xmlCleanupParser();
+		// Debug memory for regression tests
+		xmlMemoryDump();
+	}
+	profiles_build_index(profiles);
+}
+
+struct profiles *profiles_create(void)
+{
+	struct profiles *profiles = calloc(1, sizeof(struct profiles));
+	profiles_load_xml(profiles);
+	return profiles;
+}
+
+void profiles_release(struct profiles *profiles)
+{
+	profiles_clear(profiles);
 	free(profiles);
 }
 
@@ -667,51 +1095,47 @@ struct push_profile_params
 static void profiles_push_profile(struct profiles *profiles,
 		struct push_profile_params *push_profile_params, const char *profile_identifier)
 {
-	struct profile_list_item *item;
-	for (item = profiles->profile_list_head; item != NULL; item = item->next)
+	struct profile_list_item *item = profiles_find(profiles, profile_identifier);
+	if (item == NULL)
 	{
-		if (strcmp(profile_identifier, item->profile.identifier) == 0)
-		{
-			// TODO: Check for circular references (with a depth counter for example)
-			if (item->profile.inherit != NULL)
-				profiles_push_profile(profiles, push_profile_params, item->profile.inherit);
-			settings_set_app_settings(push_profile_params->settings,
-					item->profile.app_settings.count, item->profile.app_settings.settings);
-			plc_setting_set_settings(item->profile.encoder_settings.count,
-					item->profile.encoder_settings.settings,
-					push_profile_params->encoder_setting_list);
-			plc_setting_set_settings(item->profile.decoder_settings.count,
-					item->profile.decoder_settings.settings,
-					push_profile_params->decoder_setting_list);
-			if (item->profile.encoder_settings.plugin)
-			{
-				if (*push_profile_params->encoder_plugin_name == NULL)
-					*push_profile_params->encoder_plugin_name = strdup(
-							item->profile.encoder_settings.plugin);
-				else if (strcmp(*push_profile_params->encoder_plugin_name,
-						*push_profile_params->encoder_plugin_name) != 0)
-					log_format("Invalidad mix of profiles using a different encoder: "
-							"'%s'ignored (expected '%s')\n",
-							push_profile_params->encoder_plugin_name,
-							*push_profile_params->encoder_plugin_name);
-			}
-			if (item->profile.decoder_settings.plugin)
-			{
-				if (*push_profile_params->decoder_plugin_name == NULL)
-					*push_profile_params->decoder_plugin_name = strdup(
-							item->profile.decoder_settings.plugin);
-				else if (strcmp(*push_profile_params->decoder_plugin_name,
-						*push_profile_params->decoder_plugin_name) != 0)
-					log_format("Invalidad mix of profiles using a different decoder: "
-							"'%s'ignored (expected '%s')\n",
-							push_profile_params->decoder_plugin_name,
-							*push_profile_params->decoder_plugin_name);
-			}
-			return;
-		}
+		log_format("Requested profile '%s' doesn't have a definition in the XML -> ignored\n",
+				profile_identifier);
+		return;
+	}
+	// TODO: Check for circular references (with a depth counter for example)
+	if (item->profile.inherit != NULL)
+		profiles_push_profile(profiles, push_profile_params, item->profile.inherit);
+	uint32_t n;
+	const struct setting_vector *app_settings = &item->profile.app_settings;
+	for (n = 0; n < app_settings->count; n++)
+		settings_set_app_setting(push_profile_params->settings,
+				app_settings->app_setting_indexes[n], &app_settings->settings[n]);
+	plc_setting_set_settings(item->profile.encoder_settings.count,
+			item->profile.encoder_settings.settings, push_profile_params->encoder_setting_list);
+	plc_setting_set_settings(item->profile.decoder_settings.count,
+			item->profile.decoder_settings.settings, push_profile_params->decoder_setting_list);
+	if (item->profile.encoder_settings.plugin)
+	{
+		if (*push_profile_params->encoder_plugin_name == NULL)
+			*push_profile_params->encoder_plugin_name = strdup(
+					item->profile.encoder_settings.plugin);
+		else if (strcmp(*push_profile_params->encoder_plugin_name,
+				*push_profile_params->encoder_plugin_name) != 0)
+			log_format("Invalidad mix of profiles using a different encoder: "
+					"'%s'ignored (expected '%s')\n", push_profile_params->encoder_plugin_name,
+					*push_profile_params->encoder_plugin_name);
+	}
+	if (item->profile.decoder_settings.plugin)
+	{
+		if (*push_profile_params->decoder_plugin_name == NULL)
+			*push_profile_params->decoder_plugin_name = strdup(
+					item->profile.decoder_settings.plugin);
+		else if (strcmp(*push_profile_params->decoder_plugin_name,
+				*push_profile_params->decoder_plugin_name) != 0)
+			log_format("Invalidad mix of profiles using a different decoder: "
+					"'%s'ignored (expected '%s')\n", push_profile_params->decoder_plugin_name,
+					*push_profile_params->decoder_plugin_name);
 	}
-	log_format("Requested profile '%s' doesn't have a definition in the XML -> ignored\n",
-			profile_identifier);
 }
 
 void profiles_push_profile_settings(struct profiles *profiles, const char *profile_identifier,
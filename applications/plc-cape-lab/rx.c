@@ -8,12 +8,15 @@
  */
 
 #define _GNU_SOURCE		// asprintf
+#include <errno.h>
 #include <math.h>		// ceil
 #include <pthread.h>
 #include <unistd.h>		// unlink
 #include "+common/api/+base.h"
+#include "capture_writer.h"
 #include "common.h"
 #include "decoder.h"
+#include "fanout.h"
 #include "libraries/libplc-adc/api/adc.h"
 #include "libraries/libplc-adc/api/analysis.h"
 #include "libraries/libplc-cape/api/leds.h"
@@ -21,6 +24,7 @@
 #include "libraries/libplc-tools/api/file.h"
 #include "libraries/libplc-tools/api/time.h"
 #include "monitor.h"
+#include "plugins/decoder/api/decoder.h"	// decoder_span
 #include "rx.h"
 #include "settings.h"
 
@@ -35,6 +39,12 @@ struct rx
 	struct plc_leds *leds;
 	struct plc_adc *plc_adc;
 	struct decoder *decoder;
+	// Main decoder followed by the extra ones
+	struct decoder **decoders;
+	uint32_t decoders_count;
+	struct fanout *fanout;
+	uint8_t **extra_data;
+	uint32_t *extra_data_count;
 	int adc_buffer_samples;
 	uint16_t *adc_sample_by_sample_buffer;
 	int adc_sample_by_sample_buffer_pos;
@@ -45,9 +55,13 @@ struct rx
 	uint32_t buffer_data_count;
 	char *file_rx_path;
 	int rx_data_detected;
-	sample_rx_t *buffer_to_file_rx;
-	sample_rx_t *buffer_to_file_rx_cur;
-	uint32_t buffer_to_file_rx_remaining;
+	// The samples are streamed to 'file_rx_path' while capturing
+	struct capture_writer *capture_writer;
+	// UINT64_MAX when storing until stopped
+	uint64_t samples_to_file_remaining;
+	// Samples kept in memory for 'demod_mode_deferred'
+	sample_rx_t *buffer_deferred;
+	sample_rx_t *buffer_deferred_cur;
 	char *file_data_path;
 	uint8_t *buffer_to_file_data;
 	uint8_t *buffer_to_file_data_cur;
@@ -59,10 +73,11 @@ const char *rx_mode_enum_text[rx_mode_COUNT] = {
 	"none", "sample_by_sample", "buffer_by_buffer", "kernel_buffering", };
 
 const char *demod_mode_enum_text[demod_mode_COUNT] = {
-	"none", "real_time", "deferred", };
+	"none", "real_time", "deferred", "parallel", };
 
 struct rx *rx_create(const struct rx_settings *settings, struct monitor *monitor,
-		struct plc_leds *leds, struct plc_adc *plc_adc, struct decoder *decoder)
+		struct plc_leds *leds, struct plc_adc *plc_adc, struct decoder *decoder,
+		struct decoder **extra_decoders, uint32_t extra_decoders_count)
 {
 	struct rx *rx = calloc(1, sizeof(struct rx));
 	rx->settings = *settings;
@@ -72,6 +87,10 @@ struct rx *rx_create(const struct rx_settings *settings, struct monitor *monitor
 	rx->leds = leds;
 	rx->plc_adc = plc_adc;
 	rx->decoder = decoder;
+	rx->decoders_count = 1 + extra_decoders_count;
+	rx->decoders = malloc(rx->decoders_count * sizeof(struct decoder *));
+	rx->decoders[0] = decoder;
+	memcpy(&rx->decoders[1], extra_decoders, extra_decoders_count * sizeof(struct decoder *));
 	char *output_dir = plc_application_get_output_abs_dir();
 	asprintf(&rx->file_rx_path, "%s/%s", output_dir, settings->samples_filename);
 	asprintf(&rx->file_data_path, "%s/%s", output_dir, settings->data_filename);
@@ -100,6 +119,7 @@ void rx_release(struct rx *rx)
 		free(rx->adc_sample_by_sample_buffer);
 	free(rx->file_data_path);
 	free(rx->file_rx_path);
+	free(rx->decoders);
 	plc_rx_analysis_release(rx->plc_rx_analysis);
 	free(rx);
 }
@@ -117,51 +137,294 @@ static void *thread_adc_rx_buffer(void *arg)
 	return NULL;
 }
 
+struct rx_deferred_chunk
+{
+	struct rx *rx;
+	struct decoder *decoder;
+	// First sample to decode, overlap included
+	const sample_rx_t *samples;
+	uint32_t samples_count;
+	uint32_t overlap_samples_count;
+	// The last chunk ends the stream
+	int end_of_stream;
+	uint8_t *data;
+	uint32_t data_capacity;
+	uint32_t data_count;
+	pthread_t thread;
+};
+
+// Decodes the whole span and, at the end of the stream, the incomplete tail kept by the decoder.
+//	'data' grows when the decoder lacks room for its next internal chunk, whose size and data bound
+//	can differ from the ADC buffer ones
+static uint32_t rx_deferred_decode(struct decoder *decoder, struct decoder_span span,
+		int end_of_stream, uint8_t **data, uint32_t *data_capacity)
+{
+	// The tail is not longer than the span the buffer has been sized for
+	uint32_t data_room_tail = *data_capacity + 1;
+	uint32_t data_count = 0;
+	while (span.samples_count > 0)
+	{
+		uint32_t samples_consumed;
+		data_count += decoder_parse_spans(decoder, &span, 1, *data + data_count,
+				*data_capacity - data_count, &samples_consumed);
+		span.samples += samples_consumed;
+		span.samples_count -= samples_consumed;
+		// Not fully consumed -> no room for the next internal chunk
+		if (span.samples_count > 0)
+		{
+			*data_capacity = 2 * *data_capacity + 1;
+			*data = realloc(*data, *data_capacity);
+		}
+	}
+	while (end_of_stream)
+	{
+		if (*data_capacity - data_count < data_room_tail)
+		{
+			*data_capacity = data_count + data_room_tail;
+			*data = realloc(*data, *data_capacity);
+		}
+		// Repeated until nothing is left: the decoder can deliver its pending data first
+		uint32_t samples_flushed;
+		uint32_t data_flushed = decoder_parse_spans(decoder, NULL, 0, *data + data_count,
+				*data_capacity - data_count, &samples_flushed);
+		data_count += data_flushed;
+		if ((data_flushed == 0) && (samples_flushed == 0))
+			break;
+	}
+	return data_count;
+}
+
+static void *rx_deferred_chunk_thread(void *arg)
+{
+	struct rx_deferred_chunk *chunk = arg;
+	// The whole chunk is contiguous -> decoded with a single call instead of one per ADC buffer
+	struct decoder_span overlap_span = {
+		chunk->samples, chunk->overlap_samples_count };
+	struct decoder_span span = {
+		overlap_span.samples + overlap_span.samples_count,
+		chunk->samples_count - chunk->overlap_samples_count };
+	// The data decoded on the overlap belongs to the previous chunk -> overwritten
+	if (overlap_span.samples_count > 0)
+		rx_deferred_decode(chunk->decoder, overlap_span, 0, &chunk->data, &chunk->data_capacity);
+	chunk->data_count = rx_deferred_decode(chunk->decoder, span, chunk->end_of_stream,
+			&chunk->data, &chunk->data_capacity);
+	return NULL;
+}
+
+// Decodes the whole capture serially with a fresh duplicate of the main decoder and compares the
+//	result with the stitched output of the chunks
+static void rx_verify_deferred(struct rx *rx, uint32_t samples_count, const uint8_t *data,
+		uint32_t data_count)
+{
+	uint32_t data_capacity = (samples_count / rx->adc_buffer_samples + 1) * rx->buffer_data_count;
+	uint8_t *serial_data = malloc(data_capacity);
+	struct decoder *decoder = decoder_duplicate(rx->decoder, 0);
+	decoder_initialize_demodulator(decoder, rx->adc_buffer_samples);
+	struct decoder_span span = {
+		rx->buffer_deferred, samples_count };
+	uint32_t serial_data_count = rx_deferred_decode(decoder, span, 1, &serial_data,
+			&data_capacity);
+	decoder_terminate_demodulator(decoder);
+	decoder_release(decoder);
+	uint32_t n;
+	for (n = 0; (n < data_count) && (n < serial_data_count); n++)
+		if (data[n] != serial_data[n])
+			break;
+	if ((n == data_count) && (n == serial_data_count))
+		log_format("Deferred demodulation check: %u data, identical to the serial decoding\n",
+				data_count);
+	else
+		log_format("Deferred demodulation check FAILED: %u data in chunks, %u serially, first "
+				"difference at %u. Increase 'deferred_overlap_bits'\n", data_count,
+				serial_data_count, n);
+	free(serial_data);
+}
+
+// Splits the captured samples in chunks decoded in parallel. Every chunk but the first one uses a
+//	duplicated decoder starting 'deferred_overlap_bits' before the chunk to reach the same state the
+//	serial decoding would have. Results are stitched in chunk order. Only the last chunk flushes
+//	the tail of the decoder: a frame crossing a boundary is never completed by the chunk before
+//	it, and the data completed by the next one while still on its overlap is discarded
+static void rx_demodulate_deferred(struct rx *rx)
+{
+	// The chunks are cut on ADC buffer boundaries. The last one takes the incomplete buffer
+	uint32_t samples_count = rx->buffer_deferred_cur - rx->buffer_deferred;
+	uint32_t buffers_count = samples_count / rx->adc_buffer_samples;
+	uint32_t overlap_buffers_count = ceil(
+			rx->settings.deferred_overlap_bits * rx->rx_samples_per_bit / rx->adc_buffer_samples);
+	uint32_t chunks_count =
+			(rx->settings.deferred_threads > 0) ?
+					rx->settings.deferred_threads : sysconf(_SC_NPROCESSORS_ONLN);
+	// Chunks not longer than the overlap are not worth
+	if (chunks_count > buffers_count / (overlap_buffers_count + 1))
+		chunks_count = buffers_count / (overlap_buffers_count + 1);
+	if (chunks_count == 0)
+		chunks_count = 1;
+	struct timespec stamp_ini = plc_time_get_hires_stamp();
+	struct rx_deferred_chunk *chunks = calloc(chunks_count, sizeof(struct rx_deferred_chunk));
+	uint32_t n;
+	for (n = 0; n < chunks_count; n++)
+	{
+		struct rx_deferred_chunk *chunk = &chunks[n];
+		uint32_t buffer_ini = (uint64_t) buffers_count * n / chunks_count;
+		uint32_t buffer_end = (uint64_t) buffers_count * (n + 1) / chunks_count;
+		chunk->rx = rx;
+		if (n == 0)
+		{
+			chunk->decoder = rx->decoder;
+		}
+		else
+		{
+			buffer_ini -= overlap_buffers_count;
+			chunk->overlap_samples_count = overlap_buffers_count * rx->adc_buffer_samples;
+			// The chunk decoder starts with the carrier phase the serial one has at its overlap
+			chunk->decoder = decoder_duplicate(rx->decoder, buffer_ini * rx->adc_buffer_samples);
+			decoder_initialize_demodulator(chunk->decoder, rx->adc_buffer_samples);
+		}
+		chunk->samples = rx->buffer_deferred + buffer_ini * rx->adc_buffer_samples;
+		chunk->end_of_stream = (n == chunks_count - 1);
+		chunk->samples_count = (chunk->end_of_stream ? samples_count
+				: buffer_end * rx->adc_buffer_samples) - buffer_ini * rx->adc_buffer_samples;
+		chunk->data_capacity = (chunk->samples_count / rx->adc_buffer_samples + 1)
+				* rx->buffer_data_count;
+		chunk->data = malloc(chunk->data_capacity);
+		if (chunks_count > 1)
+		{
+			int ret = pthread_create(&chunk->thread, NULL, rx_deferred_chunk_thread, chunk);
+			assert(ret == 0);
+		}
+	}
+	if (chunks_count == 1)
+		rx_deferred_chunk_thread(&chunks[0]);
+	// Stitched output of all the chunks, only kept for 'deferred_verify'
+	uint8_t *data = NULL;
+	uint32_t data_count = 0;
+	for (n = 0; n < chunks_count; n++)
+	{
+		struct rx_deferred_chunk *chunk = &chunks[n];
+		if (chunks_count > 1)
+		{
+			int ret = pthread_join(chunk->thread, NULL);
+			assert(ret == 0);
+		}
+		uint32_t data_demodulated = chunk->data_count;
+		monitor_on_data_decoded(rx->monitor, chunk->data, data_demodulated);
+		if (rx->settings.deferred_verify)
+		{
+			data = realloc(data, data_count + data_demodulated);
+			memcpy(data + data_count, chunk->data, data_demodulated);
+			data_count += data_demodulated;
+		}
+		if (data_demodulated > rx->buffer_to_file_data_remaining)
+			data_demodulated = rx->buffer_to_file_data_remaining;
+		memcpy(rx->buffer_to_file_data_cur, chunk->data, data_demodulated);
+		rx->buffer_to_file_data_cur += data_demodulated;
+		rx->buffer_to_file_data_remaining -= data_demodulated;
+		free(chunk->data);
+		if (n > 0)
+		{
+			decoder_terminate_demodulator(chunk->decoder);
+			decoder_release(chunk->decoder);
+		}
+	}
+	free(chunks);
+	log_format("Deferred demodulation: %u buffers in %u chunks, %u us\n", buffers_count,
+			chunks_count,
+			plc_time_hires_interval_to_usec(stamp_ini, plc_time_get_hires_stamp()));
+	if (rx->settings.deferred_verify)
+	{
+		rx_verify_deferred(rx, samples_count, data, data_count);
+		free(data);
+	}
+}
+
+static void rx_log_data_decoded(struct rx *rx, uint8_t *data, uint32_t data_count)
+{
+	// Replace non-ASCII chars by points
+	uint8_t *buffer = data;
+	uint32_t i;
+	for (i = data_count; i > 0; i--, buffer++)
+		if (((*buffer < 0x20) || (*buffer > 0x7F)) && (*buffer != '\n'))
+			*buffer = '.';
+	log_format("%.*s", data_count, data);
+	monitor_on_data_decoded(rx->monitor, data, data_count);
+	if (rx->buffer_to_file_data_remaining)
+	{
+		if (data_count > rx->buffer_to_file_data_remaining)
+			data_count = rx->buffer_to_file_data_remaining;
+		memcpy(rx->buffer_to_file_data_cur, data, data_count);
+		rx->buffer_to_file_data_cur += data_count;
+		rx->buffer_to_file_data_remaining -= data_count;
+	}
+}
+
+// Called from the 'fanout' worker threads. Each 'decoder_index' always comes from the same thread
+static void rx_on_data_decoded(void *handle, uint32_t decoder_index, uint8_t *data,
+		uint32_t data_count)
+{
+	struct rx *rx = handle;
+	if (decoder_index == 0)
+	{
+		rx_log_data_decoded(rx, data, data_count);
+	}
+	else
+	{
+		// The extra decoders are not logged in real-time to not interleave their outputs
+		uint32_t n = decoder_index - 1;
+		uint32_t data_available = FILE_DATA_SAMPLES - rx->extra_data_count[n];
+		if (data_count > data_available)
+			data_count = data_available;
+		memcpy(rx->extra_data[n] + rx->extra_data_count[n], data, data_count);
+		rx->extra_data_count[n] += data_count;
+	}
+}
+
 static int rx_on_buffer_completed(struct rx *rx, sample_rx_t *samples_buffer,
-		uint32_t samples_buffer_count)
+		uint32_t samples_buffer_count, const struct plc_buffer_stamp *stamp)
 {
 	struct timespec stamp_ini = plc_time_get_hires_stamp();
 	int data_detected = plc_rx_analysis_analyze_buffer(rx->plc_rx_analysis, samples_buffer,
 			samples_buffer_count);
 	if (data_detected)
 		rx->rx_data_detected = 1;
-	monitor_on_buffer_received(rx->monitor, samples_buffer, samples_buffer_count);
+	monitor_on_buffer_received(rx->monitor, samples_buffer, samples_buffer_count, stamp);
 	if (rx->rx_data_detected)
 	{
-		if (rx->buffer_to_file_rx_remaining > 0)
+		if (rx->samples_to_file_remaining > 0)
 		{
 			// Storage in file (if enabled)
-			int samples_to_copy =
-					(rx->buffer_to_file_rx_remaining <= rx->adc_buffer_samples) ?
-							rx->buffer_to_file_rx_remaining : rx->adc_buffer_samples;
-			memcpy(rx->buffer_to_file_rx_cur, samples_buffer,
-					samples_to_copy * sizeof(sample_rx_t));
-			rx->buffer_to_file_rx_cur += samples_to_copy;
-			rx->buffer_to_file_rx_remaining -= samples_to_copy;
-			if (rx->buffer_to_file_rx_remaining == 0)
+			uint32_t samples_to_copy =
+					(rx->samples_to_file_remaining <= samples_buffer_count) ?
+							rx->samples_to_file_remaining : samples_buffer_count;
+			// The dropped samples are counted by the writer
+			capture_writer_push_samples(rx->capture_writer, samples_buffer, samples_to_copy,
+					stamp->timestamp_ns);
+			if (rx->buffer_deferred)
+			{
+				memcpy(rx->buffer_deferred_cur, samples_buffer,
+						samples_to_copy * sizeof(sample_rx_t));
+				rx->buffer_deferred_cur += samples_to_copy;
+			}
+			rx->samples_to_file_remaining -= samples_to_copy;
+			if (rx->samples_to_file_remaining == 0)
 				log_line("RX file captured");
 		}
+		// The decoders take whole buffers: the tail of a replay is completed with the DC level
+		uint32_t n;
+		for (n = samples_buffer_count; n < rx->adc_buffer_samples; n++)
+			samples_buffer[n] = rx->settings.data_offset;
 		// Demodulation in real-time (if enabled)
 		if (rx->settings.demod_mode == demod_mode_real_time)
 		{
 			uint32_t data_demodulated = decoder_parse_next_samples(rx->decoder, samples_buffer,
 					rx->buffer_data, rx->buffer_data_count);
 			assert(data_demodulated <= rx->buffer_data_count);
-			// Replace non-ASCII chars by points
-			uint8_t *buffer = rx->buffer_data;
-			uint32_t i;
-			for (i = data_demodulated; i > 0; i--, buffer++)
-				if (((*buffer < 0x20) || (*buffer > 0x7F)) && (*buffer != '\n'))
-					*buffer = '.';
-			log_format("%.*s", data_demodulated, rx->buffer_data);
-			if (rx->buffer_to_file_data_remaining)
-			{
-				if (data_demodulated > rx->buffer_to_file_data_remaining)
-					data_demodulated = rx->buffer_to_file_data_remaining;
-				memcpy(rx->buffer_to_file_data_cur, rx->buffer_data, data_demodulated);
-				rx->buffer_to_file_data_cur += data_demodulated;
-				rx->buffer_to_file_data_remaining -= data_demodulated;
-			}
+			rx_log_data_decoded(rx, rx->buffer_data, data_demodulated);
+		}
+		// Demodulation on the worker threads (if enabled)
+		else if (rx->settings.demod_mode == demod_mode_parallel)
+		{
+			fanout_push_buffer(rx->fanout, samples_buffer);
 		}
 	}
 	uint32_t buffer_processing_us = plc_time_hires_interval_to_usec(stamp_ini,
@@ -171,12 +434,72 @@ static int rx_on_buffer_completed(struct rx *rx, sample_rx_t *samples_buffer,
 }
 
 static void rx_on_buffer_completed_wrapper(void *rx, sample_rx_t *samples_buffer,
-		uint32_t samples_buffer_count)
+		uint32_t samples_buffer_count, const struct plc_buffer_stamp *stamp)
 {
-	int data_detected = rx_on_buffer_completed(rx, samples_buffer, samples_buffer_count);
+	int data_detected = rx_on_buffer_completed(rx, samples_buffer, samples_buffer_count, stamp);
 	plc_leds_set_rx_activity(((struct rx*) rx)->leds, data_detected);
 }
 
+// PRECONDITION: 'fanout' stopped
+static void rx_release_fanout(struct rx *rx)
+{
+	fanout_release(rx->fanout);
+	rx->fanout = NULL;
+	uint32_t n;
+	for (n = 1; n < rx->decoders_count; n++)
+	{
+		decoder_terminate_demodulator(rx->decoders[n]);
+		free(rx->extra_data[n - 1]);
+	}
+	free(rx->extra_data);
+	rx->extra_data = NULL;
+	free(rx->extra_data_count);
+	rx->extra_data_count = NULL;
+}
+
+static void rx_log_fanout_statistics(struct rx *rx)
+{
+	uint32_t n;
+	for (n = 0; n < rx->decoders_count; n++)
+	{
+		struct fanout_statistics statistics;
+		fanout_get_statistics(rx->fanout, n, &statistics);
+		log_format("Decoder %u '%s': %u buffers, %u dropped, backlog max %u, max %u us, "
+				"%u bytes\n", n, decoder_get_name(rx->decoders[n]), statistics.buffers_processed,
+				statistics.buffers_dropped, statistics.backlog_max, statistics.processing_max_us,
+				statistics.data_decoded);
+		if (n > 0)
+			log_format("  %.*s\n", rx->extra_data_count[n - 1], rx->extra_data[n - 1]);
+	}
+}
+
+static void rx_log_adc_statistics(struct rx *rx)
+{
+	struct plc_adc_statistics statistics;
+	plc_adc_get_statistics(rx->plc_adc, &statistics);
+	log_format("ADC: %u buffers, %u overflowed, queue max %u, in use max %u/%u%s\n",
+			statistics.buffers_captured, statistics.buffers_overflowed,
+			statistics.queue_high_water, statistics.buffers_in_use_high_water,
+			statistics.pool_depth, statistics.end_of_capture ? ", end of capture" : "");
+	if (rx->settings.capture_info.device == plc_rx_device_alsa)
+		log_format("ALSA RX: %u xruns, %u recoveries, delay %u frames (max %u)\n",
+				statistics.alsa.xruns, statistics.alsa.recoveries, statistics.alsa.delay_frames,
+				statistics.alsa.delay_max_frames);
+}
+
+static void rx_log_capture_writer_statistics(struct rx *rx)
+{
+	struct capture_writer_statistics statistics;
+	capture_writer_get_statistics(rx->capture_writer, &statistics);
+	log_format("RX file: %u buffers, %u dropped, queue max %u/%u, %u files, %llu bytes, "
+			"write max %u us%s\n", statistics.buffers_written, statistics.buffers_dropped,
+			statistics.queue_high_water, CAPTURE_WRITER_QUEUE_DEPTH, statistics.files_count,
+			(unsigned long long) statistics.bytes_written, statistics.write_max_us,
+			statistics.direct_io ? ", direct I/O" : "");
+	if (statistics.error)
+		log_format("RX file error: %s\n", strerror(statistics.error));
+}
+
 int rx_start_capture(struct rx *rx)
 {
 	usleep(100000);
@@ -196,14 +519,39 @@ int rx_start_capture(struct rx *rx)
 	if (access(rx->file_data_path, F_OK) != -1)
 		unlink(rx->file_data_path);
 	rx->rx_data_detected = 0;
-	rx->buffer_to_file_rx_remaining = rx->settings.samples_to_file;
-	if (rx->settings.samples_to_file)
+	rx->samples_to_file_remaining = 0;
+	if (rx->settings.samples_file)
 	{
-		rx->buffer_to_file_rx = malloc(rx->settings.samples_to_file * sizeof(sample_rx_t));
+		rx->samples_to_file_remaining =
+				rx->settings.samples_to_file ? rx->settings.samples_to_file : UINT64_MAX;
+		struct capture_writer_settings capture_writer_settings;
+		capture_writer_settings.path = rx->file_rx_path;
+		capture_writer_settings.rotate_mb = rx->settings.file_rotate_mb;
+		capture_writer_settings.rotate_seconds = rx->settings.file_rotate_seconds;
+		capture_writer_settings.direct_io = rx->settings.file_direct_io;
+		capture_writer_settings.capture_info = &rx->settings.capture_info;
+		rx->capture_writer = capture_writer_create(&capture_writer_settings,
+				rx->adc_buffer_samples);
+		if (capture_writer_start(rx->capture_writer) < 0)
+		{
+			log_format("Unable to create the RX file '%s': %s\n", rx->file_rx_path,
+					strerror(errno));
+			goto error_on_capture_writer_start;
+		}
+		// Only the deferred demodulation requires the whole capture in memory, so a bounded one
+		if (rx->settings.demod_mode == demod_mode_deferred)
+		{
+			if ((rx->settings.samples_to_file > 0) && (rx->settings.samples_to_file <= UINT32_MAX)
+					&& (rx->settings.samples_to_file <= SIZE_MAX / sizeof(sample_rx_t)))
+				rx->buffer_deferred = malloc(rx->settings.samples_to_file * sizeof(sample_rx_t));
+			if (rx->buffer_deferred == NULL)
+				log_line("Deferred demodulation disabled: it requires 'samples_to_file' samples "
+						"in memory");
+		}
 		rx->buffer_to_file_data_remaining = FILE_DATA_SAMPLES;
 		rx->buffer_to_file_data = malloc(FILE_DATA_SAMPLES);
 	}
-	rx->buffer_to_file_rx_cur = rx->buffer_to_file_rx;
+	rx->buffer_deferred_cur = rx->buffer_deferred;
 	rx->buffer_to_file_data_cur = rx->buffer_to_file_data;
 	TRACE(3, "Setting callback");
 	plc_adc_set_rx_buffer_completed_callback(rx->plc_adc, rx_on_buffer_completed_wrapper, rx);
@@ -211,12 +559,30 @@ int rx_start_capture(struct rx *rx)
 	decoder_initialize_demodulator(rx->decoder, rx->adc_buffer_samples);
 	rx->buffer_data_count = ceil((float) rx->adc_buffer_samples / rx->rx_samples_per_bit / 8.0);
 	rx->buffer_data = malloc(rx->buffer_data_count);
+	if (rx->settings.demod_mode == demod_mode_parallel)
+	{
+		uint32_t n;
+		rx->extra_data = malloc((rx->decoders_count - 1) * sizeof(uint8_t *));
+		rx->extra_data_count = calloc(rx->decoders_count - 1, sizeof(uint32_t));
+		for (n = 1; n < rx->decoders_count; n++)
+		{
+			decoder_initialize_demodulator(rx->decoders[n], rx->adc_buffer_samples);
+			rx->extra_data[n - 1] = malloc(FILE_DATA_SAMPLES);
+		}
+		rx->fanout = fanout_create(rx->plc_adc, rx->decoders, rx->decoders_count,
+				rx->adc_buffer_samples, rx->buffer_data_count, rx_on_data_decoded, rx);
+		fanout_start(rx->fanout);
+	}
 	TRACE(3, "plc_adc_start_capture");
 	switch (rx->settings.rx_mode)
 	{
 	case rx_mode_buffer_by_buffer:
 	case rx_mode_kernel_buffering:
 	{
+		// The buffers retained by the fanout are not available for the capture
+		plc_adc_set_pool_depth(rx->plc_adc, PLC_ADC_POOL_DEPTH_DEFAULT
+				+ ((rx->settings.demod_mode == demod_mode_parallel) ?
+						FANOUT_BUFFERS_RETAINED_MAX(rx->decoders_count) : 0));
 		int ret = plc_adc_start_capture(rx->plc_adc, rx->adc_buffer_samples,
 				(rx->settings.rx_mode == rx_mode_kernel_buffering),
 				rx->settings.capturing_rate_sps);
@@ -237,7 +603,12 @@ int rx_start_capture(struct rx *rx)
 	TRACE(3, "Capture started");
 	return 0;
 	// Error management
-	error_on_plc_adc_start_capture: if (rx->buffer_to_file_data)
+	error_on_plc_adc_start_capture: if (rx->fanout)
+	{
+		fanout_stop(rx->fanout);
+		rx_release_fanout(rx);
+	}
+	if (rx->buffer_to_file_data)
 	{
 		free(rx->buffer_to_file_data);
 		rx->buffer_to_file_data = NULL;
@@ -247,10 +618,17 @@ int rx_start_capture(struct rx *rx)
 		free(rx->buffer_data);
 		rx->buffer_data = NULL;
 	}
-	if (rx->buffer_to_file_rx)
+	if (rx->buffer_deferred)
+	{
+		free(rx->buffer_deferred);
+		rx->buffer_deferred = NULL;
+	}
+	if (rx->capture_writer)
+		capture_writer_stop(rx->capture_writer);
+	error_on_capture_writer_start: if (rx->capture_writer)
 	{
-		free(rx->buffer_to_file_rx);
-		rx->buffer_to_file_rx = NULL;
+		capture_writer_release(rx->capture_writer);
+		rx->capture_writer = NULL;
 	}
 	return -1;
 }
@@ -266,6 +644,7 @@ void rx_stop_capture(struct rx *rx)
 		case rx_mode_kernel_buffering:
 			plc_adc_stop_capture(rx->plc_adc);
 			usleep(100000);
+			rx_log_adc_statistics(rx);
 			break;
 		case rx_mode_sample_by_sample:
 		{
@@ -278,30 +657,26 @@ void rx_stop_capture(struct rx *rx)
 			assert(0);
 			break;
 		}
+		if (rx->capture_writer)
+		{
+			// The queued buffers are written before the writer ends
+			capture_writer_stop(rx->capture_writer);
+			rx_log_capture_writer_statistics(rx);
+			capture_writer_release(rx->capture_writer);
+			rx->capture_writer = NULL;
+		}
+		if (rx->fanout)
+		{
+			// The queued buffers are decoded before the workers end
+			fanout_stop(rx->fanout);
+			log_line("");
+			rx_log_fanout_statistics(rx);
+		}
 		// If real-time data logged add a new line for freshh logging
 		if (rx->settings.demod_mode == demod_mode_real_time)
 			log_line("");
-		if (rx->settings.samples_to_file)
-		{
-			if (rx->settings.demod_mode == demod_mode_deferred)
-			{
-				sample_rx_t *rx_cur = rx->buffer_to_file_rx;
-				sample_rx_t *rx_cur_end = rx->buffer_to_file_rx_cur - rx->adc_buffer_samples + 1;
-				for (; rx_cur < rx_cur_end; rx_cur += rx->adc_buffer_samples)
-				{
-					uint32_t data_demodulated = decoder_parse_next_samples(rx->decoder, rx_cur,
-							rx->buffer_data, rx->buffer_data_count);
-					if (rx->buffer_to_file_data_remaining)
-					{
-						if (data_demodulated > rx->buffer_to_file_data_remaining)
-							data_demodulated = rx->buffer_to_file_data_remaining;
-						memcpy(rx->buffer_to_file_data_cur, rx->buffer_data, data_demodulated);
-						rx->buffer_to_file_data_cur += data_demodulated;
-						rx->buffer_to_file_data_remaining -= data_demodulated;
-					}
-				}
-			}
-		}
+		if (rx->buffer_deferred)
+			rx_demodulate_deferred(rx);
 		if (rx->buffer_to_file_data)
 		{
 			ret = plc_file_write_csv(rx->file_data_path, csv_u8, rx->buffer_to_file_data,
@@ -316,14 +691,13 @@ void rx_stop_capture(struct rx *rx)
 		free(rx->buffer_data);
 		rx->buffer_data = NULL;
 	}
+	if (rx->fanout)
+		rx_release_fanout(rx);
 	decoder_terminate_demodulator(rx->decoder);
-	if (rx->buffer_to_file_rx)
+	if (rx->buffer_deferred)
 	{
-		ret = plc_file_write_csv(rx->file_rx_path, sample_rx_csv_enum, rx->buffer_to_file_rx,
-				rx->buffer_to_file_rx_cur - rx->buffer_to_file_rx, 0);
-		assert(ret >= 0);
-		free(rx->buffer_to_file_rx);
-		rx->buffer_to_file_rx = NULL;
+		free(rx->buffer_deferred);
+		rx->buffer_deferred = NULL;
 	}
 	plc_leds_set_rx_activity(rx->leds, 0);
 }
@@ -11,6 +11,8 @@
 #ifndef RX_H
 #define RX_H
 
+#include "libraries/libplc-tools/api/capture.h"
+
 extern const char *rx_mode_enum_text[];
 enum rx_mode_enum
 {
@@ -27,6 +29,7 @@ enum demod_mode_enum
 	demod_mode_none = 0,
 	demod_mode_real_time,
 	demod_mode_deferred,
+	demod_mode_parallel,
 	demod_mode_COUNT
 };
 
@@ -37,7 +40,23 @@ struct rx_settings
 	enum demod_mode_enum demod_mode;
 	const char *samples_filename;
 	const char *data_filename;
-	uint32_t samples_to_file;
+	// Stores the samples in 'samples_filename': 'samples_to_file' of them or, if 0, until stopped
+	int samples_file;
+	uint64_t samples_to_file;
+	// Rotation of the samples file by size and/or time (0 to disable)
+	uint32_t file_rotate_mb;
+	uint32_t file_rotate_seconds;
+	int file_direct_io;
+	// Metadata stored when the samples filename has the PLC_CAPTURE_EXTENSION (binary capture)
+	struct plc_capture_info capture_info;
+	// Threads used on 'demod_mode_deferred'. 0 for one per online CPU
+	uint32_t deferred_threads;
+	// Bits decoded by a fresh decoder before the start of each chunk on 'demod_mode_deferred'.
+	//	They must cover the warm-up of the decoder (filters, clock recovery) plus its longest frame
+	//	for the state at the chunk boundary to match the one of the serial decoding
+	uint32_t deferred_overlap_bits;
+	// Checks the chunked decoding against a serial one of the whole capture
+	int deferred_verify;
 	uint32_t bit_width_us;
 	uint16_t data_offset;
 	uint16_t data_hi_threshold_detection;
@@ -50,8 +69,10 @@ struct plc_leds;
 struct rx;
 struct settings;
 
+// 'extra_decoders' are only used on 'demod_mode_parallel', running concurrently with 'decoder'
 struct rx *rx_create(const struct rx_settings *settings, struct monitor *monitor,
-		struct plc_leds *leds, struct plc_adc *plc_adc, struct decoder *decoder);
+		struct plc_leds *leds, struct plc_adc *plc_adc, struct decoder *decoder,
+		struct decoder **extra_decoders, uint32_t extra_decoders_count);
 void rx_release(struct rx *rx);
 int rx_start_capture(struct rx *rx);
 void rx_stop_capture(struct rx *rx);
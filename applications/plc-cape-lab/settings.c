@@ -22,6 +22,10 @@
 #define TX_BUFFERS_LEN_DEFAULT 1024
 #define RX_SAMPLES_FILENAME "adc.csv"
 #define RX_DATA_FILENAME "adc_data.csv"
+#define LOG_RING_KB_DEFAULT 64
+// Enough for the OOK decoder: filter warm-up plus a whole frame (start bit, 8 data bits and 32
+//	guard bits)
+#define DEFERRED_OVERLAP_BITS_DEFAULT 64
 
 const char *operating_mode_enum_text[operating_mode_COUNT] = {
 	"none", "tx_dac", "tx_dac_txpga_txfilter", "tx_dac_txpga_txfilter_pa",
@@ -45,6 +49,36 @@ static void settings_release_resources(struct settings *settings)
 		free(settings->rx.data_filename);
 		settings->rx.data_filename = NULL;
 	}
+	if (settings->rx.extra_decoders)
+	{
+		free(settings->rx.extra_decoders);
+		settings->rx.extra_decoders = NULL;
+	}
+	if (settings->rx.replay_filename)
+	{
+		free(settings->rx.replay_filename);
+		settings->rx.replay_filename = NULL;
+	}
+	if (settings->metrics_file)
+	{
+		free(settings->metrics_file);
+		settings->metrics_file = NULL;
+	}
+	if (settings->metrics_socket)
+	{
+		free(settings->metrics_socket);
+		settings->metrics_socket = NULL;
+	}
+	if (settings->tx.alsa.device)
+	{
+		free(settings->tx.alsa.device);
+		settings->tx.alsa.device = NULL;
+	}
+	if (settings->rx.alsa.device)
+	{
+		free(settings->rx.alsa.device);
+		settings->rx.alsa.device = NULL;
+	}
 }
 
 void settings_set_defaults(struct settings *settings)
@@ -61,7 +95,10 @@ void settings_set_defaults(struct settings *settings)
 	settings->rx.sampling_rate_sps = ADC_MAX_CAPTURE_RATE_SPS;
 	settings->rx.samples_filename = strdup(RX_SAMPLES_FILENAME);
 	settings->rx.data_filename = strdup(RX_DATA_FILENAME);
+	settings->rx.replay_paced = 1;
+	settings->rx.deferred_overlap_bits = DEFERRED_OVERLAP_BITS_DEFAULT;
 	settings->monitor_profile = monitor_profile_buffers_processed;
+	settings->log_ring_kb = LOG_RING_KB_DEFAULT;
 }
 
 struct settings *settings_create(void)
@@ -147,13 +184,19 @@ char *settings_get_info(struct settings *settings, struct encoder *encoder, stru
 			asprintf(&decoder_info, "%s\n%s", decoder_get_name(decoder), decoder_settings);
 			free(decoder_settings);
 		}
+		char samples_to_file_text[32];
+		if (settings->rx.samples_to_file)
+			snprintf(samples_to_file_text, sizeof(samples_to_file_text), "%llu samples",
+					(unsigned long long) settings->rx.samples_to_file);
+		else
+			strcpy(samples_to_file_text, settings->rx.samples_file ? "until stopped" : "0 samples");
 		asprintf(&rx_info, "RX\n"
 				" %u:%s\n"
 				" %u:%s\n"
-				" ToFile: %u samples\n"
+				" ToFile: %s\n"
 				"%s", settings->rx.rx_mode, rx_mode_enum_text[settings->rx.rx_mode],
 				settings->rx.demod_mode, demod_mode_enum_text[settings->rx.demod_mode],
-				settings->rx.samples_to_file, decoder_info ? decoder_info : "");
+				samples_to_file_text, decoder_info ? decoder_info : "");
 		if (decoder_info)
 			free(decoder_info);
 	}
@@ -215,6 +258,14 @@ static const struct plc_setting_definition app_accepted_settings[] = {
 			.u32 = spi_tx_mode_none }, 1, &spi_tx_mode_captions, OFFSET(tx.tx_mode) }, {
 		"gain_tx_pga", plc_setting_enum, "Gain TX PGA", {
 			.u32 = afe_gain_tx_pga_025 }, 1, &afe_gain_tx_pga_captions, OFFSET(tx.gain_tx_pga) }, {
+		"tx_alsa_device", plc_setting_string, "TX ALSA PCM (empty=default)", {
+			.s = NULL }, 0, NULL, OFFSET(tx.alsa.device) }, {
+		"tx_alsa_mmap", plc_setting_bool, "TX ALSA mmap access", {
+			.u32 = 0 }, 0, NULL, OFFSET(tx.alsa.mmap) }, {
+		"tx_alsa_period_frames", plc_setting_u32, "TX ALSA period [frames] (0=buffer)", {
+			.u32 = 0 }, 0, NULL, OFFSET(tx.alsa.period_frames) }, {
+		"tx_alsa_periods", plc_setting_u32, "TX ALSA periods (0=default)", {
+			.u32 = 0 }, 0, NULL, OFFSET(tx.alsa.periods) }, {
 		"rx_sampling_rate_sps", plc_setting_float, "RX ADC rate [sps]", {
 			.f = ADC_MAX_CAPTURE_RATE_SPS }, 0, NULL, OFFSET(rx.sampling_rate_sps) }, {
 		"rx_mode", plc_setting_enum, "RX mode", {
@@ -223,10 +274,38 @@ static const struct plc_setting_definition app_accepted_settings[] = {
 			.s = RX_SAMPLES_FILENAME }, 0, NULL, OFFSET(rx.samples_filename) }, {
 		"rx_data_filename", plc_setting_string, "RX data filename", {
 			.s = RX_DATA_FILENAME }, 0, NULL, OFFSET(rx.data_filename) }, {
-		"samples_to_file", plc_setting_u32, "Samples to file", {
-			.u32 = 0 }, 0, NULL, OFFSET(rx.samples_to_file) }, {
+		"rx_samples_file", plc_setting_bool, "RX samples to file", {
+			.u32 = 0 }, 0, NULL, OFFSET(rx.samples_file) }, {
+		"samples_to_file", plc_setting_u64, "Samples to file (0=until stopped)", {
+			.u64 = 0 }, 0, NULL, OFFSET(rx.samples_to_file) }, {
+		"rx_file_rotate_mb", plc_setting_u32, "RX file rotation [MB] (0=none)", {
+			.u32 = 0 }, 0, NULL, OFFSET(rx.file_rotate_mb) }, {
+		"rx_file_rotate_seconds", plc_setting_u32, "RX file rotation [s] (0=none)", {
+			.u32 = 0 }, 0, NULL, OFFSET(rx.file_rotate_seconds) }, {
+		"rx_file_direct_io", plc_setting_bool, "RX file direct I/O", {
+			.u32 = 0 }, 0, NULL, OFFSET(rx.file_direct_io) }, {
 		"demod_mode", plc_setting_enum, "Samples to file", {
 			.u32 = demod_mode_none }, 1, &demod_mode_captions, OFFSET(rx.demod_mode) }, {
+		"rx_extra_decoders", plc_setting_string, "RX extra decoders (profiles)", {
+			.s = NULL }, 0, NULL, OFFSET(rx.extra_decoders) }, {
+		"deferred_threads", plc_setting_u32, "Deferred demod threads (0=auto)", {
+			.u32 = 0 }, 0, NULL, OFFSET(rx.deferred_threads) }, {
+		"deferred_overlap_bits", plc_setting_u32, "Deferred demod overlap [bits]", {
+			.u32 = DEFERRED_OVERLAP_BITS_DEFAULT }, 0, NULL, OFFSET(rx.deferred_overlap_bits) }, {
+		"deferred_verify", plc_setting_bool, "Deferred demod serial check", {
+			.u32 = 0 }, 0, NULL, OFFSET(rx.deferred_verify) }, {
+		"rx_replay_filename", plc_setting_string, "RX replay capture file", {
+			.s = NULL }, 0, NULL, OFFSET(rx.replay_filename) }, {
+		"rx_replay_paced", plc_setting_bool, "RX replay paced", {
+			.u32 = 1 }, 0, NULL, OFFSET(rx.replay_paced) }, {
+		"rx_alsa_device", plc_setting_string, "RX ALSA PCM (empty=default)", {
+			.s = NULL }, 0, NULL, OFFSET(rx.alsa.device) }, {
+		"rx_alsa_mmap", plc_setting_bool, "RX ALSA mmap access", {
+			.u32 = 0 }, 0, NULL, OFFSET(rx.alsa.mmap) }, {
+		"rx_alsa_period_frames", plc_setting_u32, "RX ALSA period [frames] (0=buffer)", {
+			.u32 = 0 }, 0, NULL, OFFSET(rx.alsa.period_frames) }, {
+		"rx_alsa_periods", plc_setting_u32, "RX ALSA periods (0=default)", {
+			.u32 = 0 }, 0, NULL, OFFSET(rx.alsa.periods) }, {
 		"data_offset", plc_setting_u16, "Data offset", {
 			.u16 = 500 }, 0, NULL, OFFSET(rx.data_offset) }, {
 		"data_hi_threshold_detection", plc_setting_u16, "Data HI Threshold detection", {
@@ -249,32 +328,50 @@ static const struct plc_setting_definition app_accepted_settings[] = {
 		"communication_timeout_ms", plc_setting_u32, "Communication Timeout [ms]", {
 			.u32 = 0 }, 0, NULL, OFFSET(communication_timeout_ms) }, {
 		"communication_interval_ms", plc_setting_u32, "Communication Interval [ms]", {
-			.u32 = 0 }, 0, NULL, OFFSET(communication_interval_ms) } };
+			.u32 = 0 }, 0, NULL, OFFSET(communication_interval_ms) }, {
+		"latency_marker_ms", plc_setting_u32, "Latency marker interval [ms] (0=none)", {
+			.u32 = 0 }, 0, NULL, OFFSET(latency_marker_ms) }, {
+		"metrics_file", plc_setting_string, "Metrics file (.prom or .json)", {
+			.s = NULL }, 0, NULL, OFFSET(metrics_file) }, {
+		"metrics_socket", plc_setting_string, "Metrics UNIX socket", {
+			.s = NULL }, 0, NULL, OFFSET(metrics_socket) }, {
+		"log_ring_kb", plc_setting_u32, "Logger ring per thread [KB] (0=synchronous)", {
+			.u32 = LOG_RING_KB_DEFAULT }, 0, NULL, OFFSET(log_ring_kb) } };
 
 #undef OFFSET
 
+int settings_find_app_setting(const char *identifier)
+{
+	const struct plc_setting_definition *setting_definition = plc_setting_find_definition(
+			app_accepted_settings, ARRAY_SIZE(app_accepted_settings), identifier);
+	return (setting_definition != NULL) ? setting_definition - app_accepted_settings : -1;
+}
+
+int settings_set_app_setting(struct settings *settings, int setting_index,
+		const struct plc_setting *setting)
+{
+	if ((setting_index < 0) || (setting_index >= ARRAY_SIZE(app_accepted_settings)))
+	{
+		log_format("Unknown application setting '%s'\n", setting->identifier);
+		assert(0);
+		return -1;
+	}
+	const struct plc_setting_definition *setting_definition = &app_accepted_settings[setting_index];
+	union plc_setting_data *dst_data = (union plc_setting_data *) (((char *) settings)
+			+ setting_definition->user_data);
+	plc_setting_data_release(setting_definition->type, dst_data);
+	plc_setting_copy_convert_data(dst_data, setting_definition, setting);
+	return 0;
+}
+
 int settings_set_app_settings(struct settings *settings, uint32_t settings_count,
 		const struct plc_setting settings_src[])
 {
 	uint32_t n;
 	const struct plc_setting *setting = settings_src;
 	for (n = settings_count; n > 0; n--, setting++)
-	{
-		const struct plc_setting_definition *setting_definition = plc_setting_find_definition(
-				app_accepted_settings, ARRAY_SIZE(app_accepted_settings), setting->identifier);
-		if (setting_definition != NULL)
-		{
-			union plc_setting_data *dst_data = (union plc_setting_data *) (((char *) settings)
-					+ setting_definition->user_data);
-			plc_setting_data_release(setting_definition->type, dst_data);
-			plc_setting_copy_convert_data(dst_data, setting_definition, setting);
-		}
-		else
-		{
-			log_format("Unknown application setting '%s'\n", setting->identifier);
-			assert(0);
+		if (settings_set_app_setting(settings, settings_find_app_setting(setting->identifier),
+				setting) < 0)
 			return -1;
-		}
-	}
 	return 0;
 }
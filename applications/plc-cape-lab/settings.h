@@ -46,6 +46,8 @@ struct settings_tx
 	uint32_t tx_buffers_len;
 	enum spi_tx_mode_enum tx_mode;
 	enum afe_gain_tx_pga_enum gain_tx_pga;
+	// Only for 'plc_tx_device_alsa'
+	struct plc_alsa_settings alsa;
 };
 
 struct settings_rx
@@ -55,12 +57,29 @@ struct settings_rx
 	float sampling_rate_sps;
 	char *samples_filename;
 	char *data_filename;
-	uint32_t samples_to_file;
+	// The samples are stored in 'samples_filename' if 'samples_file' is set or 'samples_to_file'
+	//	is not 0. 'samples_to_file' 0 stores them until the capture is stopped
+	uint32_t samples_file;
+	uint64_t samples_to_file;
+	// Rotation of the samples file by size and/or time (0 to disable)
+	uint32_t file_rotate_mb;
+	uint32_t file_rotate_seconds;
+	uint32_t file_direct_io;
 	enum demod_mode_enum demod_mode;
+	// Comma-separated list of profiles whose decoders run in parallel on 'demod_mode_parallel'
+	char *extra_decoders;
+	uint32_t deferred_threads;
+	uint32_t deferred_overlap_bits;
+	uint32_t deferred_verify;
+	// Capture file replayed instead of using the capturing device (if not NULL)
+	char *replay_filename;
+	uint32_t replay_paced;
 	sample_rx_t data_offset;
 	sample_rx_t data_hi_threshold_detection;
 	enum afe_gain_rx_pga1_enum gain_rx_pga1;
 	enum afe_gain_rx_pga2_enum gain_rx_pga2;
+	// Only for 'plc_rx_device_alsa'
+	struct plc_alsa_settings alsa;
 };
 
 struct settings
@@ -75,6 +94,15 @@ struct settings
 	uint32_t communication_interval_ms;
 	char *configuration_profile;
 	enum monitor_profile_enum monitor_profile;
+	// Interval of the latency markers embedded in the TX signal (0 to disable). Only on emulation
+	uint32_t latency_marker_ms;
+	// Metrics exported to a file (JSON if '.json' extension, otherwise Prometheus text) and/or a
+	//	UNIX-domain socket. Read at startup
+	char *metrics_file;
+	char *metrics_socket;
+	// Size of the per-thread rings of the asynchronous logger (0 for synchronous logging). Read at
+	//	startup
+	uint32_t log_ring_kb;
 	struct settings_tx tx;
 	struct settings_rx rx;
 };
@@ -85,5 +113,9 @@ void settings_set_defaults(struct settings *settings);
 char *settings_get_info(struct settings *settings, struct encoder *encoder, struct decoder *decoder);
 int settings_set_app_settings(struct settings *settings, uint32_t settings_count,
 		const struct plc_setting settings_src[]);
+// Index of an application setting (-1 if unknown) to resolve its identifier only once
+int settings_find_app_setting(const char *identifier);
+int settings_set_app_setting(struct settings *settings, int setting_index,
+		const struct plc_setting *setting);
 
 #endif /* SETTINGS_H */
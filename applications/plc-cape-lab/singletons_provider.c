@@ -23,10 +23,6 @@ singletons_provider_h singletons_provider_handle = NULL;
 static struct plc_logger_api logger_api =
 { logger_log_line, logger_log_sequence, logger_log_sequence_format, logger_log_sequence_format_va };
 
-// Forward declarations
-int singletons_provider_get(singletons_provider_h handle, enum singleton_id_enum interface_id,
-		void **interface_vtbl, void **interface_handle, uint32_t *interface_version);
-
 void singletons_provider_initialize(void)
 {
 	// Set the singleton provider to all the libararies accepting it
@@ -34,12 +30,6 @@ void singletons_provider_initialize(void)
 	plc_libadc_set_singletons_provider(singletons_provider_get, singletons_provider_handle);
 }
 
-void singletons_provider_configure_plugin(plugin_set_singletons_provider_t
-		plugin_set_singletons_provider)
-{
-	plugin_set_singletons_provider(singletons_provider_get, singletons_provider_handle);
-}
-
 int singletons_provider_get(singletons_provider_h handle, enum singleton_id_enum interface_id,
 		void **interface_vtbl, void **interface_handle, uint32_t *interface_version)
 {
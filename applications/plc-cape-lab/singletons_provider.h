@@ -12,8 +12,10 @@
 #ifndef SINGLETONS_PROVIDER_H
 #define SINGLETONS_PROVIDER_H
 
+extern singletons_provider_h singletons_provider_handle;
+
 void singletons_provider_initialize(void);
-void singletons_provider_configure_plugin(plugin_set_singletons_provider_t
-		plugin_set_singletons_provider);
+int singletons_provider_get(singletons_provider_h handle, enum singleton_id_enum interface_id,
+		void **interface_vtbl, void **interface_handle, uint32_t *interface_version);
 
 #endif /* SINGLETONS_PROVIDER_H */
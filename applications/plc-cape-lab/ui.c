@@ -46,7 +46,7 @@
 
 struct ui
 {
-	struct plugin *plugin;
+	struct plc_plugin *plugin;
 	struct ui_api *api;
 	ui_api_h api_handle;
 	struct settings *settings;
@@ -98,6 +98,10 @@ static void setting_to_dialog(struct ui_dialog_item *item,
 		item->data_type = data_type_u32;
 		item->data_ptr.u32 = &setting_data->u32;
 		break;
+	case plc_setting_u64:
+		item->data_type = data_type_u64;
+		item->data_ptr.u64 = &setting_data->u64;
+		break;
 	case plc_setting_i32:
 		item->data_type = data_type_i32;
 		item->data_ptr.i32 = &setting_data->i32;
@@ -376,8 +380,10 @@ static void ui_open_dialog_settings_rx(struct ui *ui)
 				.list.items_count = rx_mode_COUNT } }, {
 			"Freq capture [sps]:", data_type_float, {
 				.f = &ui->settings->rx.sampling_rate_sps } }, {
-			"Samples to file:", data_type_u32, {
-				.u32 = &ui->settings->rx.samples_to_file } }, {
+			"Samples file:", data_type_u32, {
+				.u32 = &ui->settings->rx.samples_file } }, {
+			"Samples to file (0=until stopped):", data_type_u64, {
+				.u64 = &ui->settings->rx.samples_to_file } }, {
 			"Demod mode:", data_type_list, {
 				.list.index = &ui->settings->rx.demod_mode, .list.items = demod_mode_enum_text,
 				.list.items_count = demod_mode_COUNT } }, {
@@ -433,6 +439,7 @@ static struct ui_menu_item menu_monitoring_profiles_item_array[] = {
 		"4. TX time", '4', ui_set_monitoring_profile, monitor_profile_tx_time }, {
 		"5. RX values", '5', ui_set_monitoring_profile, monitor_profile_rx_values }, {
 		"6. RX time", '6', ui_set_monitoring_profile, monitor_profile_rx_time }, {
+		"7. Latency", '7', ui_set_monitoring_profile, monitor_profile_latency }, {
 		"(B)ack", 'b', (void*) ui_active_panel_close } };
 
 static void ui_open_menu_monitoring_profiles(struct ui *ui)
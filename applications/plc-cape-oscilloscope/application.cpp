@@ -297,6 +297,8 @@ void Application::stop(void)
 		return;
 	}
 	end_thread_recorder = 1;
+	// The recorder thread may be waiting for samples that will not come (e.g. end of a replay)
+	recorder->cancel_pop();
 	int ret = pthread_join(recorder_thread, NULL);
 	assert(ret == 0);
 	recording_started = 0;
@@ -401,7 +403,11 @@ void Application::load_configuration(const char *filename)
 	// osc_widget
 	osc_widget->set_yunit_symbol(yunit_symbol);
 	osc_widget->set_yunit_per_sample(yunit_per_sample);
-	osc_widget->set_osc_buffer(buffer_interval_ms, 1000000.0 / recorder->get_real_capturing_rate());
+	if (osc_widget->set_osc_buffer(buffer_interval_ms,
+			1000000.0 / recorder->get_real_capturing_rate()) < 0)
+		show_dialog(GTK_MESSAGE_ERROR, GTK_BUTTONS_OK, "Error",
+				"Unable to allocate an oscilloscope buffer of %u ms. The previous one is kept",
+				buffer_interval_ms);
 	set_trigger_threshold_yunit(0.1);
 	osc_widget->show_info_widget(info_panel_visible);
 	// plugin_afe
@@ -523,8 +529,12 @@ void Application::dialog_to_settings(void)
 	GObject *widget;
 	recorder->set_preferred_capturing_rate(dialog_to_settings_float("capturingRateSpsEntry"));
 	// If capturing_rate has changed the osc_buffer will be reallocated
-	osc_widget->set_osc_buffer(dialog_to_settings_float("oscBufferIntervalEntry"),
-			1000000.0 / recorder->get_real_capturing_rate());
+	float interval_ms = dialog_to_settings_float("oscBufferIntervalEntry");
+	if (osc_widget->set_osc_buffer(interval_ms,
+			1000000.0 / recorder->get_real_capturing_rate()) < 0)
+		show_dialog(GTK_MESSAGE_ERROR, GTK_BUTTONS_OK, "Error",
+				"Unable to allocate an oscilloscope buffer of %.2f ms. The previous one is kept",
+				interval_ms);
 	// Trigger mode
 	widget = gtk_builder_get_object(builder, "triggerComboBox");
 	gint index = gtk_combo_box_get_active(GTK_COMBO_BOX(widget));
@@ -771,6 +781,14 @@ void Application::on_set_drawing_mode(GtkMenuItem *menuitem, gpointer data)
 						"plc:index"));
 }
 
+void Application::on_set_fft_window(GtkMenuItem *menuitem, gpointer data)
+{
+	if (gtk_check_menu_item_get_active(GTK_CHECK_MENU_ITEM(menuitem)))
+		((Application*) (data))->osc_widget->set_fft_window(
+				(enum spectrum_window) (uint32_t) g_object_get_data(G_OBJECT(menuitem),
+						"plc:index"));
+}
+
 void Application::on_set_ybase_to_center(GSimpleAction *action, GVariant* parameter,
 		gpointer user_data)
 {
@@ -835,6 +853,10 @@ GtkWidget *Application::create_popup_menu_darea(void)
 	GtkWidget *drawing_mode_submenu = add_submenu_entries_enum("Drawing mode",
 			graph_drawing_mode_text, graph_drawing_COUNT, (GCallback) on_set_drawing_mode);
 	gtk_menu_shell_append(GTK_MENU_SHELL(shorcuts_menu_widget), drawing_mode_submenu);
+	// FFT window
+	GtkWidget *fft_window_submenu = add_submenu_entries_enum("FFT window", spectrum_window_text,
+			spectrum_window_COUNT, (GCallback) on_set_fft_window, osc_widget->get_fft_window());
+	gtk_menu_shell_append(GTK_MENU_SHELL(shorcuts_menu_widget), fft_window_submenu);
 	// Shortcuts
 	menuitem = gtk_menu_item_new_with_label("Shortcuts");
 	gtk_menu_item_set_submenu(GTK_MENU_ITEM(menuitem), shorcuts_menu_widget);
@@ -886,7 +908,7 @@ GtkWidget *Application::create_popup_menu_darea(void)
 }
 
 GtkWidget *Application::add_submenu_entries_enum(const char *submenu_label, const char *enum_text[],
-		uint32_t enum_count, GCallback activate_callback)
+		uint32_t enum_count, GCallback activate_callback, uint32_t active_index)
 {
 	GtkWidget *submenu = gtk_menu_new();
 	uint32_t n;
@@ -899,7 +921,7 @@ GtkWidget *Application::add_submenu_entries_enum(const char *submenu_label, cons
 		gtk_menu_shell_append(GTK_MENU_SHELL(submenu), menuitem);
 		gtk_widget_show(menuitem);
 		g_signal_connect(menuitem, "activate", activate_callback, this);
-		if (n == 0)
+		if (n == active_index)
 			gtk_check_menu_item_set_active(GTK_CHECK_MENU_ITEM(menuitem), TRUE);
 	}
 	GtkWidget *main_submenu = gtk_menu_item_new_with_label(submenu_label);
@@ -1047,7 +1069,8 @@ void *Application::thread_recorder(void)
 	int trigger_threshold_detected = 0;
 	while (!end_thread_recorder && !thread_not_requited)
 	{
-		recorder->pop_recorded_buffer(samples_buffer, samples_buffer_count);
+		if (recorder->pop_recorded_buffer(samples_buffer, samples_buffer_count) < 0)
+			break;
 		if (trigger_freq_based && !trigger_threshold_detected)
 		{
 			float xr = 0.0, xc = 0.0;
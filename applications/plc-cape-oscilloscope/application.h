@@ -226,6 +226,7 @@ private:
 		return TRUE;
 	}
 	static void on_set_drawing_mode(GtkMenuItem *menuitem, gpointer data);
+	static void on_set_fft_window(GtkMenuItem *menuitem, gpointer data);
 	static void on_set_ybase_to_center(GSimpleAction *action, GVariant* parameter,
 			gpointer user_data);
 	static void on_set_xybase_to_cursor(GSimpleAction *action, GVariant* parameter,
@@ -233,8 +234,9 @@ private:
 	static void on_test_item(GSimpleAction *action, GVariant* parameter, gpointer user_data);
 	static GActionEntry action_entries[];
 	GtkWidget *create_popup_menu_darea(void);
+	// The entry 'active_index' is initially checked
 	GtkWidget *add_submenu_entries_enum(const char *submenu_label, const char *enum_text[],
-			uint32_t enum_count, GCallback activate_callback);
+			uint32_t enum_count, GCallback activate_callback, uint32_t active_index = 0);
 	static void on_app_activate(GtkApplication* app, gpointer data)
 	{
 		Application *application = (class Application*) data;
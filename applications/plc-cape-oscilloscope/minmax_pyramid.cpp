@@ -0,0 +1,157 @@
+/**
+ * @file
+ *
+ * @cond COPYRIGHT_NOTES @copyright
+ *	Copyright (C) 2017 Jose Maria Ortega\n
+ *	Distributed under the GNU GPLv3. For full terms see the file LICENSE
+ * @endcond
+ */
+
+#include "minmax_pyramid.h"
+
+static void merge_samples(const sample_rx_t *sample, const sample_rx_t *sample_end,
+		sample_rx_t *min, sample_rx_t *max)
+{
+	for (; sample < sample_end; sample++)
+	{
+		if (*sample < *min)
+			*min = *sample;
+		if (*sample > *max)
+			*max = *sample;
+	}
+}
+
+static void merge_entries(const sample_rx_t *level_min, const sample_rx_t *level_max,
+		uint32_t ini, uint32_t end, sample_rx_t *min, sample_rx_t *max)
+{
+	for (; ini < end; ini++)
+	{
+		if (level_min[ini] < *min)
+			*min = level_min[ini];
+		if (level_max[ini] > *max)
+			*max = level_max[ini];
+	}
+}
+
+Minmax_pyramid::Minmax_pyramid(uint32_t samples_count)
+{
+	this->samples_count = samples_count;
+	allocated = 1;
+	uint32_t count = (samples_count + MINMAX_PYRAMID_BLOCK_SAMPLES - 1)
+			/ MINMAX_PYRAMID_BLOCK_SAMPLES;
+	for (levels_count = 0; levels_count < MINMAX_PYRAMID_LEVELS_MAX;)
+	{
+		struct level *level = &levels[levels_count++];
+		level->count = count;
+		level->min = (sample_rx_t*) calloc(count, sizeof(sample_rx_t));
+		level->max = (sample_rx_t*) calloc(count, sizeof(sample_rx_t));
+		// The levels allocated are released by the destructor
+		if ((level->min == NULL) || (level->max == NULL))
+		{
+			allocated = 0;
+			break;
+		}
+		if (count <= MINMAX_PYRAMID_FANOUT)
+			break;
+		count = (count + MINMAX_PYRAMID_FANOUT - 1) / MINMAX_PYRAMID_FANOUT;
+	}
+}
+
+Minmax_pyramid::~Minmax_pyramid()
+{
+	uint32_t n;
+	for (n = 0; n < levels_count; n++)
+	{
+		free(levels[n].max);
+		free(levels[n].min);
+	}
+}
+
+int Minmax_pyramid::is_allocated(void)
+{
+	return allocated;
+}
+
+void Minmax_pyramid::update(const sample_rx_t *samples, uint32_t first, uint32_t count)
+{
+	assert(first + count <= samples_count);
+	if (count == 0)
+		return;
+	// Entries covering the written samples (both inclusive)
+	uint32_t ini = first / MINMAX_PYRAMID_BLOCK_SAMPLES;
+	uint32_t end = (first + count - 1) / MINMAX_PYRAMID_BLOCK_SAMPLES;
+	struct level *level = &levels[0];
+	uint32_t n;
+	for (n = ini; n <= end; n++)
+	{
+		const sample_rx_t *sample = samples + n * MINMAX_PYRAMID_BLOCK_SAMPLES;
+		// The last block up to the samples written (the buffer end included)
+		const sample_rx_t *sample_end =
+				(n == end) ? samples + first + count : sample + MINMAX_PYRAMID_BLOCK_SAMPLES;
+		sample_rx_t min = *sample, max = *sample;
+		merge_samples(sample + 1, sample_end, &min, &max);
+		level->min[n] = min;
+		level->max[n] = max;
+	}
+	uint32_t level_index;
+	for (level_index = 1; level_index < levels_count; level_index++)
+	{
+		const struct level *child = level;
+		// Likewise the last entry up to the last child updated (the level end included)
+		uint32_t child_last = end;
+		level = &levels[level_index];
+		ini /= MINMAX_PYRAMID_FANOUT;
+		end /= MINMAX_PYRAMID_FANOUT;
+		for (n = ini; n <= end; n++)
+		{
+			uint32_t child_ini = n * MINMAX_PYRAMID_FANOUT;
+			uint32_t child_end = child_ini + MINMAX_PYRAMID_FANOUT;
+			if (child_end > child_last + 1)
+				child_end = child_last + 1;
+			sample_rx_t min = child->min[child_ini], max = child->max[child_ini];
+			merge_entries(child->min, child->max, child_ini + 1, child_end, &min, &max);
+			level->min[n] = min;
+			level->max[n] = max;
+		}
+	}
+}
+
+void Minmax_pyramid::get_range(const sample_rx_t *samples, uint32_t first, uint32_t count,
+		sample_rx_t *min, sample_rx_t *max)
+{
+	assert(count > 0);
+	*min = *max = samples[first];
+	// Whole blocks of the range (the end is exclusive)
+	uint32_t ini = (first + MINMAX_PYRAMID_BLOCK_SAMPLES - 1) / MINMAX_PYRAMID_BLOCK_SAMPLES;
+	uint32_t end = (first + count) / MINMAX_PYRAMID_BLOCK_SAMPLES;
+	if (ini >= end)
+	{
+		merge_samples(samples + first, samples + first + count, min, max);
+		return;
+	}
+	merge_samples(samples + first, samples + ini * MINMAX_PYRAMID_BLOCK_SAMPLES, min, max);
+	merge_samples(samples + end * MINMAX_PYRAMID_BLOCK_SAMPLES, samples + first + count, min,
+			max);
+	// At each level merge the entries not aligned to the parent ones and climb with the rest
+	uint32_t level_index;
+	for (level_index = 0;; level_index++)
+	{
+		const struct level *level = &levels[level_index];
+		if (level_index + 1 == levels_count)
+		{
+			merge_entries(level->min, level->max, ini, end, min, max);
+			break;
+		}
+		uint32_t ini_aligned = (ini + MINMAX_PYRAMID_FANOUT - 1) / MINMAX_PYRAMID_FANOUT;
+		uint32_t end_aligned = end / MINMAX_PYRAMID_FANOUT;
+		if (ini_aligned >= end_aligned)
+		{
+			merge_entries(level->min, level->max, ini, end, min, max);
+			break;
+		}
+		merge_entries(level->min, level->max, ini, ini_aligned * MINMAX_PYRAMID_FANOUT, min, max);
+		merge_entries(level->min, level->max, end_aligned * MINMAX_PYRAMID_FANOUT, end, min, max);
+		ini = ini_aligned;
+		end = end_aligned;
+	}
+}
@@ -0,0 +1,54 @@
+/**
+ * @file
+ * @brief	Min/max envelopes of a buffer of samples at several levels of detail
+ *
+ * @cond COPYRIGHT_NOTES @copyright
+ *	Copyright (C) 2017 Jose Maria Ortega\n
+ *	Distributed under the GNU GPLv3. For full terms see the file LICENSE
+ * @endcond
+ */
+
+#ifndef MINMAX_PYRAMID_H
+#define MINMAX_PYRAMID_H
+
+#include "+common/api/+base.h"
+
+#define MINMAX_PYRAMID_BLOCK_SAMPLES 16
+#define MINMAX_PYRAMID_FANOUT 4
+#define MINMAX_PYRAMID_LEVELS_MAX 16
+
+// Level 0 keeps the min and max of each block of MINMAX_PYRAMID_BLOCK_SAMPLES samples and each
+// upper level the ones of MINMAX_PYRAMID_FANOUT entries of the previous level. The levels are
+// updated as the samples are written, so the min and max of any range are got in O(log(range))
+// without scanning the samples. The buffer itself is owned by the caller
+class Minmax_pyramid
+{
+public:
+	// All the envelopes start at 0 (matching a zeroed buffer)
+	Minmax_pyramid(uint32_t samples_count);
+	~Minmax_pyramid();
+	// Returns 1 if the envelopes have been allocated. Otherwise the object can only be deleted
+	int is_allocated(void);
+	// Updates the envelopes after writing 'samples[first, first + count)'. The samples after them
+	// are not written yet: the entries covering them are completed by the next updates
+	void update(const sample_rx_t *samples, uint32_t first, uint32_t count);
+	// Gets the min and max of 'samples[first, first + count)'
+	// PRECONDITION: count > 0
+	void get_range(const sample_rx_t *samples, uint32_t first, uint32_t count, sample_rx_t *min,
+			sample_rx_t *max);
+
+private:
+	struct level
+	{
+		sample_rx_t *min;
+		sample_rx_t *max;
+		uint32_t count;
+	};
+
+	uint32_t samples_count;
+	struct level levels[MINMAX_PYRAMID_LEVELS_MAX];
+	uint32_t levels_count;
+	int allocated;
+};
+
+#endif /* MINMAX_PYRAMID_H */
@@ -29,6 +29,9 @@
 #define STATIC_GRID_DIVISIONS_DEFAULT 10
 #define GRAPH_TEXT_MARGIN 3.0
 #define GRAPH_TEXT_INTERLINE 3.0
+// Samples per pixel from which the lines and bars are plotted as the min/max envelope of each
+// column. Below it the samples are plotted one by one
+#define ENVELOPE_SAMPLES_PER_PIXEL_MIN 2.0
 
 #define OFFSET(member) offsetof(struct plot_area_configuration, member)
 
@@ -67,7 +70,13 @@ const struct plc_setting_definition Plot_area::accepted_settings[] = {
 		"font_bold", plc_setting_u32, "Font bold", {
 			NULL }, 0, NULL, OFFSET(font_bold) }, {
 		"font_size", plc_setting_float, "Font bold", {
-			NULL }, 0, NULL, OFFSET(font_size) }, };
+			NULL }, 0, NULL, OFFSET(font_size) }, {
+		"fft_window", plc_setting_u32, "FFT window", {
+			NULL }, 0, NULL, OFFSET(fft_window) }, {
+		"fft_size", plc_setting_u32, "FFT size (0 = auto)", {
+			NULL }, 0, NULL, OFFSET(fft_size) }, {
+		"fft_wisdom_file", plc_setting_string, "FFTW wisdom file", {
+			NULL }, 0, NULL, OFFSET(fft_wisdom_file) }, };
 
 #pragma GCC diagnostic pop
 
@@ -149,7 +158,7 @@ Plot_area::Plot_area()
 	// Default values
 	plot_samples = 1;
 	plot_fft = 0;
-	fft_in = fft_out = NULL;
+	spectrum = new Spectrum();
 	fft_graph = NULL;
 	fft_graph_yrange_user = fft_graph_yrange = 0.0;
 	yunit_symbol = NULL;
@@ -161,13 +170,15 @@ Plot_area::Plot_area()
 	cursor_ini_x_ratio = cursor_ini_y_ratio = cursor_end_x_ratio = cursor_end_y_ratio = 0.0;
 	graph_title = strdup("");
 	set_configuration_defaults();
-	init_buffers(DEFAULT_OSC_BUFFER_INTERVAL_MS);
+	int ret = init_buffers(DEFAULT_OSC_BUFFER_INTERVAL_MS);
+	assert(ret == 0);
 }
 
 Plot_area::~Plot_area()
 {
 	release_configuration();
 	release_buffers();
+	delete spectrum;
 	if (yunit_symbol)
 		free(yunit_symbol);
 	free(graph_title);
@@ -180,6 +191,11 @@ void Plot_area::release_configuration(void)
 		free(font_face);
 		font_face = NULL;
 	}
+	if (fft_wisdom_file)
+	{
+		free(fft_wisdom_file);
+		fft_wisdom_file = NULL;
+	}
 }
 
 void Plot_area::set_configuration_defaults(void)
@@ -198,6 +214,7 @@ void Plot_area::set_configuration_defaults(void)
 	fft_color = fft_color_default;
 	fft_cursors_color = fft_cursors_color_default;
 	grid_color = grid_color_default;
+	fft_window = spectrum_window_hann;
 }
 
 int Plot_area::begin_configuration(void)
@@ -254,6 +271,18 @@ int Plot_area::end_configuration(void)
 			static_grid_y_divisions = STATIC_GRID_DIVISIONS_DEFAULT;
 		update_static_grid_dimensions();
 	}
+	if (fft_window >= spectrum_window_COUNT)
+		fft_window = spectrum_window_hann;
+	if (fft_wisdom_file == NULL)
+		spectrum->set_wisdom_file(SPECTRUM_WISDOM_FILENAME_DEFAULT);
+	else
+		spectrum->set_wisdom_file((*fft_wisdom_file != '\0') ? fft_wisdom_file : NULL);
+	if (plot_fft)
+	{
+		release_buffers_fft();
+		init_buffers_fft();
+		recalculate_fft();
+	}
 	return 0;
 }
 
@@ -274,6 +303,7 @@ int Plot_area::push_buffer(sample_rx_t *samples, uint32_t samples_count)
 	if (samples_count > remaining_samples)
 		samples_count = remaining_samples;
 	memcpy(buffer_capture_cur, samples, samples_count * sizeof(sample_rx_t));
+	pyramid_capture->update(buffer_capture, buffer_capture_cur - buffer_capture, samples_count);
 	buffer_capture_cur += samples_count;
 	if (buffer_capture_cur == buffer_capture_end)
 	{
@@ -342,10 +372,21 @@ int Plot_area::set_osc_buffer(float interval_ms, float time_per_sample_us)
 	if ((interval_ms == buffer_capture_interval_ms)
 			&& (time_per_sample_us == this->time_per_sample_us))
 		return 0;
+	float previous_interval_ms = buffer_capture_interval_ms;
+	float previous_time_per_sample_us = this->time_per_sample_us;
+	delete pyramid_B;
+	delete pyramid_A;
 	free(buffer_B);
 	free(buffer_A);
 	this->time_per_sample_us = time_per_sample_us;
-	init_buffers(interval_ms);
+	if (init_buffers(interval_ms) < 0)
+	{
+		// Back to the previous buffers, whose memory has just been released
+		this->time_per_sample_us = previous_time_per_sample_us;
+		int ret = init_buffers(previous_interval_ms);
+		assert(ret == 0);
+		return -1;
+	}
 	return 1;
 }
 
@@ -478,6 +519,22 @@ float Plot_area::get_fft_yrange_user(void)
 	return fft_graph_yrange_user;
 }
 
+enum spectrum_window Plot_area::get_fft_window(void)
+{
+	return fft_window;
+}
+
+void Plot_area::set_fft_window(enum spectrum_window window)
+{
+	fft_window = window;
+	if (plot_fft)
+	{
+		release_buffers_fft();
+		init_buffers_fft();
+		recalculate_fft();
+	}
+}
+
 const char *Plot_area::get_graph_title(void)
 {
 	return graph_title;
@@ -859,33 +916,77 @@ void Plot_area::plot_buffer_viewer(cairo_t *cr, int width, int height)
 	graph_plot.sample_mark_size = sample_mark_size;
 	graph_plot.x = 0.0;
 	plot_sample_t plot_sample = get_plot_sample(graph_drawing_mode);
-	uint32_t n = 0, n_next = 0;
-	float n_real = 0.0;
-	float delta_x, delta_n;
-	int decimate = (graph_drawing_mode == graph_drawing_lines_fast_decimation);
-	if (decimate && (buffer_plot_count >= (uint32_t) width))
+	// The decimation keeps the peaks of the samples merged in each pixel column
+	float samples_per_pixel = (float) buffer_plot_count / width;
+	int envelope;
+	switch (graph_drawing_mode)
 	{
-		delta_n = (float) buffer_plot_count / width;
-		delta_x = 1.0;
+	case graph_drawing_lines_fast_decimation:
+		envelope = (samples_per_pixel >= 1.0);
+		break;
+	case graph_drawing_lines:
+	case graph_drawing_bars:
+		envelope = (samples_per_pixel >= ENVELOPE_SAMPLES_PER_PIXEL_MIN);
+		break;
+	default:
+		envelope = 0;
+		break;
 	}
-	else
+	if (envelope)
 	{
-		delta_n = 1.0;
-		delta_x = (float) width / buffer_plot_count;
+		plot_buffer_viewer_envelope(cr, width, pixels_per_sample, graph_plot.y_base);
+		cairo_set_matrix(cr, &matrix);
+		return;
 	}
-	for (; n < buffer_plot_count;)
+	float delta_x = (float) width / buffer_plot_count;
+	uint32_t n;
+	for (n = 0; n < buffer_plot_count; n++)
 	{
-		n_real += delta_n;
-		n_next = (uint32_t) round(n_real);
 		graph_plot.y = -pixels_per_sample * (int16_t) (buffer_viewer_ini[n] - SAMPLES_ZERO_REF);
 		plot_sample(&graph_plot);
 		graph_plot.x += delta_x;
-		n = n_next;
 	}
 	cairo_stroke(cr);
 	cairo_set_matrix(cr, &matrix);
 }
 
+// Plots a vertical segment per pixel column from the min to the max of its samples. The bars also
+// cover the base. Each column takes O(log(samples per pixel)) through the pyramid
+void Plot_area::plot_buffer_viewer_envelope(cairo_t *cr, int width, float pixels_per_sample,
+		float y_base)
+{
+	uint32_t viewer_first = buffer_viewer_ini - buffer_plot;
+	int bars = (graph_drawing_mode == graph_drawing_bars);
+	float y_last = 0.0;
+	int x;
+	for (x = 0; x < width; x++)
+	{
+		uint32_t n_ini = (uint64_t) x * buffer_plot_count / width;
+		uint32_t n_end = (uint64_t) (x + 1) * buffer_plot_count / width;
+		sample_rx_t min, max;
+		pyramid_plot->get_range(buffer_plot, viewer_first + n_ini, n_end - n_ini, &min, &max);
+		float y_min = -pixels_per_sample * (int16_t) (min - SAMPLES_ZERO_REF);
+		float y_max = -pixels_per_sample * (int16_t) (max - SAMPLES_ZERO_REF);
+		if (bars)
+		{
+			cairo_move_to(cr, x, (y_base > y_min) ? y_base : y_min);
+			cairo_line_to(cr, x, (y_base < y_max) ? y_base : y_max);
+		}
+		else
+		{
+			// Start by the end closer to the previous column to keep the joining segments short
+			int max_first = (fabs(y_max - y_last) < fabs(y_min - y_last));
+			if (x == 0)
+				cairo_move_to(cr, x, max_first ? y_max : y_min);
+			else
+				cairo_line_to(cr, x, max_first ? y_max : y_min);
+			cairo_line_to(cr, x, max_first ? y_min : y_max);
+			y_last = max_first ? y_min : y_max;
+		}
+	}
+	cairo_stroke(cr);
+}
+
 void Plot_area::plot_buffer_viewer_fft(cairo_t *cr, int width, int height)
 {
 	cairo_set_source_rgb(cr, fft_color.red, fft_color.green, fft_color.blue);
@@ -896,7 +997,7 @@ void Plot_area::plot_buffer_viewer_fft(cairo_t *cr, int width, int height)
 	uint32_t graph_count = fft_viewer_width;
 	if (graph_ini + graph_count > fft_graph_count)
 		graph_count = fft_graph_count - graph_ini;
-	plot_double(cr, fft_graph + graph_ini, fft_viewer_width, 0, height, index_to_pos_x,
+	plot_double(cr, fft_graph + graph_ini, graph_count, 0, height, index_to_pos_x,
 			value_to_pos_y, graph_drawing_mode, sample_mark_size);
 }
 
@@ -968,8 +1069,7 @@ void Plot_area::display_viewer_info(cairo_t *cr, const GtkAllocation &area_rect)
 				darea_fft_viewer_index_to_frequency(fft_viewer_left + fft_viewer_width), "Hz");
 		*text_cur++ = ';';
 		*text_cur++ = ' ';
-		float fft_y_range_normalized = fft_graph_yrange / fft_graph_count;
-		text_cur += sprint_custom_float(text_cur, fft_y_range_normalized, NULL, 2);
+		text_cur += sprint_custom_float(text_cur, fft_graph_yrange, NULL, 2);
 		*text_cur++ = ']';
 		*text_cur = '\0';
 		uint32_t chars = text_cur - text;
@@ -983,7 +1083,7 @@ void Plot_area::display_viewer_info(cairo_t *cr, const GtkAllocation &area_rect)
 			float y_divisions = yunit_range / grid_yunit;
 			sprint_custom_float_pair_fft(text_cur, sizeof(text) - (text_cur - text),
 					darea_fft_viewer_index_to_frequency(fft_viewer_width) / x_divisions,
-					fft_y_range_normalized / y_divisions);
+					fft_graph_yrange / y_divisions);
 			y_baseline = print_viewer_info_text(cr, area_rect.width, y_baseline, fft_color, text);
 		}
 	}
@@ -1125,7 +1225,7 @@ int Plot_area::sprint_cursor_pair(char *text, uint16_t text_size, float x_pos_ra
 		return sprint_custom_float_pair_fft(text, text_size,
 				darea_fft_viewer_index_to_frequency(
 						fft_viewer_left + x_pos_ratio * fft_viewer_width),
-				(1.0 - y_pos_ratio) * fft_graph_yrange / fft_graph_count);
+				(1.0 - y_pos_ratio) * fft_graph_yrange);
 	}
 	assert(0);
 	return 0;
@@ -1147,39 +1247,20 @@ void Plot_area::coordinates_to_measures(float x_ratio, float y_ratio, float *tim
 
 void Plot_area::recalculate_fft(void)
 {
-	uint32_t n;
-	for (n = 0; n < buffer_plot_count; n++)
-	{
-		fft_in[n][0] = buffer_viewer_ini[n];
-		fft_in[n][1] = 0;
-	}
-	fftw_execute(fft_plan);
-	// Ignore the continuous component (freq = 0)
-	fft_graph[0] = 0.0;
+	spectrum->calculate(buffer_viewer_ini, fft_graph);
 	fft_graph_max = 0.0;
-	for (n = 1; n < buffer_plot_count; n++)
-	{
-		fft_graph[n] = sqrt(fft_out[n][0] * fft_out[n][0] + fft_out[n][1] * fft_out[n][1]);
+	uint32_t n;
+	for (n = 0; n < fft_graph_count; n++)
 		if (fft_graph[n] > fft_graph_max)
 			fft_graph_max = fft_graph[n];
-	}
 	update_fft_yrange_user();
 	buffer_capture_counter_fft = buffer_capture_counter;
 }
 
 void Plot_area::get_range_viewer(sample_rx_t *min, sample_rx_t *max)
 {
-	sample_rx_t *buffer = buffer_viewer_ini;
-	uint32_t count = buffer_plot_count;
-	*min = (sample_rx_t) -1;
-	*max = 0;
-	for (; count > 0; count--, buffer++)
-	{
-		if (*buffer < *min)
-			*min = *buffer;
-		if (*buffer > *max)
-			*max = *buffer;
-	}
+	pyramid_plot->get_range(buffer_plot, buffer_viewer_ini - buffer_plot, buffer_plot_count, min,
+			max);
 }
 
 void Plot_area::set_viewer_interval_samples(float viewer_width)
@@ -1215,7 +1296,8 @@ void Plot_area::set_viewer_interval_samples(float viewer_width)
 }
 
 // PRECONDITION: 'buffer_A' and 'buffer_B' unallocated
-void Plot_area::init_buffers(float interval_ms)
+// Returns -1 if the buffers cannot be allocated, leaving them unallocated
+int Plot_area::init_buffers(float interval_ms)
 {
 	valid_darea_data = 0;
 	buffer_capture_interval_ms = interval_ms;
@@ -1228,6 +1310,14 @@ void Plot_area::init_buffers(float interval_ms)
 	buffer_plot_count = round(buffer_viewer_width);
 	buffer_A = (sample_rx_t*) calloc(1, buffers_count * sizeof(sample_rx_t));
 	buffer_B = (sample_rx_t*) malloc(buffers_count * sizeof(sample_rx_t));
+	pyramid_A = new Minmax_pyramid(buffers_count);
+	pyramid_B = new Minmax_pyramid(buffers_count);
+	if ((buffer_A == NULL) || (buffer_B == NULL) || !pyramid_A->is_allocated()
+			|| !pyramid_B->is_allocated())
+	{
+		release_buffers();
+		return -1;
+	}
 	set_buffer_addresses(buffer_A, buffer_B);
 	if (plot_fft)
 	{
@@ -1236,24 +1326,26 @@ void Plot_area::init_buffers(float interval_ms)
 	}
 	if (static_grid)
 		update_static_grid_dimensions();
+	return 0;
 }
 
 void Plot_area::init_buffers_fft(void)
 {
-	assert((fft_in == NULL) && (fft_out == NULL) && (fft_graph == NULL));
-	fft_graph_count = buffer_plot_count;
-	fft_in = (fftw_complex*) fftw_malloc(sizeof(fftw_complex) * fft_graph_count);
-	fft_out = (fftw_complex*) fftw_malloc(sizeof(fftw_complex) * fft_graph_count);
-	fft_plan = fftw_plan_dft_1d(fft_graph_count, fft_in, fft_out, FFTW_FORWARD,
-	FFTW_ESTIMATE);
+	assert(fft_graph == NULL);
+	// The plans are cached by the spectrum, so only the first use of each size is expensive
+	fft_graph_count = spectrum->configure(buffer_plot_count, fft_size, fft_window);
 	fft_graph = (float*) malloc(fft_graph_count * sizeof(float));
 	buffer_capture_counter_fft = buffer_capture_counter - 1;
 	fft_viewer_left = 0.0;
-	fft_viewer_width = fft_graph_count / 2.0 - fft_viewer_left;
+	fft_viewer_width = fft_graph_count - 1 - fft_viewer_left;
 }
 
 void Plot_area::release_buffers(void)
 {
+	delete pyramid_B;
+	pyramid_B = NULL;
+	delete pyramid_A;
+	pyramid_A = NULL;
 	free(buffer_B);
 	buffer_B = NULL;
 	free(buffer_A);
@@ -1266,17 +1358,14 @@ void Plot_area::release_buffers_fft(void)
 {
 	free(fft_graph);
 	fft_graph = NULL;
-	fftw_destroy_plan(fft_plan);
-	fftw_free(fft_in);
-	fft_in = NULL;
-	fftw_free(fft_out);
-	fft_out = NULL;
 }
 
 void Plot_area::set_buffer_addresses(sample_rx_t *new_buffer_plot, sample_rx_t *new_buffer_capture)
 {
 	buffer_capture = new_buffer_capture;
 	buffer_plot = new_buffer_plot;
+	pyramid_capture = (new_buffer_capture == buffer_A) ? pyramid_A : pyramid_B;
+	pyramid_plot = (new_buffer_plot == buffer_A) ? pyramid_A : pyramid_B;
 	buffer_capture_cur = buffer_capture;
 	buffer_capture_end = buffer_capture + buffers_count;
 	buffer_viewer_ini = buffer_plot + (uint32_t) round(buffer_viewer_left);
@@ -1313,14 +1402,12 @@ float Plot_area::darea_y_ratio_to_yunit(float y_ratio)
 
 void Plot_area::update_fft_yrange_user(void)
 {
-	fft_graph_yrange =
-			(fft_graph_yrange_user == 0.0) ?
-					fft_graph_max : fft_graph_yrange_user * fft_graph_count;
+	fft_graph_yrange = (fft_graph_yrange_user == 0.0) ? fft_graph_max : fft_graph_yrange_user;
 }
 
 float Plot_area::darea_fft_viewer_index_to_frequency(float viewer_index)
 {
-	return 1000000.0 / time_per_sample_us / fft_graph_count * viewer_index;
+	return 1000000.0 / time_per_sample_us / spectrum->get_fft_size() * viewer_index;
 }
 
 void Plot_area::update_static_grid_dimensions(void)
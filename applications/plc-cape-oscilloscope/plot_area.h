@@ -12,8 +12,9 @@
 #define PLOT_AREA_H
 
 #include <gtk/gtk.h>
-#include <fftw3.h>
 #include "configuration_interface.h"
+#include "minmax_pyramid.h"
+#include "spectrum.h"
 
 extern const char *graph_drawing_mode_text[];
 enum graph_drawing_mode
@@ -53,6 +54,11 @@ struct plot_area_configuration
 	GdkRGBA fft_color;
 	GdkRGBA fft_cursors_color;
 	GdkRGBA grid_color;
+	enum spectrum_window fft_window;
+	// 0 for the next power of 2 of the viewer samples
+	uint32_t fft_size;
+	// NULL for the default one and "" to not persist the wisdom
+	char *fft_wisdom_file;
 };
 
 class Plot_area: public Configuration_interface, private plot_area_configuration
@@ -72,6 +78,8 @@ public:
 	int save_samples(const char *filename, int in_digital_units);
 	int save_png(const char *filename, int width, int height);
 	int save_svg(const char *filename, int width, int height);
+	// Returns 1 if the buffers have been reallocated, 0 if unchanged or -1 if they cannot be
+	// allocated (keeping the previous ones)
 	int set_osc_buffer(float interval_ms, float us_per_sample);
 	float get_osc_buffer_interval(void);
 	void set_yunit_symbol(const char* symbol);
@@ -92,6 +100,8 @@ public:
 	int get_plot_fft(void);
 	void set_plot_fft(int enable);
 	void set_fft_yrange_user(float yrange);
+	enum spectrum_window get_fft_window(void);
+	void set_fft_window(enum spectrum_window window);
 	float get_fft_yrange_user(void);
 	const char *get_graph_title(void);
 	void set_graph_title(const char *title);
@@ -141,6 +151,8 @@ private:
 
 	void plot_grid(cairo_t *cr, int width, int height);
 	void plot_buffer_viewer(cairo_t *cr, int width, int height);
+	void plot_buffer_viewer_envelope(cairo_t *cr, int width, float pixels_per_sample,
+			float y_base);
 	void plot_buffer_viewer_fft(cairo_t *cr, int width, int height);
 	static void plot_double(cairo_t *cr, float * graph, uint32_t graph_count, int ref_x, int ref_y,
 			float index_to_pos_x, float value_to_pos_y, enum graph_drawing_mode graph_drawing_mode,
@@ -157,7 +169,7 @@ private:
 	void recalculate_fft(void);
 	void get_range_viewer(sample_rx_t *min, sample_rx_t *max);
 	void set_viewer_interval_samples(float viewer_width);
-	void init_buffers(float interval_ms);
+	int init_buffers(float interval_ms);
 	void init_buffers_fft(void);
 	void release_buffers(void);
 	void release_buffers_fft(void);
@@ -174,6 +186,9 @@ private:
 	int valid_darea_data;
 	uint32_t buffers_count;
 	sample_rx_t *buffer_A, *buffer_B;
+	// Envelopes of each buffer, so the plotting cost depends on the width and not on the samples
+	Minmax_pyramid *pyramid_A, *pyramid_B;
+	Minmax_pyramid *pyramid_capture, *pyramid_plot;
 	sample_rx_t *buffer_capture, *buffer_capture_cur, *buffer_capture_end;
 	uint32_t buffer_capture_counter;
 	float buffer_capture_interval_ms;
@@ -183,8 +198,7 @@ private:
 	uint32_t buffer_plot_count;
 	int plot_samples;
 	int plot_fft;
-	fftw_complex *fft_in, *fft_out;
-	fftw_plan fft_plan;
+	Spectrum *spectrum;
 	uint32_t fft_graph_count;
 	float *fft_graph;
 	float fft_graph_max;
@@ -255,10 +255,12 @@ float Plot_widget::get_osc_buffer_interval(void)
 	return area->get_osc_buffer_interval();
 }
 
-void Plot_widget::set_osc_buffer(float interval_ms, float us_per_sample)
+int Plot_widget::set_osc_buffer(float interval_ms, float us_per_sample)
 {
-	if (area->set_osc_buffer(interval_ms, us_per_sample))
+	int ret = area->set_osc_buffer(interval_ms, us_per_sample);
+	if (ret != 0)
 		refresh();
+	return ret;
 }
 
 void Plot_widget::auto_scale_x(void)
@@ -346,6 +348,17 @@ void Plot_widget::set_graph_drawing_mode(enum graph_drawing_mode mode)
 	refresh();
 }
 
+enum spectrum_window Plot_widget::get_fft_window(void)
+{
+	return area->get_fft_window();
+}
+
+void Plot_widget::set_fft_window(enum spectrum_window window)
+{
+	area->set_fft_window(window);
+	refresh();
+}
+
 void Plot_widget::set_ybase_to_center(void)
 {
 	area->set_yunit_base(area->get_yunit_offset());
@@ -11,7 +11,7 @@
 #ifndef PLOT_WIDGET_H
 #define PLOT_WIDGET_H
 
-#include "plot_area.h"		// graph_drawing_mode
+#include "plot_area.h"		// graph_drawing_mode, spectrum_window
 #include "configuration_interface.h"
 
 struct plot_widget_configuration
@@ -72,7 +72,7 @@ public:
 	int save_png(const char *filename);
 	int save_svg(const char *filename);
 	float get_osc_buffer_interval(void);
-	void set_osc_buffer(float interval_ms, float us_per_sample);
+	int set_osc_buffer(float interval_ms, float us_per_sample);
 	void auto_scale_x(void);
 	void auto_scale_y(void);
 	void auto_offset_y(void);
@@ -86,6 +86,8 @@ public:
 	void set_plot_fft(int enable);
 	enum graph_drawing_mode get_graph_drawing_mode(void);
 	void set_graph_drawing_mode(enum graph_drawing_mode mode);
+	enum spectrum_window get_fft_window(void);
+	void set_fft_window(enum spectrum_window window);
 	void set_ybase_to_center(void);
 	void set_xybase_to_cursor(void);
 
@@ -26,7 +26,10 @@ public:
 	virtual void stop_recording(void) = 0;
 	virtual void pause(void) = 0;
 	virtual void resume(void) = 0;
-	virtual void pop_recorded_buffer(sample_rx_t *samples, uint32_t samples_count) = 0;
+	// Blocks until the samples are available. Returns -1 if cancelled by 'cancel_pop'
+	virtual int pop_recorded_buffer(sample_rx_t *samples, uint32_t samples_count) = 0;
+	// Called from any thread to unblock the consumer until the recording is stopped
+	virtual void cancel_pop(void) = 0;
 	virtual void get_statistics(char *text, size_t text_size) = 0;
 };
 
@@ -7,41 +7,123 @@
  * @endcond
  */
 
+#include <errno.h>
 #include <gtk/gtk.h>		// g_warning
-#include <unistd.h>			// usleep
 #include <sys/utsname.h>	// uname
 #include "+common/api/+base.h"
 #include "+common/api/bbb.h"
 #include "recorder_plc.h"
 #include "libraries/libplc-adc/api/adc.h"
+#include "libraries/libplc-tools/api/metrics.h"
+#include "spsc_ring.h"
 #include "tools.h"
 
 //#define BUFFER_SAMPLES 2048
 #define BUFFER_SAMPLES 1024
+// Enough to absorb the viewer pauses (refresh, trigger contention) at the max capturing rate
+#define RING_SAMPLES_DEFAULT 65536
 // #define SAMPLES_OFFSET ((1 << 12) / 2)
 #define SAMPLES_OFFSET 0
+#define METRICS_EXPORT_INTERVAL_MS 1000
+#define NSECS_PER_USEC 1000
+
+// Upper bounds of the buckets of the buffer cycle histogram [us]
+static const int64_t metrics_cycle_bounds_us[] = {
+		500, 1000, 2000, 5000, 10000, 20000, 50000, 100000, 200000, 500000 };
 
 Recorder_plc::Recorder_plc()
 {
 	plc_adc = NULL;
 	rx_device = plc_rx_device_adc_bbb;
-	samples_adc_len = BUFFER_SAMPLES;
-	samples_adc = (sample_rx_t*) malloc(sizeof(sample_rx_t) * samples_adc_len);
-	samples_adc_cur = samples_adc;
-	samples_adc_end = samples_adc + samples_adc_len;
-	samples_adc_pop = samples_adc;
+	capturing_rx_device = plc_rx_device_adc_bbb;
+	replay_filename = NULL;
+	metrics_file = NULL;
+	metrics_socket = NULL;
+	ring = NULL;
+	pthread_mutex_init(&ring_mutex, NULL);
+	pop_cancelled = 0;
 	paused = 0;
-	samples_adc_stored = 0;
-	overflows_detected = 0;
 	capturing_rate_sps = 0;
-	samples_adc_capturing_time_per_quarter_buffer_us = 0;
 	plc_rx_analysis = NULL;
 	rx_statistics_mode = plc_rx_statistics_none;
+	ring_samples = RING_SAMPLES_DEFAULT;
+	plc_metrics = NULL;
+	metric_rx_buffers = NULL;
+	metric_rx_buffers_lost = NULL;
+	metric_rx_buffer_cycle_us = NULL;
+	metric_ring_overflows = NULL;
+	rx_last_timestamp_ns = 0;
+	rx_next_sequence = 0;
 }
 
 Recorder_plc::~Recorder_plc()
 {
-	free(samples_adc);
+	assert(ring == NULL);
+	pthread_mutex_destroy(&ring_mutex);
+}
+
+void Recorder_plc::create_adc(void)
+{
+	assert(plc_adc == NULL);
+	if (replay_filename)
+	{
+		plc_adc = plc_adc_create_replay(replay_filename, 1);
+		if (plc_adc)
+		{
+			rx_device = plc_rx_device_replay;
+			// The sampling rate stored in the file (if any) prevails
+			float replay_rate_sps = plc_adc_get_sampling_frequency(plc_adc);
+			if (replay_rate_sps > 0.0f)
+				capturing_rate_sps = replay_rate_sps;
+		}
+		else
+		{
+			g_warning("RECORDER: Unable to load the replay file");
+		}
+	}
+	if (plc_adc == NULL)
+	{
+		rx_device = capturing_rx_device;
+		plc_adc = plc_adc_create(rx_device);
+		if (plc_adc == NULL)
+		{
+			perror("Error: ADC object cannot be created");
+			exit(EXIT_FAILURE);
+		}
+	}
+	plc_adc_set_rx_buffer_completed_callback(plc_adc, rx_buffer_completed_callback, this);
+}
+
+void Recorder_plc::create_metrics(void)
+{
+	assert(plc_metrics == NULL);
+	plc_metrics = plc_metrics_create("plc_oscilloscope_");
+	metric_rx_buffers = plc_metrics_add_counter(plc_metrics, "rx_buffers_total",
+			"RX buffers captured");
+	metric_rx_buffers_lost = plc_metrics_add_counter(plc_metrics, "rx_buffers_lost_total",
+			"RX buffers lost by the device from the gaps in their sequence numbers");
+	metric_rx_buffer_cycle_us = plc_metrics_add_histogram(plc_metrics, "rx_buffer_cycle_us",
+			"Time between consecutive RX buffers [us]", metrics_cycle_bounds_us,
+			ARRAY_SIZE(metrics_cycle_bounds_us));
+	metric_ring_overflows = plc_metrics_add_counter(plc_metrics, "ring_overflows_total",
+			"RX buffers dropped because the viewer didn't keep the pace");
+}
+
+// The export settings may change on each configuration
+void Recorder_plc::restart_metrics_export(void)
+{
+	plc_metrics_stop_export(plc_metrics);
+	const char *file_path = (metrics_file && (*metrics_file != '\0')) ? metrics_file : NULL;
+	const char *socket_path =
+			(metrics_socket && (*metrics_socket != '\0')) ? metrics_socket : NULL;
+	if ((file_path == NULL) && (socket_path == NULL))
+		return;
+	const char *extension = file_path ? strrchr(file_path, '.') : NULL;
+	enum plc_metrics_format_enum format = (extension && (strcmp(extension, ".json") == 0)) ?
+			plc_metrics_format_json : plc_metrics_format_prometheus;
+	if (plc_metrics_start_export(plc_metrics, format, file_path, socket_path,
+			METRICS_EXPORT_INTERVAL_MS) < 0)
+		g_warning("RECORDER: Unable to export the metrics: %s", strerror(errno));
 }
 
 void Recorder_plc::initialize(void)
@@ -50,14 +132,10 @@ void Recorder_plc::initialize(void)
 	struct utsname utsname;
 	int ret = uname(&utsname);
 	assert(ret == 0);
-	rx_device = (strcmp(utsname.machine, "i686") == 0) ? plc_rx_device_alsa : plc_rx_device_adc_bbb;
-	plc_adc = plc_adc_create(rx_device);
-	if (plc_adc == NULL)
-	{
-		perror("Error: ADC object cannot be created");
-		exit(EXIT_FAILURE);
-	}
-	plc_adc_set_rx_buffer_completed_callback(plc_adc, rx_buffer_completed_callback, this);
+	capturing_rx_device =
+			(strcmp(utsname.machine, "i686") == 0) ? plc_rx_device_alsa : plc_rx_device_adc_bbb;
+	create_adc();
+	create_metrics();
 	plc_rx_analysis = plc_rx_analysis_create();
 	set_configuration_defaults();
 }
@@ -67,20 +145,41 @@ void Recorder_plc::terminate(void)
 	assert(plc_rx_analysis);
 	plc_rx_analysis_release(plc_rx_analysis);
 	plc_rx_analysis = NULL;
+	assert(plc_metrics);
+	plc_metrics_release(plc_metrics);
+	plc_metrics = NULL;
 	assert(plc_adc);
 	plc_adc_release(plc_adc);
 	plc_adc = NULL;
+	release_configuration();
 	puts("ADC stopped");
 }
 
 void Recorder_plc::release_configuration(void)
 {
+	if (replay_filename)
+	{
+		free(replay_filename);
+		replay_filename = NULL;
+	}
+	if (metrics_file)
+	{
+		free(metrics_file);
+		metrics_file = NULL;
+	}
+	if (metrics_socket)
+	{
+		free(metrics_socket);
+		metrics_socket = NULL;
+	}
 }
 
 void Recorder_plc::set_configuration_defaults(void)
 {
 	memset((recorder_plc_configuration*) this, 0, sizeof(struct recorder_plc_configuration));
-	capturing_rate_sps = (rx_device == plc_rx_device_alsa) ? 48000.0 : ADC_MAX_CAPTURE_RATE_SPS;
+	capturing_rate_sps =
+			(capturing_rx_device == plc_rx_device_alsa) ? 48000.0 : ADC_MAX_CAPTURE_RATE_SPS;
+	ring_samples = RING_SAMPLES_DEFAULT;
 	plc_rx_analysis_set_statistics_mode(plc_rx_analysis, rx_statistics_mode);
 }
 
@@ -97,6 +196,28 @@ int Recorder_plc::set_configuration_setting(const char *identifier, const char *
 	{
 		capturing_rate_sps = atof(data);
 	}
+	else if (strcmp(identifier, "ring_samples") == 0)
+	{
+		ring_samples = atoi(data);
+	}
+	else if (strcmp(identifier, "replay_filename") == 0)
+	{
+		if (replay_filename)
+			free(replay_filename);
+		replay_filename = (*data != '\0') ? strdup(data) : NULL;
+	}
+	else if (strcmp(identifier, "metrics_file") == 0)
+	{
+		if (metrics_file)
+			free(metrics_file);
+		metrics_file = (*data != '\0') ? strdup(data) : NULL;
+	}
+	else if (strcmp(identifier, "metrics_socket") == 0)
+	{
+		if (metrics_socket)
+			free(metrics_socket);
+		metrics_socket = (*data != '\0') ? strdup(data) : NULL;
+	}
 	else
 	{
 		return -1;
@@ -106,6 +227,21 @@ int Recorder_plc::set_configuration_setting(const char *identifier, const char *
 
 int Recorder_plc::end_configuration(void)
 {
+	// Switch between the replay and the capturing device if required
+	if (replay_filename || (rx_device == plc_rx_device_replay))
+	{
+		if (ring == NULL)
+		{
+			plc_adc_release(plc_adc);
+			plc_adc = NULL;
+			create_adc();
+		}
+		else
+		{
+			g_warning("RECORDER: The device can't be changed while recording");
+		}
+	}
+	restart_metrics_export();
 	return 0;
 }
 
@@ -122,12 +258,18 @@ float Recorder_plc::get_real_capturing_rate(void)
 
 void Recorder_plc::start_recording(void)
 {
-	assert(plc_adc);
-	samples_adc_pop = samples_adc;
-	samples_adc_stored = 0;
-	overflows_detected = 0;
-	samples_adc_capturing_time_per_quarter_buffer_us = (uint32_t) ((250000.0 / capturing_rate_sps)
-			* samples_adc_len + .5);
+	assert(plc_adc && (ring == NULL));
+	// At least a couple of ADC buffers
+	Spsc_ring *ring_new = new Spsc_ring((ring_samples > 2 * BUFFER_SAMPLES) ? ring_samples
+			: 2 * BUFFER_SAMPLES);
+	pthread_mutex_lock(&ring_mutex);
+	// Cancelled before starting
+	if (pop_cancelled)
+		ring_new->abort();
+	ring = ring_new;
+	pthread_mutex_unlock(&ring_mutex);
+	// The cycles are measured within a recording
+	rx_last_timestamp_ns = 0;
 	plc_adc_start_capture(plc_adc, BUFFER_SAMPLES, 1, capturing_rate_sps);
 	plc_rx_analysis_reset(plc_rx_analysis);
 }
@@ -137,12 +279,18 @@ void Recorder_plc::stop_recording(void)
 	assert(plc_adc);
 	plc_adc_stop_capture(plc_adc);
 	// TODO: Improve tracing
+	uint32_t overflows_detected = ring->get_overflows();
 	if (overflows_detected)
 	{
 		char text[100];
 		sprintf(text, "RECORDER: Overflows detected: %u", overflows_detected);
 		g_warning(text);
 	}
+	pthread_mutex_lock(&ring_mutex);
+	delete ring;
+	ring = NULL;
+	pop_cancelled = 0;
+	pthread_mutex_unlock(&ring_mutex);
 }
 
 void Recorder_plc::pause(void)
@@ -150,38 +298,30 @@ void Recorder_plc::pause(void)
 	paused = 1;
 }
 
+// PRECONDITION: called from the consumer thread (the one calling 'pop_recorded_buffer')
 void Recorder_plc::resume(void)
 {
+	// Start with fresh samples. The producer doesn't push while paused
+	ring->flush();
 	paused = 0;
-	samples_adc_stored = 0;
-	samples_adc_pop = samples_adc_cur;
 }
 
-void Recorder_plc::pop_recorded_buffer(sample_rx_t *samples, uint32_t samples_count)
+int Recorder_plc::pop_recorded_buffer(sample_rx_t *samples, uint32_t samples_count)
 {
-	// TODO: Improve contention mechanism
-	while (samples_count > samples_adc_stored)
-	{
-		assert(samples_count <= BUFFER_SAMPLES);
-		usleep(samples_adc_capturing_time_per_quarter_buffer_us);
-	}
-	uint32_t samples_to_end_buffer = samples_adc_end - samples_adc_pop;
-	if (samples_to_end_buffer > samples_count)
-	{
-		for (; samples_count > 0; samples_count--)
-			*samples++ = *samples_adc_pop++ + SAMPLES_ZERO_REF - SAMPLES_OFFSET;
-	}
-	else
-	{
-		uint32_t samples_count_first = samples_to_end_buffer;
-		uint32_t samples_count_second = samples_count - samples_to_end_buffer;
-		for (; samples_count_first > 0; samples_count_first--)
-			*samples++ = *samples_adc_pop++ + SAMPLES_ZERO_REF - SAMPLES_OFFSET;
-		samples_adc_pop = samples_adc;
-		for (; samples_count_second > 0; samples_count_second--)
-			*samples++ = *samples_adc_pop++ + SAMPLES_ZERO_REF - SAMPLES_OFFSET;
-	}
-	samples_adc_stored -= samples_count;
+	if (ring->pop(samples, samples_count) < 0)
+		return -1;
+	for (; samples_count > 0; samples_count--, samples++)
+		*samples += SAMPLES_ZERO_REF - SAMPLES_OFFSET;
+	return 0;
+}
+
+void Recorder_plc::cancel_pop(void)
+{
+	pthread_mutex_lock(&ring_mutex);
+	pop_cancelled = 1;
+	if (ring)
+		ring->abort();
+	pthread_mutex_unlock(&ring_mutex);
 }
 
 void Recorder_plc::get_statistics(char *text, size_t text_size)
@@ -201,35 +341,25 @@ void Recorder_plc::get_statistics(char *text, size_t text_size)
 }
 
 void Recorder_plc::rx_buffer_completed_callback(void *data, sample_rx_t *samples_buffer,
-		uint32_t samples_buffer_count)
+		uint32_t samples_buffer_count, const struct plc_buffer_stamp *stamp)
 {
 	Recorder_plc *recorder = (Recorder_plc*) data;
-	if (recorder->paused)
-		return;
-	assert(samples_buffer_count <= (uint32_t )(recorder->samples_adc_end - recorder->samples_adc));
-	uint32_t samples_to_end_buffer = recorder->samples_adc_end - recorder->samples_adc_cur;
-	if (samples_to_end_buffer > samples_buffer_count)
+	plc_metric_add(recorder->metric_rx_buffers, 1);
+	if (recorder->rx_last_timestamp_ns != 0)
 	{
-		memcpy(recorder->samples_adc_cur, samples_buffer,
-				samples_buffer_count * sizeof(sample_rx_t));
-		recorder->samples_adc_cur += samples_buffer_count;
-	}
-	else
-	{
-		memcpy(recorder->samples_adc_cur, samples_buffer,
-				samples_to_end_buffer * sizeof(sample_rx_t));
-		uint32_t samples_remaining = samples_buffer_count - samples_to_end_buffer;
-		memcpy(recorder->samples_adc, samples_buffer + samples_to_end_buffer,
-				samples_remaining * sizeof(sample_rx_t));
-		recorder->samples_adc_cur = recorder->samples_adc + samples_remaining;
-	}
-	recorder->samples_adc_stored += samples_buffer_count;
-	// TODO: Control 'pop' overflow
-	if (recorder->samples_adc_stored > recorder->samples_adc_len)
-	{
-		recorder->samples_adc_stored = recorder->samples_adc_len;
-		recorder->samples_adc_pop = recorder->samples_adc_cur;
-		recorder->overflows_detected++;
+		// A sequence going backwards is a restart of the count (resync), not a loss
+		int32_t buffers_lost = (int32_t) (stamp->sequence - recorder->rx_next_sequence);
+		if (buffers_lost > 0)
+			plc_metric_add(recorder->metric_rx_buffers_lost, buffers_lost);
+		plc_metric_observe(recorder->metric_rx_buffer_cycle_us,
+				(stamp->timestamp_ns - recorder->rx_last_timestamp_ns) / NSECS_PER_USEC);
 	}
+	recorder->rx_last_timestamp_ns = stamp->timestamp_ns;
+	recorder->rx_next_sequence = stamp->sequence + 1;
+	if (recorder->paused)
+		return;
+	// On overflow the buffer is dropped and counted
+	if (recorder->ring->push(samples_buffer, samples_buffer_count) < 0)
+		plc_metric_add(recorder->metric_ring_overflows, 1);
 	plc_rx_analysis_analyze_buffer(recorder->plc_rx_analysis, samples_buffer, samples_buffer_count);
 }
@@ -11,17 +11,29 @@
 #ifndef RECORDER_PLC_H
 #define RECORDER_PLC_H
 
+#include <pthread.h>
 #include "+common/api/+base.h"
 #include "libraries/libplc-adc/api/analysis.h"
 #include "recorder_interface.h"
 
 struct plc_adc;
+struct plc_metric;
+struct plc_metrics;
 struct plc_rx_analysis;
+class Spsc_ring;
 
 struct recorder_plc_configuration
 {
 	float capturing_rate_sps;
 	enum plc_rx_statistics_mode rx_statistics_mode;
+	// Samples buffered between the capturing thread and the viewer
+	uint32_t ring_samples;
+	// Capture file (as the binary captures of the 'plc-cape-lab') displayed instead of the ADC
+	char *replay_filename;
+	// Metrics exported to a file (JSON if '.json' extension, otherwise Prometheus text) and/or a
+	//	UNIX-domain socket
+	char *metrics_file;
+	char *metrics_socket;
 };
 
 class Recorder_plc: public Recorder_interface, private recorder_plc_configuration
@@ -44,25 +56,35 @@ public:
 	virtual void stop_recording(void);
 	virtual void pause(void);
 	virtual void resume(void);
-	virtual void pop_recorded_buffer(sample_rx_t *samples, uint32_t samples_count);
+	virtual int pop_recorded_buffer(sample_rx_t *samples, uint32_t samples_count);
+	virtual void cancel_pop(void);
 	virtual void get_statistics(char *text, size_t text_size);
 
 private:
 	static void rx_buffer_completed_callback(void *data, sample_rx_t *samples_buffer,
-			uint32_t samples_buffer_count);
+			uint32_t samples_buffer_count, const struct plc_buffer_stamp *stamp);
+	void create_adc(void);
+	void create_metrics(void);
+	void restart_metrics_export(void);
 
 	struct plc_adc * plc_adc;
 	enum plc_rx_device_enum rx_device;
-	uint32_t samples_adc_len;
-	sample_rx_t *samples_adc;
-	sample_rx_t *samples_adc_cur;
-	sample_rx_t *samples_adc_end;
-	sample_rx_t *samples_adc_pop;
-	int paused;
-	uint32_t samples_adc_stored;
-	uint32_t overflows_detected;
-	uint32_t samples_adc_capturing_time_per_quarter_buffer_us;
+	// Device used when not replaying
+	enum plc_rx_device_enum capturing_rx_device;
+	Spsc_ring *ring;
+	// Protects the creation and destruction of 'ring' against 'cancel_pop'
+	pthread_mutex_t ring_mutex;
+	int pop_cancelled;
+	volatile int paused;
 	struct plc_rx_analysis *plc_rx_analysis;
+	struct plc_metrics *plc_metrics;
+	struct plc_metric *metric_rx_buffers;
+	struct plc_metric *metric_rx_buffers_lost;
+	struct plc_metric *metric_rx_buffer_cycle_us;
+	struct plc_metric *metric_ring_overflows;
+	// Only accessed from the capturing thread
+	int64_t rx_last_timestamp_ns;
+	uint32_t rx_next_sequence;
 };
 
 #endif /* RECORDER_PLC_H */
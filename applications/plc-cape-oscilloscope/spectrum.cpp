@@ -0,0 +1,175 @@
+/**
+ * @file
+ *
+ * @cond COPYRIGHT_NOTES @copyright
+ *	Copyright (C) 2017 Jose Maria Ortega\n
+ *	Distributed under the GNU GPLv3. For full terms see the file LICENSE
+ * @endcond
+ */
+
+#include <math.h>
+#include "spectrum.h"
+
+const char *spectrum_window_text[spectrum_window_COUNT] = {
+	"Rectangular", "Hann", "Blackman-Harris", "Flat-top" };
+
+// Windows as sums of cosines: w[n] = a0 - a1*cos(2*pi*n/N) + a2*cos(4*pi*n/N) - ...
+static const double window_coefficients[spectrum_window_COUNT][5] = {
+	{
+		1.0 }, {
+		0.5, 0.5 }, {
+		0.35875, 0.48829, 0.14128, 0.01168 }, {
+		0.21557895, 0.41663158, 0.277263158, 0.083578947, 0.006947368 } };
+
+Spectrum::Spectrum()
+{
+	plans_count = 0;
+	plans_use_counter = 0;
+	current_plan = NULL;
+	wisdom_filename = NULL;
+	samples_count = 0;
+	fft_size = 0;
+	window = spectrum_window_rectangular;
+	window_samples = NULL;
+	window_samples_count = 0;
+	window_sum = 0.0;
+}
+
+Spectrum::~Spectrum()
+{
+	uint32_t n;
+	for (n = 0; n < plans_count; n++)
+	{
+		fftw_destroy_plan(plans[n].handle);
+		fftw_free(plans[n].out);
+		fftw_free(plans[n].in);
+	}
+	free(window_samples);
+	if (wisdom_filename)
+		free(wisdom_filename);
+}
+
+void Spectrum::set_wisdom_file(const char *filename)
+{
+	if ((filename == wisdom_filename)
+			|| (filename && wisdom_filename && (strcmp(filename, wisdom_filename) == 0)))
+		return;
+	if (wisdom_filename)
+	{
+		free(wisdom_filename);
+		wisdom_filename = NULL;
+	}
+	if (filename)
+	{
+		wisdom_filename = strdup(filename);
+		// It doesn't exist the first time
+		fftw_import_wisdom_from_filename(filename);
+	}
+}
+
+uint32_t Spectrum::configure(uint32_t samples_count, uint32_t fft_size,
+		enum spectrum_window window)
+{
+	assert(samples_count > 0);
+	if (fft_size == 0)
+		for (fft_size = 1; fft_size < samples_count; fft_size <<= 1)
+			;
+	if (samples_count > fft_size)
+		samples_count = fft_size;
+	current_plan = get_plan(fft_size);
+	this->fft_size = fft_size;
+	if ((samples_count != this->samples_count) || (window != this->window))
+	{
+		this->samples_count = samples_count;
+		this->window = window;
+		init_window();
+	}
+	return fft_size / 2 + 1;
+}
+
+void Spectrum::calculate(const sample_rx_t *samples, float *amplitudes)
+{
+	// Removing the weighted mean cancels the DC component along with its leakage
+	double weighted_sum = 0.0;
+	uint32_t n;
+	for (n = 0; n < samples_count; n++)
+		weighted_sum += samples[n] * window_samples[n];
+	double mean = weighted_sum / window_sum;
+	double *in = current_plan->in;
+	for (n = 0; n < samples_count; n++)
+		in[n] = (samples[n] - mean) * window_samples[n];
+	memset(in + samples_count, 0, (fft_size - samples_count) * sizeof(double));
+	fftw_execute(current_plan->handle);
+	// The energy of a sinusoid is split between the positive and negative frequencies and scaled
+	// by the sum of the window (its coherent gain)
+	double scale = 2.0 / window_sum;
+	uint32_t bins = fft_size / 2 + 1;
+	const fftw_complex *out = current_plan->out;
+	amplitudes[0] = 0.0;
+	for (n = 1; n < bins; n++)
+		amplitudes[n] = scale * sqrt(out[n][0] * out[n][0] + out[n][1] * out[n][1]);
+	// The Nyquist bin has no negative counterpart
+	if ((fft_size % 2 == 0) && (bins > 1))
+		amplitudes[bins - 1] /= 2.0;
+}
+
+struct Spectrum::plan *Spectrum::get_plan(uint32_t fft_size)
+{
+	struct plan *plan;
+	uint32_t n;
+	for (n = 0; n < plans_count; n++)
+		if (plans[n].fft_size == fft_size)
+		{
+			plans[n].last_use = ++plans_use_counter;
+			return &plans[n];
+		}
+	if (plans_count < SPECTRUM_PLANS_MAX)
+	{
+		plan = &plans[plans_count++];
+	}
+	else
+	{
+		// Replace the least recently used one
+		plan = &plans[0];
+		for (n = 1; n < plans_count; n++)
+			if (plans[n].last_use < plan->last_use)
+				plan = &plans[n];
+		fftw_destroy_plan(plan->handle);
+		fftw_free(plan->out);
+		fftw_free(plan->in);
+	}
+	plan->fft_size = fft_size;
+	plan->in = (double*) fftw_malloc(fft_size * sizeof(double));
+	plan->out = (fftw_complex*) fftw_malloc((fft_size / 2 + 1) * sizeof(fftw_complex));
+	// FFTW_MEASURE overwrites the arrays while planning. They are filled before each execution
+	plan->handle = fftw_plan_dft_r2c_1d(fft_size, plan->in, plan->out, FFTW_MEASURE);
+	plan->last_use = ++plans_use_counter;
+	if (wisdom_filename)
+		fftw_export_wisdom_to_filename(wisdom_filename);
+	return plan;
+}
+
+void Spectrum::init_window(void)
+{
+	if (samples_count > window_samples_count)
+	{
+		free(window_samples);
+		window_samples = (double*) malloc(samples_count * sizeof(double));
+		window_samples_count = samples_count;
+	}
+	// Periodic windows (N = samples_count) as usual in spectral analysis
+	const double *a = window_coefficients[window];
+	window_sum = 0.0;
+	uint32_t n;
+	for (n = 0; n < samples_count; n++)
+	{
+		double phase = 2.0 * M_PI * n / samples_count;
+		double w = a[0] - a[1] * cos(phase) + a[2] * cos(2.0 * phase) - a[3] * cos(3.0 * phase)
+				+ a[4] * cos(4.0 * phase);
+		window_samples[n] = w;
+		window_sum += w;
+	}
+	// Degenerated windows (as a single sample with Hann) get no amplitude instead of dividing by 0
+	if (window_sum == 0.0)
+		window_sum = 1.0;
+}
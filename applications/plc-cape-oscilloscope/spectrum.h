@@ -0,0 +1,74 @@
+/**
+ * @file
+ * @brief	Amplitude spectrum of real samples through cached FFTW plans
+ *
+ * @cond COPYRIGHT_NOTES @copyright
+ *	Copyright (C) 2017 Jose Maria Ortega\n
+ *	Distributed under the GNU GPLv3. For full terms see the file LICENSE
+ * @endcond
+ */
+
+#ifndef SPECTRUM_H
+#define SPECTRUM_H
+
+#include <fftw3.h>
+#include "+common/api/+base.h"
+
+#define SPECTRUM_PLANS_MAX 8
+#define SPECTRUM_WISDOM_FILENAME_DEFAULT "plc-cape-oscilloscope.wisdom"
+
+extern const char *spectrum_window_text[];
+enum spectrum_window
+{
+	spectrum_window_rectangular = 0,
+	spectrum_window_hann,
+	spectrum_window_blackman_harris,
+	spectrum_window_flat_top,
+	spectrum_window_COUNT
+};
+
+// The real-input (r2c) plans are measured (FFTW_MEASURE) once per size and kept in a small cache,
+// so changing the number of samples only recalculates the window. The wisdom of the measured plans
+// is persisted in a file to make the planning immediate in the next executions
+class Spectrum
+{
+public:
+	Spectrum();
+	~Spectrum();
+	// Imports the FFTW wisdom of 'filename' (NULL to not persist it). The new plans are exported
+	void set_wisdom_file(const char *filename);
+	// Sets the samples to transform in an FFT of 'fft_size' points (0 for the next power of 2 of
+	// 'samples_count'). Fewer samples are zero-padded and extra ones ignored. Returns the bins
+	uint32_t configure(uint32_t samples_count, uint32_t fft_size, enum spectrum_window window);
+	uint32_t get_fft_size(void) { return fft_size; }
+	// Calculates the single-sided amplitude of each bin in sample units (a sinusoid of amplitude A
+	// centered in a bin gets A; with the flat-top window wherever it is). The DC is removed
+	void calculate(const sample_rx_t *samples, float *amplitudes);
+
+private:
+	struct plan
+	{
+		uint32_t fft_size;
+		double *in;
+		fftw_complex *out;
+		fftw_plan handle;
+		uint32_t last_use;
+	};
+
+	struct plan *get_plan(uint32_t fft_size);
+	void init_window(void);
+
+	struct plan plans[SPECTRUM_PLANS_MAX];
+	uint32_t plans_count;
+	uint32_t plans_use_counter;
+	struct plan *current_plan;
+	char *wisdom_filename;
+	uint32_t samples_count;
+	uint32_t fft_size;
+	enum spectrum_window window;
+	double *window_samples;
+	uint32_t window_samples_count;
+	double window_sum;
+};
+
+#endif /* SPECTRUM_H */
@@ -0,0 +1,135 @@
+/**
+ * @file
+ *
+ * @cond COPYRIGHT_NOTES @copyright
+ *	Copyright (C) 2017 Jose Maria Ortega\n
+ *	Distributed under the GNU GPLv3. For full terms see the file LICENSE
+ * @endcond
+ */
+
+#include <linux/futex.h>	// FUTEX_WAIT_PRIVATE
+#include <sys/syscall.h>	// SYS_futex
+#include <unistd.h>			// syscall
+#include "spsc_ring.h"
+
+// Bound of a wait, only relevant if the wake-up of an 'abort' is missed
+#define SPSC_RING_WAIT_TIMEOUT_NS 100000000
+
+static void futex_wait(volatile uint32_t *address, uint32_t value)
+{
+	static const struct timespec timeout = {
+		0, SPSC_RING_WAIT_TIMEOUT_NS };
+	// Returns immediately if '*address' is not 'value' anymore, avoiding lost wake-ups
+	syscall(SYS_futex, address, FUTEX_WAIT_PRIVATE, value, &timeout, NULL, 0);
+}
+
+static void futex_wake(volatile uint32_t *address)
+{
+	syscall(SYS_futex, address, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+}
+
+Spsc_ring::Spsc_ring(uint32_t capacity)
+{
+	this->capacity = 1;
+	while (this->capacity < capacity)
+		this->capacity <<= 1;
+	mask = this->capacity - 1;
+	samples = (sample_rx_t*) malloc(this->capacity * sizeof(sample_rx_t));
+	aborted = 0;
+	write_index = 0;
+	overflows = 0;
+	read_index = 0;
+	consumer_waiting = 0;
+}
+
+Spsc_ring::~Spsc_ring()
+{
+	free(samples);
+}
+
+int Spsc_ring::push(const sample_rx_t *samples, uint32_t samples_count)
+{
+	uint32_t write = write_index;
+	uint32_t read = __atomic_load_n(&read_index, __ATOMIC_ACQUIRE);
+	if (capacity - (write - read) < samples_count)
+	{
+		__atomic_store_n(&overflows, overflows + 1, __ATOMIC_RELAXED);
+		return -1;
+	}
+	uint32_t offset = write & mask;
+	uint32_t samples_to_end = capacity - offset;
+	if (samples_to_end >= samples_count)
+	{
+		memcpy(this->samples + offset, samples, samples_count * sizeof(sample_rx_t));
+	}
+	else
+	{
+		memcpy(this->samples + offset, samples, samples_to_end * sizeof(sample_rx_t));
+		memcpy(this->samples, samples + samples_to_end,
+				(samples_count - samples_to_end) * sizeof(sample_rx_t));
+	}
+	// Sequentially consistent store and load to pair with the ones of 'wait_for_samples'
+	__atomic_store_n(&write_index, write + samples_count, __ATOMIC_SEQ_CST);
+	if (__atomic_load_n(&consumer_waiting, __ATOMIC_SEQ_CST))
+		futex_wake(&write_index);
+	return 0;
+}
+
+uint32_t Spsc_ring::get_overflows(void)
+{
+	return __atomic_load_n(&overflows, __ATOMIC_RELAXED);
+}
+
+int Spsc_ring::wait_for_samples(uint32_t samples_count)
+{
+	uint32_t read = read_index;
+	for (;;)
+	{
+		if (__atomic_load_n(&aborted, __ATOMIC_SEQ_CST))
+			return -1;
+		uint32_t write = __atomic_load_n(&write_index, __ATOMIC_ACQUIRE);
+		if (write - read >= samples_count)
+			return 0;
+		__atomic_store_n(&consumer_waiting, 1, __ATOMIC_SEQ_CST);
+		// Check again after announcing the waiting: a push in between would not wake us up
+		if ((__atomic_load_n(&write_index, __ATOMIC_SEQ_CST) == write)
+				&& !__atomic_load_n(&aborted, __ATOMIC_SEQ_CST))
+			futex_wait(&write_index, write);
+		__atomic_store_n(&consumer_waiting, 0, __ATOMIC_RELAXED);
+	}
+}
+
+int Spsc_ring::pop(sample_rx_t *samples, uint32_t samples_count)
+{
+	assert(samples_count <= capacity);
+	if (wait_for_samples(samples_count) < 0)
+		return -1;
+	uint32_t read = read_index;
+	uint32_t offset = read & mask;
+	uint32_t samples_to_end = capacity - offset;
+	if (samples_to_end >= samples_count)
+	{
+		memcpy(samples, this->samples + offset, samples_count * sizeof(sample_rx_t));
+	}
+	else
+	{
+		memcpy(samples, this->samples + offset, samples_to_end * sizeof(sample_rx_t));
+		memcpy(samples + samples_to_end, this->samples,
+				(samples_count - samples_to_end) * sizeof(sample_rx_t));
+	}
+	__atomic_store_n(&read_index, read + samples_count, __ATOMIC_RELEASE);
+	return 0;
+}
+
+void Spsc_ring::flush(void)
+{
+	__atomic_store_n(&read_index, __atomic_load_n(&write_index, __ATOMIC_ACQUIRE),
+			__ATOMIC_RELEASE);
+}
+
+void Spsc_ring::abort(void)
+{
+	__atomic_store_n(&aborted, 1, __ATOMIC_SEQ_CST);
+	// A consumer about to sleep is not woken up, but its wait is bounded
+	futex_wake(&write_index);
+}
@@ -0,0 +1,61 @@
+/**
+ * @file
+ * @brief	Lock-free single-producer/single-consumer ring of samples
+ *
+ * @cond COPYRIGHT_NOTES @copyright
+ *	Copyright (C) 2017 Jose Maria Ortega\n
+ *	Distributed under the GNU GPLv3. For full terms see the file LICENSE
+ * @endcond
+ */
+
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include "+common/api/+base.h"
+
+#define CACHE_LINE_SIZE 64
+
+// The producer (capturing thread) and the consumer (viewer thread) only share the two indices.
+// They are free-running counters (the capacity is a power of 2) written only by their owner and
+// placed in different cache lines to avoid false sharing. The consumer sleeps on a futex over the
+// write index, so it uses no CPU while waiting and it is woken up as soon as data is pushed. The
+// wait is also bounded in time to notice an 'abort' even if its wake-up is missed
+class Spsc_ring
+{
+public:
+	// 'capacity' is rounded up to a power of 2
+	Spsc_ring(uint32_t capacity);
+	~Spsc_ring();
+	uint32_t get_capacity(void) { return capacity; }
+	// Producer side. The block is pushed whole or dropped (overflow) to keep the blocks contiguous
+	int push(const sample_rx_t *samples, uint32_t samples_count);
+	uint32_t get_overflows(void);
+	// Consumer side. Blocks until 'samples_count' samples are available. Returns -1 without
+	// popping anything if the ring has been aborted
+	// PRECONDITION: samples_count <= capacity
+	int pop(sample_rx_t *samples, uint32_t samples_count);
+	// Consumer side. Discards the samples pending to be popped
+	void flush(void);
+	// Any thread. Wakes up the consumer and makes the current and the next 'pop' fail, so that a
+	// consumer can be stopped even if the producer does not push anymore
+	void abort(void);
+
+private:
+	int wait_for_samples(uint32_t samples_count);
+
+	sample_rx_t *samples;
+	uint32_t capacity;
+	uint32_t mask;
+	volatile uint32_t aborted;
+	char padding_shared[CACHE_LINE_SIZE - sizeof(uint32_t)];
+	// Producer owned
+	volatile uint32_t write_index;
+	uint32_t overflows;
+	char padding_producer[CACHE_LINE_SIZE - 2 * sizeof(uint32_t)];
+	// Consumer owned
+	volatile uint32_t read_index;
+	volatile uint32_t consumer_waiting;
+	char padding_consumer[CACHE_LINE_SIZE - 2 * sizeof(uint32_t)];
+};
+
+#endif /* SPSC_RING_H */
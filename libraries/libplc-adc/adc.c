@@ -36,6 +36,9 @@ struct plc_adc
 {
 	struct plc_adc_api api;
 	plc_adc_h handle;
+	struct adc_pool *adc_pool;
+	struct plc_alsa_settings alsa_settings;
+	struct plc_alsa_statistics alsa_statistics;
 };
 
 ATTR_EXTERN struct plc_adc *plc_adc_create(enum plc_rx_device_enum rx_device)
@@ -50,20 +53,39 @@ ATTR_EXTERN struct plc_adc *plc_adc_create(enum plc_rx_device_enum rx_device)
 		plc_adc->handle = plc_adc_bbb_create(&plc_adc->api, 1);
 		break;
 	case plc_rx_device_alsa:
-		plc_adc->handle = plc_adc_alsa_create(&plc_adc->api);
+		plc_adc->handle = plc_adc_alsa_create(&plc_adc->api, &plc_adc->alsa_settings,
+				&plc_adc->alsa_statistics);
 		break;
 	case plc_rx_device_internal_fifo:
 		plc_adc->handle = plc_adc_fifo_create(&plc_adc->api);
 		break;
 	default:
+		// 'plc_rx_device_replay' requires a file: created through 'plc_adc_create_replay'
 		assert(0);
 	}
+	plc_adc->adc_pool = adc_pool_create();
+	return plc_adc;
+}
+
+ATTR_EXTERN struct plc_adc *plc_adc_create_replay(const char *filename, int paced)
+{
+	struct plc_adc *plc_adc = calloc(1, sizeof(struct plc_adc));
+	plc_adc->handle = plc_adc_replay_create(&plc_adc->api, filename, paced);
+	if (plc_adc->handle == NULL)
+	{
+		free(plc_adc);
+		return NULL;
+	}
+	plc_adc->adc_pool = adc_pool_create();
 	return plc_adc;
 }
 
 ATTR_EXTERN void plc_adc_release(struct plc_adc *plc_adc)
 {
 	plc_adc->api.release(plc_adc->handle);
+	adc_pool_release(plc_adc->adc_pool);
+	if (plc_adc->alsa_settings.device)
+		free(plc_adc->alsa_settings.device);
 	free(plc_adc);
 }
 
@@ -76,10 +98,43 @@ ATTR_EXTERN void plc_adc_set_rx_buffer_completed_callback(struct plc_adc *plc_ad
 		rx_buffer_completed_callback_t rx_buffer_completed_callback,
 		void *rx_buffer_completed_callback_data)
 {
-	plc_adc->api.set_rx_buffer_completed_callback(plc_adc->handle, rx_buffer_completed_callback,
+	adc_pool_set_callback(plc_adc->adc_pool, rx_buffer_completed_callback,
 			rx_buffer_completed_callback_data);
 }
 
+ATTR_EXTERN void plc_adc_set_pool_depth(struct plc_adc *plc_adc, uint32_t buffers)
+{
+	adc_pool_set_depth(plc_adc->adc_pool, buffers);
+}
+
+ATTR_EXTERN void plc_adc_set_alsa_settings(struct plc_adc *plc_adc,
+		const struct plc_alsa_settings *alsa_settings)
+{
+	if (plc_adc->alsa_settings.device)
+		free(plc_adc->alsa_settings.device);
+	plc_adc->alsa_settings = *alsa_settings;
+	// An empty name is accepted as the "default" PCM
+	plc_adc->alsa_settings.device =
+			(alsa_settings->device && *alsa_settings->device) ? strdup(alsa_settings->device) : NULL;
+}
+
+ATTR_EXTERN void plc_adc_retain_buffer(struct plc_adc *plc_adc, const sample_rx_t *samples_buffer)
+{
+	adc_pool_retain_buffer(plc_adc->adc_pool, samples_buffer);
+}
+
+ATTR_EXTERN void plc_adc_release_buffer(struct plc_adc *plc_adc, const sample_rx_t *samples_buffer)
+{
+	adc_pool_release_buffer(plc_adc->adc_pool, samples_buffer);
+}
+
+ATTR_EXTERN void plc_adc_get_statistics(struct plc_adc *plc_adc,
+		struct plc_adc_statistics *statistics)
+{
+	adc_pool_get_statistics(plc_adc->adc_pool, statistics);
+	statistics->alsa = plc_adc->alsa_statistics;
+}
+
 ATTR_EXTERN sample_rx_t plc_adc_read_sample(struct plc_adc *plc_adc)
 {
 	return plc_adc->api.read_sample(plc_adc->handle);
@@ -88,7 +143,8 @@ ATTR_EXTERN sample_rx_t plc_adc_read_sample(struct plc_adc *plc_adc)
 ATTR_EXTERN int plc_adc_start_capture(struct plc_adc *plc_adc, uint32_t buffer_samples,
 		int kernel_buffering, float freq_capture_sps)
 {
-	return plc_adc->api.start_capture(plc_adc->handle, buffer_samples, kernel_buffering, freq_capture_sps);
+	return plc_adc->api.start_capture(plc_adc->handle, plc_adc->adc_pool, buffer_samples,
+			kernel_buffering, freq_capture_sps);
 }
 
 ATTR_EXTERN void plc_adc_stop_capture(struct plc_adc *plc_adc)
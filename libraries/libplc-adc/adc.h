@@ -12,6 +12,7 @@
 #define ADC_H
 
 #include "api/adc.h"
+#include "adc_pool.h"
 
 #define THREAD_TIMEOUT_SECONDS 5
 
@@ -23,17 +24,18 @@ struct plc_adc_api
 {
 	void (*release)(plc_adc_h handle);
 	float (*get_sampling_frequency)(plc_adc_h handle);
-	void (*set_rx_buffer_completed_callback)(plc_adc_h handle,
-			rx_buffer_completed_callback_t rx_buffer_completed_callback,
-			void *rx_buffer_completed_callback_data);
 	sample_rx_t (*read_sample)(plc_adc_h handle);
-	int (*start_capture)(plc_adc_h handle, uint32_t buffer_samples, int kernel_buffering,
-			float freq_capture_sps);
+	// The captured buffers are got from and pushed to 'adc_pool'
+	int (*start_capture)(plc_adc_h handle, struct adc_pool *adc_pool, uint32_t buffer_samples,
+			int kernel_buffering, float freq_capture_sps);
 	void (*stop_capture)(plc_adc_h handle);
 };
 
 plc_adc_h plc_adc_bbb_create(struct plc_adc_api *api, int std_driver);
-plc_adc_h plc_adc_alsa_create(struct plc_adc_api *api);
+// 'alsa_settings' is read on each 'start_capture'; 'alsa_statistics' is updated while capturing
+plc_adc_h plc_adc_alsa_create(struct plc_adc_api *api,
+		const struct plc_alsa_settings *alsa_settings, struct plc_alsa_statistics *alsa_statistics);
 plc_adc_h plc_adc_fifo_create(struct plc_adc_api *api);
+plc_adc_h plc_adc_replay_create(struct plc_adc_api *api, const char *filename, int paced);
 
 #endif /* ADC_H_ */
@@ -44,16 +44,22 @@ typedef struct plc_adc *plc_adc_h;
 
 static const char *adc_capturing_device = "default";
 
+// Max time blocked waiting for the device so the termination request is attended
+#define ADC_ALSA_WAIT_TIMEOUT_MS 100
+
 struct plc_adc
 {
 	float freq_capture_sps;
-	uint16_t *frames_buffer;
+	struct adc_pool *adc_pool;
+	// Samples of each pool buffer
+	uint32_t samples_buffer_len;
+	// Frames of each period of the device
 	uint32_t frames_buffer_len;
 	snd_pcm_t *snd_pcm_handle;
 	snd_pcm_hw_params_t *hwparams;
 	snd_pcm_sw_params_t *swparams;
-	rx_buffer_completed_callback_t rx_buffer_completed_callback;
-	void *rx_buffer_completed_callback_data;
+	const struct plc_alsa_settings *alsa_settings;
+	struct plc_alsa_statistics *alsa_statistics;
 	pthread_t thread;
 	volatile int end_thread;
 	int capture_started;
@@ -65,7 +71,8 @@ int adc_set_hwparams(struct plc_adc *plc_adc, snd_pcm_uframes_t period_len)
 	int err = snd_pcm_hw_params_any(plc_adc->snd_pcm_handle, plc_adc->hwparams);
 	if (err >= 0)
 		err = snd_pcm_hw_params_set_access(plc_adc->snd_pcm_handle, plc_adc->hwparams,
-				SND_PCM_ACCESS_RW_INTERLEAVED);
+				plc_adc->alsa_settings->mmap ?
+						SND_PCM_ACCESS_MMAP_INTERLEAVED : SND_PCM_ACCESS_RW_INTERLEAVED);
 	// Although the 'SND_PCM_FORMAT_U16' is an available format it is not accepted on some PCs
 	if (err >= 0)
 		err = snd_pcm_hw_params_set_format(plc_adc->snd_pcm_handle, plc_adc->hwparams,
@@ -92,10 +99,13 @@ int adc_set_hwparams(struct plc_adc *plc_adc, snd_pcm_uframes_t period_len)
 		err = snd_pcm_hw_params_get_period_size_max(plc_adc->hwparams, &period_len_max,
 		NULL);
 		assert(err == 0);
-		// Default periods = 4 as a reasonable value
-		unsigned int nperiods = 4;
-		err = snd_pcm_hw_params_set_periods_near(plc_adc->snd_pcm_handle, plc_adc->hwparams,
-				&nperiods, NULL);
+		unsigned int nperiods = plc_adc->alsa_settings->periods ?
+				plc_adc->alsa_settings->periods : PLC_ALSA_PERIODS_DEFAULT;
+		err = snd_pcm_hw_params_set_period_size_near(plc_adc->snd_pcm_handle, plc_adc->hwparams,
+				&period_len, NULL);
+		if (err >= 0)
+			err = snd_pcm_hw_params_set_periods_near(plc_adc->snd_pcm_handle, plc_adc->hwparams,
+					&nperiods, NULL);
 		if (err >= 0)
 		{
 			snd_pcm_uframes_t buffer_len = period_len * nperiods;
@@ -112,7 +122,7 @@ int adc_set_hwparams(struct plc_adc *plc_adc, snd_pcm_uframes_t period_len)
 					err = snd_pcm_hw_params_get_period_size(plc_adc->hwparams, &period_len,
 					NULL);
 					assert(
-							(&err >= 0) && (period_len >= period_len_min)
+							(err >= 0) && (period_len >= period_len_min)
 									&& (period_len <= period_len_max)
 									&& (buffer_len >= buffer_len_min)
 									&& (buffer_len <= buffer_len_max));
@@ -150,20 +160,12 @@ int adc_set_swparams(struct plc_adc *plc_adc)
 	return err;
 }
 
-float adc_get_sampling_frequency(struct plc_adc *plc_adc)
+static float adc_get_sampling_frequency(struct plc_adc *plc_adc)
 {
 	return plc_adc->freq_capture_sps;
 }
 
-void adc_set_rx_buffer_completed_callback(struct plc_adc *plc_adc,
-		rx_buffer_completed_callback_t rx_buffer_completed_callback,
-		void *rx_buffer_completed_callback_data)
-{
-	plc_adc->rx_buffer_completed_callback = rx_buffer_completed_callback;
-	plc_adc->rx_buffer_completed_callback_data = rx_buffer_completed_callback_data;
-}
-
-uint16_t adc_read_sample(struct plc_adc *plc_adc)
+static uint16_t adc_read_sample(struct plc_adc *plc_adc)
 {
 	// TODO: To be implemented
 	return 0;
@@ -172,38 +174,140 @@ uint16_t adc_read_sample(struct plc_adc *plc_adc)
 #if ADC_BITS > 16
 #error Current implementation only accepts ADC samples <= 16-bits
 #endif
-void *adc_thread_capture_samples(void *arg)
+// TODO: Accept signed samples instead of converting them to unsigned
+static void adc_convert_samples(sample_rx_t *samples, const int16_t *frames, uint32_t frames_count)
+{
+	for (; frames_count > 0; frames_count--)
+		*samples++ = ((uint16_t) (*frames++ + 0x8000)) >> (16 - ADC_BITS);
+}
+
+static void adc_update_delay(struct plc_adc *plc_adc)
+{
+	snd_pcm_sframes_t delay;
+	if ((snd_pcm_delay(plc_adc->snd_pcm_handle, &delay) >= 0) && (delay >= 0))
+	{
+		plc_adc->alsa_statistics->delay_frames = delay;
+		if (delay > plc_adc->alsa_statistics->delay_max_frames)
+			plc_adc->alsa_statistics->delay_max_frames = delay;
+	}
+}
+
+// Returns 0 if recovered, or the unrecoverable error
+static int adc_recover(struct plc_adc *plc_adc, int err)
+{
+	if (err == -EPIPE)
+		plc_adc->alsa_statistics->xruns++;
+	err = snd_pcm_recover(plc_adc->snd_pcm_handle, err, 1);
+	// On 'mmap' the capture must be explicitly started again
+	if ((err >= 0) && plc_adc->alsa_settings->mmap)
+		err = snd_pcm_start(plc_adc->snd_pcm_handle);
+	if (err >= 0)
+		plc_adc->alsa_statistics->recoveries++;
+	return err;
+}
+
+// Returns the frames read (0 on timeout) or a negative error code
+static snd_pcm_sframes_t adc_read_frames(struct plc_adc *plc_adc, sample_rx_t *samples,
+		snd_pcm_uframes_t frames)
+{
+	snd_pcm_sframes_t frames_read = snd_pcm_readi(plc_adc->snd_pcm_handle, samples, frames);
+	if (frames_read > 0)
+		adc_convert_samples(samples, (const int16_t*) samples, frames_read);
+	return frames_read;
+}
+
+// Converts the samples directly from the ring buffer of the device, avoiding the intermediate
+//	copy of 'snd_pcm_readi'
+static snd_pcm_sframes_t adc_read_frames_mmap(struct plc_adc *plc_adc, sample_rx_t *samples,
+		snd_pcm_uframes_t frames)
+{
+	snd_pcm_t *handle = plc_adc->snd_pcm_handle;
+	snd_pcm_sframes_t avail = snd_pcm_avail_update(handle);
+	if (avail < 0)
+		return avail;
+	if (avail == 0)
+	{
+		int ret = snd_pcm_wait(handle, ADC_ALSA_WAIT_TIMEOUT_MS);
+		if (ret <= 0)
+			return ret;
+		avail = snd_pcm_avail_update(handle);
+		if (avail <= 0)
+			return avail;
+	}
+	const snd_pcm_channel_area_t *areas;
+	snd_pcm_uframes_t offset;
+	snd_pcm_uframes_t frames_contiguous = ((snd_pcm_uframes_t) avail < frames) ? avail : frames;
+	int ret = snd_pcm_mmap_begin(handle, &areas, &offset, &frames_contiguous);
+	if (ret < 0)
+		return ret;
+	// Mono interleaved: the samples of the channel are consecutive
+	assert(areas[0].step == 16);
+	const int16_t *frames_ring = (const int16_t*) ((const uint8_t*) areas[0].addr
+			+ areas[0].first / 8) + offset;
+	adc_convert_samples(samples, frames_ring, frames_contiguous);
+	// A short commit is not an overrun: only the frames committed are consumed, the rest are read
+	//	again by the next call. If the stream broke meanwhile the next call gets the real error
+	return snd_pcm_mmap_commit(handle, offset, frames_contiguous);
+}
+
+static void *adc_thread_capture_samples(void *arg)
 {
-	// If writing to file do it first to a memory buffer to minimize the impact on captures
 	assert(ADC_BITS <= 16);
 	struct plc_adc *plc_adc = (struct plc_adc *) arg;
+	snd_pcm_sframes_t (*read_frames)(struct plc_adc *plc_adc, sample_rx_t *samples,
+			snd_pcm_uframes_t frames) =
+			plc_adc->alsa_settings->mmap ? adc_read_frames_mmap : adc_read_frames;
 	while (!plc_adc->end_thread)
 	{
-		ssize_t frames_captured = snd_pcm_readi(plc_adc->snd_pcm_handle, plc_adc->frames_buffer,
-				plc_adc->frames_buffer_len);
-		snd_pcm_wait(plc_adc->snd_pcm_handle, 100);
-		assert((uint32_t )frames_captured == plc_adc->frames_buffer_len);
-		// TODO: Accept signed samples instead of converting them to unsigned
-		uint16_t *samples = plc_adc->frames_buffer;
-		uint32_t samples_captured = plc_adc->frames_buffer_len;
-		for (; samples_captured > 0; samples_captured--, samples++)
-			*samples = ((uint16_t) ((int16_t) *samples + 0x8000)) >> (16 - ADC_BITS);
-		if (plc_adc->rx_buffer_completed_callback)
-			plc_adc->rx_buffer_completed_callback(plc_adc->rx_buffer_completed_callback_data,
-					plc_adc->frames_buffer, plc_adc->frames_buffer_len);
+		// Real-time source: on overflow the buffer is captured anyway but lost
+		sample_rx_t *samples_buffer = adc_pool_get_free_buffer(plc_adc->adc_pool, 0);
+		uint32_t samples_captured = 0;
+		while ((samples_captured < plc_adc->samples_buffer_len) && !plc_adc->end_thread)
+		{
+			snd_pcm_sframes_t frames_read = read_frames(plc_adc, samples_buffer + samples_captured,
+					plc_adc->samples_buffer_len - samples_captured);
+			if (frames_read < 0)
+			{
+				if (frames_read == -EAGAIN)
+					continue;
+				// The samples lost make the partial buffer useless. The gap in the sequence reveals
+				//	the discontinuity
+				samples_captured = 0;
+				adc_pool_skip_sequence(plc_adc->adc_pool);
+				if (adc_recover(plc_adc, frames_read) < 0)
+					plc_adc->end_thread = 1;
+				continue;
+			}
+			samples_captured += frames_read;
+		}
+		if (samples_captured < plc_adc->samples_buffer_len)
+		{
+			adc_pool_discard_buffer(plc_adc->adc_pool, samples_buffer);
+			break;
+		}
+		adc_update_delay(plc_adc);
+		adc_pool_push_buffer(plc_adc->adc_pool, samples_buffer);
 	}
 	return NULL;
 }
 
-int adc_start_capture(struct plc_adc *plc_adc, uint32_t buffer_samples, int kernel_buffering,
-		float freq_capture_sps)
+static int adc_start_capture(struct plc_adc *plc_adc, struct adc_pool *adc_pool,
+		uint32_t buffer_samples, int kernel_buffering, float freq_capture_sps)
 {
 	plc_adc->freq_capture_sps = freq_capture_sps;
-	int ret = snd_pcm_open(&plc_adc->snd_pcm_handle, adc_capturing_device, SND_PCM_STREAM_CAPTURE,
-			0);
+	plc_adc->adc_pool = adc_pool;
+	plc_adc->samples_buffer_len = buffer_samples;
+	memset(plc_adc->alsa_statistics, 0, sizeof(*plc_adc->alsa_statistics));
+	int ret = snd_pcm_open(&plc_adc->snd_pcm_handle,
+			plc_adc->alsa_settings->device ? plc_adc->alsa_settings->device : adc_capturing_device,
+			SND_PCM_STREAM_CAPTURE, 0);
 	if (ret < 0)
 		return ret;
-	ret = adc_set_hwparams(plc_adc, buffer_samples);
+	// The periods are decoupled from the pool buffers: they are filled by as many transfers as
+	//	required
+	ret = adc_set_hwparams(plc_adc,
+			plc_adc->alsa_settings->period_frames ?
+					plc_adc->alsa_settings->period_frames : buffer_samples);
 	if (ret < 0)
 	{
 		snd_pcm_close(plc_adc->snd_pcm_handle);
@@ -221,10 +325,19 @@ int adc_start_capture(struct plc_adc *plc_adc, uint32_t buffer_samples, int kern
 		//		strerror(-ret));
 		return ret;
 	}
-	uint32_t period_bytes = snd_pcm_frames_to_bytes(plc_adc->snd_pcm_handle,
-			plc_adc->frames_buffer_len);
-	plc_adc->frames_buffer = (uint16_t*) malloc(period_bytes);
-	assert(plc_adc->frames_buffer != NULL);
+	// On 'mmap' the 'start_threshold' is not applied: the capture must be explicitly started
+	if (plc_adc->alsa_settings->mmap)
+	{
+		ret = snd_pcm_start(plc_adc->snd_pcm_handle);
+		if (ret < 0)
+		{
+			snd_pcm_close(plc_adc->snd_pcm_handle);
+			return ret;
+		}
+	}
+	// Mono 16-bits frames are directly converted to samples
+	assert(snd_pcm_frames_to_bytes(plc_adc->snd_pcm_handle, 1) == sizeof(sample_rx_t));
+	adc_pool_start(adc_pool, buffer_samples);
 #ifdef VERBOSE
 	// Print log
 	char *log_text;
@@ -250,7 +363,7 @@ int adc_start_capture(struct plc_adc *plc_adc, uint32_t buffer_samples, int kern
 	return ret;
 }
 
-void adc_stop_capture(struct plc_adc *plc_adc)
+static void adc_stop_capture(struct plc_adc *plc_adc)
 {
 	int ret;
 	assert(plc_adc->capture_started);
@@ -263,15 +376,11 @@ void adc_stop_capture(struct plc_adc *plc_adc)
 	assert(ret == 0);
 	ret = snd_pcm_close(plc_adc->snd_pcm_handle);
 	assert(ret >= 0);
-	if (plc_adc->frames_buffer)
-	{
-		free(plc_adc->frames_buffer);
-		plc_adc->frames_buffer = NULL;
-	}
+	adc_pool_stop(plc_adc->adc_pool);
 	plc_adc->capture_started = 0;
 }
 
-void adc_release(struct plc_adc *plc_adc)
+static void adc_release(struct plc_adc *plc_adc)
 {
 	if (plc_adc->capture_started)
 		adc_stop_capture(plc_adc);
@@ -280,19 +389,20 @@ void adc_release(struct plc_adc *plc_adc)
 	free(plc_adc);
 }
 
-ATTR_INTERN struct plc_adc *plc_adc_alsa_create(struct plc_adc_api *api)
+ATTR_INTERN struct plc_adc *plc_adc_alsa_create(struct plc_adc_api *api,
+		const struct plc_alsa_settings *alsa_settings, struct plc_alsa_statistics *alsa_statistics)
 {
 	struct plc_adc *plc_adc = calloc(1, sizeof(struct plc_adc));
 	// set_dummy_functions(api, sizeof(*api));
 	api->release = adc_release;
 	api->get_sampling_frequency = adc_get_sampling_frequency;
-	api->set_rx_buffer_completed_callback = adc_set_rx_buffer_completed_callback;
 	api->read_sample = adc_read_sample;
 	api->start_capture = adc_start_capture;
 	api->stop_capture = adc_stop_capture;
-	plc_adc->frames_buffer = NULL;
 	plc_adc->frames_buffer_len = 0;
 	plc_adc->snd_pcm_handle = NULL;
+	plc_adc->alsa_settings = alsa_settings;
+	plc_adc->alsa_statistics = alsa_statistics;
 	snd_pcm_hw_params_malloc(&plc_adc->hwparams);
 	snd_pcm_sw_params_malloc(&plc_adc->swparams);
 	return plc_adc;
@@ -45,8 +45,7 @@ struct plc_adc
 {
 	int kernel_buffering;
 	float freq_capture_sps;
-	rx_buffer_completed_callback_t rx_buffer_completed_callback;
-	void *rx_buffer_completed_callback_data;
+	struct adc_pool *adc_pool;
 	int plc_driver;
 	int fd;
 	uint32_t buffer_samples;
@@ -68,20 +67,12 @@ struct plc_adc
 	} capture_mode;
 };
 
-float adc_get_sampling_frequency(struct plc_adc *plc_adc)
+static float adc_get_sampling_frequency(struct plc_adc *plc_adc)
 {
 	return plc_adc->freq_capture_sps;
 }
 
-void adc_set_rx_buffer_completed_callback(struct plc_adc *plc_adc,
-		rx_buffer_completed_callback_t rx_buffer_completed_callback,
-		void *rx_buffer_completed_callback_data)
-{
-	plc_adc->rx_buffer_completed_callback = rx_buffer_completed_callback;
-	plc_adc->rx_buffer_completed_callback_data = rx_buffer_completed_callback_data;
-}
-
-uint16_t adc_read_sample(struct plc_adc *plc_adc)
+static uint16_t adc_read_sample(struct plc_adc *plc_adc)
 {
 	char adc_value_text[5];
 	adc_value_text[4] = '\0';
@@ -254,7 +245,7 @@ int adc_user_buffering_capture_cycle(struct plc_adc *plc_adc, sample_rx_t *buffe
 	return 1;
 }
 
-void *adc_thread_capture_samples(void *arg)
+static void *adc_thread_capture_samples(void *arg)
 {
 	// Boost 'self' thread
 	// For more details look to 'thread_spi_tx_buffer'
@@ -263,15 +254,8 @@ void *adc_thread_capture_samples(void *arg)
 	param.sched_priority = 1;
 	int ret = sched_setscheduler(0, SCHED_RR, &param);
 	assert(ret == 0);
-	// If writing to file do it first to a memory buffer to minimize the impact on captures
+	// The buffers are handed-off to the consumer thread of the pool. This thread only captures
 	struct plc_adc *plc_adc = (struct plc_adc *) arg;
-	static const int BUFFERS_ADC_COUNT = 4;
-	sample_rx_t *buffer_adc[BUFFERS_ADC_COUNT];
-	int buffer_index = 0;
-	int i;
-	for (i = 0; i < BUFFERS_ADC_COUNT; i++)
-		buffer_adc[i] = (sample_rx_t*) malloc(sizeof(sample_rx_t) * plc_adc->buffer_samples);
-	sample_rx_t *buffer_adc_cur = buffer_adc[0];
 	if (plc_adc->kernel_buffering)
 	{
 		if (iio_std_exchange)
@@ -282,7 +266,8 @@ void *adc_thread_capture_samples(void *arg)
 	while (!plc_adc->end_thread)
 	{
 		// logger_log_sequence(logger, "<");
-		buffer_adc_cur = buffer_adc[buffer_index];
+		// Real-time source: on overflow the buffer is captured anyway but lost
+		sample_rx_t *buffer_adc_cur = adc_pool_get_free_buffer(plc_adc->adc_pool, 0);
 		int buffer_rx_ok = 1;
 		if (plc_adc->kernel_buffering)
 		{
@@ -296,20 +281,10 @@ void *adc_thread_capture_samples(void *arg)
 		{
 			adc_user_buffering_capture_cycle(plc_adc, buffer_adc_cur);
 		}
-		if (plc_adc->rx_buffer_completed_callback)
-		{
-			plc_adc->rx_buffer_completed_callback(plc_adc->rx_buffer_completed_callback_data,
-					buffer_adc_cur, plc_adc->buffer_samples);
-
-		}
+		adc_pool_push_buffer(plc_adc->adc_pool, buffer_adc_cur);
 		// Timeout -> Retrigger
 		if (!buffer_rx_ok)
-		{
 			plc_libadc_log_line(">> Retrigger");
-			continue;
-		}
-		if (++buffer_index == BUFFERS_ADC_COUNT)
-			buffer_index = 0;
 	}
 	if (plc_adc->kernel_buffering)
 	{
@@ -318,34 +293,14 @@ void *adc_thread_capture_samples(void *arg)
 		else
 			adc_custom_capture_end(plc_adc);
 	}
-	// To debug internal buffers enable the following code
-	/*
-	 #define ADC_FILE_CAPTURE_CHUNK "plc_adc%d.csv"
-	 if (plc_adc->samples_to_file)
-	 {
-	 logger_log_sequence_format(logger, "Buffer index in process = %d\n", buffer_index);
-	 for (i = 0; i < BUFFERS_ADC_COUNT; i++)
-	 {
-	 char szFilename[16];
-	 sprintf(szFilename, ADC_FILE_CAPTURE_CHUNK, i);
-	 ret = plc_file_write_csv(szFilename, sample_rx_csv_enum, buffer_adc[i],
-			plc_adc->buffer_samples);
-	 assert(ret >= 0);
-	 }
-	 if (plc_adc->log_callback)
-	 plc_adc->log_callback(plc_adc->log_callback_data, "ADC-Buffers saved\n");
-	 }
-	 */
-	for (i = 0; i < BUFFERS_ADC_COUNT; i++)
-		free(buffer_adc[i]);
-
 	return NULL;
 }
 
-int adc_start_capture(struct plc_adc *plc_adc, uint32_t buffer_samples,
-		int kernel_buffering, float freq_capture_sps)
+static int adc_start_capture(struct plc_adc *plc_adc, struct adc_pool *adc_pool,
+		uint32_t buffer_samples, int kernel_buffering, float freq_capture_sps)
 {
 	int ret;
+	plc_adc->adc_pool = adc_pool;
 	plc_adc->buffer_samples = buffer_samples;
 	plc_adc->end_thread = 0;
 	plc_adc->kernel_buffering = kernel_buffering;
@@ -355,13 +310,14 @@ int adc_start_capture(struct plc_adc *plc_adc, uint32_t buffer_samples,
 		ret = pipe(plc_adc->wakeup_pipe);
 		assert(ret == 0);
 	}
+	adc_pool_start(adc_pool, buffer_samples);
 	ret = pthread_create(&plc_adc->thread, NULL, adc_thread_capture_samples, plc_adc);
 	assert(ret == 0);
 	plc_adc->capture_started = 1;
 	return 0;
 }
 
-void adc_stop_capture(struct plc_adc *plc_adc)
+static void adc_stop_capture(struct plc_adc *plc_adc)
 {
 	int ret;
 	assert(plc_adc->capture_started);
@@ -390,10 +346,11 @@ void adc_stop_capture(struct plc_adc *plc_adc)
 		ret = pthread_timedjoin_np(plc_adc->thread, NULL, &timeout);
 		assert(ret == 0);
 	}
+	adc_pool_stop(plc_adc->adc_pool);
 	plc_adc->capture_started = 0;
 }
 
-void adc_release(struct plc_adc *plc_adc)
+static void adc_release(struct plc_adc *plc_adc)
 {
 	if (plc_adc->capture_started)
 		plc_adc_stop_capture(plc_adc);
@@ -408,7 +365,6 @@ ATTR_INTERN struct plc_adc *plc_adc_bbb_create(struct plc_adc_api *api, int std_
 	// set_dummy_functions(api, sizeof(*api));
 	api->release = adc_release;
 	api->get_sampling_frequency = adc_get_sampling_frequency;
-	api->set_rx_buffer_completed_callback = adc_set_rx_buffer_completed_callback;
 	api->read_sample = adc_read_sample;
 	api->start_capture = adc_start_capture;
 	api->stop_capture = adc_stop_capture;
@@ -21,36 +21,26 @@ typedef struct plc_adc *plc_adc_h;
 struct plc_adc
 {
 	float freq_capture_sps;
-	sample_rx_t *buffer;
+	struct adc_pool *adc_pool;
 	uint32_t buffer_len;
-	rx_buffer_completed_callback_t rx_buffer_completed_callback;
-	void *rx_buffer_completed_callback_data;
 	pthread_t thread;
 	volatile int end_thread;
 	int capture_started;
 	int fifo;
 };
 
-float adc_get_sampling_frequency(struct plc_adc *plc_adc)
+static float adc_get_sampling_frequency(struct plc_adc *plc_adc)
 {
 	return plc_adc->freq_capture_sps;
 }
 
-void adc_set_rx_buffer_completed_callback(struct plc_adc *plc_adc,
-		rx_buffer_completed_callback_t rx_buffer_completed_callback,
-		void *rx_buffer_completed_callback_data)
-{
-	plc_adc->rx_buffer_completed_callback = rx_buffer_completed_callback;
-	plc_adc->rx_buffer_completed_callback_data = rx_buffer_completed_callback_data;
-}
-
-uint16_t adc_read_sample(struct plc_adc *plc_adc)
+static uint16_t adc_read_sample(struct plc_adc *plc_adc)
 {
 	// TODO: To be implemented
 	return 0;
 }
 
-void *adc_thread_capture_samples(void *arg)
+static void *adc_thread_capture_samples(void *arg)
 {
 	struct plc_adc *plc_adc = (struct plc_adc *) arg;
 	if (plc_adc->fifo == -1)
@@ -60,7 +50,10 @@ void *adc_thread_capture_samples(void *arg)
 	}
 	while (!plc_adc->end_thread)
 	{
-		uint8_t *buffer = (uint8_t *) plc_adc->buffer;
+		// The fifo writer is throttled while the consumer is busy, as with the former synchronous
+		//	implementation
+		sample_rx_t *samples_buffer = adc_pool_get_free_buffer(plc_adc->adc_pool, 1);
+		uint8_t *buffer = (uint8_t *) samples_buffer;
 		uint32_t bytes_to_read = plc_adc->buffer_len * sizeof(sample_rx_t);
 		int ret = 0;
 		while (bytes_to_read > 0)
@@ -82,20 +75,23 @@ void *adc_thread_capture_samples(void *arg)
 			bytes_to_read -= ret;
 		}
 		if (ret < 0)
+		{
+			adc_pool_discard_buffer(plc_adc->adc_pool, samples_buffer);
 			break;
-		if (plc_adc->rx_buffer_completed_callback)
-			plc_adc->rx_buffer_completed_callback(plc_adc->rx_buffer_completed_callback_data,
-					plc_adc->buffer, plc_adc->buffer_len);
+		}
+		adc_pool_push_buffer(plc_adc->adc_pool, samples_buffer);
 	}
 	return NULL;
 }
 
-int adc_start_capture(struct plc_adc *plc_adc, uint32_t buffer_samples, int kernel_buffering, float freq_capture_sps)
+static int adc_start_capture(struct plc_adc *plc_adc, struct adc_pool *adc_pool,
+		uint32_t buffer_samples, int kernel_buffering, float freq_capture_sps)
 {
-	assert(plc_adc->buffer == NULL);
+	assert(!plc_adc->capture_started);
 	plc_adc->freq_capture_sps = freq_capture_sps;
-	plc_adc->buffer = (sample_rx_t *) malloc(buffer_samples * sizeof(sample_rx_t));
+	plc_adc->adc_pool = adc_pool;
 	plc_adc->buffer_len = buffer_samples;
+	adc_pool_start(adc_pool, buffer_samples);
 	plc_adc->capture_started = 1;
 	plc_adc->end_thread = 0;
 	int ret = pthread_create(&plc_adc->thread, NULL, adc_thread_capture_samples, plc_adc);
@@ -103,7 +99,7 @@ int adc_start_capture(struct plc_adc *plc_adc, uint32_t buffer_samples, int kern
 	return 0;
 }
 
-void adc_stop_capture(struct plc_adc *plc_adc)
+static void adc_stop_capture(struct plc_adc *plc_adc)
 {
 	int ret;
 	assert(plc_adc->capture_started);
@@ -114,11 +110,7 @@ void adc_stop_capture(struct plc_adc *plc_adc)
 	timeout.tv_sec += THREAD_TIMEOUT_SECONDS;
 	ret = pthread_timedjoin_np(plc_adc->thread, NULL, &timeout);
 	assert(ret == 0);
-	if (plc_adc->buffer)
-	{
-		free(plc_adc->buffer);
-		plc_adc->buffer = NULL;
-	}
+	adc_pool_stop(plc_adc->adc_pool);
 	// TODO: Try to close here the fifo without breaking the pipe with 'tx_sched_fifo'
 	//	if (plc_adc->fifo != -1)
 	//	{
@@ -128,7 +120,7 @@ void adc_stop_capture(struct plc_adc *plc_adc)
 	plc_adc->capture_started = 0;
 }
 
-void adc_release(struct plc_adc *plc_adc)
+static void adc_release(struct plc_adc *plc_adc)
 {
 	// Close the fifo at the last moment to don't broke the pipe while some possible transmission
 	// in progress
@@ -145,11 +137,9 @@ ATTR_INTERN struct plc_adc *plc_adc_fifo_create(struct plc_adc_api *api)
 	// set_dummy_functions(api, sizeof(*api));
 	api->release = adc_release;
 	api->get_sampling_frequency = adc_get_sampling_frequency;
-	api->set_rx_buffer_completed_callback = adc_set_rx_buffer_completed_callback;
 	api->read_sample = adc_read_sample;
 	api->start_capture = adc_start_capture;
 	api->stop_capture = adc_stop_capture;
-	plc_adc->buffer = NULL;
 	plc_adc->buffer_len = 0;
 	plc_adc->fifo = -1;
 	return plc_adc;
@@ -0,0 +1,312 @@
+/**
+ * @file
+ *
+ * @cond COPYRIGHT_NOTES @copyright
+ *	Copyright (C) 2017 Jose Maria Ortega\n
+ *	Distributed under the GNU GPLv3. For full terms see the file LICENSE
+ * @endcond
+ */
+
+#include <pthread.h>
+#include "+common/api/+base.h"
+#include "adc_pool.h"
+#include "libraries/libplc-tools/api/time.h"
+
+#define ADC_POOL_DEPTH_MIN 2
+
+// The buffers are allocated in a single block. The extra one at the end is the scratch buffer
+// returned on overflow
+struct adc_pool
+{
+	uint32_t depth;
+	uint32_t buffer_samples;
+	sample_rx_t *samples;
+	// References per buffer: the producer/consumer pipeline plus the ones retained by the consumer
+	uint32_t *references;
+	uint32_t *free_stack;
+	uint32_t free_count;
+	uint32_t *queue;
+	struct plc_buffer_stamp *stamps;
+	// Samples of each buffer: 'buffer_samples' but for the tail of a finite source
+	uint32_t *samples_counts;
+	uint32_t sequence;
+	uint32_t queue_head;
+	uint32_t queue_count;
+	pthread_mutex_t mutex;
+	pthread_cond_t buffer_queued;
+	pthread_cond_t buffer_freed;
+	pthread_t thread;
+	int end_thread;
+	int end_of_capture_queued;
+	int started;
+	rx_buffer_completed_callback_t rx_buffer_completed_callback;
+	void *rx_buffer_completed_callback_data;
+	struct plc_adc_statistics statistics;
+};
+
+static void adc_pool_free_buffers(struct adc_pool *adc_pool)
+{
+	free(adc_pool->samples);
+	free(adc_pool->references);
+	free(adc_pool->free_stack);
+	free(adc_pool->queue);
+	free(adc_pool->stamps);
+	free(adc_pool->samples_counts);
+	adc_pool->samples = NULL;
+	adc_pool->references = NULL;
+	adc_pool->free_stack = NULL;
+	adc_pool->queue = NULL;
+	adc_pool->stamps = NULL;
+	adc_pool->samples_counts = NULL;
+	adc_pool->buffer_samples = 0;
+}
+
+ATTR_INTERN struct adc_pool *adc_pool_create(void)
+{
+	struct adc_pool *adc_pool = calloc(1, sizeof(struct adc_pool));
+	adc_pool->depth = PLC_ADC_POOL_DEPTH_DEFAULT;
+	int ret = pthread_mutex_init(&adc_pool->mutex, NULL);
+	assert(ret == 0);
+	ret = pthread_cond_init(&adc_pool->buffer_queued, NULL);
+	assert(ret == 0);
+	ret = pthread_cond_init(&adc_pool->buffer_freed, NULL);
+	assert(ret == 0);
+	return adc_pool;
+}
+
+ATTR_INTERN void adc_pool_release(struct adc_pool *adc_pool)
+{
+	assert(!adc_pool->started);
+	adc_pool_free_buffers(adc_pool);
+	int ret = pthread_cond_destroy(&adc_pool->buffer_freed);
+	assert(ret == 0);
+	ret = pthread_cond_destroy(&adc_pool->buffer_queued);
+	assert(ret == 0);
+	ret = pthread_mutex_destroy(&adc_pool->mutex);
+	assert(ret == 0);
+	free(adc_pool);
+}
+
+ATTR_INTERN void adc_pool_set_depth(struct adc_pool *adc_pool, uint32_t buffers)
+{
+	assert(!adc_pool->started);
+	if (buffers < ADC_POOL_DEPTH_MIN)
+		buffers = ADC_POOL_DEPTH_MIN;
+	if (buffers != adc_pool->depth)
+	{
+		adc_pool_free_buffers(adc_pool);
+		adc_pool->depth = buffers;
+	}
+}
+
+ATTR_INTERN void adc_pool_set_callback(struct adc_pool *adc_pool,
+		rx_buffer_completed_callback_t rx_buffer_completed_callback,
+		void *rx_buffer_completed_callback_data)
+{
+	adc_pool->rx_buffer_completed_callback = rx_buffer_completed_callback;
+	adc_pool->rx_buffer_completed_callback_data = rx_buffer_completed_callback_data;
+}
+
+static uint32_t adc_pool_get_index(struct adc_pool *adc_pool, const sample_rx_t *buffer)
+{
+	uint32_t index = (buffer - adc_pool->samples) / adc_pool->buffer_samples;
+	assert((index < adc_pool->depth)
+			&& (buffer == adc_pool->samples + index * adc_pool->buffer_samples));
+	return index;
+}
+
+// PRECONDITION: 'mutex' locked
+static void adc_pool_unreference(struct adc_pool *adc_pool, uint32_t index)
+{
+	assert(adc_pool->references[index] > 0);
+	if (--adc_pool->references[index] == 0)
+	{
+		adc_pool->free_stack[adc_pool->free_count++] = index;
+		pthread_cond_signal(&adc_pool->buffer_freed);
+	}
+}
+
+static void *adc_pool_thread_consumer(void *arg)
+{
+	struct adc_pool *adc_pool = (struct adc_pool *) arg;
+	pthread_mutex_lock(&adc_pool->mutex);
+	while (1)
+	{
+		while (!adc_pool->end_thread && (adc_pool->queue_count == 0))
+		{
+			// Reported once all the buffers of the source have been delivered
+			if (adc_pool->end_of_capture_queued)
+				adc_pool->statistics.end_of_capture = 1;
+			pthread_cond_wait(&adc_pool->buffer_queued, &adc_pool->mutex);
+		}
+		if (adc_pool->queue_count == 0)
+			break;
+		uint32_t index = adc_pool->queue[adc_pool->queue_head];
+		if (++adc_pool->queue_head == adc_pool->depth)
+			adc_pool->queue_head = 0;
+		adc_pool->queue_count--;
+		struct plc_buffer_stamp stamp = adc_pool->stamps[index];
+		uint32_t samples_count = adc_pool->samples_counts[index];
+		pthread_mutex_unlock(&adc_pool->mutex);
+		// The callback may extend the life of the buffer with 'plc_adc_retain_buffer'
+		if (adc_pool->rx_buffer_completed_callback)
+			adc_pool->rx_buffer_completed_callback(adc_pool->rx_buffer_completed_callback_data,
+					adc_pool->samples + index * adc_pool->buffer_samples, samples_count, &stamp);
+		pthread_mutex_lock(&adc_pool->mutex);
+		adc_pool_unreference(adc_pool, index);
+	}
+	pthread_mutex_unlock(&adc_pool->mutex);
+	return NULL;
+}
+
+ATTR_INTERN void adc_pool_start(struct adc_pool *adc_pool, uint32_t buffer_samples)
+{
+	assert(!adc_pool->started);
+	uint32_t n;
+	if (buffer_samples != adc_pool->buffer_samples)
+	{
+		adc_pool_free_buffers(adc_pool);
+		adc_pool->buffer_samples = buffer_samples;
+		adc_pool->samples = malloc((adc_pool->depth + 1) * buffer_samples * sizeof(sample_rx_t));
+		adc_pool->references = calloc(adc_pool->depth, sizeof(uint32_t));
+		adc_pool->free_stack = malloc(adc_pool->depth * sizeof(uint32_t));
+		adc_pool->queue = malloc(adc_pool->depth * sizeof(uint32_t));
+		adc_pool->stamps = malloc(adc_pool->depth * sizeof(struct plc_buffer_stamp));
+		adc_pool->samples_counts = malloc(adc_pool->depth * sizeof(uint32_t));
+	}
+	// The buffers retained on a previous capture must be released before starting a new one
+	for (n = 0; n < adc_pool->depth; n++)
+		assert(adc_pool->references[n] == 0);
+	adc_pool->free_count = adc_pool->depth;
+	for (n = 0; n < adc_pool->depth; n++)
+		adc_pool->free_stack[n] = adc_pool->depth - 1 - n;
+	adc_pool->queue_head = 0;
+	adc_pool->queue_count = 0;
+	adc_pool->sequence = 0;
+	memset(&adc_pool->statistics, 0, sizeof(adc_pool->statistics));
+	adc_pool->statistics.pool_depth = adc_pool->depth;
+	adc_pool->end_thread = 0;
+	adc_pool->end_of_capture_queued = 0;
+	int ret = pthread_create(&adc_pool->thread, NULL, adc_pool_thread_consumer, adc_pool);
+	assert(ret == 0);
+	adc_pool->started = 1;
+}
+
+ATTR_INTERN void adc_pool_stop(struct adc_pool *adc_pool)
+{
+	assert(adc_pool->started);
+	pthread_mutex_lock(&adc_pool->mutex);
+	adc_pool->end_thread = 1;
+	pthread_cond_signal(&adc_pool->buffer_queued);
+	pthread_mutex_unlock(&adc_pool->mutex);
+	int ret = pthread_join(adc_pool->thread, NULL);
+	assert(ret == 0);
+	adc_pool->started = 0;
+}
+
+ATTR_INTERN sample_rx_t *adc_pool_get_free_buffer(struct adc_pool *adc_pool, int wait)
+{
+	sample_rx_t *buffer;
+	pthread_mutex_lock(&adc_pool->mutex);
+	if (wait)
+		while (adc_pool->free_count == 0)
+			pthread_cond_wait(&adc_pool->buffer_freed, &adc_pool->mutex);
+	if (adc_pool->free_count > 0)
+	{
+		uint32_t index = adc_pool->free_stack[--adc_pool->free_count];
+		adc_pool->references[index] = 1;
+		uint32_t buffers_in_use = adc_pool->depth - adc_pool->free_count;
+		if (buffers_in_use > adc_pool->statistics.buffers_in_use_high_water)
+			adc_pool->statistics.buffers_in_use_high_water = buffers_in_use;
+		buffer = adc_pool->samples + index * adc_pool->buffer_samples;
+	}
+	else
+	{
+		buffer = adc_pool->samples + adc_pool->depth * adc_pool->buffer_samples;
+	}
+	pthread_mutex_unlock(&adc_pool->mutex);
+	return buffer;
+}
+
+ATTR_INTERN void adc_pool_push_buffer(struct adc_pool *adc_pool, sample_rx_t *buffer)
+{
+	adc_pool_push_partial_buffer(adc_pool, buffer, adc_pool->buffer_samples);
+}
+
+ATTR_INTERN void adc_pool_push_partial_buffer(struct adc_pool *adc_pool, sample_rx_t *buffer,
+		uint32_t samples_count)
+{
+	assert(samples_count <= adc_pool->buffer_samples);
+	int64_t timestamp_ns = plc_time_hires_stamp_to_nsec(plc_time_get_hires_stamp());
+	pthread_mutex_lock(&adc_pool->mutex);
+	uint32_t sequence = adc_pool->sequence++;
+	adc_pool->statistics.buffers_captured++;
+	if (buffer == adc_pool->samples + adc_pool->depth * adc_pool->buffer_samples)
+	{
+		adc_pool->statistics.buffers_overflowed++;
+	}
+	else
+	{
+		// The queue can't overflow: it has room for all the buffers
+		uint32_t queue_tail = adc_pool->queue_head + adc_pool->queue_count;
+		if (queue_tail >= adc_pool->depth)
+			queue_tail -= adc_pool->depth;
+		uint32_t index = adc_pool_get_index(adc_pool, buffer);
+		adc_pool->queue[queue_tail] = index;
+		adc_pool->stamps[index].sequence = sequence;
+		adc_pool->stamps[index].timestamp_ns = timestamp_ns;
+		adc_pool->samples_counts[index] = samples_count;
+		if (++adc_pool->queue_count > adc_pool->statistics.queue_high_water)
+			adc_pool->statistics.queue_high_water = adc_pool->queue_count;
+		pthread_cond_signal(&adc_pool->buffer_queued);
+	}
+	pthread_mutex_unlock(&adc_pool->mutex);
+}
+
+ATTR_INTERN void adc_pool_end_capture(struct adc_pool *adc_pool)
+{
+	pthread_mutex_lock(&adc_pool->mutex);
+	adc_pool->end_of_capture_queued = 1;
+	pthread_cond_signal(&adc_pool->buffer_queued);
+	pthread_mutex_unlock(&adc_pool->mutex);
+}
+
+ATTR_INTERN void adc_pool_skip_sequence(struct adc_pool *adc_pool)
+{
+	pthread_mutex_lock(&adc_pool->mutex);
+	adc_pool->sequence++;
+	pthread_mutex_unlock(&adc_pool->mutex);
+}
+
+ATTR_INTERN void adc_pool_discard_buffer(struct adc_pool *adc_pool, sample_rx_t *buffer)
+{
+	adc_pool_skip_sequence(adc_pool);
+	if (buffer != adc_pool->samples + adc_pool->depth * adc_pool->buffer_samples)
+		adc_pool_release_buffer(adc_pool, buffer);
+}
+
+ATTR_INTERN void adc_pool_retain_buffer(struct adc_pool *adc_pool, const sample_rx_t *buffer)
+{
+	uint32_t index = adc_pool_get_index(adc_pool, buffer);
+	pthread_mutex_lock(&adc_pool->mutex);
+	assert(adc_pool->references[index] > 0);
+	adc_pool->references[index]++;
+	pthread_mutex_unlock(&adc_pool->mutex);
+}
+
+ATTR_INTERN void adc_pool_release_buffer(struct adc_pool *adc_pool, const sample_rx_t *buffer)
+{
+	uint32_t index = adc_pool_get_index(adc_pool, buffer);
+	pthread_mutex_lock(&adc_pool->mutex);
+	adc_pool_unreference(adc_pool, index);
+	pthread_mutex_unlock(&adc_pool->mutex);
+}
+
+ATTR_INTERN void adc_pool_get_statistics(struct adc_pool *adc_pool,
+		struct plc_adc_statistics *statistics)
+{
+	pthread_mutex_lock(&adc_pool->mutex);
+	*statistics = adc_pool->statistics;
+	statistics->buffers_queued = adc_pool->queue_count;
+	pthread_mutex_unlock(&adc_pool->mutex);
+}
@@ -0,0 +1,53 @@
+/**
+ * @file
+ * @brief	Pool of capture buffers handed-off to a consumer thread (internal)
+ *
+ * @cond COPYRIGHT_NOTES @copyright
+ *	Copyright (C) 2017 Jose Maria Ortega\n
+ *	Distributed under the GNU GPLv3. For full terms see the file LICENSE
+ * @endcond
+ */
+
+#ifndef ADC_POOL_H
+#define ADC_POOL_H
+
+#include "api/adc.h"
+
+struct adc_pool;
+
+struct adc_pool *adc_pool_create(void);
+void adc_pool_release(struct adc_pool *adc_pool);
+// PRECONDITION: pool stopped
+void adc_pool_set_depth(struct adc_pool *adc_pool, uint32_t buffers);
+void adc_pool_set_callback(struct adc_pool *adc_pool,
+		rx_buffer_completed_callback_t rx_buffer_completed_callback,
+		void *rx_buffer_completed_callback_data);
+// Called by the capturing devices once the buffer size is known. Starts the consumer thread
+void adc_pool_start(struct adc_pool *adc_pool, uint32_t buffer_samples);
+// Called by the capturing devices once the producer has stopped. The buffers already queued are
+// delivered before terminating the consumer thread
+void adc_pool_stop(struct adc_pool *adc_pool);
+// Gets a buffer to be filled by the producer. When no one is available it waits for the consumer
+// to release one if 'wait' is set (for sources that can be throttled, as files); otherwise a
+// scratch buffer is returned whose content is discarded at 'adc_pool_push_buffer' (overflow)
+sample_rx_t *adc_pool_get_free_buffer(struct adc_pool *adc_pool, int wait);
+// Queues a filled buffer to be delivered by the consumer thread. It is stamped with the next
+// sequence number and the current time
+void adc_pool_push_buffer(struct adc_pool *adc_pool, sample_rx_t *buffer);
+// Same as 'adc_pool_push_buffer' for a buffer with only 'samples_count' samples (the tail of a
+// finite source)
+void adc_pool_push_partial_buffer(struct adc_pool *adc_pool, sample_rx_t *buffer,
+		uint32_t samples_count);
+// Called by the finite sources (replay) after the last buffer. 'end_of_capture' is reported in
+// the statistics once the consumer has delivered all the queued buffers
+void adc_pool_end_capture(struct adc_pool *adc_pool);
+// Returns a buffer got with 'adc_pool_get_free_buffer' without delivering it. Its sequence number
+// is skipped
+void adc_pool_discard_buffer(struct adc_pool *adc_pool, sample_rx_t *buffer);
+// Skips a sequence number to reveal a discontinuity (samples lost by the device)
+void adc_pool_skip_sequence(struct adc_pool *adc_pool);
+void adc_pool_retain_buffer(struct adc_pool *adc_pool, const sample_rx_t *buffer);
+void adc_pool_release_buffer(struct adc_pool *adc_pool, const sample_rx_t *buffer);
+void adc_pool_get_statistics(struct adc_pool *adc_pool, struct plc_adc_statistics *statistics);
+
+#endif /* ADC_POOL_H */
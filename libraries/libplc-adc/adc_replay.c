@@ -0,0 +1,317 @@
+/**
+ * @file
+ *
+ * @cond COPYRIGHT_NOTES @copyright
+ *	Copyright (C) 2017 Jose Maria Ortega\n
+ *	Distributed under the GNU GPLv3. For full terms see the file LICENSE
+ * @endcond
+ */
+
+#define _GNU_SOURCE		// Required for proper declaration of 'pthread_timedjoin_np'
+#include <err.h>		// warnx
+#include <pthread.h>
+#include <strings.h>	// strcasecmp
+#include <time.h>		// clock_nanosleep
+
+#include "+common/api/+base.h"
+#include "libraries/libplc-tools/api/capture.h"
+#define PLC_ADC_HANDLE_EXPLICIT_DEF
+typedef struct plc_adc *plc_adc_h;
+#include "adc.h"
+
+#define CAPTURE_VECTOR_GRANULARITY 65536
+#define NSECS_PER_SEC 1000000000LL
+
+struct plc_adc
+{
+	// Samples of the whole capture file
+	sample_rx_t *samples;
+	uint32_t samples_count;
+	uint32_t samples_delivered;
+	// Sampling rate stored in the file (0 if the format doesn't specify it)
+	float file_sampling_rate_sps;
+	float freq_capture_sps;
+	int paced;
+	struct adc_pool *adc_pool;
+	uint32_t buffer_len;
+	pthread_t thread;
+	volatile int end_thread;
+	int capture_started;
+};
+
+static uint16_t get_le_u16(const uint8_t *data)
+{
+	return data[0] | (data[1] << 8);
+}
+
+static uint32_t get_le_u32(const uint8_t *data)
+{
+	return data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t) data[3] << 24);
+}
+
+static uint8_t *replay_read_file(const char *filename, uint32_t *file_size)
+{
+	FILE *file = fopen(filename, "rb");
+	if (file == NULL)
+		return NULL;
+	uint8_t *data = NULL;
+	if ((fseek(file, 0, SEEK_END) == 0) && (ftell(file) >= 0))
+	{
+		long size = ftell(file);
+		rewind(file);
+		data = malloc(size + 1);
+		if (fread(data, 1, size, file) == (size_t) size)
+		{
+			// Null-terminated for the text parser
+			data[size] = '\0';
+			*file_size = size;
+		}
+		else
+		{
+			free(data);
+			data = NULL;
+		}
+	}
+	fclose(file);
+	return data;
+}
+
+// Accepts the CSV files generated by 'plc-cape-lab' (one sample per line) and, in general, any
+// list of samples separated by spaces, commas, semicolons or new lines
+static int replay_load_text(struct plc_adc *plc_adc, const char *text)
+{
+	uint32_t capacity = 0;
+	for (;;)
+	{
+		char *token_end;
+		while ((*text == ' ') || (*text == '\t') || (*text == ',') || (*text == ';')
+				|| (*text == '\r') || (*text == '\n'))
+			text++;
+		unsigned long value = strtoul(text, &token_end, 10);
+		if (token_end == text)
+			break;
+		if (plc_adc->samples_count == capacity)
+		{
+			capacity += CAPTURE_VECTOR_GRANULARITY;
+			plc_adc->samples = realloc(plc_adc->samples, capacity * sizeof(sample_rx_t));
+		}
+		plc_adc->samples[plc_adc->samples_count++] = value;
+		text = token_end;
+	}
+	return (*text == '\0') ? 0 : -1;
+}
+
+// Only PCM 16-bits supported. On multi-channel files the first channel is taken. The signed
+// samples are converted to the ADC range as done by the ALSA capturing device
+static int replay_load_wav(struct plc_adc *plc_adc, const uint8_t *data, uint32_t data_size)
+{
+	if ((data_size < 12) || (memcmp(data, "RIFF", 4) != 0) || (memcmp(data + 8, "WAVE", 4) != 0))
+		return -1;
+	uint32_t channels = 0;
+	const uint8_t *chunk = data + 12;
+	const uint8_t *data_end = data + data_size;
+	while (chunk + 8 <= data_end)
+	{
+		uint32_t chunk_size = get_le_u32(chunk + 4);
+		const uint8_t *chunk_data = chunk + 8;
+		if (chunk_size > data_end - chunk_data)
+			chunk_size = data_end - chunk_data;
+		if (memcmp(chunk, "fmt ", 4) == 0)
+		{
+			if ((chunk_size < 16) || (get_le_u16(chunk_data) != 1)
+					|| (get_le_u16(chunk_data + 14) != 16))
+				return -1;
+			channels = get_le_u16(chunk_data + 2);
+			plc_adc->file_sampling_rate_sps = get_le_u32(chunk_data + 4);
+		}
+		else if (memcmp(chunk, "data", 4) == 0)
+		{
+			if (channels == 0)
+				return -1;
+			uint32_t frame_size = channels * sizeof(int16_t);
+			uint32_t n;
+			plc_adc->samples_count = chunk_size / frame_size;
+			plc_adc->samples = malloc(plc_adc->samples_count * sizeof(sample_rx_t));
+			for (n = 0; n < plc_adc->samples_count; n++, chunk_data += frame_size)
+				plc_adc->samples[n] = ((uint16_t) ((int16_t) get_le_u16(chunk_data) + 0x8000))
+						>> (16 - ADC_BITS);
+			return 0;
+		}
+		// Chunks are word-aligned
+		chunk = chunk_data + chunk_size + (chunk_size & 1);
+	}
+	return -1;
+}
+
+// Raw captures are a plain dump of 'sample_rx_t' items in native byte order
+static int replay_load_raw(struct plc_adc *plc_adc, const uint8_t *data, uint32_t data_size)
+{
+	plc_adc->samples_count = data_size / sizeof(sample_rx_t);
+	plc_adc->samples = malloc(plc_adc->samples_count * sizeof(sample_rx_t));
+	memcpy(plc_adc->samples, data, plc_adc->samples_count * sizeof(sample_rx_t));
+	return 0;
+}
+
+// Binary capture files written by 'plc_capture_writer'
+static int replay_load_capture(struct plc_adc *plc_adc, const char *filename)
+{
+	struct plc_capture_reader *plc_capture_reader = plc_capture_reader_open(filename);
+	if (plc_capture_reader == NULL)
+		return -1;
+	const struct plc_capture_info *info = plc_capture_reader_get_info(plc_capture_reader);
+	int ret = 0;
+	if (info->samples_count <= UINT32_MAX)
+	{
+		plc_adc->file_sampling_rate_sps = info->sampling_rate_sps;
+		plc_adc->samples_count = info->samples_count;
+		plc_adc->samples = malloc(plc_adc->samples_count * sizeof(sample_rx_t));
+		plc_capture_reader_read_samples(plc_capture_reader, 0, plc_adc->samples,
+				plc_adc->samples_count);
+	}
+	else
+	{
+		ret = -1;
+	}
+	plc_capture_reader_close(plc_capture_reader);
+	return ret;
+}
+
+static float adc_get_sampling_frequency(struct plc_adc *plc_adc)
+{
+	return (plc_adc->file_sampling_rate_sps > 0.0f) ?
+			plc_adc->file_sampling_rate_sps : plc_adc->freq_capture_sps;
+}
+
+static uint16_t adc_read_sample(struct plc_adc *plc_adc)
+{
+	return (plc_adc->samples_delivered < plc_adc->samples_count) ?
+			plc_adc->samples[plc_adc->samples_delivered] : 0;
+}
+
+static void timespec_add_nsec(struct timespec *stamp, int64_t nsec)
+{
+	nsec += stamp->tv_nsec;
+	stamp->tv_sec += nsec / NSECS_PER_SEC;
+	stamp->tv_nsec = nsec % NSECS_PER_SEC;
+}
+
+// Delivers the capture in 'buffer_len' blocks. On paced mode each block is delivered at the time
+// it would have been completed by a real device capturing at the sampling rate. A trailing
+// incomplete block is delivered with its actual samples count. Then the end of the capture is
+// reported and the thread ends without waiting for 'adc_stop_capture'
+static void *adc_thread_capture_samples(void *arg)
+{
+	struct plc_adc *plc_adc = (struct plc_adc *) arg;
+	float sampling_rate_sps = adc_get_sampling_frequency(plc_adc);
+	int paced = plc_adc->paced && (sampling_rate_sps > 0.0f);
+	// Rounded without 'llround' to keep the library free of 'libm'
+	int64_t buffer_nsec =
+			paced ? (int64_t) (plc_adc->buffer_len * 1e9 / sampling_rate_sps + 0.5) : 0;
+	struct timespec deadline;
+	clock_gettime(CLOCK_MONOTONIC, &deadline);
+	while (!plc_adc->end_thread && (plc_adc->samples_delivered < plc_adc->samples_count))
+	{
+		uint32_t samples_count = plc_adc->samples_count - plc_adc->samples_delivered;
+		if (samples_count > plc_adc->buffer_len)
+			samples_count = plc_adc->buffer_len;
+		if (paced)
+		{
+			timespec_add_nsec(&deadline, buffer_nsec * samples_count / plc_adc->buffer_len);
+			clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL);
+		}
+		// Throttled by the consumer: no buffer is lost even on unpaced mode
+		sample_rx_t *buffer = adc_pool_get_free_buffer(plc_adc->adc_pool, 1);
+		// Copy to keep the capture unaltered if the callback modifies the buffer in-place
+		memcpy(buffer, plc_adc->samples + plc_adc->samples_delivered,
+				samples_count * sizeof(sample_rx_t));
+		plc_adc->samples_delivered += samples_count;
+		adc_pool_push_partial_buffer(plc_adc->adc_pool, buffer, samples_count);
+	}
+	if (!plc_adc->end_thread)
+		adc_pool_end_capture(plc_adc->adc_pool);
+	return NULL;
+}
+
+static int adc_start_capture(struct plc_adc *plc_adc, struct adc_pool *adc_pool,
+		uint32_t buffer_samples, int kernel_buffering, float freq_capture_sps)
+{
+	assert(!plc_adc->capture_started);
+	plc_adc->freq_capture_sps = freq_capture_sps;
+	plc_adc->adc_pool = adc_pool;
+	plc_adc->buffer_len = buffer_samples;
+	adc_pool_start(adc_pool, buffer_samples);
+	plc_adc->samples_delivered = 0;
+	plc_adc->capture_started = 1;
+	plc_adc->end_thread = 0;
+	int ret = pthread_create(&plc_adc->thread, NULL, adc_thread_capture_samples, plc_adc);
+	assert(ret == 0);
+	return 0;
+}
+
+static void adc_stop_capture(struct plc_adc *plc_adc)
+{
+	int ret;
+	assert(plc_adc->capture_started);
+	plc_adc->end_thread = 1;
+	struct timespec timeout;
+	ret = clock_gettime(CLOCK_REALTIME, &timeout);
+	assert(ret == 0);
+	timeout.tv_sec += THREAD_TIMEOUT_SECONDS;
+	ret = pthread_timedjoin_np(plc_adc->thread, NULL, &timeout);
+	assert(ret == 0);
+	adc_pool_stop(plc_adc->adc_pool);
+	plc_adc->capture_started = 0;
+}
+
+static void adc_release(struct plc_adc *plc_adc)
+{
+	if (plc_adc->capture_started)
+		adc_stop_capture(plc_adc);
+	free(plc_adc->samples);
+	free(plc_adc);
+}
+
+ATTR_INTERN struct plc_adc *plc_adc_replay_create(struct plc_adc_api *api, const char *filename,
+		int paced)
+{
+	const char *extension = strrchr(filename, '.');
+	struct plc_adc *plc_adc;
+	int ret;
+	if (extension && (strcasecmp(extension, PLC_CAPTURE_EXTENSION) == 0))
+	{
+		plc_adc = calloc(1, sizeof(struct plc_adc));
+		ret = replay_load_capture(plc_adc, filename);
+	}
+	else
+	{
+		uint32_t data_size = 0;
+		uint8_t *data = replay_read_file(filename, &data_size);
+		if (data == NULL)
+		{
+			warnx("Unable to read the capture file '%s'", filename);
+			return NULL;
+		}
+		plc_adc = calloc(1, sizeof(struct plc_adc));
+		if (extension && (strcasecmp(extension, ".wav") == 0))
+			ret = replay_load_wav(plc_adc, data, data_size);
+		else if (extension && ((strcasecmp(extension, ".csv") == 0)
+				|| (strcasecmp(extension, ".txt") == 0)))
+			ret = replay_load_text(plc_adc, (const char *) data);
+		else
+			ret = replay_load_raw(plc_adc, data, data_size);
+		free(data);
+	}
+	if (ret < 0)
+	{
+		warnx("Invalid or unsupported format of the capture file '%s'", filename);
+		adc_release(plc_adc);
+		return NULL;
+	}
+	api->release = adc_release;
+	api->get_sampling_frequency = adc_get_sampling_frequency;
+	api->read_sample = adc_read_sample;
+	api->start_capture = adc_start_capture;
+	api->stop_capture = adc_stop_capture;
+	plc_adc->paced = paced;
+	return plc_adc;
+}
@@ -7,6 +7,7 @@
  * @endcond
  */
 
+#include <math.h>		// sqrt
 #include "+common/api/+base.h"
 #include "api/analysis.h"
 #include "libraries/libplc-tools/api/time.h"
@@ -19,6 +20,25 @@ struct plc_rx_analysis
 	float rx_samples_per_bit;
 	sample_rx_t data_offset;
 	sample_rx_t data_hi_threshold_detection;
+	// Rounded DC mean of the previous buffer. Pivot for the single-pass mean absolute deviation
+	sample_rx_t ac_pivot;
+};
+
+// Accumulators of the single-pass analysis of a buffer
+struct rx_buffer_values
+{
+	sample_rx_t min;
+	sample_rx_t max;
+	uint32_t sum;
+	uint64_t sum2;
+	// Samples strictly above and below the pivot, and their sums
+	uint32_t pivot_hi_count;
+	uint32_t pivot_hi_sum;
+	uint32_t pivot_lo_count;
+	uint32_t pivot_lo_sum;
+	// Samples over the detection threshold and crossings of it
+	uint32_t hi_samples;
+	uint32_t crossings;
 };
 
 ATTR_EXTERN struct plc_rx_analysis *plc_rx_analysis_create(void)
@@ -45,6 +65,7 @@ ATTR_EXTERN void plc_rx_analysis_reset(struct plc_rx_analysis *plc_rx_analysis)
 {
 	memset(&plc_rx_analysis->rx_statistics, 0, sizeof(struct rx_statistics));
 	plc_rx_analysis->rx_stamp_cycle = plc_time_get_hires_stamp();
+	plc_rx_analysis->ac_pivot = plc_rx_analysis->data_offset;
 }
 
 ATTR_INTERN void plc_rx_analysis_set_statistics_mode(struct plc_rx_analysis *plc_rx_analysis, 
@@ -80,20 +101,90 @@ ATTR_EXTERN const struct rx_statistics *plc_rx_analysis_get_statistics(
 	return &plc_rx_analysis->rx_statistics;
 }
 
+// Single pass over the buffer. The loop is branchless (conditional increments and selects only)
+// and without loop-carried dependencies other than the reductions, so the compiler can vectorize it
+// (SSE2 on x86, NEON on the BeagleBone). The threshold crossings compare each sample with the
+// previous one, loaded again instead of carried in a variable for the same reason
+static void rx_analysis_get_values(const sample_rx_t *buffer, uint32_t buffer_samples,
+		sample_rx_t threshold, sample_rx_t pivot, struct rx_buffer_values *values)
+{
+	// 32-bit locals, also for the parameters: mixing 16 and 32-bit types in the loop prevents the
+	// vectorization
+	uint32_t threshold32 = threshold;
+	uint32_t pivot32 = pivot;
+	// The first sample initializes the reductions
+	uint32_t sample = buffer[0];
+	uint32_t min = sample;
+	uint32_t max = sample;
+	uint32_t sum = sample;
+	uint64_t sum2 = sample * sample;
+	uint32_t pivot_hi_count = (sample > pivot32);
+	uint32_t pivot_hi_sum = (sample > pivot32) ? sample : 0;
+	uint32_t pivot_lo_count = (sample < pivot32);
+	uint32_t pivot_lo_sum = (sample < pivot32) ? sample : 0;
+	uint32_t hi_samples = (sample > threshold32);
+	uint32_t crossings = 0;
+	uint32_t n;
+	for (n = 1; n < buffer_samples; n++)
+	{
+		sample = buffer[n];
+		uint32_t previous = buffer[n - 1];
+		min = (sample < min) ? sample : min;
+		max = (sample > max) ? sample : max;
+		sum += sample;
+		sum2 += sample * sample;
+		pivot_hi_count += (sample > pivot32);
+		pivot_hi_sum += (sample > pivot32) ? sample : 0;
+		pivot_lo_count += (sample < pivot32);
+		pivot_lo_sum += (sample < pivot32) ? sample : 0;
+		hi_samples += (sample > threshold32);
+		crossings += ((sample > threshold32) != (previous > threshold32));
+	}
+	values->min = min;
+	values->max = max;
+	values->sum = sum;
+	values->sum2 = sum2;
+	values->pivot_hi_count = pivot_hi_count;
+	values->pivot_hi_sum = pivot_hi_sum;
+	values->pivot_lo_count = pivot_lo_count;
+	values->pivot_lo_sum = pivot_lo_sum;
+	values->hi_samples = hi_samples;
+	values->crossings = crossings;
+}
+
+static uint32_t rx_analysis_get_hi_samples(const sample_rx_t *buffer, uint32_t buffer_samples,
+		sample_rx_t threshold)
+{
+	uint32_t hi_samples = 0;
+	uint32_t n;
+	for (n = 0; n < buffer_samples; n++)
+		hi_samples += (buffer[n] > threshold);
+	return hi_samples;
+}
+
+// Mean absolute deviation around 'dc_mean' from the partition around the pivot, without a second
+// pass. It is exact while 'dc_mean' is within 1 LSB of the pivot: then the samples above (below)
+// the pivot are also above (below) the mean and the samples equal to the pivot contribute
+// '|pivot - dc_mean|' each. Otherwise (e.g. a sudden DC change) the samples between the pivot and
+// the mean are added with the wrong sign, which only lasts one buffer as the pivot follows the mean
+static float rx_analysis_get_ac_mean(uint32_t buffer_samples,
+		const struct rx_buffer_values *values, sample_rx_t pivot, double dc_mean)
+{
+	uint32_t pivot_eq_count = buffer_samples - values->pivot_hi_count - values->pivot_lo_count;
+	double ac_sum = (values->pivot_hi_sum - values->pivot_hi_count * dc_mean)
+			+ (values->pivot_lo_count * dc_mean - values->pivot_lo_sum)
+			+ pivot_eq_count * fabs(pivot - dc_mean);
+	return ac_sum / buffer_samples;
+}
+
 // TODO: Improvements: For performance reasons allow to configure on-the-fly the type of statistics
 //	to analyze
 ATTR_EXTERN int plc_rx_analysis_analyze_buffer(struct plc_rx_analysis *plc_rx_analysis, 
 	sample_rx_t *buffer, uint32_t buffer_samples)
 {
-	int i;
 	struct rx_statistics *rx_stat = &plc_rx_analysis->rx_statistics;
 	rx_stat->buffers_handled++;
-	// Analyze the samples for valid data detection
-	sample_rx_t *buffer_cur = buffer;
-	sample_rx_t min = *buffer_cur;
-	sample_rx_t max = *buffer_cur;
-	uint32_t accum = 0;
-	// To use 'uint32_t' safely for 'accum' check that 'buffer_samples' within the limits
+	// To use 'uint32_t' safely for the sums check that 'buffer_samples' within the limits
 	assert(buffer_samples <= 0xFFFF);
 	// TODO: Make 'HI_THRESHOLD_DETECTION' this automatic or configurable? Improve the filter
 	//	anti-glitches
@@ -102,24 +193,18 @@ ATTR_EXTERN int plc_rx_analysis_analyze_buffer(struct plc_rx_analysis *plc_rx_an
 		samples_hi_threshold_detection = buffer_samples / 4;
 	sample_rx_t samples_hi_threshold = plc_rx_analysis->data_offset +
 			plc_rx_analysis->data_hi_threshold_detection;
-	int hi_samples = 0;
-	int data_detected = 0;
-	for (i = buffer_samples; i > 0; i--, buffer_cur++)
-	{
-		if (*buffer_cur < min)
-			min = *buffer_cur;
-		if (*buffer_cur > max)
-			max = *buffer_cur;
-		accum += *buffer_cur;
-		if (*buffer_cur > samples_hi_threshold)
-		{
-			if (++hi_samples == samples_hi_threshold_detection)
-			{
-				// TODO: Improve 'data_detected' strategy
-				data_detected = 1;
-			}
-		}
-	}
+	// The full set of values is only required on 'plc_rx_statistics_values'. Otherwise only the
+	// samples over the threshold for the data detection
+	struct rx_buffer_values values;
+	if (plc_rx_analysis->statistics_mode == plc_rx_statistics_values)
+		rx_analysis_get_values(buffer, buffer_samples, samples_hi_threshold,
+				plc_rx_analysis->ac_pivot, &values);
+	else
+		values.hi_samples = rx_analysis_get_hi_samples(buffer, buffer_samples,
+				samples_hi_threshold);
+	// TODO: Improve 'data_detected' strategy
+	int data_detected = (samples_hi_threshold_detection > 0)
+			&& (values.hi_samples >= samples_hi_threshold_detection);
 	// Calculate time between calls. If not buffers missing it will give the time-per-buffer
 	switch(plc_rx_analysis->statistics_mode)
 	{
@@ -148,17 +233,17 @@ ATTR_EXTERN int plc_rx_analysis_analyze_buffer(struct plc_rx_analysis *plc_rx_an
 	}
 	case plc_rx_statistics_values:
 	{
-		plc_rx_analysis->rx_statistics.buffer_min = min;
-		// plc_rx_analysis->rx_statistics.buffer_max = max;
-		plc_rx_analysis->rx_statistics.buffer_max = max++;
-		float dc_mean = (float) accum / buffer_samples;
-		float ac_mean = 0.0;
-		buffer_cur = buffer;
-		for (i = buffer_samples; i > 0; i--)
-			ac_mean += abs((float) (*buffer_cur++) - dc_mean);
-		ac_mean /= buffer_samples;
-		plc_rx_analysis->rx_statistics.buffer_dc_mean = dc_mean;
-		plc_rx_analysis->rx_statistics.buffer_ac_mean = ac_mean;
+		double dc_mean = (double) values.sum / buffer_samples;
+		double ac_variance = (double) values.sum2 / buffer_samples - dc_mean * dc_mean;
+		rx_stat->buffer_min = values.min;
+		rx_stat->buffer_max = values.max;
+		rx_stat->buffer_dc_mean = dc_mean;
+		rx_stat->buffer_ac_mean = rx_analysis_get_ac_mean(buffer_samples, &values,
+				plc_rx_analysis->ac_pivot, dc_mean);
+		rx_stat->buffer_ac_rms = (ac_variance > 0.0) ? sqrt(ac_variance) : 0.0;
+		rx_stat->buffer_hi_samples = values.hi_samples;
+		rx_stat->buffer_crossings = values.crossings;
+		plc_rx_analysis->ac_pivot = lround(dc_mean);
 		break;
 	}
 	default:
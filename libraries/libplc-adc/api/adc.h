@@ -17,12 +17,37 @@ extern "C" {
 
 #define ADC_BITS 12
 #define ADC_RANGE (1 << ADC_BITS)
+/// Default number of buffers of the capture pool
+#define PLC_ADC_POOL_DEPTH_DEFAULT 4
 
 struct plc_adc;
 struct settings_rx;
 
 typedef void (*rx_buffer_completed_callback_t)(void *data, sample_rx_t *samples_buffer,
-		uint32_t samples_buffer_count);
+		uint32_t samples_buffer_count, const struct plc_buffer_stamp *stamp);
+
+/**
+ * @brief	Statistics of the capture buffers pool
+ */
+struct plc_adc_statistics
+{
+	/// Buffers in the pool
+	uint32_t pool_depth;
+	/// Buffers completed by the capturing device
+	uint32_t buffers_captured;
+	/// Buffers lost because all the buffers of the pool were in use
+	uint32_t buffers_overflowed;
+	/// Buffers currently queued awaiting for the consumer thread
+	uint32_t buffers_queued;
+	/// Maximum number of buffers queued awaiting for the consumer thread
+	uint32_t queue_high_water;
+	/// Maximum number of buffers simultaneously in use (queued, in process or retained)
+	uint32_t buffers_in_use_high_water;
+	/// 1 once a finite source (#plc_rx_device_replay) has delivered all its buffers
+	uint32_t end_of_capture;
+	/// Statistics of the device (only for #plc_rx_device_alsa)
+	struct plc_alsa_statistics alsa;
+};
 
 /**
  * @brief	Creates an object instance
@@ -30,6 +55,25 @@ typedef void (*rx_buffer_completed_callback_t)(void *data, sample_rx_t *samples_
  * @return	A pointer to the created object
  */
 struct plc_adc *plc_adc_create(enum plc_rx_device_enum rx_device);
+/**
+ * @brief	Creates an object instance of the #plc_rx_device_replay type
+ * @param	filename	Capture file to be replayed. The format is selected by the extension:
+ *						'.plccap' for the binary captures of libplc-tools/api/capture.h,
+ *						'.wav' for PCM 16-bits WAV files, '.csv' or '.txt' for text files with
+ *						one sample per line (as written by _plc-cape-lab_) and any other for raw
+ *						files with the 'sample_rx_t' items in native byte order
+ * @param	paced		1 to deliver the buffers at the sampling rate; 0 to deliver them at maximum
+ *						speed
+ * @return	A pointer to the created object; NULL if the file can't be loaded
+ * @details
+ *	The whole file is loaded on creation. The samples are delivered through the callback set with
+ *	#plc_adc_set_rx_buffer_completed_callback as with the real capturing devices. The sampling rate
+ *	is the one stored in the file (binary capture or WAV) or, if not available, the one given to
+ *	#plc_adc_start_capture. The delivery stops at the end of the file: a trailing incomplete
+ *	buffer is delivered with its actual samples count and then _end_of_capture_ is set in the
+ *	statistics (#plc_adc_get_statistics)
+ */
+struct plc_adc *plc_adc_create_replay(const char *filename, int paced);
 /**
  * @brief	Releases an object
  * @param	plc_adc	Pointer to the handler object
@@ -49,13 +93,67 @@ float plc_adc_get_sampling_frequency(struct plc_adc *plc_adc);
  * @param	rx_buffer_completed_callback_data
  *					Optional user data to be sent as the first parameter in the callback
  * @details
- *	The callback is called from a different thread that is initiated in the #plc_adc_start_capture
- *	call. The caller is responsible of the contention mechanisms to access any possible shared
- *	resource
+ *	The callback is called from a consumer thread that is initiated in the #plc_adc_start_capture
+ *	call. The capturing thread hands-off the completed buffers to it through a pool of buffers,
+ *	so the processing time doesn't delay the capture. The caller is responsible of the contention
+ *	mechanisms to access any possible shared resource.\n
+ *	The buffer returns to the pool when the callback returns unless retained with
+ *	#plc_adc_retain_buffer.\n
+ *	The _stamp_ identifies the buffer: its sequence number since the start of the capture (the
+ *	overflowed buffers and the samples lost by the device, as on ALSA overruns, leave gaps) and the
+ *	monotonic time when the capturing device completed it, that is, approximately the time of its
+ *	last sample
  */
 void plc_adc_set_rx_buffer_completed_callback(struct plc_adc *plc_adc,
 		rx_buffer_completed_callback_t rx_buffer_completed_callback,
 		void *rx_buffer_completed_callback_data);
+/**
+ * @brief	Sets the number of buffers of the capture pool
+ * @param	plc_adc	Pointer to the handler object
+ * @param	buffers	Number of buffers (#PLC_ADC_POOL_DEPTH_DEFAULT by default; minimum 2)
+ * @details
+ *	It must be called with the capture stopped. When the consumer can't keep the pace and all the
+ *	buffers are in use, the new captured buffers are lost (counted as overflowed). The replay and
+ *	internal fifo devices wait for a free buffer instead
+ */
+void plc_adc_set_pool_depth(struct plc_adc *plc_adc, uint32_t buffers);
+/**
+ * @brief	Configures the ALSA capturing device
+ * @param	plc_adc			Pointer to the handler object
+ * @param	alsa_settings	Settings to be copied. By default the "default" PCM is used with
+ *							_readi_ access, a period of the buffer length and
+ *							#PLC_ALSA_PERIODS_DEFAULT periods
+ * @details
+ *	It must be called with the capture stopped. Ignored by the other devices. With _mmap_ the
+ *	samples are converted directly from the ring buffer of the device. The periods are independent
+ *	of the buffers delivered to the callback, which are filled with as many transfers as required.
+ *	On overruns the device is recovered and the buffer in progress is discarded
+ */
+void plc_adc_set_alsa_settings(struct plc_adc *plc_adc,
+		const struct plc_alsa_settings *alsa_settings);
+/**
+ * @brief	Retains a buffer received in the callback beyond its return
+ * @param	plc_adc			Pointer to the handler object
+ * @param	samples_buffer	Buffer received in the callback
+ * @details
+ *	Each call must be balanced with a #plc_adc_release_buffer call. It allows processing the
+ *	buffer in other threads without copying it. The retained buffers are not available for the
+ *	capture so they must be released before all the pool is exhausted. All of them must be
+ *	released before the next #plc_adc_start_capture
+ */
+void plc_adc_retain_buffer(struct plc_adc *plc_adc, const sample_rx_t *samples_buffer);
+/**
+ * @brief	Releases a buffer retained with #plc_adc_retain_buffer
+ * @param	plc_adc			Pointer to the handler object
+ * @param	samples_buffer	Buffer retained
+ */
+void plc_adc_release_buffer(struct plc_adc *plc_adc, const sample_rx_t *samples_buffer);
+/**
+ * @brief	Gets the statistics of the capture pool
+ * @param	plc_adc		Pointer to the handler object
+ * @param	statistics	Structure to be filled. Counters are reset on #plc_adc_start_capture
+ */
+void plc_adc_get_statistics(struct plc_adc *plc_adc, struct plc_adc_statistics *statistics);
 /**
  * @brief	Just reads one sample from the ADC
  * @param	plc_adc	Pointer to the handler object
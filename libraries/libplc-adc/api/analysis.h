@@ -35,6 +35,10 @@ struct rx_statistics
 	sample_rx_t buffer_max;
 	float buffer_dc_mean;
 	float buffer_ac_mean;
+	float buffer_ac_rms;
+	// Samples over the data detection threshold and number of crossings of it
+	uint32_t buffer_hi_samples;
+	uint32_t buffer_crossings;
 };
 
 /**
@@ -36,6 +36,8 @@ struct tx_statistics
 	uint32_t buffer_cycle_us;
 	uint32_t buffer_cycle_min_us;
 	uint32_t buffer_cycle_max_us;
+	/// Statistics of the device (only for #plc_tx_device_alsa)
+	struct plc_alsa_statistics alsa;
 };
 
 #ifndef TX_NODEF_FILL_CYCLE_CALLBACK_HANDLE
@@ -49,9 +51,11 @@ typedef void *tx_on_buffer_sent_callback_h;
 #endif
 // TODO: Revisar la funcionad de esta funcin. El TX ya conoce qu ha enviado -> Informacin del
 //	buffer innecesaria
+// 'stamp' identifies the buffer: its sequence number since the start of the transmission and the
+//	monotonic time when it was handed to the device
 typedef void (*tx_on_buffer_sent_callback_t)(
 		tx_on_buffer_sent_callback_h tx_on_buffer_sent_callback_handle, uint16_t *buffer,
-		uint32_t buffer_count);
+		uint32_t buffer_count, const struct plc_buffer_stamp *stamp);
 
 struct plc_afe;
 struct plc_tx;
@@ -97,6 +101,19 @@ void plc_tx_release(struct plc_tx *plc_tx);
  * @return	The closest sampling frequency
  */
 float plc_tx_get_effective_sampling_rate(struct plc_tx *plc_tx);
+/**
+ * @brief	Configures the ALSA transmission device
+ * @param	plc_tx			Pointer to the handler object
+ * @param	alsa_settings	Settings to be copied. By default the "default" PCM is used with
+ *							_writei_ access, a period of the buffer length and
+ *							#PLC_ALSA_PERIODS_DEFAULT periods
+ * @details
+ *	Ignored by the other devices. It must be called before #plc_tx_get_effective_sampling_rate and
+ *	#plc_tx_start_transmission. With _mmap_ the buffers are encoded directly in the ring buffer of
+ *	the device when contiguous there. On underruns the device is recovered and the transmission
+ *	continues
+ */
+void plc_tx_set_alsa_settings(struct plc_tx *plc_tx, const struct plc_alsa_settings *alsa_settings);
 /**
  * @brief	Gets some statistics related with the transmission
  * @param	plc_tx	Pointer to the handler object
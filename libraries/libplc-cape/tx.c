@@ -40,6 +40,7 @@ struct plc_tx
 	pthread_t thread;
 	volatile int end_thread;
 	struct tx_statistics tx_statistics;
+	struct plc_alsa_settings alsa_settings;
 };
 
 // TODO: Refactor. Don't use global variables nor signals here
@@ -127,8 +128,11 @@ void *thread_spi_tx_buffer(void *arg)
 		// Monitor buffer in progress
 		uint16_t *samples_buffer_to_tx = plc_tx->api.tx_sched_get_address_buffer_in_tx(
 				plc_tx->handle);
+		struct plc_buffer_stamp stamp;
+		stamp.sequence = plc_tx->tx_statistics.buffers_handled;
+		stamp.timestamp_ns = plc_time_hires_stamp_to_nsec(stamp_cycle_new);
 		plc_tx->tx_on_buffer_sent_callback(plc_tx->tx_on_buffer_sent_callback_handle,
-				samples_buffer_to_tx, plc_tx->tx_sched_buffers_len);
+				samples_buffer_to_tx, plc_tx->tx_sched_buffers_len, &stamp);
 		report_tx_statistics(&plc_tx->tx_statistics, ping_pong_buffers_missed,
 				buffer_preparation_us, buffer_cycle_us);
 	}
@@ -196,7 +200,7 @@ ATTR_EXTERN struct plc_tx *plc_tx_create(enum plc_tx_device_enum tx_device,
 	case plc_tx_device_alsa:
 		plc_tx->handle = tx_sched_alsa_create(&plc_tx->api, tx_fill_cycle_callback,
 				tx_fill_cycle_callback_handle, plc_tx->tx_sched_buffers_len,
-				requested_sampling_rate_sps);
+				requested_sampling_rate_sps, &plc_tx->alsa_settings, &plc_tx->tx_statistics.alsa);
 		break;
 	}
 
@@ -209,6 +213,8 @@ ATTR_EXTERN void plc_tx_release(struct plc_tx *plc_tx)
 	assert(sig_res != SIG_ERR);
 	if (plc_tx->handle)
 		plc_tx->api.tx_sched_release(plc_tx->handle);
+	if (plc_tx->alsa_settings.device)
+		free(plc_tx->alsa_settings.device);
 	free(plc_tx);
 }
 
@@ -217,6 +223,17 @@ ATTR_EXTERN float plc_tx_get_effective_sampling_rate(struct plc_tx *plc_tx)
 	return plc_tx->api.tx_sched_get_effective_sampling_rate(plc_tx->handle);
 }
 
+ATTR_EXTERN void plc_tx_set_alsa_settings(struct plc_tx *plc_tx,
+		const struct plc_alsa_settings *alsa_settings)
+{
+	if (plc_tx->alsa_settings.device)
+		free(plc_tx->alsa_settings.device);
+	plc_tx->alsa_settings = *alsa_settings;
+	// An empty name is accepted as the "default" PCM
+	plc_tx->alsa_settings.device =
+			(alsa_settings->device && *alsa_settings->device) ? strdup(alsa_settings->device) : NULL;
+}
+
 // POSTCONDITION: 'rx_statistics' items must be atomic but it's not required for the whole struct
 //	(for performance and simplicity)
 ATTR_EXTERN const struct tx_statistics *plc_tx_get_tx_statistics(struct plc_tx *plc_tx)
@@ -52,7 +52,8 @@ plc_tx_sched_h tx_sched_async_dma_create(struct plc_tx_sched_api *api,
 plc_tx_sched_h tx_sched_alsa_create(struct plc_tx_sched_api *api,
 		tx_fill_cycle_callback_t tx_fill_cycle_callback,
 		tx_fill_cycle_callback_h tx_fill_cycle_callback_handle, uint32_t buffers_len,
-		float freq_sampling_sps);
+		float freq_sampling_sps, const struct plc_alsa_settings *alsa_settings,
+		struct plc_alsa_statistics *alsa_statistics);
 
 plc_tx_sched_h tx_sched_fifo_create(struct plc_tx_sched_api *api,
 		tx_fill_cycle_callback_t tx_fill_cycle_callback,
@@ -9,6 +9,7 @@
 
 #include <alsa/asoundlib.h>
 #include <pthread.h>
+#include <unistd.h>		// usleep
 #include "+common/api/+base.h"
 #include "api/afe.h"
 #include "error.h"
@@ -23,18 +24,36 @@ typedef struct tx_sched_alsa *plc_tx_sched_h;
 
 static const char *adc_tx_device = "default";
 
+// Max time blocked waiting for the device
+#define TX_ALSA_WAIT_TIMEOUT_MS 1000
+
 struct tx_sched_alsa
 {
 	tx_fill_cycle_callback_t tx_fill_cycle_callback;
 	tx_fill_cycle_callback_h tx_fill_cycle_callback_handle;
 	uint16_t *frames_buffer;
 	uint32_t frames_buffer_len;
+	// Frames of each period and of the ring buffer of the device
+	snd_pcm_uframes_t period_len;
+	snd_pcm_uframes_t ring_len;
 	snd_pcm_t *snd_pcm_handle;
+	float requested_sampling_sps;
 	float freq_sampling_sps;
 	snd_pcm_hw_params_t *hwparams;
 	snd_pcm_sw_params_t *swparams;
+	const struct plc_alsa_settings *alsa_settings;
+	struct plc_alsa_statistics *alsa_statistics;
+	// Buffer given to the 'tx_fill_cycle_callback': 'frames_buffer' or the ring buffer of the
+	//	device on 'mmap' (then 'ring_offset' is its position)
+	uint16_t *buffer_in_tx;
+	snd_pcm_uframes_t ring_offset;
 };
 
+static const char *get_device_name(struct tx_sched_alsa *tx_sched)
+{
+	return tx_sched->alsa_settings->device ? tx_sched->alsa_settings->device : adc_tx_device;
+}
+
 static int set_hwparams(struct tx_sched_alsa *tx_sched, snd_pcm_uframes_t period_len)
 {
 	int err;
@@ -45,7 +64,8 @@ static int set_hwparams(struct tx_sched_alsa *tx_sched, snd_pcm_uframes_t period
 	err = snd_pcm_hw_params_any(tx_sched->snd_pcm_handle, tx_sched->hwparams);
 	if (err >= 0)
 		err = snd_pcm_hw_params_set_access(tx_sched->snd_pcm_handle, tx_sched->hwparams,
-				SND_PCM_ACCESS_RW_INTERLEAVED);
+				tx_sched->alsa_settings->mmap ?
+						SND_PCM_ACCESS_MMAP_INTERLEAVED : SND_PCM_ACCESS_RW_INTERLEAVED);
 	if (err >= 0)
 		err = snd_pcm_hw_params_set_format(tx_sched->snd_pcm_handle, tx_sched->hwparams,
 				SND_PCM_FORMAT_S16);
@@ -56,9 +76,8 @@ static int set_hwparams(struct tx_sched_alsa *tx_sched, snd_pcm_uframes_t period
 				tx_sched->freq_sampling_sps, 0);
 	if (err >= 0)
 	{
-		// Default periods = 4 as a reasonable value
-		unsigned int nperiods = 4;
-		snd_pcm_uframes_t buffer_len = period_len * nperiods;
+		unsigned int nperiods = tx_sched->alsa_settings->periods ?
+				tx_sched->alsa_settings->periods : PLC_ALSA_PERIODS_DEFAULT;
 		// Buffers
 		snd_pcm_uframes_t period_len_min;
 		snd_pcm_uframes_t period_len_max;
@@ -72,8 +91,12 @@ static int set_hwparams(struct tx_sched_alsa *tx_sched, snd_pcm_uframes_t period
 		assert(err >= 0);
 		err = snd_pcm_hw_params_get_period_size_max(tx_sched->hwparams, &period_len_max, NULL);
 		assert(err >= 0);
-		err = snd_pcm_hw_params_set_periods_near(tx_sched->snd_pcm_handle, tx_sched->hwparams,
-				&nperiods, NULL);
+		err = snd_pcm_hw_params_set_period_size_near(tx_sched->snd_pcm_handle,
+				tx_sched->hwparams, &period_len, NULL);
+		if (err >= 0)
+			err = snd_pcm_hw_params_set_periods_near(tx_sched->snd_pcm_handle, tx_sched->hwparams,
+					&nperiods, NULL);
+		snd_pcm_uframes_t buffer_len = period_len * nperiods;
 		if (err >= 0)
 		{
 			err = snd_pcm_hw_params_set_buffer_size_near(tx_sched->snd_pcm_handle,
@@ -92,7 +115,8 @@ static int set_hwparams(struct tx_sched_alsa *tx_sched, snd_pcm_uframes_t period
 									&& (period_len <= period_len_max)
 									&& (buffer_len >= buffer_len_min)
 									&& (buffer_len <= buffer_len_max));
-					tx_sched->frames_buffer_len = period_len;
+					tx_sched->period_len = period_len;
+					tx_sched->ring_len = buffer_len;
 				}
 			}
 		}
@@ -108,12 +132,12 @@ static int set_swparams(struct tx_sched_alsa *tx_sched)
 	assert(err >= 0);
 	// start the transfer when a period is full
 	err = snd_pcm_sw_params_set_start_threshold(tx_sched->snd_pcm_handle, tx_sched->swparams,
-			tx_sched->frames_buffer_len);
+			tx_sched->period_len);
 	if (err >= 0)
 	{
 		// Allow the transfer when at least period_size frames can be processed
 		err = snd_pcm_sw_params_set_avail_min(tx_sched->snd_pcm_handle, tx_sched->swparams,
-				tx_sched->frames_buffer_len);
+				tx_sched->period_len);
 		// Update the parameters
 		if (err >= 0)
 			err = snd_pcm_sw_params(tx_sched->snd_pcm_handle, tx_sched->swparams);
@@ -136,7 +160,8 @@ float tx_sched_alsa_get_closest_sampling_rate(struct tx_sched_alsa *tx_sched,
 	unsigned int sampling_rate_min;
 	unsigned int sampling_rate_max;
 	assert(tx_sched->snd_pcm_handle == NULL);
-	int ret = snd_pcm_open(&tx_sched->snd_pcm_handle, adc_tx_device, SND_PCM_STREAM_PLAYBACK, 0);
+	int ret = snd_pcm_open(&tx_sched->snd_pcm_handle, get_device_name(tx_sched),
+			SND_PCM_STREAM_PLAYBACK, 0);
 	if (ret >= 0)
 	{
 		ret = snd_pcm_hw_params_any(tx_sched->snd_pcm_handle, tx_sched->hwparams);
@@ -165,18 +190,29 @@ float tx_sched_alsa_get_closest_sampling_rate(struct tx_sched_alsa *tx_sched,
 		return 0.0;
 }
 
+// The rate is negotiated on the first request so the 'alsa_settings' given after the creation
+//	are considered
 float tx_sched_alsa_get_effective_sampling_rate(struct tx_sched_alsa *tx_sched)
 {
+	if (tx_sched->freq_sampling_sps == 0.0)
+		tx_sched->freq_sampling_sps = tx_sched_alsa_get_closest_sampling_rate(tx_sched,
+				tx_sched->requested_sampling_sps);
 	return tx_sched->freq_sampling_sps;
 }
 
 int tx_sched_alsa_start(struct tx_sched_alsa *tx_sched)
 {
 	assert(tx_sched->snd_pcm_handle == NULL);
-	int ret = snd_pcm_open(&tx_sched->snd_pcm_handle, adc_tx_device, SND_PCM_STREAM_PLAYBACK, 0);
+	tx_sched_alsa_get_effective_sampling_rate(tx_sched);
+	memset(tx_sched->alsa_statistics, 0, sizeof(*tx_sched->alsa_statistics));
+	int ret = snd_pcm_open(&tx_sched->snd_pcm_handle, get_device_name(tx_sched),
+			SND_PCM_STREAM_PLAYBACK, 0);
 	if (ret < 0)
 		return ret;
-	ret = set_hwparams(tx_sched, tx_sched->frames_buffer_len);
+	// The periods are decoupled from the buffers filled by 'tx_fill_cycle_callback'
+	ret = set_hwparams(tx_sched,
+			tx_sched->alsa_settings->period_frames ?
+					tx_sched->alsa_settings->period_frames : tx_sched->frames_buffer_len);
 	if (ret < 0)
 	{
 		snd_pcm_close(tx_sched->snd_pcm_handle);
@@ -194,10 +230,11 @@ int tx_sched_alsa_start(struct tx_sched_alsa *tx_sched)
 				strerror(-ret));
 		return ret;
 	}
-	uint32_t period_bytes = snd_pcm_frames_to_bytes(tx_sched->snd_pcm_handle,
+	uint32_t buffer_bytes = snd_pcm_frames_to_bytes(tx_sched->snd_pcm_handle,
 			tx_sched->frames_buffer_len);
-	tx_sched->frames_buffer = (uint16_t*) malloc(period_bytes);
+	tx_sched->frames_buffer = (uint16_t*) malloc(buffer_bytes);
 	assert(tx_sched->frames_buffer != NULL);
+	tx_sched->buffer_in_tx = tx_sched->frames_buffer;
 #ifdef VERBOSE
 	// Print log
 	char *log_text;
@@ -228,28 +265,142 @@ void tx_sched_alsa_stop(struct tx_sched_alsa *tx_sched)
 		free(tx_sched->frames_buffer);
 		tx_sched->frames_buffer = NULL;
 	}
+	tx_sched->buffer_in_tx = NULL;
+}
+
+static void update_delay(struct tx_sched_alsa *tx_sched)
+{
+	snd_pcm_sframes_t delay;
+	if ((snd_pcm_delay(tx_sched->snd_pcm_handle, &delay) >= 0) && (delay >= 0))
+	{
+		tx_sched->alsa_statistics->delay_frames = delay;
+		if (delay > tx_sched->alsa_statistics->delay_max_frames)
+			tx_sched->alsa_statistics->delay_max_frames = delay;
+	}
+}
+
+// Returns 0 if recovered, or the unrecoverable error
+static int recover(struct tx_sched_alsa *tx_sched, int err)
+{
+	if (err == -EPIPE)
+		tx_sched->alsa_statistics->xruns++;
+	err = snd_pcm_recover(tx_sched->snd_pcm_handle, err, 1);
+	if (err >= 0)
+		tx_sched->alsa_statistics->recoveries++;
+	else
+		libplc_cape_set_error_msg("ALSA player can't recover: %s", strerror(-err));
+	return err;
+}
+
+// On 'mmap' the playback starts explicitly once a period is committed (as 'snd_pcm_writei' does
+//	with the 'start_threshold'). Returns 1 if not started for lack of frames
+static int start_if_prepared(struct tx_sched_alsa *tx_sched)
+{
+	if (snd_pcm_state(tx_sched->snd_pcm_handle) != SND_PCM_STATE_PREPARED)
+		return 0;
+	snd_pcm_sframes_t avail = snd_pcm_avail_update(tx_sched->snd_pcm_handle);
+	if (avail < 0)
+		return avail;
+	if (tx_sched->ring_len - avail < tx_sched->period_len)
+		return 1;
+	return snd_pcm_start(tx_sched->snd_pcm_handle);
+}
+
+// Waits until at least 'frames' can be written. Returns the frames available or an error
+static snd_pcm_sframes_t wait_for_room(struct tx_sched_alsa *tx_sched, snd_pcm_uframes_t frames)
+{
+	for (;;)
+	{
+		snd_pcm_sframes_t avail = snd_pcm_avail_update(tx_sched->snd_pcm_handle);
+		if (avail < 0)
+		{
+			int ret = recover(tx_sched, avail);
+			if (ret < 0)
+				return ret;
+			continue;
+		}
+		if ((snd_pcm_uframes_t) avail >= frames)
+			return avail;
+		// A stream not started would never free room
+		int ret = start_if_prepared(tx_sched);
+		if (ret == 1)
+			return -EAGAIN;
+		if ((ret >= 0) && ((snd_pcm_uframes_t) avail >= tx_sched->period_len))
+		{
+			// 'snd_pcm_wait' would return immediately ('avail_min' is a period): sleep for the
+			//	frames still required
+			usleep((frames - avail) * 1000000.0 / tx_sched->freq_sampling_sps);
+			continue;
+		}
+		if (ret >= 0)
+			ret = snd_pcm_wait(tx_sched->snd_pcm_handle, TX_ALSA_WAIT_TIMEOUT_MS);
+		if (ret < 0)
+		{
+			ret = recover(tx_sched, ret);
+			if (ret < 0)
+				return ret;
+		}
+		else if (ret == 0)
+		{
+			return -EAGAIN;
+		}
+	}
+}
+
+// The ring buffer must hold a whole buffer plus a period still playing while waiting for room
+static int fits_in_ring(struct tx_sched_alsa *tx_sched)
+{
+	return tx_sched->frames_buffer_len + tx_sched->period_len <= tx_sched->ring_len;
+}
+
+// On 'mmap' the 'tx_fill_cycle_callback' encodes directly in the ring buffer of the device when
+//	the next 'frames_buffer_len' frames are contiguous. Otherwise 'frames_buffer' is used
+static uint16_t *get_ring_buffer(struct tx_sched_alsa *tx_sched)
+{
+	snd_pcm_t *handle = tx_sched->snd_pcm_handle;
+	if (!fits_in_ring(tx_sched) || (wait_for_room(tx_sched, tx_sched->frames_buffer_len) < 0))
+		return NULL;
+	const snd_pcm_channel_area_t *areas;
+	snd_pcm_uframes_t frames = tx_sched->frames_buffer_len;
+	if ((snd_pcm_mmap_begin(handle, &areas, &tx_sched->ring_offset, &frames) < 0)
+			|| (frames < tx_sched->frames_buffer_len))
+		return NULL;
+	// Mono interleaved: the samples of the channel are consecutive
+	assert(areas[0].step == 16);
+	return (uint16_t*) ((uint8_t*) areas[0].addr + areas[0].first / 8) + tx_sched->ring_offset;
 }
 
 void tx_sched_alsa_fill_next_buffer(struct tx_sched_alsa *tx_sched)
 {
+	uint16_t *buffer = NULL;
+	if (tx_sched->alsa_settings->mmap)
+		buffer = get_ring_buffer(tx_sched);
+	tx_sched->buffer_in_tx = buffer ? buffer : tx_sched->frames_buffer;
 	tx_sched->tx_fill_cycle_callback(tx_sched->tx_fill_cycle_callback_handle,
-			tx_sched->frames_buffer, tx_sched->frames_buffer_len);
+			tx_sched->buffer_in_tx, tx_sched->frames_buffer_len);
 }
 
 uint16_t *tx_sched_alsa_get_address_buffer_in_tx(struct tx_sched_alsa *tx_sched)
 {
-	return tx_sched->frames_buffer;
+	return tx_sched->buffer_in_tx;
 }
 
-static int write_buffer(snd_pcm_t *handle, sample_tx_t *buffer, uint32_t buffer_len)
+static int write_buffer(struct tx_sched_alsa *tx_sched, sample_tx_t *buffer, uint32_t buffer_len)
 {
-	int ret;
+	snd_pcm_t *handle = tx_sched->snd_pcm_handle;
 	while (buffer_len > 0)
 	{
-		ret = snd_pcm_writei(handle, buffer, buffer_len);
+		snd_pcm_sframes_t ret = snd_pcm_writei(handle, buffer, buffer_len);
 		if (ret == -EAGAIN)
 			continue;
-		assert(ret >= 0);
+		if (ret < 0)
+		{
+			// The samples of the buffer not written yet are sent after the recovery
+			ret = recover(tx_sched, ret);
+			if (ret < 0)
+				return ret;
+			continue;
+		}
 		// To convert frames sent to bytes we can use:
 		//	snd_pcm_frames_to_bytes(handle, err)
 		buffer += ret;
@@ -258,21 +409,92 @@ static int write_buffer(snd_pcm_t *handle, sample_tx_t *buffer, uint32_t buffer_
 	return 0;
 }
 
+// Copies the buffer in as many contiguous areas of the ring buffer as required
+static int write_buffer_mmap(struct tx_sched_alsa *tx_sched, const sample_tx_t *buffer,
+		uint32_t buffer_len)
+{
+	snd_pcm_t *handle = tx_sched->snd_pcm_handle;
+	while (buffer_len > 0)
+	{
+		snd_pcm_sframes_t avail = wait_for_room(tx_sched, 1);
+		if (avail < 0)
+			return avail;
+		const snd_pcm_channel_area_t *areas;
+		snd_pcm_uframes_t offset;
+		snd_pcm_uframes_t frames = ((uint32_t) avail < buffer_len) ? avail : buffer_len;
+		int ret = snd_pcm_mmap_begin(handle, &areas, &offset, &frames);
+		if (ret < 0)
+			return ret;
+		// Mono interleaved: the samples of the channel are consecutive
+		assert(areas[0].step == 16);
+		memcpy((uint8_t*) areas[0].addr + areas[0].first / 8 + offset * sizeof(sample_tx_t),
+				buffer, frames * sizeof(sample_tx_t));
+		snd_pcm_sframes_t frames_committed = snd_pcm_mmap_commit(handle, offset, frames);
+		if (frames_committed < 0)
+		{
+			ret = recover(tx_sched, frames_committed);
+			if (ret < 0)
+				return ret;
+			continue;
+		}
+		// On a short commit the rest is written again by the next iteration
+		buffer += frames_committed;
+		buffer_len -= frames_committed;
+		ret = start_if_prepared(tx_sched);
+		if (ret < 0)
+			return ret;
+	}
+	return 0;
+}
+
+static int commit_ring_buffer(struct tx_sched_alsa *tx_sched)
+{
+	snd_pcm_uframes_t offset = tx_sched->ring_offset;
+	snd_pcm_uframes_t frames = tx_sched->frames_buffer_len;
+	// On a short commit the rest of the buffer, already in the ring, is committed again
+	while (frames > 0)
+	{
+		snd_pcm_sframes_t frames_committed = snd_pcm_mmap_commit(tx_sched->snd_pcm_handle,
+				offset, frames);
+		if (frames_committed < 0)
+			// The samples not committed are lost
+			return recover(tx_sched, frames_committed);
+		// No progress: the rest is overwritten by the next buffer
+		if (frames_committed == 0)
+			break;
+		offset += frames_committed;
+		frames -= frames_committed;
+	}
+	int ret = start_if_prepared(tx_sched);
+	// Wait here (not on 'fill_next_buffer') for room for the next buffer
+	if ((ret >= 0) && fits_in_ring(tx_sched))
+		ret = wait_for_room(tx_sched, tx_sched->frames_buffer_len);
+	return ((ret == -EAGAIN) || (ret > 0)) ? 0 : ret;
+}
+
 #if AFE_DAC_BITS > 16
 #error DAC resolution must be below 16-bits
 #endif
 void tx_sched_alsa_flush_and_wait_buffer(struct tx_sched_alsa *tx_sched)
 {
 	int i;
+	uint16_t *buffer = tx_sched->buffer_in_tx;
 	for (i = 0; i < tx_sched->frames_buffer_len; i++)
-		tx_sched->frames_buffer[i] = (tx_sched->frames_buffer[i] << (16 - AFE_DAC_BITS)) - 0x8000;
-	write_buffer(tx_sched->snd_pcm_handle, tx_sched->frames_buffer, tx_sched->frames_buffer_len);
+		buffer[i] = (buffer[i] << (16 - AFE_DAC_BITS)) - 0x8000;
+	if (buffer != tx_sched->frames_buffer)
+		commit_ring_buffer(tx_sched);
+	else if (tx_sched->alsa_settings->mmap)
+		write_buffer_mmap(tx_sched, buffer, tx_sched->frames_buffer_len);
+	else
+		write_buffer(tx_sched, buffer, tx_sched->frames_buffer_len);
+	update_delay(tx_sched);
 }
 
 ATTR_INTERN struct tx_sched_alsa *tx_sched_alsa_create(struct plc_tx_sched_api *api,
 		tx_fill_cycle_callback_t tx_fill_cycle_callback,
 		tx_fill_cycle_callback_h tx_fill_cycle_callback_handle, uint32_t buffers_len,
-		float freq_sampling_sps)
+		float freq_sampling_sps, const struct plc_alsa_settings *alsa_settings,
+		struct plc_alsa_statistics *alsa_statistics)
 {
 	CHECK_INTERFACE_MEMBERS_COUNT(plc_tx_sched_api, 8);
 	struct tx_sched_alsa *tx_sched_alsa = calloc(1, sizeof(struct tx_sched_alsa));
@@ -292,7 +514,9 @@ ATTR_INTERN struct tx_sched_alsa *tx_sched_alsa_create(struct plc_tx_sched_api *
 	tx_sched_alsa->snd_pcm_handle = NULL;
 	snd_pcm_hw_params_malloc(&tx_sched_alsa->hwparams);
 	snd_pcm_sw_params_malloc(&tx_sched_alsa->swparams);
-	tx_sched_alsa->freq_sampling_sps = tx_sched_alsa_get_closest_sampling_rate(tx_sched_alsa,
-			freq_sampling_sps);
+	tx_sched_alsa->alsa_settings = alsa_settings;
+	tx_sched_alsa->alsa_statistics = alsa_statistics;
+	tx_sched_alsa->requested_sampling_sps = freq_sampling_sps;
+	tx_sched_alsa->freq_sampling_sps = 0.0;
 	return tx_sched_alsa;
 }
@@ -0,0 +1,129 @@
+/**
+ * @file
+ * @brief	Compact binary format for the captured samples, with a zero-copy (mmap) reader
+ * @details
+ *	A capture file ('.plccap') is made of:
+ *	- A 128-byte header: magic "PLCCAPT\0", version, sample bits, device, sampling rate, AFE RX
+ *	  settings, wall-clock time of the start of the capture, total samples and blocks, and the
+ *	  offset of the index (0 if none)
+ *	- Blocks of raw samples as captured (native 'sample_rx_t'), each one preceded by a 16-byte
+ *	  header (magic "BLCK", samples count and monotonic timestamp in ns) and padded to 8 bytes
+ *	- An optional index at the end with the offset, first sample and timestamp of each block
+ *
+ *	All the fields are little-endian. A file not properly closed (header counts at 0) is still
+ *	readable: the blocks are then scanned sequentially.
+ *	The Octave function 'plc_load_capture' (tools/octave/plc_tools.m) reads this format
+ *
+ * @cond COPYRIGHT_NOTES @copyright
+ *	Copyright (C) 2017 Jose Maria Ortega\n
+ *	Distributed under the GNU GPLv3. For full terms see the file LICENSE
+ * @endcond
+ */
+
+#ifndef LIBPLC_TOOLS_CAPTURE_H
+#define LIBPLC_TOOLS_CAPTURE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Extension recommended for the capture files
+#define PLC_CAPTURE_EXTENSION ".plccap"
+
+struct plc_capture_writer;
+struct plc_capture_reader;
+
+/**
+ * @brief	Metadata stored in the header of a capture file
+ */
+struct plc_capture_info
+{
+	/// Significant bits of each sample
+	uint32_t sample_bits;
+	/// Capturing device (_plc_rx_device_enum_)
+	uint32_t device;
+	float sampling_rate_sps;
+	/// AFE settings at capture time (_afe_gain_rx_pga1_enum_, _afe_gain_rx_pga2_enum_)
+	uint32_t afe_gain_rx_pga1;
+	uint32_t afe_gain_rx_pga2;
+	uint32_t afe_cenelec_a;
+	/// Wall-clock time (CLOCK_REALTIME) of the start of the capture [ns]
+	int64_t start_time_ns;
+	/// Filled when reading
+	uint64_t samples_count;
+	/// Filled when reading
+	uint32_t blocks_count;
+};
+
+/**
+ * @brief	Creates a capture file
+ * @param	filename	Path of the file
+ * @param	info		Metadata to store. _start_time_ns_ is filled with the current time if 0
+ * @param	with_index	1 to write an index of the blocks when closing the file
+ * @return	A pointer to the handler object (release it with @ref plc_capture_writer_close) or
+ *			NULL on error (consult _errno_ for extended information)
+ */
+struct plc_capture_writer *plc_capture_writer_create(const char *filename,
+		const struct plc_capture_info *info, int with_index);
+/**
+ * @brief	Appends a block of samples
+ * @param	plc_capture_writer	Pointer to the handler object
+ * @param	samples				Samples to write
+ * @param	samples_count		Number of samples
+ * @param	timestamp_ns		Monotonic time (CLOCK_MONOTONIC) of the block [ns]
+ * @return	0 if ok, -1 if error (consult _errno_ for extended information)
+ */
+int plc_capture_writer_write_block(struct plc_capture_writer *plc_capture_writer,
+		const sample_rx_t *samples, uint32_t samples_count, int64_t timestamp_ns);
+/**
+ * @brief	Writes the index and the final header, and releases the object
+ * @param	plc_capture_writer	Pointer to the handler object
+ * @return	0 if ok, -1 if error (consult _errno_ for extended information)
+ */
+int plc_capture_writer_close(struct plc_capture_writer *plc_capture_writer);
+
+/**
+ * @brief	Opens a capture file mapping it in memory
+ * @param	filename	Path of the file
+ * @return	A pointer to the handler object (release it with @ref plc_capture_reader_close) or
+ *			NULL on error (consult _errno_ for extended information; EINVAL on invalid format)
+ */
+struct plc_capture_reader *plc_capture_reader_open(const char *filename);
+/**
+ * @brief	Unmaps the file and releases the object
+ * @param	plc_capture_reader	Pointer to the handler object
+ */
+void plc_capture_reader_close(struct plc_capture_reader *plc_capture_reader);
+/**
+ * @brief	Gets the metadata of the capture
+ * @param	plc_capture_reader	Pointer to the handler object
+ * @return	The metadata, valid while the reader is open
+ */
+const struct plc_capture_info *plc_capture_reader_get_info(
+		struct plc_capture_reader *plc_capture_reader);
+/**
+ * @brief	Gets a block of samples without copying it
+ * @param	plc_capture_reader	Pointer to the handler object
+ * @param	block_index			Index of the block (< _blocks_count_)
+ * @param	samples_count		Output: number of samples of the block
+ * @param	timestamp_ns		Output: monotonic time of the block [ns] (NULL if not required)
+ * @return	Pointer to the samples inside the mapped file, valid while the reader is open
+ */
+const sample_rx_t *plc_capture_reader_get_block(struct plc_capture_reader *plc_capture_reader,
+		uint32_t block_index, uint32_t *samples_count, int64_t *timestamp_ns);
+/**
+ * @brief	Copies a range of samples regardless of the blocks containing them
+ * @param	plc_capture_reader	Pointer to the handler object
+ * @param	first_sample		Index of the first sample to read
+ * @param	samples				Destination buffer
+ * @param	samples_count		Number of samples to read
+ * @return	Number of samples copied (less than _samples_count_ at the end of the capture)
+ */
+uint32_t plc_capture_reader_read_samples(struct plc_capture_reader *plc_capture_reader,
+		uint64_t first_sample, sample_rx_t *samples, uint32_t samples_count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LIBPLC_TOOLS_CAPTURE_H */
@@ -0,0 +1,138 @@
+/**
+ * @file
+ * @brief	Regrouping of arbitrary-length streams of samples into fixed-size chunks
+ *
+ * @cond COPYRIGHT_NOTES @copyright
+ *	Copyright (C) 2017 Jose Maria Ortega\n
+ *	Distributed under the GNU GPLv3. For full terms see the file LICENSE
+ * @endcond
+ */
+
+#ifndef LIBPLC_TOOLS_CHUNKER_H
+#define LIBPLC_TOOLS_CHUNKER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct plc_chunker;
+
+/**
+ * @brief	Contiguous span of read-only samples
+ * @note	Same layout than _struct decoder_span_, so that the spans received by the decoders can
+ *			be passed through
+ */
+struct plc_chunker_span
+{
+	const sample_rx_t *samples;
+	uint32_t samples_count;
+};
+
+/**
+ * @brief	Callback processing a full chunk of samples
+ * @param	handle				Handle provided on @ref plc_chunker_create
+ * @param	chunk				The samples of the chunk. Only valid during the call
+ * @param	data_out			Buffer for the resulting data
+ * @param	data_out_count		Space available in _data_out_. At least the _chunk_data_max_
+ *								provided on @ref plc_chunker_create
+ * @return	The number of data stored in _data_out_
+ */
+typedef uint32_t (*plc_chunker_process_t)(void *handle, const sample_rx_t *chunk,
+		uint8_t *data_out, uint32_t data_out_count);
+
+/**
+ * @brief	Creates an object that regroups incoming samples in chunks of a fixed size
+ * @details	The chunks fully contained in the incoming samples are processed in place. Only the
+ *			incomplete tail is copied to an internal buffer, waiting for the next samples
+ * @param	chunk_samples	Samples per chunk
+ * @param	chunk_data_max	Maximum data that a chunk can generate
+ * @param	process			Callback processing each full chunk
+ * @param	handle			Handle passed to _process_
+ * @return	A pointer to the handler object. Release it with @ref plc_chunker_release
+ */
+struct plc_chunker *plc_chunker_create(uint32_t chunk_samples, uint32_t chunk_data_max,
+		plc_chunker_process_t process, void *handle);
+/**
+ * @brief	Releases a chunker
+ * @param	plc_chunker	Pointer to the handler object
+ */
+void plc_chunker_release(struct plc_chunker *plc_chunker);
+/**
+ * @brief	Discards the samples pending to complete a chunk and the data kept by
+ *			@ref plc_chunker_push_all
+ * @param	plc_chunker	Pointer to the handler object
+ */
+void plc_chunker_reset(struct plc_chunker *plc_chunker);
+/**
+ * @brief	Gets the number of samples per chunk
+ * @param	plc_chunker	Pointer to the handler object
+ * @return	The samples per chunk
+ */
+uint32_t plc_chunker_get_chunk_samples(struct plc_chunker *plc_chunker);
+/**
+ * @brief		Pushes a new span of samples, processing all the chunks completed
+ * @param[in]	plc_chunker			Pointer to the handler object
+ * @param[in]	samples				Incoming samples
+ * @param[in]	samples_count		Number of incoming samples
+ * @param[out]	data_out			Buffer for the resulting data
+ * @param[in]	data_out_count		Space available in _data_out_
+ * @param[out]	samples_consumed	Samples effectively consumed. Lower than _samples_count_ only
+ *									when _data_out_ hasn't space enough for the next chunk
+ *									(_chunk_data_max_). In that case, the non-consumed samples
+ *									must be pushed again with a new output buffer
+ * @return		The number of data stored in _data_out_
+ */
+uint32_t plc_chunker_push(struct plc_chunker *plc_chunker, const sample_rx_t *samples,
+		uint32_t samples_count, uint8_t *data_out, uint32_t data_out_count,
+		uint32_t *samples_consumed);
+/**
+ * @brief		Pushes several spans of samples, as if they were contiguous
+ * @details		Stops at the first span not fully consumed. An empty list of spans marks the end of
+ *				the stream and flushes the incomplete tail (see @ref plc_chunker_flush)
+ * @param[in]	plc_chunker			Pointer to the handler object
+ * @param[in]	spans				Incoming spans
+ * @param[in]	spans_count			Number of incoming spans
+ * @param[in]	pad_sample			Value completing the tail chunk at the end of the stream
+ * @param[out]	data_out			Buffer for the resulting data
+ * @param[in]	data_out_count		Space available in _data_out_
+ * @param[out]	samples_consumed	Samples effectively consumed (or flushed) from all the spans
+ * @return		The number of data stored in _data_out_
+ */
+uint32_t plc_chunker_push_spans(struct plc_chunker *plc_chunker,
+		const struct plc_chunker_span *spans, uint32_t spans_count, sample_rx_t pad_sample,
+		uint8_t *data_out, uint32_t data_out_count, uint32_t *samples_consumed);
+/**
+ * @brief		Pushes all the incoming samples whatever the space in the output buffer
+ * @details		For callers that cannot defer samples. The chunks are processed into an internal
+ *				buffer sized from _samples_count_, and the data not fitting in _data_out_ is kept
+ *				to be delivered first on the next call. Do not mix it with the other push functions
+ *				without a @ref plc_chunker_reset
+ * @param[in]	plc_chunker			Pointer to the handler object
+ * @param[in]	samples				Incoming samples
+ * @param[in]	samples_count		Number of incoming samples
+ * @param[out]	data_out			Buffer for the resulting data
+ * @param[in]	data_out_count		Space available in _data_out_
+ * @return		The number of data stored in _data_out_
+ */
+uint32_t plc_chunker_push_all(struct plc_chunker *plc_chunker, const sample_rx_t *samples,
+		uint32_t samples_count, uint8_t *data_out, uint32_t data_out_count);
+/**
+ * @brief		Processes the samples pending to complete a chunk, padding them to a whole chunk
+ * @details		Used at the end of a stream for its tail not to be lost
+ * @param[in]	plc_chunker			Pointer to the handler object
+ * @param[in]	pad_sample			Value completing the chunk (e.g. the idle level of the signal)
+ * @param[out]	data_out			Buffer for the resulting data
+ * @param[in]	data_out_count		Space available in _data_out_
+ * @param[out]	samples_flushed		Pending samples processed. 0 if there were none or if
+ *									_data_out_ hasn't space enough for a chunk (_chunk_data_max_),
+ *									in which case they remain pending
+ * @return		The number of data stored in _data_out_
+ */
+uint32_t plc_chunker_flush(struct plc_chunker *plc_chunker, sample_rx_t pad_sample,
+		uint8_t *data_out, uint32_t data_out_count, uint32_t *samples_flushed);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LIBPLC_TOOLS_CHUNKER_H */
@@ -0,0 +1,113 @@
+/**
+ * @file
+ * @brief	Detection of known sequences (preambles, sync words) by normalized cross-correlation
+ *
+ * @cond COPYRIGHT_NOTES @copyright
+ *	Copyright (C) 2017 Jose Maria Ortega\n
+ *	Distributed under the GNU GPLv3. For full terms see the file LICENSE
+ * @endcond
+ */
+
+#ifndef LIBPLC_TOOLS_CORRELATOR_H
+#define LIBPLC_TOOLS_CORRELATOR_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct plc_correlator;
+
+/**
+ * @brief	Algorithms available to compute the cross-correlation
+ */
+enum plc_correlator_method_enum
+{
+	/// Chooses the fastest method according to the template length
+	plc_correlator_method_auto = 0,
+	/// Time-domain correlation. Cost proportional to the template length per sample
+	plc_correlator_method_direct,
+	/// Overlap-save fast correlation based on FFTW. Cost proportional to the logarithm of the
+	/// template length per sample
+	plc_correlator_method_fft,
+	plc_correlator_method_COUNT
+};
+
+/**
+ * @brief	Detected occurrence of the template
+ */
+struct plc_correlator_peak
+{
+	/// Index of the first sample of the match, counted from the creation or the last reset
+	uint64_t position;
+	/// Normalized correlation score in the range [-1, 1]
+	float score;
+};
+
+/**
+ * @brief	Creates a correlator searching for a template in a stream of samples
+ * @details	The score of each position is the Pearson correlation between the template and the
+ *			incoming samples it overlaps, so it is independent of the signal offset and amplitude.
+ *			Consecutive positions with a score equal or greater than _threshold_ are grouped
+ *			together and reported as a single peak at the greatest score.\n
+ *			The samples are processed in blocks, so peaks are reported with a delay up to the block
+ *			size (the template length for the direct method, a few times it for the FFT one)
+ * @param	template_samples	Samples of the searched sequence
+ * @param	template_count		Number of samples of the template
+ * @param	threshold			Minimum score to report a peak
+ * @param	method				Algorithm used to compute the correlation
+ * @return	A pointer to the handler object. Release it with @ref plc_correlator_release
+ */
+struct plc_correlator *plc_correlator_create(const float *template_samples,
+		uint32_t template_count, float threshold, enum plc_correlator_method_enum method);
+/**
+ * @brief	Releases a correlator
+ * @param	plc_correlator	Pointer to the handler object
+ */
+void plc_correlator_release(struct plc_correlator *plc_correlator);
+/**
+ * @brief	Discards the pending samples and restarts the position count
+ * @param	plc_correlator	Pointer to the handler object
+ */
+void plc_correlator_reset(struct plc_correlator *plc_correlator);
+/**
+ * @brief	Gets the algorithm effectively used (resolving @ref plc_correlator_method_auto)
+ * @param	plc_correlator	Pointer to the handler object
+ * @return	The correlation method
+ */
+enum plc_correlator_method_enum plc_correlator_get_method(struct plc_correlator *plc_correlator);
+/**
+ * @brief		Pushes new floating-point samples, reporting the peaks completed
+ * @param[in]	plc_correlator	Pointer to the handler object
+ * @param[in]	samples			Incoming samples
+ * @param[in]	samples_count	Number of incoming samples
+ * @param[out]	peaks			Buffer for the detected peaks
+ * @param[in]	peaks_max		Space available in _peaks_
+ * @param[out]	peaks_discarded	Number of peaks completed that did not fit in _peaks_. Nonzero
+ *								means that _peaks_max_ is too small for the pushed samples
+ * @return		The number of peaks stored in _peaks_
+ */
+uint32_t plc_correlator_process(struct plc_correlator *plc_correlator, const float *samples,
+		uint32_t samples_count, struct plc_correlator_peak *peaks, uint32_t peaks_max,
+		uint32_t *peaks_discarded);
+/**
+ * @brief		Pushes new raw samples, reporting the peaks completed
+ * @details		Equivalent to @ref plc_correlator_process but avoiding an intermediate conversion
+ *				when working directly with the ADC samples
+ * @param[in]	plc_correlator	Pointer to the handler object
+ * @param[in]	samples			Incoming samples
+ * @param[in]	samples_count	Number of incoming samples
+ * @param[out]	peaks			Buffer for the detected peaks
+ * @param[in]	peaks_max		Space available in _peaks_
+ * @param[out]	peaks_discarded	Number of peaks completed that did not fit in _peaks_. Nonzero
+ *								means that _peaks_max_ is too small for the pushed samples
+ * @return		The number of peaks stored in _peaks_
+ */
+uint32_t plc_correlator_process_rx(struct plc_correlator *plc_correlator,
+		const sample_rx_t *samples, uint32_t samples_count, struct plc_correlator_peak *peaks,
+		uint32_t peaks_max, uint32_t *peaks_discarded);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LIBPLC_TOOLS_CORRELATOR_H */
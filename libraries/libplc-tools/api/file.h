@@ -31,6 +31,8 @@ enum csv_type_enum
 	csv_float
 };
 
+struct plc_file_csv;
+
 /**
  * @brief	Write a string to a file given a path splited in two parameters (for simplicity)
  * @param	base_path	first part of the path
@@ -103,6 +105,66 @@ int plc_file_write_csv_units(const char *filename, enum csv_type_enum csv_type_e
  */
 int plc_file_write_csv_xy(const char *filename, enum csv_type_enum csv_type_enum_x, void *buffer_x,
 		enum csv_type_enum csv_type_enum_y, void *buffer_y, uint32_t buffer_count, int append);
+/**
+ * @brief	Open a 'csv' file to be written incrementally
+ * @param	filename	target path
+ * @param	append		0 to create a new file, 1 to add files to the end of the file
+ * @return	A pointer to the handler object (release it with @ref plc_file_csv_close) or NULL on
+ *			error (consult _errno_ for extended information)
+ * @details
+ *	The values are formatted without depending on the locale (always '.' as decimal point) into a
+ *	large user-space buffer that is written to disk when full. Therefore, this object is safe to
+ *	use while other threads are formatting numbers. An object must be used by a single thread.
+ *	The first error is kept: the subsequent calls are ignored and return it
+ */
+struct plc_file_csv *plc_file_csv_open(const char *filename, int append);
+/**
+ * @brief	Flush the pending text, close the file and release the object
+ * @param	plc_file_csv	pointer to the handler object
+ * @return	0 if ok, -1 if error in this or any previous operation (consult _errno_ for extended
+ *			information)
+ */
+int plc_file_csv_close(struct plc_file_csv *plc_file_csv);
+/**
+ * @brief	Append an unsigned integer value followed by a separator
+ * @param	plc_file_csv	pointer to the handler object
+ * @param	value			value to write (as '%u')
+ * @param	separator		character to write after the value (typically ' ' or '\n')
+ * @return	0 if ok, -1 if error (consult _errno_ for extended information)
+ */
+int plc_file_csv_add_uint(struct plc_file_csv *plc_file_csv, uint32_t value, char separator);
+/**
+ * @brief	Append a float value followed by a separator
+ * @param	plc_file_csv	pointer to the handler object
+ * @param	value			value to write (as '%f' in the "POSIX" locale)
+ * @param	separator		character to write after the value (typically ' ' or '\n')
+ * @return	0 if ok, -1 if error (consult _errno_ for extended information)
+ */
+int plc_file_csv_add_float(struct plc_file_csv *plc_file_csv, float value, char separator);
+/**
+ * @brief	Append a buffer of binary data, one item per line
+ * @param	plc_file_csv	pointer to the handler object
+ * @param	csv_type_enum	type of binary data conforming the _buffer_
+ * @param	buffer			buffer of data to be converted
+ * @param	buffer_count	number of items of the buffer
+ * @return	0 if ok, -1 if error (consult _errno_ for extended information)
+ */
+int plc_file_csv_add_items(struct plc_file_csv *plc_file_csv, enum csv_type_enum csv_type_enum,
+		void *buffer, uint32_t buffer_count);
+/**
+ * @brief	Format a buffer of binary data, one item per line, into a buffer of the caller
+ * @param	text			where to write the text. It must have room for _buffer_count_ lines of
+ *							the longest item of the type (e.g. 6 bytes per @ref csv_u16 item)
+ * @param	csv_type_enum	type of binary data conforming the _buffer_
+ * @param	buffer			buffer of data to be converted
+ * @param	buffer_count	number of items of the buffer
+ * @return	The end of the generated text (not null-terminated)
+ * @details
+ *	Same locale-independent text than @ref plc_file_csv_add_items, for callers managing their own
+ *	output (e.g. aligned buffers for O_DIRECT)
+ */
+char *plc_file_csv_format_items(char *text, enum csv_type_enum csv_type_enum,
+		const void *buffer, uint32_t buffer_count);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,156 @@
+/**
+ * @file
+ * @brief	Registry of counters, gauges and histograms exported in Prometheus text or JSON format
+ * @details
+ *	The metrics are registered when setting up the application and then updated from the hot paths
+ *	(capturing and sending threads) with relaxed atomic operations: no locks, no allocations and no
+ *	system calls. So the observation doesn't perturb the real-time behavior.\n
+ *	An optional exporter thread periodically publishes a snapshot:
+ *	- To a file, replaced atomically (as expected by the _textfile_ collector of the Prometheus
+ *	  _node_exporter_)
+ *	- To each client connecting to a local UNIX-domain socket (e.g. 'socat - UNIX:path')
+ *
+ *	Each value is read atomically but a snapshot is not a consistent cut among metrics (as usual in
+ *	Prometheus exporters). The histogram buckets are cumulated when formatting
+ *
+ * @cond COPYRIGHT_NOTES @copyright
+ *	Copyright (C) 2017 Jose Maria Ortega\n
+ *	Distributed under the GNU GPLv3. For full terms see the file LICENSE
+ * @endcond
+ */
+
+#ifndef LIBPLC_TOOLS_METRICS_H
+#define LIBPLC_TOOLS_METRICS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Max number of metrics in a registry
+#define PLC_METRICS_MAX 64
+/// Max number of bucket bounds of a histogram (the '+Inf' one is implicit)
+#define PLC_METRICS_HISTOGRAM_BOUNDS_MAX 16
+
+struct plc_metrics;
+struct plc_metric;
+
+enum plc_metrics_format_enum
+{
+	plc_metrics_format_prometheus = 0,
+	plc_metrics_format_json,
+};
+
+/**
+ * @brief	Callback invoked from the exporter thread before each snapshot
+ * @details	Intended to refresh the gauges mirroring values kept elsewhere (statistics of other
+ *			objects). It must not block the hot paths, i.e. it must not take their locks
+ */
+typedef void (*plc_metrics_collect_callback_t)(void *data, struct plc_metrics *plc_metrics);
+
+/**
+ * @brief	Creates an empty registry
+ * @param	prefix	Prefix prepended to the name of all the metrics (as "plc_lab_")
+ * @return	A pointer to the handler object
+ */
+struct plc_metrics *plc_metrics_create(const char *prefix);
+/**
+ * @brief	Releases the registry, stopping the exporter if running
+ * @param	plc_metrics	Pointer to the handler object
+ */
+void plc_metrics_release(struct plc_metrics *plc_metrics);
+/**
+ * @brief	Registers a monotonically increasing counter
+ * @param	plc_metrics	Pointer to the handler object
+ * @param	name		Name of the metric (without the prefix). By convention ended in '_total'
+ * @param	help		Description of the metric
+ * @return	The metric to be updated with @ref plc_metric_add or NULL if the registry is full
+ * @details	The registration must be done before starting the exporter
+ */
+struct plc_metric *plc_metrics_add_counter(struct plc_metrics *plc_metrics, const char *name,
+		const char *help);
+/**
+ * @brief	Registers a gauge: a value that can go up and down
+ * @param	plc_metrics	Pointer to the handler object
+ * @param	name		Name of the metric (without the prefix)
+ * @param	help		Description of the metric
+ * @return	The metric to be updated with @ref plc_metric_set or NULL if the registry is full
+ */
+struct plc_metric *plc_metrics_add_gauge(struct plc_metrics *plc_metrics, const char *name,
+		const char *help);
+/**
+ * @brief	Registers a histogram
+ * @param	plc_metrics		Pointer to the handler object
+ * @param	name			Name of the metric (without the prefix). Better with the unit suffix
+ * @param	help			Description of the metric
+ * @param	bounds			Upper bounds (inclusive) of the buckets in ascending order
+ * @param	bounds_count	Number of bounds (<= @ref PLC_METRICS_HISTOGRAM_BOUNDS_MAX)
+ * @return	The metric to be updated with @ref plc_metric_observe or NULL if the registry is full
+ */
+struct plc_metric *plc_metrics_add_histogram(struct plc_metrics *plc_metrics, const char *name,
+		const char *help, const int64_t *bounds, uint32_t bounds_count);
+/**
+ * @brief	Increments a counter. Lock-free and safe to be called from any thread
+ * @param	plc_metric	Metric to update. Ignored if NULL (e.g. not registered)
+ * @param	increment	Amount to add
+ */
+void plc_metric_add(struct plc_metric *plc_metric, uint64_t increment);
+/**
+ * @brief	Sets the value of a gauge (or of a counter mirroring a count kept elsewhere). Lock-free
+ *			and safe to be called from any thread
+ * @param	plc_metric	Metric to update. Ignored if NULL
+ * @param	value		New value
+ */
+void plc_metric_set(struct plc_metric *plc_metric, int64_t value);
+/**
+ * @brief	Adds an observation to a histogram. Lock-free and safe to be called from any thread
+ * @param	plc_metric	Metric to update. Ignored if NULL
+ * @param	value		Observed value
+ */
+void plc_metric_observe(struct plc_metric *plc_metric, int64_t value);
+/**
+ * @brief	Clears the values of all the metrics
+ * @param	plc_metrics	Pointer to the handler object
+ * @details	Intended for the beginning of a session. Updates running concurrently may be lost
+ */
+void plc_metrics_reset(struct plc_metrics *plc_metrics);
+/**
+ * @brief	Sets the callback invoked before each snapshot of the exporter
+ * @param	plc_metrics		Pointer to the handler object
+ * @param	callback		Callback (NULL to disable)
+ * @param	callback_data	Custom data passed to the callback
+ */
+void plc_metrics_set_collect_callback(struct plc_metrics *plc_metrics,
+		plc_metrics_collect_callback_t callback, void *callback_data);
+/**
+ * @brief	Formats a snapshot of all the metrics
+ * @param	plc_metrics	Pointer to the handler object
+ * @param	format		Output format
+ * @param	text		Destination buffer. Always null-terminated (if _text_size_ > 0)
+ * @param	text_size	Size of the destination buffer
+ * @return	Length of the full snapshot (as _snprintf_). If >= _text_size_ it has been truncated
+ */
+size_t plc_metrics_format(struct plc_metrics *plc_metrics, enum plc_metrics_format_enum format,
+		char *text, size_t text_size);
+/**
+ * @brief	Starts the exporter thread
+ * @param	plc_metrics		Pointer to the handler object
+ * @param	format			Output format
+ * @param	file_path		File periodically rewritten with the snapshot (NULL if not required)
+ * @param	socket_path		Path of the UNIX-domain socket serving a snapshot to each connection
+ *							(NULL if not required). A stale socket file is replaced
+ * @param	interval_ms		Refresh interval of the file
+ * @return	0 if ok, -1 if error (consult _errno_ for extended information)
+ */
+int plc_metrics_start_export(struct plc_metrics *plc_metrics, enum plc_metrics_format_enum format,
+		const char *file_path, const char *socket_path, uint32_t interval_ms);
+/**
+ * @brief	Stops the exporter thread (if running), writing a final snapshot to the file
+ * @param	plc_metrics	Pointer to the handler object
+ */
+void plc_metrics_stop_export(struct plc_metrics *plc_metrics);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LIBPLC_TOOLS_METRICS_H */
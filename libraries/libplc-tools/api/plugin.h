@@ -61,6 +61,62 @@ void plc_plugin_list_release(struct plc_plugin_list *plc_plugin_list);
  */
 int plc_plugin_list_find_name(struct plc_plugin_list *plc_plugin_list, const char *plugin_name);
 
+/**
+ * @brief	Handler of a loaded plugin
+ */
+struct plc_plugin;
+
+/**
+ * @brief	Entry points of a plugin linked statically into the application
+ * @details	Usually declared through @ref plugin_static.h
+ */
+struct plc_plugin_static
+{
+	/// Name of the plugin. '_' matches the '-' of the dynamic library name (as 'encoder_wave')
+	const char *name;
+	enum plc_plugin_category category;
+	/// NULL if the plugin doesn't accept a _singletons_provider_
+	plugin_set_singletons_provider_t set_singletons_provider;
+	plugin_api_load_t api_load;
+	plugin_api_unload_t api_unload;
+};
+
+/**
+ * @brief	Registers the plugins linked statically into the application
+ * @details	@ref plc_plugin_load uses a registered plugin instead of loading the dynamic library
+ *			with the same name. They are also included in the lists of @ref plc_plugin_list_create
+ * @param	plugins			Array of plugins. It must remain valid while the library is in use
+ * @param	plugins_count	Number of items of _plugins_
+ */
+void plc_plugin_register_static(const struct plc_plugin_static *plugins, uint32_t plugins_count);
+
+/**
+ * @brief	Loads a plugin (dynamic library) and gets its API
+ * @details	If the plugin accepts a _singletons_provider_ it is configured before loading the API.
+ *			The API is validated checking that none of its functions is NULL.\n
+ *			If a plugin with the same name has been registered with @ref plc_plugin_register_static
+ *			it is used instead, without accessing the file
+ * @param	path						Absolute path of the plugin
+ * @param	singletons_provider_get		Singletons provider offered to the plugin. NULL if none
+ * @param	singletons_provider_handle	Handle passed to _singletons_provider_get_
+ * @param	api							Receives the pointer to the API of the plugin
+ * @param	api_version					Receives the version of the API
+ * @param	api_size					Receives the size in bytes of the API
+ * @param	error_msg					Receives a description of the error on failure.
+ *										Release it with _free_ when no longer required
+ * @return	A pointer to the handler object or NULL on failure.
+ *			Release it with _plc_plugin_unload_ when no longer required
+ */
+struct plc_plugin *plc_plugin_load(const char *path,
+		singletons_provider_get_t singletons_provider_get,
+		singletons_provider_h singletons_provider_handle, void **api, uint32_t *api_version,
+		uint32_t *api_size, char **error_msg);
+/**
+ * @brief	Releases the API of a plugin and unloads it
+ * @param	plc_plugin	Pointer to the handler object
+ */
+void plc_plugin_unload(struct plc_plugin *plc_plugin);
+
 #ifdef __cplusplus
 }
 #endif
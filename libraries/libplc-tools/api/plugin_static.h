@@ -0,0 +1,58 @@
+/**
+ * @file
+ * @brief	Registration of the plugins linked statically into the application
+ * @details
+ *	When the framework is built with 'PLUGINS_STATIC' (see 'make_object.mk') the listed plugins of
+ *	the categories used by an application are linked into it and 'PLUGINS_STATIC_LIST' enumerates
+ *	them as 'PLUGIN_STATIC(category, name)' items. This header declares their entry points and
+ *	the table to register them. It must be included by a single source file of the application,
+ *	calling @ref plc_plugin_register_static_list at startup (before loading any plugin).\n
+ *	Without 'PLUGINS_STATIC_LIST' the registration is empty and all the plugins are loaded
+ *	dynamically
+ *
+ * @cond COPYRIGHT_NOTES @copyright
+ *	Copyright (C) 2017 Jose Maria Ortega\n
+ *	Distributed under the GNU GPLv3. For full terms see the file LICENSE
+ * @endcond
+ */
+
+#ifndef LIBPLC_TOOLS_PLUGIN_STATIC_H
+#define LIBPLC_TOOLS_PLUGIN_STATIC_H
+
+#include "libraries/libplc-tools/api/plugin.h"
+
+#ifdef PLUGINS_STATIC_LIST
+
+// The singletons provider is optional for the plugins: weak reference (NULL if not defined)
+#define PLUGIN_STATIC(category, name) \
+	void name##_set_singletons_provider(singletons_provider_get_t callback, \
+			singletons_provider_h handle) __attribute__((weak)); \
+	void *name##_plugin_api_load(uint32_t *plugin_api_version, uint32_t *plugin_api_size); \
+	void name##_plugin_api_unload(void *plugin_api);
+PLUGINS_STATIC_LIST
+#undef PLUGIN_STATIC
+
+#define PLUGIN_STATIC(category, name) \
+	{ QUOTE(name), plc_plugin_category_##category, name##_set_singletons_provider, \
+		name##_plugin_api_load, name##_plugin_api_unload },
+static const struct plc_plugin_static plc_plugins_static[] = {
+	PLUGINS_STATIC_LIST };
+#undef PLUGIN_STATIC
+
+/**
+ * @brief	Registers the plugins linked statically (see @ref plc_plugin_register_static)
+ */
+static inline void plc_plugin_register_static_list(void)
+{
+	plc_plugin_register_static(plc_plugins_static, ARRAY_SIZE(plc_plugins_static));
+}
+
+#else
+
+static inline void plc_plugin_register_static_list(void)
+{
+}
+
+#endif /* PLUGINS_STATIC_LIST */
+
+#endif /* LIBPLC_TOOLS_PLUGIN_STATIC_H */
@@ -0,0 +1,80 @@
+/**
+ * @file
+ * @brief	Pseudo-random binary sequences (PRBS) for bit-error-rate measurements
+ *
+ * @cond COPYRIGHT_NOTES @copyright
+ *	Copyright (C) 2017 Jose Maria Ortega\n
+ *	Distributed under the GNU GPLv3. For full terms see the file LICENSE
+ * @endcond
+ */
+
+#ifndef LIBPLC_TOOLS_PRBS_H
+#define LIBPLC_TOOLS_PRBS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct plc_prbs;
+
+/**
+ * @brief	Sequences available, generated with the ITU-T O.150 polynomials
+ */
+enum plc_prbs_enum
+{
+	/// x^7 + x^6 + 1 (period 127 bits)
+	plc_prbs_7 = 0,
+	/// x^15 + x^14 + 1 (period 32767 bits)
+	plc_prbs_15,
+	/// x^23 + x^18 + 1 (period 8388607 bits)
+	plc_prbs_23,
+	/// x^31 + x^28 + 1 (period 2147483647 bits)
+	plc_prbs_31,
+	plc_prbs_COUNT
+};
+
+/**
+ * @brief	Creates a PRBS generator
+ * @param	prbs	Sequence to generate
+ * @return	A pointer to the handler object. Release it with @ref plc_prbs_release
+ */
+struct plc_prbs *plc_prbs_create(enum plc_prbs_enum prbs);
+/**
+ * @brief	Releases a PRBS generator
+ * @param	plc_prbs	Pointer to the handler object
+ */
+void plc_prbs_release(struct plc_prbs *plc_prbs);
+/**
+ * @brief	Restarts the sequence from the all-ones state
+ * @param	plc_prbs	Pointer to the handler object
+ */
+void plc_prbs_reset(struct plc_prbs *plc_prbs);
+/**
+ * @brief	Gets the degree of the polynomial, i.e. the bits required to synchronize with it
+ * @param	plc_prbs	Pointer to the handler object
+ * @return	The degree of the polynomial
+ */
+uint32_t plc_prbs_get_order(struct plc_prbs *plc_prbs);
+/**
+ * @brief	Generates the next bit of the sequence
+ * @param	plc_prbs	Pointer to the handler object
+ * @return	The new bit (0 or 1)
+ */
+int plc_prbs_next_bit(struct plc_prbs *plc_prbs);
+/**
+ * @brief	Self-synchronizing check of a received bit
+ * @details	The expected bit is predicted from the previous received bits, and then the received
+ *			bit is shifted in. After _order_ error-free bits the generator is aligned with the
+ *			incoming sequence and @ref plc_prbs_next_bit can continue it without the error
+ *			multiplication of the self-synchronizing mode (each error is predicted wrong 3 times)
+ * @param	plc_prbs	Pointer to the handler object
+ * @param	bit			The received bit (0 or 1)
+ * @return	The expected bit
+ */
+int plc_prbs_check_bit(struct plc_prbs *plc_prbs, int bit);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LIBPLC_TOOLS_PRBS_H */
@@ -32,6 +32,35 @@ enum plc_signal_iir_demodulator_enum
 	plc_signal_iir_demodulator_cos,
 };
 
+/**
+ * @brief	Arithmetic used on the demodulation and filtering processes
+ * @details	The fixed-point modes avoid the floating-point unit in the per-sample path. The IIR
+ *			coefficients are quantized to 16 (Q15) or 32 bits (Q31) with the binary point adjusted
+ *			to the greatest coefficient. Intermediate values are accumulated on 64 bits
+ */
+enum plc_signal_arithmetic_enum
+{
+	/// Single-precision floating point (legacy behavior)
+	plc_signal_arithmetic_float = 0,
+	/// Fixed point with 16-bit coefficients
+	plc_signal_arithmetic_q15,
+	/// Fixed point with 32-bit coefficients
+	plc_signal_arithmetic_q31,
+	plc_signal_arithmetic_COUNT
+};
+
+/**
+ * @brief	Decimation filters available between the demodulator and the IIR filter
+ */
+enum plc_signal_decimator_enum
+{
+	/// Cascaded integrator-comb (3 stages) followed by a 3-tap droop compensator
+	plc_signal_decimator_cic = 0,
+	/// Windowed-sinc FIR evaluated only at the decimated outputs
+	plc_signal_decimator_polyphase,
+	plc_signal_decimator_COUNT
+};
+
 /**
  * @brief	Creates a new object encapsulating demodulation functionalities
  * @param	chunk_samples	Size of the intermediate buffer for processing at chunks
@@ -54,6 +83,19 @@ void plc_signal_iir_release(struct plc_signal_iir *plc_signal_iir);
  * @return	Pointer to the buffer with the resulting filtered samples
  */
 float* plc_signal_get_buffer_out(struct plc_signal_iir *plc_signal_iir);
+/**
+ * @brief	Gets the number of samples available in the output buffer after each chunk
+ * @param	plc_signal_iir	Pointer to the handler object
+ * @return	'chunk_samples' divided by the decimation factor
+ */
+uint32_t plc_signal_get_buffer_out_count(struct plc_signal_iir *plc_signal_iir);
+/**
+ * @brief	Gets a pointer to the buffer with the filtered samples on fixed-point modes
+ * @param	plc_signal_iir	Pointer to the handler object
+ * @return	Pointer to the buffer with the resulting filtered samples rounded to integer values or
+ *			NULL if the floating-point arithmetic is selected
+ */
+const int32_t *plc_signal_get_buffer_out_fixed(struct plc_signal_iir *plc_signal_iir);
 /**
  * @brief	Indicates the amount of samples to be stored on a file
  * @param	plc_signal_iir		Pointer to the handler object
@@ -75,6 +117,38 @@ void plc_signal_iir_set_demodulator(struct plc_signal_iir *plc_signal_iir,
  */
 void plc_signal_iir_set_demodulation_frequency(struct plc_signal_iir *plc_signal_iir,
 		float digital_frequency);
+/**
+ * @brief	Sets the index of the next sample to process
+ * @details	It determines the phase of the demodulation carrier: a signal demodulated from any of
+ *			its samples gets the carrier phase it would have if demodulated from its beginning.
+ *			Requires the demodulation frequency already set
+ * @param	plc_signal_iir		Pointer to the handler object
+ * @param	samples_counter		Index of the next sample in the whole signal
+ */
+void plc_signal_iir_set_samples_counter(struct plc_signal_iir *plc_signal_iir,
+		uint32_t samples_counter);
+/**
+ * @brief	Selects the arithmetic used on the demodulation and filtering processes
+ * @param	plc_signal_iir		Pointer to the handler object
+ * @param	arithmetic			Arithmetic to be used
+ * @param	saturation			If not 0 the fixed-point values saturate on overflow instead of
+ *								wrapping around
+ * @note	It must be called before processing the first chunk
+ */
+void plc_signal_iir_set_arithmetic(struct plc_signal_iir *plc_signal_iir,
+		enum plc_signal_arithmetic_enum arithmetic, int saturation);
+/**
+ * @brief	Inserts a decimation stage between the demodulator and the IIR filter
+ * @param	plc_signal_iir		Pointer to the handler object
+ * @param	decimator			Decimation filter to be used
+ * @param	decimation			Decimation factor. It must divide 'chunk_samples'. Use 1 to disable
+ *								the stage
+ * @note	The IIR filter runs at the decimated rate so its coefficients must be designed for it
+ *			(see @ref plc_signal_design_butterworth2)
+ * @note	It must be called before processing the first chunk
+ */
+void plc_signal_iir_set_decimation(struct plc_signal_iir *plc_signal_iir,
+		enum plc_signal_decimator_enum decimator, uint32_t decimation);
 /**
  * @brief	Resets the object to its initial state
  * @param	plc_signal_iir		Pointer to the handler object
@@ -88,6 +162,73 @@ void plc_signal_iir_reset(struct plc_signal_iir *plc_signal_iir);
  */
 void plc_signal_iir_process_chunk(struct plc_signal_iir *plc_signal_iir,
 		const sample_rx_t *buffer_in, sample_rx_t buffer_in_offset);
+/**
+ * @brief	Designs a 2nd order low-pass Butterworth IIR filter
+ * @details	Equivalent to the Octave's '[iir_b, iir_a] = butter(2, cutoff)'
+ * @param	cutoff		Cut-off frequency normalized to the Nyquist frequency (0.0 to 1.0)
+ * @param	iir_a		Pointer to a 3-element array receiving the 'a' coefficients
+ * @param	iir_b		Pointer to a 3-element array receiving the 'b' coefficients
+ */
+void plc_signal_design_butterworth2(float cutoff, float *iir_a, float *iir_b);
+/**
+ * @brief	Calculates the energy of a buffer of samples using integer arithmetic only
+ * @param	buffer_in			Pointer to the input buffer to analyze
+ * @param	buffer_in_count		Number of samples in the buffer
+ * @param	buffer_in_offset	Reference offset level in the input buffer
+ * @return	Mean of the squared deviations from the offset level
+ */
+uint32_t plc_signal_get_energy(const sample_rx_t *buffer_in, uint32_t buffer_in_count,
+		sample_rx_t buffer_in_offset);
+
+/**
+ * @brief	Symbol timing recovery based on an integrate-and-dump matched filter
+ * @details	Integrates the demodulated samples over each symbol period (matched filter of
+ *			rectangular pulses) and tracks the symbol clock with a Gardner timing-error detector
+ *			evaluated on the transitions and normalized to their amplitude. The transitions are
+ *			identified by the middle point of the estimated symbol levels, which can differ from the
+ *			decision threshold
+ */
+struct plc_signal_symbol_sync;
+
+/**
+ * @brief	Creates a new symbol synchronizer
+ * @param	samples_per_symbol	Nominal symbol length in samples (fractional values accepted)
+ * @param	threshold			Decision threshold between the two symbol levels
+ * @param	loop_gain			Fraction of the estimated timing error corrected on each symbol
+ *								(0.0 disables the tracking)
+ * @return	Pointer to the handler object
+ */
+struct plc_signal_symbol_sync *plc_signal_symbol_sync_create(float samples_per_symbol,
+		float threshold, float loop_gain);
+/**
+ * @brief	Releases a handler object
+ * @param	plc_signal_symbol_sync	Pointer to the handler object
+ */
+void plc_signal_symbol_sync_release(struct plc_signal_symbol_sync *plc_signal_symbol_sync);
+/**
+ * @brief	Aligns the symbol clock to an externally detected symbol start (e.g. a start bit edge)
+ * @details	The symbol length tracked until then is kept
+ * @param	plc_signal_symbol_sync	Pointer to the handler object
+ * @param	samples_elapsed			Samples already pushed since the symbol start
+ */
+void plc_signal_symbol_sync_align(struct plc_signal_symbol_sync *plc_signal_symbol_sync,
+		float samples_elapsed);
+/**
+ * @brief	Pushes a new demodulated sample
+ * @param	plc_signal_symbol_sync	Pointer to the handler object
+ * @param	sample					Demodulated sample
+ * @param	symbol_level			Receives the mean level of the symbol when completed
+ * @return	1 if a symbol has been completed with this sample; 0 otherwise
+ */
+int plc_signal_symbol_sync_push(struct plc_signal_symbol_sync *plc_signal_symbol_sync,
+		float sample, float *symbol_level);
+/**
+ * @brief	Gets the current estimation of the symbol length
+ * @param	plc_signal_symbol_sync	Pointer to the handler object
+ * @return	Mean symbol length in samples tracked by the loop
+ */
+float plc_signal_symbol_sync_get_samples_per_symbol(
+		struct plc_signal_symbol_sync *plc_signal_symbol_sync);
 
 #ifdef __cplusplus
 }
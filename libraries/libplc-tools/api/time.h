@@ -40,6 +40,12 @@ int32_t plc_time_hires_interval_to_usec(struct timespec t1, struct timespec t2);
  * @param	interval_us	The interval to add in microseconds
  */
 void plc_time_add_usec_to_hires_interval(struct timespec *t, int32_t interval_us);
+/**
+ * @brief	Converts a _hires_ stamp to nanoseconds
+ * @param	t	The _hires_ stamp in _timespec_ units
+ * @return	The stamp in nanoseconds, as used in _plc_buffer_stamp_
+ */
+int64_t plc_time_hires_stamp_to_nsec(struct timespec t);
 
 #ifdef __cplusplus
 }
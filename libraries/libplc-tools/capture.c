@@ -0,0 +1,434 @@
+/**
+ * @file
+ *
+ * @cond COPYRIGHT_NOTES @copyright
+ *	Copyright (C) 2017 Jose Maria Ortega\n
+ *	Distributed under the GNU GPLv3. For full terms see the file LICENSE
+ * @endcond
+ */
+
+#include <errno.h>
+#include <fcntl.h>		// open
+#include <sys/mman.h>	// mmap
+#include <sys/stat.h>	// fstat
+#include <sys/uio.h>	// writev
+#include <time.h>		// clock_gettime
+#include <unistd.h>		// pwrite
+#include "+common/api/+base.h"
+#include "api/capture.h"
+
+#if __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "The capture files are little-endian. Byte-swapping not implemented"
+#endif
+
+#define CAPTURE_MAGIC "PLCCAPT"
+#define CAPTURE_VERSION 1
+#define CAPTURE_BLOCK_MAGIC 0x4B434C42	// "BLCK"
+#define CAPTURE_BLOCK_ALIGNMENT 8
+#define CAPTURE_INDEX_GRANULARITY 1024
+#define NSECS_PER_SEC 1000000000LL
+
+// On-disk layout. Fields naturally aligned for the same layout on 32 and 64-bit platforms
+struct capture_header
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t header_size;
+	uint32_t sample_bits;
+	uint32_t device;
+	float sampling_rate_sps;
+	uint32_t afe_gain_rx_pga1;
+	uint32_t afe_gain_rx_pga2;
+	uint32_t afe_cenelec_a;
+	int64_t start_time_ns;
+	uint64_t samples_count;
+	uint32_t blocks_count;
+	uint32_t block_header_size;
+	uint64_t index_offset;
+	uint8_t reserved[56];
+};
+
+struct capture_block_header
+{
+	uint32_t magic;
+	uint32_t samples_count;
+	int64_t timestamp_ns;
+};
+
+struct capture_index_entry
+{
+	uint64_t offset;
+	uint64_t first_sample;
+	int64_t timestamp_ns;
+};
+
+struct plc_capture_writer
+{
+	int file;
+	struct capture_header header;
+	uint64_t offset;
+	int with_index;
+	struct capture_index_entry *index;
+	uint32_t index_capacity;
+};
+
+struct plc_capture_reader
+{
+	const uint8_t *data;
+	size_t data_size;
+	struct plc_capture_info info;
+	// Points to the index in the file or to 'index_scanned'
+	const struct capture_index_entry *index;
+	struct capture_index_entry *index_scanned;
+};
+
+static uint32_t capture_block_padding(uint32_t samples_count)
+{
+	uint32_t bytes = samples_count * sizeof(sample_rx_t);
+	return (CAPTURE_BLOCK_ALIGNMENT - bytes % CAPTURE_BLOCK_ALIGNMENT) % CAPTURE_BLOCK_ALIGNMENT;
+}
+
+static int capture_write_all(int file, const void *data, size_t size, off_t offset)
+{
+	while (size > 0)
+	{
+		ssize_t bytes_written = pwrite(file, data, size, offset);
+		if (bytes_written < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		data = (const uint8_t *) data + bytes_written;
+		size -= bytes_written;
+		offset += bytes_written;
+	}
+	return 0;
+}
+
+ATTR_EXTERN struct plc_capture_writer *plc_capture_writer_create(const char *filename,
+		const struct plc_capture_info *info, int with_index)
+{
+	REPORT_COMPILER_ERROR_IF(sizeof(struct capture_header) != 128);
+	REPORT_COMPILER_ERROR_IF(sizeof(struct capture_block_header) != 16);
+	REPORT_COMPILER_ERROR_IF(sizeof(struct capture_index_entry) != 24);
+	mode_t mode = S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH;
+	int file = open(filename, O_CREAT | O_WRONLY | O_TRUNC, mode);
+	if (file < 0)
+		return NULL;
+	struct plc_capture_writer *plc_capture_writer = calloc(1, sizeof(struct plc_capture_writer));
+	plc_capture_writer->file = file;
+	plc_capture_writer->with_index = with_index;
+	struct capture_header *header = &plc_capture_writer->header;
+	memcpy(header->magic, CAPTURE_MAGIC, sizeof(header->magic));
+	header->version = CAPTURE_VERSION;
+	header->header_size = sizeof(struct capture_header);
+	header->sample_bits = info->sample_bits;
+	header->device = info->device;
+	header->sampling_rate_sps = info->sampling_rate_sps;
+	header->afe_gain_rx_pga1 = info->afe_gain_rx_pga1;
+	header->afe_gain_rx_pga2 = info->afe_gain_rx_pga2;
+	header->afe_cenelec_a = info->afe_cenelec_a;
+	header->start_time_ns = info->start_time_ns;
+	if (header->start_time_ns == 0)
+	{
+		struct timespec stamp;
+		clock_gettime(CLOCK_REALTIME, &stamp);
+		header->start_time_ns = stamp.tv_sec * NSECS_PER_SEC + stamp.tv_nsec;
+	}
+	header->block_header_size = sizeof(struct capture_block_header);
+	// The counts remain at 0 until closing: the readers then know that the blocks must be scanned
+	if (capture_write_all(file, header, sizeof(*header), 0) < 0)
+	{
+		int last_error = errno;
+		close(file);
+		free(plc_capture_writer);
+		errno = last_error;
+		return NULL;
+	}
+	// 'pwrite' doesn't move the file offset used by 'writev'
+	plc_capture_writer->offset = sizeof(*header);
+	lseek(file, plc_capture_writer->offset, SEEK_SET);
+	return plc_capture_writer;
+}
+
+ATTR_EXTERN int plc_capture_writer_write_block(struct plc_capture_writer *plc_capture_writer,
+		const sample_rx_t *samples, uint32_t samples_count, int64_t timestamp_ns)
+{
+	static const uint8_t padding[CAPTURE_BLOCK_ALIGNMENT] = { 0 };
+	struct capture_header *header = &plc_capture_writer->header;
+	if (plc_capture_writer->with_index)
+	{
+		if (header->blocks_count == plc_capture_writer->index_capacity)
+		{
+			plc_capture_writer->index_capacity += CAPTURE_INDEX_GRANULARITY;
+			plc_capture_writer->index = realloc(plc_capture_writer->index,
+					plc_capture_writer->index_capacity * sizeof(struct capture_index_entry));
+		}
+		struct capture_index_entry *entry = &plc_capture_writer->index[header->blocks_count];
+		entry->offset = plc_capture_writer->offset;
+		entry->first_sample = header->samples_count;
+		entry->timestamp_ns = timestamp_ns;
+	}
+	struct capture_block_header block_header = {
+		CAPTURE_BLOCK_MAGIC, samples_count, timestamp_ns };
+	// A single system call per block
+	struct iovec iov[3] = {
+		{ &block_header, sizeof(block_header) },
+		{ (void *) samples, samples_count * sizeof(sample_rx_t) },
+		{ (void *) padding, capture_block_padding(samples_count) } };
+	size_t block_size = iov[0].iov_len + iov[1].iov_len + iov[2].iov_len;
+	ssize_t bytes_written = writev(plc_capture_writer->file, iov, 3);
+	if (bytes_written < 0)
+		return -1;
+	if ((size_t) bytes_written != block_size)
+	{
+		// Short write (signal or disk full): complete it to keep the file consistent
+		uint8_t *block = malloc(block_size);
+		memcpy(block, iov[0].iov_base, iov[0].iov_len);
+		memcpy(block + iov[0].iov_len, iov[1].iov_base, iov[1].iov_len);
+		memset(block + iov[0].iov_len + iov[1].iov_len, 0, iov[2].iov_len);
+		int ret = capture_write_all(plc_capture_writer->file, block + bytes_written,
+				block_size - bytes_written, plc_capture_writer->offset + bytes_written);
+		free(block);
+		if (ret < 0)
+			return -1;
+		lseek(plc_capture_writer->file, plc_capture_writer->offset + block_size, SEEK_SET);
+	}
+	plc_capture_writer->offset += block_size;
+	header->samples_count += samples_count;
+	header->blocks_count++;
+	return 0;
+}
+
+ATTR_EXTERN int plc_capture_writer_close(struct plc_capture_writer *plc_capture_writer)
+{
+	struct capture_header *header = &plc_capture_writer->header;
+	int ret = 0;
+	if (plc_capture_writer->with_index && (header->blocks_count > 0))
+	{
+		ret = capture_write_all(plc_capture_writer->file, plc_capture_writer->index,
+				header->blocks_count * sizeof(struct capture_index_entry),
+				plc_capture_writer->offset);
+		if (ret == 0)
+			header->index_offset = plc_capture_writer->offset;
+	}
+	if (ret == 0)
+		ret = capture_write_all(plc_capture_writer->file, header, sizeof(*header), 0);
+	int last_error = errno;
+	if ((close(plc_capture_writer->file) < 0) && (ret == 0))
+	{
+		last_error = errno;
+		ret = -1;
+	}
+	free(plc_capture_writer->index);
+	free(plc_capture_writer);
+	errno = last_error;
+	return ret;
+}
+
+// Gets the size of the block at 'offset'. Returns 0 if it is a valid block ending at or before
+//	'offset_end', -1 otherwise
+static int capture_reader_get_block_size(struct plc_capture_reader *plc_capture_reader,
+		uint64_t offset, uint64_t offset_end, uint64_t *block_size)
+{
+	if ((offset % CAPTURE_BLOCK_ALIGNMENT != 0) || (offset_end < offset)
+			|| (offset_end - offset < sizeof(struct capture_block_header)))
+		return -1;
+	const struct capture_block_header *block_header =
+			(const struct capture_block_header *) (plc_capture_reader->data + offset);
+	// Checked before multiplying: the sizes in 'uint32_t' and 'size_t' overflow on 32-bit
+	uint64_t samples_max = (offset_end - offset - sizeof(struct capture_block_header))
+			/ sizeof(sample_rx_t);
+	if ((block_header->magic != CAPTURE_BLOCK_MAGIC) || (block_header->samples_count > samples_max))
+		return -1;
+	*block_size = sizeof(struct capture_block_header)
+			+ (uint64_t) block_header->samples_count * sizeof(sample_rx_t)
+			+ capture_block_padding(block_header->samples_count);
+	return (*block_size <= offset_end - offset) ? 0 : -1;
+}
+
+// Checks that the index of the file points to consecutive valid blocks, all of them before the
+//	index, and that its sample counts match the blocks. Returns 0 if valid
+static int capture_reader_check_index(struct plc_capture_reader *plc_capture_reader,
+		const struct capture_index_entry *index, uint64_t index_offset)
+{
+	uint64_t offset = sizeof(struct capture_header);
+	uint64_t samples_count = 0;
+	uint32_t n;
+	for (n = 0; n < plc_capture_reader->info.blocks_count; n++)
+	{
+		uint64_t block_size;
+		if ((index[n].offset != offset) || (index[n].first_sample != samples_count)
+				|| (capture_reader_get_block_size(plc_capture_reader, offset, index_offset,
+						&block_size) < 0))
+			return -1;
+		const struct capture_block_header *block_header =
+				(const struct capture_block_header *) (plc_capture_reader->data + offset);
+		samples_count += block_header->samples_count;
+		offset += block_size;
+	}
+	return (samples_count == plc_capture_reader->info.samples_count) ? 0 : -1;
+}
+
+// Builds the index when not available (file not properly closed or written without index) or not
+//	valid. A truncated last block is ignored
+static void capture_reader_scan_blocks(struct plc_capture_reader *plc_capture_reader)
+{
+	uint32_t index_capacity = 0;
+	uint64_t offset = sizeof(struct capture_header);
+	plc_capture_reader->info.samples_count = 0;
+	plc_capture_reader->info.blocks_count = 0;
+	for (;;)
+	{
+		uint64_t block_size;
+		if (capture_reader_get_block_size(plc_capture_reader, offset,
+				plc_capture_reader->data_size, &block_size) < 0)
+			break;
+		const struct capture_block_header *block_header =
+				(const struct capture_block_header *) (plc_capture_reader->data + offset);
+		if (plc_capture_reader->info.blocks_count == index_capacity)
+		{
+			index_capacity += CAPTURE_INDEX_GRANULARITY;
+			plc_capture_reader->index_scanned = realloc(plc_capture_reader->index_scanned,
+					index_capacity * sizeof(struct capture_index_entry));
+		}
+		struct capture_index_entry *entry =
+				&plc_capture_reader->index_scanned[plc_capture_reader->info.blocks_count++];
+		entry->offset = offset;
+		entry->first_sample = plc_capture_reader->info.samples_count;
+		entry->timestamp_ns = block_header->timestamp_ns;
+		plc_capture_reader->info.samples_count += block_header->samples_count;
+		offset += block_size;
+	}
+	plc_capture_reader->index = plc_capture_reader->index_scanned;
+}
+
+ATTR_EXTERN struct plc_capture_reader *plc_capture_reader_open(const char *filename)
+{
+	int file = open(filename, O_RDONLY);
+	if (file < 0)
+		return NULL;
+	struct stat file_stat;
+	if (fstat(file, &file_stat) < 0)
+	{
+		int last_error = errno;
+		close(file);
+		errno = last_error;
+		return NULL;
+	}
+	if (file_stat.st_size < (off_t) sizeof(struct capture_header))
+	{
+		close(file);
+		errno = EINVAL;
+		return NULL;
+	}
+	void *data = mmap(NULL, file_stat.st_size, PROT_READ, MAP_SHARED, file, 0);
+	// The mapping remains valid after closing the descriptor
+	close(file);
+	if (data == MAP_FAILED)
+		return NULL;
+	const struct capture_header *header = data;
+	if ((memcmp(header->magic, CAPTURE_MAGIC, sizeof(header->magic)) != 0)
+			|| (header->version != CAPTURE_VERSION)
+			|| (header->header_size != sizeof(struct capture_header))
+			|| (header->block_header_size != sizeof(struct capture_block_header)))
+	{
+		munmap(data, file_stat.st_size);
+		errno = EINVAL;
+		return NULL;
+	}
+	// Mostly read sequentially
+	madvise(data, file_stat.st_size, MADV_SEQUENTIAL);
+	struct plc_capture_reader *plc_capture_reader = calloc(1, sizeof(struct plc_capture_reader));
+	plc_capture_reader->data = data;
+	plc_capture_reader->data_size = file_stat.st_size;
+	struct plc_capture_info *info = &plc_capture_reader->info;
+	info->sample_bits = header->sample_bits;
+	info->device = header->device;
+	info->sampling_rate_sps = header->sampling_rate_sps;
+	info->afe_gain_rx_pga1 = header->afe_gain_rx_pga1;
+	info->afe_gain_rx_pga2 = header->afe_gain_rx_pga2;
+	info->afe_cenelec_a = header->afe_cenelec_a;
+	info->start_time_ns = header->start_time_ns;
+	info->samples_count = header->samples_count;
+	info->blocks_count = header->blocks_count;
+	// The index of the file is only trusted if consistent with the blocks. Otherwise it is rebuilt
+	uint64_t index_size = (uint64_t) header->blocks_count * sizeof(struct capture_index_entry);
+	if ((header->index_offset >= sizeof(struct capture_header))
+			&& (header->index_offset <= plc_capture_reader->data_size)
+			&& (index_size == plc_capture_reader->data_size - header->index_offset))
+	{
+		const struct capture_index_entry *index = (const struct capture_index_entry *) (
+				plc_capture_reader->data + header->index_offset);
+		if (capture_reader_check_index(plc_capture_reader, index, header->index_offset) == 0)
+			plc_capture_reader->index = index;
+	}
+	if (plc_capture_reader->index == NULL)
+		capture_reader_scan_blocks(plc_capture_reader);
+	return plc_capture_reader;
+}
+
+ATTR_EXTERN void plc_capture_reader_close(struct plc_capture_reader *plc_capture_reader)
+{
+	munmap((void *) plc_capture_reader->data, plc_capture_reader->data_size);
+	free(plc_capture_reader->index_scanned);
+	free(plc_capture_reader);
+}
+
+ATTR_EXTERN const struct plc_capture_info *plc_capture_reader_get_info(
+		struct plc_capture_reader *plc_capture_reader)
+{
+	return &plc_capture_reader->info;
+}
+
+ATTR_EXTERN const sample_rx_t *plc_capture_reader_get_block(
+		struct plc_capture_reader *plc_capture_reader, uint32_t block_index,
+		uint32_t *samples_count, int64_t *timestamp_ns)
+{
+	assert(block_index < plc_capture_reader->info.blocks_count);
+	const struct capture_block_header *block_header =
+			(const struct capture_block_header *) (plc_capture_reader->data
+					+ plc_capture_reader->index[block_index].offset);
+	*samples_count = block_header->samples_count;
+	if (timestamp_ns)
+		*timestamp_ns = block_header->timestamp_ns;
+	return (const sample_rx_t *) (block_header + 1);
+}
+
+ATTR_EXTERN uint32_t plc_capture_reader_read_samples(struct plc_capture_reader *plc_capture_reader,
+		uint64_t first_sample, sample_rx_t *samples, uint32_t samples_count)
+{
+	if (first_sample >= plc_capture_reader->info.samples_count)
+		return 0;
+	// Binary search of the last block starting at or before 'first_sample'
+	const struct capture_index_entry *index = plc_capture_reader->index;
+	uint32_t block_ini = 0;
+	uint32_t block_end = plc_capture_reader->info.blocks_count;
+	while (block_end - block_ini > 1)
+	{
+		uint32_t block_mid = (block_ini + block_end) / 2;
+		if (index[block_mid].first_sample <= first_sample)
+			block_ini = block_mid;
+		else
+			block_end = block_mid;
+	}
+	uint32_t samples_copied = 0;
+	uint32_t block_index;
+	for (block_index = block_ini;
+			(samples_copied < samples_count)
+					&& (block_index < plc_capture_reader->info.blocks_count); block_index++)
+	{
+		uint32_t block_samples_count;
+		const sample_rx_t *block_samples = plc_capture_reader_get_block(plc_capture_reader,
+				block_index, &block_samples_count, NULL);
+		uint32_t block_offset = first_sample + samples_copied - index[block_index].first_sample;
+		uint32_t samples_to_copy = block_samples_count - block_offset;
+		if (samples_to_copy > samples_count - samples_copied)
+			samples_to_copy = samples_count - samples_copied;
+		memcpy(samples + samples_copied, block_samples + block_offset,
+				samples_to_copy * sizeof(sample_rx_t));
+		samples_copied += samples_to_copy;
+	}
+	return samples_copied;
+}
@@ -0,0 +1,163 @@
+/**
+ * @file
+ *
+ * @cond COPYRIGHT_NOTES @copyright
+ *	Copyright (C) 2017 Jose Maria Ortega\n
+ *	Distributed under the GNU GPLv3. For full terms see the file LICENSE
+ * @endcond
+ */
+
+#include "+common/api/+base.h"
+#include "api/chunker.h"
+
+struct plc_chunker
+{
+	uint32_t chunk_samples;
+	uint32_t chunk_data_max;
+	plc_chunker_process_t process;
+	void *handle;
+	// Incomplete chunk waiting for more samples
+	sample_rx_t *pending;
+	uint32_t pending_count;
+	// Data processed by 'plc_chunker_push_all' not delivered yet
+	uint8_t *data_kept;
+	uint32_t data_kept_count;
+	uint32_t data_kept_max;
+};
+
+ATTR_EXTERN struct plc_chunker *plc_chunker_create(uint32_t chunk_samples,
+		uint32_t chunk_data_max, plc_chunker_process_t process, void *handle)
+{
+	assert(chunk_samples > 0);
+	struct plc_chunker *plc_chunker = calloc(1, sizeof(struct plc_chunker));
+	plc_chunker->chunk_samples = chunk_samples;
+	plc_chunker->chunk_data_max = chunk_data_max;
+	plc_chunker->process = process;
+	plc_chunker->handle = handle;
+	plc_chunker->pending = malloc(chunk_samples * sizeof(sample_rx_t));
+	return plc_chunker;
+}
+
+ATTR_EXTERN void plc_chunker_release(struct plc_chunker *plc_chunker)
+{
+	free(plc_chunker->data_kept);
+	free(plc_chunker->pending);
+	free(plc_chunker);
+}
+
+ATTR_EXTERN void plc_chunker_reset(struct plc_chunker *plc_chunker)
+{
+	plc_chunker->pending_count = 0;
+	plc_chunker->data_kept_count = 0;
+}
+
+ATTR_EXTERN uint32_t plc_chunker_get_chunk_samples(struct plc_chunker *plc_chunker)
+{
+	return plc_chunker->chunk_samples;
+}
+
+ATTR_EXTERN uint32_t plc_chunker_push(struct plc_chunker *plc_chunker, const sample_rx_t *samples,
+		uint32_t samples_count, uint8_t *data_out, uint32_t data_out_count,
+		uint32_t *samples_consumed)
+{
+	uint32_t chunk_samples = plc_chunker->chunk_samples;
+	uint32_t data_count = 0;
+	const sample_rx_t *samples_cur = samples;
+	const sample_rx_t *samples_end = samples + samples_count;
+	while (samples_cur < samples_end)
+	{
+		uint32_t samples_available = samples_end - samples_cur;
+		int chunk_completed = (plc_chunker->pending_count + samples_available >= chunk_samples);
+		// Stop before completing a chunk if its data could not fit in the output buffer
+		if (chunk_completed && (data_out_count - data_count < plc_chunker->chunk_data_max))
+			break;
+		if ((plc_chunker->pending_count == 0) && chunk_completed)
+		{
+			// Zero-copy path: the chunk is contiguous in the incoming samples
+			data_count += plc_chunker->process(plc_chunker->handle, samples_cur,
+					data_out + data_count, data_out_count - data_count);
+			samples_cur += chunk_samples;
+		}
+		else
+		{
+			uint32_t samples_to_copy = chunk_samples - plc_chunker->pending_count;
+			if (samples_to_copy > samples_available)
+				samples_to_copy = samples_available;
+			memcpy(plc_chunker->pending + plc_chunker->pending_count, samples_cur,
+					samples_to_copy * sizeof(sample_rx_t));
+			plc_chunker->pending_count += samples_to_copy;
+			samples_cur += samples_to_copy;
+			if (plc_chunker->pending_count == chunk_samples)
+			{
+				data_count += plc_chunker->process(plc_chunker->handle, plc_chunker->pending,
+						data_out + data_count, data_out_count - data_count);
+				plc_chunker->pending_count = 0;
+			}
+		}
+	}
+	*samples_consumed = samples_cur - samples;
+	return data_count;
+}
+
+ATTR_EXTERN uint32_t plc_chunker_push_spans(struct plc_chunker *plc_chunker,
+		const struct plc_chunker_span *spans, uint32_t spans_count, sample_rx_t pad_sample,
+		uint8_t *data_out, uint32_t data_out_count, uint32_t *samples_consumed)
+{
+	if (spans_count == 0)
+		return plc_chunker_flush(plc_chunker, pad_sample, data_out, data_out_count,
+				samples_consumed);
+	uint32_t data_count = 0;
+	*samples_consumed = 0;
+	for (; spans_count > 0; spans_count--, spans++)
+	{
+		uint32_t span_samples_consumed;
+		data_count += plc_chunker_push(plc_chunker, spans->samples, spans->samples_count,
+				data_out + data_count, data_out_count - data_count, &span_samples_consumed);
+		*samples_consumed += span_samples_consumed;
+		if (span_samples_consumed < spans->samples_count)
+			break;
+	}
+	return data_count;
+}
+
+ATTR_EXTERN uint32_t plc_chunker_push_all(struct plc_chunker *plc_chunker,
+		const sample_rx_t *samples, uint32_t samples_count, uint8_t *data_out,
+		uint32_t data_out_count)
+{
+	// Room for all the chunks completed by the incoming samples
+	uint32_t chunks = (plc_chunker->pending_count + samples_count) / plc_chunker->chunk_samples;
+	uint32_t data_kept_required = plc_chunker->data_kept_count
+			+ chunks * plc_chunker->chunk_data_max;
+	if (data_kept_required > plc_chunker->data_kept_max)
+	{
+		plc_chunker->data_kept_max = data_kept_required;
+		plc_chunker->data_kept = realloc(plc_chunker->data_kept, data_kept_required);
+	}
+	uint32_t samples_consumed;
+	plc_chunker->data_kept_count += plc_chunker_push(plc_chunker, samples, samples_count,
+			plc_chunker->data_kept + plc_chunker->data_kept_count,
+			plc_chunker->data_kept_max - plc_chunker->data_kept_count, &samples_consumed);
+	assert(samples_consumed == samples_count);
+	uint32_t data_count = (plc_chunker->data_kept_count < data_out_count) ?
+			plc_chunker->data_kept_count : data_out_count;
+	memcpy(data_out, plc_chunker->data_kept, data_count);
+	plc_chunker->data_kept_count -= data_count;
+	memmove(plc_chunker->data_kept, plc_chunker->data_kept + data_count,
+			plc_chunker->data_kept_count);
+	return data_count;
+}
+
+ATTR_EXTERN uint32_t plc_chunker_flush(struct plc_chunker *plc_chunker, sample_rx_t pad_sample,
+		uint8_t *data_out, uint32_t data_out_count, uint32_t *samples_flushed)
+{
+	*samples_flushed = 0;
+	if ((plc_chunker->pending_count == 0) || (data_out_count < plc_chunker->chunk_data_max))
+		return 0;
+	uint32_t n;
+	for (n = plc_chunker->pending_count; n < plc_chunker->chunk_samples; n++)
+		plc_chunker->pending[n] = pad_sample;
+	*samples_flushed = plc_chunker->pending_count;
+	plc_chunker->pending_count = 0;
+	return plc_chunker->process(plc_chunker->handle, plc_chunker->pending, data_out,
+			data_out_count);
+}
@@ -0,0 +1,306 @@
+/**
+ * @file
+ *
+ * @cond COPYRIGHT_NOTES @copyright
+ *	Copyright (C) 2017 Jose Maria Ortega\n
+ *	Distributed under the GNU GPLv3. For full terms see the file LICENSE
+ * @endcond
+ */
+
+#include <fftw3.h>		// fftwf_plan_dft_r2c_1d
+#include <math.h>		// sqrt
+#include <pthread.h>	// pthread_mutex_lock
+#include "+common/api/+base.h"
+#include "api/correlator.h"
+
+// Longest template for which 'plc_correlator_method_auto' chooses the direct method. Measured with
+// the 'correlator' bench of plc-cape-bench on x86 with '-O3': the overlap-save method becomes
+// faster at about 16 samples. Run it again on the target to tune this value
+#define CORRELATOR_DIRECT_TEMPLATE_MAX 16
+// New positions evaluated per block with the direct method
+#define CORRELATOR_DIRECT_BLOCK_POSITIONS 256
+// FFT size as a multiple of the template length. Greater ratios reduce the overlap overhead
+// ('template_count - 1' samples processed twice per block) at the cost of a longer latency
+#define CORRELATOR_FFT_SIZE_RATIO 4
+#define CORRELATOR_FFT_SIZE_MIN 256
+// Relative energy under which the window is considered constant and the score is reported as 0
+#define CORRELATOR_ENERGY_EPSILON 1e-9
+
+// The FFTW planner is not thread-safe. Only 'fftwf_execute' can be called concurrently
+static pthread_mutex_t fftw_planner_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+struct plc_correlator
+{
+	enum plc_correlator_method_enum method;
+	uint32_t template_count;
+	float threshold;
+	// Zero-mean template
+	float *template_samples;
+	double template_norm;
+	// Block of samples being processed. The first 'template_count - 1' samples are the tail of the
+	// previous block. Each full block provides 'block_positions' new scores
+	float *block;
+	uint32_t block_size;
+	uint32_t block_count;
+	uint32_t block_positions;
+	uint64_t block_position;
+	// Raw correlation of each position of the block
+	float *correlation;
+	// Overlap-save stuff
+	fftwf_complex *spectrum;
+	fftwf_complex *template_spectrum;
+	fftwf_plan plan_forward;
+	fftwf_plan plan_backward;
+	// Peak being tracked while the scores remain above the threshold
+	int peak_open;
+	struct plc_correlator_peak peak;
+};
+
+static void correlator_initialize_fft(struct plc_correlator *plc_correlator)
+{
+	uint32_t fft_size = CORRELATOR_FFT_SIZE_MIN;
+	while (fft_size < CORRELATOR_FFT_SIZE_RATIO * plc_correlator->template_count)
+		fft_size <<= 1;
+	uint32_t spectrum_count = fft_size / 2 + 1;
+	plc_correlator->block_size = fft_size;
+	plc_correlator->block = fftwf_malloc(fft_size * sizeof(float));
+	plc_correlator->correlation = fftwf_malloc(fft_size * sizeof(float));
+	plc_correlator->spectrum = fftwf_malloc(spectrum_count * sizeof(fftwf_complex));
+	plc_correlator->template_spectrum = fftwf_malloc(spectrum_count * sizeof(fftwf_complex));
+	pthread_mutex_lock(&fftw_planner_mutex);
+	plc_correlator->plan_forward = fftwf_plan_dft_r2c_1d(fft_size, plc_correlator->block,
+			plc_correlator->spectrum, FFTW_ESTIMATE);
+	plc_correlator->plan_backward = fftwf_plan_dft_c2r_1d(fft_size, plc_correlator->spectrum,
+			plc_correlator->correlation, FFTW_ESTIMATE);
+	pthread_mutex_unlock(&fftw_planner_mutex);
+	// Precompute the spectrum of the template, already scaled to compensate the unnormalized
+	// FFTW transforms
+	memset(plc_correlator->block, 0, fft_size * sizeof(float));
+	uint32_t n;
+	for (n = 0; n < plc_correlator->template_count; n++)
+		plc_correlator->block[n] = plc_correlator->template_samples[n] / fft_size;
+	fftwf_execute_dft_r2c(plc_correlator->plan_forward, plc_correlator->block,
+			plc_correlator->template_spectrum);
+}
+
+ATTR_EXTERN struct plc_correlator *plc_correlator_create(const float *template_samples,
+		uint32_t template_count, float threshold, enum plc_correlator_method_enum method)
+{
+	assert(template_count > 0);
+	assert(method < plc_correlator_method_COUNT);
+	struct plc_correlator *plc_correlator = calloc(1, sizeof(struct plc_correlator));
+	if (method == plc_correlator_method_auto)
+		method = (template_count <= CORRELATOR_DIRECT_TEMPLATE_MAX) ?
+				plc_correlator_method_direct : plc_correlator_method_fft;
+	plc_correlator->method = method;
+	plc_correlator->template_count = template_count;
+	plc_correlator->threshold = threshold;
+	// Remove the mean of the template. Then, the correlation with the raw samples equals the
+	// correlation with the zero-mean samples
+	plc_correlator->template_samples = malloc(template_count * sizeof(float));
+	double template_sum = 0.0;
+	uint32_t n;
+	for (n = 0; n < template_count; n++)
+		template_sum += template_samples[n];
+	double template_mean = template_sum / template_count;
+	double template_sum2 = 0.0;
+	for (n = 0; n < template_count; n++)
+	{
+		float sample = template_samples[n] - template_mean;
+		plc_correlator->template_samples[n] = sample;
+		template_sum2 += (double) sample * sample;
+	}
+	plc_correlator->template_norm = sqrt(template_sum2);
+	if (method == plc_correlator_method_fft)
+	{
+		correlator_initialize_fft(plc_correlator);
+	}
+	else
+	{
+		plc_correlator->block_size = template_count - 1 + CORRELATOR_DIRECT_BLOCK_POSITIONS;
+		plc_correlator->block = malloc(plc_correlator->block_size * sizeof(float));
+		plc_correlator->correlation = malloc(plc_correlator->block_size * sizeof(float));
+	}
+	plc_correlator->block_positions = plc_correlator->block_size - template_count + 1;
+	return plc_correlator;
+}
+
+ATTR_EXTERN void plc_correlator_release(struct plc_correlator *plc_correlator)
+{
+	if (plc_correlator->method == plc_correlator_method_fft)
+	{
+		pthread_mutex_lock(&fftw_planner_mutex);
+		fftwf_destroy_plan(plc_correlator->plan_backward);
+		fftwf_destroy_plan(plc_correlator->plan_forward);
+		pthread_mutex_unlock(&fftw_planner_mutex);
+		fftwf_free(plc_correlator->template_spectrum);
+		fftwf_free(plc_correlator->spectrum);
+		fftwf_free(plc_correlator->correlation);
+		fftwf_free(plc_correlator->block);
+	}
+	else
+	{
+		free(plc_correlator->correlation);
+		free(plc_correlator->block);
+	}
+	free(plc_correlator->template_samples);
+	free(plc_correlator);
+}
+
+ATTR_EXTERN void plc_correlator_reset(struct plc_correlator *plc_correlator)
+{
+	plc_correlator->block_count = 0;
+	plc_correlator->block_position = 0;
+	plc_correlator->peak_open = 0;
+}
+
+ATTR_EXTERN enum plc_correlator_method_enum plc_correlator_get_method(
+		struct plc_correlator *plc_correlator)
+{
+	return plc_correlator->method;
+}
+
+static void correlator_correlate_direct(struct plc_correlator *plc_correlator)
+{
+	// Loop over the template taps first: the inner loop is then a multiply-accumulate over
+	// consecutive positions, which the compiler can vectorize without reordering additions
+	float *correlation = plc_correlator->correlation;
+	uint32_t block_positions = plc_correlator->block_positions;
+	memset(correlation, 0, block_positions * sizeof(float));
+	uint32_t n;
+	for (n = 0; n < plc_correlator->template_count; n++)
+	{
+		const float *block = plc_correlator->block + n;
+		float tap = plc_correlator->template_samples[n];
+		uint32_t k;
+		for (k = 0; k < block_positions; k++)
+			correlation[k] += block[k] * tap;
+	}
+}
+
+static void correlator_correlate_fft(struct plc_correlator *plc_correlator)
+{
+	fftwf_execute(plc_correlator->plan_forward);
+	// Correlation = IFFT(X * conj(T)). Only the first 'block_positions' outputs are free of the
+	// circular aliasing
+	uint32_t spectrum_count = plc_correlator->block_size / 2 + 1;
+	fftwf_complex *x = plc_correlator->spectrum;
+	fftwf_complex *t = plc_correlator->template_spectrum;
+	uint32_t n;
+	for (n = 0; n < spectrum_count; n++)
+	{
+		float re = x[n][0] * t[n][0] + x[n][1] * t[n][1];
+		float im = x[n][1] * t[n][0] - x[n][0] * t[n][1];
+		x[n][0] = re;
+		x[n][1] = im;
+	}
+	fftwf_execute(plc_correlator->plan_backward);
+}
+
+// Returns the number of peaks stored in 'peaks' and accumulates into 'peaks_discarded' the ones
+//	not fitting in
+static uint32_t correlator_process_block(struct plc_correlator *plc_correlator,
+		struct plc_correlator_peak *peaks, uint32_t peaks_max, uint32_t *peaks_discarded)
+{
+	if (plc_correlator->method == plc_correlator_method_fft)
+		correlator_correlate_fft(plc_correlator);
+	else
+		correlator_correlate_direct(plc_correlator);
+	// Normalize with the energy of each window, updated incrementally
+	uint32_t template_count = plc_correlator->template_count;
+	const float *block = plc_correlator->block;
+	double window_sum = 0.0;
+	double window_sum2 = 0.0;
+	uint32_t n;
+	for (n = 0; n < template_count - 1; n++)
+	{
+		window_sum += block[n];
+		window_sum2 += (double) block[n] * block[n];
+	}
+	uint32_t peaks_count = 0;
+	uint32_t k;
+	for (k = 0; k < plc_correlator->block_positions; k++)
+	{
+		double sample_new = block[k + template_count - 1];
+		window_sum += sample_new;
+		window_sum2 += sample_new * sample_new;
+		double energy = window_sum2 - window_sum * window_sum / template_count;
+		float score = 0.0f;
+		if (energy > window_sum2 * CORRELATOR_ENERGY_EPSILON)
+			score = plc_correlator->correlation[k] / (plc_correlator->template_norm * sqrt(energy));
+		double sample_old = block[k];
+		window_sum -= sample_old;
+		window_sum2 -= sample_old * sample_old;
+		if (score >= plc_correlator->threshold)
+		{
+			if (!plc_correlator->peak_open || (score > plc_correlator->peak.score))
+			{
+				plc_correlator->peak.position = plc_correlator->block_position + k;
+				plc_correlator->peak.score = score;
+				plc_correlator->peak_open = 1;
+			}
+		}
+		else if (plc_correlator->peak_open)
+		{
+			if (peaks_count < peaks_max)
+				peaks[peaks_count++] = plc_correlator->peak;
+			else
+				(*peaks_discarded)++;
+			plc_correlator->peak_open = 0;
+		}
+	}
+	// Keep the samples still required by the next windows
+	memmove(plc_correlator->block, plc_correlator->block + plc_correlator->block_positions,
+			(template_count - 1) * sizeof(float));
+	plc_correlator->block_count = template_count - 1;
+	plc_correlator->block_position += plc_correlator->block_positions;
+	return peaks_count;
+}
+
+ATTR_EXTERN uint32_t plc_correlator_process(struct plc_correlator *plc_correlator,
+		const float *samples, uint32_t samples_count, struct plc_correlator_peak *peaks,
+		uint32_t peaks_max, uint32_t *peaks_discarded)
+{
+	uint32_t peaks_count = 0;
+	*peaks_discarded = 0;
+	while (samples_count > 0)
+	{
+		uint32_t samples_to_copy = plc_correlator->block_size - plc_correlator->block_count;
+		if (samples_to_copy > samples_count)
+			samples_to_copy = samples_count;
+		memcpy(plc_correlator->block + plc_correlator->block_count, samples,
+				samples_to_copy * sizeof(float));
+		plc_correlator->block_count += samples_to_copy;
+		samples += samples_to_copy;
+		samples_count -= samples_to_copy;
+		if (plc_correlator->block_count == plc_correlator->block_size)
+			peaks_count += correlator_process_block(plc_correlator, peaks + peaks_count,
+					peaks_max - peaks_count, peaks_discarded);
+	}
+	return peaks_count;
+}
+
+ATTR_EXTERN uint32_t plc_correlator_process_rx(struct plc_correlator *plc_correlator,
+		const sample_rx_t *samples, uint32_t samples_count, struct plc_correlator_peak *peaks,
+		uint32_t peaks_max, uint32_t *peaks_discarded)
+{
+	uint32_t peaks_count = 0;
+	*peaks_discarded = 0;
+	while (samples_count > 0)
+	{
+		uint32_t samples_to_copy = plc_correlator->block_size - plc_correlator->block_count;
+		if (samples_to_copy > samples_count)
+			samples_to_copy = samples_count;
+		float *block_cur = plc_correlator->block + plc_correlator->block_count;
+		uint32_t n;
+		for (n = 0; n < samples_to_copy; n++)
+			block_cur[n] = samples[n];
+		plc_correlator->block_count += samples_to_copy;
+		samples += samples_to_copy;
+		samples_count -= samples_to_copy;
+		if (plc_correlator->block_count == plc_correlator->block_size)
+			peaks_count += correlator_process_block(plc_correlator, peaks + peaks_count,
+					peaks_max - peaks_count, peaks_discarded);
+	}
+	return peaks_count;
+}
@@ -11,9 +11,9 @@
 #include <err.h>		// warnx
 #include <errno.h>		// errno
 #include <fcntl.h>		// S_IRUSR
-#include <locale.h>		// set_locale
+#include <math.h>		// isnan
 #include <stdarg.h>		// va_start
-#include <unistd.h>		// va_start
+#include <unistd.h>		// write
 #include "+common/api/+base.h"
 #include "api/file.h"
 
@@ -68,6 +68,104 @@ void set_error(const char *msg)
 	warnx("%s", msg);
 }
 
+// Size of the user-space buffer of the CSV writer. Flushed to disk when full
+#define CSV_BUFFER_SIZE (128*1024)
+// Upper bound of the text of one line (two floats of max magnitude and their separators)
+#define CSV_LINE_MAX_LEN 128
+
+static const char csv_digit_pairs[201] =
+		"00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+		"40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+		"8081828384858687888990919293949596979899";
+
+struct plc_file_csv
+{
+	int file;
+	// 'errno' of the first error. Once set the subsequent operations are ignored
+	int error;
+	uint32_t buffer_len;
+	char buffer[CSV_BUFFER_SIZE];
+};
+
+// Locale-independent equivalent to '%u'. Returns the end of the generated text
+static char *csv_format_uint(char *text, uint64_t value)
+{
+	char digits[20];
+	char *digit = digits + sizeof(digits);
+	while (value >= 100)
+	{
+		const char *pair = csv_digit_pairs + 2 * (value % 100);
+		value /= 100;
+		*--digit = pair[1];
+		*--digit = pair[0];
+	}
+	if (value >= 10)
+	{
+		const char *pair = csv_digit_pairs + 2 * value;
+		*--digit = pair[1];
+		*--digit = pair[0];
+	}
+	else
+	{
+		*--digit = '0' + value;
+	}
+	uint32_t len = digits + sizeof(digits) - digit;
+	memcpy(text, digit, len);
+	return text + len;
+}
+
+// Locale-independent equivalent to '%f' (always '.' as decimal point, 6 decimals, same rounding)
+static char *csv_format_float(char *text, float value)
+{
+	if (isnan(value))
+	{
+		if (signbit(value))
+			*text++ = '-';
+		memcpy(text, "nan", 3);
+		return text + 3;
+	}
+	if (signbit(value))
+	{
+		*text++ = '-';
+		value = -value;
+	}
+	if (isinf(value))
+	{
+		memcpy(text, "inf", 3);
+		return text + 3;
+	}
+	if (value >= 4294967296.0f)
+	{
+		// A float so big has no fractional part. '%.0f' doesn't use the decimal point
+		text += sprintf(text, "%.0f", value);
+		memcpy(text, ".000000", 7);
+		return text + 7;
+	}
+	// The mantissa of a float has 24 bits and 1e6 = 15625 * 2^6 needs 14 bits so the fractional
+	//	part scaled by 1e6 is exact in double precision. Then round half to even as 'printf' does
+	uint64_t integer_part = (uint32_t) value;
+	double fraction = ((double) value - integer_part) * 1e6;
+	uint32_t decimals = (uint32_t) fraction;
+	double remainder = fraction - decimals;
+	if ((remainder > 0.5) || ((remainder == 0.5) && (decimals & 1)))
+	{
+		if (++decimals == 1000000)
+		{
+			decimals = 0;
+			integer_part++;
+		}
+	}
+	text = csv_format_uint(text, integer_part);
+	*text++ = '.';
+	int n;
+	for (n = 2; n >= 0; n--)
+	{
+		memcpy(text + 2 * n, csv_digit_pairs + 2 * (decimals % 100), 2);
+		decimals /= 100;
+	}
+	return text + 6;
+}
+
 float csv_buffer_item_to_float_u8(void *buffer_item)
 {
 	return *(uint8_t*) buffer_item;
@@ -91,23 +189,22 @@ float csv_buffer_item_to_float_float(void *buffer_item)
 // PRECONDITION: 'line' with enough allocated length
 int csv_buffer_item_to_text_u8(char *line, void *buffer_item)
 {
-	// Casting to 'uint16_t' for safety as it's the type expected by the '%hu'
-	return sprintf(line, "%hu", (uint16_t) *(uint8_t*) buffer_item);
+	return csv_format_uint(line, *(uint8_t*) buffer_item) - line;
 }
 
 int csv_buffer_item_to_text_u16(char *line, void *buffer_item)
 {
-	return sprintf(line, "%hu", *(uint16_t*) buffer_item);
+	return csv_format_uint(line, *(uint16_t*) buffer_item) - line;
 }
 
 int csv_buffer_item_to_text_u32(char *line, void *buffer_item)
 {
-	return sprintf(line, "%u", *(uint32_t*) buffer_item);
+	return csv_format_uint(line, *(uint32_t*) buffer_item) - line;
 }
 
 int csv_buffer_item_to_text_float(char *line, void *buffer_item)
 {
-	return sprintf(line, "%f", *(float*) buffer_item);
+	return csv_format_float(line, *(float*) buffer_item) - line;
 }
 
 void csv_get_buffer_type_data(enum csv_type_enum csv_type_enum, uint32_t *buffer_item_size,
@@ -153,49 +250,148 @@ void csv_get_buffer_type_data(enum csv_type_enum csv_type_enum, uint32_t *buffer
 		*buffer_item_to_text = item_to_text;
 }
 
-ATTR_EXTERN int plc_file_write_csv(const char *filename, enum csv_type_enum csv_type_enum,
-		void *buffer, uint32_t buffer_count, int append)
+static int plc_file_csv_flush(struct plc_file_csv *plc_file_csv)
+{
+	const char *data = plc_file_csv->buffer;
+	uint32_t len = plc_file_csv->buffer_len;
+	plc_file_csv->buffer_len = 0;
+	while (len > 0)
+	{
+		ssize_t bytes_written = write(plc_file_csv->file, data, len);
+		if (bytes_written < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			plc_file_csv->error = errno;
+			return -1;
+		}
+		data += bytes_written;
+		len -= bytes_written;
+	}
+	return 0;
+}
+
+// Returns where to write the next item, having room for at least CSV_LINE_MAX_LEN bytes
+static inline char *plc_file_csv_reserve(struct plc_file_csv *plc_file_csv)
+{
+	if (plc_file_csv->buffer_len > CSV_BUFFER_SIZE - CSV_LINE_MAX_LEN)
+		plc_file_csv_flush(plc_file_csv);
+	return plc_file_csv->buffer + plc_file_csv->buffer_len;
+}
+
+static inline int plc_file_csv_commit(struct plc_file_csv *plc_file_csv, char *end)
+{
+	if (plc_file_csv->error)
+	{
+		errno = plc_file_csv->error;
+		return -1;
+	}
+	plc_file_csv->buffer_len = end - plc_file_csv->buffer;
+	return 0;
+}
+
+ATTR_EXTERN struct plc_file_csv *plc_file_csv_open(const char *filename, int append)
 {
-	uint32_t buffer_item_size;
-	int (*buffer_item_to_text)(char *line, void *buffer_item);
-	csv_get_buffer_type_data(csv_type_enum, &buffer_item_size, NULL, &buffer_item_to_text);
 	mode_t mode = S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH;
 	int file = open(filename, O_CREAT | O_WRONLY | (append ? O_APPEND : O_TRUNC), mode);
 	if (file < 0)
+		return NULL;
+	struct plc_file_csv *plc_file_csv = malloc(sizeof(struct plc_file_csv));
+	if (plc_file_csv == NULL)
 	{
+		close(file);
+		errno = ENOMEM;
+		return NULL;
+	}
+	plc_file_csv->file = file;
+	plc_file_csv->error = 0;
+	plc_file_csv->buffer_len = 0;
+	return plc_file_csv;
+}
+
+ATTR_EXTERN int plc_file_csv_close(struct plc_file_csv *plc_file_csv)
+{
+	if (!plc_file_csv->error)
+		plc_file_csv_flush(plc_file_csv);
+	if ((close(plc_file_csv->file) < 0) && !plc_file_csv->error)
+		plc_file_csv->error = errno;
+	int last_error = plc_file_csv->error;
+	free(plc_file_csv);
+	if (last_error)
+	{
+		errno = last_error;
 		return -1;
 	}
-	else
+	return 0;
+}
+
+ATTR_EXTERN int plc_file_csv_add_uint(struct plc_file_csv *plc_file_csv, uint32_t value,
+		char separator)
+{
+	char *text = csv_format_uint(plc_file_csv_reserve(plc_file_csv), value);
+	*text++ = separator;
+	return plc_file_csv_commit(plc_file_csv, text);
+}
+
+ATTR_EXTERN int plc_file_csv_add_float(struct plc_file_csv *plc_file_csv, float value,
+		char separator)
+{
+	char *text = csv_format_float(plc_file_csv_reserve(plc_file_csv), value);
+	*text++ = separator;
+	return plc_file_csv_commit(plc_file_csv, text);
+}
+
+ATTR_EXTERN int plc_file_csv_add_items(struct plc_file_csv *plc_file_csv,
+		enum csv_type_enum csv_type_enum, void *buffer, uint32_t buffer_count)
+{
+	uint32_t buffer_item_size;
+	int (*buffer_item_to_text)(char *line, void *buffer_item);
+	csv_get_buffer_type_data(csv_type_enum, &buffer_item_size, NULL, &buffer_item_to_text);
+	for (; buffer_count > 0; buffer_count--)
 	{
-		int last_error = 0;
-		char *prev_locale = strdup(setlocale(LC_NUMERIC, NULL));
-		// Functions like 'printf' use the local information to print decimal points
-		//	In European locale it means a ','. By default Octave uses '.' so let's force it
-		char *locale = setlocale(LC_NUMERIC, "POSIX");
-		assert(locale != NULL);
-		for (; buffer_count > 0; buffer_count--)
-		{
-			char line[32];
-			int len = buffer_item_to_text(line, buffer);
-			line[len++] = '\n';
-			buffer += buffer_item_size;
-			int bytes_written = write(file, line, len);
-			if (bytes_written < 0)
-			{
-				last_error = errno;
-				break;
-			}
-			assert(bytes_written == len);
-		}
-		locale = setlocale(LC_NUMERIC, prev_locale);
-		assert(locale != NULL);
-		if (last_error)
-		{
-			errno = last_error;
+		char *line = plc_file_csv_reserve(plc_file_csv);
+		line += buffer_item_to_text(line, buffer);
+		*line++ = '\n';
+		buffer += buffer_item_size;
+		if (plc_file_csv_commit(plc_file_csv, line) < 0)
 			return -1;
-		}
-		return 0;
 	}
+	return 0;
+}
+
+ATTR_EXTERN char *plc_file_csv_format_items(char *text, enum csv_type_enum csv_type_enum,
+		const void *buffer, uint32_t buffer_count)
+{
+	uint32_t buffer_item_size;
+	int (*buffer_item_to_text)(char *line, void *buffer_item);
+	csv_get_buffer_type_data(csv_type_enum, &buffer_item_size, NULL, &buffer_item_to_text);
+	for (; buffer_count > 0; buffer_count--, buffer += buffer_item_size)
+	{
+		text += buffer_item_to_text(text, (void*) buffer);
+		*text++ = '\n';
+	}
+	return text;
+}
+
+// Closes the file preserving the 'errno' of a previous error
+static int plc_file_csv_close_with_result(struct plc_file_csv *plc_file_csv, int result)
+{
+	int last_error = errno;
+	if ((plc_file_csv_close(plc_file_csv) < 0) && (result == 0))
+		return -1;
+	if (result < 0)
+		errno = last_error;
+	return result;
+}
+
+ATTR_EXTERN int plc_file_write_csv(const char *filename, enum csv_type_enum csv_type_enum,
+		void *buffer, uint32_t buffer_count, int append)
+{
+	struct plc_file_csv *plc_file_csv = plc_file_csv_open(filename, append);
+	if (plc_file_csv == NULL)
+		return -1;
+	int ret = plc_file_csv_add_items(plc_file_csv, csv_type_enum, buffer, buffer_count);
+	return plc_file_csv_close_with_result(plc_file_csv, ret);
 }
 
 ATTR_EXTERN int plc_file_write_csv_units(const char *filename, enum csv_type_enum csv_type_enum,
@@ -204,47 +400,24 @@ ATTR_EXTERN int plc_file_write_csv_units(const char *filename, enum csv_type_enu
 {
 	uint32_t buffer_item_size;
 	float (*buffer_item_to_float)(void *buffer_item);
-	int (*buffer_item_to_text)(char *line, void *buffer_item);
-	csv_get_buffer_type_data(csv_type_enum, &buffer_item_size, &buffer_item_to_float,
-			&buffer_item_to_text);
-	mode_t mode = S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH;
-	int file = open(filename, O_CREAT | O_WRONLY | (append ? O_APPEND : O_TRUNC), mode);
-	if (file < 0)
-	{
+	csv_get_buffer_type_data(csv_type_enum, &buffer_item_size, &buffer_item_to_float, NULL);
+	struct plc_file_csv *plc_file_csv = plc_file_csv_open(filename, append);
+	if (plc_file_csv == NULL)
 		return -1;
-	}
-	else
+	int ret = 0;
+	float x = 0.0;
+	float y_offset = buffer_item_to_float(buffer_zero_ref);
+	for (; (buffer_count > 0) && (ret == 0); buffer_count--, x += sample_to_unit_x)
 	{
-		int last_error = 0;
-		char *prev_locale = strdup(setlocale(LC_NUMERIC, NULL));
-		char *locale = setlocale(LC_NUMERIC, "POSIX");
-		assert(locale != NULL);
-		float x = 0.0;
-		float y_offset = buffer_item_to_float(buffer_zero_ref);
-		for (; buffer_count > 0; buffer_count--, x += sample_to_unit_x)
-		{
-			char line[64];
-			int len = sprintf(line, "%f %f\n", x,
-					(buffer_item_to_float(buffer) - y_offset) * sample_to_unit_y);
-			buffer += buffer_item_size;
-			int bytes_written = write(file, line, len);
-			if (bytes_written < 0)
-			{
-				last_error = errno;
-				break;
-			}
-			assert(bytes_written == len);
-		}
-		close(file);
-		locale = setlocale(LC_NUMERIC, prev_locale);
-		assert(locale != NULL);
-		if (last_error)
-		{
-			errno = last_error;
-			return -1;
-		}
-		return 0;
+		char *line = plc_file_csv_reserve(plc_file_csv);
+		line = csv_format_float(line, x);
+		*line++ = ' ';
+		line = csv_format_float(line, (buffer_item_to_float(buffer) - y_offset) * sample_to_unit_y);
+		*line++ = '\n';
+		buffer += buffer_item_size;
+		ret = plc_file_csv_commit(plc_file_csv, line);
 	}
+	return plc_file_csv_close_with_result(plc_file_csv, ret);
 }
 
 ATTR_EXTERN int plc_file_write_csv_xy(const char *filename, enum csv_type_enum csv_type_enum_x,
@@ -256,43 +429,20 @@ ATTR_EXTERN int plc_file_write_csv_xy(const char *filename, enum csv_type_enum c
 	int (*buffer_item_to_text_y)(char *line, void *buffer_item);
 	csv_get_buffer_type_data(csv_type_enum_x, &buffer_item_size_x, NULL, &buffer_item_to_text_x);
 	csv_get_buffer_type_data(csv_type_enum_y, &buffer_item_size_y, NULL, &buffer_item_to_text_y);
-	mode_t mode = S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH;
-	int file = open(filename, O_CREAT | O_WRONLY | (append ? O_APPEND : O_TRUNC), mode);
-	if (file < 0)
-	{
+	struct plc_file_csv *plc_file_csv = plc_file_csv_open(filename, append);
+	if (plc_file_csv == NULL)
 		return -1;
-	}
-	else
+	int ret = 0;
+	for (; (buffer_count > 0) && (ret == 0); buffer_count--)
 	{
-		int last_error = 0;
-		char *prev_locale = strdup(setlocale(LC_NUMERIC, NULL));
-		char *locale = setlocale(LC_NUMERIC, "POSIX");
-		assert(locale != NULL);
-		for (; buffer_count > 0; buffer_count--)
-		{
-			char line[64];
-			int len = buffer_item_to_text_x(line, buffer_x);
-			line[len++] = ' ';
-			buffer_x += buffer_item_size_x;
-			len += buffer_item_to_text_y(line + len, buffer_y);
-			line[len++] = '\n';
-			buffer_y += buffer_item_size_y;
-			int bytes_written = write(file, line, len);
-			if (bytes_written < 0)
-			{
-				last_error = errno;
-				break;
-			}
-			assert(bytes_written == len);
-		}
-		close(file);
-		locale = setlocale(LC_NUMERIC, prev_locale);
-		assert(locale != NULL);
-		if (last_error)
-		{
-			errno = last_error;
-			return -1;
-		}
-		return 0;
+		char *line = plc_file_csv_reserve(plc_file_csv);
+		line += buffer_item_to_text_x(line, buffer_x);
+		*line++ = ' ';
+		buffer_x += buffer_item_size_x;
+		line += buffer_item_to_text_y(line, buffer_y);
+		*line++ = '\n';
+		buffer_y += buffer_item_size_y;
+		ret = plc_file_csv_commit(plc_file_csv, line);
 	}
+	return plc_file_csv_close_with_result(plc_file_csv, ret);
 }
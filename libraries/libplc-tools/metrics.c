@@ -0,0 +1,510 @@
+/**
+ * @file
+ *
+ * @cond COPYRIGHT_NOTES @copyright
+ *	Copyright (C) 2017 Jose Maria Ortega\n
+ *	Distributed under the GNU GPLv3. For full terms see the file LICENSE
+ * @endcond
+ */
+
+#include <errno.h>
+#include <fcntl.h>			// open
+#include <inttypes.h>		// PRId64
+#include <poll.h>			// poll
+#include <pthread.h>		// pthread_create
+#include <stdarg.h>			// va_list
+#include <sys/socket.h>		// socket
+#include <sys/stat.h>		// S_IRUSR
+#include <sys/un.h>			// sockaddr_un
+#include <unistd.h>			// pipe
+#include "+common/api/+base.h"
+#include "api/metrics.h"
+#include "api/time.h"
+
+// Initial size of the snapshot buffer. Grown on demand
+#define METRICS_TEXT_SIZE_DEFAULT 8192
+#define METRICS_SOCKET_BACKLOG 4
+
+enum plc_metric_type_enum
+{
+	plc_metric_type_counter = 0,
+	plc_metric_type_gauge,
+	plc_metric_type_histogram,
+};
+
+struct plc_metric
+{
+	enum plc_metric_type_enum type;
+	char *name;
+	char *help;
+	// Counter or gauge value. Updated atomically
+	int64_t value;
+	// Histogram. 'buckets' not cumulated, with the '+Inf' one at 'bounds_count'
+	uint32_t bounds_count;
+	int64_t bounds[PLC_METRICS_HISTOGRAM_BOUNDS_MAX];
+	int64_t buckets[PLC_METRICS_HISTOGRAM_BOUNDS_MAX + 1];
+	int64_t sum;
+};
+
+struct plc_metrics
+{
+	char *prefix;
+	struct plc_metric metrics[PLC_METRICS_MAX];
+	uint32_t metrics_count;
+	plc_metrics_collect_callback_t collect_callback;
+	void *collect_callback_data;
+	// Exporter
+	int exporting;
+	pthread_t thread;
+	enum plc_metrics_format_enum format;
+	char *file_path;
+	char *file_path_tmp;
+	char *socket_path;
+	uint32_t interval_ms;
+	int socket;
+	// Written on stop to wake up the exporter thread
+	int wake_pipe[2];
+	char *text;
+	size_t text_size;
+};
+
+ATTR_EXTERN struct plc_metrics *plc_metrics_create(const char *prefix)
+{
+	struct plc_metrics *plc_metrics = calloc(1, sizeof(struct plc_metrics));
+	plc_metrics->prefix = strdup(prefix ? prefix : "");
+	plc_metrics->socket = -1;
+	return plc_metrics;
+}
+
+ATTR_EXTERN void plc_metrics_release(struct plc_metrics *plc_metrics)
+{
+	plc_metrics_stop_export(plc_metrics);
+	uint32_t n;
+	for (n = 0; n < plc_metrics->metrics_count; n++)
+	{
+		free(plc_metrics->metrics[n].name);
+		free(plc_metrics->metrics[n].help);
+	}
+	free(plc_metrics->prefix);
+	free(plc_metrics);
+}
+
+static struct plc_metric *plc_metrics_add(struct plc_metrics *plc_metrics,
+		enum plc_metric_type_enum type, const char *name, const char *help)
+{
+	assert(!plc_metrics->exporting);
+	if (plc_metrics->metrics_count >= PLC_METRICS_MAX)
+		return NULL;
+	struct plc_metric *plc_metric = &plc_metrics->metrics[plc_metrics->metrics_count++];
+	plc_metric->type = type;
+	plc_metric->name = strdup(name);
+	plc_metric->help = strdup(help);
+	return plc_metric;
+}
+
+ATTR_EXTERN struct plc_metric *plc_metrics_add_counter(struct plc_metrics *plc_metrics,
+		const char *name, const char *help)
+{
+	return plc_metrics_add(plc_metrics, plc_metric_type_counter, name, help);
+}
+
+ATTR_EXTERN struct plc_metric *plc_metrics_add_gauge(struct plc_metrics *plc_metrics,
+		const char *name, const char *help)
+{
+	return plc_metrics_add(plc_metrics, plc_metric_type_gauge, name, help);
+}
+
+ATTR_EXTERN struct plc_metric *plc_metrics_add_histogram(struct plc_metrics *plc_metrics,
+		const char *name, const char *help, const int64_t *bounds, uint32_t bounds_count)
+{
+	assert(bounds_count <= PLC_METRICS_HISTOGRAM_BOUNDS_MAX);
+	struct plc_metric *plc_metric =
+			plc_metrics_add(plc_metrics, plc_metric_type_histogram, name, help);
+	if (plc_metric)
+	{
+		plc_metric->bounds_count = bounds_count;
+		memcpy(plc_metric->bounds, bounds, bounds_count * sizeof(*bounds));
+	}
+	return plc_metric;
+}
+
+ATTR_EXTERN void plc_metric_add(struct plc_metric *plc_metric, uint64_t increment)
+{
+	if (plc_metric)
+		__atomic_fetch_add(&plc_metric->value, (int64_t) increment, __ATOMIC_RELAXED);
+}
+
+ATTR_EXTERN void plc_metric_set(struct plc_metric *plc_metric, int64_t value)
+{
+	if (plc_metric)
+		__atomic_store_n(&plc_metric->value, value, __ATOMIC_RELAXED);
+}
+
+ATTR_EXTERN void plc_metric_observe(struct plc_metric *plc_metric, int64_t value)
+{
+	if (plc_metric == NULL)
+		return;
+	// Few buckets -> linear search
+	uint32_t n;
+	for (n = 0; n < plc_metric->bounds_count; n++)
+		if (value <= plc_metric->bounds[n])
+			break;
+	__atomic_fetch_add(&plc_metric->buckets[n], 1, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&plc_metric->sum, value, __ATOMIC_RELAXED);
+}
+
+ATTR_EXTERN void plc_metrics_reset(struct plc_metrics *plc_metrics)
+{
+	uint32_t n;
+	for (n = 0; n < plc_metrics->metrics_count; n++)
+	{
+		struct plc_metric *plc_metric = &plc_metrics->metrics[n];
+		__atomic_store_n(&plc_metric->value, 0, __ATOMIC_RELAXED);
+		__atomic_store_n(&plc_metric->sum, 0, __ATOMIC_RELAXED);
+		uint32_t b;
+		for (b = 0; b <= plc_metric->bounds_count; b++)
+			__atomic_store_n(&plc_metric->buckets[b], 0, __ATOMIC_RELAXED);
+	}
+}
+
+ATTR_EXTERN void plc_metrics_set_collect_callback(struct plc_metrics *plc_metrics,
+		plc_metrics_collect_callback_t callback, void *callback_data)
+{
+	plc_metrics->collect_callback = callback;
+	plc_metrics->collect_callback_data = callback_data;
+}
+
+// Appends to 'text' as 'snprintf' does, accounting the full length even when not fitting
+static void metrics_append(char *text, size_t text_size, size_t *length, const char *format, ...)
+{
+	va_list args;
+	va_start(args, format);
+	int ret = (*length < text_size) ?
+			vsnprintf(text + *length, text_size - *length, format, args) :
+			vsnprintf(NULL, 0, format, args);
+	va_end(args);
+	assert(ret >= 0);
+	*length += ret;
+}
+
+static const char *metrics_type_name(enum plc_metric_type_enum type)
+{
+	switch (type)
+	{
+	case plc_metric_type_counter:
+		return "counter";
+	case plc_metric_type_gauge:
+		return "gauge";
+	case plc_metric_type_histogram:
+		return "histogram";
+	default:
+		assert(0);
+		return "untyped";
+	}
+}
+
+static void metrics_format_prometheus(struct plc_metrics *plc_metrics, char *text,
+		size_t text_size, size_t *length)
+{
+	const char *prefix = plc_metrics->prefix;
+	uint32_t n;
+	for (n = 0; n < plc_metrics->metrics_count; n++)
+	{
+		struct plc_metric *plc_metric = &plc_metrics->metrics[n];
+		const char *name = plc_metric->name;
+		metrics_append(text, text_size, length, "# HELP %s%s %s\n# TYPE %s%s %s\n", prefix, name,
+				plc_metric->help, prefix, name, metrics_type_name(plc_metric->type));
+		if (plc_metric->type == plc_metric_type_histogram)
+		{
+			int64_t cumulated = 0;
+			uint32_t b;
+			for (b = 0; b < plc_metric->bounds_count; b++)
+			{
+				cumulated += __atomic_load_n(&plc_metric->buckets[b], __ATOMIC_RELAXED);
+				metrics_append(text, text_size, length, "%s%s_bucket{le=\"%" PRId64 "\"} %"
+						PRId64 "\n", prefix, name, plc_metric->bounds[b], cumulated);
+			}
+			cumulated += __atomic_load_n(&plc_metric->buckets[b], __ATOMIC_RELAXED);
+			metrics_append(text, text_size, length, "%s%s_bucket{le=\"+Inf\"} %" PRId64 "\n"
+					"%s%s_sum %" PRId64 "\n%s%s_count %" PRId64 "\n", prefix, name, cumulated,
+					prefix, name, __atomic_load_n(&plc_metric->sum, __ATOMIC_RELAXED), prefix,
+					name, cumulated);
+		}
+		else
+		{
+			metrics_append(text, text_size, length, "%s%s %" PRId64 "\n", prefix, name,
+					__atomic_load_n(&plc_metric->value, __ATOMIC_RELAXED));
+		}
+	}
+}
+
+static void metrics_format_json(struct plc_metrics *plc_metrics, char *text, size_t text_size,
+		size_t *length)
+{
+	const char *prefix = plc_metrics->prefix;
+	metrics_append(text, text_size, length, "{");
+	uint32_t n;
+	for (n = 0; n < plc_metrics->metrics_count; n++)
+	{
+		struct plc_metric *plc_metric = &plc_metrics->metrics[n];
+		metrics_append(text, text_size, length, "%s\n\t\"%s%s\": ", (n > 0) ? "," : "", prefix,
+				plc_metric->name);
+		if (plc_metric->type == plc_metric_type_histogram)
+		{
+			int64_t cumulated = 0;
+			metrics_append(text, text_size, length, "{ \"buckets\": { ");
+			uint32_t b;
+			for (b = 0; b < plc_metric->bounds_count; b++)
+			{
+				cumulated += __atomic_load_n(&plc_metric->buckets[b], __ATOMIC_RELAXED);
+				metrics_append(text, text_size, length, "\"%" PRId64 "\": %" PRId64 ", ",
+						plc_metric->bounds[b], cumulated);
+			}
+			cumulated += __atomic_load_n(&plc_metric->buckets[b], __ATOMIC_RELAXED);
+			metrics_append(text, text_size, length, "\"+Inf\": %" PRId64 " }, \"sum\": %" PRId64
+					", \"count\": %" PRId64 " }", cumulated,
+					__atomic_load_n(&plc_metric->sum, __ATOMIC_RELAXED), cumulated);
+		}
+		else
+		{
+			metrics_append(text, text_size, length, "%" PRId64,
+					__atomic_load_n(&plc_metric->value, __ATOMIC_RELAXED));
+		}
+	}
+	metrics_append(text, text_size, length, "\n}\n");
+}
+
+ATTR_EXTERN size_t plc_metrics_format(struct plc_metrics *plc_metrics,
+		enum plc_metrics_format_enum format, char *text, size_t text_size)
+{
+	size_t length = 0;
+	if (text_size > 0)
+		*text = '\0';
+	switch (format)
+	{
+	case plc_metrics_format_prometheus:
+		metrics_format_prometheus(plc_metrics, text, text_size, &length);
+		break;
+	case plc_metrics_format_json:
+		metrics_format_json(plc_metrics, text, text_size, &length);
+		break;
+	default:
+		assert(0);
+		break;
+	}
+	return length;
+}
+
+// Collects and formats a snapshot in 'plc_metrics->text'. Returns its length
+static size_t metrics_take_snapshot(struct plc_metrics *plc_metrics)
+{
+	if (plc_metrics->collect_callback)
+		plc_metrics->collect_callback(plc_metrics->collect_callback_data, plc_metrics);
+	size_t length = plc_metrics_format(plc_metrics, plc_metrics->format, plc_metrics->text,
+			plc_metrics->text_size);
+	if (length >= plc_metrics->text_size)
+	{
+		plc_metrics->text_size = length + 1;
+		plc_metrics->text = realloc(plc_metrics->text, plc_metrics->text_size);
+		length = plc_metrics_format(plc_metrics, plc_metrics->format, plc_metrics->text,
+				plc_metrics->text_size);
+		// Values may have grown in length meanwhile
+		if (length >= plc_metrics->text_size)
+			length = plc_metrics->text_size - 1;
+	}
+	return length;
+}
+
+// Written to a temporary file and renamed for the readers to never see a partial snapshot
+static void metrics_write_file(struct plc_metrics *plc_metrics)
+{
+	size_t length = metrics_take_snapshot(plc_metrics);
+	mode_t mode = S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH;
+	int file = open(plc_metrics->file_path_tmp, O_CREAT | O_WRONLY | O_TRUNC, mode);
+	if (file < 0)
+		return;
+	const char *data = plc_metrics->text;
+	while (length > 0)
+	{
+		ssize_t bytes_written = write(file, data, length);
+		if (bytes_written < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+		data += bytes_written;
+		length -= bytes_written;
+	}
+	close(file);
+	if (length == 0)
+		rename(plc_metrics->file_path_tmp, plc_metrics->file_path);
+	else
+		unlink(plc_metrics->file_path_tmp);
+}
+
+static void metrics_serve_client(struct plc_metrics *plc_metrics)
+{
+	int client = accept(plc_metrics->socket, NULL, NULL);
+	if (client < 0)
+		return;
+	size_t length = metrics_take_snapshot(plc_metrics);
+	// The snapshot fits in the socket buffer. Not blocking on clients not reading it
+	const char *data = plc_metrics->text;
+	while (length > 0)
+	{
+		ssize_t bytes_sent = send(client, data, length, MSG_DONTWAIT | MSG_NOSIGNAL);
+		if (bytes_sent < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+		data += bytes_sent;
+		length -= bytes_sent;
+	}
+	close(client);
+}
+
+static void *metrics_export_thread(void *arg)
+{
+	struct plc_metrics *plc_metrics = arg;
+	struct pollfd fds[2];
+	fds[0].fd = plc_metrics->wake_pipe[0];
+	fds[0].events = POLLIN;
+	// Negative descriptors are ignored by 'poll'
+	fds[1].fd = plc_metrics->socket;
+	fds[1].events = POLLIN;
+	uint32_t tick_next_file_ms = plc_time_get_tick_ms();
+	for (;;)
+	{
+		int timeout_ms = -1;
+		if (plc_metrics->file_path)
+		{
+			int32_t remaining_ms = (int32_t) (tick_next_file_ms - plc_time_get_tick_ms());
+			timeout_ms = (remaining_ms > 0) ? remaining_ms : 0;
+		}
+		int ret = poll(fds, 2, timeout_ms);
+		if ((ret < 0) && (errno != EINTR))
+			break;
+		if ((ret > 0) && (fds[0].revents != 0))
+			break;
+		if ((ret > 0) && (fds[1].revents & POLLIN))
+			metrics_serve_client(plc_metrics);
+		if (plc_metrics->file_path
+				&& ((int32_t) (tick_next_file_ms - plc_time_get_tick_ms()) <= 0))
+		{
+			metrics_write_file(plc_metrics);
+			tick_next_file_ms += plc_metrics->interval_ms;
+			// Skip the missed periods instead of catching up
+			if ((int32_t) (tick_next_file_ms - plc_time_get_tick_ms()) <= 0)
+				tick_next_file_ms = plc_time_get_tick_ms() + plc_metrics->interval_ms;
+		}
+	}
+	// Final values of the session
+	if (plc_metrics->file_path)
+		metrics_write_file(plc_metrics);
+	return NULL;
+}
+
+static int metrics_open_socket(struct plc_metrics *plc_metrics)
+{
+	struct sockaddr_un address;
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	if (strlen(plc_metrics->socket_path) >= sizeof(address.sun_path))
+	{
+		errno = ENAMETOOLONG;
+		return -1;
+	}
+	strcpy(address.sun_path, plc_metrics->socket_path);
+	int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (fd < 0)
+		return -1;
+	// A socket file remaining from a previous execution would make 'bind' fail
+	unlink(plc_metrics->socket_path);
+	if ((bind(fd, (struct sockaddr*) &address, sizeof(address)) < 0)
+			|| (listen(fd, METRICS_SOCKET_BACKLOG) < 0))
+	{
+		int bind_errno = errno;
+		close(fd);
+		errno = bind_errno;
+		return -1;
+	}
+	plc_metrics->socket = fd;
+	return 0;
+}
+
+static void metrics_release_export_resources(struct plc_metrics *plc_metrics)
+{
+	if (plc_metrics->socket >= 0)
+	{
+		close(plc_metrics->socket);
+		plc_metrics->socket = -1;
+		unlink(plc_metrics->socket_path);
+	}
+	if (plc_metrics->wake_pipe[0] > 0)
+	{
+		close(plc_metrics->wake_pipe[0]);
+		close(plc_metrics->wake_pipe[1]);
+		plc_metrics->wake_pipe[0] = plc_metrics->wake_pipe[1] = 0;
+	}
+	free(plc_metrics->file_path);
+	free(plc_metrics->file_path_tmp);
+	free(plc_metrics->socket_path);
+	free(plc_metrics->text);
+	plc_metrics->file_path = plc_metrics->file_path_tmp = plc_metrics->socket_path = NULL;
+	plc_metrics->text = NULL;
+	plc_metrics->text_size = 0;
+}
+
+ATTR_EXTERN int plc_metrics_start_export(struct plc_metrics *plc_metrics,
+		enum plc_metrics_format_enum format, const char *file_path, const char *socket_path,
+		uint32_t interval_ms)
+{
+	assert(!plc_metrics->exporting);
+	assert(file_path || socket_path);
+	assert(interval_ms > 0);
+	plc_metrics->format = format;
+	plc_metrics->interval_ms = interval_ms;
+	plc_metrics->text_size = METRICS_TEXT_SIZE_DEFAULT;
+	plc_metrics->text = malloc(plc_metrics->text_size);
+	if (file_path)
+	{
+		plc_metrics->file_path = strdup(file_path);
+		plc_metrics->file_path_tmp = malloc(strlen(file_path) + sizeof(".tmp"));
+		sprintf(plc_metrics->file_path_tmp, "%s.tmp", file_path);
+	}
+	if (socket_path)
+	{
+		plc_metrics->socket_path = strdup(socket_path);
+		if (metrics_open_socket(plc_metrics) < 0)
+		{
+			metrics_release_export_resources(plc_metrics);
+			return -1;
+		}
+	}
+	if (pipe(plc_metrics->wake_pipe) < 0)
+	{
+		plc_metrics->wake_pipe[0] = plc_metrics->wake_pipe[1] = 0;
+		metrics_release_export_resources(plc_metrics);
+		return -1;
+	}
+	int ret = pthread_create(&plc_metrics->thread, NULL, metrics_export_thread, plc_metrics);
+	assert(ret == 0);
+	plc_metrics->exporting = 1;
+	return 0;
+}
+
+ATTR_EXTERN void plc_metrics_stop_export(struct plc_metrics *plc_metrics)
+{
+	if (!plc_metrics->exporting)
+		return;
+	char wake = 0;
+	ssize_t bytes_written = write(plc_metrics->wake_pipe[1], &wake, sizeof(wake));
+	assert(bytes_written == sizeof(wake));
+	int ret = pthread_join(plc_metrics->thread, NULL);
+	assert(ret == 0);
+	plc_metrics->exporting = 0;
+	metrics_release_export_resources(plc_metrics);
+}
@@ -9,6 +9,7 @@
 
 #define _GNU_SOURCE		// asprintf
 #include <dirent.h>		// opendir
+#include <dlfcn.h>		// dlopen
 #include "+common/api/+base.h"
 #include "api/application.h"
 #include "api/plugin.h"
@@ -19,6 +20,70 @@
 #define PLUGINS_CATEGORY_DECODER "decoder"
 #define PLUGINS_CATEGORY_UI "ui"
 
+struct plc_plugin
+{
+	// NULL for the static plugins
+	void *so_handle;
+	plugin_api_unload_t api_unload;
+	void *api;
+};
+
+static const struct plc_plugin_static *plugins_static = NULL;
+static uint32_t plugins_static_count = 0;
+
+ATTR_EXTERN void plc_plugin_register_static(const struct plc_plugin_static *plugins,
+		uint32_t plugins_count)
+{
+	plugins_static = plugins;
+	plugins_static_count = plugins_count;
+}
+
+// Compares the first 'plugin_name_len' chars of 'plugin_name' with a static plugin name
+static int plugin_static_name_matches(const char *static_name, const char *plugin_name,
+		size_t plugin_name_len)
+{
+	for (; plugin_name_len > 0; plugin_name_len--, plugin_name++, static_name++)
+		if ((*static_name != *plugin_name) && !((*static_name == '_') && (*plugin_name == '-')))
+			return 0;
+	return (*static_name == '\0');
+}
+
+static const struct plc_plugin_static *plugin_static_find(const char *plugin_name,
+		size_t plugin_name_len)
+{
+	uint32_t n;
+	for (n = 0; n < plugins_static_count; n++)
+		if (plugin_static_name_matches(plugins_static[n].name, plugin_name, plugin_name_len))
+			return &plugins_static[n];
+	return NULL;
+}
+
+// The static plugins not found as dynamic libraries are appended to the list
+static void add_plugins_static(struct plc_plugin_list *plc_plugin_list,
+		enum plc_plugin_category category)
+{
+	uint32_t n;
+	for (n = 0; (n < plugins_static_count)
+			&& (plc_plugin_list->active_index < plc_plugin_list->list_count); n++)
+	{
+		if (plugins_static[n].category != category)
+			continue;
+		char *plugin_name = strdup(plugins_static[n].name);
+		char *c;
+		for (c = plugin_name; *c; c++)
+			if (*c == '_')
+				*c = '-';
+		uint32_t i;
+		for (i = 0; i < plc_plugin_list->active_index; i++)
+			if (strcmp(plc_plugin_list->list[i], plugin_name) == 0)
+				break;
+		if (i == plc_plugin_list->active_index)
+			plc_plugin_list->list[plc_plugin_list->active_index++] = plugin_name;
+		else
+			free(plugin_name);
+	}
+}
+
 const char *plc_plugin_category_get_rel_dir(enum plc_plugin_category category)
 {
 	switch (category)
@@ -99,6 +164,7 @@ ATTR_EXTERN struct plc_plugin_list *plc_plugin_list_create(enum plc_plugin_categ
 	char *plugins_category_abs_dir = plc_plugin_category_get_abs_dir(category);
 	add_plugins(plc_plugin_list, plugins_category_abs_dir);
 	free(plugins_category_abs_dir);
+	add_plugins_static(plc_plugin_list, category);
 	plc_plugin_list->list_count = plc_plugin_list->active_index;
 	plc_plugin_list->active_index = 0;
 	// Truncate the vector releasing the unused memory
@@ -126,3 +192,77 @@ ATTR_EXTERN int plc_plugin_list_find_name(struct plc_plugin_list *plc_plugin_lis
 			return i;
 	return -1;
 }
+
+ATTR_EXTERN struct plc_plugin *plc_plugin_load(const char *path,
+		singletons_provider_get_t singletons_provider_get,
+		singletons_provider_h singletons_provider_handle, void **api, uint32_t *api_version,
+		uint32_t *api_size, char **error_msg)
+{
+	*error_msg = NULL;
+	void *so_handle = NULL;
+	plugin_set_singletons_provider_t plugin_set_singletons_provider;
+	plugin_api_load_t api_load;
+	plugin_api_unload_t api_unload;
+	// A static plugin is identified by the file name without extension
+	const char *plugin_name = strrchr(path, '/');
+	plugin_name = plugin_name ? plugin_name + 1 : path;
+	const char *plugin_name_ext = strrchr(plugin_name, '.');
+	const struct plc_plugin_static *plugin_static = plugin_static_find(plugin_name,
+			plugin_name_ext ? plugin_name_ext - plugin_name : strlen(plugin_name));
+	if (plugin_static)
+	{
+		plugin_set_singletons_provider = plugin_static->set_singletons_provider;
+		api_load = plugin_static->api_load;
+		api_unload = plugin_static->api_unload;
+	}
+	else
+	{
+		so_handle = dlopen(path, RTLD_LAZY);
+		if (!so_handle)
+		{
+			*error_msg = strdup(dlerror());
+			return NULL;
+		}
+		plugin_set_singletons_provider = dlsym(so_handle,
+				PLUGIN_API_SET_SINGLETON_PROVIDER_STRING);
+		api_load = dlsym(so_handle, PLUGIN_API_LOAD_STRING);
+		api_unload = dlsym(so_handle, PLUGIN_API_UNLOAD_STRING);
+		if ((api_load == NULL) || (api_unload == NULL))
+		{
+			asprintf(error_msg, "Invalid plugin: '%s' or '%s' not exported",
+					PLUGIN_API_LOAD_STRING, PLUGIN_API_UNLOAD_STRING);
+			dlclose(so_handle);
+			return NULL;
+		}
+	}
+	// Check for optional 'singletons_provider' management and provide it if accepted by the plugin
+	if (singletons_provider_get && plugin_set_singletons_provider)
+		plugin_set_singletons_provider(singletons_provider_get, singletons_provider_handle);
+	void *plugin_api = api_load(api_version, api_size);
+	// Check that all the functions have been filled by the plugin
+	int functions_count = *api_size / sizeof(void (*)());
+	void **fn_ptr = plugin_api;
+	for (; functions_count > 0; functions_count--, fn_ptr++)
+		if (*fn_ptr == NULL)
+		{
+			*error_msg = strdup("Invalid plugin: some function of the interface is NULL");
+			api_unload(plugin_api);
+			if (so_handle)
+				dlclose(so_handle);
+			return NULL;
+		}
+	struct plc_plugin *plc_plugin = calloc(1, sizeof(struct plc_plugin));
+	plc_plugin->so_handle = so_handle;
+	plc_plugin->api_unload = api_unload;
+	plc_plugin->api = plugin_api;
+	*api = plugin_api;
+	return plc_plugin;
+}
+
+ATTR_EXTERN void plc_plugin_unload(struct plc_plugin *plc_plugin)
+{
+	plc_plugin->api_unload(plc_plugin->api);
+	if (plc_plugin->so_handle)
+		dlclose(plc_plugin->so_handle);
+	free(plc_plugin);
+}
@@ -0,0 +1,66 @@
+/**
+ * @file
+ *
+ * @cond COPYRIGHT_NOTES @copyright
+ *	Copyright (C) 2017 Jose Maria Ortega\n
+ *	Distributed under the GNU GPLv3. For full terms see the file LICENSE
+ * @endcond
+ */
+
+#include "+common/api/+base.h"
+#include "api/prbs.h"
+
+// Fibonacci LFSR: the newest bit is at bit 0 of 'state' and the new bit is the XOR of the bits
+// 'order' and 'tap' bits ago
+struct plc_prbs
+{
+	uint32_t order;
+	uint32_t tap;
+	uint32_t mask;
+	uint32_t state;
+};
+
+static const uint8_t prbs_polynomials[plc_prbs_COUNT][2] = {
+	{ 7, 6 }, { 15, 14 }, { 23, 18 }, { 31, 28 } };
+
+ATTR_EXTERN struct plc_prbs *plc_prbs_create(enum plc_prbs_enum prbs)
+{
+	assert(prbs < plc_prbs_COUNT);
+	struct plc_prbs *plc_prbs = calloc(1, sizeof(struct plc_prbs));
+	plc_prbs->order = prbs_polynomials[prbs][0];
+	plc_prbs->tap = prbs_polynomials[prbs][1];
+	plc_prbs->mask = (1u << plc_prbs->order) - 1;
+	plc_prbs_reset(plc_prbs);
+	return plc_prbs;
+}
+
+ATTR_EXTERN void plc_prbs_release(struct plc_prbs *plc_prbs)
+{
+	free(plc_prbs);
+}
+
+ATTR_EXTERN void plc_prbs_reset(struct plc_prbs *plc_prbs)
+{
+	plc_prbs->state = plc_prbs->mask;
+}
+
+ATTR_EXTERN uint32_t plc_prbs_get_order(struct plc_prbs *plc_prbs)
+{
+	return plc_prbs->order;
+}
+
+ATTR_EXTERN int plc_prbs_next_bit(struct plc_prbs *plc_prbs)
+{
+	uint32_t state = plc_prbs->state;
+	int bit = ((state >> (plc_prbs->order - 1)) ^ (state >> (plc_prbs->tap - 1))) & 1;
+	plc_prbs->state = ((state << 1) | bit) & plc_prbs->mask;
+	return bit;
+}
+
+ATTR_EXTERN int plc_prbs_check_bit(struct plc_prbs *plc_prbs, int bit)
+{
+	uint32_t state = plc_prbs->state;
+	int bit_expected = ((state >> (plc_prbs->order - 1)) ^ (state >> (plc_prbs->tap - 1))) & 1;
+	plc_prbs->state = ((state << 1) | bit) & plc_prbs->mask;
+	return bit_expected;
+}
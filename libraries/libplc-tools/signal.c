@@ -7,7 +7,7 @@
  * @endcond
  */
 
-#include <math.h>		// round
+#include <math.h>		// round, llround
 #include "+common/api/+base.h"
 #include "api/file.h"
 #include "api/signal.h"
@@ -39,11 +39,38 @@
 // TODO: Make ADC_FILE_CAPTURE_FILTER a configurable setting
 #define ADC_FILE_CAPTURE_FILTER "adc_filter.csv"
 
+//
+// FIXED-POINT ARITHMETIC
+//
+
+// Fractional bits kept on the demodulated and filtered samples. 12-bit samples (13 with sign) still
+// fit in 32 bits, and the resolution is required by low cut-off filters. For example, 'butter(2,
+// 0.01)' amplifies the rounding noise of the feedback path by '1 / sum(a) ~= 1000'
+#define FIXED_GUARD_BITS 16
+// Quarter of wave in 'nco_phase' units. Used to get 'sin' from the 'cos' table
+#define FIXED_PHASE_QUARTER 0x40000000u
+// Size of the 'cos' lookup table in bits (1 << FIXED_COS_TABLE_BITS entries)
+#define FIXED_COS_TABLE_BITS 10
+#define FIXED_COS_TABLE_SIZE (1 << FIXED_COS_TABLE_BITS)
+
+//
+// DECIMATION
+//
+
+// Number of integrator and comb stages of the CIC decimator
+#define CIC_STAGES 3
+// Length of the polyphase FIR per output phase (total taps = taps_per_phase * decimation + 1)
+#define POLYPHASE_TAPS_PER_PHASE 8
+// Fractional bits of the fixed-point polyphase FIR taps
+#define POLYPHASE_TAPS_FRAC_BITS 15
+
 struct plc_signal_iir
 {
 	float *buffer_in_f;
 	float *buffer_out_f;
 	uint32_t chunk_samples;
+	// Samples at the output of the decimation stage (equal to 'chunk_samples' if not decimating)
+	uint32_t out_samples;
 	// Demodulation parameters
 	uint32_t samples_counter;
 	enum plc_signal_iir_demodulator_enum demodulator;
@@ -57,16 +84,217 @@ struct plc_signal_iir
 	float *buffer_to_file_rx_filter;
 	uint32_t buffer_to_file_rx_filter_remaining;
 	float *buffer_to_file_rx_filter_cur;
+	// Fixed-point arithmetic. Samples in Q(FIXED_GUARD_BITS) format
+	enum plc_signal_arithmetic_enum arithmetic;
+	int saturation;
+	int32_t *buffer_in_q;
+	int32_t *buffer_out_q;
+	int32_t *buffer_out_i;
+	int32_t *iir_a_q;
+	int32_t *iir_b_q;
+	uint32_t coefficients_frac_bits;
+	int16_t *cos_table;
+	uint32_t nco_phase;
+	uint32_t nco_step;
+	// Decimation front-end between the demodulation and the IIR filtering
+	enum plc_signal_decimator_enum decimator;
+	uint32_t decimation;
+	// Demodulated samples at full rate preceded by 'decimator_history' samples from previous chunk
+	float *buffer_demod_f;
+	int32_t *buffer_demod_q;
+	uint32_t decimator_history;
+	uint64_t cic_integrators[CIC_STAGES];
+	uint64_t cic_combs[CIC_STAGES];
+	int64_t cic_gain;
+	int64_t cic_outputs[2];
+	float *fir_taps;
+	int32_t *fir_taps_q;
+	uint32_t fir_taps_count;
 };
 
+static void plc_signal_iir_release_decimator(struct plc_signal_iir *plc_signal_iir)
+{
+	free(plc_signal_iir->fir_taps_q);
+	free(plc_signal_iir->fir_taps);
+	free(plc_signal_iir->buffer_demod_q);
+	free(plc_signal_iir->buffer_demod_f);
+	plc_signal_iir->fir_taps_q = NULL;
+	plc_signal_iir->fir_taps = NULL;
+	plc_signal_iir->buffer_demod_q = NULL;
+	plc_signal_iir->buffer_demod_f = NULL;
+}
+
+static void plc_signal_iir_release_fixed(struct plc_signal_iir *plc_signal_iir)
+{
+	free(plc_signal_iir->cos_table);
+	free(plc_signal_iir->iir_b_q);
+	free(plc_signal_iir->iir_a_q);
+	free(plc_signal_iir->buffer_out_i);
+	free(plc_signal_iir->buffer_out_q);
+	free(plc_signal_iir->buffer_in_q);
+	plc_signal_iir->cos_table = NULL;
+	plc_signal_iir->iir_b_q = NULL;
+	plc_signal_iir->iir_a_q = NULL;
+	plc_signal_iir->buffer_out_i = NULL;
+	plc_signal_iir->buffer_out_q = NULL;
+	plc_signal_iir->buffer_in_q = NULL;
+}
+
+// Quantizes the coefficients normalized by 'a[0]'
+static void quantize_coefficients(int32_t *coefs_q, const float *coefs, uint32_t coefs_count,
+		float a0, uint32_t frac_bits, int32_t coef_max)
+{
+	uint32_t n;
+	for (n = 0; n < coefs_count; n++)
+	{
+		double coef = round((double) coefs[n] / a0 * (1ull << frac_bits));
+		if (coef > coef_max)
+			coef = coef_max;
+		else if (coef < -coef_max - 1)
+			coef = -coef_max - 1;
+		coefs_q[n] = (int32_t) coef;
+	}
+}
+
+static inline int32_t fixed_narrow(int64_t value, int saturation)
+{
+	if (saturation)
+	{
+		if (value > INT32_MAX)
+			return INT32_MAX;
+		if (value < INT32_MIN)
+			return INT32_MIN;
+		return (int32_t) value;
+	}
+	// Two's complement wrap-around
+	return (int32_t) (uint32_t) (uint64_t) value;
+}
+
+// CIC integrators with modular arithmetic: the wrap-arounds cancel out on the combs as long as the
+// output fits on 64 bits (input bits + CIC_STAGES * log2(decimation))
+static inline void cic_integrate(struct plc_signal_iir *plc_signal_iir, int64_t sample)
+{
+	uint64_t value = (uint64_t) sample;
+	int k;
+	for (k = 0; k < CIC_STAGES; k++)
+		value = (plc_signal_iir->cic_integrators[k] += value);
+}
+
+// CIC combs followed by the 3-tap droop compensator '[-1, 10, -1] / 8'
+// The compensator matches the '1 - CIC_STAGES * w^2 / 24' droop of the CIC on the passband
+static inline int64_t cic_comb(struct plc_signal_iir *plc_signal_iir)
+{
+	uint64_t value = plc_signal_iir->cic_integrators[CIC_STAGES - 1];
+	int k;
+	for (k = 0; k < CIC_STAGES; k++)
+	{
+		uint64_t value_prev = plc_signal_iir->cic_combs[k];
+		plc_signal_iir->cic_combs[k] = value;
+		value -= value_prev;
+	}
+	int64_t cic_out = (int64_t) value / plc_signal_iir->cic_gain;
+	int64_t out = (10 * plc_signal_iir->cic_outputs[0] - cic_out - plc_signal_iir->cic_outputs[1])
+			/ 8;
+	plc_signal_iir->cic_outputs[1] = plc_signal_iir->cic_outputs[0];
+	plc_signal_iir->cic_outputs[0] = cic_out;
+	return out;
+}
+
+// Decimates the 'buffer_demod_f' contents into 'out_f' ('out_samples' values)
+static void decimate_float(struct plc_signal_iir *plc_signal_iir, float *out_f)
+{
+	uint32_t n, m;
+	uint32_t decimation = plc_signal_iir->decimation;
+	const float *demod_f = plc_signal_iir->buffer_demod_f + plc_signal_iir->decimator_history;
+	switch (plc_signal_iir->decimator)
+	{
+	case plc_signal_decimator_cic:
+		// Integer CIC on Q(FIXED_GUARD_BITS) values. A floating-point CIC would lose precision
+		// as the integrators grow
+		for (n = 0, m = 0; m < plc_signal_iir->out_samples; m++)
+		{
+			uint32_t n_end = n + decimation;
+			for (; n < n_end; n++)
+				cic_integrate(plc_signal_iir, lrintf(demod_f[n] * (1 << FIXED_GUARD_BITS)));
+			out_f[m] = (float) cic_comb(plc_signal_iir) / (1 << FIXED_GUARD_BITS);
+		}
+		break;
+	case plc_signal_decimator_polyphase:
+	{
+		// Only the samples kept after decimation are calculated, what is equivalent to the
+		// polyphase decomposition of the FIR
+		const float *taps = plc_signal_iir->fir_taps;
+		uint32_t taps_count = plc_signal_iir->fir_taps_count;
+		for (m = 0; m < plc_signal_iir->out_samples; m++)
+		{
+			const float *last = demod_f + (m + 1) * decimation - 1;
+			float acc = 0.0;
+			uint32_t k;
+			for (k = 0; k < taps_count; k++)
+				acc += taps[k] * last[-(int) k];
+			out_f[m] = acc;
+		}
+		memmove(plc_signal_iir->buffer_demod_f,
+				plc_signal_iir->buffer_demod_f + plc_signal_iir->chunk_samples,
+				plc_signal_iir->decimator_history * sizeof(float));
+		break;
+	}
+	default:
+		assert(0);
+	}
+}
+
+// Fixed-point version of 'decimate_float'
+static void decimate_fixed(struct plc_signal_iir *plc_signal_iir, int32_t *out_q)
+{
+	uint32_t n, m;
+	uint32_t decimation = plc_signal_iir->decimation;
+	const int32_t *demod_q = plc_signal_iir->buffer_demod_q + plc_signal_iir->decimator_history;
+	switch (plc_signal_iir->decimator)
+	{
+	case plc_signal_decimator_cic:
+		for (n = 0, m = 0; m < plc_signal_iir->out_samples; m++)
+		{
+			uint32_t n_end = n + decimation;
+			for (; n < n_end; n++)
+				cic_integrate(plc_signal_iir, demod_q[n]);
+			out_q[m] = fixed_narrow(cic_comb(plc_signal_iir), plc_signal_iir->saturation);
+		}
+		break;
+	case plc_signal_decimator_polyphase:
+	{
+		const int32_t *taps_q = plc_signal_iir->fir_taps_q;
+		uint32_t taps_count = plc_signal_iir->fir_taps_count;
+		for (m = 0; m < plc_signal_iir->out_samples; m++)
+		{
+			const int32_t *last = demod_q + (m + 1) * decimation - 1;
+			int64_t acc = 1ll << (POLYPHASE_TAPS_FRAC_BITS - 1);
+			uint32_t k;
+			for (k = 0; k < taps_count; k++)
+				acc += (int64_t) taps_q[k] * last[-(int) k];
+			out_q[m] = fixed_narrow(acc >> POLYPHASE_TAPS_FRAC_BITS, plc_signal_iir->saturation);
+		}
+		memmove(plc_signal_iir->buffer_demod_q,
+				plc_signal_iir->buffer_demod_q + plc_signal_iir->chunk_samples,
+				plc_signal_iir->decimator_history * sizeof(int32_t));
+		break;
+	}
+	default:
+		assert(0);
+	}
+}
+
 ATTR_EXTERN struct plc_signal_iir *plc_signal_iir_create(uint32_t chunk_samples, const float *iir_a,
 		uint32_t iir_a_count, const float *iir_b, uint32_t iir_b_count)
 {
 	struct plc_signal_iir *plc_signal_iir = calloc(1, sizeof(struct plc_signal_iir));
-	memset(plc_signal_iir, 0, sizeof(*plc_signal_iir));
-	plc_signal_iir->buffer_in_f = malloc((chunk_samples + iir_b_count) * sizeof(float));
-	plc_signal_iir->buffer_out_f = malloc((chunk_samples + iir_a_count) * sizeof(float));
+	// Zeroed as a whole: each chunk takes the tail of the previous one as the filter history, so
+	// the first chunk would chain whatever the heap contained
+	plc_signal_iir->buffer_in_f = calloc(chunk_samples + iir_b_count, sizeof(float));
+	plc_signal_iir->buffer_out_f = calloc(chunk_samples + iir_a_count, sizeof(float));
 	plc_signal_iir->chunk_samples = chunk_samples;
+	plc_signal_iir->out_samples = chunk_samples;
+	plc_signal_iir->decimation = 1;
 	uint32_t iir_a_size = sizeof(*iir_a) * iir_a_count;
 	plc_signal_iir->iir_a = (float*) malloc(iir_a_size);
 	plc_signal_iir->iir_a_count = iir_a_count;
@@ -75,11 +303,6 @@ ATTR_EXTERN struct plc_signal_iir *plc_signal_iir_create(uint32_t chunk_samples,
 	plc_signal_iir->iir_b = (float*) malloc(iir_b_size);
 	plc_signal_iir->iir_b_count = iir_b_count;
 	memcpy(plc_signal_iir->iir_b, iir_b, iir_b_size);
-	int n;
-	for (n = 0; n < plc_signal_iir->iir_b_count; n++)
-		plc_signal_iir->buffer_in_f[n] = 0.0;
-	for (n = 0; n < plc_signal_iir->iir_a_count; n++)
-		plc_signal_iir->buffer_out_f[n] = 0.0;
 	return plc_signal_iir;
 }
 
@@ -94,6 +317,8 @@ ATTR_EXTERN void plc_signal_iir_release(struct plc_signal_iir *plc_signal_iir)
 		assert(ret >= 0);
 		free(plc_signal_iir->buffer_to_file_rx_filter);
 	}
+	plc_signal_iir_release_decimator(plc_signal_iir);
+	plc_signal_iir_release_fixed(plc_signal_iir);
 	free(plc_signal_iir->iir_b);
 	free(plc_signal_iir->iir_a);
 	free(plc_signal_iir->buffer_out_f);
@@ -106,6 +331,16 @@ ATTR_EXTERN float* plc_signal_get_buffer_out(struct plc_signal_iir *plc_signal_i
 	return plc_signal_iir->buffer_out_f + plc_signal_iir->iir_a_count;
 }
 
+ATTR_EXTERN const int32_t *plc_signal_get_buffer_out_fixed(struct plc_signal_iir *plc_signal_iir)
+{
+	return plc_signal_iir->buffer_out_i;
+}
+
+ATTR_EXTERN uint32_t plc_signal_get_buffer_out_count(struct plc_signal_iir *plc_signal_iir)
+{
+	return plc_signal_iir->out_samples;
+}
+
 ATTR_EXTERN void plc_signal_iir_set_samples_to_file(struct plc_signal_iir *plc_signal_iir,
 		uint32_t samples_to_file)
 {
@@ -126,27 +361,254 @@ ATTR_EXTERN void plc_signal_iir_set_demodulation_frequency(struct plc_signal_iir
 		float digital_frequency)
 {
 	plc_signal_iir->demodulation_frequency = digital_frequency;
+	// Phase increment per sample of the fixed-point oscillator (a full turn is 2^32)
+	plc_signal_iir->nco_step = (uint32_t) (int64_t) llround(digital_frequency * 4294967296.0);
+}
+
+ATTR_EXTERN void plc_signal_iir_set_samples_counter(struct plc_signal_iir *plc_signal_iir,
+		uint32_t samples_counter)
+{
+	plc_signal_iir->samples_counter = samples_counter;
+	// Same phase than accumulating 'nco_step' on each sample (modulo a full turn)
+	plc_signal_iir->nco_phase = samples_counter * plc_signal_iir->nco_step;
+}
+
+ATTR_EXTERN void plc_signal_iir_set_arithmetic(struct plc_signal_iir *plc_signal_iir,
+		enum plc_signal_arithmetic_enum arithmetic, int saturation)
+{
+	assert(arithmetic < plc_signal_arithmetic_COUNT);
+	plc_signal_iir_release_fixed(plc_signal_iir);
+	plc_signal_iir->arithmetic = arithmetic;
+	plc_signal_iir->saturation = saturation;
+	if (arithmetic == plc_signal_arithmetic_float)
+		return;
+	uint32_t chunk_samples = plc_signal_iir->chunk_samples;
+	plc_signal_iir->buffer_in_q = calloc(chunk_samples + plc_signal_iir->iir_b_count,
+			sizeof(int32_t));
+	plc_signal_iir->buffer_out_q = calloc(chunk_samples + plc_signal_iir->iir_a_count,
+			sizeof(int32_t));
+	plc_signal_iir->buffer_out_i = calloc(chunk_samples, sizeof(int32_t));
+	// Place the binary point to fit the greatest normalized coefficient
+	// For example, 'butter(2, 0.01)' has 'a[1] = -1.95558' -> Q1.14 on 16 bits, Q1.30 on 32 bits
+	float a0 = plc_signal_iir->iir_a[0];
+	float coef_abs_max = 0.0;
+	uint32_t n;
+	for (n = 0; n < plc_signal_iir->iir_a_count; n++)
+		if (fabsf(plc_signal_iir->iir_a[n] / a0) > coef_abs_max)
+			coef_abs_max = fabsf(plc_signal_iir->iir_a[n] / a0);
+	for (n = 0; n < plc_signal_iir->iir_b_count; n++)
+		if (fabsf(plc_signal_iir->iir_b[n] / a0) > coef_abs_max)
+			coef_abs_max = fabsf(plc_signal_iir->iir_b[n] / a0);
+	uint32_t integer_bits = 0;
+	while ((1u << integer_bits) <= coef_abs_max)
+		integer_bits++;
+	uint32_t container_bits = (arithmetic == plc_signal_arithmetic_q15) ? 16 : 32;
+	assert(integer_bits < container_bits - 1);
+	plc_signal_iir->coefficients_frac_bits = container_bits - 1 - integer_bits;
+	int32_t coef_max = (arithmetic == plc_signal_arithmetic_q15) ? INT16_MAX : INT32_MAX;
+	plc_signal_iir->iir_a_q = malloc(plc_signal_iir->iir_a_count * sizeof(int32_t));
+	quantize_coefficients(plc_signal_iir->iir_a_q, plc_signal_iir->iir_a,
+			plc_signal_iir->iir_a_count, a0, plc_signal_iir->coefficients_frac_bits, coef_max);
+	plc_signal_iir->iir_b_q = malloc(plc_signal_iir->iir_b_count * sizeof(int32_t));
+	quantize_coefficients(plc_signal_iir->iir_b_q, plc_signal_iir->iir_b,
+			plc_signal_iir->iir_b_count, a0, plc_signal_iir->coefficients_frac_bits, coef_max);
+	// Q15 'cos' table used by the numerically-controlled oscillator of the 'cos' demodulator
+	plc_signal_iir->cos_table = malloc(FIXED_COS_TABLE_SIZE * sizeof(int16_t));
+	for (n = 0; n < FIXED_COS_TABLE_SIZE; n++)
+		plc_signal_iir->cos_table[n] = (int16_t) round(
+				cos(2.0 * M_PI * n / FIXED_COS_TABLE_SIZE) * INT16_MAX);
+}
+
+ATTR_EXTERN void plc_signal_iir_set_decimation(struct plc_signal_iir *plc_signal_iir,
+		enum plc_signal_decimator_enum decimator, uint32_t decimation)
+{
+	assert((decimation > 0) && (plc_signal_iir->chunk_samples % decimation == 0));
+	plc_signal_iir_release_decimator(plc_signal_iir);
+	memset(plc_signal_iir->cic_integrators, 0, sizeof(plc_signal_iir->cic_integrators));
+	memset(plc_signal_iir->cic_combs, 0, sizeof(plc_signal_iir->cic_combs));
+	memset(plc_signal_iir->cic_outputs, 0, sizeof(plc_signal_iir->cic_outputs));
+	plc_signal_iir->decimator = decimator;
+	plc_signal_iir->decimation = decimation;
+	plc_signal_iir->out_samples = plc_signal_iir->chunk_samples / decimation;
+	plc_signal_iir->decimator_history = 0;
+	plc_signal_iir->fir_taps_count = 0;
+	if (decimation == 1)
+		return;
+	switch (decimator)
+	{
+	case plc_signal_decimator_cic:
+	{
+		plc_signal_iir->cic_gain = 1;
+		int k;
+		for (k = 0; k < CIC_STAGES; k++)
+			plc_signal_iir->cic_gain *= decimation;
+		break;
+	}
+	case plc_signal_decimator_polyphase:
+	{
+		// Windowed-sinc (Hamming) low-pass FIR with the cut-off at the output Nyquist frequency
+		uint32_t taps_count = POLYPHASE_TAPS_PER_PHASE * decimation + 1;
+		float *taps = malloc(taps_count * sizeof(float));
+		double cutoff = 0.5 / decimation;
+		double taps_sum = 0.0;
+		uint32_t k;
+		for (k = 0; k < taps_count; k++)
+		{
+			double t = (double) k - (taps_count - 1) / 2.0;
+			double sinc = (t == 0.0) ? 1.0 : sin(2.0 * M_PI * cutoff * t) / (2.0 * M_PI * cutoff * t);
+			double window = 0.54 - 0.46 * cos(2.0 * M_PI * k / (taps_count - 1));
+			taps[k] = sinc * window;
+			taps_sum += taps[k];
+		}
+		plc_signal_iir->fir_taps_q = malloc(taps_count * sizeof(int32_t));
+		for (k = 0; k < taps_count; k++)
+		{
+			taps[k] /= taps_sum;
+			plc_signal_iir->fir_taps_q[k] = (int32_t) lrint(
+					taps[k] * (1 << POLYPHASE_TAPS_FRAC_BITS));
+		}
+		plc_signal_iir->fir_taps = taps;
+		plc_signal_iir->fir_taps_count = taps_count;
+		plc_signal_iir->decimator_history = taps_count - 1;
+		break;
+	}
+	default:
+		assert(0);
+	}
+	uint32_t demod_samples = plc_signal_iir->decimator_history + plc_signal_iir->chunk_samples;
+	plc_signal_iir->buffer_demod_f = calloc(demod_samples, sizeof(float));
+	plc_signal_iir->buffer_demod_q = calloc(demod_samples, sizeof(int32_t));
 }
 
 ATTR_EXTERN void plc_signal_iir_reset(struct plc_signal_iir *plc_signal_iir)
 {
 	plc_signal_iir->samples_counter = 0;
+	plc_signal_iir->nco_phase = 0;
+}
+
+ATTR_EXTERN void plc_signal_design_butterworth2(float cutoff, float *iir_a, float *iir_b)
+{
+	// Bilinear transform of the analog prototype with pre-warping (same result as 'butter' in
+	// Octave)
+	double k = tan(M_PI * cutoff / 2.0);
+	double k2 = k * k;
+	double norm = 1.0 / (1.0 + M_SQRT2 * k + k2);
+	iir_b[0] = k2 * norm;
+	iir_b[1] = 2.0 * k2 * norm;
+	iir_b[2] = k2 * norm;
+	iir_a[0] = 1.0;
+	iir_a[1] = 2.0 * (k2 - 1.0) * norm;
+	iir_a[2] = (1.0 - M_SQRT2 * k + k2) * norm;
+}
+
+// Same algorithm than the 'float' version with integer arithmetic:
+//	* Demodulated samples and filter state in Q(FIXED_GUARD_BITS)
+//	* Coefficients in Q(coefficients_frac_bits)
+//	* 64-bit accumulation, rounding and narrowing (saturated or wrapped) to 32 bits
+static void plc_signal_iir_process_chunk_fixed(struct plc_signal_iir *plc_signal_iir,
+		const sample_rx_t *buffer_in, sample_rx_t buffer_in_offset)
+{
+	uint32_t n;
+	uint32_t chunk_samples = plc_signal_iir->chunk_samples;
+	uint32_t out_samples = plc_signal_iir->out_samples;
+	int32_t *in_q = plc_signal_iir->buffer_in_q + plc_signal_iir->iir_b_count;
+	int32_t *out_q = plc_signal_iir->buffer_out_q + plc_signal_iir->iir_a_count;
+	int32_t *out_i = plc_signal_iir->buffer_out_i;
+	const int32_t *iir_a_q = plc_signal_iir->iir_a_q;
+	const int32_t *iir_b_q = plc_signal_iir->iir_b_q;
+	uint32_t iir_a_count = plc_signal_iir->iir_a_count;
+	uint32_t iir_b_count = plc_signal_iir->iir_b_count;
+	uint32_t frac_bits = plc_signal_iir->coefficients_frac_bits;
+	int64_t rounding = 1ll << (frac_bits - 1);
+	int saturation = plc_signal_iir->saturation;
+	int32_t *demod_q =
+			(plc_signal_iir->decimation > 1) ?
+					plc_signal_iir->buffer_demod_q + plc_signal_iir->decimator_history : in_q;
+	// Chain previous in/out values
+	for (n = 0; n < iir_b_count; n++)
+		plc_signal_iir->buffer_in_q[n] = plc_signal_iir->buffer_in_q[out_samples + n];
+	for (n = 0; n < iir_a_count; n++)
+		plc_signal_iir->buffer_out_q[n] = plc_signal_iir->buffer_out_q[out_samples + n];
+	// Demodulation
+	switch (plc_signal_iir->demodulator)
+	{
+	case plc_signal_iir_demodulator_none:
+		for (n = 0; n < chunk_samples; n++)
+			demod_q[n] = ((int32_t) buffer_in[n] - (int32_t) buffer_in_offset) << FIXED_GUARD_BITS;
+		break;
+	case plc_signal_iir_demodulator_abs:
+		for (n = 0; n < chunk_samples; n++)
+			demod_q[n] = abs((int16_t) (buffer_in[n] - buffer_in_offset)) << FIXED_GUARD_BITS;
+		break;
+	case plc_signal_iir_demodulator_cos:
+	{
+		// Same '-M_PI / 2' phase synchronization than the 'float' version
+		uint32_t phase = plc_signal_iir->nco_phase - FIXED_PHASE_QUARTER;
+		uint32_t step = plc_signal_iir->nco_step;
+		const int16_t *cos_table = plc_signal_iir->cos_table;
+		for (n = 0; n < chunk_samples; n++, phase += step)
+		{
+			int32_t sample = (int32_t) buffer_in[n] - (int32_t) buffer_in_offset;
+			// Q0 * Q15 -> Q(FIXED_GUARD_BITS)
+			demod_q[n] = (sample * cos_table[phase >> (32 - FIXED_COS_TABLE_BITS)])
+					<< (FIXED_GUARD_BITS - 15);
+		}
+		plc_signal_iir->nco_phase = phase + FIXED_PHASE_QUARTER;
+		break;
+	}
+	}
+	// Decimation
+	if (plc_signal_iir->decimation > 1)
+		decimate_fixed(plc_signal_iir, in_q);
+	// IIR filtering with the coefficients already normalized by 'a[0]'
+	for (n = 0; n < out_samples; n++)
+	{
+		int64_t acc = 0;
+		int k;
+		for (k = 0; k < iir_b_count; k++)
+			acc += (int64_t) iir_b_q[k] * in_q[(int) n - k];
+		for (k = 1; k < iir_a_count; k++)
+			acc -= (int64_t) iir_a_q[k] * out_q[(int) n - k];
+		out_q[n] = fixed_narrow((acc + rounding) >> frac_bits, saturation);
+		out_i[n] = (int32_t) (((int64_t) out_q[n] + (1 << (FIXED_GUARD_BITS - 1)))
+				>> FIXED_GUARD_BITS);
+	}
+	// Record to file
+	if (plc_signal_iir->buffer_to_file_rx_filter_remaining)
+	{
+		int samples_to_copy =
+				(plc_signal_iir->buffer_to_file_rx_filter_remaining <= out_samples) ?
+						plc_signal_iir->buffer_to_file_rx_filter_remaining : out_samples;
+		for (n = 0; n < samples_to_copy; n++)
+			plc_signal_iir->buffer_to_file_rx_filter_cur[n] = (float) out_q[n]
+					/ (1 << FIXED_GUARD_BITS);
+		plc_signal_iir->buffer_to_file_rx_filter_cur += samples_to_copy;
+		plc_signal_iir->buffer_to_file_rx_filter_remaining -= samples_to_copy;
+	}
 }
 
 ATTR_EXTERN void plc_signal_iir_process_chunk(struct plc_signal_iir *plc_signal_iir,
 		const sample_rx_t *buffer_in, sample_rx_t buffer_in_offset)
 {
+	if (plc_signal_iir->arithmetic != plc_signal_arithmetic_float)
+	{
+		plc_signal_iir_process_chunk_fixed(plc_signal_iir, buffer_in, buffer_in_offset);
+		return;
+	}
 	uint32_t n;
 	float *in_f = plc_signal_iir->buffer_in_f + plc_signal_iir->iir_b_count;
 	float *out_f = plc_signal_iir->buffer_out_f + plc_signal_iir->iir_a_count;
+	float *demod_f =
+			(plc_signal_iir->decimation > 1) ?
+					plc_signal_iir->buffer_demod_f + plc_signal_iir->decimator_history : in_f;
 	//
 	// Chain previous in/out values
 	//
 	for (n = 0; n < plc_signal_iir->iir_b_count; n++)
-		plc_signal_iir->buffer_in_f[n] = plc_signal_iir->buffer_in_f[plc_signal_iir->chunk_samples
+		plc_signal_iir->buffer_in_f[n] = plc_signal_iir->buffer_in_f[plc_signal_iir->out_samples
 				+ n];
 	for (n = 0; n < plc_signal_iir->iir_a_count; n++)
-		plc_signal_iir->buffer_out_f[n] = plc_signal_iir->buffer_out_f[plc_signal_iir->chunk_samples
+		plc_signal_iir->buffer_out_f[n] = plc_signal_iir->buffer_out_f[plc_signal_iir->out_samples
 				+ n];
 	//
 	// Demodulation
@@ -154,11 +616,17 @@ ATTR_EXTERN void plc_signal_iir_process_chunk(struct plc_signal_iir *plc_signal_
 	switch (plc_signal_iir->demodulator)
 	{
 	case plc_signal_iir_demodulator_none:
+		// Same offset removal than the fixed-point version
+		for (n = 0; n < plc_signal_iir->chunk_samples; n++)
+		{
+			demod_f[n] = (int32_t) buffer_in[n] - (int32_t) buffer_in_offset;
+			out_f[n] = 0.0;
+		}
 		break;
 	case plc_signal_iir_demodulator_abs:
 		for (n = 0; n < plc_signal_iir->chunk_samples; n++)
 		{
-			in_f[n] = abs((int16_t) (buffer_in[n] - buffer_in_offset));
+			demod_f[n] = abs((int16_t) (buffer_in[n] - buffer_in_offset));
 			out_f[n] = 0.0;
 		}
 		break;
@@ -169,7 +637,7 @@ ATTR_EXTERN void plc_signal_iir_process_chunk(struct plc_signal_iir *plc_signal_
 		float phase_synchronization = -M_PI / 2;
 		for (n = 0; n < plc_signal_iir->chunk_samples; n++, plc_signal_iir->samples_counter++)
 		{
-			in_f[n] = (float) ((int16_t) (buffer_in[n]) - (int16_t) (buffer_in_offset))
+			demod_f[n] = (float) ((int16_t) (buffer_in[n]) - (int16_t) (buffer_in_offset))
 					* cos(
 							2 * M_PI * plc_signal_iir->demodulation_frequency
 									* plc_signal_iir->samples_counter + phase_synchronization);
@@ -179,6 +647,11 @@ ATTR_EXTERN void plc_signal_iir_process_chunk(struct plc_signal_iir *plc_signal_
 	}
 	}
 	//
+	// Decimation (if enabled the IIR filter works at the decimated rate)
+	//
+	if (plc_signal_iir->decimation > 1)
+		decimate_float(plc_signal_iir, in_f);
+	//
 	// Apply IIR filtering (https://en.wikipedia.org/wiki/Infinite_impulse_response).
 	// Typical formula (got from Octave >> 'doc filter'):
 	//
@@ -194,13 +667,13 @@ ATTR_EXTERN void plc_signal_iir_process_chunk(struct plc_signal_iir *plc_signal_
 	//
     // where c = a/a(0), d = b/a(0), N = len(iir_a)-1, M = len(iir_b)-1.
 	//
-	for (n = 0; n < plc_signal_iir->chunk_samples; n++)
+	for (n = 0; n < plc_signal_iir->out_samples; n++)
 	{
 		int k;
 		for (k = 0; k < plc_signal_iir->iir_b_count; k++)
-			out_f[n] += plc_signal_iir->iir_b[k] * in_f[n - k];
+			out_f[n] += plc_signal_iir->iir_b[k] * in_f[(int) n - k];
 		for (k = 1; k < plc_signal_iir->iir_a_count; k++)
-			out_f[n] -= plc_signal_iir->iir_a[k] * out_f[n - k];
+			out_f[n] -= plc_signal_iir->iir_a[k] * out_f[(int) n - k];
 		out_f[n] /= plc_signal_iir->iir_a[0];
 	}
 	//
@@ -209,12 +682,176 @@ ATTR_EXTERN void plc_signal_iir_process_chunk(struct plc_signal_iir *plc_signal_
 	if (plc_signal_iir->buffer_to_file_rx_filter_remaining)
 	{
 		int samples_to_copy =
-				(plc_signal_iir->buffer_to_file_rx_filter_remaining <= plc_signal_iir->chunk_samples) ?
+				(plc_signal_iir->buffer_to_file_rx_filter_remaining <= plc_signal_iir->out_samples) ?
 						plc_signal_iir->buffer_to_file_rx_filter_remaining :
-						plc_signal_iir->chunk_samples;
+						plc_signal_iir->out_samples;
 		memcpy(plc_signal_iir->buffer_to_file_rx_filter_cur, out_f,
 				samples_to_copy * sizeof(float));
 		plc_signal_iir->buffer_to_file_rx_filter_cur += samples_to_copy;
 		plc_signal_iir->buffer_to_file_rx_filter_remaining -= samples_to_copy;
 	}
 }
+
+ATTR_EXTERN uint32_t plc_signal_get_energy(const sample_rx_t *buffer_in, uint32_t buffer_in_count,
+		sample_rx_t buffer_in_offset)
+{
+	if (buffer_in_count == 0)
+		return 0;
+	// 12-bit samples -> squares fit on 24 bits -> no overflow on 64 bits for any practical count
+	uint64_t energy = 0;
+	uint32_t n;
+	for (n = 0; n < buffer_in_count; n++)
+	{
+		int32_t sample = (int32_t) buffer_in[n] - (int32_t) buffer_in_offset;
+		energy += (uint32_t) (sample * sample);
+	}
+	return (uint32_t) (energy / buffer_in_count);
+}
+
+//
+// SYMBOL SYNCHRONIZATION
+//
+
+// Maximum timing correction applied per symbol as a fraction of the symbol length
+#define SYMBOL_SYNC_MAX_CORRECTION 0.25f
+// The loop also adapts the symbol length (2nd order loop) with this fraction of the correction
+#define SYMBOL_SYNC_PERIOD_GAIN 0.1f
+// Weight of each new symbol on the estimation of the two symbol levels
+#define SYMBOL_SYNC_LEVEL_GAIN 0.5f
+
+struct plc_signal_symbol_sync
+{
+	float samples_per_symbol_nominal;
+	float samples_per_symbol;
+	float loop_gain;
+	// Samples remaining to the end and to the middle of the current symbol
+	float samples_to_end;
+	float samples_to_mid;
+	// Integrators of the current symbol and of the window centered on the previous boundary
+	float symbol_acc;
+	uint32_t symbol_samples;
+	float mid_acc;
+	uint32_t mid_samples;
+	float mid_level;
+	int mid_level_valid;
+	float symbol_level_prev;
+	int symbol_level_prev_valid;
+	// Estimation of the HI and LO symbol levels. Their middle point identifies the transitions
+	// independently of the decision threshold
+	float level_hi;
+	float level_lo;
+};
+
+ATTR_EXTERN struct plc_signal_symbol_sync *plc_signal_symbol_sync_create(float samples_per_symbol,
+		float threshold, float loop_gain)
+{
+	assert((samples_per_symbol >= 2.0f) && (threshold > 0.0f));
+	struct plc_signal_symbol_sync *plc_signal_symbol_sync = calloc(1,
+			sizeof(struct plc_signal_symbol_sync));
+	plc_signal_symbol_sync->samples_per_symbol_nominal = samples_per_symbol;
+	plc_signal_symbol_sync->samples_per_symbol = samples_per_symbol;
+	plc_signal_symbol_sync->loop_gain = loop_gain;
+	// Until the first symbols assume the threshold centered between the levels
+	plc_signal_symbol_sync->level_hi = 2.0f * threshold;
+	plc_signal_symbol_sync->level_lo = 0.0f;
+	plc_signal_symbol_sync_align(plc_signal_symbol_sync, 0.0f);
+	return plc_signal_symbol_sync;
+}
+
+ATTR_EXTERN void plc_signal_symbol_sync_release(
+		struct plc_signal_symbol_sync *plc_signal_symbol_sync)
+{
+	free(plc_signal_symbol_sync);
+}
+
+ATTR_EXTERN void plc_signal_symbol_sync_align(struct plc_signal_symbol_sync *plc_signal_symbol_sync,
+		float samples_elapsed)
+{
+	struct plc_signal_symbol_sync *sync = plc_signal_symbol_sync;
+	// The symbol length tracked so far is kept: a rate mismatch between TX and RX persists
+	sync->samples_to_end = sync->samples_per_symbol - samples_elapsed;
+	sync->samples_to_mid = sync->samples_to_end - sync->samples_per_symbol / 2.0f;
+	if (sync->samples_to_mid <= 0.0f)
+		sync->samples_to_mid += sync->samples_per_symbol;
+	sync->symbol_acc = 0.0f;
+	sync->symbol_samples = 0;
+	sync->mid_acc = 0.0f;
+	sync->mid_samples = 0;
+	sync->mid_level_valid = 0;
+	sync->symbol_level_prev_valid = 0;
+}
+
+ATTR_EXTERN int plc_signal_symbol_sync_push(struct plc_signal_symbol_sync *plc_signal_symbol_sync,
+		float sample, float *symbol_level)
+{
+	struct plc_signal_symbol_sync *sync = plc_signal_symbol_sync;
+	sync->symbol_acc += sample;
+	sync->symbol_samples++;
+	sync->mid_acc += sample;
+	sync->mid_samples++;
+	if (--sync->samples_to_mid <= 0.0f)
+	{
+		// Window between the middle of the previous symbol and the middle of the current one
+		sync->mid_level = sync->mid_acc / sync->mid_samples;
+		sync->mid_level_valid = sync->symbol_level_prev_valid;
+		sync->mid_acc = 0.0f;
+		sync->mid_samples = 0;
+		sync->samples_to_mid += sync->samples_per_symbol;
+	}
+	if (--sync->samples_to_end > 0.0f)
+		return 0;
+	// Integrate-and-dump
+	float level = sync->symbol_acc / sync->symbol_samples;
+	sync->symbol_acc = 0.0f;
+	sync->symbol_samples = 0;
+	float correction = 0.0f;
+	// Only the transitions carry timing information. Comparing with the decision threshold
+	// instead of the middle level would take a LO symbol partially overlapped by a HI one as a
+	// transition if the threshold is low, inverting the correction
+	float level_middle = (sync->level_hi + sync->level_lo) / 2.0f;
+	int is_hi = (level >= level_middle);
+	if (sync->mid_level_valid && (sync->loop_gain > 0.0f)
+			&& (is_hi != (sync->symbol_level_prev >= level_middle)))
+	{
+		// Gardner detector with the middle level centered on the mean of both symbols and
+		// normalized to their difference, so it depends neither on the signal amplitude nor on
+		// where the threshold lies between the levels. For a late clock of 'e' samples:
+		//	(mid_level - (level + level_prev) / 2) / (level - level_prev) ~= e / samples_per_symbol / 2
+		// (up to twice that if the next symbol is also a transition)
+		float level_diff = level - sync->symbol_level_prev;
+		float mid_centered = sync->mid_level - (level + sync->symbol_level_prev) / 2.0f;
+		float timing_error = 2.0f * mid_centered / level_diff * sync->samples_per_symbol;
+		correction = sync->loop_gain * timing_error;
+		float correction_max = SYMBOL_SYNC_MAX_CORRECTION * sync->samples_per_symbol;
+		if (correction > correction_max)
+			correction = correction_max;
+		else if (correction < -correction_max)
+			correction = -correction_max;
+		sync->samples_per_symbol -= SYMBOL_SYNC_PERIOD_GAIN * correction;
+		// Keep the tracked symbol length within a reasonable range of the nominal one
+		float period_max = sync->samples_per_symbol_nominal * (1.0f + SYMBOL_SYNC_MAX_CORRECTION);
+		float period_min = sync->samples_per_symbol_nominal * (1.0f - SYMBOL_SYNC_MAX_CORRECTION);
+		if (sync->samples_per_symbol > period_max)
+			sync->samples_per_symbol = period_max;
+		else if (sync->samples_per_symbol < period_min)
+			sync->samples_per_symbol = period_min;
+	}
+	if (is_hi)
+		sync->level_hi += SYMBOL_SYNC_LEVEL_GAIN * (level - sync->level_hi);
+	else
+		sync->level_lo += SYMBOL_SYNC_LEVEL_GAIN * (level - sync->level_lo);
+	sync->mid_level_valid = 0;
+	// A late clock (positive error) shortens the next symbol
+	sync->samples_to_end += sync->samples_per_symbol - correction;
+	sync->samples_to_mid -= correction;
+	sync->symbol_level_prev = level;
+	sync->symbol_level_prev_valid = 1;
+	*symbol_level = level;
+	return 1;
+}
+
+ATTR_EXTERN float plc_signal_symbol_sync_get_samples_per_symbol(
+		struct plc_signal_symbol_sync *plc_signal_symbol_sync)
+{
+	return plc_signal_symbol_sync->samples_per_symbol;
+}
@@ -50,3 +50,8 @@ ATTR_EXTERN inline void plc_time_add_usec_to_hires_interval(struct timespec *t,
 		t->tv_sec++;
 	}
 }
+
+ATTR_EXTERN int64_t plc_time_hires_stamp_to_nsec(struct timespec t)
+{
+	return (int64_t) t.tv_sec * 1000000000LL + t.tv_nsec;
+}
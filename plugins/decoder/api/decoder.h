@@ -16,6 +16,16 @@
 struct plc_setting_definition;
 union plc_setting_data;
 
+/**
+ * @brief	Contiguous span of read-only samples, as used by @ref decoder_api::parse_spans
+ * @note	Same layout than _struct plc_chunker_span_ of libplc-tools
+ */
+struct decoder_span
+{
+	const sample_rx_t *samples;
+	uint32_t samples_count;
+};
+
 /**
  * @brief PLUGIN API duality. See @ref plugins for more info
  */
@@ -79,6 +89,8 @@ struct decoder_api
 	int (*end_settings)(decoder_api_h handle);
 	/**
 	 * @brief	Intialize a decoding session
+	 * @details	Since API version 2 _chunk_samples_ is only mandatory for _parse_next_samples_.
+	 *			On _parse_spans_ it is a hint of the expected span size
 	 * @param	handle			Handle to the decoder-plugin
 	 * @param	chunk_samples	Samples of each chunk of buffered data
 	 */
@@ -99,6 +111,28 @@ struct decoder_api
 	 */
 	uint32_t (*parse_next_samples)(decoder_api_h handle, const sample_rx_t *buffer_in,
 			data_tx_rx_t *buffer_data_out, uint32_t buffer_data_out_count);
+	/**
+	 * @brief		Decode an arbitrary number of raw received samples (API version >= 2)
+	 * @details		The samples can be split in several spans (e.g. at the wrap point of a ring
+	 *				buffer). They are decoded in place: the decoder only keeps internally the
+	 *				incomplete tail required to continue on the next call.
+	 *				A call without spans (_spans_count_ 0) marks the end of the stream: that tail
+	 *				is decoded padded with the idle level and _samples_consumed_ returns its length
+	 * @param[in]	handle					Handle to the decoder-plugin
+	 * @param[in]	spans					Spans of consecutive samples
+	 * @param[in]	spans_count				Number of spans
+	 * @param[out]	buffer_data_out			Buffer with allocated space for the data output
+	 * @param[in]	buffer_data_out_count	Space available in the output buffer in bytes
+	 * @param[out]	samples_consumed		Samples consumed from the spans. It's lower than the
+	 *										total only when the output buffer is full. In that case
+	 *										the non-consumed samples must be provided again (or
+	 *										the call repeated, at the end of the stream)
+	 * @return
+	 *				The number of data effectively decoded and stored in _buffer_data_out_
+	 */
+	uint32_t (*parse_spans)(decoder_api_h handle, const struct decoder_span *spans,
+			uint32_t spans_count, data_tx_rx_t *buffer_data_out, uint32_t buffer_data_out_count,
+			uint32_t *samples_consumed);
 };
 
 #endif /* PLUGINS_DECODER_DECODER_H */
@@ -35,6 +35,7 @@
 #include "+common/api/error.h"
 #include "+common/api/logger.h"
 #include "+common/api/setting.h"
+#include "libraries/libplc-tools/api/chunker.h"
 #include "libraries/libplc-tools/api/signal.h"
 // Declare the custom type used as handle. Doing it like this avoids the 'void*' hard-casting
 #define PLUGINS_API_HANDLE_EXPLICIT_DEF
@@ -48,6 +49,9 @@ typedef struct decoder *decoder_api_h;
 //	static const float iir_a_default[] = { 1.00000, -1.56102, 0.64135 };
 //	static const float iir_b_default[] = { 0.020083, 0.040167, 0.020083 };
 
+// Cut-off of the IIR filter normalized to the full-rate Nyquist frequency
+#define IIR_CUTOFF 0.01f
+
 //[iir_b,iir_a] = butter(2, 0.01)
 static const float iir_a_default[] = { 1.00000, -1.95558, 0.95654 };
 static const float iir_b_default[] = { 2.4136e-04, 4.8272e-04, 2.4136e-04 };
@@ -78,11 +82,21 @@ struct decoder
 	uint32_t samples_between_words;
 	uint32_t bit_width_us;
 	uint32_t samples_to_file;
+	// Index of the first sample in the whole capture, to demodulate with its carrier phase
+	uint32_t first_sample;
+	enum plc_signal_arithmetic_enum arithmetic;
+	int saturation;
+	enum plc_signal_decimator_enum decimator;
+	uint32_t decimation;
 	float samples_per_dot;
 	float samples_min_dot;
 	float samples_min_dash;
 	// Dynamic data
 	struct plc_signal_iir *signal_iir;
+	// Regroups the incoming spans in chunks suitable for the filter
+	struct plc_chunker *chunker;
+	// Chunk size requested on 'initialize'. Mandatory for 'parse_next_samples'
+	uint32_t chunk_samples_in;
 	int incoming_data_detected;
 	uint32_t samples_with_carrier;
 	uint32_t samples_without_carrier;
@@ -119,6 +133,8 @@ static void decoder_set_defaults(struct decoder *decoder)
 	decoder->carrier_threshold = 50;
 	decoder->offset = 500;
 	decoder->bit_width_us = 1000;
+	decoder->saturation = 1;
+	decoder->decimation = 1;
 }
 
 struct decoder *decoder_create(void)
@@ -139,6 +155,22 @@ void decoder_release(struct decoder *decoder)
 	free(decoder);
 }
 
+static const char *arithmetic_enum_text[plc_signal_arithmetic_COUNT] = {
+	"float", "q15", "q31" };
+
+static struct plc_setting_extra_data arithmetic_captions = {
+	plc_setting_extra_data_enum_captions, {
+		.enum_captions.captions = arithmetic_enum_text, .enum_captions.captions_count =
+				plc_signal_arithmetic_COUNT } };
+
+static const char *decimator_enum_text[plc_signal_decimator_COUNT] = {
+	"cic", "polyphase" };
+
+static struct plc_setting_extra_data decimator_captions = {
+	plc_setting_extra_data_enum_captions, {
+		.enum_captions.captions = decimator_enum_text, .enum_captions.captions_count =
+				plc_signal_decimator_COUNT } };
+
 const struct plc_setting_definition accepted_settings[] = {
 	{
 		"sampling_rate_sps", plc_setting_float, "Freq Capture [sps]", {
@@ -152,7 +184,17 @@ const struct plc_setting_definition accepted_settings[] = {
 		"bit_width_us", plc_setting_u32, "Bit Width [us]", {
 			.u32 = 1000 }, 0 }, {
 		"samples_to_file", plc_setting_u32, "Samples to file", {
-			.u32 = 0 }, 0 } };
+			.u32 = 0 }, 0 }, {
+		"first_sample", plc_setting_u32, "First sample index", {
+			.u32 = 0 }, 0 }, {
+		"arithmetic", plc_setting_enum, "Arithmetic", {
+			.u32 = plc_signal_arithmetic_float }, 1, &arithmetic_captions }, {
+		"saturation", plc_setting_bool, "Fixed-point saturation", {
+			.u32 = 1 }, 0 }, {
+		"decimation", plc_setting_u32, "Decimation factor", {
+			.u32 = 1 }, 0 }, {
+		"decimator", plc_setting_enum, "Decimator", {
+			.u32 = plc_signal_decimator_cic }, 1, &decimator_captions } };
 
 const struct plc_setting_definition *decoder_get_accepted_settings(struct decoder *decoder,
 		uint32_t *accepted_settings_count)
@@ -195,6 +237,30 @@ int decoder_set_setting(struct decoder *decoder, const char *identifier,
 	{
 		decoder->samples_to_file = data.u32;
 	}
+	else if (strcmp(identifier, "first_sample") == 0)
+	{
+		decoder->first_sample = data.u32;
+	}
+	else if (strcmp(identifier, "arithmetic") == 0)
+	{
+		if (data.u32 >= plc_signal_arithmetic_COUNT)
+			return set_error_msg("Unknown arithmetic");
+		decoder->arithmetic = data.u32;
+	}
+	else if (strcmp(identifier, "saturation") == 0)
+	{
+		decoder->saturation = data.u32;
+	}
+	else if (strcmp(identifier, "decimation") == 0)
+	{
+		decoder->decimation = data.u32;
+	}
+	else if (strcmp(identifier, "decimator") == 0)
+	{
+		if (data.u32 >= plc_signal_decimator_COUNT)
+			return set_error_msg("Unknown decimator");
+		decoder->decimator = data.u32;
+	}
 	else
 	{
 		return set_error_msg("Unknown setting");
@@ -204,8 +270,12 @@ int decoder_set_setting(struct decoder *decoder, const char *identifier,
 
 int decoder_end_settings(struct decoder *decoder)
 {
+	// The IIR filter runs at the decimated rate -> the cut-off scales with the decimation
+	if ((decoder->decimation == 0) || (IIR_CUTOFF * decoder->decimation >= 1.0f))
+		return set_error_msg("Decimation factor out of range");
 	decoder->samples_per_dot = round(
-			decoder->sampling_rate_sps * decoder->bit_width_us / 1000000.0f);
+			decoder->sampling_rate_sps / decoder->decimation * decoder->bit_width_us
+					/ 1000000.0f);
 	if (decoder->samples_per_dot == 0)
 		return set_error_msg("Bit width must be greater than 1 us");
 	// TODO: Allow parametrization of 'samples_min_*' thresholds
@@ -218,6 +288,9 @@ int decoder_end_settings(struct decoder *decoder)
 	return 0;
 }
 
+static uint32_t decoder_parse_chunk(void *handle, const sample_rx_t *buffer_in,
+		uint8_t *buffer_data_out, uint32_t buffer_data_out_count);
+
 void decoder_initialize(struct decoder *decoder, uint32_t chunk_samples)
 {
 #ifdef VERBOSE
@@ -227,10 +300,27 @@ void decoder_initialize(struct decoder *decoder, uint32_t chunk_samples)
 			decoder->samples_per_dot);
 #endif
 	assert(decoder->signal_iir == NULL);
-	decoder->chunk_samples = chunk_samples;
-	decoder->signal_iir = plc_signal_iir_create(chunk_samples, iir_a_default,
-			ARRAY_SIZE(iir_a_default), iir_b_default, ARRAY_SIZE(iir_b_default));
+	decoder->chunk_samples_in = chunk_samples;
+	// The internal chunks must be a multiple of the decimation factor
+	chunk_samples = (chunk_samples + decoder->decimation - 1) / decoder->decimation
+			* decoder->decimation;
+	if (decoder->decimation > 1)
+	{
+		float iir_a[3], iir_b[3];
+		plc_signal_design_butterworth2(IIR_CUTOFF * decoder->decimation, iir_a, iir_b);
+		decoder->signal_iir = plc_signal_iir_create(chunk_samples, iir_a, ARRAY_SIZE(iir_a), iir_b,
+				ARRAY_SIZE(iir_b));
+	}
+	else
+	{
+		decoder->signal_iir = plc_signal_iir_create(chunk_samples, iir_a_default,
+				ARRAY_SIZE(iir_a_default), iir_b_default, ARRAY_SIZE(iir_b_default));
+	}
+	plc_signal_iir_set_decimation(decoder->signal_iir, decoder->decimator, decoder->decimation);
+	// From here 'chunk_samples' refers to the (decimated) samples at the output of the filter
+	decoder->chunk_samples = plc_signal_get_buffer_out_count(decoder->signal_iir);
 	plc_signal_iir_set_samples_to_file(decoder->signal_iir, decoder->samples_to_file);
+	plc_signal_iir_set_arithmetic(decoder->signal_iir, decoder->arithmetic, decoder->saturation);
 	if (decoder->carrier_freq)
 	{
 		plc_signal_iir_set_demodulator(decoder->signal_iir, plc_signal_iir_demodulator_cos);
@@ -241,28 +331,39 @@ void decoder_initialize(struct decoder *decoder, uint32_t chunk_samples)
 	{
 		plc_signal_iir_set_demodulator(decoder->signal_iir, plc_signal_iir_demodulator_abs);
 	}
+	plc_signal_iir_set_samples_counter(decoder->signal_iir, decoder->first_sample);
 	decoder->incoming_data_detected = 0;
 	decoder->samples_with_carrier = 0;
 	decoder->samples_without_carrier = 0;
 	decoder->cur_morse_index = 0;
+	// Conservative bound of the data generated per chunk: one data per 8 bits
+	decoder->chunker = plc_chunker_create(chunk_samples,
+			ceil(chunk_samples * 1000000.0f / decoder->sampling_rate_sps / decoder->bit_width_us
+					/ 8.0f), decoder_parse_chunk, decoder);
 }
 
 void decoder_terminate(struct decoder *decoder)
 {
+	plc_chunker_release(decoder->chunker);
+	decoder->chunker = NULL;
 	plc_signal_iir_release(decoder->signal_iir);
 	decoder->signal_iir = NULL;
 }
 
-uint32_t decoder_parse_next_samples(struct decoder *decoder, const sample_rx_t *buffer_in,
+static uint32_t decoder_parse_chunk(void *handle, const sample_rx_t *buffer_in,
 		uint8_t *buffer_data_out, uint32_t buffer_data_out_count)
 {
+	struct decoder *decoder = handle;
 	plc_signal_iir_process_chunk(decoder->signal_iir, buffer_in, decoder->offset);
 	uint32_t n;
 	float *out_f = plc_signal_get_buffer_out(decoder->signal_iir);
+	const int32_t *out_q = plc_signal_get_buffer_out_fixed(decoder->signal_iir);
 	uint8_t *buffer_data_out_ini = buffer_data_out;
 	for (n = 0; n < decoder->chunk_samples; n++)
 	{
-		int hi_level_detected = (out_f[n] >= decoder->carrier_threshold);
+		int hi_level_detected =
+				out_q ? (out_q[n] >= decoder->carrier_threshold) :
+						(out_f[n] >= decoder->carrier_threshold);
 		if (decoder->samples_with_carrier == 0)
 		{
 			// If 'hi_level_detected' start counting the carrier, even when below the level
@@ -346,6 +447,27 @@ uint32_t decoder_parse_next_samples(struct decoder *decoder, const sample_rx_t *
 	return buffer_data_out - buffer_data_out_ini;
 }
 
+uint32_t decoder_parse_spans(struct decoder *decoder, const struct decoder_span *spans,
+		uint32_t spans_count, uint8_t *buffer_data_out, uint32_t buffer_data_out_count,
+		uint32_t *samples_consumed)
+{
+	// No spans -> end of the stream: the incomplete tail is decoded padded with the idle level
+	return plc_chunker_push_spans(decoder->chunker, (const struct plc_chunker_span*) spans,
+			spans_count, decoder->offset, buffer_data_out, buffer_data_out_count,
+			samples_consumed);
+}
+
+uint32_t decoder_parse_next_samples(struct decoder *decoder, const sample_rx_t *buffer_in,
+		uint8_t *buffer_data_out, uint32_t buffer_data_out_count)
+{
+	// Direct decoding if the chunk size hasn't been adapted (the usual case)
+	if (decoder->chunk_samples_in == plc_chunker_get_chunk_samples(decoder->chunker))
+		return decoder_parse_chunk(decoder, buffer_in, buffer_data_out, buffer_data_out_count);
+	// All the samples are consumed, the data not fitting is delivered on the next calls
+	return plc_chunker_push_all(decoder->chunker, buffer_in, decoder->chunk_samples_in,
+			buffer_data_out, buffer_data_out_count);
+}
+
 ATTR_EXTERN void PLUGIN_API_SET_SINGLETON_PROVIDER(singletons_provider_get_t callback,
 		singletons_provider_h handle)
 {
@@ -360,8 +482,8 @@ ATTR_EXTERN void PLUGIN_API_SET_SINGLETON_PROVIDER(singletons_provider_get_t cal
 
 ATTR_EXTERN void *PLUGIN_API_LOAD(uint32_t *plugin_api_version, uint32_t *plugin_api_size)
 {
-	CHECK_INTERFACE_MEMBERS_COUNT(decoder_api, 9);
-	*plugin_api_version = 1;
+	CHECK_INTERFACE_MEMBERS_COUNT(decoder_api, 10);
+	*plugin_api_version = 2;
 	*plugin_api_size = sizeof(struct decoder_api);
 	struct decoder_api *decoder_api = calloc(1, *plugin_api_size);
 	decoder_api->create = decoder_create;
@@ -373,6 +495,7 @@ ATTR_EXTERN void *PLUGIN_API_LOAD(uint32_t *plugin_api_version, uint32_t *plugin
 	decoder_api->initialize = decoder_initialize;
 	decoder_api->terminate = decoder_terminate;
 	decoder_api->parse_next_samples = decoder_parse_next_samples;
+	decoder_api->parse_spans = decoder_parse_spans;
 	return decoder_api;
 }
 
@@ -35,6 +35,7 @@
 #include "+common/api/error.h"
 #include "+common/api/logger.h"
 #include "+common/api/setting.h"
+#include "libraries/libplc-tools/api/chunker.h"
 #include "libraries/libplc-tools/api/signal.h"
 // Declare the custom type used as handle. Doing it like this avoids the 'void*' hard-casting
 #define PLUGINS_API_HANDLE_EXPLICIT_DEF
@@ -63,16 +64,34 @@ typedef struct decoder *decoder_api_h;
 //	implemented. Review
 static const int auto_resynchronization = 0;
 
+// Cut-off of the IIR filter normalized to the full-rate Nyquist frequency
+#define IIR_CUTOFF 0.01f
+
 //[iir_b,iir_a] = butter(2, 0.01)
 static const float iir_a_default[] = { 1.00000, -1.95558, 0.95654 };
 static const float iir_b_default[] = { 2.4136e-04, 4.8272e-04, 2.4136e-04 };
 
+// In matched-filter mode the integrate-and-dump stage does the filtering -> pass-all IIR
+static const float iir_a_pass_all[] = { 1.0 };
+static const float iir_b_pass_all[] = { 1.0 };
+
+enum decode_mode_enum
+{
+	decode_mode_threshold = 0,
+	decode_mode_matched_filter,
+	decode_mode_COUNT
+};
+
 struct decoder
 {
 	float sampling_rate_sps;
 	// chunk mode
 	uint32_t chunk_samples;
 	struct plc_signal_iir *signal_iir;
+	// Regroups the incoming spans in chunks suitable for the filter
+	struct plc_chunker *chunker;
+	// Chunk size requested on 'initialize'. Mandatory for 'parse_next_samples'
+	uint32_t chunk_samples_in;
 	sample_rx_t *buffer_out_filter;
 	// data mode
 	float carrier_freq;
@@ -80,6 +99,16 @@ struct decoder
 	uint32_t data_offset;
 	uint32_t bit_width_us;
 	uint32_t samples_to_file;
+	// Index of the first sample in the whole capture, to demodulate with its carrier phase
+	uint32_t first_sample;
+	enum plc_signal_arithmetic_enum arithmetic;
+	int saturation;
+	enum plc_signal_decimator_enum decimator;
+	uint32_t decimation;
+	enum decode_mode_enum decode_mode;
+	float timing_gain;
+	// Exact (fractional) symbol length at the output of the filter
+	float samples_per_symbol;
 	uint32_t samples_hi_threshold;
 	uint32_t samples_not_hi_threshold;
 	uint32_t samples_per_bit;
@@ -96,6 +125,24 @@ struct decoder
 	uint16_t data_per_frame_cur;
 	uint8_t bits_per_data;
 	uint8_t bits_per_data_cur;
+	// matched-filter mode
+	struct plc_signal_symbol_sync *symbol_sync;
+	// Moving average used to detect the rising edge of the start bit
+	float *edge_window;
+	uint32_t edge_window_samples;
+	uint32_t edge_window_pos;
+	float edge_window_acc;
+	int edge_armed;
+	// Average level before the edge
+	float edge_idle_level;
+	// Samples since the average crossed the threshold (0 if not crossed)
+	uint32_t edge_crossing_samples;
+	// Symbols received in the current frame (start bit included)
+	uint32_t frame_symbols;
+	// Data decoded not fitting in the output buffer, delivered on the next calls
+	uint8_t *data_pending;
+	uint32_t data_pending_count;
+	uint32_t data_pending_max;
 };
 
 // Connection with the 'singletons_provider'
@@ -127,6 +174,9 @@ static void decoder_set_defaults(struct decoder *decoder)
 	decoder->data_hi_threshold = 50;
 	decoder->data_offset = 500;
 	decoder->bit_width_us = 1000;
+	decoder->saturation = 1;
+	decoder->decimation = 1;
+	decoder->timing_gain = 0.2f;
 }
 
 struct decoder *decoder_create(void)
@@ -142,11 +192,36 @@ static void decoder_release_resources(struct decoder *decoder)
 
 void decoder_release(struct decoder *decoder)
 {
-	assert((decoder->signal_iir == NULL) && (decoder->buffer_out_filter == NULL));
+	assert((decoder->signal_iir == NULL) && (decoder->buffer_out_filter == NULL)
+			&& (decoder->symbol_sync == NULL));
 	decoder_release_resources(decoder);
 	free(decoder);
 }
 
+static const char *arithmetic_enum_text[plc_signal_arithmetic_COUNT] = {
+	"float", "q15", "q31" };
+
+static struct plc_setting_extra_data arithmetic_captions = {
+	plc_setting_extra_data_enum_captions, {
+		.enum_captions.captions = arithmetic_enum_text, .enum_captions.captions_count =
+				plc_signal_arithmetic_COUNT } };
+
+static const char *decimator_enum_text[plc_signal_decimator_COUNT] = {
+	"cic", "polyphase" };
+
+static struct plc_setting_extra_data decimator_captions = {
+	plc_setting_extra_data_enum_captions, {
+		.enum_captions.captions = decimator_enum_text, .enum_captions.captions_count =
+				plc_signal_decimator_COUNT } };
+
+static const char *decode_mode_enum_text[decode_mode_COUNT] = {
+	"threshold", "matched_filter" };
+
+static struct plc_setting_extra_data decode_mode_captions = {
+	plc_setting_extra_data_enum_captions, {
+		.enum_captions.captions = decode_mode_enum_text, .enum_captions.captions_count =
+				decode_mode_COUNT } };
+
 const struct plc_setting_definition accepted_settings[] = {
 	{
 		"sampling_rate_sps", plc_setting_float, "Freq Capture [sps]", {
@@ -160,7 +235,21 @@ const struct plc_setting_definition accepted_settings[] = {
 		"bit_width_us", plc_setting_u32, "Bit Width [us]", {
 			.u32 = 1000 }, 0 }, {
 		"samples_to_file", plc_setting_u32, "Samples to file", {
-			.u32 = 0 }, 0 } };
+			.u32 = 0 }, 0 }, {
+		"first_sample", plc_setting_u32, "First sample index", {
+			.u32 = 0 }, 0 }, {
+		"arithmetic", plc_setting_enum, "Arithmetic", {
+			.u32 = plc_signal_arithmetic_float }, 1, &arithmetic_captions }, {
+		"saturation", plc_setting_bool, "Fixed-point saturation", {
+			.u32 = 1 }, 0 }, {
+		"decimation", plc_setting_u32, "Decimation factor", {
+			.u32 = 1 }, 0 }, {
+		"decimator", plc_setting_enum, "Decimator", {
+			.u32 = plc_signal_decimator_cic }, 1, &decimator_captions }, {
+		"decode_mode", plc_setting_enum, "Decode mode", {
+			.u32 = decode_mode_threshold }, 1, &decode_mode_captions }, {
+		"timing_gain", plc_setting_float, "Timing recovery gain", {
+			.f = 0.2f }, 0 } };
 
 const struct plc_setting_definition *decoder_get_accepted_settings(struct decoder *decoder,
 		uint32_t *accepted_settings_count)
@@ -203,6 +292,40 @@ int decoder_set_setting(struct decoder *decoder, const char *identifier,
 	{
 		decoder->samples_to_file = data.u32;
 	}
+	else if (strcmp(identifier, "first_sample") == 0)
+	{
+		decoder->first_sample = data.u32;
+	}
+	else if (strcmp(identifier, "arithmetic") == 0)
+	{
+		if (data.u32 >= plc_signal_arithmetic_COUNT)
+			return set_error_msg("Unknown arithmetic");
+		decoder->arithmetic = data.u32;
+	}
+	else if (strcmp(identifier, "saturation") == 0)
+	{
+		decoder->saturation = data.u32;
+	}
+	else if (strcmp(identifier, "decimation") == 0)
+	{
+		decoder->decimation = data.u32;
+	}
+	else if (strcmp(identifier, "decimator") == 0)
+	{
+		if (data.u32 >= plc_signal_decimator_COUNT)
+			return set_error_msg("Unknown decimator");
+		decoder->decimator = data.u32;
+	}
+	else if (strcmp(identifier, "decode_mode") == 0)
+	{
+		if (data.u32 >= decode_mode_COUNT)
+			return set_error_msg("Unknown decode mode");
+		decoder->decode_mode = data.u32;
+	}
+	else if (strcmp(identifier, "timing_gain") == 0)
+	{
+		decoder->timing_gain = data.f;
+	}
 	else
 	{
 		return set_error_msg("Unknown setting");
@@ -212,23 +335,66 @@ int decoder_set_setting(struct decoder *decoder, const char *identifier,
 
 int decoder_end_settings(struct decoder *decoder)
 {
-	decoder->samples_per_bit = round(
-			decoder->sampling_rate_sps * decoder->bit_width_us / 1000000.0f);
+	// The IIR filter runs at the decimated rate -> the cut-off scales with the decimation
+	if ((decoder->decimation == 0) || (IIR_CUTOFF * decoder->decimation >= 1.0f))
+		return set_error_msg("Decimation factor out of range");
+	// Both decoding modes compare the demodulated level against it
+	if (decoder->data_hi_threshold == 0)
+		return set_error_msg("Data HI threshold must be greater than 0");
+	decoder->samples_per_symbol = decoder->sampling_rate_sps / decoder->decimation
+			* decoder->bit_width_us / 1000000.0f;
+	decoder->samples_per_bit = round(decoder->samples_per_symbol);
 	if (decoder->samples_per_bit == 0)
 		return set_error_msg("Bit width must be greater than 1 us");
+	if (decoder->decode_mode == decode_mode_matched_filter)
+	{
+		// The edge detector averages over a quarter of symbol
+		if (decoder->samples_per_symbol < 4.0f)
+			return set_error_msg("Matched filter requires at least 4 samples per bit");
+		if ((decoder->timing_gain < 0.0f) || (decoder->timing_gain > 1.0f))
+			return set_error_msg("Timing gain must be in the range [0, 1]");
+	}
 	return 0;
 }
 
+static uint32_t decoder_parse_chunk(void *handle, const sample_rx_t *buffer_in,
+		uint8_t *buffer_data_out, uint32_t buffer_data_out_count);
+
 // PRECONDITION: 'buffer_out_filter' with allocated space enough
-// PRECONDITION: ceil(samples_per_bit) > decoder->chunk_samples
 void decoder_initialize(struct decoder *decoder, uint32_t chunk_samples)
 {
 	assert((decoder->signal_iir == NULL) && (decoder->buffer_out_filter == NULL));
-	decoder->chunk_samples = chunk_samples;
-	decoder->signal_iir = plc_signal_iir_create(chunk_samples, iir_a_default,
-			ARRAY_SIZE(iir_a_default), iir_b_default, ARRAY_SIZE(iir_b_default));
+	decoder->chunk_samples_in = chunk_samples;
+	// The internal chunks must be a multiple of the decimation factor
+	chunk_samples = (chunk_samples + decoder->decimation - 1) / decoder->decimation
+			* decoder->decimation;
+	// For simplicity in the circular buffer assume 'samples_per_bit <= chunk_samples'
+	if (chunk_samples < (uint32_t) ceil(decoder->samples_per_bit) * decoder->decimation)
+		chunk_samples = (uint32_t) ceil(decoder->samples_per_bit) * decoder->decimation;
+	if (decoder->decode_mode == decode_mode_matched_filter)
+	{
+		decoder->signal_iir = plc_signal_iir_create(chunk_samples, iir_a_pass_all,
+				ARRAY_SIZE(iir_a_pass_all), iir_b_pass_all, ARRAY_SIZE(iir_b_pass_all));
+	}
+	else if (decoder->decimation > 1)
+	{
+		float iir_a[3], iir_b[3];
+		plc_signal_design_butterworth2(IIR_CUTOFF * decoder->decimation, iir_a, iir_b);
+		decoder->signal_iir = plc_signal_iir_create(chunk_samples, iir_a, ARRAY_SIZE(iir_a), iir_b,
+				ARRAY_SIZE(iir_b));
+	}
+	else
+	{
+		decoder->signal_iir = plc_signal_iir_create(chunk_samples, iir_a_default,
+				ARRAY_SIZE(iir_a_default), iir_b_default, ARRAY_SIZE(iir_b_default));
+	}
+	plc_signal_iir_set_decimation(decoder->signal_iir, decoder->decimator, decoder->decimation);
+	// From here 'chunk_samples' refers to the (decimated) samples at the output of the filter
+	decoder->chunk_samples = plc_signal_get_buffer_out_count(decoder->signal_iir);
 	plc_signal_iir_set_samples_to_file(decoder->signal_iir, decoder->samples_to_file);
-	if (decoder->carrier_freq)
+	plc_signal_iir_set_arithmetic(decoder->signal_iir, decoder->arithmetic, decoder->saturation);
+	// The matched filter integrates the envelope so the carrier phase is not relevant
+	if (decoder->carrier_freq && (decoder->decode_mode != decode_mode_matched_filter))
 	{
 		plc_signal_iir_set_demodulator(decoder->signal_iir, plc_signal_iir_demodulator_cos);
 		plc_signal_iir_set_demodulation_frequency(decoder->signal_iir,
@@ -238,15 +404,8 @@ void decoder_initialize(struct decoder *decoder, uint32_t chunk_samples)
 	{
 		plc_signal_iir_set_demodulator(decoder->signal_iir, plc_signal_iir_demodulator_abs);
 	}
-	decoder->buffer_out_filter = malloc(chunk_samples * sizeof(sample_rx_t));
-	// For simplicity in the circular buffer assume 'samples_per_bit < chunk_samples'
-	if ((uint32_t) ceil(decoder->samples_per_bit) > decoder->chunk_samples)
-	{
-		if (logger_api)
-			logger_api->log_line(logger_handle,
-					"'Samples per bit' too long. It must fit at least on a chunk");
-		assert(0);
-	}
+	plc_signal_iir_set_samples_counter(decoder->signal_iir, decoder->first_sample);
+	decoder->buffer_out_filter = malloc(decoder->chunk_samples * sizeof(sample_rx_t));
 	// Accept a bit if active 75% of symbol length
 	// TODO: Logics should be 'float-based' instead of 'uint32_t-based'.
 	//	i.e. float samples_hi_threshold...
@@ -269,10 +428,47 @@ void decoder_initialize(struct decoder *decoder, uint32_t chunk_samples)
 	decoder->bits_per_data = 8;
 	decoder->bits_per_data_cur = 0;
 	decoder->data_in_process = 0;
+	if (decoder->decode_mode == decode_mode_matched_filter)
+	{
+		decoder->symbol_sync = plc_signal_symbol_sync_create(decoder->samples_per_symbol,
+				decoder->data_hi_threshold, decoder->timing_gain);
+		decoder->edge_window_samples = round(decoder->samples_per_symbol / 4.0f);
+		// The line is assumed idle before the capture, so a start bit at its very beginning is
+		// also detected
+		decoder->edge_window = calloc(decoder->edge_window_samples, sizeof(float));
+		decoder->edge_window_pos = 0;
+		decoder->edge_window_acc = 0.0f;
+		decoder->edge_armed = 1;
+		decoder->edge_idle_level = 0.0f;
+		decoder->edge_crossing_samples = 0;
+		decoder->frame_symbols = 0;
+		// The clock recovery can shorten the symbols down to 9/16 of the nominal length (two
+		// corrections of 25%), so a frame of 9 symbols lasts at least 4.5 nominal ones
+		decoder->data_pending_max = chunk_samples / decoder->decimation
+				/ (4.5f * decoder->samples_per_symbol) + 1;
+		decoder->data_pending = malloc(decoder->data_pending_max);
+		decoder->data_pending_count = 0;
+	}
+	// Conservative bound of the data generated per chunk: one data per 8 bits. The matched filter
+	// can exceed it if its clock runs faster, keeping the excess as pending data
+	decoder->chunker = plc_chunker_create(chunk_samples,
+			ceil(chunk_samples * 1000000.0f / decoder->sampling_rate_sps / decoder->bit_width_us
+					/ 8.0f), decoder_parse_chunk, decoder);
 }
 
 void decoder_terminate(struct decoder *decoder)
 {
+	plc_chunker_release(decoder->chunker);
+	decoder->chunker = NULL;
+	if (decoder->symbol_sync)
+	{
+		plc_signal_symbol_sync_release(decoder->symbol_sync);
+		decoder->symbol_sync = NULL;
+		free(decoder->edge_window);
+		decoder->edge_window = NULL;
+		free(decoder->data_pending);
+		decoder->data_pending = NULL;
+	}
 	free(decoder->buffer_out_filter);
 	decoder->buffer_out_filter = NULL;
 	plc_signal_iir_release(decoder->signal_iir);
@@ -284,9 +480,18 @@ uint32_t decoder_parse_next_samples_buffer(struct decoder *decoder, const sample
 {
 	plc_signal_iir_process_chunk(decoder->signal_iir, buffer_in, decoder->data_offset);
 	uint32_t n;
-	float *out_f = plc_signal_get_buffer_out(decoder->signal_iir);
-	for (n = 0; n < decoder->chunk_samples; n++)
-		decoder->buffer_out_filter[n] = (sample_rx_t) (abs(round(out_f[n])));
+	const int32_t *out_q = plc_signal_get_buffer_out_fixed(decoder->signal_iir);
+	if (out_q)
+	{
+		for (n = 0; n < decoder->chunk_samples; n++)
+			decoder->buffer_out_filter[n] = (sample_rx_t) (abs(out_q[n]));
+	}
+	else
+	{
+		float *out_f = plc_signal_get_buffer_out(decoder->signal_iir);
+		for (n = 0; n < decoder->chunk_samples; n++)
+			decoder->buffer_out_filter[n] = (sample_rx_t) (abs(round(out_f[n])));
+	}
 	if (buffer_data_out_count == 0)
 		return 0;
 	uint8_t *buffer_data_out_end = buffer_data_out + buffer_data_out_count;
@@ -473,14 +678,169 @@ uint32_t decoder_parse_next_samples_buffer(struct decoder *decoder, const sample
 	}
 }
 
-uint32_t decoder_parse_next_samples(struct decoder *decoder, const sample_rx_t *buffer_in,
+// Stores a decoded data in the output buffer or, if full, in the pending queue
+static void decoder_store_data(struct decoder *decoder, uint8_t data, uint8_t **buffer_data_out_cur,
+		uint8_t *buffer_data_out_end)
+{
+	if ((*buffer_data_out_cur < buffer_data_out_end) && (decoder->data_pending_count == 0))
+	{
+		*(*buffer_data_out_cur)++ = data;
+		return;
+	}
+	// Only grows if the caller keeps providing less space than the data decoded
+	if (decoder->data_pending_count == decoder->data_pending_max)
+	{
+		decoder->data_pending_max *= 2;
+		decoder->data_pending = realloc(decoder->data_pending, decoder->data_pending_max);
+	}
+	decoder->data_pending[decoder->data_pending_count++] = data;
+}
+
+// Moves the pending data to the output buffer. Returns the number of data moved
+static uint32_t decoder_flush_pending_data(struct decoder *decoder, uint8_t *buffer_data_out,
+		uint32_t buffer_data_out_count)
+{
+	uint32_t data_count = (decoder->data_pending_count < buffer_data_out_count) ?
+			decoder->data_pending_count : buffer_data_out_count;
+	if (data_count == 0)
+		return 0;
+	memcpy(buffer_data_out, decoder->data_pending, data_count);
+	decoder->data_pending_count -= data_count;
+	memmove(decoder->data_pending, decoder->data_pending + data_count,
+			decoder->data_pending_count);
+	return data_count;
+}
+
+// Matched-filter decoding: the start bit is detected with a moving average over a quarter of
+// symbol. From there each symbol is integrated (integrate-and-dump) and the symbol clock is tracked
+// with a Gardner timing-error detector, which absorbs rate mismatches between TX and RX
+uint32_t decoder_parse_next_samples_matched(struct decoder *decoder, const sample_rx_t *buffer_in,
+		uint8_t *buffer_data_out, uint32_t buffer_data_out_count)
+{
+	plc_signal_iir_process_chunk(decoder->signal_iir, buffer_in, decoder->data_offset);
+	const int32_t *out_q = plc_signal_get_buffer_out_fixed(decoder->signal_iir);
+	const float *out_f = plc_signal_get_buffer_out(decoder->signal_iir);
+	float threshold = decoder->data_hi_threshold;
+	float window_samples = decoder->edge_window_samples;
+	uint8_t *buffer_data_out_cur = buffer_data_out;
+	uint8_t *buffer_data_out_end = buffer_data_out + buffer_data_out_count;
+	uint32_t n;
+	for (n = 0; n < decoder->chunk_samples; n++)
+	{
+		float sample = out_q ? (float) out_q[n] : out_f[n];
+		// The moving average always runs to know the state of the line at the end of each frame
+		decoder->edge_window_acc += sample - decoder->edge_window[decoder->edge_window_pos];
+		decoder->edge_window[decoder->edge_window_pos] = sample;
+		if (++decoder->edge_window_pos == decoder->edge_window_samples)
+			decoder->edge_window_pos = 0;
+		if (decoder->frame_symbols == 0)
+		{
+			float level = decoder->edge_window_acc / window_samples;
+			if (decoder->edge_crossing_samples > 0)
+			{
+				// Wait for the window to be fully inside the start bit to get its level
+				if (++decoder->edge_crossing_samples <= decoder->edge_window_samples)
+					continue;
+				decoder->edge_crossing_samples = 0;
+				// A spike shorter than the window -> keep waiting for an edge
+				if (level < threshold)
+					continue;
+				// The average crossed the threshold when the window contained a fraction
+				// '(threshold - idle) / (level - idle)' of start bit samples. Interpolating it
+				// removes the dependency of the alignment on the amplitude
+				float samples_edge_to_crossing = window_samples
+						* (threshold - decoder->edge_idle_level)
+						/ (level - decoder->edge_idle_level);
+				if (samples_edge_to_crossing < 1.0f)
+					samples_edge_to_crossing = 1.0f;
+				else if (samples_edge_to_crossing > window_samples)
+					samples_edge_to_crossing = window_samples;
+				plc_signal_symbol_sync_align(decoder->symbol_sync,
+						samples_edge_to_crossing + window_samples);
+				decoder->frame_symbols = 1;
+				decoder->bits_per_data_cur = 0;
+				decoder->data_in_process = 0;
+				continue;
+			}
+			// A rising edge is only accepted after an idle period
+			if (level < threshold)
+			{
+				decoder->edge_armed = 1;
+				decoder->edge_idle_level = level;
+			}
+			else if (decoder->edge_armed)
+			{
+				decoder->edge_armed = 0;
+				decoder->edge_crossing_samples = 1;
+			}
+			continue;
+		}
+		float symbol_level;
+		if (!plc_signal_symbol_sync_push(decoder->symbol_sync, sample, &symbol_level))
+			continue;
+		// The first symbol is the start bit
+		if (decoder->frame_symbols++ == 1)
+			continue;
+		decoder->data_in_process = (decoder->data_in_process << 1) | (symbol_level >= threshold);
+		if (++decoder->bits_per_data_cur < decoder->bits_per_data)
+			continue;
+		decoder_store_data(decoder, decoder->data_in_process, &buffer_data_out_cur,
+				buffer_data_out_end);
+		// End of frame -> the next edge is accepted once the average falls below the threshold
+		// (immediately if the last bit was a 0)
+		decoder->frame_symbols = 0;
+		decoder->edge_armed = 0;
+	}
+	return buffer_data_out_cur - buffer_data_out;
+}
+
+static uint32_t decoder_parse_chunk(void *handle, const sample_rx_t *buffer_in,
 		uint8_t *buffer_data_out, uint32_t buffer_data_out_count)
 {
+	struct decoder *decoder = handle;
+	if (decoder->decode_mode == decode_mode_matched_filter)
+		return decoder_parse_next_samples_matched(decoder, buffer_in, buffer_data_out,
+				buffer_data_out_count);
 	uint32_t data_decoded = decoder_parse_next_samples_buffer(decoder, buffer_in, buffer_data_out,
 			buffer_data_out_count);
 	return data_decoded;
 }
 
+uint32_t decoder_parse_spans(struct decoder *decoder, const struct decoder_span *spans,
+		uint32_t spans_count, uint8_t *buffer_data_out, uint32_t buffer_data_out_count,
+		uint32_t *samples_consumed)
+{
+	uint32_t data_count = decoder_flush_pending_data(decoder, buffer_data_out,
+			buffer_data_out_count);
+	*samples_consumed = 0;
+	// No samples are consumed until all the previous data has been delivered
+	if (decoder->data_pending_count > 0)
+		return data_count;
+	// No spans -> end of the stream: the incomplete tail is decoded padded with the idle level
+	return data_count + plc_chunker_push_spans(decoder->chunker,
+			(const struct plc_chunker_span*) spans, spans_count, decoder->data_offset,
+			buffer_data_out + data_count, buffer_data_out_count - data_count, samples_consumed);
+}
+
+uint32_t decoder_parse_next_samples(struct decoder *decoder, const sample_rx_t *buffer_in,
+		uint8_t *buffer_data_out, uint32_t buffer_data_out_count)
+{
+	// Direct decoding if the chunk size hasn't been adapted (the usual case)
+	if (decoder->chunk_samples_in == plc_chunker_get_chunk_samples(decoder->chunker))
+	{
+		// The v1 interface cannot defer the samples, so the data pending is just delivered first
+		uint32_t data_count = decoder_flush_pending_data(decoder, buffer_data_out,
+				buffer_data_out_count);
+		return data_count + decoder_parse_chunk(decoder, buffer_in, buffer_data_out + data_count,
+				buffer_data_out_count - data_count);
+	}
+	// All the samples are consumed. The data kept by the chunker is older than the pending one
+	uint32_t data_count = plc_chunker_push_all(decoder->chunker, buffer_in,
+			decoder->chunk_samples_in, buffer_data_out, buffer_data_out_count);
+	return data_count + decoder_flush_pending_data(decoder, buffer_data_out + data_count,
+			buffer_data_out_count - data_count);
+}
+
 ATTR_EXTERN void PLUGIN_API_SET_SINGLETON_PROVIDER(singletons_provider_get_t callback,
 		singletons_provider_h handle)
 {
@@ -495,8 +855,8 @@ ATTR_EXTERN void PLUGIN_API_SET_SINGLETON_PROVIDER(singletons_provider_get_t cal
 
 ATTR_EXTERN void *PLUGIN_API_LOAD(uint32_t *plugin_api_version, uint32_t *plugin_api_size)
 {
-	CHECK_INTERFACE_MEMBERS_COUNT(decoder_api, 9);
-	*plugin_api_version = 1;
+	CHECK_INTERFACE_MEMBERS_COUNT(decoder_api, 10);
+	*plugin_api_version = 2;
 	*plugin_api_size = sizeof(struct decoder_api);
 	struct decoder_api *decoder_api = calloc(1, *plugin_api_size);
 	decoder_api->create = decoder_create;
@@ -508,6 +868,7 @@ ATTR_EXTERN void *PLUGIN_API_LOAD(uint32_t *plugin_api_version, uint32_t *plugin
 	decoder_api->initialize = decoder_initialize;
 	decoder_api->terminate = decoder_terminate;
 	decoder_api->parse_next_samples = decoder_parse_next_samples;
+	decoder_api->parse_spans = decoder_parse_spans;
 	return decoder_api;
 }
 
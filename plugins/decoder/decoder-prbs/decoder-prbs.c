@@ -0,0 +1,488 @@
+/**
+ * @file
+ * @brief	**Main** file
+ *	
+ * @see		@ref plugin-decoder-prbs
+ *
+ * @cond COPYRIGHT_NOTES
+ *
+ * ##LICENSE
+ *
+ *		This file is part of plc-cape project.
+ *
+ *		plc-cape project is free software: you can redistribute it and/or modify
+ *		it under the terms of the GNU General Public License as published by
+ *		the Free Software Foundation, either version 3 of the License, or
+ *		(at your option) any later version.
+ *
+ *		plc-cape project is distributed in the hope that it will be useful,
+ *		but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *		MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *		GNU General Public License for more details.
+ *
+ *		You should have received a copy of the GNU General Public License
+ *		along with plc-cape project.  If not, see <http://www.gnu.org/licenses/>. 
+ *
+ * @copyright
+ *	Copyright (C) 2017 Jose Maria Ortega
+ * 
+ * @endcond
+ */
+
+#include <err.h>			// warnx
+#include <math.h>			// sqrt
+#include <stdio.h>			// snprintf
+#include "+common/api/+base.h"
+#include "+common/api/error.h"
+#include "+common/api/logger.h"
+#include "+common/api/setting.h"
+#include "libraries/libplc-tools/api/prbs.h"
+#include "libraries/libplc-tools/api/signal.h"
+// Declare the custom type used as handle. Doing it like this avoids the 'void*' hard-casting
+#define PLUGINS_API_HANDLE_EXPLICIT_DEF
+typedef struct decoder *decoder_api_h;
+#include "plugins/decoder/api/decoder.h"
+
+// Consecutive bits correctly predicted by the self-synchronizing checker to declare the lock
+#define SYNC_ACQUISITION_BITS 64
+// Errors on the last 64 checked bits declaring a sync loss. A wrong alignment gives a 50% of errors
+#define SYNC_LOSS_ERRORS 16
+// Maximum length of a report line
+#define REPORT_MAX 128
+// A report can only be emitted at the pace of the decoded data (one byte each 8 bits)
+#define REPORT_BITS_MIN (REPORT_MAX * 8)
+// Quantile of the standard normal distribution for the 95% confidence interval
+#define CONFIDENCE_Z 1.96
+
+enum modulation_enum
+{
+	modulation_ook = 0,
+	modulation_nrz,
+	modulation_COUNT
+};
+
+struct decoder
+{
+	float sampling_rate_sps;
+	uint32_t data_hi_threshold;
+	uint32_t data_offset;
+	uint32_t bit_width_us;
+	enum plc_prbs_enum prbs;
+	enum modulation_enum modulation;
+	float timing_gain;
+	uint32_t report_bits;
+	uint32_t burst_gap_bits;
+	float samples_per_symbol;
+	uint32_t chunk_samples;
+	struct plc_signal_symbol_sync *symbol_sync;
+	// Checker
+	struct plc_prbs *plc_prbs;
+	int synchronized;
+	uint32_t sync_bits;
+	uint32_t zero_bits;
+	// Errors on the last 64 checked bits (bit 0 the newest)
+	uint64_t error_window;
+	// Statistics
+	uint64_t bits_checked;
+	uint64_t errors;
+	uint32_t bursts;
+	uint32_t burst_max;
+	int burst_open;
+	uint64_t burst_first;
+	uint64_t error_last;
+	uint32_t sync_losses;
+	// Report pending to be delivered through the data output
+	uint32_t bits_to_report;
+	char report[REPORT_MAX];
+	uint32_t report_count;
+	uint32_t report_pos;
+};
+
+// Connection with the 'singletons_provider'
+static singletons_provider_get_t singletons_provider_get = NULL;
+static singletons_provider_h singletons_provider_handle = NULL;
+
+// Error reporting function
+static struct plc_error_api *plc_error_api;
+static void *error_ctrl_handle;
+
+// Logger served by the 'singletons_provider'
+static struct plc_logger_api *logger_api;
+static void *logger_handle;
+
+// Error function shortcut
+int set_error_msg(const char *msg)
+{
+	if (plc_error_api)
+		plc_error_api->set_error_msg(error_ctrl_handle, msg);
+	else
+		warnx("%s", msg);
+	return -1;
+}
+
+static void decoder_set_defaults(struct decoder *decoder)
+{
+	memset(decoder, 0, sizeof(*decoder));
+	decoder->sampling_rate_sps = 100000.0f;
+	decoder->data_hi_threshold = 50;
+	decoder->data_offset = 500;
+	decoder->bit_width_us = 1000;
+	decoder->prbs = plc_prbs_7;
+	decoder->modulation = modulation_ook;
+	decoder->timing_gain = 0.2f;
+	decoder->report_bits = 10000;
+	decoder->burst_gap_bits = 16;
+}
+
+struct decoder *decoder_create(void)
+{
+	struct decoder *decoder = malloc(sizeof(struct decoder));
+	decoder_set_defaults(decoder);
+	return decoder;
+}
+
+static void decoder_release_resources(struct decoder *decoder)
+{
+}
+
+void decoder_release(struct decoder *decoder)
+{
+	assert((decoder->symbol_sync == NULL) && (decoder->plc_prbs == NULL));
+	decoder_release_resources(decoder);
+	free(decoder);
+}
+
+static const char *prbs_enum_text[plc_prbs_COUNT] = {
+	"prbs7", "prbs15", "prbs23", "prbs31" };
+
+static struct plc_setting_extra_data prbs_captions = {
+	plc_setting_extra_data_enum_captions, {
+		.enum_captions.captions = prbs_enum_text, .enum_captions.captions_count =
+				plc_prbs_COUNT } };
+
+static const char *modulation_enum_text[modulation_COUNT] = {
+	"ook", "nrz" };
+
+static struct plc_setting_extra_data modulation_captions = {
+	plc_setting_extra_data_enum_captions, {
+		.enum_captions.captions = modulation_enum_text, .enum_captions.captions_count =
+				modulation_COUNT } };
+
+const struct plc_setting_definition accepted_settings[] = {
+	{
+		"sampling_rate_sps", plc_setting_float, "Freq Capture [sps]", {
+			.f = 100000.0f }, 0 }, {
+		"data_hi_threshold", plc_setting_u16, "Demod data HI Threshold", {
+			.u16 = 50 }, 0 }, {
+		"data_offset", plc_setting_u16, "Data offset", {
+			.u16 = 500 }, 0 }, {
+		"bit_width_us", plc_setting_u32, "Bit Width [us]", {
+			.u32 = 1000 }, 0 }, {
+		"prbs", plc_setting_enum, "PRBS sequence", {
+			.u32 = plc_prbs_7 }, 1, &prbs_captions }, {
+		"modulation", plc_setting_enum, "Modulation", {
+			.u32 = modulation_ook }, 1, &modulation_captions }, {
+		"timing_gain", plc_setting_float, "Timing recovery gain", {
+			.f = 0.2f }, 0 }, {
+		"report_bits", plc_setting_u32, "Bits per report", {
+			.u32 = 10000 }, 0 }, {
+		"burst_gap_bits", plc_setting_u32, "Error-free bits closing a burst", {
+			.u32 = 16 }, 0 } };
+
+const struct plc_setting_definition *decoder_get_accepted_settings(struct decoder *decoder,
+		uint32_t *accepted_settings_count)
+{
+	*accepted_settings_count = ARRAY_SIZE(accepted_settings);
+	return accepted_settings;
+}
+
+int decoder_begin_settings(struct decoder *decoder)
+{
+	decoder_release_resources(decoder);
+	decoder_set_defaults(decoder);
+	return 0;
+}
+
+int decoder_set_setting(struct decoder *decoder, const char *identifier,
+		union plc_setting_data data)
+{
+	if (strcmp(identifier, "sampling_rate_sps") == 0)
+	{
+		decoder->sampling_rate_sps = data.f;
+	}
+	else if (strcmp(identifier, "data_hi_threshold") == 0)
+	{
+		decoder->data_hi_threshold = data.u16;
+	}
+	else if (strcmp(identifier, "data_offset") == 0)
+	{
+		decoder->data_offset = data.u16;
+	}
+	else if (strcmp(identifier, "bit_width_us") == 0)
+	{
+		decoder->bit_width_us = data.u32;
+	}
+	else if (strcmp(identifier, "prbs") == 0)
+	{
+		if (data.u32 >= plc_prbs_COUNT)
+			return set_error_msg("Unknown PRBS sequence");
+		decoder->prbs = data.u32;
+	}
+	else if (strcmp(identifier, "modulation") == 0)
+	{
+		if (data.u32 >= modulation_COUNT)
+			return set_error_msg("Unknown modulation");
+		decoder->modulation = data.u32;
+	}
+	else if (strcmp(identifier, "timing_gain") == 0)
+	{
+		decoder->timing_gain = data.f;
+	}
+	else if (strcmp(identifier, "report_bits") == 0)
+	{
+		decoder->report_bits = data.u32;
+	}
+	else if (strcmp(identifier, "burst_gap_bits") == 0)
+	{
+		decoder->burst_gap_bits = data.u32;
+	}
+	else
+	{
+		return set_error_msg("Unknown setting");
+	}
+	return 0;
+}
+
+int decoder_end_settings(struct decoder *decoder)
+{
+	decoder->samples_per_symbol = decoder->sampling_rate_sps * decoder->bit_width_us / 1000000.0f;
+	if (decoder->samples_per_symbol < 2.0f)
+		return set_error_msg("At least 2 samples per bit are required");
+	// The timing-error detector is normalized to the threshold
+	if (decoder->data_hi_threshold == 0)
+		return set_error_msg("Threshold must be greater than 0");
+	if ((decoder->timing_gain < 0.0f) || (decoder->timing_gain > 1.0f))
+		return set_error_msg("Timing gain must be in the range [0, 1]");
+	if (decoder->report_bits < REPORT_BITS_MIN)
+		return set_error_msg("Too few bits per report");
+	return 0;
+}
+
+void decoder_initialize(struct decoder *decoder, uint32_t chunk_samples)
+{
+	assert((decoder->symbol_sync == NULL) && (decoder->plc_prbs == NULL));
+	decoder->chunk_samples = chunk_samples;
+	// The symbol clock is acquired from the PRBS transitions: no start bit is required
+	decoder->symbol_sync = plc_signal_symbol_sync_create(decoder->samples_per_symbol,
+			decoder->data_hi_threshold, decoder->timing_gain);
+	decoder->plc_prbs = plc_prbs_create(decoder->prbs);
+	decoder->synchronized = 0;
+	decoder->sync_bits = 0;
+	decoder->zero_bits = 0;
+	decoder->error_window = 0;
+	decoder->bits_checked = 0;
+	decoder->errors = 0;
+	decoder->bursts = 0;
+	decoder->burst_max = 0;
+	decoder->burst_open = 0;
+	decoder->sync_losses = 0;
+	decoder->bits_to_report = decoder->report_bits;
+	decoder->report_count = 0;
+	decoder->report_pos = 0;
+}
+
+void decoder_terminate(struct decoder *decoder)
+{
+	plc_prbs_release(decoder->plc_prbs);
+	decoder->plc_prbs = NULL;
+	plc_signal_symbol_sync_release(decoder->symbol_sync);
+	decoder->symbol_sync = NULL;
+}
+
+// Wilson score interval. Unlike the normal approximation it remains meaningful with few or no
+// errors. It assumes independent errors, so it is optimistic on channels with error bursts
+static void decoder_get_confidence_interval(uint64_t errors, uint64_t bits, double *low,
+		double *high)
+{
+	double p = (double) errors / bits;
+	double z2_n = CONFIDENCE_Z * CONFIDENCE_Z / bits;
+	double center = (p + z2_n / 2.0) / (1.0 + z2_n);
+	double half_width = CONFIDENCE_Z * sqrt(p * (1.0 - p) / bits + z2_n / (4.0 * bits))
+			/ (1.0 + z2_n);
+	*low = (center > half_width) ? center - half_width : 0.0;
+	*high = center + half_width;
+}
+
+static void decoder_prepare_report(struct decoder *decoder)
+{
+	// Skip the report if the previous one is still being delivered
+	if (decoder->report_pos < decoder->report_count)
+		return;
+	int len;
+	if (decoder->bits_checked == 0)
+	{
+		len = snprintf(decoder->report, REPORT_MAX, "BER - bits 0 NO SYNC\n");
+	}
+	else
+	{
+		double low, high;
+		decoder_get_confidence_interval(decoder->errors, decoder->bits_checked, &low, &high);
+		len = snprintf(decoder->report, REPORT_MAX,
+				"BER %.2e [%.2e, %.2e] bits %llu errors %llu bursts %u (max %u) sync_losses %u%s\n",
+				(double) decoder->errors / decoder->bits_checked, low, high,
+				(unsigned long long) decoder->bits_checked, (unsigned long long) decoder->errors,
+				decoder->bursts, decoder->burst_max, decoder->sync_losses,
+				decoder->synchronized ? "" : " NO SYNC");
+	}
+	// On truncation keep the line ending
+	if (len >= REPORT_MAX)
+	{
+		len = REPORT_MAX - 1;
+		decoder->report[len - 1] = '\n';
+	}
+	decoder->report_count = len;
+	decoder->report_pos = 0;
+}
+
+static void decoder_check_bit(struct decoder *decoder, int bit)
+{
+	if (!decoder->synchronized)
+	{
+		int bit_expected = plc_prbs_check_bit(decoder->plc_prbs, bit);
+		// The all-zeros state (i.e. an idle line) is a fixed point of the LFSR -> not a lock
+		decoder->zero_bits = bit ? 0 : decoder->zero_bits + 1;
+		if ((bit == bit_expected) && (decoder->zero_bits < plc_prbs_get_order(decoder->plc_prbs)))
+		{
+			if (++decoder->sync_bits == SYNC_ACQUISITION_BITS)
+			{
+				decoder->synchronized = 1;
+				decoder->error_window = 0;
+				decoder->burst_open = 0;
+			}
+		}
+		else
+		{
+			decoder->sync_bits = 0;
+		}
+	}
+	else
+	{
+		// Once synchronized the generator runs free, so each channel error is counted once
+		int error = (plc_prbs_next_bit(decoder->plc_prbs) != bit);
+		decoder->bits_checked++;
+		decoder->error_window = (decoder->error_window << 1) | error;
+		if (error)
+		{
+			decoder->errors++;
+			if (!decoder->burst_open
+					|| (decoder->bits_checked - decoder->error_last > decoder->burst_gap_bits))
+			{
+				decoder->bursts++;
+				decoder->burst_first = decoder->bits_checked;
+				decoder->burst_open = 1;
+			}
+			decoder->error_last = decoder->bits_checked;
+			uint32_t burst_length = decoder->error_last - decoder->burst_first + 1;
+			if (burst_length > decoder->burst_max)
+				decoder->burst_max = burst_length;
+			if (__builtin_popcountll(decoder->error_window) > SYNC_LOSS_ERRORS)
+			{
+				decoder->synchronized = 0;
+				decoder->sync_bits = 0;
+				decoder->sync_losses++;
+			}
+		}
+	}
+	if (--decoder->bits_to_report == 0)
+	{
+		decoder->bits_to_report = decoder->report_bits;
+		decoder_prepare_report(decoder);
+	}
+}
+
+static void decoder_process_samples(struct decoder *decoder, const sample_rx_t *buffer_in,
+		uint32_t buffer_in_count)
+{
+	float threshold = decoder->data_hi_threshold;
+	// NRZ levels are moved around the threshold as required by the timing-error detector
+	float nrz_offset = threshold;
+	int32_t data_offset = decoder->data_offset;
+	uint32_t n;
+	for (n = 0; n < buffer_in_count; n++)
+	{
+		int32_t sample = (int32_t) buffer_in[n] - data_offset;
+		float level_in =
+				(decoder->modulation == modulation_ook) ? abs(sample) : sample + nrz_offset;
+		float symbol_level;
+		if (plc_signal_symbol_sync_push(decoder->symbol_sync, level_in, &symbol_level))
+			decoder_check_bit(decoder, symbol_level >= threshold);
+	}
+}
+
+static uint32_t decoder_output_report(struct decoder *decoder, uint8_t *buffer_data_out,
+		uint32_t buffer_data_out_count)
+{
+	uint32_t data_count = decoder->report_count - decoder->report_pos;
+	if (data_count > buffer_data_out_count)
+		data_count = buffer_data_out_count;
+	memcpy(buffer_data_out, decoder->report + decoder->report_pos, data_count);
+	decoder->report_pos += data_count;
+	return data_count;
+}
+
+uint32_t decoder_parse_next_samples(struct decoder *decoder, const sample_rx_t *buffer_in,
+		uint8_t *buffer_data_out, uint32_t buffer_data_out_count)
+{
+	decoder_process_samples(decoder, buffer_in, decoder->chunk_samples);
+	return decoder_output_report(decoder, buffer_data_out, buffer_data_out_count);
+}
+
+uint32_t decoder_parse_spans(struct decoder *decoder, const struct decoder_span *spans,
+		uint32_t spans_count, uint8_t *buffer_data_out, uint32_t buffer_data_out_count,
+		uint32_t *samples_consumed)
+{
+	// The reports are delivered progressively -> all the samples are always consumed
+	*samples_consumed = 0;
+	for (; spans_count > 0; spans_count--, spans++)
+	{
+		decoder_process_samples(decoder, spans->samples, spans->samples_count);
+		*samples_consumed += spans->samples_count;
+	}
+	return decoder_output_report(decoder, buffer_data_out, buffer_data_out_count);
+}
+
+ATTR_EXTERN void PLUGIN_API_SET_SINGLETON_PROVIDER(singletons_provider_get_t callback,
+		singletons_provider_h handle)
+{
+	singletons_provider_get = callback;
+	singletons_provider_handle = handle;
+	// Ask for the required callbacks
+	uint32_t version;
+	singletons_provider_get(singletons_provider_handle, singleton_id_logger, (void**) &logger_api,
+			&logger_handle, &version);
+	assert(!logger_api || (version >= 1));
+}
+
+ATTR_EXTERN void *PLUGIN_API_LOAD(uint32_t *plugin_api_version, uint32_t *plugin_api_size)
+{
+	CHECK_INTERFACE_MEMBERS_COUNT(decoder_api, 10);
+	*plugin_api_version = 2;
+	*plugin_api_size = sizeof(struct decoder_api);
+	struct decoder_api *decoder_api = calloc(1, *plugin_api_size);
+	decoder_api->create = decoder_create;
+	decoder_api->release = decoder_release;
+	decoder_api->get_accepted_settings = decoder_get_accepted_settings;
+	decoder_api->begin_settings = decoder_begin_settings;
+	decoder_api->set_setting = decoder_set_setting;
+	decoder_api->end_settings = decoder_end_settings;
+	decoder_api->initialize = decoder_initialize;
+	decoder_api->terminate = decoder_terminate;
+	decoder_api->parse_next_samples = decoder_parse_next_samples;
+	decoder_api->parse_spans = decoder_parse_spans;
+	return decoder_api;
+}
+
+ATTR_EXTERN void PLUGIN_API_UNLOAD(void *decoder_api)
+{
+	free(decoder_api);
+}
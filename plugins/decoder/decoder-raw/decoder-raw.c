@@ -150,6 +150,16 @@ uint32_t decoder_parse_next_samples(struct decoder *decoder, const sample_rx_t *
 	return 0;
 }
 
+uint32_t decoder_parse_spans(struct decoder *decoder, const struct decoder_span *spans,
+		uint32_t spans_count, uint8_t *buffer_data_out, uint32_t buffer_data_out_count,
+		uint32_t *samples_consumed)
+{
+	*samples_consumed = 0;
+	for (; spans_count > 0; spans_count--, spans++)
+		*samples_consumed += spans->samples_count;
+	return 0;
+}
+
 ATTR_EXTERN void PLUGIN_API_SET_SINGLETON_PROVIDER(singletons_provider_get_t callback,
 		singletons_provider_h handle)
 {
@@ -164,8 +174,8 @@ ATTR_EXTERN void PLUGIN_API_SET_SINGLETON_PROVIDER(singletons_provider_get_t cal
 
 ATTR_EXTERN void *PLUGIN_API_LOAD(uint32_t *plugin_api_version, uint32_t *plugin_api_size)
 {
-	CHECK_INTERFACE_MEMBERS_COUNT(decoder_api, 9);
-	*plugin_api_version = 1;
+	CHECK_INTERFACE_MEMBERS_COUNT(decoder_api, 10);
+	*plugin_api_version = 2;
 	*plugin_api_size = sizeof(struct decoder_api);
 	struct decoder_api *decoder_api = calloc(1, *plugin_api_size);
 	decoder_api->create = decoder_create;
@@ -177,6 +187,7 @@ ATTR_EXTERN void *PLUGIN_API_LOAD(uint32_t *plugin_api_version, uint32_t *plugin
 	decoder_api->initialize = decoder_initialize;
 	decoder_api->terminate = decoder_terminate;
 	decoder_api->parse_next_samples = decoder_parse_next_samples;
+	decoder_api->parse_spans = decoder_parse_spans;
 	return decoder_api;
 }
 
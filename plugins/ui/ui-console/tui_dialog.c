@@ -46,6 +46,9 @@ void tui_dialog_display_item(struct ui_dialog_item *item)
 	case data_type_u32:
 		printf("%u", *item->data_ptr.u32);
 		break;
+	case data_type_u64:
+		printf("%llu", (unsigned long long) *item->data_ptr.u64);
+		break;
 	case data_type_float:
 		printf("%.2f", *item->data_ptr.f);
 		break;
@@ -97,6 +100,14 @@ void tui_dialog_change_item(struct ui_dialog_item *item)
 		scanf("%u", item->data_ptr.u32);
 		getchar();
 		break;
+	case data_type_u64:
+	{
+		unsigned long long value;
+		if (scanf("%llu", &value) == 1)
+			*item->data_ptr.u64 = value;
+		getchar();
+		break;
+	}
 	case data_type_float:
 		scanf("%f", item->data_ptr.f);
 		getchar();
@@ -78,6 +78,13 @@ static void tui_dialog_validate(struct tui_dialog *tui_dialog)
 		case data_type_u32:
 			sscanf(dialog_text, "%u", item->data_ptr.u32);
 			break;
+		case data_type_u64:
+		{
+			unsigned long long value;
+			if (sscanf(dialog_text, "%llu", &value) == 1)
+				*item->data_ptr.u64 = value;
+			break;
+		}
 		case data_type_float:
 			sscanf(dialog_text, "%f", item->data_ptr.f);
 			break;
@@ -305,7 +312,7 @@ struct tui_dialog *tui_dialog_create(struct tui_panel *parent,
 		field_opts_off(*cur_field, O_AUTOSKIP);
 		set_field_userptr(*cur_field, item);
 		// Fill data
-		char field_text_int[11];
+		char field_text_int[21];
 		int use_field_text_int = 1;
 		switch (item->data_type)
 		{
@@ -320,6 +327,9 @@ struct tui_dialog *tui_dialog_create(struct tui_panel *parent,
 		case data_type_u32:
 			sprintf(field_text_int, "%u", *item->data_ptr.u32);
 			break;
+		case data_type_u64:
+			sprintf(field_text_int, "%llu", (unsigned long long) *item->data_ptr.u64);
+			break;
 		case data_type_float:
 		{
 			char *field_text_float;
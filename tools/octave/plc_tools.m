@@ -144,3 +144,49 @@ function plc_plot_adc_capture_and_demod(title, seq, f_passband_hz, f_demod_hz)
   demod_filt = filter(b_low,a_low,demod);
   plot_seq_and_fft('Demod + Filter', 5, demod_filt);
 endfunction
+
+% Loads a binary capture file ('.plccap') written by the 'plc-cape' applications
+%   seq: row vector with the samples
+%   info: struct with the metadata of the header (sampling rate, device, AFE settings, start
+%     time) plus the 'timestamps_ns' of each block
+% The format is described in 'libraries/libplc-tools/api/capture.h'
+function [seq, info] = plc_load_capture(filename)
+  fid = fopen(filename, 'r', 'ieee-le');
+  assert(fid >= 0, 'Unable to open the capture file');
+  magic = fread(fid, 8, 'char=>char')';
+  assert(strcmp(magic(1:7), 'PLCCAPT'), 'Invalid capture file');
+  version = fread(fid, 1, 'uint32');
+  header_size = fread(fid, 1, 'uint32');
+  info.sample_bits = fread(fid, 1, 'uint32');
+  info.device = fread(fid, 1, 'uint32');
+  info.sampling_rate_sps = fread(fid, 1, 'single');
+  info.afe_gain_rx_pga1 = fread(fid, 1, 'uint32');
+  info.afe_gain_rx_pga2 = fread(fid, 1, 'uint32');
+  info.afe_cenelec_a = fread(fid, 1, 'uint32');
+  info.start_time_ns = fread(fid, 1, 'int64');
+  samples_count = fread(fid, 1, 'uint64');
+  blocks_count = fread(fid, 1, 'uint32');
+  % Blocks scanned sequentially (valid also for files not properly closed)
+  fseek(fid, header_size, SEEK_SET);
+  seq = zeros(1, samples_count);
+  info.timestamps_ns = [];
+  seq_len = 0;
+  while (true)
+    block_magic = fread(fid, 1, 'uint32');
+    if (isempty(block_magic) || (block_magic != 0x4B434C42))
+      break;
+    endif
+    block_samples = fread(fid, 1, 'uint32');
+    info.timestamps_ns(end+1) = fread(fid, 1, 'int64');
+    block = fread(fid, block_samples, 'uint16')';
+    if (length(block) < block_samples)
+      break;
+    endif
+    seq(seq_len+1:seq_len+block_samples) = block;
+    seq_len += block_samples;
+    % Blocks padded to 8 bytes
+    fseek(fid, mod(-2*block_samples, 8), SEEK_CUR);
+  endwhile
+  fclose(fid);
+  seq = seq(1:seq_len);
+endfunction